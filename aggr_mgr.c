@@ -0,0 +1,754 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "aggr_mgr.h"
+#include "record_mgr.h"
+#include "rm_spill.h"
+#include "dberror.h"
+#include "tables.h"
+
+/*
+ * aggr_mgr.c
+ * ---------------------------------------------------------------
+ * Hash aggregation. Every group had one fixed-size state: its key (the group
+ * attributes' bytes, strings padded with '\0') followed by one accumulator
+ * per aggregate. The states lay one after the other in a single array, and an
+ * open-addressed bucket array of (hash, state index) pairs, probed linearly,
+ * found them by key.
+ *
+ * The input was handled RM_AGGR_BATCH records at a time, one pass per step:
+ * build all keys, hash all keys, find or create all groups, then update one
+ * aggregate at a time across the whole batch.
+ *
+ * Once the states and buckets would have outgrown the memory budget, records
+ * of groups that were not in memory yet went to partition files by hash
+ * instead. After the groups in memory were returned, each partition was
+ * aggregated on its own (over budget if it had to).
+ */
+
+/* Partitions the records of groups that did not fit went to. */
+#define AGGR_PARTITIONS 16
+
+/* Accumulator of one aggregate within a group state. */
+typedef struct AggrAcc {
+    long long count;
+    long long isum;     // SUM/AVG of DT_INT
+    double fsum;        // SUM/AVG of DT_FLOAT
+    char minMax[];      // MIN/MAX: raw value in record->data format
+} AggrAcc;
+
+/* One bucket; group < 0 marks an empty bucket. */
+typedef struct AggrBucket {
+    unsigned int hash;
+    int group;
+} AggrBucket;
+
+/* This structure stored the state of an aggregation in progress. */
+typedef struct AggrData {
+    Schema *inSchema;
+    int inSize;
+    int numGroupAttrs;
+    int *groupAttrs;
+    int numAggrs;
+    RM_AggrSpec *aggrs;
+    size_t budget;
+
+    // Group state layout
+    int keySize;
+    int *accOff;        // where each accumulator started within a state
+    int stateSize;
+
+    // Groups in memory
+    char *states;
+    int numGroups, capGroups;
+    AggrBucket *buckets;
+    unsigned int mask;
+
+    // Current batch
+    char *batch;        // RM_AGGR_BATCH input records
+    char *keys;         // their keys
+    unsigned int *hashes;
+    int *groupOf;       // their group, -1 if spilled
+
+    // Partitions of the groups that did not fit
+    RM_Spill *parts;    // NULL until the first record spilled
+    int part;           // partition whose groups were being returned (-1: none yet)
+
+    int emitPos;        // next group nextGroup returned
+} AggrData;
+
+/* --------------------------------------------------------------------------
+   Keys and values
+   -------------------------------------------------------------------------- */
+
+/*
+ * compareRaw
+ * ----------
+ * Compared two values of an attribute in their record->data byte format.
+ * Returned <0, 0 or >0 like strcmp.
+ */
+static int compareRaw(DataType dt, const char *a, const char *b, int width)
+{
+    switch (dt)
+    {
+        case DT_INT:
+        case DT_BLOB:   // large objects compared by id
+        {
+            int x, y;
+            memcpy(&x, a, sizeof(int));
+            memcpy(&y, b, sizeof(int));
+            return (x > y) - (x < y);
+        }
+        case DT_FLOAT:
+        {
+            float x, y;
+            memcpy(&x, a, sizeof(float));
+            memcpy(&y, b, sizeof(float));
+            return (x > y) - (x < y);
+        }
+        case DT_BOOL:
+            return (a[0] != 0) - (b[0] != 0);
+        case DT_STRING:
+            return strncmp(a, b, width);
+    }
+    return 0;
+}
+
+/*
+ * makeKey
+ * -------
+ * Copied the group attributes of a record into a key. Bytes after a string's
+ * terminator were cleared, so equal groups always had equal keys.
+ */
+static void makeKey(AggrData *ad, const char *rec, char *key)
+{
+    Schema *sc = ad->inSchema;
+    int pos = 0;
+
+    for (int i = 0; i < ad->numGroupAttrs; i++)
+    {
+        int attr  = ad->groupAttrs[i];
+        int width = getAttrSize(sc, attr);
+        const char *val = rec + sc->attrOffsets[attr];
+
+        if (sc->dataTypes[attr] == DT_STRING)
+        {
+            int len = (int) strnlen(val, width);
+            memcpy(key + pos, val, len);
+            memset(key + pos + len, 0, width - len);
+        }
+        else
+            memcpy(key + pos, val, width);
+        pos += width;
+    }
+}
+
+/*
+ * hashKey
+ * -------
+ * FNV-1a over the key bytes.
+ */
+static unsigned int hashKey(const char *key, int len)
+{
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < len; i++)
+    {
+        h ^= (unsigned char) key[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* --------------------------------------------------------------------------
+   Group table
+   -------------------------------------------------------------------------- */
+
+#define GROUP_STATE(ad, g)  ((ad)->states + (size_t) (g) * (ad)->stateSize)
+#define GROUP_ACC(ad, g, a) ((AggrAcc *) (GROUP_STATE(ad, g) + (ad)->accOff[a]))
+
+/*
+ * memoryFor
+ * ---------
+ * Bytes the states and buckets would take for the given number of groups,
+ * using the same growth steps as addGroup.
+ */
+static size_t memoryFor(AggrData *ad, int numGroups)
+{
+    size_t cap = (ad->capGroups > 0) ? (size_t) ad->capGroups : 64;
+    while (cap < (size_t) numGroups)
+        cap *= 2;
+    size_t buckets = ad->mask + 1;
+    while (buckets < 2 * (size_t) numGroups)
+        buckets *= 2;
+    return cap * ad->stateSize + buckets * sizeof(AggrBucket);
+}
+
+/*
+ * growBuckets
+ * -----------
+ * Doubled the bucket array and re-inserted every group by its stored hash.
+ */
+static RC growBuckets(AggrData *ad)
+{
+    unsigned int cap = 2 * (ad->mask + 1);
+    AggrBucket *b = (AggrBucket *) malloc(cap * sizeof(AggrBucket));
+    if (b == NULL)
+        return RC_MEMORY_ALLOCATION_ERROR;
+    for (unsigned int i = 0; i < cap; i++)
+        b[i].group = -1;
+
+    for (unsigned int i = 0; i <= ad->mask; i++)
+    {
+        if (ad->buckets[i].group < 0)
+            continue;
+        unsigned int slot = ad->buckets[i].hash & (cap - 1);
+        while (b[slot].group >= 0)
+            slot = (slot + 1) & (cap - 1);
+        b[slot] = ad->buckets[i];
+    }
+    free(ad->buckets);
+    ad->buckets = b;
+    ad->mask = cap - 1;
+    return RC_OK;
+}
+
+/*
+ * resetGroups
+ * -----------
+ * Dropped all groups, keeping the arrays for the next partition.
+ */
+static void resetGroups(AggrData *ad)
+{
+    ad->numGroups = 0;
+    ad->emitPos = 0;
+    for (unsigned int i = 0; i <= ad->mask; i++)
+        ad->buckets[i].group = -1;
+}
+
+/*
+ * addGroup
+ * --------
+ * Created the state of a new group from its first record: the key, zero
+ * counts and sums, and the record's values as MIN/MAX so far.
+ */
+static RC addGroup(AggrData *ad, const char *key, unsigned int hash, unsigned int slot, const char *rec)
+{
+    RC rc;
+
+    if (ad->numGroups == ad->capGroups)
+    {
+        int cap = (ad->capGroups > 0) ? 2 * ad->capGroups : 64;
+        char *states = (char *) realloc(ad->states, (size_t) cap * ad->stateSize);
+        if (states == NULL)
+            return RC_MEMORY_ALLOCATION_ERROR;
+        ad->states = states;
+        ad->capGroups = cap;
+    }
+
+    int g = ad->numGroups++;
+    char *state = GROUP_STATE(ad, g);
+    memset(state, 0, ad->stateSize);
+    memcpy(state, key, ad->keySize);
+    for (int a = 0; a < ad->numAggrs; a++)
+    {
+        RM_AggrFunc f = ad->aggrs[a].func;
+        int attr = ad->aggrs[a].attrNum;
+        if (f == RM_AGGR_MIN || f == RM_AGGR_MAX)
+            memcpy(GROUP_ACC(ad, g, a)->minMax, rec + ad->inSchema->attrOffsets[attr],
+                   getAttrSize(ad->inSchema, attr));
+    }
+
+    ad->buckets[slot].hash  = hash;
+    ad->buckets[slot].group = g;
+    if (2u * (unsigned int) ad->numGroups > ad->mask + 1)
+    {
+        if ((rc = growBuckets(ad)) != RC_OK)
+            return rc;
+    }
+    return RC_OK;
+}
+
+/*
+ * findGroup
+ * ---------
+ * Looked a key up. Returned its group, or -1 with *slot set to the empty
+ * bucket where it would go.
+ */
+static int findGroup(AggrData *ad, const char *key, unsigned int hash, unsigned int *slot)
+{
+    unsigned int s = hash & ad->mask;
+    while (ad->buckets[s].group >= 0)
+    {
+        if (ad->buckets[s].hash == hash
+            && memcmp(GROUP_STATE(ad, ad->buckets[s].group), key, ad->keySize) == 0)
+            return ad->buckets[s].group;
+        s = (s + 1) & ad->mask;
+    }
+    *slot = s;
+    return -1;
+}
+
+/* --------------------------------------------------------------------------
+   Spilling
+   -------------------------------------------------------------------------- */
+
+/*
+ * spillRecord
+ * -----------
+ * Sent an input record whose group was not in memory to its partition,
+ * creating the partition files on first use.
+ */
+static RC spillRecord(AggrData *ad, unsigned int hash, const char *rec)
+{
+    RC rc;
+
+    if (ad->parts == NULL)
+    {
+        ad->parts = (RM_Spill *) calloc(AGGR_PARTITIONS, sizeof(RM_Spill));
+        if (ad->parts == NULL)
+            return RC_MEMORY_ALLOCATION_ERROR;
+
+        int id = rmSpillNextId();
+        for (int i = 0; i < AGGR_PARTITIONS; i++)
+        {
+            char fileName[64];
+            snprintf(fileName, sizeof(fileName), "aggr%d.p%d.tmp", id, i);
+            if ((rc = rmSpillOpen(&ad->parts[i], fileName)) != RC_OK)
+                return rc;
+        }
+    }
+
+    RID none = { -1, -1 };
+    return rmSpillTuple(&ad->parts[(hash >> 16) % AGGR_PARTITIONS], none, rec, ad->inSize);
+}
+
+/* --------------------------------------------------------------------------
+   Batches
+   -------------------------------------------------------------------------- */
+
+/*
+ * aggregateBatch
+ * --------------
+ * Folded n records of ad->batch into the groups, one pass per step. With
+ * maySpill, records of new groups that would have broken the memory budget
+ * were spilled instead.
+ */
+static RC aggregateBatch(AggrData *ad, int n, bool maySpill)
+{
+    Schema *sc = ad->inSchema;
+    RC rc;
+
+    for (int r = 0; r < n; r++)
+        makeKey(ad, ad->batch + (size_t) r * ad->inSize, ad->keys + (size_t) r * ad->keySize);
+    for (int r = 0; r < n; r++)
+        ad->hashes[r] = hashKey(ad->keys + (size_t) r * ad->keySize, ad->keySize);
+
+    for (int r = 0; r < n; r++)
+    {
+        const char *key = ad->keys + (size_t) r * ad->keySize;
+        const char *rec = ad->batch + (size_t) r * ad->inSize;
+        unsigned int slot;
+        int g = findGroup(ad, key, ad->hashes[r], &slot);
+
+        if (g < 0)
+        {
+            if (maySpill && (ad->parts != NULL || memoryFor(ad, ad->numGroups + 1) > ad->budget)
+                && ad->numGroups > 0)
+            {
+                if ((rc = spillRecord(ad, ad->hashes[r], rec)) != RC_OK)
+                    return rc;
+                ad->groupOf[r] = -1;
+                continue;
+            }
+            if ((rc = addGroup(ad, key, ad->hashes[r], slot, rec)) != RC_OK)
+                return rc;
+            g = ad->numGroups - 1;
+        }
+        ad->groupOf[r] = g;
+    }
+
+    for (int a = 0; a < ad->numAggrs; a++)
+    {
+        RM_AggrFunc f = ad->aggrs[a].func;
+        int attr = ad->aggrs[a].attrNum;
+        int off = (f == RM_AGGR_COUNT) ? 0 : sc->attrOffsets[attr];
+        int width = (f == RM_AGGR_COUNT) ? 0 : getAttrSize(sc, attr);
+        DataType dt = (f == RM_AGGR_COUNT) ? DT_INT : sc->dataTypes[attr];
+
+        for (int r = 0; r < n; r++)
+        {
+            if (ad->groupOf[r] < 0)
+                continue;
+            AggrAcc *acc = GROUP_ACC(ad, ad->groupOf[r], a);
+            const char *val = ad->batch + (size_t) r * ad->inSize + off;
+
+            acc->count++;
+            switch (f)
+            {
+                case RM_AGGR_COUNT:
+                    break;
+                case RM_AGGR_SUM:
+                case RM_AGGR_AVG:
+                    if (dt == DT_INT)
+                    {
+                        int v;
+                        memcpy(&v, val, sizeof(int));
+                        acc->isum += v;
+                    }
+                    else
+                    {
+                        float v;
+                        memcpy(&v, val, sizeof(float));
+                        acc->fsum += v;
+                    }
+                    break;
+                case RM_AGGR_MIN:
+                    if (compareRaw(dt, val, acc->minMax, width) < 0)
+                        memcpy(acc->minMax, val, width);
+                    break;
+                case RM_AGGR_MAX:
+                    if (compareRaw(dt, val, acc->minMax, width) > 0)
+                        memcpy(acc->minMax, val, width);
+                    break;
+            }
+        }
+    }
+    return RC_OK;
+}
+
+/*
+ * loadPartition
+ * -------------
+ * Replaced the groups in memory by those of the next non-empty partition.
+ * Returned RC_RM_NO_MORE_TUPLES when there was none.
+ */
+static RC loadPartition(AggrData *ad)
+{
+    RC rc;
+
+    resetGroups(ad);
+    while (++ad->part < AGGR_PARTITIONS)
+    {
+        RM_Spill *sp = &ad->parts[ad->part];
+        if (sp->numTuples == 0)
+            continue;
+        if ((rc = rmSpillRewind(sp)) != RC_OK)
+            return rc;
+
+        while (sp->remaining > 0)
+        {
+            int n = 0;
+            RID id;
+            while (n < RM_AGGR_BATCH && sp->remaining > 0)
+            {
+                if ((rc = rmSpillReadTuple(sp, &id, ad->batch + (size_t) n * ad->inSize, ad->inSize)) != RC_OK)
+                    return rc;
+                n++;
+            }
+            if ((rc = aggregateBatch(ad, n, false)) != RC_OK)
+                return rc;
+        }
+        return RC_OK;
+    }
+    return RC_RM_NO_MORE_TUPLES;
+}
+
+/* --------------------------------------------------------------------------
+   Aggregation interface
+   -------------------------------------------------------------------------- */
+
+/*
+ * outputSchema
+ * ------------
+ * Built the schema of the group records: the group attributes under their
+ * own names (and as the key), then "count", "sum_<attr>", "min_<attr>", ...
+ */
+static Schema *outputSchema(AggrData *ad)
+{
+    static const char *prefix[] = { "count", "sum_", "min_", "max_", "avg_" };
+    Schema *in = ad->inSchema;
+    int n = ad->numGroupAttrs + ad->numAggrs;
+    char **names = (char **) malloc(n * sizeof(char *));
+    DataType *types = (DataType *) malloc(n * sizeof(DataType));
+    int *lengths = (int *) malloc(n * sizeof(int));
+    int *keys = (ad->numGroupAttrs > 0) ? (int *) malloc(ad->numGroupAttrs * sizeof(int)) : NULL;
+
+    for (int i = 0; i < ad->numGroupAttrs; i++)
+    {
+        int attr = ad->groupAttrs[i];
+        names[i]   = strdup(in->attrNames[attr]);
+        types[i]   = in->dataTypes[attr];
+        lengths[i] = in->typeLength[attr];
+        keys[i]    = i;
+    }
+    for (int a = 0; a < ad->numAggrs; a++)
+    {
+        int i = ad->numGroupAttrs + a;
+        RM_AggrFunc f = ad->aggrs[a].func;
+        const char *attrName = (f == RM_AGGR_COUNT) ? "" : in->attrNames[ad->aggrs[a].attrNum];
+
+        names[i] = (char *) malloc(strlen(prefix[f]) + strlen(attrName) + 1);
+        sprintf(names[i], "%s%s", prefix[f], attrName);
+        lengths[i] = 0;
+        switch (f)
+        {
+            case RM_AGGR_COUNT: types[i] = DT_INT; break;
+            case RM_AGGR_AVG:   types[i] = DT_FLOAT; break;
+            default:
+                types[i]   = in->dataTypes[ad->aggrs[a].attrNum];
+                lengths[i] = in->typeLength[ad->aggrs[a].attrNum];
+                break;
+        }
+    }
+    return createSchema(n, names, types, lengths, ad->numGroupAttrs, keys);
+}
+
+/*
+ * freeAggrData
+ * ------------
+ * Released everything an aggregation held, removing its partition files.
+ */
+static void freeAggrData(AggrData *ad)
+{
+    if (ad->parts != NULL)
+    {
+        for (int i = 0; i < AGGR_PARTITIONS; i++)
+            rmSpillClose(&ad->parts[i]);
+        free(ad->parts);
+    }
+    free(ad->groupAttrs);
+    free(ad->aggrs);
+    free(ad->accOff);
+    free(ad->states);
+    free(ad->buckets);
+    free(ad->batch);
+    free(ad->keys);
+    free(ad->hashes);
+    free(ad->groupOf);
+    free(ad);
+}
+
+/*
+ * expectedMask
+ * ------------
+ * Sized the bucket array for the number of groups the table statistics
+ * expected (the product of the group attributes' distinct counts, at most one
+ * group per tuple), so it did not have to grow while the input was read. The
+ * buckets were kept to an eighth of the budget; without statistics the array
+ * started at 128 buckets.
+ */
+static unsigned int expectedMask(AggrData *ad, RM_TableData *rel)
+{
+    double groups = 1;
+    for (int i = 0; i < ad->numGroupAttrs; i++)
+    {
+        RM_AttrStats st;
+        if (getAttrStats(rel, ad->groupAttrs[i], &st) != RC_OK)
+            return 127;
+        groups *= (st.ndv > 1) ? st.ndv : 1;
+    }
+    if (groups > getNumTuples(rel))
+        groups = getNumTuples(rel);
+
+    size_t buckets = 128;
+    while (buckets < 2 * groups && 2 * buckets * sizeof(AggrBucket) <= ad->budget / 8)
+        buckets *= 2;
+    return (unsigned int) buckets - 1;
+}
+
+/*
+ * startAggregation
+ * ----------------
+ * Read an open scan to its end and aggregated it by the group attributes.
+ * memoryBudget limited the bytes of group states kept in memory (0 meant
+ * RM_AGGR_DEFAULT_MEMORY). SUM and AVG needed int or float attributes. An
+ * analyzed table let the hash table start at the size the groups needed.
+ */
+RC startAggregation(RM_ScanHandle *scan, int numGroupAttrs, int *groupAttrs,
+                    int numAggrs, RM_AggrSpec *aggrs, int memoryBudget, RM_AggrHandle *aggr)
+{
+    Schema *sc = scan->rel->schema;
+    RC rc;
+
+    for (int i = 0; i < numGroupAttrs; i++)
+    {
+        if (groupAttrs[i] < 0 || groupAttrs[i] >= sc->numAttr)
+            return RC_RM_NO_SUCH_ATTR;
+        if (sc->dataTypes[groupAttrs[i]] == DT_BLOB)
+            return RC_RM_BAD_BLOB_ATTR;
+    }
+    for (int a = 0; a < numAggrs; a++)
+    {
+        if (aggrs[a].func == RM_AGGR_COUNT)
+            continue;
+        if (aggrs[a].attrNum < 0 || aggrs[a].attrNum >= sc->numAttr)
+            return RC_RM_NO_SUCH_ATTR;
+        DataType dt = sc->dataTypes[aggrs[a].attrNum];
+        if (dt == DT_BLOB)
+            return RC_RM_BAD_BLOB_ATTR;
+        if ((aggrs[a].func == RM_AGGR_SUM || aggrs[a].func == RM_AGGR_AVG) && dt != DT_INT && dt != DT_FLOAT)
+            return RC_RM_UNKOWN_DATATYPE;
+    }
+
+    AggrData *ad = (AggrData *) calloc(1, sizeof(AggrData));
+    if (ad == NULL)
+        return RC_MEMORY_ALLOCATION_ERROR;
+    ad->inSchema      = sc;
+    ad->inSize        = getRecordSize(sc);
+    ad->numGroupAttrs = numGroupAttrs;
+    ad->groupAttrs    = (int *) malloc((numGroupAttrs + 1) * sizeof(int));
+    if (numGroupAttrs > 0)
+        memcpy(ad->groupAttrs, groupAttrs, numGroupAttrs * sizeof(int));
+    ad->numAggrs      = numAggrs;
+    ad->aggrs         = (RM_AggrSpec *) malloc((numAggrs + 1) * sizeof(RM_AggrSpec));
+    if (numAggrs > 0)
+        memcpy(ad->aggrs, aggrs, numAggrs * sizeof(RM_AggrSpec));
+    ad->budget        = (memoryBudget > 0) ? (size_t) memoryBudget : RM_AGGR_DEFAULT_MEMORY;
+    ad->part          = -1;
+
+    // State layout: key, then 8-byte aligned accumulators
+    for (int i = 0; i < numGroupAttrs; i++)
+        ad->keySize += getAttrSize(sc, groupAttrs[i]);
+    ad->accOff = (int *) malloc((numAggrs + 1) * sizeof(int));
+    ad->stateSize = (ad->keySize + 7) & ~7;
+    for (int a = 0; a < numAggrs; a++)
+    {
+        int extra = 0;
+        if (aggrs[a].func == RM_AGGR_MIN || aggrs[a].func == RM_AGGR_MAX)
+            extra = getAttrSize(sc, aggrs[a].attrNum);
+        ad->accOff[a] = ad->stateSize;
+        ad->stateSize += ((int) sizeof(AggrAcc) + extra + 7) & ~7;
+    }
+    if (ad->stateSize == 0)
+        ad->stateSize = 8;
+
+    ad->mask    = expectedMask(ad, scan->rel);
+    ad->buckets = (AggrBucket *) malloc((ad->mask + 1) * sizeof(AggrBucket));
+    ad->batch   = (char *) malloc((size_t) RM_AGGR_BATCH * ad->inSize);
+    ad->keys    = (char *) malloc((size_t) RM_AGGR_BATCH * ad->keySize + 1);
+    ad->hashes  = (unsigned int *) malloc(RM_AGGR_BATCH * sizeof(unsigned int));
+    ad->groupOf = (int *) malloc(RM_AGGR_BATCH * sizeof(int));
+    resetGroups(ad);
+
+    // Read the input a batch at a time
+    while (true)
+    {
+        int n = 0;
+        Record rec;
+        while (n < RM_AGGR_BATCH)
+        {
+            rec.data = ad->batch + (size_t) n * ad->inSize;
+            if ((rc = next(scan, &rec)) != RC_OK)
+                break;
+            n++;
+        }
+        if (rc != RC_OK && rc != RC_RM_NO_MORE_TUPLES)
+            break;
+        if (n > 0 && (rc = aggregateBatch(ad, n, true)) != RC_OK)
+            break;
+        if (n < RM_AGGR_BATCH)
+        {
+            rc = RC_OK;
+            break;
+        }
+    }
+
+    // Without group attributes there was exactly one group, even for no input
+    if (rc == RC_OK && numGroupAttrs == 0 && ad->numGroups == 0)
+    {
+        unsigned int slot;
+        memset(ad->batch, 0, ad->inSize);
+        findGroup(ad, ad->keys, hashKey(ad->keys, 0), &slot);
+        rc = addGroup(ad, ad->keys, hashKey(ad->keys, 0), slot, ad->batch);
+    }
+    if (rc != RC_OK)
+    {
+        freeAggrData(ad);
+        return rc;
+    }
+
+    aggr->schema = outputSchema(ad);
+    aggr->mgmtData = ad;
+    return RC_OK;
+}
+
+/*
+ * nextGroup
+ * ---------
+ * Returned the next group as a record of aggr->schema (created by the caller
+ * with createRecord), or RC_RM_NO_MORE_TUPLES. Groups came in no particular
+ * order.
+ */
+RC nextGroup(RM_AggrHandle *aggr, Record *group)
+{
+    AggrData *ad = (AggrData *) aggr->mgmtData;
+    Schema *out = aggr->schema;
+    RC rc;
+
+    while (ad->emitPos >= ad->numGroups)
+    {
+        if (ad->parts == NULL || ad->part >= AGGR_PARTITIONS)
+            return RC_RM_NO_MORE_TUPLES;
+        if ((rc = loadPartition(ad)) != RC_OK)
+            return rc;
+    }
+
+    int g = ad->emitPos++;
+    memcpy(group->data, GROUP_STATE(ad, g), ad->keySize);
+    group->id.page = -1;
+    group->id.slot = -1;
+
+    for (int a = 0; a < ad->numAggrs; a++)
+    {
+        AggrAcc *acc = GROUP_ACC(ad, g, a);
+        int outAttr = ad->numGroupAttrs + a;
+        bool isInt = (ad->aggrs[a].func != RM_AGGR_COUNT
+                      && ad->inSchema->dataTypes[ad->aggrs[a].attrNum] == DT_INT);
+        Value v;
+
+        switch (ad->aggrs[a].func)
+        {
+            case RM_AGGR_COUNT:
+                v.dt = DT_INT;
+                v.v.intV = (int) acc->count;
+                break;
+            case RM_AGGR_SUM:
+                v.dt = out->dataTypes[outAttr];
+                if (isInt)
+                    v.v.intV = (int) acc->isum;
+                else
+                    v.v.floatV = (float) acc->fsum;
+                break;
+            case RM_AGGR_AVG:
+                v.dt = DT_FLOAT;
+                v.v.floatV = (acc->count == 0) ? 0.0f
+                           : (float) ((isInt ? (double) acc->isum : acc->fsum) / acc->count);
+                break;
+            case RM_AGGR_MIN:
+            case RM_AGGR_MAX:
+                // Already in record format
+                memcpy(group->data + out->attrOffsets[outAttr], acc->minMax,
+                       out->attrOffsets[outAttr + 1] - out->attrOffsets[outAttr]);
+                continue;
+        }
+        setAttr(group, out, outAttr, &v);
+    }
+    return RC_OK;
+}
+
+/*
+ * closeAggregation
+ * ----------------
+ * Freed the aggregation, its output schema and its partition files. The
+ * scan stayed open.
+ */
+RC closeAggregation(RM_AggrHandle *aggr)
+{
+    if (aggr->mgmtData != NULL)
+        freeAggrData((AggrData *) aggr->mgmtData);
+    freeSchema(aggr->schema);
+    aggr->mgmtData = NULL;
+    aggr->schema = NULL;
+    return RC_OK;
+}
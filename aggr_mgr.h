@@ -0,0 +1,53 @@
+#ifndef AGGR_MGR_H
+#define AGGR_MGR_H
+
+#include "dberror.h"
+#include "record_mgr.h"
+
+/*
+ * Grouped aggregation over a record manager scan.
+ *
+ * startAggregation read a scan the caller had already started to its end and
+ * grouped the records by the raw values of the group attributes (none meant
+ * one group over all records, returned even for an empty input). Each group
+ * came back from nextGroup as one record of aggr->schema: the group attributes
+ * in the given order, then one attribute per aggregate.
+ *
+ * Aggregate results took these types: COUNT DT_INT, SUM the input type (int
+ * or float), AVG DT_FLOAT, MIN and MAX the input type. DT_BLOB attributes
+ * were neither grouped nor aggregated (RC_RM_BAD_BLOB_ATTR).
+ */
+
+typedef enum RM_AggrFunc {
+	RM_AGGR_COUNT = 0,
+	RM_AGGR_SUM = 1,
+	RM_AGGR_MIN = 2,
+	RM_AGGR_MAX = 3,
+	RM_AGGR_AVG = 4
+} RM_AggrFunc;
+
+typedef struct RM_AggrSpec
+{
+	RM_AggrFunc func;
+	int attrNum;        // input attribute (ignored by COUNT)
+} RM_AggrSpec;
+
+// Bookkeeping for aggregations
+typedef struct RM_AggrHandle
+{
+	Schema *schema;     // schema of the returned group records
+	void *mgmtData;
+} RM_AggrHandle;
+
+// memory for the groups when the caller passed 0
+#define RM_AGGR_DEFAULT_MEMORY (1 << 20)
+
+// input records hashed and aggregated together
+#define RM_AGGR_BATCH 256
+
+extern RC startAggregation (RM_ScanHandle *scan, int numGroupAttrs, int *groupAttrs,
+		int numAggrs, RM_AggrSpec *aggrs, int memoryBudget, RM_AggrHandle *aggr);
+extern RC nextGroup (RM_AggrHandle *aggr, Record *group);
+extern RC closeAggregation (RM_AggrHandle *aggr);
+
+#endif // AGGR_MGR_H
@@ -1,86 +1,558 @@
 /*
  * btree_mgr.c
  *
- * A minimal B+ tree manager that uses a straightforward sequential allocation model.
- *   - Page 0 contains the maximum keys per node (the "fan out" or node limit).
- *   - Node pages start at page 1. Each node page begins with a boolean that indicates
- *     whether the node has one key (false) or two keys (true). The rest of the page
- *     stores the node details.
+ * A B+ tree index stored in its own page file.
+ *   - Page 0 holds the index metadata (BT_Meta): order, key type and size,
+ *     root page, node and entry counts.
+ *   - Every other page is one node. A node starts with a BT_NodeHeader and then
+ *     holds up to n keys, the RID that goes with each key, and (inner nodes
+ *     only) n + 1 child page numbers. Leaves are chained left to right through
+ *     'next', so scans never go back up the tree.
  *
- * Global variables:
- *   HighestPage  - Tracks the largest page number allocated (1-based for nodes)
- *   gScanIndex    - Tracks the current index into the sorted key list while scanning
+ * Keys are stored in a fixed-width byte format (ints, floats, bools, or zero
+ * padded strings of keyLength bytes). A unique tree orders entries by key; a
+ * tree created with allowDuplicates orders them by (key, RID), so the same key
+ * can be stored once per record and a single entry can still be deleted.
+ * Inner nodes keep the full (key, RID) of their separators for that reason.
  *
- * Only DT_INT keys are supported.
+ * Full nodes are split on insert. Deletes only remove the entry from its leaf;
+ * underfull nodes are not merged, since the separators above them still route
+ * searches correctly and scans step over empty leaves.
  *
- * Author: Apurv Gaikwad, Nishant Dalvi, Satyam Borade
-
- */
-
- #include <stdio.h>
- #include <stdlib.h>
- #include <string.h>
- #include "buffer_mgr.h"
- #include "storage_mgr.h"
- #include "dberror.h"
- #include "btree_mgr.h"
- #include "tables.h"
- #include "expr.h"
- 
- /* Global counters used in this B+ tree manager */
- int gHighestPage = 0;         /* The highest node page number allocated (1-based) */
- int gScanIndex   = 0;         /* Position in the sorted key list during a tree scan */
- const RID RID_NONE = { -1, -1 }; /* A sentinel RID for invalid references */
- 
- /*
-  * NodeInPage:
-  * Describes how a node is represented on disk after an initial bool flag.
-  *
-  * Fields:
-  *   parentIdx  : Page number of this node's parent (-1 if root)
-  *   nodeLeafBit: True if the node is a leaf; in this design, all nodes are leaves
-  *   leftSlot   : RID tied to the first key
-  *   leftKey    : The first integer key; -1 if unused
-  *   rightSlot  : RID for the second key (if used)
-  *   rightKey   : The second integer key; -1 if unused
-  *   chainLink  : Placeholder for leaf chaining (unused)
-  */
- typedef struct NodeInPage {
-     int  parentIdx;
-     bool nodeLeafBit;
-     RID  leftSlot;
-     int  leftKey;
-     RID  rightSlot;
-     int  rightKey;
-     RID  chainLink;
- } NodeInPage;
- 
- /*
-  * CoreIndex:
-  * Maintains metadata for the B+ tree and references buffer management objects.
-  * A pointer to CoreIndex is stored in BTreeHandle->mgmtData.
-  *
-  * Fields:
-  *   poolRef  : A pointer to the buffer pool
-  *   pageRef  : A page handle for read/write operations
-  *   topNode  : The page number of the root node (initialized on the first insertion)
-  *   keysTotal: The total count of keys in the tree
-  *   nodeLimit: The maximum keys allowed per node (loaded from page 0)
-  */
- typedef struct CoreIndex {
-     BM_BufferPool *poolRef;
-     BM_PageHandle *pageRef;
-     int topNode;
-     int keysTotal;
-     int nodeLimit;
- } CoreIndex;
- 
- /* ========================= INDEX MANAGER FUNCTIONS ========================= */
- 
- /* initIndexManager: prepares storage management. */
- RC initIndexManager(void *unused) {
+ * All state lives in the BTreeHandle, so several trees can be open at once.
+ *
+ * Author: Apurv Gaikwad, Nishant Dalvi, Satyam Borade
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include "buffer_mgr.h"
+#include "storage_mgr.h"
+#include "dberror.h"
+#include "btree_mgr.h"
+#include "tables.h"
+#include "expr.h"
+
+/* The deepest tree we expect; with n >= 2 this covers far more keys than fit in a file. */
+#define BT_MAX_DEPTH 32
+
+/*
+ * BT_Meta:
+ * The contents of page 0.
+ */
+typedef struct BT_Meta {
+    int n;               /* maximum keys per node */
+    int keyType;         /* DataType of the keys */
+    int keyLength;       /* declared length of string keys */
+    int allowDuplicates; /* entries ordered by (key, RID) instead of key */
+    int root;            /* page of the root node, -1 while the tree is empty */
+    int numNodes;
+    int numEntries;
+    int numPages;        /* pages in the file, including page 0 */
+} BT_Meta;
+
+/*
+ * BT_NodeHeader:
+ * The start of every node page.
+ */
+typedef struct BT_NodeHeader {
+    int isLeaf;
+    int numKeys;
+    int next;            /* right sibling of a leaf, -1 for the last leaf */
+} BT_NodeHeader;
+
+/*
+ * CoreIndex:
+ * Per-handle state, stored in BTreeHandle->mgmtData.
+ *
+ * Fields:
+ *   poolRef : the buffer pool of the index file
+ *   meta    : an in-memory copy of page 0, written back on close
+ *   keySize : bytes per stored key
+ *   ridsOff, childOff: where the RID and child arrays start on a node page
+ *   logged  : a write-ahead log was attached, so page 0 was rewritten (and
+ *             logged) after every change instead of only on close
+ */
+typedef struct CoreIndex {
+    BM_BufferPool *poolRef;
+    BT_Meta meta;
+    bool logged;
+    int keySize;
+    int ridsOff;
+    int childOff;
+} CoreIndex;
+
+/*
+ * BT_ScanData:
+ * Position and bounds of a running tree scan, stored in BT_ScanHandle->mgmtData.
+ */
+typedef struct BT_ScanData {
+    int page;            /* current leaf, -1 when the scan is done */
+    int pos;             /* next entry within that leaf */
+    bool hasLow, lowInclusive;
+    bool hasHigh, highInclusive;
+    char *low;
+    char *high;
+} BT_ScanData;
+
+/* ========================= NODE LAYOUT HELPERS ========================= */
+
+#define NODE_HDR(data)          ((BT_NodeHeader *) (data))
+#define NODE_KEY(ci, data, i)   ((data) + sizeof(BT_NodeHeader) + (size_t) (i) * (ci)->keySize)
+#define NODE_RID(ci, data, i)   ((RID *) ((data) + (ci)->ridsOff) + (i))
+#define NODE_CHILD(ci, data, i) ((int *) ((data) + (ci)->childOff) + (i))
+
+/*
+ * keySizeFor:
+ * Returned how many bytes a key of the given type took up in a node.
+ */
+static int keySizeFor(DataType keyType, int keyLength) {
+    switch (keyType) {
+        case DT_INT:    return sizeof(int);
+        case DT_FLOAT:  return sizeof(float);
+        case DT_BOOL:   return sizeof(int);
+        case DT_STRING: return keyLength;
+        case DT_BLOB:   return 0;   // large objects were not indexed
+    }
+    return 0;
+}
+
+/*
+ * getMaxBtreeOrder:
+ * Returned the largest n for which a node with these keys still fit on a page.
+ */
+int getMaxBtreeOrder(DataType keyType, int keyLength) {
+    int keySize = keySizeFor(keyType, keyLength);
+    if (keySize <= 0)
+        return 0;
+    return (PAGE_SIZE - (int) sizeof(BT_NodeHeader) - (int) sizeof(int))
+         / (keySize + (int) sizeof(RID) + (int) sizeof(int));
+}
+
+/*
+ * setLayout:
+ * Computed the node array offsets for the tree's order and key size.
+ */
+static void setLayout(CoreIndex *ci) {
+    ci->keySize  = keySizeFor((DataType) ci->meta.keyType, ci->meta.keyLength);
+    ci->ridsOff  = (int) sizeof(BT_NodeHeader) + ci->meta.n * ci->keySize;
+    ci->childOff = ci->ridsOff + ci->meta.n * (int) sizeof(RID);
+}
+
+/*
+ * encodeKey:
+ * Brought a Value into the stored key format. Returned false if the value had
+ * the wrong type.
+ */
+static bool encodeKey(CoreIndex *ci, Value *key, char *out) {
+    if ((int) key->dt != ci->meta.keyType)
+        return false;
+    memset(out, 0, ci->keySize);
+    switch (key->dt) {
+        case DT_INT:    memcpy(out, &key->v.intV, sizeof(int)); break;
+        case DT_FLOAT:  memcpy(out, &key->v.floatV, sizeof(float)); break;
+        case DT_BOOL:   { int b = (key->v.boolV != 0); memcpy(out, &b, sizeof(int)); } break;
+        case DT_STRING: strncpy(out, key->v.stringV, ci->keySize); break;
+        case DT_BLOB:   return false;
+    }
+    return true;
+}
+
+/*
+ * compareKeys:
+ * Compared two stored keys, returning <0, 0 or >0.
+ */
+static int compareKeys(CoreIndex *ci, const char *a, const char *b) {
+    switch ((DataType) ci->meta.keyType) {
+        case DT_INT:
+        case DT_BOOL: {
+            int x, y;
+            memcpy(&x, a, sizeof(int));
+            memcpy(&y, b, sizeof(int));
+            return (x > y) - (x < y);
+        }
+        case DT_FLOAT: {
+            float x, y;
+            memcpy(&x, a, sizeof(float));
+            memcpy(&y, b, sizeof(float));
+            return (x > y) - (x < y);
+        }
+        case DT_STRING:
+            return strncmp(a, b, ci->keySize);
+        case DT_BLOB:
+            break;
+    }
+    return 0;
+}
+
+/*
+ * compareEntries:
+ * Compared (key, rid) pairs. RIDs only broke ties in trees with duplicates.
+ */
+static int compareEntries(CoreIndex *ci, const char *keyA, RID ridA, const char *keyB, RID ridB) {
+    int c = compareKeys(ci, keyA, keyB);
+    if (c != 0 || !ci->meta.allowDuplicates)
+        return c;
+    if (ridA.page != ridB.page)
+        return (ridA.page > ridB.page) - (ridA.page < ridB.page);
+    return (ridA.slot > ridB.slot) - (ridA.slot < ridB.slot);
+}
+
+/*
+ * writeMeta:
+ * Stored the in-memory metadata on page 0. Without a log the page was forced
+ * to disk; with one, the log record written on unpin made it durable.
+ */
+static RC writeMeta(CoreIndex *ci) {
+    BM_PageHandle page;
+    RC rc = pinPage(ci->poolRef, &page, 0);
+    if (rc != RC_OK)
+        return rc;
+    memcpy(page.data, &ci->meta, sizeof(BT_Meta));
+    markDirty(ci->poolRef, &page);
+    rc = unpinPage(ci->poolRef, &page);
+    if (rc != RC_OK || ci->logged)
+        return rc;
+    return forcePage(ci->poolRef, &page);
+}
+
+/*
+ * logMeta:
+ * Rewrote page 0 after a successful change of a logged tree, so recovery
+ * found the root and counts that matched the redone nodes.
+ */
+static RC logMeta(CoreIndex *ci, RC rc) {
+    if (rc != RC_OK || !ci->logged)
+        return rc;
+    return writeMeta(ci);
+}
+
+/*
+ * newNode:
+ * Appended a node page to the file and left it pinned in 'page'.
+ */
+static RC newNode(CoreIndex *ci, BM_PageHandle *page, bool isLeaf, int *pageNum) {
+    *pageNum = ci->meta.numPages++;
+    RC rc = pinPage(ci->poolRef, page, *pageNum);
+    if (rc != RC_OK)
+        return rc;
+    memset(page->data, 0, PAGE_SIZE);
+    NODE_HDR(page->data)->isLeaf  = isLeaf;
+    NODE_HDR(page->data)->numKeys = 0;
+    NODE_HDR(page->data)->next    = -1;
+    ci->meta.numNodes++;
+    return RC_OK;
+}
+
+/*
+ * descend:
+ * Walked from the root to the leaf where (key, rid) belonged: in every inner
+ * node, the child after the last separator that was <= the probe. The pages
+ * on the way were recorded in path (the leaf last); returned the depth.
+ */
+static int descend(CoreIndex *ci, const char *key, RID rid, int *path) {
+    BM_PageHandle page;
+    int depth = 0;
+    int pageNum = ci->meta.root;
+
+    while (pageNum > 0 && depth < BT_MAX_DEPTH) {
+        path[depth++] = pageNum;
+        if (pinPage(ci->poolRef, &page, pageNum) != RC_OK)
+            return -1;
+        BT_NodeHeader *hdr = NODE_HDR(page.data);
+        if (hdr->isLeaf) {
+            unpinPage(ci->poolRef, &page);
+            break;
+        }
+        int i = 0;
+        while (i < hdr->numKeys
+               && compareEntries(ci, NODE_KEY(ci, page.data, i), *NODE_RID(ci, page.data, i), key, rid) <= 0)
+            i++;
+        pageNum = *NODE_CHILD(ci, page.data, i);
+        unpinPage(ci->poolRef, &page);
+    }
+    return depth;
+}
+
+/*
+ * lowestRid:
+ * A RID smaller than every real one, so a (key, lowestRid) probe led to the
+ * first entry with that key.
+ */
+static RID lowestRid(void) {
+    RID r = { INT_MIN, INT_MIN };
+    return r;
+}
+
+/* ====================== INSERTION ====================== */
+
+/*
+ * insertIntoParent:
+ * After the node at path[level] split, added the separator (key, rid) and the
+ * new right sibling to its parent, splitting further up as needed. A split
+ * root got a new root above it.
+ */
+static RC insertIntoParent(CoreIndex *ci, int *path, int level, char *key, RID rid, int rightPage) {
+    BM_PageHandle page;
+    RC rc;
+    int n = ci->meta.n;
+
+    if (level == 0) {
+        int rootPage;
+        rc = newNode(ci, &page, false, &rootPage);
+        if (rc != RC_OK)
+            return rc;
+        NODE_HDR(page.data)->numKeys = 1;
+        memcpy(NODE_KEY(ci, page.data, 0), key, ci->keySize);
+        *NODE_RID(ci, page.data, 0)   = rid;
+        *NODE_CHILD(ci, page.data, 0) = path[0];
+        *NODE_CHILD(ci, page.data, 1) = rightPage;
+        markDirty(ci->poolRef, &page);
+        unpinPage(ci->poolRef, &page);
+        ci->meta.root = rootPage;
+        return RC_OK;
+    }
+
+    int parent = path[level - 1];
+    rc = pinPage(ci->poolRef, &page, parent);
+    if (rc != RC_OK)
+        return rc;
+    char *data = page.data;
+    BT_NodeHeader *hdr = NODE_HDR(data);
+
+    // Gathered the keys and children with the new separator in place
+    char *keys  = (char *) malloc((size_t) (n + 1) * ci->keySize);
+    RID *rids   = (RID *) malloc((n + 1) * sizeof(RID));
+    int *childs = (int *) malloc((n + 2) * sizeof(int));
+    int pos = 0;
+    while (pos < hdr->numKeys && compareEntries(ci, NODE_KEY(ci, data, pos), *NODE_RID(ci, data, pos), key, rid) <= 0)
+        pos++;
+    for (int i = 0, j = 0; i <= hdr->numKeys; i++, j++) {
+        if (i == pos) {
+            memcpy(keys + (size_t) j * ci->keySize, key, ci->keySize);
+            rids[j] = rid;
+            j++;
+        }
+        if (i < hdr->numKeys) {
+            memcpy(keys + (size_t) j * ci->keySize, NODE_KEY(ci, data, i), ci->keySize);
+            rids[j] = *NODE_RID(ci, data, i);
+        }
+    }
+    for (int i = 0, j = 0; i <= hdr->numKeys; i++, j++) {
+        childs[j] = *NODE_CHILD(ci, data, i);
+        if (i == pos)
+            childs[++j] = rightPage;
+    }
+    int total = hdr->numKeys + 1;
+
+    if (total <= n) {
+        memcpy(NODE_KEY(ci, data, 0), keys, (size_t) total * ci->keySize);
+        memcpy(NODE_RID(ci, data, 0), rids, total * sizeof(RID));
+        memcpy(NODE_CHILD(ci, data, 0), childs, (total + 1) * sizeof(int));
+        hdr->numKeys = total;
+        markDirty(ci->poolRef, &page);
+        unpinPage(ci->poolRef, &page);
+        rc = RC_OK;
+    } else {
+        // The middle separator moved up; the left half stayed, the right half moved
+        int mid = total / 2;
+        memcpy(NODE_KEY(ci, data, 0), keys, (size_t) mid * ci->keySize);
+        memcpy(NODE_RID(ci, data, 0), rids, mid * sizeof(RID));
+        memcpy(NODE_CHILD(ci, data, 0), childs, (mid + 1) * sizeof(int));
+        hdr->numKeys = mid;
+        markDirty(ci->poolRef, &page);
+        unpinPage(ci->poolRef, &page);
+
+        BM_PageHandle right;
+        int rightNum;
+        rc = newNode(ci, &right, false, &rightNum);
+        if (rc == RC_OK) {
+            int rightKeys = total - mid - 1;
+            memcpy(NODE_KEY(ci, right.data, 0), keys + (size_t) (mid + 1) * ci->keySize, (size_t) rightKeys * ci->keySize);
+            memcpy(NODE_RID(ci, right.data, 0), rids + mid + 1, rightKeys * sizeof(RID));
+            memcpy(NODE_CHILD(ci, right.data, 0), childs + mid + 1, (rightKeys + 1) * sizeof(int));
+            NODE_HDR(right.data)->numKeys = rightKeys;
+            markDirty(ci->poolRef, &right);
+            unpinPage(ci->poolRef, &right);
+
+            rc = insertIntoParent(ci, path, level - 1, keys + (size_t) mid * ci->keySize, rids[mid], rightNum);
+        }
+    }
+
+    free(keys);
+    free(rids);
+    free(childs);
+    return rc;
+}
+
+/*
+ * insertEncoded:
+ * Inserted a stored-format key with its RID. Returned RC_IM_KEY_ALREADY_EXISTS
+ * if the key (or, with duplicates, the same key and RID) was already there.
+ */
+static RC insertEncoded(CoreIndex *ci, char *key, RID rid) {
+    BM_PageHandle page;
+    int path[BT_MAX_DEPTH];
+    RC rc;
+    int n = ci->meta.n;
+
+    if (ci->meta.root < 1) {
+        int leaf;
+        rc = newNode(ci, &page, true, &leaf);
+        if (rc != RC_OK)
+            return rc;
+        unpinPage(ci->poolRef, &page);
+        ci->meta.root = leaf;
+    }
+
+    int depth = descend(ci, key, rid, path);
+    if (depth < 1)
+        return RC_ERROR;
+    int leafNum = path[depth - 1];
+    rc = pinPage(ci->poolRef, &page, leafNum);
+    if (rc != RC_OK)
+        return rc;
+    char *data = page.data;
+    BT_NodeHeader *hdr = NODE_HDR(data);
+
+    int pos = 0;
+    while (pos < hdr->numKeys && compareEntries(ci, NODE_KEY(ci, data, pos), *NODE_RID(ci, data, pos), key, rid) < 0)
+        pos++;
+    if (pos < hdr->numKeys && compareEntries(ci, NODE_KEY(ci, data, pos), *NODE_RID(ci, data, pos), key, rid) == 0) {
+        unpinPage(ci->poolRef, &page);
+        return RC_IM_KEY_ALREADY_EXISTS;
+    }
+
+    // Gathered the leaf entries with the new one in place
+    int total = hdr->numKeys + 1;
+    char *keys = (char *) malloc((size_t) total * ci->keySize);
+    RID *rids  = (RID *) malloc(total * sizeof(RID));
+    memcpy(keys, NODE_KEY(ci, data, 0), (size_t) pos * ci->keySize);
+    memcpy(rids, NODE_RID(ci, data, 0), pos * sizeof(RID));
+    memcpy(keys + (size_t) pos * ci->keySize, key, ci->keySize);
+    rids[pos] = rid;
+    memcpy(keys + (size_t) (pos + 1) * ci->keySize, NODE_KEY(ci, data, pos), (size_t) (hdr->numKeys - pos) * ci->keySize);
+    memcpy(rids + pos + 1, NODE_RID(ci, data, pos), (hdr->numKeys - pos) * sizeof(RID));
+
+    if (total <= n) {
+        memcpy(NODE_KEY(ci, data, 0), keys, (size_t) total * ci->keySize);
+        memcpy(NODE_RID(ci, data, 0), rids, total * sizeof(RID));
+        hdr->numKeys = total;
+        markDirty(ci->poolRef, &page);
+        unpinPage(ci->poolRef, &page);
+        rc = RC_OK;
+    } else {
+        // Split: the left leaf kept the larger half, the first right entry was copied up
+        int leftKeys  = (total + 1) / 2;
+        int rightKeys = total - leftKeys;
+        BM_PageHandle right;
+        int rightNum;
+        rc = newNode(ci, &right, true, &rightNum);
+        if (rc == RC_OK) {
+            memcpy(NODE_KEY(ci, right.data, 0), keys + (size_t) leftKeys * ci->keySize, (size_t) rightKeys * ci->keySize);
+            memcpy(NODE_RID(ci, right.data, 0), rids + leftKeys, rightKeys * sizeof(RID));
+            NODE_HDR(right.data)->numKeys = rightKeys;
+            NODE_HDR(right.data)->next    = hdr->next;
+            markDirty(ci->poolRef, &right);
+            unpinPage(ci->poolRef, &right);
+
+            memcpy(NODE_KEY(ci, data, 0), keys, (size_t) leftKeys * ci->keySize);
+            memcpy(NODE_RID(ci, data, 0), rids, leftKeys * sizeof(RID));
+            hdr->numKeys = leftKeys;
+            hdr->next    = rightNum;
+        }
+        markDirty(ci->poolRef, &page);
+        unpinPage(ci->poolRef, &page);
+
+        if (rc == RC_OK)
+            rc = insertIntoParent(ci, path, depth - 1, keys + (size_t) leftKeys * ci->keySize, rids[leftKeys], rightNum);
+    }
+
+    free(keys);
+    free(rids);
+    if (rc == RC_OK)
+        ci->meta.numEntries++;
+    return rc;
+}
+
+/* ====================== LOOKUP AND DELETION ====================== */
+
+/*
+ * seekEntry:
+ * Found the first entry whose key was >= key (and, if rid was given, whose
+ * (key, RID) matched exactly), following the leaf chain past empty leaves.
+ * Returned RC_IM_KEY_NOT_FOUND if there was no entry with an equal key;
+ * otherwise the leaf and position were returned for the caller.
+ */
+static RC seekEntry(CoreIndex *ci, char *key, RID *rid, int *leafOut, int *posOut) {
+    BM_PageHandle page;
+    int path[BT_MAX_DEPTH];
+
+    if (ci->meta.root < 1)
+        return RC_IM_KEY_NOT_FOUND;
+
+    int depth = descend(ci, key, (rid != NULL) ? *rid : lowestRid(), path);
+    if (depth < 1)
+        return RC_ERROR;
+
+    int leaf = path[depth - 1];
+    while (leaf > 0) {
+        RC rc = pinPage(ci->poolRef, &page, leaf);
+        if (rc != RC_OK)
+            return rc;
+        BT_NodeHeader *hdr = NODE_HDR(page.data);
+        for (int i = 0; i < hdr->numKeys; i++) {
+            int c = compareKeys(ci, NODE_KEY(ci, page.data, i), key);
+            if (c < 0)
+                continue;
+            if (c == 0 && rid != NULL) {
+                RID found = *NODE_RID(ci, page.data, i);
+                if (found.page != rid->page || found.slot != rid->slot)
+                    continue;
+            }
+            unpinPage(ci->poolRef, &page);
+            if (c > 0)
+                return RC_IM_KEY_NOT_FOUND;
+            *leafOut = leaf;
+            *posOut  = i;
+            return RC_OK;
+        }
+        int next = hdr->next;
+        unpinPage(ci->poolRef, &page);
+        leaf = next;
+    }
+    return RC_IM_KEY_NOT_FOUND;
+}
+
+/*
+ * removeAt:
+ * Deleted the entry at 'pos' of a leaf.
+ */
+static RC removeAt(CoreIndex *ci, int leaf, int pos) {
+    BM_PageHandle page;
+    RC rc = pinPage(ci->poolRef, &page, leaf);
+    if (rc != RC_OK)
+        return rc;
+    BT_NodeHeader *hdr = NODE_HDR(page.data);
+    int rest = hdr->numKeys - pos - 1;
+    memmove(NODE_KEY(ci, page.data, pos), NODE_KEY(ci, page.data, pos + 1), (size_t) rest * ci->keySize);
+    memmove(NODE_RID(ci, page.data, pos), NODE_RID(ci, page.data, pos + 1), rest * sizeof(RID));
+    hdr->numKeys--;
+    markDirty(ci->poolRef, &page);
+    unpinPage(ci->poolRef, &page);
+    ci->meta.numEntries--;
+    return RC_OK;
+}
+
+/* ========================= INDEX MANAGER FUNCTIONS ========================= */
+
+/* initIndexManager: prepares storage management. */
+RC initIndexManager(void *unused) {
     // Print a message indicating the index manager is starting up
-    printf("Initializing the minimal B+ tree manager.\n");
+    printf("Initializing the B+ tree manager.\n");
     // Initialize the underlying storage manager (for paging, files, etc.)
     initStorageManager();
     // Return success code
@@ -90,20 +562,35 @@
 /* shutdownIndexManager: no special teardown needed. */
 RC shutdownIndexManager() {
     // Print a message indicating the index manager is shutting down
-    printf("Shutting down the minimal B+ tree manager.\n");
+    printf("Shutting down the B+ tree manager.\n");
     // Return success code
     return RC_OK;
 }
 
 /*
  * createBtree:
- * Produces a page file named idxId and writes n (the node limit) into page 0.
- * Supports only DT_INT keys.
+ * Produces a page file named idxId for a tree of unique keys with up to n keys
+ * per node. String keys need createBtreeWithOptions, which knows their length.
  */
 RC createBtree(char *idxId, DataType keyType, int n) {
+    return createBtreeWithOptions(idxId, keyType, 0, n, false);
+}
+
+/*
+ * createBtreeWithOptions:
+ * Produces a page file named idxId and writes the tree metadata into page 0.
+ */
+RC createBtreeWithOptions(char *idxId, DataType keyType, int keyLength, int n, int allowDuplicates) {
     // Log creation of a new B-tree index file
     printf("Creating index file '%s'\n", idxId);
 
+    if (keySizeFor(keyType, keyLength) <= 0) {
+        printf("Error: Unsupported key type for an index.\n");
+        return RC_RM_UNKOWN_DATATYPE;
+    }
+    if (n < 2 || n > getMaxBtreeOrder(keyType, keyLength))
+        return RC_ORDER_TOO_HIGH_FOR_PAGE;
+
     // Create the underlying page file on disk
     RC rc = createPageFile(idxId);
     if (rc != RC_OK)
@@ -117,24 +604,21 @@ RC createBtree(char *idxId, DataType keyType, int n) {
         // Propagate error if open failed
         return rc;
 
-    // Ensure at least one page exists (page 0) in the file
-    ensureCapacity(1, &fileCtrl);
-
-    // Allocate a zeroed buffer of one page size
+    // Prepared the metadata of an empty tree
     SM_PageHandle pageBuf = calloc(PAGE_SIZE, sizeof(char));
-    // Verify that the requested key type is an integer
-    if (keyType != DT_INT) {
-        // Only integer keys are supported; print error and clean up
-        printf("Error: Only integer keys are allowed.\n");
-        free(pageBuf);
-        return RC_RM_UNKOWN_DATATYPE;
-    }
-
-    // Store the node limit 'n' into the first bytes of page 0
-    *((int *)pageBuf) = n;
+    BT_Meta meta;
+    meta.n               = n;
+    meta.keyType         = keyType;
+    meta.keyLength       = keyLength;
+    meta.allowDuplicates = allowDuplicates ? 1 : 0;
+    meta.root            = -1;
+    meta.numNodes        = 0;
+    meta.numEntries      = 0;
+    meta.numPages        = 1;
+    memcpy(pageBuf, &meta, sizeof(BT_Meta));
 
-    // Write the prepared page buffer into the current block (page 0)
-    rc = writeCurrentBlock(&fileCtrl, pageBuf);
+    // Write the prepared page buffer into page 0
+    rc = writeBlock(0, &fileCtrl, pageBuf);
     // Free the page buffer after writing
     free(pageBuf);
 
@@ -145,336 +629,343 @@ RC createBtree(char *idxId, DataType keyType, int n) {
     return rc;
 }
 
- 
- /*
-  * openBtree:
-  * Opens the B+ tree index file, initializes a buffer pool, and reads the node limit from page 0 (via page 1).
-  */
- RC openBtree(BTreeHandle **tree, char *idxId) {
-     printf("Opening the B+ tree index: %s\n", idxId);
-     CoreIndex *cindex = (CoreIndex *)malloc(sizeof(CoreIndex));
-     if (!cindex)
-         return RC_MEMORY_ALLOCATION_ERROR;
- 
-     cindex->poolRef   = MAKE_POOL();
-     cindex->pageRef   = MAKE_PAGE_HANDLE();
-     cindex->keysTotal = 0;
-     cindex->topNode   = 0;
- 
-     /* Setup buffer pool for up to 10 pages with FIFO replacement. */
-     initBufferPool(cindex->poolRef, idxId, 10, RS_FIFO, NULL);
- 
-     /* Pin page 1 to read the node limit from page 0 */
-     pinPage(cindex->poolRef, cindex->pageRef, 1);
-     cindex->nodeLimit = *((int *)cindex->pageRef->data);
-     printf("Index config: nodeLimit = %d\n", cindex->nodeLimit);
-     unpinPage(cindex->poolRef, cindex->pageRef);
- 
-     BTreeHandle *bh = (BTreeHandle *)malloc(sizeof(BTreeHandle));
-     if (!bh)
-         return RC_MEMORY_ALLOCATION_ERROR;
-     bh->keyType = DT_INT;
-     bh->idxId   = strdup(idxId);
-     bh->mgmtData= cindex;
-     *tree       = bh;
-     return RC_OK;
- }
- 
- /*
-  * closeBtree:
-  * Flushes changes, shuts down the buffer pool, frees memory, and resets global counters.
-  */
- RC closeBtree(BTreeHandle *tree) {
-     printf("Closing the B+ tree index.\n");
-     gHighestPage = 0;
-     gScanIndex   = 0;
- 
-     CoreIndex *cindex = (CoreIndex *)tree->mgmtData;
-     shutdownBufferPool(cindex->poolRef);
-     free(cindex->pageRef);
-     free(cindex->poolRef);
-     free(cindex);
-     free(tree->idxId);
-     free(tree);
-     return RC_OK;
- }
- 
- /*
-  * deleteBtree:
-  * Removes the index file from disk.
-  */
- RC deleteBtree(char *idxId) {
-     printf("Deleting B+ tree file: %s\n", idxId);
-     return (remove(idxId) != 0) ? RC_FILE_NOT_FOUND : RC_OK;
- }
- 
- /*
-  * getNumNodes:
-  * Returns how many node pages have been allocated (gHighestPage is zero-based).
-  */
- RC getNumNodes(BTreeHandle *tree, int *result) {
-     *result = gHighestPage + 1;
-     return RC_OK;
- }
- 
- /*
-  * getNumEntries:
-  * Returns how many keys exist in the index.
-  */
- RC getNumEntries(BTreeHandle *tree, int *result) {
-     CoreIndex *cindex = (CoreIndex *)tree->mgmtData;
-     *result = cindex->keysTotal;
-     return RC_OK;
- }
- 
- /*
-  * getKeyType:
-  * Returns the type of keys (DT_INT).
-  */
- RC getKeyType(BTreeHandle *tree, DataType *result) {
-     *result = DT_INT;
-     return RC_OK;
- }
- 
- /* ====================== INDEX ACCESS FUNCTIONS ====================== */
- 
- /*
-  * findKey:
-  * Looks for a key among pages 1..gHighestPage. Each node page starts with a bool flag, then the NodeInPage data.
-  * If the key matches leftKey or rightKey in a node, returns the corresponding RID.
-  */
- RC findKey(BTreeHandle *tree, Value *key, RID *result) {
-     int neededVal = key->v.intV;
-     CoreIndex *cindex = (CoreIndex *)tree->mgmtData;
-     for (int pg = 1; pg <= gHighestPage; pg++) {
-         pinPage(cindex->poolRef, cindex->pageRef, pg);
-         NodeInPage *nodeObj = (NodeInPage *)((char *)cindex->pageRef->data + sizeof(bool));
-         if ((nodeObj->leftKey == neededVal) || (nodeObj->rightKey == neededVal)) {
-             *result = (neededVal == nodeObj->leftKey) ? nodeObj->leftSlot : nodeObj->rightSlot;
-             unpinPage(cindex->poolRef, cindex->pageRef);
-             return RC_OK;
-         }
-         unpinPage(cindex->poolRef, cindex->pageRef);
-     }
-     return RC_IM_KEY_NOT_FOUND;
- }
- 
- /*
-  * insertKey:
-  * Appends a key-RID pair to the index. If no nodes exist (gHighestPage == 0), allocate page 1.
-  * If the last node is full (bool flag == true), allocate a fresh node page; else place the key in the second slot.
-  */
- RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
-     CoreIndex *cindex = (CoreIndex *)tree->mgmtData;
-     NodeInPage *nodeObj;
- 
-     if (gHighestPage == 0) {
-         gHighestPage     = 1;
-         cindex->topNode  = 1;
-         pinPage(cindex->poolRef, cindex->pageRef, gHighestPage);
-         *((bool *)cindex->pageRef->data) = false;  /* only one key is used */
-         nodeObj = (NodeInPage *)((char *)cindex->pageRef->data + sizeof(bool));
-         nodeObj->parentIdx  = -1;
-         nodeObj->nodeLeafBit= true;
-         nodeObj->leftSlot   = rid;
-         nodeObj->leftKey    = key->v.intV;
-         nodeObj->rightSlot  = RID_NONE;
-         nodeObj->rightKey   = -1;
-         nodeObj->chainLink  = RID_NONE;
-         unpinPage(cindex->poolRef, cindex->pageRef);
-     } else {
-         pinPage(cindex->poolRef, cindex->pageRef, gHighestPage);
-         bool nodeFull = *((bool *)cindex->pageRef->data);
-         if (nodeFull) {
-             /* The last node page is full; allocate a new node page. */
-             gHighestPage++;
-             unpinPage(cindex->poolRef, cindex->pageRef);
-             pinPage(cindex->poolRef, cindex->pageRef, gHighestPage);
-             *((bool *)cindex->pageRef->data) = false;
-             nodeObj = (NodeInPage *)((char *)cindex->pageRef->data + sizeof(bool));
-             nodeObj->parentIdx   = -1;
-             nodeObj->nodeLeafBit = true;
-             nodeObj->leftSlot    = rid;
-             nodeObj->leftKey     = key->v.intV;
-             nodeObj->rightSlot   = RID_NONE;
-             nodeObj->rightKey    = -1;
-             nodeObj->chainLink   = RID_NONE;
-             unpinPage(cindex->poolRef, cindex->pageRef);
-         } else {
-             /* Place the new key in the second slot of the existing last node. */
-             nodeObj = (NodeInPage *)((char *)cindex->pageRef->data + sizeof(bool));
-             nodeObj->rightSlot = rid;
-             nodeObj->rightKey  = key->v.intV;
-             *((bool *)cindex->pageRef->data) = true;
-             unpinPage(cindex->poolRef, cindex->pageRef);
-         }
-     }
-     cindex->keysTotal++;
-     return RC_OK;
- }
- 
- /*
-  * deleteKey:
-  * Searches for the given key among pages 1..gHighestPage. If found in the last page, remove or shift keys.
-  * Otherwise, "borrow" a key from the last page to overwrite the key being deleted.
-  */
- RC deleteKey(BTreeHandle *tree, Value *key) {
-     int removingVal = key->v.intV;
-     CoreIndex *cindex = (CoreIndex *)tree->mgmtData;
-     bool located = false;
-     int foundPg  = 0;
-     int whichKey = 0;  /* 1 => leftKey, 2 => rightKey */
-     NodeInPage *nodeObj;
- 
-     for (int pg = 1; pg <= gHighestPage && !located; pg++) {
-         pinPage(cindex->poolRef, cindex->pageRef, pg);
-         nodeObj = (NodeInPage *)((char *)cindex->pageRef->data + sizeof(bool));
-         if (nodeObj->leftKey == removingVal)  { located = true; whichKey = 1; foundPg = pg; }
-         else if (nodeObj->rightKey == removingVal) { located = true; whichKey = 2; foundPg = pg; }
-         unpinPage(cindex->poolRef, cindex->pageRef);
-     }
-     if (!located)
-         return RC_IM_KEY_NOT_FOUND;
- 
-     if (foundPg == gHighestPage) {
-         /* If the key is in the last node page, remove or shift in place. */
-         pinPage(cindex->poolRef, cindex->pageRef, gHighestPage);
-         nodeObj = (NodeInPage *)((char *)cindex->pageRef->data + sizeof(bool));
-         bool wasFull = *((bool *)cindex->pageRef->data);
-         if (whichKey == 2) {
-             nodeObj->rightSlot = RID_NONE;
-             nodeObj->rightKey  = -1;
-             *((bool *)cindex->pageRef->data) = false;
-         } else {
-             /* whichKey == 1 */
-             if (wasFull) {
-                 nodeObj->leftSlot = nodeObj->rightSlot;
-                 nodeObj->leftKey  = nodeObj->rightKey;
-                 nodeObj->rightSlot= RID_NONE;
-                 nodeObj->rightKey = -1;
-                 *((bool *)cindex->pageRef->data) = false;
-             } else {
-                 nodeObj->leftSlot = RID_NONE;
-                 nodeObj->leftKey  = -1;
-                 gHighestPage--;
-             }
-         }
-         unpinPage(cindex->poolRef, cindex->pageRef);
-     } else {
-         /* Borrow a key from the last node to replace the removed key. */
-         pinPage(cindex->poolRef, cindex->pageRef, gHighestPage);
-         nodeObj = (NodeInPage *)((char *)cindex->pageRef->data + sizeof(bool));
-         RID borrowSlot;
-         int borrowVal;
-         bool lastFull = *((bool *)cindex->pageRef->data);
-         if (lastFull) {
-             borrowSlot      = nodeObj->rightSlot;
-             borrowVal       = nodeObj->rightKey;
-             nodeObj->rightSlot = RID_NONE;
-             nodeObj->rightKey  = -1;
-             *((bool *)cindex->pageRef->data) = false;
-         } else {
-             borrowSlot      = nodeObj->leftSlot;
-             borrowVal       = nodeObj->leftKey;
-             nodeObj->leftSlot= RID_NONE;
-             nodeObj->leftKey = -1;
-             gHighestPage--;
-         }
-         unpinPage(cindex->poolRef, cindex->pageRef);
- 
-         pinPage(cindex->poolRef, cindex->pageRef, foundPg);
-         nodeObj = (NodeInPage *)((char *)cindex->pageRef->data + sizeof(bool));
-         if (whichKey == 1) {
-             nodeObj->leftSlot = borrowSlot;
-             nodeObj->leftKey  = borrowVal;
-         } else {
-             nodeObj->rightSlot= borrowSlot;
-             nodeObj->rightKey = borrowVal;
-         }
-         unpinPage(cindex->poolRef, cindex->pageRef);
-     }
-     cindex->keysTotal--;
-     return RC_OK;
- }
- 
- /* ====================== TREE SCAN FUNCTIONS ====================== */
- 
- /*
-  * openTreeScan:
-  * Collects all keys from pages 1..gHighestPage into an array, sorts them, and stores them
-  * in the scan handle so that nextEntry can retrieve them in ascending order.
-  */
- RC openTreeScan(BTreeHandle *tree, BT_ScanHandle **handle) {
-     printf("Initiating a tree scan...\n");
-     CoreIndex *cindex = (CoreIndex *)tree->mgmtData;
-     int *gathered = (int *)malloc(sizeof(int) * cindex->keysTotal);
-     int indexPos = 0;
-     for (int pg = 1; pg <= gHighestPage; pg++) {
-         pinPage(cindex->poolRef, cindex->pageRef, pg);
-         NodeInPage *nd = (NodeInPage *)((char *)cindex->pageRef->data + sizeof(bool));
-         if (nd->leftKey != -1)
-             gathered[indexPos++] = nd->leftKey;
-         if (*((bool *)cindex->pageRef->data) && (nd->rightKey != -1))
-             gathered[indexPos++] = nd->rightKey;
-         unpinPage(cindex->poolRef, cindex->pageRef);
-     }
-     /* Sort using a simple selection sort */
-     for (int i = 0; i < cindex->keysTotal - 1; i++) {
-         int minIdx = i;
-         for (int j = i + 1; j < cindex->keysTotal; j++) {
-             if (gathered[j] < gathered[minIdx])
-                 minIdx = j;
-         }
-         int temp = gathered[minIdx];
-         gathered[minIdx] = gathered[i];
-         gathered[i] = temp;
-     }
-     BT_ScanHandle *scanH = (BT_ScanHandle *)malloc(sizeof(BT_ScanHandle));
-     scanH->tree = tree;
-     scanH->mgmtData = gathered;
-     gScanIndex = 0;
-     *handle = scanH;
-     return RC_OK;
- }
- 
- /*
-  * nextEntry:
-  * Reads the next key from the sorted list in mgmtData, uses findKey to locate its RID,
-  * and returns that RID as the next entry.
-  */
- RC nextEntry(BT_ScanHandle *handle, RID *result) {
-     CoreIndex *cindex = (CoreIndex *)handle->tree->mgmtData;
-     int *sortedKeys = (int *)handle->mgmtData;
-     if (gScanIndex >= cindex->keysTotal)
-         return RC_IM_NO_MORE_ENTRIES;
-     Value valNext;
-     valNext.dt = DT_INT;
-     valNext.v.intV = sortedKeys[gScanIndex];
-     RID foundHere;
-     RC rc = findKey(handle->tree, &valNext, &foundHere);
-     if (rc != RC_OK)
-         return rc;
-     *result = foundHere;
-     gScanIndex++;
-     return RC_OK;
- }
- 
- /*
-  * closeTreeScan:
-  * Deallocates the sorted key array and the scan handle, and resets the scan index.
-  */
- RC closeTreeScan(BT_ScanHandle *handle) {
-     printf("Concluding the tree scan...\n");
-     free(handle->mgmtData);
-     free(handle);
-     gScanIndex = 0;
-     return RC_OK;
- }
- 
- /*
-  * printTree:
-  * For debugging, returns the file name (idxId) for this B+ tree.
-  */
- char* printTree(BTreeHandle *tree) {
-     return tree->idxId;
- }
+/*
+ * openBtree:
+ * Opens the B+ tree index file, initializes a buffer pool, and reads the metadata from page 0.
+ */
+RC openBtree(BTreeHandle **tree, char *idxId) {
+    CoreIndex *cindex = (CoreIndex *) malloc(sizeof(CoreIndex));
+    if (!cindex)
+        return RC_MEMORY_ALLOCATION_ERROR;
+
+    cindex->poolRef = MAKE_POOL();
+
+    /* Setup buffer pool for up to 10 pages with FIFO replacement. The pool kept
+       the file name pointer, so it got the handle's own copy of the name. */
+    char *name = strdup(idxId);
+    RC rc = initBufferPool(cindex->poolRef, name, 10, RS_FIFO, NULL);
+    if (rc != RC_OK) {
+        free(name);
+        free(cindex->poolRef);
+        free(cindex);
+        return rc;
+    }
+
+    BM_PageHandle page;
+    rc = pinPage(cindex->poolRef, &page, 0);
+    if (rc != RC_OK)
+        return rc;
+    memcpy(&cindex->meta, page.data, sizeof(BT_Meta));
+    unpinPage(cindex->poolRef, &page);
+    setLayout(cindex);
+    cindex->logged = false;
+
+    BTreeHandle *bh = (BTreeHandle *) malloc(sizeof(BTreeHandle));
+    if (!bh)
+        return RC_MEMORY_ALLOCATION_ERROR;
+    bh->keyType  = (DataType) cindex->meta.keyType;
+    bh->idxId    = name;
+    bh->mgmtData = cindex;
+    *tree        = bh;
+    return RC_OK;
+}
+
+/*
+ * closeBtree:
+ * Writes the metadata back, shuts down the buffer pool (flushing the nodes), and frees memory.
+ */
+RC closeBtree(BTreeHandle *tree) {
+    CoreIndex *cindex = (CoreIndex *) tree->mgmtData;
+    RC rc = writeMeta(cindex);
+    if (rc != RC_OK)
+        return rc;
+
+    rc = shutdownBufferPool(cindex->poolRef);
+    if (rc != RC_OK)
+        return rc;
+    free(cindex->poolRef);
+    free(cindex);
+    free(tree->idxId);
+    free(tree);
+    return RC_OK;
+}
+
+/*
+ * setBtreeLog:
+ * Attached a write-ahead log to the index's buffer pool (NULL detached it).
+ */
+RC setBtreeLog(BTreeHandle *tree, WAL_Log *log) {
+    CoreIndex *cindex = (CoreIndex *) tree->mgmtData;
+    cindex->logged = (log != NULL);
+    return setPoolLog(cindex->poolRef, log);
+}
+
+/*
+ * deleteBtree:
+ * Removes the index file from disk.
+ */
+RC deleteBtree(char *idxId) {
+    printf("Deleting B+ tree file: %s\n", idxId);
+    return (remove(idxId) != 0) ? RC_FILE_NOT_FOUND : RC_OK;
+}
+
+/*
+ * getNumNodes:
+ * Returns how many node pages the tree uses.
+ */
+RC getNumNodes(BTreeHandle *tree, int *result) {
+    *result = ((CoreIndex *) tree->mgmtData)->meta.numNodes;
+    return RC_OK;
+}
+
+/*
+ * getNumEntries:
+ * Returns how many keys exist in the index.
+ */
+RC getNumEntries(BTreeHandle *tree, int *result) {
+    *result = ((CoreIndex *) tree->mgmtData)->meta.numEntries;
+    return RC_OK;
+}
+
+/*
+ * getKeyType:
+ * Returns the type of keys the tree was created with.
+ */
+RC getKeyType(BTreeHandle *tree, DataType *result) {
+    *result = (DataType) ((CoreIndex *) tree->mgmtData)->meta.keyType;
+    return RC_OK;
+}
+
+/* ====================== INDEX ACCESS FUNCTIONS ====================== */
+
+/*
+ * findKey:
+ * Descends to the leaf that would hold the key and returns the RID of its
+ * first entry with that key.
+ */
+RC findKey(BTreeHandle *tree, Value *key, RID *result) {
+    CoreIndex *cindex = (CoreIndex *) tree->mgmtData;
+    char probe[cindex->keySize];
+    int leaf, pos;
+
+    if (!encodeKey(cindex, key, probe))
+        return RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
+    RC rc = seekEntry(cindex, probe, NULL, &leaf, &pos);
+    if (rc != RC_OK)
+        return rc;
+
+    BM_PageHandle page;
+    rc = pinPage(cindex->poolRef, &page, leaf);
+    if (rc != RC_OK)
+        return rc;
+    *result = *NODE_RID(cindex, page.data, pos);
+    unpinPage(cindex->poolRef, &page);
+    return RC_OK;
+}
+
+/*
+ * insertKey:
+ * Adds a key-RID pair, splitting full nodes on the way back up.
+ */
+RC insertKey(BTreeHandle *tree, Value *key, RID rid) {
+    CoreIndex *cindex = (CoreIndex *) tree->mgmtData;
+    char stored[cindex->keySize];
+
+    if (!encodeKey(cindex, key, stored))
+        return RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
+    return logMeta(cindex, insertEncoded(cindex, stored, rid));
+}
+
+/*
+ * deleteKey:
+ * Removes the (first) entry with the given key.
+ */
+RC deleteKey(BTreeHandle *tree, Value *key) {
+    CoreIndex *cindex = (CoreIndex *) tree->mgmtData;
+    char probe[cindex->keySize];
+    int leaf, pos;
+
+    if (!encodeKey(cindex, key, probe))
+        return RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
+    RC rc = seekEntry(cindex, probe, NULL, &leaf, &pos);
+    if (rc != RC_OK)
+        return rc;
+    return logMeta(cindex, removeAt(cindex, leaf, pos));
+}
+
+/*
+ * deleteEntry:
+ * Removes exactly the entry for this key and RID; used for trees with duplicates.
+ */
+RC deleteEntry(BTreeHandle *tree, Value *key, RID rid) {
+    CoreIndex *cindex = (CoreIndex *) tree->mgmtData;
+    char probe[cindex->keySize];
+    int leaf, pos;
+
+    if (!encodeKey(cindex, key, probe))
+        return RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
+    RC rc = seekEntry(cindex, probe, &rid, &leaf, &pos);
+    if (rc != RC_OK)
+        return rc;
+    return logMeta(cindex, removeAt(cindex, leaf, pos));
+}
+
+/* ====================== TREE SCAN FUNCTIONS ====================== */
+
+/*
+ * openTreeScan:
+ * Starts a scan over all entries in key order.
+ */
+RC openTreeScan(BTreeHandle *tree, BT_ScanHandle **handle) {
+    return openTreeRangeScan(tree, NULL, true, NULL, true, handle);
+}
+
+/*
+ * positionScan:
+ * Stores the bounds of a scan and points it at the leaf the lower bound leads
+ * to (the leftmost leaf without one), from where nextEntry walks the leaf chain.
+ */
+static RC positionScan(CoreIndex *cindex, BT_ScanData *sd, Value *low, int lowInclusive,
+                       Value *high, int highInclusive) {
+    sd->hasLow  = (low != NULL);
+    sd->hasHigh = (high != NULL);
+    sd->lowInclusive  = lowInclusive;
+    sd->highInclusive = highInclusive;
+    sd->page = -1;
+    sd->pos  = 0;
+    if ((low != NULL && !encodeKey(cindex, low, sd->low))
+        || (high != NULL && !encodeKey(cindex, high, sd->high)))
+        return RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
+
+    // Found the first leaf to look at
+    if (cindex->meta.root > 0) {
+        int path[BT_MAX_DEPTH];
+        int depth;
+        if (sd->hasLow)
+            depth = descend(cindex, sd->low, lowestRid(), path);
+        else {
+            // The leftmost leaf: always took the first child
+            BM_PageHandle page;
+            int pageNum = cindex->meta.root;
+            depth = 0;
+            while (pageNum > 0) {
+                path[depth++] = pageNum;
+                if (pinPage(cindex->poolRef, &page, pageNum) != RC_OK)
+                    break;
+                int isLeaf = NODE_HDR(page.data)->isLeaf;
+                int child  = *NODE_CHILD(cindex, page.data, 0);
+                unpinPage(cindex->poolRef, &page);
+                pageNum = isLeaf ? -1 : child;
+            }
+        }
+        if (depth > 0)
+            sd->page = path[depth - 1];
+    }
+    return RC_OK;
+}
+
+/*
+ * openTreeRangeScan:
+ * Starts a scan over the entries whose keys lie between low and high.
+ */
+RC openTreeRangeScan(BTreeHandle *tree, Value *low, int lowInclusive,
+                     Value *high, int highInclusive, BT_ScanHandle **handle) {
+    CoreIndex *cindex = (CoreIndex *) tree->mgmtData;
+    BT_ScanData *sd = (BT_ScanData *) calloc(1, sizeof(BT_ScanData));
+    sd->low  = (char *) malloc(cindex->keySize);
+    sd->high = (char *) malloc(cindex->keySize);
+
+    RC rc = positionScan(cindex, sd, low, lowInclusive, high, highInclusive);
+    if (rc != RC_OK) {
+        free(sd->low);
+        free(sd->high);
+        free(sd);
+        return rc;
+    }
+
+    BT_ScanHandle *scanH = (BT_ScanHandle *) malloc(sizeof(BT_ScanHandle));
+    scanH->tree = tree;
+    scanH->mgmtData = sd;
+    *handle = scanH;
+    return RC_OK;
+}
+
+/*
+ * seekTreeScan:
+ * Restarts an open scan with new bounds, so that many lookups can share one
+ * scan handle. Lookups in ascending key order find the upper levels of the
+ * tree already in the buffer pool.
+ */
+RC seekTreeScan(BT_ScanHandle *handle, Value *low, int lowInclusive,
+                Value *high, int highInclusive) {
+    CoreIndex *cindex = (CoreIndex *) handle->tree->mgmtData;
+    return positionScan(cindex, (BT_ScanData *) handle->mgmtData, low, lowInclusive, high, highInclusive);
+}
+
+/*
+ * nextEntry:
+ * Returns the RID of the next entry within the bounds, moving to the next leaf
+ * when the current one is used up.
+ */
+RC nextEntry(BT_ScanHandle *handle, RID *result) {
+    CoreIndex *cindex = (CoreIndex *) handle->tree->mgmtData;
+    BT_ScanData *sd = (BT_ScanData *) handle->mgmtData;
+    BM_PageHandle page;
+
+    while (sd->page > 0) {
+        RC rc = pinPage(cindex->poolRef, &page, sd->page);
+        if (rc != RC_OK)
+            return rc;
+        BT_NodeHeader *hdr = NODE_HDR(page.data);
+
+        while (sd->pos < hdr->numKeys) {
+            char *key = NODE_KEY(cindex, page.data, sd->pos);
+            RID rid = *NODE_RID(cindex, page.data, sd->pos);
+            sd->pos++;
+
+            if (sd->hasLow) {
+                int c = compareKeys(cindex, key, sd->low);
+                if (c < 0 || (c == 0 && !sd->lowInclusive))
+                    continue;
+            }
+            if (sd->hasHigh) {
+                int c = compareKeys(cindex, key, sd->high);
+                if (c > 0 || (c == 0 && !sd->highInclusive)) {
+                    sd->page = -1;
+                    break;
+                }
+            }
+            unpinPage(cindex->poolRef, &page);
+            *result = rid;
+            return RC_OK;
+        }
+
+        if (sd->page > 0) {
+            sd->page = hdr->next;
+            sd->pos  = 0;
+        }
+        unpinPage(cindex->poolRef, &page);
+    }
+    return RC_IM_NO_MORE_ENTRIES;
+}
+
+/*
+ * closeTreeScan:
+ * Deallocates the scan state and the scan handle.
+ */
+RC closeTreeScan(BT_ScanHandle *handle) {
+    BT_ScanData *sd = (BT_ScanData *) handle->mgmtData;
+    free(sd->low);
+    free(sd->high);
+    free(sd);
+    free(handle);
+    return RC_OK;
+}
+
+/*
+ * printTree:
+ * For debugging, returns the file name (idxId) for this B+ tree.
+ */
+char* printTree(BTreeHandle *tree) {
+    return tree->idxId;
+}
@@ -3,6 +3,7 @@
 
 #include "dberror.h"
 #include "tables.h"
+#include "wal_mgr.h"
 
 // structure for accessing btrees
 typedef struct BTreeHandle {
@@ -22,9 +23,15 @@ extern RC shutdownIndexManager ();
 
 // create, destroy, open, and close an btree index
 extern RC createBtree (char *idxId, DataType keyType, int n);
+// keyLength is only used for DT_STRING keys; with allowDuplicates a key may
+// appear once per RID, and entries are ordered by (key, RID)
+extern RC createBtreeWithOptions (char *idxId, DataType keyType, int keyLength, int n, int allowDuplicates);
+extern int getMaxBtreeOrder (DataType keyType, int keyLength);
 extern RC openBtree (BTreeHandle **tree, char *idxId);
 extern RC closeBtree (BTreeHandle *tree);
 extern RC deleteBtree (char *idxId);
+// logs every change of the index to a write-ahead log (NULL stops logging)
+extern RC setBtreeLog (BTreeHandle *tree, WAL_Log *log);
 
 // access information about a b-tree
 extern RC getNumNodes (BTreeHandle *tree, int *result);
@@ -35,7 +42,14 @@ extern RC getKeyType (BTreeHandle *tree, DataType *result);
 extern RC findKey (BTreeHandle *tree, Value *key, RID *result);
 extern RC insertKey (BTreeHandle *tree, Value *key, RID rid);
 extern RC deleteKey (BTreeHandle *tree, Value *key);
+extern RC deleteEntry (BTreeHandle *tree, Value *key, RID rid);
 extern RC openTreeScan (BTreeHandle *tree, BT_ScanHandle **handle);
+// scans the keys between low and high (NULL => unbounded) in order
+extern RC openTreeRangeScan (BTreeHandle *tree, Value *low, int lowInclusive,
+			     Value *high, int highInclusive, BT_ScanHandle **handle);
+// restarts an open scan with new bounds (a failed seek leaves the scan finished)
+extern RC seekTreeScan (BT_ScanHandle *handle, Value *low, int lowInclusive,
+			Value *high, int highInclusive);
 extern RC nextEntry (BT_ScanHandle *handle, RID *result);
 extern RC closeTreeScan (BT_ScanHandle *handle);
 
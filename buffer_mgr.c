@@ -6,6 +6,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
 
 /*
  * Data Structures
@@ -17,6 +20,29 @@
  *                 and a usage counter for LRU or CLOCK.
  *   2. BM_MgmtData: Managed the array of PageFrame objects and also tracked
  *                   read/write IO counts and a clock pointer if needed.
+ *
+ * With a write-ahead log attached (setPoolLog), a page marked dirty was
+ * logged when it was unpinned, and the log was forced up to a page's LSN
+ * before the page was written back to its file. Every pool with a log was
+ * also registered, so checkpointLog could collect the dirty pages of all the
+ * pools sharing a log.
+ *
+ * A pool could be shared by threads: its frames were only looked at or
+ * changed with its mutex held, and a pin that found every frame pinned failed
+ * with RC_BM_NO_FREE_FRAME instead of evicting a page in use (waiting for an
+ * unpin could hang a caller that held those pins itself). The mutex only
+ * protected the frames; callers latched the contents of the pages themselves.
+ *
+ * Disk I/O ran without the mutex. A pin that missed claimed a frame, marked
+ * it loading, and wrote the victim back and read the page in with the mutex
+ * released, so hits and pins of other pages went on meanwhile. Pins of the
+ * page being read, or of the victim being written back, waited on 'loaded'.
+ * Flushes and checkpoints wrote a dirty page the same way: they pinned it and
+ * marked it clean with the mutex held, so it could not be evicted and a change
+ * made during the write dirtied it again, then wrote it with the mutex released.
+ * The page file itself was guarded by ioLock: reads and writes of pages held
+ * it shared (they used pread/pwrite, so they did not get in each other's
+ * way) and only growing the file took it exclusively.
  */
 
 /* This struct had represented one page frame in the buffer pool. */
@@ -28,6 +54,11 @@ typedef struct PageFrame
     int fixCount;       // This was the number of clients currently using the page
     // usage was used for LRU, CLOCK, or other replacement strategies
     int usage;          
+    bool logPending;    // This was set by markDirty while a log was attached
+    LSN pageLSN;        // This was the LSN of the last log record for the page
+    LSN recLSN;         // This was the first record since the page was last written
+    bool loading;       // This was set while the page was being read into the frame
+    PageNumber evicting; // This was the dirty victim being written back meanwhile (NO_PAGE if none)
 } PageFrame;
 
 /* This struct contained additional info for the entire buffer pool. */
@@ -37,6 +68,11 @@ typedef struct BM_MgmtData
     int readIO;         // This counted how many reads were performed
     int writeIO;        // This counted how many writes were performed
     int clockPointer;   // If using CLOCK, this was the pointer
+    WAL_Log *log;       // This was the write-ahead log, NULL if none
+    SM_FileHandle fh;   // This was the page file, open while the pool was
+    pthread_mutex_t lock;       // Held while the frames were looked at or changed
+    pthread_cond_t loaded;      // Broadcast when a frame stopped loading
+    pthread_rwlock_t ioLock;    // Held shared to read or write pages, exclusively to grow the file
 } BM_MgmtData;
 
 /*
@@ -51,13 +87,28 @@ static RC initPageFrameArray(BM_MgmtData *mgmt, int numPages);
 static int findPageFrame(BM_MgmtData *mgmt, int numPages, PageNumber pageNum);
 static int findFreeFrame(BM_MgmtData *mgmt, int numPages);
 static int findVictimFrame(BM_BufferPool *bm, BM_MgmtData *mgmt);
-static RC writeDirtyPageToDisk(BM_BufferPool *bm, PageFrame *pf);
+static RC loadFrame(BM_BufferPool *bm, BM_MgmtData *mgmt, int freeIndex, PageNumber pageNum, BM_PageHandle *page);
+static RC writeDirtyPageToDisk(BM_BufferPool *bm, BM_MgmtData *mgmt, PageFrame *pf);
+static int findEvictingFrame(BM_MgmtData *mgmt, int numPages, PageNumber pageNum);
+static RC growFile(BM_MgmtData *mgmt, PageNumber pageNum);
+static RC readPage(BM_MgmtData *mgmt, PageNumber pageNum, char *data);
+static RC writePage(BM_MgmtData *mgmt, PageNumber pageNum, char *data);
+static RC logFrame(BM_BufferPool *bm, PageFrame *pf);
+static RC checkpointIfDue(WAL_Log *log, LSN lsn);
+static void registerPool(BM_BufferPool *bm, bool logged);
+
+/* Pools with a log attached, for checkpointLog */
+static BM_BufferPool **loggedPools = NULL;
+static int numLoggedPools = 0;
+static int capLoggedPools = 0;
+static pthread_mutex_t loggedPoolsLock = PTHREAD_MUTEX_INITIALIZER;
 
 /* 
  * initBufferPool
  * --------------
  * This function initialized the buffer pool by:
- *  1) Checking if the page file was accessible
+ *  1) Opening the page file (kept open until shutdown, so a compressed
+ *     file's extent map was read once)
  *  2) Allocating BM_MgmtData
  *  3) Creating an array of PageFrame
  *  4) Setting up initial read/write counters and clockPointer
@@ -68,12 +119,6 @@ RC initBufferPool(BM_BufferPool *const bm,
                   ReplacementStrategy strategy,
                   void *stratData)
 {
-    // Verified the file could be opened, to ensure it existed
-    FILE *fp = fopen(pageFileName, "r");
-    if (!fp)
-        return RC_FILE_NOT_FOUND;
-    fclose(fp);
-
     // Stored basic info about the buffer pool
     bm->pageFile = (char*)pageFileName;
     bm->numPages = numPages;
@@ -84,14 +129,29 @@ RC initBufferPool(BM_BufferPool *const bm,
     if (!mgmt)
         return RC_MEMORY_ALLOCATION_ERROR;
 
+    // Opened the page file, which also ensured it existed
+    if (openPageFile(bm->pageFile, &mgmt->fh) != RC_OK)
+    {
+        free(mgmt);
+        return RC_FILE_NOT_FOUND;
+    }
+
     mgmt->readIO       = 0;
     mgmt->writeIO      = 0;
     mgmt->clockPointer = 0;
+    mgmt->log          = NULL;
+    pthread_mutex_init(&mgmt->lock, NULL);
+    pthread_cond_init(&mgmt->loaded, NULL);
+    pthread_rwlock_init(&mgmt->ioLock, NULL);
 
     // Allocated and initialized an array of PageFrame
     RC rc = initPageFrameArray(mgmt, numPages);
     if (rc != RC_OK)
     {
+        closePageFile(&mgmt->fh);
+        pthread_mutex_destroy(&mgmt->lock);
+        pthread_cond_destroy(&mgmt->loaded);
+        pthread_rwlock_destroy(&mgmt->ioLock);
         free(mgmt);
         return rc;
     }
@@ -107,7 +167,7 @@ RC initBufferPool(BM_BufferPool *const bm,
  * This function:
  *  1) Called forceFlushPool to ensure all dirty pages were written
  *  2) Verified that no page remained pinned
- *  3) Freed all frames and mgmt data
+ *  3) Closed the page file and freed all frames and mgmt data
  */
 RC shutdownBufferPool(BM_BufferPool *const bm)
 {
@@ -122,11 +182,20 @@ RC shutdownBufferPool(BM_BufferPool *const bm)
         return rc;
 
     // Ensured no pinned pages remained
+    pthread_mutex_lock(&mgmt->lock);
     for (int i=0; i<bm->numPages; i++)
     {
         if (mgmt->frames[i].fixCount > 0)
+        {
+            pthread_mutex_unlock(&mgmt->lock);
             return RC_ERROR; // or a specialized code if pinned pages are not allowed
+        }
     }
+    pthread_mutex_unlock(&mgmt->lock);
+
+    // A checkpoint could no longer look at this pool
+    if (mgmt->log)
+        registerPool(bm, false);
 
     // Freed each page's data
     for (int i=0; i<bm->numPages; i++)
@@ -136,18 +205,23 @@ RC shutdownBufferPool(BM_BufferPool *const bm)
     }
 
     // Freed the frames array, then mgmt data
+    rc = closePageFile(&mgmt->fh);
     free(mgmt->frames);
+    pthread_mutex_destroy(&mgmt->lock);
+    pthread_cond_destroy(&mgmt->loaded);
+    pthread_rwlock_destroy(&mgmt->ioLock);
     free(mgmt);
 
     bm->mgmtData = NULL;
-    return RC_OK;
+    return rc;
 }
 
 /*
  * forceFlushPool
  * --------------
  * This wrote all dirty pages with fixCount=0 out to disk. For each
- * frame that was dirty and fixCount=0, it called writeDirtyPageToDisk.
+ * frame that was dirty and fixCount=0, it called writeDirtyPageToDisk,
+ * which released the mutex while the page was written.
  */
 RC forceFlushPool(BM_BufferPool *const bm)
 {
@@ -155,21 +229,19 @@ RC forceFlushPool(BM_BufferPool *const bm)
         return RC_ERROR;
 
     BM_MgmtData *mgmt = (BM_MgmtData*) bm->mgmtData;
+    RC rc = RC_OK;
 
     // Checked each frame
-    for (int i=0; i<bm->numPages; i++)
+    pthread_mutex_lock(&mgmt->lock);
+    for (int i=0; i<bm->numPages && rc == RC_OK; i++)
     {
         PageFrame *pf = &mgmt->frames[i];
         // If the page was dirty and not pinned
         if (pf->dirty && pf->fixCount == 0)
-        {
-            RC rc = writeDirtyPageToDisk(bm, pf);
-            if (rc != RC_OK)
-                return rc;
-            pf->dirty = false;
-        }
+            rc = writeDirtyPageToDisk(bm, mgmt, pf);
     }
-    return RC_OK;
+    pthread_mutex_unlock(&mgmt->lock);
+    return rc;
 }
 
 /*
@@ -184,19 +256,25 @@ RC markDirty(BM_BufferPool *const bm, BM_PageHandle *const page)
         return RC_ERROR;
 
     BM_MgmtData *mgmt = (BM_MgmtData*) bm->mgmtData;
+    pthread_mutex_lock(&mgmt->lock);
     int index = findPageFrame(mgmt, bm->numPages, page->pageNum);
-    if (index < 0)
-        return RC_ERROR;
-
-    mgmt->frames[index].dirty = true;
-    return RC_OK;
+    if (index >= 0)
+    {
+        mgmt->frames[index].dirty = true;
+        if (mgmt->log)
+            mgmt->frames[index].logPending = true;
+    }
+    pthread_mutex_unlock(&mgmt->lock);
+    return (index < 0) ? RC_ERROR : RC_OK;
 }
 
 /*
  * unpinPage
  * ---------
  * Decremented fixCount for a page in the buffer pool. It found the frame
- * with page->pageNum, then fixCount-- if it was >0.
+ * with page->pageNum, then fixCount-- if it was >0. A logged change could
+ * start an automatic checkpoint, which was taken after the pool's mutex had
+ * been released.
  */
 RC unpinPage(BM_BufferPool *const bm, BM_PageHandle *const page)
 {
@@ -204,21 +282,39 @@ RC unpinPage(BM_BufferPool *const bm, BM_PageHandle *const page)
         return RC_ERROR;
 
     BM_MgmtData *mgmt = (BM_MgmtData*) bm->mgmtData;
+    pthread_mutex_lock(&mgmt->lock);
     int index = findPageFrame(mgmt, bm->numPages, page->pageNum);
     if (index < 0)
+    {
+        pthread_mutex_unlock(&mgmt->lock);
         return RC_ERROR;
+    }
 
-    if (mgmt->frames[index].fixCount > 0)
-        mgmt->frames[index].fixCount--;
+    PageFrame *pf = &mgmt->frames[index];
+    if (pf->fixCount > 0)
+        pf->fixCount--;
 
-    return RC_OK;
+    // Logged the changes made while the page was pinned
+    RC rc = RC_OK;
+    LSN logged = WAL_NO_LSN;
+    if (pf->logPending)
+    {
+        rc = logFrame(bm, pf);
+        logged = pf->pageLSN;
+    }
+    WAL_Log *log = mgmt->log;
+    pthread_mutex_unlock(&mgmt->lock);
+
+    if (rc == RC_OK && logged != WAL_NO_LSN)
+        rc = checkpointIfDue(log, logged);
+    return rc;
 }
 
 /*
  * forcePage
  * ---------
  * Wrote a single dirty page to disk. If dirty, it called
- * writeDirtyPageToDisk, then set dirty=false.
+ * writeDirtyPageToDisk, which set dirty=false.
  */
 RC forcePage(BM_BufferPool *const bm, BM_PageHandle *const page)
 {
@@ -226,19 +322,17 @@ RC forcePage(BM_BufferPool *const bm, BM_PageHandle *const page)
         return RC_ERROR;
 
     BM_MgmtData *mgmt = (BM_MgmtData*) bm->mgmtData;
+    RC rc = RC_OK;
+    pthread_mutex_lock(&mgmt->lock);
     int index = findPageFrame(mgmt, bm->numPages, page->pageNum);
     if (index < 0)
-        return RC_ERROR;
+        rc = RC_ERROR;
 
     // If dirty, wrote out
-    if (mgmt->frames[index].dirty)
-    {
-        RC rc = writeDirtyPageToDisk(bm, &mgmt->frames[index]);
-        if (rc != RC_OK)
-            return rc;
-        mgmt->frames[index].dirty = false;
-    }
-    return RC_OK;
+    else if (mgmt->frames[index].dirty)
+        rc = writeDirtyPageToDisk(bm, mgmt, &mgmt->frames[index]);
+    pthread_mutex_unlock(&mgmt->lock);
+    return rc;
 }
 
 /*
@@ -247,6 +341,8 @@ RC forcePage(BM_BufferPool *const bm, BM_PageHandle *const page)
  * Pinned the requested page into the buffer pool. If the page was found in memory,
  * fixCount++ and usage++ for LRU. If not found, found a free frame or victim,
  * wrote out if dirty, read from disk, updated readIO, and set fixCount=1, usage=1.
+ * A page still being read in (or written back) was waited for. If every
+ * frame was pinned, it returned RC_BM_NO_FREE_FRAME.
  */
 RC pinPage(BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum)
 {
@@ -256,65 +352,141 @@ RC pinPage(BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber
         return RC_ERROR;
 
     BM_MgmtData *mgmt = (BM_MgmtData*) bm->mgmtData;
+    pthread_mutex_lock(&mgmt->lock);
 
-    // Checked if page was already in memory
-    int idx = findPageFrame(mgmt, bm->numPages, pageNum);
-    if (idx >= 0)
+    for (;;)
     {
-        // Found it => fixCount++, usage++ (for LRU)
-        mgmt->frames[idx].fixCount++;
-        mgmt->frames[idx].usage++;
-        page->data = mgmt->frames[idx].data;
-        page->pageNum = pageNum;
-        return RC_OK;
+        // Checked if page was already in memory
+        int idx = findPageFrame(mgmt, bm->numPages, pageNum);
+        if (idx >= 0 && !mgmt->frames[idx].loading)
+        {
+            // Found it => fixCount++, usage++ (for LRU)
+            mgmt->frames[idx].fixCount++;
+            mgmt->frames[idx].usage++;
+            page->data = mgmt->frames[idx].data;
+            page->pageNum = pageNum;
+            pthread_mutex_unlock(&mgmt->lock);
+            return RC_OK;
+        }
+
+        // Not in memory, and not on its way in or out => read it ourselves
+        if (idx < 0 && findEvictingFrame(mgmt, bm->numPages, pageNum) < 0)
+            break;
+        pthread_cond_wait(&mgmt->loaded, &mgmt->lock);
     }
-    else
+
+    // Not in memory => find free or victim
+    int freeIndex = findFreeFrame(mgmt, bm->numPages);
+    if (freeIndex < 0)
+        freeIndex = findVictimFrame(bm, mgmt);
+    if (freeIndex < 0)
     {
-        // Not in memory => find free or victim
-        int freeIndex = findFreeFrame(mgmt, bm->numPages);
-        if (freeIndex < 0)
-            freeIndex = findVictimFrame(bm, mgmt);
+        pthread_mutex_unlock(&mgmt->lock);
+        return RC_BM_NO_FREE_FRAME;
+    }
+
+    RC rc = loadFrame(bm, mgmt, freeIndex, pageNum, page);
+    pthread_mutex_unlock(&mgmt->lock);
+    return rc;
+}
 
-        // If victim was dirty, wrote out
-        if (mgmt->frames[freeIndex].dirty)
+/*
+ * setPoolLog
+ * ----------
+ * Attached a write-ahead log to the pool (NULL detached it). From then on
+ * every page marked dirty was logged when unpinned, and written back only
+ * after its log record was durable.
+ */
+RC setPoolLog(BM_BufferPool *const bm, WAL_Log *log)
+{
+    if (!bm || !bm->mgmtData)
+        return RC_ERROR;
+
+    BM_MgmtData *mgmt = (BM_MgmtData*) bm->mgmtData;
+    if ((mgmt->log != NULL) != (log != NULL))
+        registerPool(bm, log != NULL);
+    pthread_mutex_lock(&mgmt->lock);
+    mgmt->log = log;
+    pthread_mutex_unlock(&mgmt->lock);
+    return RC_OK;
+}
+
+/*
+ * checkpointLog
+ * -------------
+ * Took a fuzzy checkpoint of a log: collected every page with log records not
+ * written back yet from the pools using the log, together with its recLSN,
+ * made what those pools had already written back durable, and logged the
+ * table. Nothing waited for writers. The only pages written were unpinned
+ * ones that had stayed dirty since before the previous checkpoint, so a hot
+ * page could not hold the start of redo back forever.
+ */
+RC checkpointLog(WAL_Log *log)
+{
+    WAL_DirtyPage *dirty = NULL;
+    int numDirty = 0, capDirty = 0;
+    RC rc = RC_OK;
+
+    if (!log)
+        return RC_ERROR;
+    LSN previous = getLastCheckpointLSN(log);
+
+    pthread_mutex_lock(&loggedPoolsLock);
+    for (int p = 0; p < numLoggedPools && rc == RC_OK; p++)
+    {
+        BM_BufferPool *bm = loggedPools[p];
+        BM_MgmtData *mgmt = (BM_MgmtData*) bm->mgmtData;
+        pthread_mutex_lock(&mgmt->lock);
+        if (mgmt->log != log)
         {
-            RC rc = writeDirtyPageToDisk(bm, &mgmt->frames[freeIndex]);
-            if (rc != RC_OK)
-                return rc;
-            mgmt->frames[freeIndex].dirty = false;
+            pthread_mutex_unlock(&mgmt->lock);
+            continue;
         }
 
-        // Read from disk
-        SM_FileHandle fh;
-        if (openPageFile(bm->pageFile, &fh) != RC_OK)
-            return RC_ERROR;
-
-        // If the frame had no data allocated yet, allocated
-        if (!mgmt->frames[freeIndex].data)
-            mgmt->frames[freeIndex].data = calloc(PAGE_SIZE, sizeof(char));
-
-        // Ensured capacity, then read
-        if (ensureCapacity(pageNum+1, &fh) != RC_OK)
-            return RC_ERROR;
-
-        fseek(fh.mgmtInfo, pageNum * PAGE_SIZE, SEEK_SET);
-        size_t ret = fread(mgmt->frames[freeIndex].data, 1, PAGE_SIZE, fh.mgmtInfo);
-        if (ret < PAGE_SIZE)
-            memset(mgmt->frames[freeIndex].data + ret, 0, PAGE_SIZE - ret);
-        mgmt->readIO++;
-        closePageFile(&fh);
-
-        // Updated the frame info
-        mgmt->frames[freeIndex].pageNum  = pageNum;
-        mgmt->frames[freeIndex].dirty    = false;
-        mgmt->frames[freeIndex].fixCount = 1;
-        mgmt->frames[freeIndex].usage    = 1;
-
-        // Returned via page handle
-        page->data    = mgmt->frames[freeIndex].data;
-        page->pageNum = pageNum;
-        return RC_OK;
+        for (int i = 0; i < bm->numPages; i++)
+        {
+            PageFrame *pf = &mgmt->frames[i];
+            if (pf->recLSN == WAL_NO_LSN)
+                continue;
+            if (previous != WAL_NO_LSN && pf->recLSN < previous && pf->fixCount == 0 && !pf->logPending)
+            {
+                rc = writeDirtyPageToDisk(bm, mgmt, pf);
+                if (rc != RC_OK)
+                    break;
+                // Records logged while it was written still belonged in the table
+                if (pf->recLSN == WAL_NO_LSN)
+                    continue;
+            }
+            if (numDirty == capDirty)
+            {
+                capDirty = (capDirty > 0) ? 2 * capDirty : 16;
+                WAL_DirtyPage *grown = (WAL_DirtyPage*) realloc(dirty, capDirty * sizeof(WAL_DirtyPage));
+                if (!grown)
+                {
+                    rc = RC_MEMORY_ALLOCATION_ERROR;
+                    break;
+                }
+                dirty = grown;
+            }
+            dirty[numDirty].pageFile = bm->pageFile;
+            dirty[numDirty].pageNum  = (pf->evicting != NO_PAGE) ? pf->evicting : pf->pageNum;
+            dirty[numDirty].recLSN   = pf->recLSN;
+            numDirty++;
+        }
+        pthread_mutex_unlock(&mgmt->lock);
+
+        // Pages written back before the table was collected had to be durable
+        if (syncPageFile(&mgmt->fh) != RC_OK)
+            rc = RC_WRITE_FAILED;
     }
+
+    // The names pointed into the pools, so they stayed registered until logged
+    if (rc == RC_OK)
+        rc = logCheckpoint(log, dirty, numDirty, NULL);
+    pthread_mutex_unlock(&loggedPoolsLock);
+
+    free(dirty);
+    return rc;
 }
 
 /*
@@ -330,6 +502,7 @@ PageNumber *getFrameContents(BM_BufferPool *const bm)
     BM_MgmtData *mgmt = (BM_MgmtData*) bm->mgmtData;
 
     PageNumber *arr = malloc(sizeof(PageNumber) * bm->numPages);
+    pthread_mutex_lock(&mgmt->lock);
     for (int i=0; i<bm->numPages; i++)
     {
         if (mgmt->frames[i].pageNum == -1)
@@ -337,6 +510,7 @@ PageNumber *getFrameContents(BM_BufferPool *const bm)
         else
             arr[i] = mgmt->frames[i].pageNum;
     }
+    pthread_mutex_unlock(&mgmt->lock);
     return arr;
 }
 
@@ -352,8 +526,10 @@ bool *getDirtyFlags(BM_BufferPool *const bm)
     BM_MgmtData *mgmt = (BM_MgmtData*) bm->mgmtData;
 
     bool *arr = malloc(sizeof(bool)*bm->numPages);
+    pthread_mutex_lock(&mgmt->lock);
     for (int i=0; i<bm->numPages; i++)
         arr[i] = mgmt->frames[i].dirty;
+    pthread_mutex_unlock(&mgmt->lock);
     return arr;
 }
 
@@ -369,8 +545,10 @@ int *getFixCounts(BM_BufferPool *const bm)
     BM_MgmtData *mgmt = (BM_MgmtData*) bm->mgmtData;
 
     int *arr = malloc(sizeof(int)*bm->numPages);
+    pthread_mutex_lock(&mgmt->lock);
     for (int i=0; i<bm->numPages; i++)
         arr[i] = mgmt->frames[i].fixCount;
+    pthread_mutex_unlock(&mgmt->lock);
     return arr;
 }
 
@@ -384,7 +562,10 @@ int getNumReadIO(BM_BufferPool *const bm)
     if (!bm || !bm->mgmtData)
         return 0;
     BM_MgmtData *mgmt = (BM_MgmtData*) bm->mgmtData;
-    return mgmt->readIO;
+    pthread_mutex_lock(&mgmt->lock);
+    int n = mgmt->readIO;
+    pthread_mutex_unlock(&mgmt->lock);
+    return n;
 }
 
 /*
@@ -397,7 +578,10 @@ int getNumWriteIO(BM_BufferPool *const bm)
     if (!bm || !bm->mgmtData)
         return 0;
     BM_MgmtData *mgmt = (BM_MgmtData*) bm->mgmtData;
-    return mgmt->writeIO;
+    pthread_mutex_lock(&mgmt->lock);
+    int n = mgmt->writeIO;
+    pthread_mutex_unlock(&mgmt->lock);
+    return n;
 }
 
 /*
@@ -425,6 +609,11 @@ static RC initPageFrameArray(BM_MgmtData *mgmt, int numPages)
         mgmt->frames[i].dirty    = false;
         mgmt->frames[i].fixCount = 0;
         mgmt->frames[i].usage    = 0;
+        mgmt->frames[i].logPending = false;
+        mgmt->frames[i].pageLSN  = WAL_NO_LSN;
+        mgmt->frames[i].recLSN   = WAL_NO_LSN;
+        mgmt->frames[i].loading  = false;
+        mgmt->frames[i].evicting = NO_PAGE;
     }
     return RC_OK;
 }
@@ -464,7 +653,7 @@ static int findFreeFrame(BM_MgmtData *mgmt, int numPages)
  * findVictimFrame
  * ---------------
  * For a simple LRU: picked the frame with the smallest usage among those
- * with fixCount=0. If all pinned => returned 0 as fallback.
+ * with fixCount=0. If all pinned => returned -1 (the pin failed).
  */
 static int findVictimFrame(BM_BufferPool *bm, BM_MgmtData *mgmt)
 {
@@ -481,31 +670,278 @@ static int findVictimFrame(BM_BufferPool *bm, BM_MgmtData *mgmt)
             }
         }
     }
-    // if all pinned => fallback to index 0
-    if (victimIndex < 0)
-        victimIndex = 0;
     return victimIndex;
 }
 
+/*
+ * findEvictingFrame
+ * -----------------
+ * Looked for a frame writing back the given page as the victim of a load.
+ * Returned the index or -1 if not found.
+ */
+static int findEvictingFrame(BM_MgmtData *mgmt, int numPages, PageNumber pageNum)
+{
+    for (int i=0; i<numPages; i++)
+    {
+        if (mgmt->frames[i].loading && mgmt->frames[i].evicting == pageNum)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * loadFrame
+ * ---------
+ * Read a page into a free or victim frame, writing the victim back first if
+ * it was dirty. Called with the pool's mutex held, which it released for the
+ * I/O: the frame was marked loading (and pinned, so it was not picked again)
+ * until the page was in, and the mutex was held again on return. If the
+ * victim could not be written back, it stayed in the frame.
+ */
+static RC loadFrame(BM_BufferPool *bm, BM_MgmtData *mgmt, int freeIndex, PageNumber pageNum, BM_PageHandle *page)
+{
+    PageFrame *pf = &mgmt->frames[freeIndex];
+    RC rc = RC_OK;
+
+    // The victim's last changes were logged before the mutex was released
+    PageNumber victim = pf->dirty ? pf->pageNum : NO_PAGE;
+    if (victim != NO_PAGE && mgmt->log && pf->logPending)
+    {
+        rc = logFrame(bm, pf);
+        if (rc != RC_OK)
+            return rc;
+    }
+    WAL_Log *log = mgmt->log;
+    LSN victimLSN = pf->pageLSN;
+
+    // If the frame had no data allocated yet, allocated
+    if (!pf->data)
+        pf->data = calloc(PAGE_SIZE, sizeof(char));
+    if (!pf->data)
+        return RC_MEMORY_ALLOCATION_ERROR;
+
+    // Claimed the frame for the page
+    pf->pageNum    = pageNum;
+    pf->evicting   = victim;
+    pf->loading    = true;
+    pf->dirty      = false;
+    pf->fixCount   = 1;
+    pf->usage      = 1;
+    pf->logPending = false;
+    if (victim == NO_PAGE)
+        pf->recLSN = WAL_NO_LSN;
+    pthread_mutex_unlock(&mgmt->lock);
+
+    // Wrote the victim back (write-ahead rule: its log record went out first),
+    // then read the page over it
+    bool written = false;
+    if (victim != NO_PAGE)
+    {
+        if (log)
+            rc = flushLog(log, victimLSN);
+        if (rc == RC_OK)
+            rc = writePage(mgmt, victim, pf->data);
+        written = (rc == RC_OK);
+    }
+    if (rc == RC_OK)
+        rc = readPage(mgmt, pageNum, pf->data);
+
+    pthread_mutex_lock(&mgmt->lock);
+    if (victim != NO_PAGE)
+        mgmt->writeIO++;
+    if (written)
+        pf->recLSN = WAL_NO_LSN;
+    pf->loading  = false;
+    pf->evicting = NO_PAGE;
+    pthread_cond_broadcast(&mgmt->loaded);
+
+    if (rc != RC_OK)
+    {
+        if (victim != NO_PAGE && !written)
+        {
+            pf->pageNum = victim;
+            pf->dirty   = true;
+        }
+        else
+            pf->pageNum = NO_PAGE;
+        pf->fixCount = 0;
+        return rc;
+    }
+    mgmt->readIO++;
+    pf->pageLSN = WAL_NO_LSN;
+
+    // Returned via page handle
+    page->data    = pf->data;
+    page->pageNum = pageNum;
+    return RC_OK;
+}
+
 /*
  * writeDirtyPageToDisk
  * --------------------
- * Opened the file, sought to pf->pageNum * PAGE_SIZE, wrote pf->data, closed,
- * incremented mgmt->writeIO. Returned RC_OK if we wrote exactly PAGE_SIZE bytes,
- * else RC_ERROR.
+ * Wrote pf->data to block pf->pageNum of the pool's page file and
+ * incremented mgmt->writeIO. It was called with the mutex held and released
+ * it for the I/O: the frame stayed pinned meanwhile and was marked clean up
+ * front, so a change made during the write dirtied it again. recLSN was only
+ * cleared if nothing had been logged for the page since the write started.
+ * Returned RC_OK if the block was written, else RC_ERROR (the page stayed
+ * dirty).
  */
-static RC writeDirtyPageToDisk(BM_BufferPool *bm, PageFrame *pf)
+static RC writeDirtyPageToDisk(BM_BufferPool *bm, BM_MgmtData *mgmt, PageFrame *pf)
 {
-    SM_FileHandle fh;
-    if (openPageFile(bm->pageFile, &fh) != RC_OK)
-        return RC_FILE_NOT_FOUND;
+    // Write-ahead rule: the log record for the page went out first
+    if (mgmt->log && pf->logPending)
+    {
+        RC rc = logFrame(bm, pf);
+        if (rc != RC_OK)
+            return rc;
+    }
 
-    fseek(fh.mgmtInfo, pf->pageNum * PAGE_SIZE, SEEK_SET);
-    size_t wrote = fwrite(pf->data, 1, PAGE_SIZE, fh.mgmtInfo);
-    fclose(fh.mgmtInfo);
+    WAL_Log *log = mgmt->log;
+    PageNumber pageNum = pf->pageNum;
+    LSN pageLSN = pf->pageLSN, recLSN = pf->recLSN;
+    pf->fixCount++;
+    pf->dirty = false;
+    pthread_mutex_unlock(&mgmt->lock);
 
-    BM_MgmtData *mgmt = (BM_MgmtData*) bm->mgmtData;
+    RC rc = log ? flushLog(log, pageLSN) : RC_OK;
+    if (rc == RC_OK)
+        rc = (writePage(mgmt, pageNum, pf->data) == RC_OK) ? RC_OK : RC_ERROR;
+
+    pthread_mutex_lock(&mgmt->lock);
     mgmt->writeIO++;
+    pf->fixCount--;
+    if (rc != RC_OK)
+        pf->dirty = true;
+    else if (pf->recLSN == recLSN && pf->pageLSN == pageLSN)
+        pf->recLSN = WAL_NO_LSN;
+    return rc;
+}
+
+/*
+ * growFile
+ * --------
+ * Made sure the page file reached a page, taking ioLock exclusively only if
+ * the file had to grow.
+ */
+static RC growFile(BM_MgmtData *mgmt, PageNumber pageNum)
+{
+    pthread_rwlock_rdlock(&mgmt->ioLock);
+    bool there = (pageNum < mgmt->fh.totalNumPages);
+    pthread_rwlock_unlock(&mgmt->ioLock);
+    if (there)
+        return RC_OK;
 
-    return (wrote == PAGE_SIZE) ? RC_OK : RC_ERROR;
-}
\ No newline at end of file
+    pthread_rwlock_wrlock(&mgmt->ioLock);
+    RC rc = ensureCapacity(pageNum + 1, &mgmt->fh);
+    pthread_rwlock_unlock(&mgmt->ioLock);
+    return rc;
+}
+
+/*
+ * readPage
+ * --------
+ * Read a page of the pool's file into a frame's buffer (without the pool's
+ * mutex), growing the file if the page was past its end.
+ */
+static RC readPage(BM_MgmtData *mgmt, PageNumber pageNum, char *data)
+{
+    if (growFile(mgmt, pageNum) != RC_OK)
+        return RC_ERROR;
+
+    pthread_rwlock_rdlock(&mgmt->ioLock);
+    RC rc = readBlock(pageNum, &mgmt->fh, data);
+    pthread_rwlock_unlock(&mgmt->ioLock);
+    return (rc == RC_OK) ? RC_OK : RC_ERROR;
+}
+
+/*
+ * writePage
+ * ---------
+ * Wrote a frame's buffer to a page of the pool's file. The page could be past
+ * the end if it was pinned but never read.
+ */
+static RC writePage(BM_MgmtData *mgmt, PageNumber pageNum, char *data)
+{
+    RC rc = growFile(mgmt, pageNum);
+    if (rc != RC_OK)
+        return rc;
+
+    pthread_rwlock_rdlock(&mgmt->ioLock);
+    rc = writeBlock(pageNum, &mgmt->fh, data);
+    pthread_rwlock_unlock(&mgmt->ioLock);
+    return rc;
+}
+
+/*
+ * logFrame
+ * --------
+ * Appended the current image of a frame's page to the log and stamped the
+ * frame with the record's LSN.
+ */
+static RC logFrame(BM_BufferPool *bm, PageFrame *pf)
+{
+    BM_MgmtData *mgmt = (BM_MgmtData*) bm->mgmtData;
+    RC rc = logPageImage(mgmt->log, bm->pageFile, pf->pageNum, pf->data, &pf->pageLSN);
+    if (rc != RC_OK)
+        return rc;
+    pf->logPending = false;
+    if (pf->recLSN == WAL_NO_LSN)
+        pf->recLSN = pf->pageLSN;
+    return RC_OK;
+}
+
+/*
+ * checkpointIfDue
+ * ---------------
+ * Checkpointed automatically once enough log had been written since the last
+ * checkpoint. Called without any pool's mutex held, since checkpointLog took
+ * the mutexes of every pool using the log.
+ */
+static RC checkpointIfDue(WAL_Log *log, LSN lsn)
+{
+    if (log == NULL || log->checkpointInterval <= 0)
+        return RC_OK;
+
+    LSN last = getLastCheckpointLSN(log);
+    if (lsn - ((last == WAL_NO_LSN) ? 0 : last) >= log->checkpointInterval)
+        return checkpointLog(log);
+    return RC_OK;
+}
+
+/*
+ * registerPool
+ * ------------
+ * Added a pool to (or removed it from) the pools checkpointLog looked at.
+ */
+static void registerPool(BM_BufferPool *bm, bool logged)
+{
+    pthread_mutex_lock(&loggedPoolsLock);
+    if (logged)
+    {
+        if (numLoggedPools == capLoggedPools)
+        {
+            int cap = (capLoggedPools > 0) ? 2 * capLoggedPools : 8;
+            BM_BufferPool **grown = (BM_BufferPool**) realloc(loggedPools, cap * sizeof(BM_BufferPool*));
+            if (grown)
+            {
+                loggedPools = grown;
+                capLoggedPools = cap;
+            }
+        }
+        if (numLoggedPools < capLoggedPools)
+            loggedPools[numLoggedPools++] = bm;
+    }
+    else
+    {
+        for (int i = 0; i < numLoggedPools; i++)
+        {
+            if (loggedPools[i] == bm)
+            {
+                loggedPools[i] = loggedPools[--numLoggedPools];
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&loggedPoolsLock);
+}
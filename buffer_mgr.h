@@ -7,6 +7,9 @@
 // Include bool DT
 #include "dt.h"
 
+// Include the write-ahead log
+#include "wal_mgr.h"
+
 // Replacement Strategies
 typedef enum ReplacementStrategy {
 	RS_FIFO = 0,
@@ -54,6 +57,10 @@ RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
 		const PageNumber pageNum);
 
+// Write-ahead logging (pages were logged on unpin, the log forced before write-back)
+RC setPoolLog (BM_BufferPool *const bm, WAL_Log *log);
+RC checkpointLog (WAL_Log *log);
+
 // Statistics Interface
 PageNumber *getFrameContents (BM_BufferPool *const bm);
 bool *getDirtyFlags (BM_BufferPool *const bm);
@@ -23,6 +23,21 @@ typedef int RC;
 #define RC_RM_NO_PRINT_FOR_DATATYPE 204
 #define RC_RM_UNKOWN_DATATYPE 205
 #define RC_INVALID_FILENAME 206
+#define RC_RM_PAGE_FULL 207
+#define RC_RM_RECORD_TOO_LARGE 208
+#define RC_RM_NO_SUCH_ATTR 209
+#define RC_RM_NO_INDEX 210
+#define RC_RM_SNAPSHOT_OPEN 211
+#define RC_RM_NO_STATS 212
+#define RC_RM_BAD_ROW 213
+#define RC_RM_BAD_EXPORT_FILE 214
+#define RC_RM_DICT_FULL 215
+#define RC_RM_BAD_DICT_ATTR 216
+#define RC_RM_BAD_PARTITION 217
+#define RC_RM_NO_PARTITION 218
+#define RC_RM_ARENA_FULL 219
+#define RC_RM_BAD_BLOB 220
+#define RC_RM_BAD_BLOB_ATTR 221
 
 #define RC_IM_KEY_NOT_FOUND 300
 #define RC_IM_KEY_ALREADY_EXISTS 301
@@ -37,6 +52,7 @@ typedef int RC;
 #define PAGE_FRAME_ERROR 401
 #define RC_PINNED_PAGES_IN_BUFFER 402
 #define RC_ERROR 403
+#define RC_BM_NO_FREE_FRAME 404
 
 /* holder for error messages */
 extern char *RC_message;
@@ -0,0 +1,896 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "export_mgr.h"
+#include "record_mgr.h"
+#include "rm_zonemap.h"
+#include "dberror.h"
+#include "expr.h"
+#include "tables.h"
+
+/*
+ * export_mgr.c
+ * ---------------------------------------------------------------
+ * Columnar export files (see export_mgr.h for the layout).
+ *
+ * The writer collected a row group of records, then encoded it one attribute
+ * at a time. The min and max of the chunks were kept in an RM_ZoneMap with
+ * the row group number in place of the page number: the writer widened it
+ * with every record, and the reader refilled it from the footer, so row
+ * groups were skipped exactly like zone-mapped pages.
+ */
+
+#define EXPORT_MAGIC        "RMCOLv1"       // 8 bytes with its '\0'
+#define EXPORT_MAGIC_LEN    8
+#define EXPORT_TRAILER_LEN  (4 + 8 + EXPORT_MAGIC_LEN)
+
+/* Chunk encodings */
+#define ENC_PLAIN   0
+#define ENC_RLE     1
+#define ENC_DICT    2
+
+/* Most distinct values a dictionary chunk held (its codes took 2 bytes). */
+#define EXPORT_DICT_MAX 65535
+
+/* The most "attribute <op> constant" terms a column scan skipped row groups with. */
+#define EXPORT_MAX_PREDS 8
+
+/* This structure stored the state of an export in progress. */
+typedef struct ExportWriter {
+    FILE *file;
+    Schema *schema;
+    int recordSize;
+    char *rows;             // the row group being collected
+    int numRows;
+    char *chunk;            // the chunk being encoded
+    int chunkCap;
+    char *footer;           // the footer so far
+    size_t footerLen;
+    size_t footerCap;
+    int numGroups;
+    long long pos;          // bytes written so far
+    RM_ZoneMap zones;       // min and max of every chunk
+    int *dictSlots;         // hash table of the dictionary encoder
+    int *dictValues;        // row of each distinct value, in order of appearance
+} ExportWriter;
+
+/* This structure stored an open export file. */
+typedef struct ColumnFileData {
+    FILE *file;
+    int *groupRows;
+    long long *chunkOffset;     // numRowGroups * numAttr entries
+    int *chunkLength;
+    int *chunkEncoding;
+    RM_ZoneMap zones;
+} ColumnFileData;
+
+/* This structure stored the state of a column scan. */
+typedef struct ColumnScanData {
+    Expr *cond;
+    bool *needAttr;
+    AttrPredicate preds[EXPORT_MAX_PREDS];
+    int numPreds;
+    int group;              // row group being returned, -1 before the first
+    int row;
+    char **values;          // per needed attribute: the group's values, side by side
+    char *chunk;
+    int chunkCap;
+} ColumnScanData;
+
+/* --------------------------------------------------------------------------
+   Values
+   -------------------------------------------------------------------------- */
+
+/*
+ * plainSize
+ * ---------
+ * Returned the size of a value (in record->data format) in plain encoding.
+ */
+static int plainSize(DataType dt, const char *raw, int width)
+{
+    if (dt == DT_STRING)
+        return (int) sizeof(unsigned short) + (int) strnlen(raw, width);
+    return width;
+}
+
+/*
+ * writePlain
+ * ----------
+ * Wrote a value in plain encoding and returned its size.
+ */
+static int writePlain(DataType dt, const char *raw, int width, char *out)
+{
+    if (dt != DT_STRING)
+    {
+        memcpy(out, raw, width);
+        return width;
+    }
+    unsigned short len = (unsigned short) strnlen(raw, width);
+    memcpy(out, &len, sizeof(len));
+    memcpy(out + sizeof(len), raw, len);
+    return (int) sizeof(len) + len;
+}
+
+/*
+ * readPlain
+ * ---------
+ * Read a value in plain encoding back into record->data format. Returned the
+ * bytes it took, or -1 if it ran past 'end' or did not fit the attribute.
+ */
+static int readPlain(DataType dt, const char *src, const char *end, int width, char *dest)
+{
+    if (dt != DT_STRING)
+    {
+        if (end - src < width)
+            return -1;
+        memcpy(dest, src, width);
+        return width;
+    }
+    unsigned short len;
+    if (end - src < (int) sizeof(len))
+        return -1;
+    memcpy(&len, src, sizeof(len));
+    if (len > width || end - src < (int) sizeof(len) + len)
+        return -1;
+    memset(dest, 0, width);
+    memcpy(dest, src + sizeof(len), len);
+    return (int) sizeof(len) + len;
+}
+
+/* --------------------------------------------------------------------------
+   Writing
+   -------------------------------------------------------------------------- */
+
+/*
+ * emit
+ * ----
+ * Appended bytes to the file.
+ */
+static void emit(ExportWriter *w, const void *bytes, size_t len)
+{
+    fwrite(bytes, 1, len, w->file);
+    w->pos += (long long) len;
+}
+
+/*
+ * toFooter
+ * --------
+ * Appended bytes to the footer kept in memory.
+ */
+static void toFooter(ExportWriter *w, const void *bytes, size_t len)
+{
+    if (w->footerLen + len > w->footerCap)
+    {
+        w->footerCap = 2 * w->footerCap + len;
+        w->footer = (char *) realloc(w->footer, w->footerCap);
+    }
+    memcpy(w->footer + w->footerLen, bytes, len);
+    w->footerLen += len;
+}
+
+/*
+ * writeHeader
+ * -----------
+ * Wrote the magic and the schema.
+ */
+static void writeHeader(ExportWriter *w)
+{
+    Schema *sc = w->schema;
+    emit(w, EXPORT_MAGIC, EXPORT_MAGIC_LEN);
+    emit(w, &sc->numAttr, sizeof(int));
+    for (int i = 0; i < sc->numAttr; i++)
+    {
+        int dt = sc->dataTypes[i];
+        unsigned short nameLen = (unsigned short) strlen(sc->attrNames[i]);
+        emit(w, &dt, sizeof(int));
+        emit(w, &sc->typeLength[i], sizeof(int));
+        emit(w, &nameLen, sizeof(nameLen));
+        emit(w, sc->attrNames[i], nameLen);
+    }
+    emit(w, &sc->keySize, sizeof(int));
+    if (sc->keySize > 0)
+        emit(w, sc->keyAttrs, sc->keySize * sizeof(int));
+}
+
+/*
+ * dictionarySize
+ * --------------
+ * Collected the distinct values of a column of the row group into
+ * w->dictValues (rows of their first appearance) and returned the size of the
+ * dictionary encoding, or -1 if there were too many. *numDistinct was set.
+ */
+static int dictionarySize(ExportWriter *w, DataType dt, int off, int width, int *numDistinct)
+{
+    int numSlots = 1;
+    while (numSlots < 2 * w->numRows)
+        numSlots *= 2;
+    for (int s = 0; s < numSlots; s++)
+        w->dictSlots[s] = -1;
+
+    int distinct = 0, size = (int) sizeof(int) + 1;
+    for (int r = 0; r < w->numRows; r++)
+    {
+        const char *v = w->rows + (size_t) r * w->recordSize + off;
+        unsigned h = 2166136261u;
+        for (int b = 0; b < width; b++)
+            h = (h ^ (unsigned char) v[b]) * 16777619u;
+
+        int s = h & (numSlots - 1);
+        while (w->dictSlots[s] >= 0)
+        {
+            const char *known = w->rows + (size_t) w->dictValues[w->dictSlots[s]] * w->recordSize + off;
+            if (memcmp(known, v, width) == 0)
+                break;
+            s = (s + 1) & (numSlots - 1);
+        }
+        if (w->dictSlots[s] < 0)
+        {
+            if (distinct == EXPORT_DICT_MAX)
+                return -1;
+            w->dictSlots[s] = distinct;
+            w->dictValues[distinct++] = r;
+            size += plainSize(dt, v, width);
+        }
+    }
+    *numDistinct = distinct;
+    return size + w->numRows * ((distinct <= 256) ? 1 : 2);
+}
+
+/*
+ * dictionaryCode
+ * --------------
+ * Found the code of a value in the dictionary built by dictionarySize.
+ */
+static int dictionaryCode(ExportWriter *w, const char *v, int off, int width)
+{
+    int numSlots = 1;
+    while (numSlots < 2 * w->numRows)
+        numSlots *= 2;
+
+    unsigned h = 2166136261u;
+    for (int b = 0; b < width; b++)
+        h = (h ^ (unsigned char) v[b]) * 16777619u;
+    int s = h & (numSlots - 1);
+    while (true)
+    {
+        int code = w->dictSlots[s];
+        const char *known = w->rows + (size_t) w->dictValues[code] * w->recordSize + off;
+        if (memcmp(known, v, width) == 0)
+            return code;
+        s = (s + 1) & (numSlots - 1);
+    }
+}
+
+/*
+ * encodeChunk
+ * -----------
+ * Encoded one attribute of the row group into w->chunk with the smallest of
+ * the three encodings. Returned the chunk's length and set *encoding.
+ */
+static int encodeChunk(ExportWriter *w, int attr, int *encoding)
+{
+    Schema *sc = w->schema;
+    DataType dt = sc->dataTypes[attr];
+    int off = sc->attrOffsets[attr], width = getAttrSize(sc, attr);
+    int plain = 0, rle = 0, dict, distinct = 0;
+    const char *prev = NULL;
+
+    for (int r = 0; r < w->numRows; r++)
+    {
+        const char *v = w->rows + (size_t) r * w->recordSize + off;
+        plain += plainSize(dt, v, width);
+        if (prev == NULL || memcmp(prev, v, width) != 0)
+            rle += (int) sizeof(int) + plainSize(dt, v, width);
+        prev = v;
+    }
+    dict = dictionarySize(w, dt, off, width, &distinct);
+
+    *encoding = ENC_PLAIN;
+    int size = plain;
+    if (rle < size)
+    {
+        *encoding = ENC_RLE;
+        size = rle;
+    }
+    if (dict >= 0 && dict < size)
+    {
+        *encoding = ENC_DICT;
+        size = dict;
+    }
+    if (size > w->chunkCap)
+    {
+        w->chunkCap = size;
+        w->chunk = (char *) realloc(w->chunk, w->chunkCap);
+    }
+
+    char *out = w->chunk;
+    switch (*encoding)
+    {
+        case ENC_PLAIN:
+            for (int r = 0; r < w->numRows; r++)
+                out += writePlain(dt, w->rows + (size_t) r * w->recordSize + off, width, out);
+            break;
+        case ENC_RLE:
+            for (int r = 0; r < w->numRows; )
+            {
+                const char *v = w->rows + (size_t) r * w->recordSize + off;
+                int run = 1;
+                while (r + run < w->numRows
+                       && memcmp(w->rows + (size_t) (r + run) * w->recordSize + off, v, width) == 0)
+                    run++;
+                memcpy(out, &run, sizeof(int));
+                out += sizeof(int);
+                out += writePlain(dt, v, width, out);
+                r += run;
+            }
+            break;
+        case ENC_DICT:
+        {
+            char codeWidth = (distinct <= 256) ? 1 : 2;
+            memcpy(out, &distinct, sizeof(int));
+            out += sizeof(int);
+            for (int d = 0; d < distinct; d++)
+                out += writePlain(dt, w->rows + (size_t) w->dictValues[d] * w->recordSize + off, width, out);
+            *out++ = codeWidth;
+            for (int r = 0; r < w->numRows; r++)
+            {
+                int code = dictionaryCode(w, w->rows + (size_t) r * w->recordSize + off, off, width);
+                if (codeWidth == 1)
+                    *out++ = (char) (unsigned char) code;
+                else
+                {
+                    unsigned short c = (unsigned short) code;
+                    memcpy(out, &c, sizeof(c));
+                    out += sizeof(c);
+                }
+            }
+            break;
+        }
+    }
+    return (int) (out - w->chunk);
+}
+
+/*
+ * flushGroup
+ * ----------
+ * Wrote the collected row group, one chunk per attribute, and added its
+ * entries to the footer.
+ */
+static void flushGroup(ExportWriter *w)
+{
+    Schema *sc = w->schema;
+    if (w->numRows == 0)
+        return;
+
+    int group = w->numGroups++;
+    char *entry = w->zones.entries + (size_t) group * w->zones.entrySize;
+    toFooter(w, &w->numRows, sizeof(int));
+    for (int i = 0; i < sc->numAttr; i++)
+    {
+        int encoding;
+        int len = encodeChunk(w, i, &encoding);
+        long long offset = w->pos;
+        emit(w, w->chunk, len);
+
+        toFooter(w, &offset, sizeof(offset));
+        toFooter(w, &len, sizeof(int));
+        toFooter(w, &encoding, sizeof(int));
+        toFooter(w, entry + w->zones.valOffset[i], 2 * getAttrSize(sc, i));
+    }
+    w->numRows = 0;
+}
+
+/*
+ * exportScan
+ * ----------
+ * Wrote the records of a started scan to a new export file (see
+ * export_mgr.h), holding one row group in memory at a time.
+ */
+RC exportScan(RM_ScanHandle *scan, char *path)
+{
+    Schema *sc = scan->rel->schema;
+    ExportWriter w;
+    Record *r;
+    int attrs[sc->numAttr > 0 ? sc->numAttr : 1];
+    RC rc;
+
+    memset(&w, 0, sizeof(w));
+    w.file = fopen(path, "wb");
+    if (w.file == NULL)
+        return RC_FILE_NOT_FOUND;
+    w.schema = sc;
+    w.recordSize = getRecordSize(sc);
+    w.rows = (char *) malloc((size_t) RM_EXPORT_GROUP_ROWS * w.recordSize);
+    w.dictSlots = (int *) malloc(2 * RM_EXPORT_GROUP_ROWS * sizeof(int));
+    w.dictValues = (int *) malloc(RM_EXPORT_GROUP_ROWS * sizeof(int));
+    for (int i = 0; i < sc->numAttr; i++)
+        attrs[i] = i;
+    rmZoneInit(&w.zones, sc, sc->numAttr, attrs);
+    writeHeader(&w);
+
+    createRecord(&r, sc);
+    while ((rc = next(scan, r)) == RC_OK)
+    {
+        rmZoneReserve(&w.zones, w.numGroups + 1);
+        rmZoneAdd(&w.zones, sc, w.numGroups, r->data);
+        memcpy(w.rows + (size_t) w.numRows * w.recordSize, r->data, w.recordSize);
+        if (++w.numRows == RM_EXPORT_GROUP_ROWS)
+            flushGroup(&w);
+    }
+    freeRecord(r);
+
+    if (rc == RC_RM_NO_MORE_TUPLES)
+    {
+        flushGroup(&w);
+        long long footerStart = w.pos;
+        emit(&w, w.footer, w.footerLen);
+        emit(&w, &w.numGroups, sizeof(int));
+        emit(&w, &footerStart, sizeof(footerStart));
+        emit(&w, EXPORT_MAGIC, EXPORT_MAGIC_LEN);
+        rc = ferror(w.file) ? RC_WRITE_FAILED : RC_OK;
+    }
+    if (fclose(w.file) != 0 && rc == RC_OK)
+        rc = RC_WRITE_FAILED;
+
+    rmZoneFree(&w.zones);
+    free(w.rows);
+    free(w.chunk);
+    free(w.footer);
+    free(w.dictSlots);
+    free(w.dictValues);
+    return rc;
+}
+
+/*
+ * exportTable
+ * -----------
+ * Wrote every record of a table to a new export file.
+ */
+RC exportTable(RM_TableData *rel, char *path)
+{
+    RM_ScanHandle scan;
+    RC rc = startScan(rel, &scan, NULL);
+    if (rc != RC_OK)
+        return rc;
+    rc = exportScan(&scan, path);
+    RC closed = closeScan(&scan);
+    return (rc != RC_OK) ? rc : closed;
+}
+
+/* --------------------------------------------------------------------------
+   Reading
+   -------------------------------------------------------------------------- */
+
+/*
+ * readBytes
+ * ---------
+ * Read exactly len bytes, or returned false.
+ */
+static bool readBytes(FILE *f, void *dest, size_t len)
+{
+    return fread(dest, 1, len, f) == len;
+}
+
+/*
+ * readSchema
+ * ----------
+ * Read the schema after the magic of the header. Returned NULL if it was
+ * malformed.
+ */
+static Schema *readSchema(FILE *f)
+{
+    int numAttr, keySize;
+    if (!readBytes(f, &numAttr, sizeof(int)) || numAttr <= 0 || numAttr > 4096)
+        return NULL;
+
+    char **names = (char **) calloc(numAttr, sizeof(char *));
+    DataType *dataTypes = (DataType *) malloc(numAttr * sizeof(DataType));
+    int *typeLength = (int *) malloc(numAttr * sizeof(int));
+    int *keys = NULL;
+    bool ok = true;
+
+    for (int i = 0; i < numAttr && ok; i++)
+    {
+        int dt;
+        unsigned short nameLen;
+        ok = readBytes(f, &dt, sizeof(int)) && readBytes(f, &typeLength[i], sizeof(int))
+            && readBytes(f, &nameLen, sizeof(nameLen))
+            && dt >= DT_INT && dt <= DT_BOOL && typeLength[i] >= 0 && typeLength[i] < PAGE_SIZE;
+        if (!ok)
+            break;
+        dataTypes[i] = (DataType) dt;
+        names[i] = (char *) malloc(nameLen + 1);
+        ok = readBytes(f, names[i], nameLen);
+        names[i][nameLen] = '\0';
+    }
+    ok = ok && readBytes(f, &keySize, sizeof(int)) && keySize >= 0 && keySize <= numAttr;
+    if (ok)
+    {
+        keys = (int *) malloc((keySize > 0 ? keySize : 1) * sizeof(int));
+        ok = (keySize == 0 || readBytes(f, keys, keySize * sizeof(int)));
+    }
+
+    if (!ok)
+    {
+        for (int i = 0; i < numAttr; i++)
+            free(names[i]);
+        free(names);
+        free(dataTypes);
+        free(typeLength);
+        free(keys);
+        return NULL;
+    }
+    return createSchema(numAttr, names, dataTypes, typeLength, keySize, keys);
+}
+
+/*
+ * readFooter
+ * ----------
+ * Read the row group sizes and chunk entries, and refilled the zone map with
+ * the min and max of every chunk.
+ */
+static bool readFooter(RM_ColumnFile *cf, ColumnFileData *fd)
+{
+    Schema *sc = cf->schema;
+    int numGroups;
+    long long footerStart;
+    char magic[EXPORT_MAGIC_LEN];
+
+    if (fseek(fd->file, -EXPORT_TRAILER_LEN, SEEK_END) != 0
+        || !readBytes(fd->file, &numGroups, sizeof(int))
+        || !readBytes(fd->file, &footerStart, sizeof(footerStart))
+        || !readBytes(fd->file, magic, EXPORT_MAGIC_LEN)
+        || memcmp(magic, EXPORT_MAGIC, EXPORT_MAGIC_LEN) != 0
+        || numGroups < 0 || fseek(fd->file, (long) footerStart, SEEK_SET) != 0)
+        return false;
+
+    int numChunks = numGroups * sc->numAttr;
+    int recordSize = getRecordSize(sc);
+    char *bounds[2] = { (char *) calloc(1, recordSize), (char *) calloc(1, recordSize) };
+    bool ok = true;
+
+    cf->numRowGroups  = numGroups;
+    fd->groupRows     = (int *) malloc((numGroups > 0 ? numGroups : 1) * sizeof(int));
+    fd->chunkOffset   = (long long *) malloc((numChunks > 0 ? numChunks : 1) * sizeof(long long));
+    fd->chunkLength   = (int *) malloc((numChunks > 0 ? numChunks : 1) * sizeof(int));
+    fd->chunkEncoding = (int *) malloc((numChunks > 0 ? numChunks : 1) * sizeof(int));
+    rmZoneReserve(&fd->zones, numGroups);
+
+    for (int g = 0; g < numGroups && ok; g++)
+    {
+        ok = readBytes(fd->file, &fd->groupRows[g], sizeof(int))
+            && fd->groupRows[g] > 0 && fd->groupRows[g] <= RM_EXPORT_GROUP_ROWS;
+        cf->numRows += ok ? fd->groupRows[g] : 0;
+        for (int i = 0; i < sc->numAttr && ok; i++)
+        {
+            int c = g * sc->numAttr + i, width = getAttrSize(sc, i);
+            ok = readBytes(fd->file, &fd->chunkOffset[c], sizeof(long long))
+                && readBytes(fd->file, &fd->chunkLength[c], sizeof(int))
+                && readBytes(fd->file, &fd->chunkEncoding[c], sizeof(int))
+                && readBytes(fd->file, bounds[0] + sc->attrOffsets[i], width)
+                && readBytes(fd->file, bounds[1] + sc->attrOffsets[i], width)
+                && fd->chunkLength[c] >= 0;
+        }
+        // The chunk bounds, as two records, gave the row group its range
+        if (ok)
+        {
+            rmZoneAdd(&fd->zones, sc, g, bounds[0]);
+            rmZoneAdd(&fd->zones, sc, g, bounds[1]);
+        }
+    }
+    free(bounds[0]);
+    free(bounds[1]);
+    return ok;
+}
+
+/*
+ * openColumnFile
+ * --------------
+ * Opened an export file and read its schema and footer. The chunks stayed on
+ * disk until a scan needed them.
+ */
+RC openColumnFile(RM_ColumnFile *cf, char *path)
+{
+    ColumnFileData *fd = (ColumnFileData *) calloc(1, sizeof(ColumnFileData));
+    char magic[EXPORT_MAGIC_LEN];
+
+    memset(cf, 0, sizeof(*cf));
+    fd->file = fopen(path, "rb");
+    if (fd->file == NULL)
+    {
+        free(fd);
+        return RC_FILE_NOT_FOUND;
+    }
+    cf->mgmtData = fd;
+
+    if (readBytes(fd->file, magic, EXPORT_MAGIC_LEN) && memcmp(magic, EXPORT_MAGIC, EXPORT_MAGIC_LEN) == 0)
+        cf->schema = readSchema(fd->file);
+    if (cf->schema == NULL)
+    {
+        fclose(fd->file);
+        free(fd);
+        cf->mgmtData = NULL;
+        return RC_RM_BAD_EXPORT_FILE;
+    }
+
+    int attrs[cf->schema->numAttr];
+    for (int i = 0; i < cf->schema->numAttr; i++)
+        attrs[i] = i;
+    rmZoneInit(&fd->zones, cf->schema, cf->schema->numAttr, attrs);
+
+    if (!readFooter(cf, fd))
+    {
+        closeColumnFile(cf);
+        return RC_RM_BAD_EXPORT_FILE;
+    }
+    return RC_OK;
+}
+
+/*
+ * closeColumnFile
+ * ---------------
+ * Closed an export file and freed its schema.
+ */
+RC closeColumnFile(RM_ColumnFile *cf)
+{
+    ColumnFileData *fd = (ColumnFileData *) cf->mgmtData;
+    if (fd == NULL)
+        return RC_OK;
+
+    fclose(fd->file);
+    rmZoneFree(&fd->zones);
+    free(fd->groupRows);
+    free(fd->chunkOffset);
+    free(fd->chunkLength);
+    free(fd->chunkEncoding);
+    free(fd);
+    freeSchema(cf->schema);
+    cf->schema = NULL;
+    cf->mgmtData = NULL;
+    return RC_OK;
+}
+
+/*
+ * markAttrs
+ * ---------
+ * Marked the attributes a condition referred to.
+ */
+static void markAttrs(Expr *e, bool *needAttr)
+{
+    if (e == NULL)
+        return;
+    if (e->type == EXPR_ATTRREF)
+        needAttr[e->expr.attrRef] = true;
+    else if (e->type == EXPR_OP)
+    {
+        markAttrs(e->expr.op->args[0], needAttr);
+        if (e->expr.op->type != OP_BOOL_NOT)
+            markAttrs(e->expr.op->args[1], needAttr);
+    }
+}
+
+/*
+ * startColumnScan
+ * ---------------
+ * Started a scan of an export file that returned the given attributes (all of
+ * them if numAttrs was 0) of the records satisfying cond.
+ */
+RC startColumnScan(RM_ColumnFile *cf, int numAttrs, int *attrs, Expr *cond, RM_ColumnScan *scan)
+{
+    Schema *sc = cf->schema;
+    ColumnScanData *sd = (ColumnScanData *) calloc(1, sizeof(ColumnScanData));
+    int exact;
+
+    sd->cond = cond;
+    sd->group = -1;
+    sd->needAttr = (bool *) calloc(sc->numAttr, sizeof(bool));
+    sd->values = (char **) calloc(sc->numAttr, sizeof(char *));
+    for (int i = 0; i < sc->numAttr; i++)
+        sd->needAttr[i] = (numAttrs == 0);
+    for (int i = 0; i < numAttrs; i++)
+    {
+        if (attrs[i] < 0 || attrs[i] >= sc->numAttr)
+        {
+            free(sd->needAttr);
+            free(sd->values);
+            free(sd);
+            return RC_RM_NO_SUCH_ATTR;
+        }
+        sd->needAttr[attrs[i]] = true;
+    }
+    markAttrs(cond, sd->needAttr);
+    if (cond != NULL)
+        sd->numPreds = extractPredicates(cond, sd->preds, EXPORT_MAX_PREDS, &exact);
+
+    scan->file = cf;
+    scan->rowGroupsRead = 0;
+    scan->mgmtData = sd;
+    return RC_OK;
+}
+
+/*
+ * decodeChunk
+ * -----------
+ * Decoded the chunk of one attribute into numRows values side by side, in
+ * record->data format. Returned false if the chunk was malformed.
+ */
+static bool decodeChunk(int encoding, const char *src, int len, DataType dt, int width, int numRows, char *out)
+{
+    const char *end = src + len;
+    int used;
+
+    switch (encoding)
+    {
+        case ENC_PLAIN:
+            for (int r = 0; r < numRows; r++)
+            {
+                if ((used = readPlain(dt, src, end, width, out + (size_t) r * width)) < 0)
+                    return false;
+                src += used;
+            }
+            return true;
+        case ENC_RLE:
+            for (int r = 0; r < numRows; )
+            {
+                int run;
+                if (end - src < (int) sizeof(int))
+                    return false;
+                memcpy(&run, src, sizeof(int));
+                src += sizeof(int);
+                if (run <= 0 || run > numRows - r
+                    || (used = readPlain(dt, src, end, width, out + (size_t) r * width)) < 0)
+                    return false;
+                src += used;
+                for (int k = 1; k < run; k++)
+                    memcpy(out + (size_t) (r + k) * width, out + (size_t) r * width, width);
+                r += run;
+            }
+            return true;
+        case ENC_DICT:
+        {
+            int distinct;
+            if (end - src < (int) sizeof(int))
+                return false;
+            memcpy(&distinct, src, sizeof(int));
+            src += sizeof(int);
+            if (distinct <= 0 || distinct > EXPORT_DICT_MAX)
+                return false;
+
+            char *dict = (char *) malloc((size_t) distinct * width);
+            bool ok = true;
+            for (int d = 0; d < distinct && ok; d++)
+            {
+                ok = (used = readPlain(dt, src, end, width, dict + (size_t) d * width)) >= 0;
+                src += ok ? used : 0;
+            }
+            int codeWidth = (ok && src < end) ? *src++ : 0;
+            ok = ok && (codeWidth == 1 || codeWidth == 2) && end - src >= (long) numRows * codeWidth;
+            for (int r = 0; r < numRows && ok; r++)
+            {
+                int code;
+                if (codeWidth == 1)
+                    code = (unsigned char) src[r];
+                else
+                {
+                    unsigned short c;
+                    memcpy(&c, src + 2 * r, sizeof(c));
+                    code = c;
+                }
+                ok = (code < distinct);
+                if (ok)
+                    memcpy(out + (size_t) r * width, dict + (size_t) code * width, width);
+            }
+            free(dict);
+            return ok;
+        }
+    }
+    return false;
+}
+
+/*
+ * loadGroup
+ * ---------
+ * Read and decoded the chunks of the needed attributes of one row group.
+ */
+static RC loadGroup(RM_ColumnScan *scan, int group)
+{
+    RM_ColumnFile *cf = scan->file;
+    ColumnFileData *fd = (ColumnFileData *) cf->mgmtData;
+    ColumnScanData *sd = (ColumnScanData *) scan->mgmtData;
+    Schema *sc = cf->schema;
+    int numRows = fd->groupRows[group];
+
+    for (int i = 0; i < sc->numAttr; i++)
+    {
+        if (!sd->needAttr[i])
+            continue;
+        int c = group * sc->numAttr + i, width = getAttrSize(sc, i);
+        if (fd->chunkLength[c] > sd->chunkCap)
+        {
+            sd->chunkCap = fd->chunkLength[c];
+            sd->chunk = (char *) realloc(sd->chunk, sd->chunkCap);
+        }
+        if (sd->values[i] == NULL)
+            sd->values[i] = (char *) malloc((size_t) RM_EXPORT_GROUP_ROWS * (width > 0 ? width : 1));
+
+        if (fseek(fd->file, (long) fd->chunkOffset[c], SEEK_SET) != 0
+            || !readBytes(fd->file, sd->chunk, fd->chunkLength[c]))
+            return RC_READ_NON_EXISTING_PAGE;
+        if (!decodeChunk(fd->chunkEncoding[c], sd->chunk, fd->chunkLength[c],
+                         sc->dataTypes[i], width, numRows, sd->values[i]))
+            return RC_RM_BAD_EXPORT_FILE;
+    }
+    scan->rowGroupsRead++;
+    return RC_OK;
+}
+
+/*
+ * nextColumnRecord
+ * ----------------
+ * Returned the next record of the scan that satisfied its condition, moving
+ * on to the next row group that could hold one when the current one ran out.
+ */
+RC nextColumnRecord(RM_ColumnScan *scan, Record *record)
+{
+    RM_ColumnFile *cf = scan->file;
+    ColumnFileData *fd = (ColumnFileData *) cf->mgmtData;
+    ColumnScanData *sd = (ColumnScanData *) scan->mgmtData;
+    Schema *sc = cf->schema;
+
+    while (true)
+    {
+        if (sd->group < 0 || sd->row >= fd->groupRows[sd->group])
+        {
+            do
+                sd->group++;
+            while (sd->group < cf->numRowGroups
+                   && !rmZoneMayMatch(&fd->zones, sc, sd->group, sd->preds, sd->numPreds));
+            if (sd->group >= cf->numRowGroups)
+                return RC_RM_NO_MORE_TUPLES;
+
+            RC rc = loadGroup(scan, sd->group);
+            if (rc != RC_OK)
+                return rc;
+            sd->row = 0;
+        }
+
+        int row = sd->row++;
+        memset(record->data, 0, getRecordSize(sc));
+        for (int i = 0; i < sc->numAttr; i++)
+            if (sd->needAttr[i])
+                memcpy(record->data + sc->attrOffsets[i],
+                       sd->values[i] + (size_t) row * getAttrSize(sc, i), getAttrSize(sc, i));
+        record->id.page = sd->group;
+        record->id.slot = row;
+
+        if (sd->cond == NULL)
+            return RC_OK;
+        Value *res;
+        evalExpr(record, sc, sd->cond, &res);
+        bool pass = (res->v.boolV == TRUE);
+        freeVal(res);
+        if (pass)
+            return RC_OK;
+    }
+}
+
+/*
+ * closeColumnScan
+ * ---------------
+ * Freed the state of a column scan.
+ */
+RC closeColumnScan(RM_ColumnScan *scan)
+{
+    ColumnScanData *sd = (ColumnScanData *) scan->mgmtData;
+    Schema *sc = scan->file->schema;
+
+    for (int i = 0; i < sc->numAttr; i++)
+        free(sd->values[i]);
+    free(sd->values);
+    free(sd->needAttr);
+    free(sd->chunk);
+    free(sd);
+    scan->mgmtData = NULL;
+    return RC_OK;
+}
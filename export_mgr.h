@@ -0,0 +1,65 @@
+#ifndef EXPORT_MGR_H
+#define EXPORT_MGR_H
+
+#include "dberror.h"
+#include "expr.h"
+#include "record_mgr.h"
+
+/*
+ * Columnar export files.
+ *
+ * exportTable and exportScan wrote records to a self-describing file:
+ *   - a header: the magic, then the schema (types, lengths, names and keys),
+ *   - row groups of up to RM_EXPORT_GROUP_ROWS records, each made of one chunk
+ *     per attribute holding that attribute's values in the group,
+ *   - a footer: the size of every row group and, for each of its chunks, the
+ *     position, length, encoding and min and max value (in the record->data
+ *     byte format); then the number of row groups, where the footer started
+ *     and the magic again.
+ * Each chunk was written with whichever encoding came out smallest:
+ *   - plain: the values one after the other (ints and floats in 4 bytes, bools
+ *     in 1 byte, strings as an unsigned short length and their bytes),
+ *   - run-length: an int count and a plain value for every run of equal values,
+ *   - dictionary: an int count and the distinct plain values, the width of the
+ *     codes (1 or 2 bytes), then the code of every value.
+ * Numbers were in the machine's byte order.
+ *
+ * openColumnFile read the header and the footer. A column scan then read only
+ * the chunks of the attributes it returned or tested, and skipped the row
+ * groups whose min and max ruled out an "attribute <op> constant" term of its
+ * condition. Records came back in the file's schema with the other attributes
+ * zeroed; record->id held the row group (page) and the row in it (slot).
+ */
+
+// records per row group
+#define RM_EXPORT_GROUP_ROWS 4096
+
+// Bookkeeping for an open export file
+typedef struct RM_ColumnFile
+{
+	Schema *schema;     // of the exported records
+	int numRows;
+	int numRowGroups;
+	void *mgmtData;
+} RM_ColumnFile;
+
+// Bookkeeping for a scan of an export file
+typedef struct RM_ColumnScan
+{
+	RM_ColumnFile *file;
+	int rowGroupsRead;  // row groups whose chunks were read (the rest were skipped)
+	void *mgmtData;
+} RM_ColumnScan;
+
+// writing (exportScan read a started scan to its end but did not close it)
+extern RC exportTable (RM_TableData *rel, char *path);
+extern RC exportScan (RM_ScanHandle *scan, char *path);
+
+// reading (numAttrs 0 returned every attribute; cond may be NULL)
+extern RC openColumnFile (RM_ColumnFile *cf, char *path);
+extern RC closeColumnFile (RM_ColumnFile *cf);
+extern RC startColumnScan (RM_ColumnFile *cf, int numAttrs, int *attrs, Expr *cond, RM_ColumnScan *scan);
+extern RC nextColumnRecord (RM_ColumnScan *scan, Record *record);
+extern RC closeColumnScan (RM_ColumnScan *scan);
+
+#endif // EXPORT_MGR_H
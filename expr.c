@@ -19,6 +19,9 @@ valueEquals (Value *left, Value *right, Value *result)
 	case DT_INT:
 		result->v.boolV = (left->v.intV == right->v.intV);
 		break;
+	case DT_BLOB:
+		result->v.boolV = (left->v.blobV == right->v.blobV);
+		break;
 	case DT_FLOAT:
 		result->v.boolV = (left->v.floatV == right->v.floatV);
 		break;
@@ -45,6 +48,9 @@ valueSmaller (Value *left, Value *right, Value *result)
 	case DT_INT:
 		result->v.boolV = (left->v.intV < right->v.intV);
 		break;
+	case DT_BLOB:
+		result->v.boolV = (left->v.blobV < right->v.blobV);
+		break;
 	case DT_FLOAT:
 		result->v.boolV = (left->v.floatV < right->v.floatV);
 		break;
@@ -74,6 +80,7 @@ boolAnd (Value *left, Value *right, Value *result)
 {
 	if (left->dt != DT_BOOL || right->dt != DT_BOOL)
 		THROW(RC_RM_BOOLEAN_EXPR_ARG_IS_NOT_BOOLEAN, "boolean AND requires boolean inputs");
+	result->dt = DT_BOOL;
 	result->v.boolV = (left->v.boolV && right->v.boolV);
 
 	return RC_OK;
@@ -84,6 +91,7 @@ boolOr (Value *left, Value *right, Value *result)
 {
 	if (left->dt != DT_BOOL || right->dt != DT_BOOL)
 		THROW(RC_RM_BOOLEAN_EXPR_ARG_IS_NOT_BOOLEAN, "boolean OR requires boolean inputs");
+	result->dt = DT_BOOL;
 	result->v.boolV = (left->v.boolV || right->v.boolV);
 
 	return RC_OK;
@@ -188,3 +196,117 @@ freeVal (Value *val)
 	free(val);
 }
 
+/*
+ * collectPredicates: walked the AND tree of a condition and appended every
+ * "attribute <op> constant" comparison it found. Anything else (OR, a negated
+ * equality, attribute-to-attribute comparisons) cleared *exact.
+ */
+static void
+collectPredicates (Expr *e, AttrPredicate *preds, int maxPreds, int *count, int *exact)
+{
+	Operator *op;
+	Expr *l, *r;
+	int negated = 0;
+
+	if (e->type != EXPR_OP)
+	{
+		*exact = 0;
+		return;
+	}
+
+	op = e->expr.op;
+	if (op->type == OP_BOOL_AND)
+	{
+		collectPredicates(op->args[0], preds, maxPreds, count, exact);
+		collectPredicates(op->args[1], preds, maxPreds, count, exact);
+		return;
+	}
+
+	if (op->type == OP_BOOL_NOT && op->args[0]->type == EXPR_OP)
+	{
+		negated = 1;
+		op = op->args[0]->expr.op;
+	}
+	if (op->type != OP_COMP_EQUAL && op->type != OP_COMP_SMALLER)
+	{
+		*exact = 0;
+		return;
+	}
+
+	l = op->args[0];
+	r = op->args[1];
+	if (*count >= maxPreds || (negated && op->type == OP_COMP_EQUAL))
+	{
+		*exact = 0;
+		return;
+	}
+
+	if (l->type == EXPR_ATTRREF && r->type == EXPR_CONST)
+	{
+		preds[*count].attrNum = l->expr.attrRef;
+		preds[*count].cons = r->expr.cons;
+		if (op->type == OP_COMP_EQUAL)
+			preds[*count].op = COMP_EQ;
+		else
+			preds[*count].op = negated ? COMP_GE : COMP_LT;
+	}
+	else if (l->type == EXPR_CONST && r->type == EXPR_ATTRREF)
+	{
+		preds[*count].attrNum = r->expr.attrRef;
+		preds[*count].cons = l->expr.cons;
+		if (op->type == OP_COMP_EQUAL)
+			preds[*count].op = COMP_EQ;
+		else
+			preds[*count].op = negated ? COMP_LE : COMP_GT;
+	}
+	else
+	{
+		*exact = 0;
+		return;
+	}
+	(*count)++;
+}
+
+/*
+ * extractPredicates: listed up to maxPreds simple "attribute <op> constant"
+ * comparisons that all had to hold for cond to be true. *exact was set to 1
+ * when the conjunction of the returned predicates was equivalent to cond, so
+ * a caller that checked them all could skip evalExpr.
+ */
+int
+extractPredicates (Expr *cond, AttrPredicate *preds, int maxPreds, int *exact)
+{
+	int count = 0;
+
+	*exact = 1;
+	if (cond == NULL)
+		return 0;
+	collectPredicates(cond, preds, maxPreds, &count, exact);
+	return count;
+}
+
+/*
+ * predicateHolds: evaluated "val <op> pred->cons" for a value of the same type.
+ */
+int
+predicateHolds (AttrPredicate *pred, Value *val)
+{
+	Value eq, lt;
+
+	if (valueEquals(val, pred->cons, &eq) != RC_OK)
+		return 0;
+	switch(pred->op)
+	{
+	case COMP_EQ:
+		return eq.v.boolV;
+	case COMP_LT:
+	case COMP_GE:
+		valueSmaller(val, pred->cons, &lt);
+		return (pred->op == COMP_LT) ? lt.v.boolV : !lt.v.boolV;
+	case COMP_GT:
+	case COMP_LE:
+		valueSmaller(val, pred->cons, &lt);
+		return (pred->op == COMP_LE) ? (lt.v.boolV || eq.v.boolV) : !(lt.v.boolV || eq.v.boolV);
+	}
+	return 0;
+}
@@ -34,6 +34,21 @@ typedef struct Operator {
   Expr **args;
 } Operator;
 
+// a comparison of one attribute with a constant, as found in a scan condition
+typedef enum CompOp {
+  COMP_EQ,
+  COMP_LT,
+  COMP_LE,
+  COMP_GT,
+  COMP_GE
+} CompOp;
+
+typedef struct AttrPredicate {
+  int attrNum;
+  CompOp op;
+  Value *cons;     // points into the expression, not a copy
+} AttrPredicate;
+
 // expression evaluation methods
 extern RC valueEquals (Value *left, Value *right, Value *result);
 extern RC valueSmaller (Value *left, Value *right, Value *result);
@@ -44,6 +59,10 @@ extern RC evalExpr (Record *record, Schema *schema, Expr *expr, Value **result);
 extern RC freeExpr (Expr *expr);
 extern void freeVal(Value *val);
 
+// condition analysis
+extern int extractPredicates (Expr *cond, AttrPredicate *preds, int maxPreds, int *exact);
+extern int predicateHolds (AttrPredicate *pred, Value *val);
+
 
 #define CPVAL(_result,_input)						\
   do {									\
@@ -63,6 +82,9 @@ extern void freeVal(Value *val);
     case DT_BOOL:							\
       (_result)->v.boolV = _input->v.boolV;				\
       break;								\
+    case DT_BLOB:							\
+      (_result)->v.blobV = _input->v.blobV;				\
+      break;								\
     }									\
 } while(0)
 
@@ -0,0 +1,1174 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "join_mgr.h"
+#include "record_mgr.h"
+#include "storage_mgr.h"
+#include "rm_spill.h"
+#include "dberror.h"
+#include "tables.h"
+#include "btree_mgr.h"
+
+/*
+ * join_mgr.c
+ * ---------------------------------------------------------------
+ * Equi-join operators: hash join, index nested-loop join and sort-merge join.
+ * Each kept its state in its own structure behind RM_JoinHandle->mgmtData;
+ * the structure started with a JoinKind so nextJoin and closeJoin could tell
+ * them apart.
+ *
+ * Hash join: the input with fewer tuples in its table became the build side.
+ * Its records were copied into an arena and indexed by an open-addressed hash
+ * table keyed by the raw bytes of the join attribute (strings up to their
+ * terminating '\0'). Every record of the other input then probed that table.
+ *
+ * If the build side grew beyond the memory budget, the join switched to
+ * partitions: both inputs were split by hash into temporary page files and
+ * each pair of partitions was joined in memory on its own. A partition that
+ * still did not fit was joined anyway, over budget.
+ */
+
+/* The most partitions a spilled join split its inputs into. */
+#define JOIN_MAX_PARTITIONS 64
+
+/* Bytes in one arena block (larger records got a block of their own). */
+#define JOIN_ARENA_BLOCK (64 * 1024)
+
+/* One record of the build side, as stored in the arena. */
+typedef struct JoinTuple {
+    RID id;
+    unsigned int hash;
+    char data[];        // record->data of the build input
+} JoinTuple;
+
+/* One hash table bucket; tuple == NULL marks an empty bucket. */
+typedef struct JoinBucket {
+    unsigned int hash;
+    JoinTuple *tuple;
+} JoinBucket;
+
+typedef struct JoinArenaBlock {
+    struct JoinArenaBlock *next;
+    size_t used;
+    size_t size;
+    char mem[];
+} JoinArenaBlock;
+
+typedef enum JoinKind {
+    JOIN_HASH,
+    JOIN_INDEX,
+    JOIN_MERGE
+} JoinKind;
+
+/* This structure stored the state of a hash join in progress. */
+typedef struct HashJoinData {
+    JoinKind kind;
+    bool buildIsLeft;
+    RM_ScanHandle *buildScan, *probeScan;
+    Schema *buildSchema, *probeSchema;
+    int buildAttr, probeAttr;
+    int buildSize, probeSize;   // record sizes
+    Record *buildRec, *probeRec;
+    size_t budget;
+
+    // Build side in memory
+    JoinArenaBlock *arena;
+    size_t memUsed;
+    JoinTuple **tuples;
+    int numTuples, capTuples;
+    JoinBucket *buckets;
+    unsigned int mask;
+
+    // Probe state
+    bool haveProbe;
+    unsigned int probeHash;
+    unsigned int slot;
+
+    // Partitions, once the build side had spilled
+    int numParts;               // 0 while everything fit in memory
+    int part;                   // partition being joined
+    RM_Spill *buildParts, *probeParts;
+} HashJoinData;
+
+/* --------------------------------------------------------------------------
+   Keys
+   -------------------------------------------------------------------------- */
+
+/*
+ * joinKey
+ * -------
+ * Returned where the join attribute started inside record->data and how many
+ * of its bytes took part in comparisons.
+ */
+static const char *joinKey(Schema *schema, int attr, const char *data, int *len)
+{
+    const char *key = data + schema->attrOffsets[attr];
+    int width = schema->attrOffsets[attr + 1] - schema->attrOffsets[attr];
+
+    *len = (schema->dataTypes[attr] == DT_STRING) ? (int) strnlen(key, width) : width;
+    return key;
+}
+
+/*
+ * hashKey
+ * -------
+ * FNV-1a over the key bytes.
+ */
+static unsigned int hashKey(const char *key, int len)
+{
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < len; i++)
+    {
+        h ^= (unsigned char) key[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/*
+ * partitionOf
+ * -----------
+ * Picked a partition from the high bits of a hash, so that the low bits
+ * still spread the tuples of one partition over its buckets.
+ */
+static int partitionOf(unsigned int hash, int numParts)
+{
+    return (int) ((hash >> 16) % (unsigned int) numParts);
+}
+
+/* --------------------------------------------------------------------------
+   Arena and hash table
+   -------------------------------------------------------------------------- */
+
+/*
+ * arenaAlloc
+ * ----------
+ * Handed out 8-byte aligned memory from the arena, adding a block when the
+ * current one was full.
+ */
+static void *arenaAlloc(HashJoinData *jd, size_t size)
+{
+    size = (size + 7) & ~(size_t) 7;
+    JoinArenaBlock *blk = jd->arena;
+
+    if (blk == NULL || blk->size - blk->used < size)
+    {
+        size_t blkSize = (size > JOIN_ARENA_BLOCK) ? size : JOIN_ARENA_BLOCK;
+        blk = (JoinArenaBlock *) malloc(sizeof(JoinArenaBlock) + blkSize);
+        if (blk == NULL)
+            return NULL;
+        blk->next = jd->arena;
+        blk->used = 0;
+        blk->size = blkSize;
+        jd->arena = blk;
+        jd->memUsed += sizeof(JoinArenaBlock) + blkSize;
+    }
+
+    void *p = blk->mem + blk->used;
+    blk->used += size;
+    return p;
+}
+
+/*
+ * resetBuild
+ * ----------
+ * Dropped the build side held in memory: arena, tuple list and buckets.
+ */
+static void resetBuild(HashJoinData *jd)
+{
+    while (jd->arena != NULL)
+    {
+        JoinArenaBlock *next = jd->arena->next;
+        free(jd->arena);
+        jd->arena = next;
+    }
+    free(jd->tuples);
+    free(jd->buckets);
+    jd->tuples = NULL;
+    jd->buckets = NULL;
+    jd->numTuples = jd->capTuples = 0;
+    jd->mask = 0;
+    jd->memUsed = 0;
+    jd->haveProbe = false;
+}
+
+/*
+ * addBuildTuple
+ * -------------
+ * Copied one build record into the arena and remembered it for buildTable.
+ */
+static RC addBuildTuple(HashJoinData *jd, RID id, unsigned int hash, const char *data)
+{
+    if (jd->numTuples == jd->capTuples)
+    {
+        int cap = (jd->capTuples > 0) ? 2 * jd->capTuples : 256;
+        JoinTuple **tuples = (JoinTuple **) realloc(jd->tuples, cap * sizeof(JoinTuple *));
+        if (tuples == NULL)
+            return RC_MEMORY_ALLOCATION_ERROR;
+        jd->memUsed += (size_t) (cap - jd->capTuples) * sizeof(JoinTuple *);
+        jd->tuples = tuples;
+        jd->capTuples = cap;
+    }
+
+    JoinTuple *t = (JoinTuple *) arenaAlloc(jd, sizeof(JoinTuple) + jd->buildSize);
+    if (t == NULL)
+        return RC_MEMORY_ALLOCATION_ERROR;
+    t->id = id;
+    t->hash = hash;
+    memcpy(t->data, data, jd->buildSize);
+    jd->tuples[jd->numTuples++] = t;
+    return RC_OK;
+}
+
+/*
+ * buildTable
+ * ----------
+ * Put every build tuple into a power-of-two bucket array that was at most
+ * half full, using linear probing. Equal keys simply took neighbouring buckets.
+ */
+static RC buildTable(HashJoinData *jd)
+{
+    unsigned int cap = 16;
+    while (cap < 2u * (unsigned int) jd->numTuples)
+        cap *= 2;
+
+    jd->buckets = (JoinBucket *) calloc(cap, sizeof(JoinBucket));
+    if (jd->buckets == NULL)
+        return RC_MEMORY_ALLOCATION_ERROR;
+    jd->memUsed += cap * sizeof(JoinBucket);
+    jd->mask = cap - 1;
+
+    for (int i = 0; i < jd->numTuples; i++)
+    {
+        unsigned int slot = jd->tuples[i]->hash & jd->mask;
+        while (jd->buckets[slot].tuple != NULL)
+            slot = (slot + 1) & jd->mask;
+        jd->buckets[slot].hash  = jd->tuples[i]->hash;
+        jd->buckets[slot].tuple = jd->tuples[i];
+    }
+    return RC_OK;
+}
+
+/*
+ * startSpill
+ * ----------
+ * Switched a join whose build side had outgrown its budget to partitions:
+ * created the partition files of both inputs and moved the build tuples read
+ * so far from memory into them. The number of partitions came from the size
+ * the whole build table would take if every record matched its condition.
+ */
+static RC startSpill(HashJoinData *jd)
+{
+    size_t estimate = (size_t) getNumTuples(jd->buildScan->rel)
+                    * (sizeof(JoinTuple) + jd->buildSize + sizeof(JoinTuple *) + 2 * sizeof(JoinBucket));
+    int numParts = (int) (estimate / jd->budget) + 1;
+    numParts += numParts / 2;
+    if (numParts < 2)
+        numParts = 2;
+    if (numParts > JOIN_MAX_PARTITIONS)
+        numParts = JOIN_MAX_PARTITIONS;
+
+    jd->buildParts = (RM_Spill *) calloc(numParts, sizeof(RM_Spill));
+    jd->probeParts = (RM_Spill *) calloc(numParts, sizeof(RM_Spill));
+    if (jd->buildParts == NULL || jd->probeParts == NULL)
+        return RC_MEMORY_ALLOCATION_ERROR;
+    jd->numParts = numParts;
+
+    int id = rmSpillNextId();
+    for (int i = 0; i < numParts; i++)
+    {
+        char fileName[64];
+        RC rc;
+
+        snprintf(fileName, sizeof(fileName), "join%d.b%d.tmp", id, i);
+        if ((rc = rmSpillOpen(&jd->buildParts[i], fileName)) != RC_OK)
+            return rc;
+        snprintf(fileName, sizeof(fileName), "join%d.p%d.tmp", id, i);
+        if ((rc = rmSpillOpen(&jd->probeParts[i], fileName)) != RC_OK)
+            return rc;
+    }
+
+    for (int i = 0; i < jd->numTuples; i++)
+    {
+        JoinTuple *t = jd->tuples[i];
+        RC rc = rmSpillTuple(&jd->buildParts[partitionOf(t->hash, numParts)], t->id, t->data, jd->buildSize);
+        if (rc != RC_OK)
+            return rc;
+    }
+    resetBuild(jd);
+    return RC_OK;
+}
+
+/*
+ * loadPartition
+ * -------------
+ * Read the build tuples of partition jd->part into a fresh hash table and
+ * rewound the matching probe partition.
+ */
+static RC loadPartition(HashJoinData *jd)
+{
+    RM_Spill *bp = &jd->buildParts[jd->part];
+    RC rc;
+
+    resetBuild(jd);
+    if ((rc = rmSpillRewind(bp)) != RC_OK)
+        return rc;
+
+    while (bp->remaining > 0)
+    {
+        RID id;
+        int len;
+        if ((rc = rmSpillReadTuple(bp, &id, jd->buildRec->data, jd->buildSize)) != RC_OK)
+            return rc;
+
+        const char *key = joinKey(jd->buildSchema, jd->buildAttr, jd->buildRec->data, &len);
+        if ((rc = addBuildTuple(jd, id, hashKey(key, len), jd->buildRec->data)) != RC_OK)
+            return rc;
+    }
+
+    if ((rc = buildTable(jd)) != RC_OK)
+        return rc;
+    return rmSpillRewind(&jd->probeParts[jd->part]);
+}
+
+/*
+ * fetchProbe
+ * ----------
+ * Put the next probe record into jd->probeRec: straight from the probe scan,
+ * or from the probe partitions once the build side had spilled (moving on to
+ * the next partition pair as each one ran out).
+ */
+static RC fetchProbe(HashJoinData *jd)
+{
+    if (jd->numParts == 0)
+        return (jd->numTuples > 0) ? next(jd->probeScan, jd->probeRec) : RC_RM_NO_MORE_TUPLES;
+
+    while (jd->part < 0 || jd->probeParts[jd->part].remaining == 0)
+    {
+        jd->part++;
+        if (jd->part >= jd->numParts)
+        {
+            resetBuild(jd);
+            return RC_RM_NO_MORE_TUPLES;
+        }
+        // Partitions with nothing on one side could not produce a match
+        if (jd->buildParts[jd->part].numTuples == 0 || jd->probeParts[jd->part].numTuples == 0)
+            continue;
+
+        RC rc = loadPartition(jd);
+        if (rc != RC_OK)
+            return rc;
+    }
+
+    return rmSpillReadTuple(&jd->probeParts[jd->part], &jd->probeRec->id, jd->probeRec->data, jd->probeSize);
+}
+
+/* --------------------------------------------------------------------------
+   Join interface
+   -------------------------------------------------------------------------- */
+
+/*
+ * freeHashJoin
+ * ------------
+ * Released everything a hash join held, removing its partition files.
+ */
+static void freeHashJoin(HashJoinData *jd)
+{
+    resetBuild(jd);
+    for (int i = 0; i < jd->numParts; i++)
+    {
+        rmSpillClose(&jd->buildParts[i]);
+        rmSpillClose(&jd->probeParts[i]);
+    }
+    free(jd->buildParts);
+    free(jd->probeParts);
+    if (jd->buildRec != NULL)
+        freeRecord(jd->buildRec);
+    if (jd->probeRec != NULL)
+        freeRecord(jd->probeRec);
+    free(jd);
+}
+
+/*
+ * startHashJoin
+ * -------------
+ * Started a join of two open scans on left.leftAttr = right.rightAttr. The
+ * build side was read completely here (spilling it, and then the probe side,
+ * to partition files if it exceeded memoryBudget bytes; 0 meant
+ * RM_JOIN_DEFAULT_MEMORY). Both attributes had to exist and have the same type.
+ */
+RC startHashJoin(RM_ScanHandle *left, int leftAttr, RM_ScanHandle *right, int rightAttr,
+                 int memoryBudget, RM_JoinHandle *join)
+{
+    Schema *ls = left->rel->schema;
+    Schema *rs = right->rel->schema;
+    RC rc;
+
+    if (leftAttr < 0 || leftAttr >= ls->numAttr || rightAttr < 0 || rightAttr >= rs->numAttr)
+        return RC_RM_NO_SUCH_ATTR;
+    if (ls->dataTypes[leftAttr] != rs->dataTypes[rightAttr])
+        return RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
+    if (ls->dataTypes[leftAttr] == DT_BLOB)
+        return RC_RM_BAD_BLOB_ATTR;
+
+    HashJoinData *jd = (HashJoinData *) calloc(1, sizeof(HashJoinData));
+    if (jd == NULL)
+        return RC_MEMORY_ALLOCATION_ERROR;
+    jd->kind = JOIN_HASH;
+
+    // Built on the input whose table was smaller
+    jd->buildIsLeft = (getNumTuples(left->rel) <= getNumTuples(right->rel));
+    jd->buildScan   = jd->buildIsLeft ? left : right;
+    jd->probeScan   = jd->buildIsLeft ? right : left;
+    jd->buildAttr   = jd->buildIsLeft ? leftAttr : rightAttr;
+    jd->probeAttr   = jd->buildIsLeft ? rightAttr : leftAttr;
+    jd->buildSchema = jd->buildScan->rel->schema;
+    jd->probeSchema = jd->probeScan->rel->schema;
+    jd->buildSize   = getRecordSize(jd->buildSchema);
+    jd->probeSize   = getRecordSize(jd->probeSchema);
+    jd->budget      = (memoryBudget > 0) ? (size_t) memoryBudget : RM_JOIN_DEFAULT_MEMORY;
+    jd->part        = -1;
+    createRecord(&jd->buildRec, jd->buildSchema);
+    createRecord(&jd->probeRec, jd->probeSchema);
+
+    // Build phase
+    while ((rc = next(jd->buildScan, jd->buildRec)) == RC_OK)
+    {
+        int len;
+        const char *key = joinKey(jd->buildSchema, jd->buildAttr, jd->buildRec->data, &len);
+        unsigned int hash = hashKey(key, len);
+
+        if (jd->numParts > 0)
+            rc = rmSpillTuple(&jd->buildParts[partitionOf(hash, jd->numParts)],
+                            jd->buildRec->id, jd->buildRec->data, jd->buildSize);
+        else
+        {
+            rc = addBuildTuple(jd, jd->buildRec->id, hash, jd->buildRec->data);
+            if (rc == RC_OK && jd->memUsed > jd->budget)
+                rc = startSpill(jd);
+        }
+        if (rc != RC_OK)
+            break;
+    }
+    if (rc != RC_RM_NO_MORE_TUPLES)
+    {
+        freeHashJoin(jd);
+        return rc;
+    }
+
+    if (jd->numParts == 0)
+        rc = buildTable(jd);
+    else
+    {
+        // Partitioned the probe side the same way
+        while ((rc = next(jd->probeScan, jd->probeRec)) == RC_OK)
+        {
+            int len;
+            const char *key = joinKey(jd->probeSchema, jd->probeAttr, jd->probeRec->data, &len);
+            rc = rmSpillTuple(&jd->probeParts[partitionOf(hashKey(key, len), jd->numParts)],
+                            jd->probeRec->id, jd->probeRec->data, jd->probeSize);
+            if (rc != RC_OK)
+                break;
+        }
+        if (rc == RC_RM_NO_MORE_TUPLES)
+            rc = RC_OK;
+    }
+    if (rc != RC_OK)
+    {
+        freeHashJoin(jd);
+        return rc;
+    }
+
+    join->left = left->rel;
+    join->right = right->rel;
+    join->mgmtData = jd;
+    return RC_OK;
+}
+
+/*
+ * nextHashJoin
+ * ------------
+ * Returned the next matching pair of a hash join. Pairs came in probe order;
+ * all matches of one probe record came one after the other.
+ */
+static RC nextHashJoin(HashJoinData *jd, Record *left, Record *right)
+{
+    int probeLen, buildLen;
+    RC rc;
+
+    while (true)
+    {
+        if (jd->haveProbe)
+        {
+            const char *probeKey = joinKey(jd->probeSchema, jd->probeAttr, jd->probeRec->data, &probeLen);
+
+            // Walked the run of occupied buckets starting at the probe's home bucket
+            while (jd->buckets[jd->slot].tuple != NULL)
+            {
+                JoinBucket *b = &jd->buckets[jd->slot];
+                jd->slot = (jd->slot + 1) & jd->mask;
+                if (b->hash != jd->probeHash)
+                    continue;
+
+                const char *buildKey = joinKey(jd->buildSchema, jd->buildAttr, b->tuple->data, &buildLen);
+                if (buildLen != probeLen || memcmp(buildKey, probeKey, probeLen) != 0)
+                    continue;
+
+                Record *buildOut = jd->buildIsLeft ? left : right;
+                Record *probeOut = jd->buildIsLeft ? right : left;
+                buildOut->id = b->tuple->id;
+                memcpy(buildOut->data, b->tuple->data, jd->buildSize);
+                probeOut->id = jd->probeRec->id;
+                memcpy(probeOut->data, jd->probeRec->data, jd->probeSize);
+                return RC_OK;
+            }
+            jd->haveProbe = false;
+        }
+
+        if ((rc = fetchProbe(jd)) != RC_OK)
+            return rc;
+
+        const char *key = joinKey(jd->probeSchema, jd->probeAttr, jd->probeRec->data, &probeLen);
+        jd->probeHash = hashKey(key, probeLen);
+        jd->slot = jd->probeHash & jd->mask;
+        jd->haveProbe = true;
+    }
+}
+
+/* --------------------------------------------------------------------------
+   Key order
+   -------------------------------------------------------------------------- */
+
+/*
+ * compareJoinKeys
+ * ---------------
+ * Compared two join keys as returned by joinKey, in the order the B+ trees
+ * kept them. Returned <0, 0 or >0 like strcmp.
+ */
+static int compareJoinKeys(DataType dt, const char *a, int alen, const char *b, int blen)
+{
+    switch (dt)
+    {
+        case DT_INT:
+        case DT_BLOB:   // large objects compared by id
+        {
+            int x, y;
+            memcpy(&x, a, sizeof(int));
+            memcpy(&y, b, sizeof(int));
+            return (x > y) - (x < y);
+        }
+        case DT_FLOAT:
+        {
+            float x, y;
+            memcpy(&x, a, sizeof(float));
+            memcpy(&y, b, sizeof(float));
+            return (x > y) - (x < y);
+        }
+        case DT_BOOL:
+            return (a[0] != 0) - (b[0] != 0);
+        case DT_STRING:
+        {
+            int c = memcmp(a, b, (alen < blen) ? alen : blen);
+            return (c != 0) ? c : (alen > blen) - (alen < blen);
+        }
+    }
+    return 0;
+}
+
+/*
+ * keyValue
+ * --------
+ * Turned a join key into a Value for the B+ tree calls. Strings were copied
+ * into buf, which needed len + 1 bytes.
+ */
+static void keyValue(DataType dt, const char *key, int len, char *buf, Value *val)
+{
+    val->dt = dt;
+    switch (dt)
+    {
+        case DT_INT:   memcpy(&val->v.intV, key, sizeof(int)); break;
+        case DT_FLOAT: memcpy(&val->v.floatV, key, sizeof(float)); break;
+        case DT_BOOL:  val->v.boolV = (key[0] != 0); break;
+        case DT_BLOB:  memcpy(&val->v.blobV, key, sizeof(int)); break;
+        case DT_STRING:
+            memcpy(buf, key, len);
+            buf[len] = '\0';
+            val->v.stringV = buf;
+            break;
+    }
+}
+
+/*
+ * condHolds
+ * ---------
+ * Evaluated an optional condition on a record (NULL always held).
+ */
+static bool condHolds(Record *record, Schema *schema, Expr *cond)
+{
+    Value *res;
+    if (cond == NULL)
+        return true;
+    if (evalExpr(record, schema, cond, &res) != RC_OK)
+        return false;
+    bool pass = (res->v.boolV == TRUE);
+    freeVal(res);
+    return pass;
+}
+
+/* --------------------------------------------------------------------------
+   Index nested-loop join
+   -------------------------------------------------------------------------- */
+
+/* One outer record of a batch, for sorting the batch by key. */
+typedef struct JoinBatchKey {
+    const char *key;
+    int len;
+    int idx;            // position of the record in the batch
+} JoinBatchKey;
+
+/* One (outer record, inner RID) pair found in the index. */
+typedef struct JoinMatch {
+    RID inner;
+    int outer;
+} JoinMatch;
+
+/* This structure stored the state of an index nested-loop join in progress. */
+typedef struct IndexJoinData {
+    JoinKind kind;
+    RM_ScanHandle *outer;
+    RM_TableData *inner;
+    Schema *outerSchema, *innerSchema;
+    int outerAttr, innerAttr;
+    int outerSize, innerSize;
+    Expr *innerCond;
+    BT_ScanHandle *lookup;      // one tree scan, re-positioned for every key
+
+    // Current batch of outer records
+    char *batch;                // RM_JOIN_BATCH records of outerSize bytes
+    RID *batchIds;
+    JoinBatchKey *keys;
+    int batchLen;
+    bool outerDone;
+
+    // Matches of the batch, in inner RID order
+    JoinMatch *matches;
+    int numMatches, capMatches, matchPos;
+    Record *innerRec;           // last inner record fetched
+    bool haveInner;
+    char *keyBuf;               // string keys handed to the index
+} IndexJoinData;
+
+/*
+ * sortBatchKeys
+ * -------------
+ * Sorted the keys of a batch by key, then position. An insertion sort did:
+ * a batch held at most RM_JOIN_BATCH keys, and qsort passed its comparison no
+ * context, so the key type would have had to be shared by every join.
+ */
+static void sortBatchKeys(DataType dt, JoinBatchKey *keys, int n)
+{
+    for (int i = 1; i < n; i++)
+    {
+        JoinBatchKey k = keys[i];
+        int j = i;
+        for (; j > 0; j--)
+        {
+            int c = compareJoinKeys(dt, keys[j - 1].key, keys[j - 1].len, k.key, k.len);
+            if (c < 0 || (c == 0 && keys[j - 1].idx < k.idx))
+                break;
+            keys[j] = keys[j - 1];
+        }
+        keys[j] = k;
+    }
+}
+
+/* qsort order for matches: by inner page and slot, then outer position. */
+static int compareMatches(const void *a, const void *b)
+{
+    const JoinMatch *x = (const JoinMatch *) a;
+    const JoinMatch *y = (const JoinMatch *) b;
+    if (x->inner.page != y->inner.page)
+        return (x->inner.page > y->inner.page) - (x->inner.page < y->inner.page);
+    if (x->inner.slot != y->inner.slot)
+        return (x->inner.slot > y->inner.slot) - (x->inner.slot < y->inner.slot);
+    return (x->outer > y->outer) - (x->outer < y->outer);
+}
+
+/*
+ * addMatch
+ * --------
+ * Remembered one outer record / inner RID pair of the current batch.
+ */
+static RC addMatch(IndexJoinData *jd, int outer, RID inner)
+{
+    if (jd->numMatches == jd->capMatches)
+    {
+        int cap = (jd->capMatches > 0) ? 2 * jd->capMatches : RM_JOIN_BATCH;
+        JoinMatch *m = (JoinMatch *) realloc(jd->matches, cap * sizeof(JoinMatch));
+        if (m == NULL)
+            return RC_MEMORY_ALLOCATION_ERROR;
+        jd->matches = m;
+        jd->capMatches = cap;
+    }
+    jd->matches[jd->numMatches].inner = inner;
+    jd->matches[jd->numMatches].outer = outer;
+    jd->numMatches++;
+    return RC_OK;
+}
+
+/*
+ * loadBatch
+ * ---------
+ * Read the next batch of outer records and looked up their keys in the inner
+ * index. The keys were sorted first, so every distinct key was looked up once
+ * and the lookups went through the tree in ascending order. The matches were
+ * then sorted by inner RID, so the inner table was read page by page.
+ */
+static RC loadBatch(IndexJoinData *jd)
+{
+    Record rec;
+    RC rc = RC_OK;
+
+    jd->batchLen = 0;
+    jd->numMatches = 0;
+    jd->matchPos = 0;
+    jd->haveInner = false;
+
+    while (jd->batchLen < RM_JOIN_BATCH && !jd->outerDone)
+    {
+        rec.data = jd->batch + (size_t) jd->batchLen * jd->outerSize;
+        rc = next(jd->outer, &rec);
+        if (rc == RC_RM_NO_MORE_TUPLES)
+        {
+            jd->outerDone = true;
+            break;
+        }
+        if (rc != RC_OK)
+            return rc;
+
+        JoinBatchKey *k = &jd->keys[jd->batchLen];
+        k->key = joinKey(jd->outerSchema, jd->outerAttr, rec.data, &k->len);
+        k->idx = jd->batchLen;
+        jd->batchIds[jd->batchLen++] = rec.id;
+    }
+    if (jd->batchLen == 0)
+        return RC_RM_NO_MORE_TUPLES;
+
+    DataType keyType = jd->outerSchema->dataTypes[jd->outerAttr];
+    sortBatchKeys(keyType, jd->keys, jd->batchLen);
+
+    for (int i = 0; i < jd->batchLen; )
+    {
+        // The run of batch records sharing this key
+        int end = i + 1;
+        while (end < jd->batchLen
+               && compareJoinKeys(keyType, jd->keys[i].key, jd->keys[i].len,
+                                  jd->keys[end].key, jd->keys[end].len) == 0)
+            end++;
+
+        Value key;
+        RID rid;
+        keyValue(keyType, jd->keys[i].key, jd->keys[i].len, jd->keyBuf, &key);
+        if (jd->lookup == NULL)
+            rc = openTreeRangeScan(getTableIndex(jd->inner, jd->innerAttr), &key, true, &key, true, &jd->lookup);
+        else
+            rc = seekTreeScan(jd->lookup, &key, true, &key, true);
+        if (rc != RC_OK)
+            return rc;
+
+        while ((rc = nextEntry(jd->lookup, &rid)) == RC_OK)
+            for (int j = i; j < end; j++)
+                if ((rc = addMatch(jd, jd->keys[j].idx, rid)) != RC_OK)
+                    return rc;
+        if (rc != RC_IM_NO_MORE_ENTRIES)
+            return rc;
+        i = end;
+    }
+
+    qsort(jd->matches, jd->numMatches, sizeof(JoinMatch), compareMatches);
+    return RC_OK;
+}
+
+/*
+ * startIndexJoin
+ * --------------
+ * Started a join of an open outer scan with an inner table on
+ * outer.outerAttr = inner.innerAttr, using the inner table's index on
+ * innerAttr. Inner records also had to satisfy innerCond. Returned
+ * RC_RM_NO_INDEX if that attribute was not indexed.
+ */
+RC startIndexJoin(RM_ScanHandle *outer, int outerAttr, RM_TableData *inner, int innerAttr,
+                  Expr *innerCond, RM_JoinHandle *join)
+{
+    Schema *os = outer->rel->schema;
+    Schema *is = inner->schema;
+
+    if (outerAttr < 0 || outerAttr >= os->numAttr || innerAttr < 0 || innerAttr >= is->numAttr)
+        return RC_RM_NO_SUCH_ATTR;
+    if (os->dataTypes[outerAttr] != is->dataTypes[innerAttr])
+        return RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
+    if (os->dataTypes[outerAttr] == DT_BLOB)
+        return RC_RM_BAD_BLOB_ATTR;
+    if (getTableIndex(inner, innerAttr) == NULL)
+        return RC_RM_NO_INDEX;
+
+    IndexJoinData *jd = (IndexJoinData *) calloc(1, sizeof(IndexJoinData));
+    if (jd == NULL)
+        return RC_MEMORY_ALLOCATION_ERROR;
+    jd->kind        = JOIN_INDEX;
+    jd->outer       = outer;
+    jd->inner       = inner;
+    jd->outerSchema = os;
+    jd->innerSchema = is;
+    jd->outerAttr   = outerAttr;
+    jd->innerAttr   = innerAttr;
+    jd->outerSize   = getRecordSize(os);
+    jd->innerSize   = getRecordSize(is);
+    jd->innerCond   = innerCond;
+    jd->batch       = (char *) malloc((size_t) RM_JOIN_BATCH * jd->outerSize);
+    jd->batchIds    = (RID *) malloc(RM_JOIN_BATCH * sizeof(RID));
+    jd->keys        = (JoinBatchKey *) malloc(RM_JOIN_BATCH * sizeof(JoinBatchKey));
+    jd->keyBuf      = (char *) malloc(os->attrOffsets[outerAttr + 1] - os->attrOffsets[outerAttr] + 1);
+    createRecord(&jd->innerRec, is);
+
+    join->left = outer->rel;
+    join->right = inner;
+    join->mgmtData = jd;
+    return RC_OK;
+}
+
+/*
+ * nextIndexJoin
+ * -------------
+ * Returned the next matching pair of an index join. Within a batch, pairs
+ * came in inner RID order; each inner record was read once per batch.
+ */
+static RC nextIndexJoin(IndexJoinData *jd, Record *left, Record *right)
+{
+    RC rc;
+
+    while (true)
+    {
+        while (jd->matchPos < jd->numMatches)
+        {
+            JoinMatch *m = &jd->matches[jd->matchPos++];
+
+            if (!jd->haveInner || jd->innerRec->id.page != m->inner.page
+                || jd->innerRec->id.slot != m->inner.slot)
+            {
+                if ((rc = getRecord(jd->inner, m->inner, jd->innerRec)) != RC_OK)
+                    return rc;
+                jd->haveInner = true;
+            }
+            if (!condHolds(jd->innerRec, jd->innerSchema, jd->innerCond))
+                continue;
+
+            left->id = jd->batchIds[m->outer];
+            memcpy(left->data, jd->batch + (size_t) m->outer * jd->outerSize, jd->outerSize);
+            right->id = jd->innerRec->id;
+            memcpy(right->data, jd->innerRec->data, jd->innerSize);
+            return RC_OK;
+        }
+
+        if ((rc = loadBatch(jd)) != RC_OK)
+            return rc;
+    }
+}
+
+/*
+ * freeIndexJoin
+ * -------------
+ * Released everything an index join held.
+ */
+static void freeIndexJoin(IndexJoinData *jd)
+{
+    if (jd->lookup != NULL)
+        closeTreeScan(jd->lookup);
+    free(jd->batch);
+    free(jd->batchIds);
+    free(jd->keys);
+    free(jd->matches);
+    free(jd->keyBuf);
+    freeRecord(jd->innerRec);
+    free(jd);
+}
+
+/* --------------------------------------------------------------------------
+   Sort-merge join
+   -------------------------------------------------------------------------- */
+
+/* One input of a merge join: a table read in key order through its index. */
+typedef struct MergeInput {
+    RM_TableData *rel;
+    int attr;
+    int size;
+    Expr *cond;
+    BT_ScanHandle *scan;
+    Record *rec;        // current record
+    bool done;
+} MergeInput;
+
+/* This structure stored the state of a sort-merge join in progress. */
+typedef struct MergeJoinData {
+    JoinKind kind;
+    MergeInput in[2];   // left and right input
+
+    // Right records sharing the key of the current left record
+    char *run;
+    RID *runIds;
+    int runLen, runCap, runPos;
+    bool inRun;
+} MergeJoinData;
+
+/*
+ * advanceInput
+ * ------------
+ * Moved an input to its next record in key order that met its condition.
+ */
+static RC advanceInput(MergeInput *in)
+{
+    RID rid;
+    RC rc;
+
+    while ((rc = nextEntry(in->scan, &rid)) == RC_OK)
+    {
+        if ((rc = getRecord(in->rel, rid, in->rec)) != RC_OK)
+            return rc;
+        if (condHolds(in->rec, in->rel->schema, in->cond))
+            return RC_OK;
+    }
+    if (rc == RC_IM_NO_MORE_ENTRIES)
+    {
+        in->done = true;
+        return RC_OK;
+    }
+    return rc;
+}
+
+/*
+ * compareInputs
+ * -------------
+ * Compared the keys of the current left and right records.
+ */
+static int compareInputs(MergeInput *a, MergeInput *b)
+{
+    int alen, blen;
+    const char *ak = joinKey(a->rel->schema, a->attr, a->rec->data, &alen);
+    const char *bk = joinKey(b->rel->schema, b->attr, b->rec->data, &blen);
+    return compareJoinKeys(a->rel->schema->dataTypes[a->attr], ak, alen, bk, blen);
+}
+
+/*
+ * bufferRun
+ * ---------
+ * Copied the right records whose key equalled the current left key into the
+ * run buffer, leaving the right input on the first larger key.
+ */
+static RC bufferRun(MergeJoinData *jd)
+{
+    MergeInput *l = &jd->in[0];
+    MergeInput *r = &jd->in[1];
+    RC rc;
+
+    jd->runLen = 0;
+    while (!r->done && compareInputs(l, r) == 0)
+    {
+        if (jd->runLen == jd->runCap)
+        {
+            int cap = (jd->runCap > 0) ? 2 * jd->runCap : 16;
+            char *run = (char *) realloc(jd->run, (size_t) cap * r->size);
+            RID *ids = (RID *) realloc(jd->runIds, cap * sizeof(RID));
+            if (run != NULL) jd->run = run;
+            if (ids != NULL) jd->runIds = ids;
+            if (run == NULL || ids == NULL)
+                return RC_MEMORY_ALLOCATION_ERROR;
+            jd->runCap = cap;
+        }
+        memcpy(jd->run + (size_t) jd->runLen * r->size, r->rec->data, r->size);
+        jd->runIds[jd->runLen++] = r->rec->id;
+
+        if ((rc = advanceInput(r)) != RC_OK)
+            return rc;
+    }
+    jd->runPos = 0;
+    jd->inRun = true;
+    return RC_OK;
+}
+
+/*
+ * freeMergeJoin
+ * -------------
+ * Released everything a merge join held.
+ */
+static void freeMergeJoin(MergeJoinData *jd)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        if (jd->in[i].scan != NULL)
+            closeTreeScan(jd->in[i].scan);
+        if (jd->in[i].rec != NULL)
+            freeRecord(jd->in[i].rec);
+    }
+    free(jd->run);
+    free(jd->runIds);
+    free(jd);
+}
+
+/*
+ * startMergeJoin
+ * --------------
+ * Started a join of two tables on left.leftAttr = right.rightAttr that read
+ * both through their index on the join attribute, so both came in key order
+ * without sorting. Records also had to satisfy their table's condition.
+ * Returned RC_RM_NO_INDEX if either attribute was not indexed.
+ */
+RC startMergeJoin(RM_TableData *left, int leftAttr, Expr *leftCond,
+                  RM_TableData *right, int rightAttr, Expr *rightCond, RM_JoinHandle *join)
+{
+    RM_TableData *rels[2] = { left, right };
+    int attrs[2] = { leftAttr, rightAttr };
+    Expr *conds[2] = { leftCond, rightCond };
+    RC rc;
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (attrs[i] < 0 || attrs[i] >= rels[i]->schema->numAttr)
+            return RC_RM_NO_SUCH_ATTR;
+    }
+    if (left->schema->dataTypes[leftAttr] != right->schema->dataTypes[rightAttr])
+        return RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE;
+    if (left->schema->dataTypes[leftAttr] == DT_BLOB)
+        return RC_RM_BAD_BLOB_ATTR;
+    if (getTableIndex(left, leftAttr) == NULL || getTableIndex(right, rightAttr) == NULL)
+        return RC_RM_NO_INDEX;
+
+    MergeJoinData *jd = (MergeJoinData *) calloc(1, sizeof(MergeJoinData));
+    if (jd == NULL)
+        return RC_MEMORY_ALLOCATION_ERROR;
+    jd->kind = JOIN_MERGE;
+
+    for (int i = 0; i < 2; i++)
+    {
+        MergeInput *in = &jd->in[i];
+        in->rel  = rels[i];
+        in->attr = attrs[i];
+        in->size = getRecordSize(rels[i]->schema);
+        in->cond = conds[i];
+        createRecord(&in->rec, rels[i]->schema);
+
+        rc = openTreeScan(getTableIndex(rels[i], attrs[i]), &in->scan);
+        if (rc == RC_OK)
+            rc = advanceInput(in);
+        if (rc != RC_OK)
+        {
+            freeMergeJoin(jd);
+            return rc;
+        }
+    }
+
+    join->left = left;
+    join->right = right;
+    join->mgmtData = jd;
+    return RC_OK;
+}
+
+/*
+ * nextMergeJoin
+ * -------------
+ * Returned the next matching pair of a merge join, in join key order. When a
+ * left key was found on the right, the right records with that key were
+ * buffered once and paired with every left record carrying it.
+ */
+static RC nextMergeJoin(MergeJoinData *jd, Record *left, Record *right)
+{
+    MergeInput *l = &jd->in[0];
+    MergeInput *r = &jd->in[1];
+    RC rc;
+
+    while (true)
+    {
+        if (jd->inRun)
+        {
+            if (jd->runPos < jd->runLen)
+            {
+                left->id = l->rec->id;
+                memcpy(left->data, l->rec->data, l->size);
+                right->id = jd->runIds[jd->runPos];
+                memcpy(right->data, jd->run + (size_t) jd->runPos * r->size, r->size);
+                jd->runPos++;
+                return RC_OK;
+            }
+
+            // The next left record reused the run if it had the same key
+            if ((rc = advanceInput(l)) != RC_OK)
+                return rc;
+            if (l->done)
+                return RC_RM_NO_MORE_TUPLES;
+            Record first = { jd->runIds[0], jd->run };
+            int len, rlen;
+            const char *lk = joinKey(l->rel->schema, l->attr, l->rec->data, &len);
+            const char *rk = joinKey(r->rel->schema, r->attr, first.data, &rlen);
+            if (compareJoinKeys(l->rel->schema->dataTypes[l->attr], lk, len, rk, rlen) == 0)
+            {
+                jd->runPos = 0;
+                continue;
+            }
+            jd->inRun = false;
+        }
+
+        if (l->done || r->done)
+            return RC_RM_NO_MORE_TUPLES;
+
+        int c = compareInputs(l, r);
+        if (c < 0)
+            rc = advanceInput(l);
+        else if (c > 0)
+            rc = advanceInput(r);
+        else
+            rc = bufferRun(jd);
+        if (rc != RC_OK)
+            return rc;
+    }
+}
+
+/* --------------------------------------------------------------------------
+   Common interface
+   -------------------------------------------------------------------------- */
+
+/*
+ * nextJoin
+ * --------
+ * Returned the next matching pair of any join, or RC_RM_NO_MORE_TUPLES.
+ */
+RC nextJoin(RM_JoinHandle *join, Record *left, Record *right)
+{
+    switch (*(JoinKind *) join->mgmtData)
+    {
+        case JOIN_HASH:  return nextHashJoin((HashJoinData *) join->mgmtData, left, right);
+        case JOIN_INDEX: return nextIndexJoin((IndexJoinData *) join->mgmtData, left, right);
+        case JOIN_MERGE: return nextMergeJoin((MergeJoinData *) join->mgmtData, left, right);
+    }
+    return RC_ERROR;
+}
+
+/*
+ * closeJoin
+ * ---------
+ * Freed the join's memory, tree scans and temporary files. Scans the caller
+ * passed in stayed open.
+ */
+RC closeJoin(RM_JoinHandle *join)
+{
+    if (join->mgmtData == NULL)
+        return RC_OK;
+
+    switch (*(JoinKind *) join->mgmtData)
+    {
+        case JOIN_HASH:  freeHashJoin((HashJoinData *) join->mgmtData); break;
+        case JOIN_INDEX: freeIndexJoin((IndexJoinData *) join->mgmtData); break;
+        case JOIN_MERGE: freeMergeJoin((MergeJoinData *) join->mgmtData); break;
+    }
+    join->mgmtData = NULL;
+    return RC_OK;
+}
@@ -0,0 +1,52 @@
+#ifndef JOIN_MGR_H
+#define JOIN_MGR_H
+
+#include "dberror.h"
+#include "record_mgr.h"
+
+/*
+ * Equi-joins of two tables on one attribute each.
+ *
+ * Inputs given as RM_ScanHandles were started by the caller, with any
+ * condition or projection (the join attribute had to be among the projected
+ * ones). The join read them to the end but did not close them; the caller
+ * closed the join first and the scans afterwards.
+ *
+ * nextJoin returned one matching pair at a time, copied into two records the
+ * caller created for the left and the right table's schema.
+ *
+ * - startHashJoin built a hash table over the smaller input and suited
+ *   unindexed inputs of any size.
+ * - startIndexJoin looked the outer records up, a batch at a time, in the
+ *   inner table's B+ tree index. It suited a small outer input.
+ * - startMergeJoin walked the indexes of both tables in key order. It suited
+ *   two tables that were both indexed on the join attribute.
+ * The last two kept only a batch or a run of equal keys in memory. None of
+ * them joined on a DT_BLOB attribute (RC_RM_BAD_BLOB_ATTR).
+ */
+
+// Bookkeeping for joins
+typedef struct RM_JoinHandle
+{
+	RM_TableData *left;     // tables the returned pairs came from
+	RM_TableData *right;
+	void *mgmtData;
+} RM_JoinHandle;
+
+// memory the hash join used for its build side when the caller passed 0
+#define RM_JOIN_DEFAULT_MEMORY (1 << 20)
+
+// outer records the index join looked up together
+#define RM_JOIN_BATCH 256
+
+extern RC startHashJoin (RM_ScanHandle *left, int leftAttr, RM_ScanHandle *right, int rightAttr,
+		int memoryBudget, RM_JoinHandle *join);
+// innerCond and the conditions of the merge join may be NULL
+extern RC startIndexJoin (RM_ScanHandle *outer, int outerAttr, RM_TableData *inner, int innerAttr,
+		Expr *innerCond, RM_JoinHandle *join);
+extern RC startMergeJoin (RM_TableData *left, int leftAttr, Expr *leftCond,
+		RM_TableData *right, int rightAttr, Expr *rightCond, RM_JoinHandle *join);
+extern RC nextJoin (RM_JoinHandle *join, Record *left, Record *right);
+extern RC closeJoin (RM_JoinHandle *join);
+
+#endif // JOIN_MGR_H
@@ -0,0 +1,560 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "load_mgr.h"
+#include "record_mgr.h"
+#include "dberror.h"
+#include "tables.h"
+
+/*
+ * load_mgr.c
+ * ---------------------------------------------------------------
+ * Bulk loading.
+ *
+ * The reader handed batches to the converters through a queue, and the
+ * converters handed them to the writer through a list that the writer
+ * searched for the next batch in file order. One mutex and one condition
+ * variable guarded both; every change was broadcast, as there were only a few
+ * threads and every batch held thousands of rows.
+ *
+ * A batch owned the chunk of the file its fields pointed into. A row cut off
+ * at the end of a chunk was copied to the front of the next one, which was the
+ * only copy the reader made.
+ */
+
+/* parseCsvRow/parseBinaryRow results other than the position after the row */
+#define LOAD_MORE   -1      // the row went on past the bytes read so far
+#define LOAD_BAD    -2      // the row had the wrong shape
+
+/* Longest number a CSV field could hold. */
+#define LOAD_NUMBER_CHARS 64
+
+typedef struct LoadField {
+    int off;            // start in the batch's text
+    int len;
+} LoadField;
+
+typedef struct LoadBatch {
+    int seq;            // position in the file among the batches
+    int firstRow;       // number of the batch's first row in the file (from 1)
+    char *text;         // the chunk the fields were slices of
+    int numRows;
+    int capRows;
+    LoadField *fields;  // numAttr per row
+    char *records;      // numRows records of recordSize bytes, made by a converter
+    int badRow;         // first row that could not be loaded, -1 if none
+    const char *why;
+    struct LoadBatch *next;
+} LoadBatch;
+
+/* This structure stored the state shared by the stages of one load. */
+typedef struct LoadData {
+    Schema *schema;
+    int recordSize;
+    FILE *file;
+    RM_LoadFormat format;
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    LoadBatch *parsedHead;      // waiting for a converter, in file order
+    LoadBatch *parsedTail;
+    LoadBatch *converted;       // waiting for the writer, in any order
+    int inFlight;               // batches read but not written yet
+    int numBatches;             // batches the reader had made
+    bool readerDone;
+    bool stop;                  // the writer had given up
+} LoadData;
+
+/* RC_message of the last bad row. */
+static char loadMessage[96];
+
+/* --------------------------------------------------------------------------
+   Reader
+   -------------------------------------------------------------------------- */
+
+/*
+ * parseCsvRow
+ * -----------
+ * Cut the row starting at 'pos' into numAttr fields. The end of the row was
+ * found first, leaving the bytes alone, so a row cut off by the end of the
+ * chunk could be parsed again later; then quoted fields were unquoted in
+ * place. Returned the position after the row (*isRow false for an empty
+ * line), LOAD_MORE or LOAD_BAD.
+ */
+static int parseCsvRow(char *text, int len, int pos, LoadField *fields, int numAttr, bool eof, bool *isRow)
+{
+    int end = pos;
+    bool quoted = false;
+    while (end < len && (quoted || text[end] != '\n'))
+    {
+        if (text[end] == '"')
+            quoted = !quoted;
+        end++;
+    }
+    if (end == len && !eof)
+        return LOAD_MORE;
+
+    int next = (end < len) ? end + 1 : end;
+    int stop = end;
+    if (stop > pos && text[stop - 1] == '\r')
+        stop--;
+    *isRow = (stop > pos);
+    if (!*isRow)
+        return next;
+
+    int f = 0, i = pos;
+    while (true)
+    {
+        if (f == numAttr)
+            return LOAD_BAD;
+
+        int start = i, out = i;
+        if (i < stop && text[i] == '"')
+        {
+            bool closed = false;
+            start = out = ++i;
+            while (i < stop && !closed)
+            {
+                if (text[i] != '"')
+                    text[out++] = text[i++];
+                else if (i + 1 < stop && text[i + 1] == '"')
+                {
+                    text[out++] = '"';
+                    i += 2;
+                }
+                else
+                {
+                    closed = true;
+                    i++;
+                }
+            }
+            if (!closed || (i < stop && text[i] != ','))
+                return LOAD_BAD;
+        }
+        else
+        {
+            while (i < stop && text[i] != ',')
+                i++;
+            out = i;
+        }
+
+        fields[f].off = start;
+        fields[f].len = out - start;
+        f++;
+        if (i >= stop)
+            break;
+        i++;
+    }
+    return (f == numAttr) ? next : LOAD_BAD;
+}
+
+/*
+ * parseBinaryRow
+ * --------------
+ * Found the fields of the binary row starting at 'pos'. Returned the position
+ * after the row, LOAD_MORE, or LOAD_BAD for a row cut off by the end of the file.
+ */
+static int parseBinaryRow(Schema *schema, char *text, int len, int pos, LoadField *fields, bool eof)
+{
+    int i = pos;
+    for (int a = 0; a < schema->numAttr; a++)
+    {
+        int size;
+        if (schema->dataTypes[a] == DT_STRING)
+        {
+            unsigned short strLen;
+            if (i + (int) sizeof(strLen) > len)
+                return eof ? LOAD_BAD : LOAD_MORE;
+            memcpy(&strLen, text + i, sizeof(strLen));
+            i += sizeof(strLen);
+            size = strLen;
+        }
+        else
+            size = (schema->dataTypes[a] == DT_BOOL) ? (int) sizeof(bool) : 4;
+
+        if (i + size > len)
+            return eof ? LOAD_BAD : LOAD_MORE;
+        fields[a].off = i;
+        fields[a].len = size;
+        i += size;
+    }
+    return i;
+}
+
+/*
+ * cutRows
+ * -------
+ * Cut the text of a batch into rows, up to the first row that went on past
+ * it (whose start was returned) or could not be parsed (marked in badRow).
+ */
+static int cutRows(LoadData *ld, LoadBatch *b, int len, bool eof)
+{
+    int numAttr = ld->schema->numAttr;
+    int pos = 0;
+
+    while (pos < len)
+    {
+        if (b->numRows == b->capRows)
+        {
+            b->capRows = (b->capRows > 0) ? 2 * b->capRows : 256;
+            b->fields = (LoadField *) realloc(b->fields, (size_t) b->capRows * numAttr * sizeof(LoadField));
+        }
+
+        LoadField *fields = b->fields + (size_t) b->numRows * numAttr;
+        bool isRow = true;
+        int end = (ld->format == RM_LOAD_CSV)
+            ? parseCsvRow(b->text, len, pos, fields, numAttr, eof, &isRow)
+            : parseBinaryRow(ld->schema, b->text, len, pos, fields, eof);
+
+        if (end == LOAD_MORE)
+            break;
+        if (end == LOAD_BAD)
+        {
+            b->badRow = b->firstRow + b->numRows;
+            b->why = (ld->format == RM_LOAD_CSV) ? "wrong number of fields" : "cut off by the end of the file";
+            break;
+        }
+        if (isRow)
+            b->numRows++;
+        pos = end;
+    }
+    return pos;
+}
+
+/*
+ * readerThread
+ * ------------
+ * Read the file a chunk at a time, cut every chunk into rows and queued it as
+ * a batch for the converters. A chunk that did not hold one whole row was read
+ * again twice as large. Stopped at the end of the file, at the first bad row,
+ * or when the writer gave up.
+ */
+static void *readerThread(void *arg)
+{
+    LoadData *ld = (LoadData *) arg;
+    char *tail = NULL;
+    int tailLen = 0, size = RM_LOAD_CHUNK, row = 1;
+    bool eof = false, failed = false;
+
+    while (!eof && !failed)
+    {
+        pthread_mutex_lock(&ld->lock);
+        while (ld->inFlight >= RM_LOAD_MAX_BATCHES && !ld->stop)
+            pthread_cond_wait(&ld->changed, &ld->lock);
+        if (ld->stop)
+        {
+            pthread_mutex_unlock(&ld->lock);
+            break;
+        }
+        ld->inFlight++;
+        pthread_mutex_unlock(&ld->lock);
+
+        LoadBatch *b = (LoadBatch *) calloc(1, sizeof(LoadBatch));
+        b->text = (char *) malloc(size);
+        b->firstRow = row;
+        b->badRow = -1;
+        if (tailLen > 0)
+            memcpy(b->text, tail, tailLen);
+        int len = tailLen + (int) fread(b->text + tailLen, 1, size - tailLen, ld->file);
+        eof = (len < size);
+        if (ferror(ld->file))
+        {
+            b->badRow = row;
+            b->why = "the file could not be read";
+        }
+        else
+        {
+            int pos = cutRows(ld, b, len, eof);
+            free(tail);
+            tailLen = len - pos;
+            tail = (char *) malloc(tailLen > 0 ? tailLen : 1);
+            memcpy(tail, b->text + pos, tailLen);
+            if (b->numRows == 0 && b->badRow < 0 && !eof)
+                size *= 2;
+        }
+        failed = (b->badRow >= 0);
+        row += b->numRows;
+
+        pthread_mutex_lock(&ld->lock);
+        if (b->numRows == 0 && !failed)
+        {
+            ld->inFlight--;
+            free(b->text);
+            free(b->fields);
+            free(b);
+        }
+        else
+        {
+            b->seq = ld->numBatches++;
+            if (ld->parsedTail != NULL)
+                ld->parsedTail->next = b;
+            else
+                ld->parsedHead = b;
+            ld->parsedTail = b;
+            pthread_cond_broadcast(&ld->changed);
+        }
+        pthread_mutex_unlock(&ld->lock);
+    }
+
+    free(tail);
+    pthread_mutex_lock(&ld->lock);
+    ld->readerDone = true;
+    pthread_cond_broadcast(&ld->changed);
+    pthread_mutex_unlock(&ld->lock);
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------
+   Converters
+   -------------------------------------------------------------------------- */
+
+/*
+ * convertField
+ * ------------
+ * Wrote one field into its place in record->data, which was zeroed, parsing
+ * CSV numbers from a copy on the stack. Returned NULL, or why the field could
+ * not be converted.
+ */
+static const char *convertField(DataType dt, int width, char *src, int len, bool binary, char *dest)
+{
+    char number[LOAD_NUMBER_CHARS];
+    char *end;
+
+    if (!binary && (dt == DT_INT || dt == DT_FLOAT))
+    {
+        if (len == 0 || len >= LOAD_NUMBER_CHARS)
+            return "not a number";
+        memcpy(number, src, len);
+        number[len] = '\0';
+    }
+
+    switch (dt)
+    {
+        case DT_INT:
+        {
+            int v;
+            if (binary)
+                memcpy(&v, src, sizeof(int));
+            else
+            {
+                v = (int) strtol(number, &end, 10);
+                if (*end != '\0')
+                    return "not an int";
+            }
+            memcpy(dest, &v, sizeof(int));
+            break;
+        }
+        case DT_FLOAT:
+        {
+            float v;
+            if (binary)
+                memcpy(&v, src, sizeof(float));
+            else
+            {
+                v = strtof(number, &end);
+                if (*end != '\0')
+                    return "not a float";
+            }
+            memcpy(dest, &v, sizeof(float));
+            break;
+        }
+        case DT_BOOL:
+        {
+            bool v = binary ? (src[0] != 0) : (len > 0 && (src[0] == 't' || src[0] == 'T' || src[0] == '1'));
+            memcpy(dest, &v, sizeof(bool));
+            break;
+        }
+        case DT_STRING:
+            if (len > width)
+                return "string longer than its attribute";
+            memcpy(dest, src, len);
+            break;
+        case DT_BLOB:
+            return "large objects were not loaded";
+    }
+    return NULL;
+}
+
+/*
+ * convertBatch
+ * ------------
+ * Turned the rows of a batch into records, up to the first one that could not
+ * be converted.
+ */
+static void convertBatch(LoadData *ld, LoadBatch *b)
+{
+    Schema *sc = ld->schema;
+    bool binary = (ld->format == RM_LOAD_BINARY);
+
+    b->records = (char *) calloc(b->numRows > 0 ? b->numRows : 1, ld->recordSize);
+    for (int r = 0; r < b->numRows; r++)
+    {
+        char *rec = b->records + (size_t) r * ld->recordSize;
+        LoadField *fields = b->fields + (size_t) r * sc->numAttr;
+        for (int a = 0; a < sc->numAttr; a++)
+        {
+            const char *why = convertField(sc->dataTypes[a], sc->typeLength[a], b->text + fields[a].off,
+                                           fields[a].len, binary, rec + sc->attrOffsets[a]);
+            if (why != NULL)
+            {
+                b->badRow = b->firstRow + r;
+                b->why = why;
+                return;
+            }
+        }
+    }
+}
+
+/*
+ * converterThread
+ * ---------------
+ * Converted queued batches until the reader was done and the queue empty, or
+ * the writer gave up.
+ */
+static void *converterThread(void *arg)
+{
+    LoadData *ld = (LoadData *) arg;
+
+    pthread_mutex_lock(&ld->lock);
+    while (true)
+    {
+        while (ld->parsedHead == NULL && !ld->readerDone && !ld->stop)
+            pthread_cond_wait(&ld->changed, &ld->lock);
+        if (ld->parsedHead == NULL || ld->stop)
+            break;
+
+        LoadBatch *b = ld->parsedHead;
+        ld->parsedHead = b->next;
+        if (ld->parsedHead == NULL)
+            ld->parsedTail = NULL;
+        pthread_mutex_unlock(&ld->lock);
+
+        convertBatch(ld, b);
+
+        pthread_mutex_lock(&ld->lock);
+        b->next = ld->converted;
+        ld->converted = b;
+        pthread_cond_broadcast(&ld->changed);
+    }
+    pthread_mutex_unlock(&ld->lock);
+    return NULL;
+}
+
+/* --------------------------------------------------------------------------
+   Writer
+   -------------------------------------------------------------------------- */
+
+/*
+ * freeBatches
+ * -----------
+ * Freed a list of batches.
+ */
+static void freeBatches(LoadBatch *b)
+{
+    while (b != NULL)
+    {
+        LoadBatch *next = b->next;
+        free(b->text);
+        free(b->fields);
+        free(b->records);
+        free(b);
+        b = next;
+    }
+}
+
+/*
+ * takeConverted
+ * -------------
+ * Took the converted batch with the given position in the file off the list,
+ * or returned NULL if it was not converted yet. Called under the lock.
+ */
+static LoadBatch *takeConverted(LoadData *ld, int seq)
+{
+    for (LoadBatch **link = &ld->converted; *link != NULL; link = &(*link)->next)
+        if ((*link)->seq == seq)
+        {
+            LoadBatch *b = *link;
+            *link = b->next;
+            b->next = NULL;
+            return b;
+        }
+    return NULL;
+}
+
+/*
+ * loadTableFromFile
+ * -----------------
+ * Appended the rows of a file to a table (see load_mgr.h). Started the reader
+ * and the converters, and wrote the converted batches in file order on the
+ * caller's thread.
+ */
+RC loadTableFromFile(RM_TableData *rel, char *path, RM_LoadFormat format)
+{
+    LoadData ld;
+    pthread_t reader, converters[RM_LOAD_CONVERTERS];
+    RC rc = RC_OK;
+    int seq = 0;
+
+    for (int i = 0; i < rel->schema->numAttr; i++)
+        if (rel->schema->dataTypes[i] == DT_BLOB)
+            return RC_RM_BAD_BLOB_ATTR;
+
+    memset(&ld, 0, sizeof(ld));
+    ld.schema = rel->schema;
+    ld.recordSize = getRecordSize(rel->schema);
+    ld.format = format;
+    ld.file = fopen(path, "rb");
+    if (ld.file == NULL)
+        return RC_FILE_NOT_FOUND;
+    pthread_mutex_init(&ld.lock, NULL);
+    pthread_cond_init(&ld.changed, NULL);
+
+    pthread_create(&reader, NULL, readerThread, &ld);
+    for (int i = 0; i < RM_LOAD_CONVERTERS; i++)
+        pthread_create(&converters[i], NULL, converterThread, &ld);
+
+    pthread_mutex_lock(&ld.lock);
+    while (rc == RC_OK)
+    {
+        LoadBatch *b = takeConverted(&ld, seq);
+        if (b == NULL)
+        {
+            if (ld.readerDone && seq == ld.numBatches)
+                break;
+            pthread_cond_wait(&ld.changed, &ld.lock);
+            continue;
+        }
+        pthread_mutex_unlock(&ld.lock);
+
+        int good = (b->badRow >= 0) ? b->badRow - b->firstRow : b->numRows;
+        rc = insertRecords(rel, b->records, good, NULL);
+        if (rc == RC_OK && b->badRow >= 0)
+        {
+            snprintf(loadMessage, sizeof(loadMessage), "row %d: %s", b->badRow, b->why);
+            RC_message = loadMessage;
+            rc = RC_RM_BAD_ROW;
+        }
+        freeBatches(b);
+
+        pthread_mutex_lock(&ld.lock);
+        ld.inFlight--;
+        seq++;
+        pthread_cond_broadcast(&ld.changed);
+    }
+    ld.stop = true;
+    pthread_cond_broadcast(&ld.changed);
+    pthread_mutex_unlock(&ld.lock);
+
+    pthread_join(reader, NULL);
+    for (int i = 0; i < RM_LOAD_CONVERTERS; i++)
+        pthread_join(converters[i], NULL);
+
+    freeBatches(ld.parsedHead);
+    freeBatches(ld.converted);
+    fclose(ld.file);
+    pthread_mutex_destroy(&ld.lock);
+    pthread_cond_destroy(&ld.changed);
+    return rc;
+}
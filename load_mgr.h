@@ -0,0 +1,54 @@
+#ifndef LOAD_MGR_H
+#define LOAD_MGR_H
+
+#include "dberror.h"
+#include "record_mgr.h"
+
+/*
+ * Bulk loading of a table from a file.
+ *
+ * loadTableFromFile appended every row of a file to a table through a
+ * pipeline of three stages:
+ *   - a reader thread read the file a chunk at a time and cut it into rows and
+ *     fields, which were slices of the chunk (nothing was copied),
+ *   - converter threads turned the fields of a batch of rows into records,
+ *     parsing numbers in place,
+ *   - the caller's thread wrote the records, in file order, with insertRecords,
+ *     which filled one page at a time.
+ * Indexes, zone maps and the tuple count were kept up to date as with
+ * insertRecord.
+ *
+ * Formats:
+ *   - RM_LOAD_CSV: one row per line ("\n" or "\r\n"), fields in schema order
+ *     separated by commas. A field could be quoted ("..."), with "" standing
+ *     for a quote; quoted fields could hold commas and line breaks. Ints and
+ *     floats were written as for stringToValue, without its type letter, and
+ *     nothing could follow them; bools were true if they began with 't', 'T'
+ *     or '1'. Empty lines were skipped.
+ *   - RM_LOAD_BINARY: rows back to back, each the attributes in schema order:
+ *     ints and floats as 4 bytes and bools as 1 byte in the machine's byte
+ *     order, strings as an unsigned short length followed by that many bytes.
+ *
+ * A row that could not be read (wrong number of fields, a malformed number, a
+ * string longer than its attribute) stopped the load with RC_RM_BAD_ROW and
+ * RC_message naming the row; the rows before it stayed in the table. Tables
+ * with DT_BLOB attributes could not be loaded (RC_RM_BAD_BLOB_ATTR).
+ */
+
+typedef enum RM_LoadFormat {
+	RM_LOAD_CSV = 0,
+	RM_LOAD_BINARY = 1
+} RM_LoadFormat;
+
+// bytes the reader cut into rows at a time (rows could be longer)
+#define RM_LOAD_CHUNK (64 * 1024)
+
+// threads converting batches at once
+#define RM_LOAD_CONVERTERS 3
+
+// batches read but not yet written; the reader waited beyond this
+#define RM_LOAD_MAX_BATCHES 8
+
+extern RC loadTableFromFile (RM_TableData *rel, char *path, RM_LoadFormat format);
+
+#endif // LOAD_MGR_H
@@ -2,91 +2,481 @@
 #include <stdlib.h>
 #include <string.h>      // for memcpy, memset, etc.
 #include <stdbool.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include "record_mgr.h"
 #include "buffer_mgr.h"
 #include "storage_mgr.h"
 #include "dberror.h"
 #include "expr.h"
 #include "tables.h"
+#include "rm_page.h"
+#include "rm_zonemap.h"
+#include "rm_version.h"
+#include "rm_stats.h"
+#include "rm_dict.h"
+#include "rm_partition.h"
+#include "rm_arena.h"
+#include "btree_mgr.h"
 
 /*
  * Data structures used internally
  * ---------------------------------------------------------------
  * - RM_TableMgmtData: stored the buffer pool and table-level metadata.
  * - RM_ScanMgmtData : stored scan-related information (current page, slot, etc.).
+ *
+ * Several threads could insert, update, delete, read and scan one open table
+ * at once (see "Latches" below). Creating, opening, closing and vacuuming a
+ * table still needed it to themselves.
  */
 
+/* Latch stripes: a page used pageLatches[page % RM_PAGE_LATCHES], and so on. */
+#define RM_PAGE_LATCHES     64
+#define RM_RECORD_LATCHES   64
+
+/* Threads took turns among this many insert target pages per table. */
+#define RM_INSERT_TARGETS   16
+
+/*
+ * Frames in a table's buffer pool. A pin failed when every frame was pinned,
+ * so there were enough for each insert target's thread to hold a page and
+ * the page it led to, with room left for record views kept by callers.
+ */
+#define RM_POOL_PAGES       (4 * RM_INSERT_TARGETS)
+
 /* This structure stored the essential table metadata. */
 typedef struct RM_TableMgmtData {
     BM_BufferPool bufferPool; // This had been the buffer pool used by the table
-    int numTuples;            // This had been the total number of tuples present in the table
-    int nextFreePage;         // This had been the first data page that might have free slots (-1 if none)
-    int recordSize;           // This had been the size, in bytes, of each record
+    RM_Arena *arena;          // In-memory tables: where the pages lay instead (NULL otherwise)
+    atomic_int numTuples;     // This had been the total number of tuples present in the table
+    int nextFreePage;         // This had been the heap page new records went to first (-1 if none)
+    int recordSize;           // This had been the size, in bytes, of each record in memory
+    atomic_int numPages;      // Pages in the page file, including the header page 0
+    int freePageHead;         // First page of the free page chain (-1 if empty)
+
+    // Stored record layout, derived from the schema when the table was opened
+    int fixedSize;            // Bytes taken by all non-string attributes
+    int numStrings;           // Number of DT_STRING attributes stored as strings
+    int *encOffset;           // Per attribute: offset in the fixed part, or index among the strings
+    int numBlobs;             // Number of DT_BLOB attributes (their large objects went with the record)
+
+    // Dictionaries of the attributes stored as codes, kept in RM_PAGE_DICT chains
+    int numDicts;
+    RM_Dictionary **dictOf;   // Per attribute: its dictionary, NULL if not encoded
+
+    // Page layout chosen when the table was created
+    RM_Layout layout;
+    int paxCapacity;          // Records per PAX page
+    int *paxColStart;         // Start of each attribute's minipage on a PAX page
+
+    // Per-page min/max of the zoned attributes, saved in an overflow chain on close
+    RM_ZoneMap zoneMap;
+    int zoneMapPage;          // First page of the saved zone map (-1 if none)
+
+    // Secondary B+ tree indexes, kept in sync by insert/update/deleteRecord
+    int numIndexes;
+    int *indexAttrs;          // Indexed attribute of each index
+    BTreeHandle **indexes;    // Open index handles (NULL while not opened)
+
+    WAL_Log *log;             // Write-ahead log the table's pages went to (NULL if none)
+
+    // Versions replaced while snapshots were open
+    RM_VersionStore versions;
+
+    // Statistics from the last analyzeTable, saved on page 0
+    RM_TableStats stats;
+
+    // Partitioned tables: the partitions, whose list was saved in an overflow chain
+    RM_PartitionSet *partSet; // NULL if the table held its records itself
+    int partMapPage;          // First page of the saved list (-1 if none)
+
+    // Latches for threads sharing the table
+    pthread_mutex_t spaceLatch;   // numPages growth, freePageHead and the insert targets
+    pthread_mutex_t indexLatch;   // the B+ trees, which were not thread-safe
+    pthread_mutex_t dictLatch;    // finding and adding dictionary codes
+    pthread_rwlock_t pageLatches[RM_PAGE_LATCHES];      // contents of pinned pages
+    pthread_mutex_t recordLatches[RM_RECORD_LATCHES];   // one update or delete of a RID
+    int insertTargets[RM_INSERT_TARGETS];   // per-thread insert targets; slot 0 used nextFreePage
 } RM_TableMgmtData;
 
+/* The most "attribute <op> constant" terms a scan checked directly. */
+#define RM_MAX_SCAN_PREDS 8
+
+/* Cost of handling one tuple, in page reads, when access paths were compared. */
+#define RM_PLAN_TUPLE_COST  0.01
+
+/* Scans sampled a table again once its tuple count had drifted this far from
+   the one its statistics were gathered at (see statsFresh). */
+#define RM_PLAN_STALE_FRACTION  0.2
+#define RM_PLAN_STALE_MIN       100
+
+/* Data pages a scan sampled when it gathered statistics itself; analyzeTable
+   read up to RM_STATS_SAMPLE_PAGES. */
+#define RM_PLAN_SAMPLE_PAGES    8
+
+/* The key range of one index that the terms of a scan bounded. */
+typedef struct RM_IndexRange {
+    int index;          // position among the table's indexes
+    Value *low;         // NULL => unbounded (both point into the condition)
+    Value *high;
+    int lowInc;
+    int highInc;
+    double sel;         // estimated fraction of the tuples in the range
+} RM_IndexRange;
+
+/* A term of a scan condition on a dictionary-encoded attribute: the codes it
+   accepted, one bit each (an equality accepted one, an OR of equalities on the
+   same attribute several). */
+typedef struct RM_DictTerm {
+    int offset;                 // of the code in a record body
+    unsigned char *codes;       // RM_DICT_MAX_CODES bits
+} RM_DictTerm;
+
 /* This structure stored the state for a table scan in progress. */
 typedef struct RM_ScanMgmtData {
     int currentPage;    // Which page was being scanned
     int currentSlot;    // Which slot within that page
     Expr *cond;         // The scan condition (NULL if no filtering)
+    bool *needAttr;     // Attributes to fill in, or NULL for all of them
+
+    // Terms of cond that PAX pages evaluated a whole minipage at a time
+    int numPreds;
+    AttrPredicate preds[RM_MAX_SCAN_PREDS];
+    bool predsExact;    // true if the terms alone decided cond
+    char *match;        // Per slot result of the terms for the current PAX page
+
+    // Terms of cond checked against the zone map before a page was read
+    int numZonePreds;
+    AttrPredicate zonePreds[RM_MAX_SCAN_PREDS];
+
+    // Terms of cond that heap pages evaluated on dictionary codes
+    int numDictTerms;
+    RM_DictTerm dictTerms[RM_MAX_SCAN_PREDS];
+    bool dictExact;     // true if the terms alone decided cond
+    char *dictMatch;    // Per slot result of the terms for the current heap page
+    int dictSlots;      // Slots of the current page dictMatch covered
+
+    // How the scan reached the records, chosen by planScan
+    RM_ScanPlan plan;
+
+    // Index scans: the matching RIDs, sorted so heap pages were read in order
+    RID *rids;          // NULL for a scan over all pages
+    int numRids;
+    int ridPos;
+
+    // Snapshot scans: what the snapshot saw of the current page, collected at once
+    bool asOf;
+    RM_Timestamp snapshot;
+    RID *batchIds;
+    char *batch;        // batchLen records of recordSize bytes
+    int batchLen;
+    int batchCap;
+    int batchPos;
+    RM_VersionHit *hits;    // Scratch space for rmVersionsOnPage
+    char *hitData;
+    int hitCap;
+
+    // Scans of partitioned tables: a scan of each partition the condition left, in turn
+    int *parts;         // positions of those partitions, NULL for other scans
+    int numParts;
+    int partPos;
+    RM_ScanHandle partScan;
+    bool partOpen;      // partScan was started on parts[partPos]
+    int numProjAttrs;   // the attributes the partition scans filled in
+    int *projAttrs;
+
+    // nextView: where records were decoded when the condition needed them
+    char *viewData;
 } RM_ScanMgmtData;
 
+/* This structure stored the state of an open large object. */
+typedef struct RM_BlobMgmtData {
+    long long length;   // Bytes in the object
+    long long pos;      // Where the next read or write started
+    int dirPage;        // The directory page last used (sequential access stayed on it)
+    int dirFirst;       // Index of the first data page it listed
+} RM_BlobMgmtData;
+
+/*
+ * Stored record body
+ * ---------------------------------------------------------------
+ * After the flag byte (and the home RID of a moved record) came:
+ *   - the non-string attributes, packed at encOffset[i], and likewise the
+ *     unsigned short code of every dictionary-encoded string,
+ *   - one unsigned short per string attribute holding the end offset of its
+ *     bytes in the variable part (RM_VAR_TOASTED set => an RM_ToastPointer),
+ *   - the variable part: each string without its zero padding.
+ * Strings longer than RM_TOAST_THRESHOLD, or whatever was needed to make the
+ * record fit on a page, were moved into overflow page chains.
+ */
+#define RM_VAR_TOASTED      0x8000
+#define RM_VAR_END_MASK     0x7fff
+#define RM_TOAST_THRESHOLD  (PAGE_SIZE / 4)
+
+/* A deleted record made its page an insert target again once this much was free. */
+#define RM_FREE_SPACE_HINT  (PAGE_SIZE / 4)
+
+typedef struct RM_ToastPointer {
+    int length;      // Full length of the string
+    int firstPage;   // First overflow page holding it
+} RM_ToastPointer;
+
+/* --------------------------------------------------------------------------
+   Latches
+   --------------------------------------------------------------------------
+   A thread held at most one page of a table pinned at a time, and latched it
+   while it did: shared to read the page, exclusive to change it. Latches were
+   striped by page number, so a latch stood for several pages. The free page
+   chain, numPages and the insert targets were changed under spaceLatch (taken
+   before a page latch, never while holding one). Updates and deletes of the
+   same RID were serialized by a record latch, the indexes by indexLatch, new
+   dictionary codes by dictLatch (taken before spaceLatch), and tuple counts
+   were atomic. Each thread inserted into its own target page
+   (threads took turns among RM_INSERT_TARGETS slots), so concurrent inserts
+   did not all queue up on the latch of a single tail page.
+   -------------------------------------------------------------------------- */
+
+/* Insert target slot of the calling thread (-1 until its first insert). */
+static __thread int threadSlot = -1;
+static atomic_int nextThreadSlot = 0;
+
+/*
+ * initLatches
+ * -----------
+ * Set up the latches of a table's mgmt data, with no insert targets yet.
+ */
+static void
+initLatches(RM_TableMgmtData *tblData)
+{
+    pthread_mutex_init(&tblData->spaceLatch, NULL);
+    pthread_mutex_init(&tblData->indexLatch, NULL);
+    pthread_mutex_init(&tblData->dictLatch, NULL);
+    for (int i = 0; i < RM_PAGE_LATCHES; i++)
+        pthread_rwlock_init(&tblData->pageLatches[i], NULL);
+    for (int i = 0; i < RM_RECORD_LATCHES; i++)
+        pthread_mutex_init(&tblData->recordLatches[i], NULL);
+    for (int i = 0; i < RM_INSERT_TARGETS; i++)
+        tblData->insertTargets[i] = -1;
+}
+
+/*
+ * destroyLatches
+ * --------------
+ * Released the latches set up by initLatches.
+ */
+static void
+destroyLatches(RM_TableMgmtData *tblData)
+{
+    pthread_mutex_destroy(&tblData->spaceLatch);
+    pthread_mutex_destroy(&tblData->indexLatch);
+    pthread_mutex_destroy(&tblData->dictLatch);
+    for (int i = 0; i < RM_PAGE_LATCHES; i++)
+        pthread_rwlock_destroy(&tblData->pageLatches[i]);
+    for (int i = 0; i < RM_RECORD_LATCHES; i++)
+        pthread_mutex_destroy(&tblData->recordLatches[i]);
+}
+
+/*
+ * latchPage
+ * ---------
+ * Pinned a page and latched it, exclusively if the caller was going to change it.
+ * The pages of an in-memory table were used where they lay in its arena.
+ */
+static RC
+latchPage(RM_TableMgmtData *tblData, BM_PageHandle *page, int pageNum, bool exclusive)
+{
+    if (tblData->arena != NULL)
+    {
+        page->pageNum = pageNum;
+        page->data = rmArenaPage(tblData->arena, pageNum);
+        if (page->data == NULL)
+            return RC_RM_ARENA_FULL;
+    }
+    else
+    {
+        RC rc = pinPage(&tblData->bufferPool, page, pageNum);
+        if (rc != RC_OK) return rc;
+    }
+
+    pthread_rwlock_t *latch = &tblData->pageLatches[pageNum % RM_PAGE_LATCHES];
+    if (exclusive)
+        pthread_rwlock_wrlock(latch);
+    else
+        pthread_rwlock_rdlock(latch);
+    return RC_OK;
+}
+
+/*
+ * unlatchPage
+ * -----------
+ * Unpinned a page latched by latchPage, then released the latch (a logged
+ * page was logged on unpin, so nobody changed it halfway through).
+ */
+static RC
+unlatchPage(RM_TableMgmtData *tblData, BM_PageHandle *page)
+{
+    RC rc = (tblData->arena != NULL) ? RC_OK : unpinPage(&tblData->bufferPool, page);
+    pthread_rwlock_unlock(&tblData->pageLatches[page->pageNum % RM_PAGE_LATCHES]);
+    return rc;
+}
+
+/*
+ * dirtyPage
+ * ---------
+ * Marked a latched page as changed, so the buffer pool wrote it back (the
+ * arena of an in-memory table already held the change).
+ */
+static void
+dirtyPage(RM_TableMgmtData *tblData, BM_PageHandle *page)
+{
+    if (tblData->arena == NULL)
+        markDirty(&tblData->bufferPool, page);
+}
+
+/*
+ * flushTable
+ * ----------
+ * Wrote the table's dirty pages back to its page file. An in-memory table had
+ * nothing to write.
+ */
+static RC
+flushTable(RM_TableMgmtData *tblData)
+{
+    return (tblData->arena != NULL) ? RC_OK : forceFlushPool(&tblData->bufferPool);
+}
+
+/*
+ * recordLatch
+ * -----------
+ * Returned the latch that serialized updates and deletes of a RID.
+ */
+static pthread_mutex_t *
+recordLatch(RM_TableMgmtData *tblData, RID id)
+{
+    unsigned h = (unsigned) id.page * 31u + (unsigned) id.slot;
+    return &tblData->recordLatches[h % RM_RECORD_LATCHES];
+}
+
+/*
+ * insertTarget
+ * ------------
+ * Returned the insert target of the calling thread. The first thread to
+ * insert anything used nextFreePage, which was saved with the table, so a
+ * single-threaded program filled pages exactly as before. Read and written
+ * under spaceLatch.
+ */
+static int *
+insertTarget(RM_TableMgmtData *tblData)
+{
+    if (threadSlot < 0)
+        threadSlot = atomic_fetch_add(&nextThreadSlot, 1) % RM_INSERT_TARGETS;
+    return (threadSlot == 0) ? &tblData->nextFreePage : &tblData->insertTargets[threadSlot];
+}
+
 /* --------------------------------------------------------------------------
    Helpers
    -------------------------------------------------------------------------- */
 
+/*
+ * attrSize
+ * --------
+ * Returned how many bytes one attribute took up inside record->data.
+ */
+static int
+attrSize(Schema *schema, int attrNum)
+{
+    switch (schema->dataTypes[attrNum])
+    {
+        case DT_INT:    return sizeof(int);
+        case DT_FLOAT:  return sizeof(float);
+        case DT_BOOL:   return sizeof(bool);
+        case DT_STRING: return schema->typeLength[attrNum];
+        case DT_BLOB:   return sizeof(int);
+    }
+    return 0;
+}
+
 /* 
  * computeRecordSize
  * -----------------
  * Determined how many bytes a record required, based on its schema.
- * Summed up the byte sizes for each attribute's data type.
+ * The per-attribute offsets were summed once in createSchema, so the last
+ * entry of attrOffsets already held the total.
  */
 static int
 computeRecordSize(Schema *schema)
 {
-    int size = 0;
+    return schema->attrOffsets[schema->numAttr];
+}
+
+/*
+ * isVarAttr
+ * ---------
+ * Told whether an attribute was stored in the variable part of a record: a
+ * string that was not dictionary-encoded.
+ */
+static bool
+isVarAttr(RM_TableMgmtData *tblData, Schema *schema, int attrNum)
+{
+    return schema->dataTypes[attrNum] == DT_STRING && tblData->dictOf[attrNum] == NULL;
+}
+
+/*
+ * initRecordLayout
+ * ----------------
+ * Worked out where each attribute lived inside a stored record: non-string
+ * attributes and dictionary codes got a fixed offset, strings got their index
+ * in the variable part. The dictionaries had to be set up first.
+ */
+static void
+initRecordLayout(RM_TableMgmtData *tblData, Schema *schema)
+{
+    tblData->encOffset  = (int *) malloc(schema->numAttr * sizeof(int));
+    tblData->fixedSize  = 0;
+    tblData->numStrings = 0;
+    tblData->numBlobs   = 0;
+
     for (int i = 0; i < schema->numAttr; i++)
     {
-        switch (schema->dataTypes[i])
+        if (schema->dataTypes[i] == DT_BLOB)
+            tblData->numBlobs++;
+        if (isVarAttr(tblData, schema, i))
+            tblData->encOffset[i] = tblData->numStrings++;
+        else
         {
-            case DT_INT:    
-                size += sizeof(int);    
-                break;
-            case DT_FLOAT:  
-                size += sizeof(float);  
-                break;
-            case DT_BOOL:   
-                size += sizeof(bool);   
-                break;
-            case DT_STRING: 
-                size += schema->typeLength[i];  
-                break;
+            tblData->encOffset[i] = tblData->fixedSize;
+            tblData->fixedSize += (tblData->dictOf[i] != NULL) ? (int) sizeof(unsigned short)
+                                                               : attrSize(schema, i);
         }
     }
-    return size;
 }
 
 /* 
  * writeTableInfo
  * --------------
- * Wrote table metadata (numTuples, nextFreePage, schema info) into page 0.
- * Used the buffer manager to pin page 0, cleared it, and wrote lines describing
- * attribute data types, lengths, etc.
+ * Wrote table metadata (numTuples, nextFreePage, freePageHead, schema info,
+ * table options, statistics) into page 0. Used the buffer manager to pin page 0, cleared it, and wrote
+ * lines describing attribute data types, lengths, etc.
  */
 static RC
 writeTableInfo(RM_TableData *rel)
 {
     RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
     BM_PageHandle page;
-    RC rc = pinPage(&tblData->bufferPool, &page, 0);
+
+    // First line: numTuples, nextFreePage, freePageHead (read before page 0
+    // was latched, since spaceLatch came before page latches)
+    char buffer[512];
+    pthread_mutex_lock(&tblData->spaceLatch);
+    sprintf(buffer, "%d %d %d\n", (int) tblData->numTuples, tblData->nextFreePage, tblData->freePageHead);
+    pthread_mutex_unlock(&tblData->spaceLatch);
+
+    RC rc = latchPage(tblData, &page, 0, true);
     if (rc != RC_OK) return rc;
 
     // Cleared out page 0
     memset(page.data, 0, PAGE_SIZE);
-
-    // First line: numTuples, nextFreePage
-    char buffer[512];
-    sprintf(buffer, "%d %d\n", tblData->numTuples, tblData->nextFreePage);
     strcpy(page.data, buffer);
     int offset = (int) strlen(buffer);
 
@@ -107,40 +497,88 @@ writeTableInfo(RM_TableData *rel)
         offset += (int) strlen(buffer);
     }
 
-    // Marked page as dirty, unpinned, and forced to disk
-    markDirty(&tblData->bufferPool, &page);
-    unpinPage(&tblData->bufferPool, &page);
-    forcePage(&tblData->bufferPool, &page);
+    // Then the table options, one "key value" line each
+    sprintf(buffer, "layout %d\n", (int) tblData->layout);
+    strcpy(page.data + offset, buffer);
+    offset += (int) strlen(buffer);
 
-    return RC_OK;
+    for (int i = 0; i < tblData->zoneMap.numAttrs; i++)
+    {
+        sprintf(buffer, "zoneattr %d\n", tblData->zoneMap.attrs[i]);
+        strcpy(page.data + offset, buffer);
+        offset += (int) strlen(buffer);
+    }
+    for (int i = 0; i < tblData->numIndexes; i++)
+    {
+        sprintf(buffer, "index %d\n", tblData->indexAttrs[i]);
+        strcpy(page.data + offset, buffer);
+        offset += (int) strlen(buffer);
+    }
+    for (int i = 0; i < sc->numAttr; i++)
+    {
+        if (tblData->dictOf[i] == NULL)
+            continue;
+        sprintf(buffer, "dictattr %d\ndictpage %d\n", i, tblData->dictOf[i]->firstPage);
+        strcpy(page.data + offset, buffer);
+        offset += (int) strlen(buffer);
+    }
+    if (tblData->zoneMapPage > 0)
+    {
+        sprintf(buffer, "zonemap %d\nzoneentries %d\n", tblData->zoneMapPage, tblData->zoneMap.numEntries);
+        strcpy(page.data + offset, buffer);
+        offset += (int) strlen(buffer);
+    }
+    if (tblData->partSet != NULL)
+    {
+        RM_PartitionSet *ps = tblData->partSet;
+        sprintf(buffer, "partscheme %d\npartattr %d\npartnext %d\npartmap %d\npartentries %d\n",
+                (int) ps->scheme, ps->attr, ps->nextId, tblData->partMapPage, ps->numParts);
+        strcpy(page.data + offset, buffer);
+        offset += (int) strlen(buffer);
+    }
+
+    // Last the statistics, as far as they fit on the page
+    pthread_mutex_lock(&tblData->stats.lock);
+    offset += rmStatsWrite(&tblData->stats, page.data + offset, PAGE_SIZE - 1 - offset);
+    pthread_mutex_unlock(&tblData->stats.lock);
+
+    // Marked page as dirty, unpinned, and forced to disk (a logged table
+    // relied on the log record written on unpin instead, and an in-memory
+    // table had no disk)
+    dirtyPage(tblData, &page);
+    rc = unlatchPage(tblData, &page);
+    if (rc == RC_OK && tblData->log == NULL && tblData->arena == NULL)
+        forcePage(&tblData->bufferPool, &page);
+
+    return rc;
 }
 
 /* 
  * readTableInfo
  * -------------
  * Read table metadata from page 0. This pinned page 0, parsed lines for
- * numTuples, nextFreePage, number of attributes, each attribute's data type,
- * name, etc.
+ * numTuples, nextFreePage, freePageHead, number of attributes, each
+ * attribute's data type, name, the table options, etc.
  */
 static RC
 readTableInfo(RM_TableData *rel)
 {
     RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
     BM_PageHandle page;
-    RC rc = pinPage(&tblData->bufferPool, &page, 0);
+    RC rc = latchPage(tblData, &page, 0, false);
     if (rc != RC_OK) return rc;
 
     char *data = page.data;
-    int numT, freeP;
-    int offset = 0;
+    int numT = 0, freeP = -1, freeHead = -1;
 
-    // Parsed line 1: "numTuples nextFreePage"
-    sscanf(data, "%d %d\n%n", &numT, &freeP, &offset);
+    // Parsed line 1: "numTuples nextFreePage freePageHead"
+    sscanf(data, "%d %d %d", &numT, &freeP, &freeHead);
     tblData->numTuples    = numT;
     tblData->nextFreePage = freeP;
+    tblData->freePageHead = freeHead;
 
     // Parsed line 2: number of attributes
-    data += offset;
+    data = strchr(data, '\n') + 1;
     int numAttr;
     int used = 0;
     sscanf(data, "%d\n%n", &numAttr, &used);
@@ -165,6 +603,60 @@ readTableInfo(RM_TableData *rel)
         strcpy(attrNames[i], nameBuf);
     }
 
+    // Parsed the optional "key value" lines that followed the schema
+    char key[32];
+    int value;
+    int zoneAttrs[numAttr > 0 ? numAttr : 1];
+    int numZoneAttrs = 0, zoneEntries = 0;
+    int partScheme = RM_PART_NONE, partAttr = 0, partNext = 0, partEntries = 0;
+    tblData->layout      = RM_LAYOUT_ROW;
+    tblData->zoneMapPage = -1;
+    tblData->partSet     = NULL;
+    tblData->partMapPage = -1;
+    tblData->numIndexes  = 0;
+    tblData->indexAttrs  = (int *) malloc((numAttr > 0 ? numAttr : 1) * sizeof(int));
+    tblData->indexes     = NULL;
+    tblData->numDicts    = 0;
+    tblData->dictOf      = (RM_Dictionary **) calloc(numAttr > 0 ? numAttr : 1, sizeof(RM_Dictionary *));
+    RM_Dictionary *dict  = NULL;
+    rmStatsInit(&tblData->stats, numAttr);
+    while (sscanf(data, "%31s %d\n%n", key, &value, &used) == 2)
+    {
+        int statsLen;
+        if (strcmp(key, "dictattr") == 0 && value >= 0 && value < numAttr && tblData->dictOf[value] == NULL)
+        {
+            dict = (RM_Dictionary *) malloc(sizeof(RM_Dictionary));
+            rmDictInit(dict, value, typeLength[value]);
+            tblData->dictOf[value] = dict;
+            tblData->numDicts++;
+        }
+        else if (strcmp(key, "dictpage") == 0 && dict != NULL)
+            dict->firstPage = dict->lastPage = value;
+        else if (strcmp(key, "layout") == 0)
+            tblData->layout = (RM_Layout) value;
+        else if (strcmp(key, "zoneattr") == 0 && numZoneAttrs < numAttr)
+            zoneAttrs[numZoneAttrs++] = value;
+        else if (strcmp(key, "zonemap") == 0)
+            tblData->zoneMapPage = value;
+        else if (strcmp(key, "zoneentries") == 0)
+            zoneEntries = value;
+        else if (strcmp(key, "index") == 0 && tblData->numIndexes < numAttr)
+            tblData->indexAttrs[tblData->numIndexes++] = value;
+        else if (strcmp(key, "partscheme") == 0)
+            partScheme = value;
+        else if (strcmp(key, "partattr") == 0 && value >= 0 && value < numAttr)
+            partAttr = value;
+        else if (strcmp(key, "partnext") == 0)
+            partNext = value;
+        else if (strcmp(key, "partmap") == 0)
+            tblData->partMapPage = value;
+        else if (strcmp(key, "partentries") == 0)
+            partEntries = value;
+        else if ((statsLen = rmStatsParse(&tblData->stats, key, value, data + used)) > 0)
+            used += statsLen;
+        data += used;
+    }
+
     // Created a default "keys" array with one attribute (assumed index 0)
     int *keys = (int*) malloc(sizeof(int));
     keys[0] = 0;
@@ -173,399 +665,5094 @@ readTableInfo(RM_TableData *rel)
     Schema *sc = createSchema(numAttr, attrNames, dataTypes, typeLength, 1, keys);
     rel->schema = sc;
 
-    // Computed record size
+    // Computed record size and the stored record layout
     tblData->recordSize = computeRecordSize(sc);
+    initRecordLayout(tblData, sc);
+
+    tblData->paxColStart = NULL;
+    if (tblData->layout == RM_LAYOUT_PAX)
+    {
+        tblData->paxColStart = (int *) malloc(numAttr * sizeof(int));
+        tblData->paxCapacity = rmPaxLayout(sc, tblData->paxColStart);
+    }
+
+    // The saved entries themselves were read by openTable
+    rmZoneInit(&tblData->zoneMap, sc, numZoneAttrs, zoneAttrs);
+    rmZoneReserve(&tblData->zoneMap, zoneEntries);
+
+    // Likewise the partition list (see openPartitions)
+    if (partScheme != RM_PART_NONE)
+    {
+        tblData->partSet = (RM_PartitionSet *) malloc(sizeof(RM_PartitionSet));
+        rmPartInit(tblData->partSet, (RM_PartScheme) partScheme, partAttr, dataTypes[partAttr]);
+        for (int i = 0; i < partEntries; i++)
+            rmPartAdd(tblData->partSet);
+        tblData->partSet->nextId = partNext;
+    }
 
-    unpinPage(&tblData->bufferPool, &page);
+    unlatchPage(tblData, &page);
     return RC_OK;
 }
 
+/* --------------------------------------------------------------------------
+   Page allocation and overflow chains
+   -------------------------------------------------------------------------- */
+
 /*
- * computeMaxSlots
- * ---------------
- * Calculated how many records (slots) could fit in one page. We used 4 bytes
- * to store "slotsUsed," plus 1 usage byte per slot, plus (recSize * #slots).
- * This solved N * (recSize+1) + 4 <= PAGE_SIZE to get N.
+ * allocPage
+ * ---------
+ * Handed out a page for the caller to format: the head of the free page chain
+ * if there was one, otherwise a new page at the end of the file (pinPage grew
+ * the file when the page was first pinned). Took spaceLatch.
  */
-static int
-computeMaxSlots(int recSize)
+static RC
+allocPage(RM_TableMgmtData *tblData, int *pageNum)
 {
-    return (PAGE_SIZE - 4) / (recSize + 1);
+    RC rc = RC_OK;
+    pthread_mutex_lock(&tblData->spaceLatch);
+    if (tblData->freePageHead > 0)
+    {
+        BM_PageHandle page;
+        rc = latchPage(tblData, &page, tblData->freePageHead, false);
+        if (rc == RC_OK)
+        {
+            *pageNum = tblData->freePageHead;
+            tblData->freePageHead = RM_PAGE_HDR(page.data)->nextPage;
+            unlatchPage(tblData, &page);
+        }
+    }
+    else
+        *pageNum = tblData->numPages++;
+    pthread_mutex_unlock(&tblData->spaceLatch);
+    return rc;
 }
 
 /*
- * getSlotFlag / setSlotFlag
- * -------------------------
- * Provided quick access to the 1-byte usage flags for each slot.
- * If usage is 0 => free, 1 => used, etc.
+ * releasePage
+ * -----------
+ * Put a page that was no longer needed at the head of the free page chain.
+ * Took spaceLatch.
  */
-static int getSlotFlag(char *data, int slotNum) {
-    return (unsigned char)(data[4 + slotNum]);
-}
-static void setSlotFlag(char *data, int slotNum, int val) {
-    data[4 + slotNum] = (char) val;
+static RC
+releasePage(RM_TableMgmtData *tblData, int pageNum)
+{
+    BM_PageHandle page;
+    pthread_mutex_lock(&tblData->spaceLatch);
+    RC rc = latchPage(tblData, &page, pageNum, true);
+    if (rc == RC_OK)
+    {
+        rmInitPage(page.data, RM_PAGE_FREE);
+        RM_PAGE_HDR(page.data)->nextPage = tblData->freePageHead;
+        tblData->freePageHead = pageNum;
+
+        dirtyPage(tblData, &page);
+        unlatchPage(tblData, &page);
+    }
+    pthread_mutex_unlock(&tblData->spaceLatch);
+    return rc;
 }
 
-/* --------------------------------------------------------------------------
-   Record Manager Interface
-   -------------------------------------------------------------------------- */
+/*
+ * writeOverflow
+ * -------------
+ * Stored 'len' bytes in a chain of overflow pages and returned the first page.
+ * All the pages were allocated before any was written, so only one page was
+ * pinned at a time, and a chain that could not be finished was given back
+ * whole (*firstPage was only set on success).
+ */
+static RC
+writeOverflow(RM_TableMgmtData *tblData, char *src, int len, int *firstPage)
+{
+    BM_PageHandle page;
+    int numPages = (len > 0) ? (len + RM_OVERFLOW_CAPACITY - 1) / RM_OVERFLOW_CAPACITY : 1;
+    int pages[numPages];
+    int allocated = 0;
+    RC rc = RC_OK;
 
-/* 
- * initRecordManager
- * -----------------
- * Performed global initialization if needed (here we just called initStorageManager).
+    while (allocated < numPages && rc == RC_OK)
+        if ((rc = allocPage(tblData, &pages[allocated])) == RC_OK)
+            allocated++;
+
+    for (int p = 0; p < numPages && rc == RC_OK; p++)
+    {
+        int chunk = (len > RM_OVERFLOW_CAPACITY) ? RM_OVERFLOW_CAPACITY : len;
+        rc = latchPage(tblData, &page, pages[p], true);
+        if (rc != RC_OK)
+            break;
+        rmInitPage(page.data, RM_PAGE_OVERFLOW);
+        RM_PAGE_HDR(page.data)->nextPage = (p + 1 < numPages) ? pages[p + 1] : -1;
+        RM_PAGE_HDR(page.data)->dataLen  = chunk;
+        memcpy(RM_OVERFLOW_DATA(page.data), src, chunk);
+        dirtyPage(tblData, &page);
+        unlatchPage(tblData, &page);
+
+        src += chunk;
+        len -= chunk;
+    }
+
+    if (rc != RC_OK)
+    {
+        for (int p = 0; p < allocated; p++)
+            releasePage(tblData, pages[p]);
+        return rc;
+    }
+    *firstPage = pages[0];
+    return RC_OK;
+}
+
+/*
+ * readOverflow
+ * ------------
+ * Copied up to 'len' bytes of an overflow chain into dest.
  */
-RC initRecordManager(void *mgmtData)
+static RC
+readOverflow(RM_TableMgmtData *tblData, int pageNum, char *dest, int len)
 {
-    initStorageManager();
+    BM_PageHandle page;
+    while (pageNum > 0 && len > 0)
+    {
+        RC rc = latchPage(tblData, &page, pageNum, false);
+        if (rc != RC_OK) return rc;
+
+        RM_PageHeader *hdr = RM_PAGE_HDR(page.data);
+        int chunk = (hdr->dataLen < len) ? hdr->dataLen : len;
+        memcpy(dest, RM_OVERFLOW_DATA(page.data), chunk);
+        dest += chunk;
+        len  -= chunk;
+        pageNum = hdr->nextPage;
+
+        unlatchPage(tblData, &page);
+    }
     return RC_OK;
 }
 
 /*
- * shutdownRecordManager
- * ---------------------
- * Performed a global shutdown if needed. Here, it was just a stub.
+ * freeOverflow
+ * ------------
+ * Released every page of an overflow chain.
  */
-RC shutdownRecordManager()
+static RC
+freeOverflow(RM_TableMgmtData *tblData, int pageNum)
 {
+    BM_PageHandle page;
+    while (pageNum > 0)
+    {
+        RC rc = latchPage(tblData, &page, pageNum, false);
+        if (rc != RC_OK) return rc;
+        int next = RM_PAGE_HDR(page.data)->nextPage;
+        unlatchPage(tblData, &page);
+
+        rc = releasePage(tblData, pageNum);
+        if (rc != RC_OK) return rc;
+        pageNum = next;
+    }
     return RC_OK;
 }
 
+/* --------------------------------------------------------------------------
+   Dictionaries
+   --------------------------------------------------------------------------
+   Every dictionary-encoded attribute had a chain of RM_PAGE_DICT pages, started
+   when the table was created, that held its values in code order. A new value
+   was appended to the chain as soon as it got its code, before any record
+   holding the code was placed, so the pages never lagged behind the records
+   (a logged table logged them like its other pages). Codes were found and
+   added under dictLatch; values were read without it (see rm_dict.h).
+   -------------------------------------------------------------------------- */
+
 /*
- * createTable
+ * newDictPage
  * -----------
- * Created a page file for the table, set up the mgmt data, wrote initial table
- * metadata, and then shut down the buffer manager. Freed the mgmt data after done.
+ * Allocated and formatted an empty dictionary page.
  */
-RC createTable(char *name, Schema *schema)
+static RC
+newDictPage(RM_TableMgmtData *tblData, int *pageNum)
 {
-    RC rc = createPageFile(name);
+    BM_PageHandle page;
+    RC rc = allocPage(tblData, pageNum);
     if (rc != RC_OK) return rc;
 
-    // Allocated mgmt data for the table
-    RM_TableMgmtData *tblData = (RM_TableMgmtData *) malloc(sizeof(RM_TableMgmtData));
-    tblData->numTuples    = 0;
-    tblData->nextFreePage = -1;
-    tblData->recordSize   = computeRecordSize(schema);
-
-    // Initialized a buffer manager for this table
-    rc = initBufferPool(&tblData->bufferPool, name, /*numPages*/3, RS_FIFO, NULL);
+    rc = latchPage(tblData, &page, *pageNum, true);
     if (rc != RC_OK) return rc;
+    rmInitPage(page.data, RM_PAGE_DICT);
+    dirtyPage(tblData, &page);
+    return unlatchPage(tblData, &page);
+}
 
-    // Built a temporary RM_TableData struct so we could call writeTableInfo
-    RM_TableData tmp;
-    tmp.name   = name;
-    tmp.schema = schema;
-    tmp.mgmtData = tblData;
+/*
+ * appendDictValue
+ * ---------------
+ * Wrote a new value at the end of a dictionary's page chain. A full last page
+ * got a successor, which was formatted before it was linked in, so only one
+ * page was pinned at a time. *onPage was set to the page the value was written
+ * to, and left alone if it was not written. The caller held dictLatch.
+ */
+static RC
+appendDictValue(RM_TableMgmtData *tblData, RM_Dictionary *dict, const char *value, int len, int *onPage)
+{
+    BM_PageHandle page;
+    unsigned short n = (unsigned short) len;
+    int need = (int) sizeof(n) + len;
 
-    // Wrote out the table metadata to page 0
-    rc = writeTableInfo(&tmp);
+    RC rc = latchPage(tblData, &page, dict->lastPage, true);
     if (rc != RC_OK) return rc;
+    if (RM_PAGE_HDR(page.data)->dataLen + need > RM_OVERFLOW_CAPACITY)
+    {
+        int next;
+        unlatchPage(tblData, &page);
+        rc = newDictPage(tblData, &next);
+        if (rc != RC_OK) return rc;
 
-    // Shut down the buffer manager
-    rc = shutdownBufferPool(&tblData->bufferPool);
+        rc = latchPage(tblData, &page, dict->lastPage, true);
+        if (rc != RC_OK) return rc;
+        RM_PAGE_HDR(page.data)->nextPage = next;
+        dirtyPage(tblData, &page);
+        unlatchPage(tblData, &page);
+
+        dict->lastPage = next;
+        rc = latchPage(tblData, &page, next, true);
+        if (rc != RC_OK) return rc;
+    }
+
+    RM_PageHeader *hdr = RM_PAGE_HDR(page.data);
+    char *dest = RM_OVERFLOW_DATA(page.data) + hdr->dataLen;
+    memcpy(dest, &n, sizeof(n));
+    memcpy(dest + sizeof(n), value, len);
+    hdr->dataLen += need;
+    dirtyPage(tblData, &page);
+    *onPage = page.pageNum;
+    return unlatchPage(tblData, &page);
+}
+
+/*
+ * dropDictValue
+ * -------------
+ * Took the newest value of a dictionary off the page it had been appended to,
+ * and then its code, because the record that needed it could not be stored.
+ * If the page could not be changed, the code stayed, so the pages and the
+ * codes still agreed. The caller held dictLatch.
+ */
+static RC
+dropDictValue(RM_TableMgmtData *tblData, RM_Dictionary *dict, int pageNum)
+{
+    BM_PageHandle page;
+    char *value = rmDictValue(dict, dict->numCodes - 1);
+    int need = (int) sizeof(unsigned short) + (int) strnlen(value, dict->width);
+
+    RC rc = latchPage(tblData, &page, pageNum, true);
     if (rc != RC_OK) return rc;
+    RM_PAGE_HDR(page.data)->dataLen -= need;
+    dirtyPage(tblData, &page);
+    unlatchPage(tblData, &page);
 
-    // Freed the mgmt data
-    free(tblData);
+    rmDictDropLast(dict);
     return RC_OK;
 }
 
 /*
- * openTable
+ * dictCodes
  * ---------
- * Opened an existing table by creating new mgmt data, initing a buffer pool,
- * and reading table info from page 0. Set rel->schema and rel->mgmtData.
+ * Found the codes of a record's dictionary-encoded attributes, adding new
+ * values to their dictionaries and pages. It all happened under one hold of
+ * dictLatch, so if one value could not be added, the ones added before it
+ * were taken back before any other record could have used their codes.
  */
-RC openTable(RM_TableData *rel, char *name)
+static RC
+dictCodes(RM_TableData *rel, char *recData, unsigned short *codes)
 {
-    RM_TableMgmtData *tblData = (RM_TableMgmtData *) malloc(sizeof(RM_TableMgmtData));
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    Schema *sc = rel->schema;
+    int added[sc->numAttr], onPage[sc->numAttr];
+    int numAdded = 0;
+    RC rc = RC_OK;
 
-    RC rc = initBufferPool(&tblData->bufferPool, name, 3, RS_FIFO, NULL);
-    if (rc != RC_OK) return rc;
+    pthread_mutex_lock(&tblData->dictLatch);
+    for (int i = 0; i < sc->numAttr && rc == RC_OK; i++)
+    {
+        RM_Dictionary *dict = tblData->dictOf[i];
+        if (dict == NULL)
+            continue;
 
-    rel->name     = name;
-    rel->schema   = NULL;
-    rel->mgmtData = tblData;
+        char *value = recData + sc->attrOffsets[i];
+        int len = (int) strnlen(value, dict->width);
+        int c = rmDictFind(dict, value, len);
+        if (c < 0)
+        {
+            c = rmDictAdd(dict, value, len);
+            if (c < 0)
+                rc = RC_RM_DICT_FULL;
+            else
+            {
+                onPage[numAdded] = -1;
+                rc = appendDictValue(tblData, dict, value, len, &onPage[numAdded]);
+                if (onPage[numAdded] > 0)
+                    added[numAdded++] = i;
+                else
+                    rmDictDropLast(dict);
+            }
+        }
+        codes[i] = (unsigned short) c;
+    }
 
-    rc = readTableInfo(rel);
-    if (rc != RC_OK) return rc;
+    // Every dictionary had at most one new value, so they could go in any order
+    for (int k = 0; k < numAdded && rc != RC_OK; k++)
+        dropDictValue(tblData, tblData->dictOf[added[k]], onPage[k]);
+    pthread_mutex_unlock(&tblData->dictLatch);
+    return rc;
+}
+
+/*
+ * loadDictionaries
+ * ----------------
+ * Read every dictionary of a table back from its page chain, in code order.
+ */
+static RC
+loadDictionaries(RM_TableData *rel)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    BM_PageHandle page;
 
+    for (int i = 0; i < rel->schema->numAttr; i++)
+    {
+        RM_Dictionary *dict = tblData->dictOf[i];
+        if (dict == NULL)
+            continue;
+
+        int pageNum = dict->firstPage;
+        while (pageNum > 0)
+        {
+            RC rc = latchPage(tblData, &page, pageNum, false);
+            if (rc != RC_OK) return rc;
+
+            RM_PageHeader *hdr = RM_PAGE_HDR(page.data);
+            char *pos = RM_OVERFLOW_DATA(page.data);
+            char *end = pos + hdr->dataLen;
+            while (pos < end)
+            {
+                unsigned short n;
+                memcpy(&n, pos, sizeof(n));
+                rmDictAdd(dict, pos + sizeof(n), n);
+                pos += sizeof(n) + n;
+            }
+            dict->lastPage = pageNum;
+            pageNum = hdr->nextPage;
+            unlatchPage(tblData, &page);
+        }
+    }
     return RC_OK;
 }
 
 /*
- * closeTable
+ * freeDictionaries
+ * ----------------
+ * Released the in-memory dictionaries of a table.
+ */
+static void
+freeDictionaries(RM_TableMgmtData *tblData, int numAttr)
+{
+    for (int i = 0; i < numAttr; i++)
+    {
+        if (tblData->dictOf[i] == NULL)
+            continue;
+        rmDictFree(tblData->dictOf[i]);
+        free(tblData->dictOf[i]);
+    }
+    free(tblData->dictOf);
+    tblData->dictOf   = NULL;
+    tblData->numDicts = 0;
+}
+
+/* --------------------------------------------------------------------------
+   Stored record encoding
+   -------------------------------------------------------------------------- */
+
+/*
+ * recordBody
  * ----------
- * Wrote out metadata, shut down buffer pool, freed schema and mgmt data.
+ * Skipped the flag byte (and the home RID of a moved record) of a stored record.
  */
-RC closeTable(RM_TableData *rel)
+static char *
+recordBody(char *stored)
 {
-    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
-    RC rc = writeTableInfo(rel);
-    if (rc != RC_OK) return rc;
+    if (stored[0] == RM_REC_MOVED)
+        return stored + 1 + sizeof(RID);
+    return stored + 1;
+}
 
-    rc = shutdownBufferPool(&tblData->bufferPool);
-    if (rc != RC_OK) return rc;
+/*
+ * encodeRecord
+ * ------------
+ * Turned record->data into its stored form. 'flag' was RM_REC_NORMAL or
+ * RM_REC_MOVED (in which case 'home' was written after the flag). Strings lost
+ * their zero padding, and long strings were written to overflow chains until
+ * the record fit on a page. Dictionary-encoded strings were replaced by their
+ * codes, new values getting one first. 'out' had to hold RM_MAX_STORED_RECORD
+ * bytes. Nothing was written before the record was known to fit, and if a
+ * dictionary code could not be added, the chains already written were freed
+ * again; a caller that could not place the record freed them with
+ * freeStoredToast.
+ */
+static RC
+encodeRecord(RM_TableData *rel, char *recData, int flag, RID *home, char *out, int *outLen)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    Schema *sc = rel->schema;
+    int numStrings = tblData->numStrings;
+    int strLen[numStrings > 0 ? numStrings : 1];
+    int strAttr[numStrings > 0 ? numStrings : 1];
+    bool toast[numStrings > 0 ? numStrings : 1];
+    unsigned short codes[sc->numAttr];
 
-    freeSchema(rel->schema);
-    rel->schema = NULL;
+    int hdrLen = 1 + ((flag == RM_REC_MOVED) ? (int) sizeof(RID) : 0);
+    int size = hdrLen + tblData->fixedSize + numStrings * (int) sizeof(unsigned short);
 
-    free(tblData);
-    rel->mgmtData = NULL;
+    // Measured the strings and toasted the ones that were long on their own
+    for (int i = 0; i < sc->numAttr; i++)
+    {
+        if (!isVarAttr(tblData, sc, i))
+            continue;
+        int s = tblData->encOffset[i];
+        strAttr[s] = i;
+        strLen[s]  = (int) strnlen(recData + sc->attrOffsets[i], sc->typeLength[i]);
+        toast[s]   = (strLen[s] > RM_TOAST_THRESHOLD);
+        size += toast[s] ? (int) sizeof(RM_ToastPointer) : strLen[s];
+    }
+
+    // Toasted the largest remaining strings until the record fit on a page
+    while (size > RM_MAX_STORED_RECORD)
+    {
+        int largest = -1;
+        for (int s = 0; s < numStrings; s++)
+            if (!toast[s] && strLen[s] > (int) sizeof(RM_ToastPointer)
+                && (largest < 0 || strLen[s] > strLen[largest]))
+                largest = s;
+        if (largest < 0)
+            return RC_RM_RECORD_TOO_LARGE;
+        toast[largest] = true;
+        size += (int) sizeof(RM_ToastPointer) - strLen[largest];
+    }
+
+    // Wrote the overflow chains, then coded the dictionary-encoded strings
+    int toastPage[numStrings > 0 ? numStrings : 1];
+    RC rc = RC_OK;
+    for (int s = 0; s < numStrings; s++)
+    {
+        toastPage[s] = -1;
+        if (toast[s] && rc == RC_OK)
+            rc = writeOverflow(tblData, recData + sc->attrOffsets[strAttr[s]], strLen[s], &toastPage[s]);
+    }
+    if (rc == RC_OK && tblData->numDicts > 0)
+        rc = dictCodes(rel, recData, codes);
+    if (rc != RC_OK)
+    {
+        for (int s = 0; s < numStrings; s++)
+            if (toastPage[s] > 0)
+                freeOverflow(tblData, toastPage[s]);
+        return rc;
+    }
+
+    // Header
+    out[0] = (char) flag;
+    if (flag == RM_REC_MOVED)
+        memcpy(out + 1, home, sizeof(RID));
+
+    // Fixed part
+    char *fixed = out + hdrLen;
+    for (int i = 0; i < sc->numAttr; i++)
+    {
+        if (tblData->dictOf[i] != NULL)
+            memcpy(fixed + tblData->encOffset[i], &codes[i], sizeof(codes[i]));
+        else if (sc->dataTypes[i] != DT_STRING)
+            memcpy(fixed + tblData->encOffset[i], recData + sc->attrOffsets[i], attrSize(sc, i));
+    }
+
+    // Variable part, preceded by the table of end offsets
+    unsigned short *ends = (unsigned short *) (fixed + tblData->fixedSize);
+    char *var = (char *) (ends + numStrings);
+    int varLen = 0;
+    for (int s = 0; s < numStrings; s++)
+    {
+        char *src = recData + sc->attrOffsets[strAttr[s]];
+        unsigned short end;
+        if (toast[s])
+        {
+            RM_ToastPointer tp;
+            tp.length    = strLen[s];
+            tp.firstPage = toastPage[s];
+            memcpy(var + varLen, &tp, sizeof(tp));
+            varLen += sizeof(tp);
+            end = (unsigned short) (varLen | RM_VAR_TOASTED);
+        }
+        else
+        {
+            memcpy(var + varLen, src, strLen[s]);
+            varLen += strLen[s];
+            end = (unsigned short) varLen;
+        }
+        memcpy(&ends[s], &end, sizeof(end));
+    }
+
+    *outLen = (int) (var - out) + varLen;
+
+    // Kept room for a forward stub
+    if (*outLen < RM_MIN_STORED_RECORD)
+    {
+        memset(out + *outLen, 0, RM_MIN_STORED_RECORD - *outLen);
+        *outLen = RM_MIN_STORED_RECORD;
+    }
     return RC_OK;
 }
 
 /*
- * deleteTable
- * -----------
- * Destroyed the page file on disk for the table.
+ * varEntry
+ * --------
+ * Found the bytes of string number 's' in the variable part of a record body.
+ * Returned the start and set *len and *toasted.
  */
-RC deleteTable(char *name)
+static char *
+varEntry(RM_TableMgmtData *tblData, char *body, int s, int *len, bool *toasted)
 {
-    return destroyPageFile(name);
+    unsigned short *ends = (unsigned short *) (body + tblData->fixedSize);
+    char *var = (char *) (ends + tblData->numStrings);
+    unsigned short end, start = 0;
+
+    memcpy(&end, &ends[s], sizeof(end));
+    if (s > 0)
+    {
+        memcpy(&start, &ends[s - 1], sizeof(start));
+        start &= RM_VAR_END_MASK;
+    }
+
+    *toasted = (end & RM_VAR_TOASTED) != 0;
+    *len = (end & RM_VAR_END_MASK) - start;
+    return var + start;
 }
 
 /*
- * getNumTuples
+ * decodeRecord
  * ------------
- * Returned the number of tuples stored in the table (from mgmt data).
+ * Rebuilt record->data (the fixed-width in-memory layout) from a stored record,
+ * padding strings back to their typeLength, reading toasted ones back in and
+ * looking up dictionary codes. With needAttr set, only those attributes were
+ * filled in.
  */
-int getNumTuples(RM_TableData *rel)
+static RC
+decodeRecord(RM_TableData *rel, char *stored, char *recData, bool *needAttr)
 {
-    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
-    return tblData->numTuples;
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    Schema *sc = rel->schema;
+    char *body = recordBody(stored);
+
+    for (int i = 0; i < sc->numAttr; i++)
+    {
+        if (needAttr != NULL && !needAttr[i])
+            continue;
+
+        char *dest = recData + sc->attrOffsets[i];
+        if (tblData->dictOf[i] != NULL)
+        {
+            unsigned short code;
+            memcpy(&code, body + tblData->encOffset[i], sizeof(code));
+            memcpy(dest, rmDictValue(tblData->dictOf[i], code), sc->typeLength[i]);
+            continue;
+        }
+        if (sc->dataTypes[i] != DT_STRING)
+        {
+            memcpy(dest, body + tblData->encOffset[i], attrSize(sc, i));
+            continue;
+        }
+
+        int len;
+        bool toasted;
+        char *src = varEntry(tblData, body, tblData->encOffset[i], &len, &toasted);
+        memset(dest, 0, sc->typeLength[i]);
+        if (toasted)
+        {
+            RM_ToastPointer tp;
+            memcpy(&tp, src, sizeof(tp));
+            RC rc = readOverflow(tblData, tp.firstPage, dest, tp.length);
+            if (rc != RC_OK) return rc;
+        }
+        else
+            memcpy(dest, src, len);
+    }
+    return RC_OK;
 }
 
-/* --------------------------------------------------------------------------
-   Record-level operations
-   -------------------------------------------------------------------------- */
+/*
+ * hasToast
+ * --------
+ * Told whether decoding a stored record (only the attributes in needAttr, if
+ * set) would read toasted strings from overflow pages.
+ */
+static bool
+hasToast(RM_TableData *rel, char *stored, bool *needAttr)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    Schema *sc = rel->schema;
+    char *body = recordBody(stored);
+
+    for (int i = 0; i < sc->numAttr; i++)
+    {
+        if (!isVarAttr(tblData, sc, i) || (needAttr != NULL && !needAttr[i]))
+            continue;
+        int len;
+        bool toasted;
+        varEntry(tblData, body, tblData->encOffset[i], &len, &toasted);
+        if (toasted)
+            return true;
+    }
+    return false;
+}
 
 /*
- * insertRecord
+ * collectToast
  * ------------
- * Inserted a new record into the table. If nextFreePage < 1, appended a new data page.
- * Found a free slot or created a new page. Copied record->data into the free slot,
- * updated usage array, incremented numTuples. 
+ * Listed the first overflow page of every toasted string in a stored record,
+ * so the chains could be freed once the record itself was gone. Returned how
+ * many were found; 'pages' had room for numStrings entries.
  */
-RC insertRecord(RM_TableData *rel, Record *record)
+static int
+collectToast(RM_TableMgmtData *tblData, char *stored, int *pages)
+{
+    char *body = recordBody(stored);
+    int found = 0;
+
+    if (stored[0] == RM_REC_FORWARD)
+        return 0;
+    for (int s = 0; s < tblData->numStrings; s++)
+    {
+        int len;
+        bool toasted;
+        char *src = varEntry(tblData, body, s, &len, &toasted);
+        if (toasted)
+        {
+            RM_ToastPointer tp;
+            memcpy(&tp, src, sizeof(tp));
+            pages[found++] = tp.firstPage;
+        }
+    }
+    return found;
+}
+
+/*
+ * freeToast
+ * ---------
+ * Freed the overflow chains listed by collectToast.
+ */
+static RC
+freeToast(RM_TableMgmtData *tblData, int *pages, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        RC rc = freeOverflow(tblData, pages[i]);
+        if (rc != RC_OK) return rc;
+    }
+    return RC_OK;
+}
+
+/*
+ * freeStoredToast
+ * ---------------
+ * Freed the overflow chains of a stored record that encodeRecord had made but
+ * that never got (or did not stay) on a page.
+ */
+static RC
+freeStoredToast(RM_TableMgmtData *tblData, char *stored)
+{
+    int pages[tblData->numStrings > 0 ? tblData->numStrings : 1];
+    return freeToast(tblData, pages, collectToast(tblData, stored, pages));
+}
+
+/*
+ * placeRecord
+ * -----------
+ * Found a heap page for a stored record: the calling thread's insert target if
+ * it still had room, otherwise a newly allocated page, which then became the
+ * target. With versionTs set, the empty version of a new record was saved
+ * while its page was still latched, so no snapshot scan saw the record first.
+ */
+static RC
+placeRecord(RM_TableMgmtData *tblData, char *stored, int len, RID *rid, RM_Timestamp *versionTs)
 {
-    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
     BM_PageHandle page;
+    int *target = insertTarget(tblData);
     RC rc;
-    int recSize = tblData->recordSize;
-    int pageNum = tblData->nextFreePage;
 
-    // If nextFreePage was not valid, appended a new data page
-    if (pageNum < 1)
+    pthread_mutex_lock(&tblData->spaceLatch);
+    int pageNum = *target;
+    pthread_mutex_unlock(&tblData->spaceLatch);
+
+    if (pageNum > 0)
     {
-        SM_FileHandle fHandle;
-        rc = openPageFile(rel->name, &fHandle);
+        rc = latchPage(tblData, &page, pageNum, true);
         if (rc != RC_OK) return rc;
 
-        pageNum = fHandle.totalNumPages;  // The new data page
-        ensureCapacity(pageNum + 1, &fHandle);
-        closePageFile(&fHandle);
+        int slot = -1;
+        if (RM_PAGE_HDR(page.data)->pageType == RM_PAGE_HEAP)
+            slot = rmPageInsert(page.data, stored, len);
+        if (slot >= 0)
+        {
+            rid->page = pageNum;
+            rid->slot = slot;
+            if (versionTs != NULL)
+                rmVersionAdd(&tblData->versions, *rid, *versionTs, NULL);
+            dirtyPage(tblData, &page);
+            unlatchPage(tblData, &page);
+            return RC_OK;
+        }
 
-        // pinned that new page
-        rc = pinPage(&tblData->bufferPool, &page, pageNum);
-        if (rc != RC_OK) return rc;
+        // The target was full, so we stopped sending inserts there
+        unlatchPage(tblData, &page);
+        pthread_mutex_lock(&tblData->spaceLatch);
+        if (*target == pageNum)
+            *target = -1;
+        pthread_mutex_unlock(&tblData->spaceLatch);
+    }
+
+    rc = allocPage(tblData, &pageNum);
+    if (rc != RC_OK) return rc;
+
+    rc = latchPage(tblData, &page, pageNum, true);
+    if (rc != RC_OK) return rc;
+    rmInitPage(page.data, RM_PAGE_HEAP);
+    rid->page = pageNum;
+    rid->slot = rmPageInsert(page.data, stored, len);
+    if (versionTs != NULL)
+        rmVersionAdd(&tblData->versions, *rid, *versionTs, NULL);
+    dirtyPage(tblData, &page);
+    unlatchPage(tblData, &page);
+
+    pthread_mutex_lock(&tblData->spaceLatch);
+    *target = pageNum;
+    pthread_mutex_unlock(&tblData->spaceLatch);
+    return RC_OK;
+}
+
+/*
+ * clearZoneIfEmpty
+ * ----------------
+ * Reset the range of a (pinned) page once its last record was gone.
+ */
+static void
+clearZoneIfEmpty(RM_TableMgmtData *tblData, char *data, int pageNum)
+{
+    if (RM_PAGE_HDR(data)->slotsUsed == 0)
+        rmZoneClear(&tblData->zoneMap, pageNum);
+}
+
+/*
+ * removeStored
+ * ------------
+ * Deleted one stored record (a normal or moved one) and freed its overflow
+ * chains. Updated the insert target if the page now had plenty of room.
+ */
+static RC
+removeStored(RM_TableMgmtData *tblData, RID id)
+{
+    BM_PageHandle page;
+    int toastPages[tblData->numStrings > 0 ? tblData->numStrings : 1];
+    int numToast = 0;
+
+    RC rc = latchPage(tblData, &page, id.page, true);
+    if (rc != RC_OK) return rc;
 
-        // zeroed out the entire page
-        memset(page.data, 0, PAGE_SIZE);
+    bool roomy = false;
+    char *stored = rmPageRecord(page.data, id.slot, NULL);
+    if (stored != NULL)
+    {
+        numToast = collectToast(tblData, stored, toastPages);
+        rmPageDelete(page.data, id.slot);
+        clearZoneIfEmpty(tblData, page.data, id.page);
+        roomy = (rmPageFreeSpace(page.data) >= RM_FREE_SPACE_HINT);
+        dirtyPage(tblData, &page);
+    }
+    unlatchPage(tblData, &page);
+
+    if (roomy)
+    {
+        pthread_mutex_lock(&tblData->spaceLatch);
+        if (tblData->nextFreePage < 1)
+            tblData->nextFreePage = id.page;
+        pthread_mutex_unlock(&tblData->spaceLatch);
+    }
+    return freeToast(tblData, toastPages, numToast);
+}
+
+/*
+ * readForward
+ * -----------
+ * Read the target RID out of a forward stub.
+ */
+static RID
+readForward(char *stored)
+{
+    RID target;
+    memcpy(&target, stored + 1, sizeof(RID));
+    return target;
+}
+
+/* --------------------------------------------------------------------------
+   PAX tables
+   -------------------------------------------------------------------------- */
 
-        // stored slotsUsed = 0 in first 4 bytes
-        int slotsUsed = 0;
-        memcpy(page.data, &slotsUsed, sizeof(int));
+/*
+ * paxInsert
+ * ---------
+ * Inserted a record into a PAX table: the calling thread's insert target page
+ * if it had an unused slot, otherwise a freshly formatted page. versionTs was
+ * handled as in placeRecord.
+ */
+static RC
+paxInsert(RM_TableData *rel, Record *record, RM_Timestamp *versionTs)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    BM_PageHandle page;
+    int *target = insertTarget(tblData);
+    RC rc;
 
-        markDirty(&tblData->bufferPool, &page);
-        unpinPage(&tblData->bufferPool, &page);
+    pthread_mutex_lock(&tblData->spaceLatch);
+    int pageNum = *target;
+    pthread_mutex_unlock(&tblData->spaceLatch);
 
-        tblData->nextFreePage = pageNum;
+    if (pageNum > 0)
+    {
+        rc = latchPage(tblData, &page, pageNum, true);
+        if (rc != RC_OK) return rc;
+
+        int slot = -1;
+        if (RM_PAGE_HDR(page.data)->pageType == RM_PAGE_PAX)
+            slot = rmPaxInsert(page.data, rel->schema, tblData->paxColStart, record->data);
+        if (slot >= 0)
+        {
+            record->id.page = pageNum;
+            record->id.slot = slot;
+            if (versionTs != NULL)
+                rmVersionAdd(&tblData->versions, record->id, *versionTs, NULL);
+            dirtyPage(tblData, &page);
+            unlatchPage(tblData, &page);
+            return RC_OK;
+        }
+        unlatchPage(tblData, &page);
+        pthread_mutex_lock(&tblData->spaceLatch);
+        if (*target == pageNum)
+            *target = -1;
+        pthread_mutex_unlock(&tblData->spaceLatch);
     }
 
-    // pinned the nextFreePage
-    rc = pinPage(&tblData->bufferPool, &page, tblData->nextFreePage);
+    rc = allocPage(tblData, &pageNum);
+    if (rc != RC_OK) return rc;
+
+    rc = latchPage(tblData, &page, pageNum, true);
     if (rc != RC_OK) return rc;
+    rmPaxInit(page.data, tblData->paxCapacity);
+    record->id.page = pageNum;
+    record->id.slot = rmPaxInsert(page.data, rel->schema, tblData->paxColStart, record->data);
+    if (versionTs != NULL)
+        rmVersionAdd(&tblData->versions, record->id, *versionTs, NULL);
+    dirtyPage(tblData, &page);
+    unlatchPage(tblData, &page);
+
+    pthread_mutex_lock(&tblData->spaceLatch);
+    *target = pageNum;
+    pthread_mutex_unlock(&tblData->spaceLatch);
+    return RC_OK;
+}
+
+/*
+ * paxSlotUsed
+ * -----------
+ * Checked that a RID pointed at a used slot of a PAX page.
+ */
+static bool
+paxSlotUsed(char *data, int slot)
+{
+    RM_PageHeader *hdr = RM_PAGE_HDR(data);
+    return hdr->pageType == RM_PAGE_PAX && slot >= 0 && slot < hdr->numSlots
+        && RM_PAX_USED(data)[slot];
+}
+
+/*
+ * paxAccess
+ * ---------
+ * Deleted, updated or read one record of a PAX table, depending on 'op'
+ * ('d', 'u' or 'r'). Returned RC_RM_NO_MORE_TUPLES if the slot was not used.
+ */
+static RC
+paxAccess(RM_TableData *rel, RID id, Record *record, char op)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    BM_PageHandle page;
+    RC rc = latchPage(tblData, &page, id.page, op != 'r');
+    if (rc != RC_OK) return rc;
+
+    if (!paxSlotUsed(page.data, id.slot))
+    {
+        unlatchPage(tblData, &page);
+        return RC_RM_NO_MORE_TUPLES;
+    }
+
+    switch (op)
+    {
+        case 'd':
+            rmPaxDelete(page.data, id.slot);
+            clearZoneIfEmpty(tblData, page.data, id.page);
+            tblData->numTuples--;
+            dirtyPage(tblData, &page);
+            break;
+        case 'u':
+            rmPaxWrite(page.data, rel->schema, tblData->paxColStart, id.slot, record->data);
+            rmZoneAdd(&tblData->zoneMap, rel->schema, id.page, record->data);
+            dirtyPage(tblData, &page);
+            break;
+        default:
+            for (int i = 0; i < rel->schema->numAttr; i++)
+                rmPaxRead(page.data, rel->schema, tblData->paxColStart, id.slot, i, record->data);
+            record->id = id;
+            break;
+    }
+
+    unlatchPage(tblData, &page);
+    if (op == 'd')
+    {
+        pthread_mutex_lock(&tblData->spaceLatch);
+        if (tblData->nextFreePage < 1)
+            tblData->nextFreePage = id.page;
+        pthread_mutex_unlock(&tblData->spaceLatch);
+    }
+    return RC_OK;
+}
+
+/*
+ * paxFilter
+ * ---------
+ * Evaluated the scan's simple terms over whole minipages, one tight loop per
+ * term, and left the result per slot in sdata->match (unused slots never
+ * matched). Only the minipages of attributes named by a term were read.
+ */
+static void
+paxFilter(RM_TableData *rel, RM_ScanMgmtData *sdata, char *data)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    Schema *sc = rel->schema;
+    int n = RM_PAGE_HDR(data)->numSlots;
+    char *match = sdata->match;
+
+    memcpy(match, RM_PAX_USED(data), n);
+
+    for (int p = 0; p < sdata->numPreds; p++)
+    {
+        AttrPredicate *pred = &sdata->preds[p];
+        char *col = data + tblData->paxColStart[pred->attrNum];
+
+        switch (sc->dataTypes[pred->attrNum])
+        {
+            case DT_INT:
+            {
+                const int *vals = (const int *) col;
+                int c = pred->cons->v.intV;
+                switch (pred->op)
+                {
+                    case COMP_EQ: for (int s = 0; s < n; s++) match[s] &= (vals[s] == c); break;
+                    case COMP_LT: for (int s = 0; s < n; s++) match[s] &= (vals[s] <  c); break;
+                    case COMP_LE: for (int s = 0; s < n; s++) match[s] &= (vals[s] <= c); break;
+                    case COMP_GT: for (int s = 0; s < n; s++) match[s] &= (vals[s] >  c); break;
+                    case COMP_GE: for (int s = 0; s < n; s++) match[s] &= (vals[s] >= c); break;
+                }
+            }
+            break;
+            case DT_FLOAT:
+            {
+                const float *vals = (const float *) col;
+                float c = pred->cons->v.floatV;
+                switch (pred->op)
+                {
+                    case COMP_EQ: for (int s = 0; s < n; s++) match[s] &= (vals[s] == c); break;
+                    case COMP_LT: for (int s = 0; s < n; s++) match[s] &= (vals[s] <  c); break;
+                    case COMP_LE: for (int s = 0; s < n; s++) match[s] &= (vals[s] <= c); break;
+                    case COMP_GT: for (int s = 0; s < n; s++) match[s] &= (vals[s] >  c); break;
+                    case COMP_GE: for (int s = 0; s < n; s++) match[s] &= (vals[s] >= c); break;
+                }
+            }
+            break;
+            case DT_STRING:
+            {
+                // Only equality terms were kept for strings (see startScanProjection)
+                int width = sc->typeLength[pred->attrNum];
+                char padded[width + 1];
+                memset(padded, 0, width + 1);
+                strncpy(padded, pred->cons->v.stringV, width + 1);
+                if (padded[width] != '\0')
+                    memset(match, 0, n);
+                else
+                    for (int s = 0; s < n; s++)
+                        match[s] &= (memcmp(col + s * width, padded, width) == 0);
+            }
+            break;
+            default:
+            break;
+        }
+    }
+}
+
+/*
+ * markCondAttrs
+ * -------------
+ * Flagged every attribute that a condition referred to.
+ */
+static void
+markCondAttrs(Expr *e, bool *needAttr)
+{
+    if (e == NULL)
+        return;
+    switch (e->type)
+    {
+        case EXPR_ATTRREF:
+            needAttr[e->expr.attrRef] = true;
+            break;
+        case EXPR_OP:
+            markCondAttrs(e->expr.op->args[0], needAttr);
+            if (e->expr.op->type != OP_BOOL_NOT)
+                markCondAttrs(e->expr.op->args[1], needAttr);
+            break;
+        default:
+            break;
+    }
+}
+
+/* --------------------------------------------------------------------------
+   Dictionary terms
+   --------------------------------------------------------------------------
+   A scan of a row table turned the conjuncts of its condition that compared a
+   dictionary-encoded attribute with string constants ("a = 'x'", or the IN
+   form "a = 'x' OR a = 'y' ...") into sets of accepted codes. Heap pages then
+   tested the codes in the stored records and only decoded the records that
+   passed. A constant the dictionary did not hold accepted no code at all.
+   -------------------------------------------------------------------------- */
+
+/*
+ * dictTermCodes
+ * -------------
+ * Told whether a condition was an equality, or an OR of equalities, between
+ * one dictionary-encoded attribute (*attr, -1 until found) and string
+ * constants, and marked the codes of the constants in 'codes'. The caller
+ * held dictLatch.
+ */
+static bool
+dictTermCodes(RM_TableMgmtData *tblData, Expr *e, int *attr, unsigned char *codes)
+{
+    if (e->type != EXPR_OP)
+        return false;
+
+    Operator *op = e->expr.op;
+    if (op->type == OP_BOOL_OR)
+        return dictTermCodes(tblData, op->args[0], attr, codes)
+            && dictTermCodes(tblData, op->args[1], attr, codes);
+    if (op->type != OP_COMP_EQUAL)
+        return false;
+
+    Expr *ref = op->args[0], *cons = op->args[1];
+    if (ref->type == EXPR_CONST)
+    {
+        ref  = op->args[1];
+        cons = op->args[0];
+    }
+    if (ref->type != EXPR_ATTRREF || cons->type != EXPR_CONST || cons->expr.cons->dt != DT_STRING)
+        return false;
+
+    RM_Dictionary *dict = tblData->dictOf[ref->expr.attrRef];
+    if (dict == NULL || (*attr >= 0 && *attr != ref->expr.attrRef))
+        return false;
+    *attr = ref->expr.attrRef;
+
+    char *v = cons->expr.cons->v.stringV;
+    int code = rmDictFind(dict, v, (int) strlen(v));
+    if (code >= 0)
+        codes[code >> 3] |= (unsigned char) (1 << (code & 7));
+    return true;
+}
+
+/*
+ * collectDictTerms
+ * ----------------
+ * Went through the conjuncts of a condition and kept the ones dictTermCodes
+ * understood. dictExact was cleared for every conjunct left to evalExpr.
+ */
+static void
+collectDictTerms(RM_TableMgmtData *tblData, RM_ScanMgmtData *sdata, Expr *e)
+{
+    if (e->type == EXPR_OP && e->expr.op->type == OP_BOOL_AND)
+    {
+        collectDictTerms(tblData, sdata, e->expr.op->args[0]);
+        collectDictTerms(tblData, sdata, e->expr.op->args[1]);
+        return;
+    }
+
+    int attr = -1;
+    unsigned char *codes = (unsigned char *) calloc(RM_DICT_MAX_CODES / 8, 1);
+    if (sdata->numDictTerms < RM_MAX_SCAN_PREDS && dictTermCodes(tblData, e, &attr, codes))
+    {
+        RM_DictTerm *term = &sdata->dictTerms[sdata->numDictTerms++];
+        term->offset = tblData->encOffset[attr];
+        term->codes  = codes;
+    }
+    else
+    {
+        free(codes);
+        sdata->dictExact = false;
+    }
+}
+
+/*
+ * dictFilter
+ * ----------
+ * Evaluated the scan's dictionary terms for every record on a heap page at
+ * once and left the result per slot in sdata->dictMatch (free slots and
+ * forward stubs never matched). For each term the codes were gathered into
+ * one array first and then looked up in a tight loop.
+ */
+static void
+dictFilter(RM_ScanMgmtData *sdata, char *data)
+{
+    int n = RM_PAGE_HDR(data)->numSlots;
+    char *bodies[n > 0 ? n : 1];
+    unsigned short codes[n > 0 ? n : 1];
+    char *match = sdata->dictMatch;
+
+    for (int s = 0; s < n; s++)
+    {
+        char *stored = rmPageRecord(data, s, NULL);
+        match[s]  = (stored != NULL && stored[0] != RM_REC_FORWARD);
+        bodies[s] = match[s] ? recordBody(stored) : NULL;
+        codes[s]  = 0;
+    }
+
+    for (int t = 0; t < sdata->numDictTerms; t++)
+    {
+        RM_DictTerm *term = &sdata->dictTerms[t];
+        for (int s = 0; s < n; s++)
+            if (bodies[s] != NULL)
+                memcpy(&codes[s], bodies[s] + term->offset, sizeof(codes[s]));
+        for (int s = 0; s < n; s++)
+            match[s] &= (term->codes[codes[s] >> 3] >> (codes[s] & 7)) & 1;
+    }
+    sdata->dictSlots = n;
+}
+
+/* --------------------------------------------------------------------------
+   Zone maps
+   -------------------------------------------------------------------------- */
+
+/*
+ * rebuildZoneMap
+ * --------------
+ * Recomputed every page's range by reading the zoned attributes of all records
+ * in the table. Used when no saved zone map was available, e.g. after the
+ * table had not been closed properly.
+ */
+static RC
+rebuildZoneMap(RM_TableData *rel)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    RM_ZoneMap *zm = &tblData->zoneMap;
+    Schema *sc = rel->schema;
+    bool needAttr[sc->numAttr];
+    char recData[tblData->recordSize];
+    BM_PageHandle page;
+
+    memset(needAttr, 0, sizeof(needAttr));
+    memset(recData, 0, sizeof(recData));
+    for (int i = 0; i < zm->numAttrs; i++)
+        needAttr[zm->attrs[i]] = true;
+
+    for (int p = 1; p < tblData->numPages; p++)
+    {
+        RC rc = latchPage(tblData, &page, p, false);
+        if (rc != RC_OK) return rc;
+
+        RM_PageHeader *hdr = RM_PAGE_HDR(page.data);
+        for (int slot = 0; slot < hdr->numSlots; slot++)
+        {
+            if (hdr->pageType == RM_PAGE_HEAP)
+            {
+                char *stored = rmPageRecord(page.data, slot, NULL);
+                if (stored == NULL || stored[0] == RM_REC_FORWARD)
+                    continue;
+                rc = decodeRecord(rel, stored, recData, needAttr);
+                if (rc != RC_OK) break;
+                if (stored[0] == RM_REC_MOVED)
+                    rmZoneAdd(zm, sc, readForward(stored).page, recData);
+            }
+            else if (hdr->pageType == RM_PAGE_PAX)
+            {
+                if (!RM_PAX_USED(page.data)[slot])
+                    continue;
+                for (int i = 0; i < zm->numAttrs; i++)
+                    rmPaxRead(page.data, sc, tblData->paxColStart, slot, zm->attrs[i], recData);
+            }
+            else
+                break;
+            rmZoneAdd(zm, sc, p, recData);
+        }
+
+        unlatchPage(tblData, &page);
+        if (rc != RC_OK) return rc;
+    }
+    return RC_OK;
+}
+
+/*
+ * loadZoneMap
+ * -----------
+ * Read the zone map saved by closeTable and gave its overflow pages back to
+ * the free chain. The header was rewritten without the map right away, so a
+ * table that was not closed again got its map rebuilt on the next open
+ * instead of trusting stale ranges.
+ */
+static RC
+loadZoneMap(RM_TableData *rel)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    RM_ZoneMap *zm = &tblData->zoneMap;
+
+    if (zm->numAttrs == 0)
+        return RC_OK;
+    if (tblData->zoneMapPage < 1)
+        return rebuildZoneMap(rel);
+
+    RC rc = readOverflow(tblData, tblData->zoneMapPage, zm->entries, zm->numEntries * zm->entrySize);
+    if (rc != RC_OK) return rc;
+    rc = freeOverflow(tblData, tblData->zoneMapPage);
+    if (rc != RC_OK) return rc;
+    tblData->zoneMapPage = -1;
+    return writeTableInfo(rel);
+}
+
+/*
+ * saveZoneMap
+ * -----------
+ * Stored the entries for all pages of the table in an overflow chain, so the
+ * next openTable did not have to rebuild them.
+ */
+static RC
+saveZoneMap(RM_TableMgmtData *tblData)
+{
+    RM_ZoneMap *zm = &tblData->zoneMap;
+    if (zm->numAttrs == 0)
+        return RC_OK;
+
+    if (zm->numEntries > tblData->numPages)
+        zm->numEntries = tblData->numPages;
+    if (zm->numEntries == 0)
+        return RC_OK;
+    return writeOverflow(tblData, zm->entries, zm->numEntries * zm->entrySize, &tblData->zoneMapPage);
+}
+
+/* --------------------------------------------------------------------------
+   Secondary indexes
+   -------------------------------------------------------------------------- */
+
+/*
+ * indexFileName
+ * -------------
+ * Built the page file name of the index on one attribute: "<table>.<attr>.idx".
+ */
+static void
+indexFileName(char *table, Schema *schema, int attrNum, char *buf, size_t size)
+{
+    snprintf(buf, size, "%s.%s.idx", table, schema->attrNames[attrNum]);
+}
+
+/*
+ * createIndexFile
+ * ---------------
+ * Created an empty B+ tree for an attribute, with room for duplicate keys and
+ * as many keys per node as fit on a page.
+ */
+static RC
+createIndexFile(char *table, Schema *schema, int attrNum)
+{
+    char file[256];
+    DataType dt = schema->dataTypes[attrNum];
+    int order = getMaxBtreeOrder(dt, schema->typeLength[attrNum]);
+
+    indexFileName(table, schema, attrNum, file, sizeof(file));
+    return createBtreeWithOptions(file, dt, schema->typeLength[attrNum], order, true);
+}
+
+/*
+ * openIndexes
+ * -----------
+ * Opened the B+ tree of every index the table header listed.
+ */
+static RC
+openIndexes(RM_TableData *rel)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    char file[256];
+
+    if (tblData->numIndexes == 0)
+        return RC_OK;
+    tblData->indexes = (BTreeHandle **) calloc(tblData->numIndexes, sizeof(BTreeHandle *));
+    for (int i = 0; i < tblData->numIndexes; i++)
+    {
+        indexFileName(rel->name, rel->schema, tblData->indexAttrs[i], file, sizeof(file));
+        RC rc = openBtree(&tblData->indexes[i], file);
+        if (rc != RC_OK) return rc;
+    }
+    return RC_OK;
+}
+
+/*
+ * closeIndexes
+ * ------------
+ * Closed the open index handles of a table.
+ */
+static RC
+closeIndexes(RM_TableMgmtData *tblData)
+{
+    if (tblData->indexes == NULL)
+        return RC_OK;
+    for (int i = 0; i < tblData->numIndexes; i++)
+    {
+        if (tblData->indexes[i] == NULL)
+            continue;
+        RC rc = closeBtree(tblData->indexes[i]);
+        if (rc != RC_OK) return rc;
+    }
+    free(tblData->indexes);
+    tblData->indexes = NULL;
+    return RC_OK;
+}
+
+/*
+ * changeIndexes
+ * -------------
+ * Did the work of maintainIndexes (the caller held indexLatch).
+ */
+static RC
+changeIndexes(RM_TableData *rel, RID id, char *oldData, char *newData)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    Schema *sc = rel->schema;
+
+    for (int i = 0; i < tblData->numIndexes; i++)
+    {
+        int attr = tblData->indexAttrs[i];
+        int off  = sc->attrOffsets[attr];
+        int size = attrSize(sc, attr);
+        char strBuf[sc->typeLength[attr] + 1];
+        Value key;
+        Record view;
+        RC rc;
+
+        if (oldData != NULL && newData != NULL && memcmp(oldData + off, newData + off, size) == 0)
+            continue;
+
+        view.id = id;
+        key.v.stringV = strBuf;
+        if (oldData != NULL)
+        {
+            view.data = oldData;
+            getAttrInto(&view, sc, attr, &key);
+            rc = deleteEntry(tblData->indexes[i], &key, id);
+            if (rc != RC_OK && rc != RC_IM_KEY_NOT_FOUND) return rc;
+        }
+        if (newData != NULL)
+        {
+            view.data = newData;
+            key.v.stringV = strBuf;
+            getAttrInto(&view, sc, attr, &key);
+            rc = insertKey(tblData->indexes[i], &key, id);
+            if (rc != RC_OK && rc != RC_IM_KEY_ALREADY_EXISTS) return rc;
+        }
+    }
+    return RC_OK;
+}
+
+/*
+ * maintainIndexes
+ * ---------------
+ * Brought every index in line with one record change: the old attribute values
+ * (NULL for an insert) were removed and the new ones (NULL for a delete) were
+ * added under the record's RID. Indexes whose attribute did not change were
+ * left alone. The trees were changed under indexLatch.
+ */
+static RC
+maintainIndexes(RM_TableData *rel, RID id, char *oldData, char *newData)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    if (tblData->numIndexes == 0)
+        return RC_OK;
+
+    pthread_mutex_lock(&tblData->indexLatch);
+    RC rc = changeIndexes(rel, id, oldData, newData);
+    pthread_mutex_unlock(&tblData->indexLatch);
+    return rc;
+}
+
+/*
+ * compareRids
+ * -----------
+ * qsort order for RIDs: by page, then slot.
+ */
+static int
+compareRids(const void *a, const void *b)
+{
+    const RID *x = (const RID *) a;
+    const RID *y = (const RID *) b;
+    if (x->page != y->page)
+        return (x->page > y->page) - (x->page < y->page);
+    return (x->slot > y->slot) - (x->slot < y->slot);
+}
+
+/*
+ * collectRange
+ * ------------
+ * Collected the RIDs in the key range of one index and sorted them by page,
+ * so next() read every heap page at most once. Returned how many were found
+ * (*rids was malloc'ed), or -1 if the tree could not be scanned.
+ */
+static int
+collectRange(RM_TableMgmtData *tblData, RM_IndexRange *range, RID **rids)
+{
+    // The tree was read under indexLatch, the records themselves later
+    BT_ScanHandle *bscan;
+    pthread_mutex_lock(&tblData->indexLatch);
+    if (openTreeRangeScan(tblData->indexes[range->index], range->low, range->lowInc,
+                          range->high, range->highInc, &bscan) != RC_OK)
+    {
+        pthread_mutex_unlock(&tblData->indexLatch);
+        return -1;
+    }
+
+    int capacity = 64, num = 0;
+    RID rid;
+    *rids = (RID *) malloc(capacity * sizeof(RID));
+    while (nextEntry(bscan, &rid) == RC_OK)
+    {
+        if (num == capacity)
+        {
+            capacity *= 2;
+            *rids = (RID *) realloc(*rids, capacity * sizeof(RID));
+        }
+        (*rids)[num++] = rid;
+    }
+    closeTreeScan(bscan);
+    pthread_mutex_unlock(&tblData->indexLatch);
+
+    qsort(*rids, num, sizeof(RID), compareRids);
+    return num;
+}
+
+/*
+ * intersectRids
+ * -------------
+ * Kept the RIDs of a (sorted) that were also in b (sorted), in place.
+ * Returned how many were left.
+ */
+static int
+intersectRids(RID *a, int numA, RID *b, int numB)
+{
+    int i = 0, j = 0, kept = 0;
+    while (i < numA && j < numB)
+    {
+        int c = compareRids(&a[i], &b[j]);
+        if (c < 0)
+            i++;
+        else if (c > 0)
+            j++;
+        else
+        {
+            a[kept++] = a[i];
+            i++;
+            j++;
+        }
+    }
+    return kept;
+}
+
+/* --------------------------------------------------------------------------
+   Partitioned tables
+   --------------------------------------------------------------------------
+   A partitioned table kept no records itself: every record operation went to
+   the table of one partition (see rm_partition.h), and the id of the partition
+   was put into or taken out of the RID's slot on the way. Only createTable,
+   addPartition and dropPartition changed the partition list, and the last two
+   needed the table to themselves; the other operations only read it.
+ */
+
+/*
+ * toParentRid
+ * -----------
+ * Turned the RID of a record in the partition at 'pos' into the RID the
+ * partitioned table handed out for it.
+ */
+static RID
+toParentRid(RM_PartitionSet *ps, int pos, RID id)
+{
+    id.slot += ps->parts[pos].id * RM_PART_SLOTS;
+    return id;
+}
+
+/*
+ * partitionOfRid
+ * --------------
+ * Returned the open table of the partition a RID of the partitioned table
+ * pointed into, and the RID within it, or NULL if that partition was gone.
+ */
+static RM_TableData *
+partitionOfRid(RM_PartitionSet *ps, RID id, RID *local)
+{
+    int pos = rmPartFind(ps, RM_PART_RID_ID(id));
+    if (pos < 0 || id.slot < 0)
+        return NULL;
+    local->page = id.page;
+    local->slot = RM_PART_RID_SLOT(id);
+    return ps->tables[pos];
+}
+
+/*
+ * partitionOf
+ * -----------
+ * Returned the position of the partition a record belonged in, or -1 if no
+ * range partition took its key.
+ */
+static int
+partitionOf(RM_TableData *rel, char *recData)
+{
+    RM_PartitionSet *ps = ((RM_TableMgmtData *) rel->mgmtData)->partSet;
+    Schema *sc = rel->schema;
+    char *raw = recData + sc->attrOffsets[ps->attr];
+    int len = attrSize(sc, ps->attr);
+    double key = 0;
+
+    if (ps->dt == DT_INT)
+    {
+        int v;
+        memcpy(&v, raw, sizeof(int));
+        key = v;
+    }
+    else if (ps->dt == DT_FLOAT)
+    {
+        float v;
+        memcpy(&v, raw, sizeof(float));
+        key = v;
+    }
+    else if (ps->dt == DT_STRING)
+        len = (int) strnlen(raw, sc->typeLength[ps->attr]);
+
+    unsigned hash = (ps->scheme == RM_PART_HASH) ? rmPartHash(ps->dt, raw, len) : 0;
+    return rmPartRouteKey(ps, key, hash);
+}
+
+/*
+ * savePartitionMap
+ * ----------------
+ * Wrote the partition list to a new overflow chain, pointed page 0 at it, and
+ * only then freed the old chain, so a crash left one list or the other.
+ */
+static RC
+savePartitionMap(RM_TableData *rel)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    RM_PartitionSet *ps = tblData->partSet;
+    int oldPage = tblData->partMapPage;
+    RC rc;
+
+    tblData->partMapPage = -1;
+    if (ps->numParts > 0)
+    {
+        rc = writeOverflow(tblData, (char *) ps->parts, ps->numParts * (int) sizeof(RM_Partition),
+                           &tblData->partMapPage);
+        if (rc != RC_OK) return rc;
+    }
+    if (tblData->log == NULL)
+    {
+        rc = flushTable(tblData);
+        if (rc != RC_OK) return rc;
+    }
+
+    rc = writeTableInfo(rel);
+    if (rc != RC_OK) return rc;
+    return (oldPage > 0) ? freeOverflow(tblData, oldPage) : RC_OK;
+}
+
+/*
+ * openPartition
+ * -------------
+ * Opened the table of the partition at 'pos'. Its RM_TableData and name were
+ * allocated here and freed by closePartition.
+ */
+static RC
+openPartition(RM_TableData *rel, int pos)
+{
+    RM_PartitionSet *ps = ((RM_TableMgmtData *) rel->mgmtData)->partSet;
+    size_t size = strlen(rel->name) + 16;
+    char *name = (char *) malloc(size);
+    rmPartFileName(rel->name, ps->parts[pos].id, name, size);
+
+    RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+    RC rc = openTable(table, name);
+    if (rc != RC_OK)
+    {
+        free(name);
+        free(table);
+        return rc;
+    }
+    ps->tables[pos] = table;
+    return RC_OK;
+}
+
+/*
+ * closePartition
+ * --------------
+ * Closed the table of a partition (deleting its files if 'destroy' was set)
+ * and freed what openPartition had allocated.
+ */
+static RC
+closePartition(RM_TableData *table, bool destroy)
+{
+    char *name = table->name;
+    RC rc = closeTable(table);
+    if (rc == RC_OK && destroy)
+        rc = deleteTable(name);
+    free(name);
+    free(table);
+    return rc;
+}
+
+/*
+ * openPartitions
+ * --------------
+ * Read the saved partition list (readTableInfo had made room for it) and
+ * opened the table of every partition.
+ */
+static RC
+openPartitions(RM_TableData *rel)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    RM_PartitionSet *ps = tblData->partSet;
+    if (ps == NULL || ps->numParts == 0)
+        return RC_OK;
+
+    RC rc = readOverflow(tblData, tblData->partMapPage, (char *) ps->parts,
+                         ps->numParts * (int) sizeof(RM_Partition));
+    for (int i = 0; i < ps->numParts && rc == RC_OK; i++)
+        rc = openPartition(rel, i);
+    return rc;
+}
+
+/*
+ * closePartitions
+ * ---------------
+ * Closed the table of every partition; the list itself stayed until the
+ * partitioned table was closed.
+ */
+static RC
+closePartitions(RM_TableMgmtData *tblData)
+{
+    RM_PartitionSet *ps = tblData->partSet;
+    RC rc = RC_OK;
+    for (int i = 0; ps != NULL && i < ps->numParts; i++)
+        if (ps->tables[i] != NULL)
+        {
+            RC closed = closePartition(ps->tables[i], false);
+            ps->tables[i] = NULL;
+            if (rc == RC_OK)
+                rc = closed;
+        }
+    return rc;
+}
+
+/*
+ * likeOptions
+ * -----------
+ * Filled in the options an open table had been created with, so a new
+ * partition could be made like the others. The attribute lists went into
+ * the caller's arrays (numAttr entries each).
+ */
+static void
+likeOptions(RM_TableData *table, RM_TableOptions *options, int *zoneAttrs, int *indexAttrs, int *dictAttrs)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) table->mgmtData;
+    initTableOptions(options);
+    options->layout = tblData->layout;
+
+    options->numZoneAttrs = tblData->zoneMap.numAttrs;
+    for (int i = 0; i < tblData->zoneMap.numAttrs; i++)
+        zoneAttrs[i] = tblData->zoneMap.attrs[i];
+    options->zoneAttrs = zoneAttrs;
+
+    options->numIndexes = tblData->numIndexes;
+    for (int i = 0; i < tblData->numIndexes; i++)
+        indexAttrs[i] = tblData->indexAttrs[i];
+    options->indexAttrs = indexAttrs;
+
+    for (int a = 0; a < table->schema->numAttr; a++)
+        if (tblData->dictOf[a] != NULL)
+            dictAttrs[options->numDictAttrs++] = a;
+    options->dictAttrs = dictAttrs;
+
+    options->inMemory = (tblData->arena != NULL);
+    if (!options->inMemory)
+        getPageFileCodec(table->name, &options->codec);
+}
+
+/*
+ * createPartitionedTable
+ * ----------------------
+ * Checked the partitioning options, created the table of every partition
+ * (with the other options) and then the partitioned table itself, whose page
+ * 0 and partition list named them.
+ */
+static RC
+createPartitionedTable(char *name, Schema *schema, RM_TableOptions *options)
+{
+    int attr = options->partAttr, numParts = options->numParts;
+    if (attr < 0 || attr >= schema->numAttr)
+        return RC_RM_NO_SUCH_ATTR;
+    if (options->partScheme != RM_PART_HASH && options->partScheme != RM_PART_RANGE)
+        return RC_RM_BAD_PARTITION;
+    if (numParts < 1)
+        return RC_RM_BAD_PARTITION;
+
+    // Large objects lived next to the records that held them, which no page
+    // file of a partitioned table did for all its records
+    for (int i = 0; i < schema->numAttr; i++)
+        if (schema->dataTypes[i] == DT_BLOB)
+            return RC_RM_BAD_BLOB_ATTR;
+
+    // Range keys were numbers, and the upper bounds went up
+    if (options->partScheme == RM_PART_RANGE)
+    {
+        if ((schema->dataTypes[attr] != DT_INT && schema->dataTypes[attr] != DT_FLOAT)
+            || options->partBounds == NULL)
+            return RC_RM_BAD_PARTITION;
+        for (int i = 0; i < numParts; i++)
+        {
+            Value *bound = options->partBounds[i];
+            if (bound == NULL || (bound->dt != DT_INT && bound->dt != DT_FLOAT)
+                || (i > 0 && rmPartKey(bound) <= rmPartKey(options->partBounds[i - 1])))
+                return RC_RM_BAD_PARTITION;
+        }
+    }
+
+    RM_TableOptions parentOptions;
+    initTableOptions(&parentOptions);
+    parentOptions.inMemory = options->inMemory;
+    RC rc = createTableWithOptions(name, schema, &parentOptions);
+    if (rc != RC_OK) return rc;
+
+    RM_TableData rel;
+    rc = openTable(&rel, name);
+    if (rc != RC_OK) return rc;
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel.mgmtData;
+    tblData->partSet = (RM_PartitionSet *) malloc(sizeof(RM_PartitionSet));
+    rmPartInit(tblData->partSet, options->partScheme, attr, schema->dataTypes[attr]);
+
+    RM_TableOptions partOptions = *options;
+    partOptions.partScheme = RM_PART_NONE;
+    for (int i = 0; i < numParts && rc == RC_OK; i++)
+    {
+        RM_Partition *p = rmPartAdd(tblData->partSet);
+        if (options->partScheme == RM_PART_RANGE)
+        {
+            p->hasLow  = (i > 0);
+            p->low     = (i > 0) ? rmPartKey(options->partBounds[i - 1]) : 0;
+            p->hasHigh = 1;
+            p->high    = rmPartKey(options->partBounds[i]);
+        }
+        char file[256];
+        rmPartFileName(name, p->id, file, sizeof(file));
+        rc = createTableWithOptions(file, schema, &partOptions);
+    }
+
+    if (rc == RC_OK)
+        rc = savePartitionMap(&rel);
+    RC closed = closeTable(&rel);
+    return (rc != RC_OK) ? rc : closed;
+}
+
+/*
+ * partitionInsert
+ * ---------------
+ * Inserted a record into the partition its key belonged in.
+ */
+static RC
+partitionInsert(RM_TableData *rel, Record *record)
+{
+    RM_PartitionSet *ps = ((RM_TableMgmtData *) rel->mgmtData)->partSet;
+    int pos = partitionOf(rel, record->data);
+    if (pos < 0)
+        return RC_RM_NO_PARTITION;
+
+    RC rc = insertRecord(ps->tables[pos], record);
+    if (rc == RC_OK)
+        record->id = toParentRid(ps, pos, record->id);
+    return rc;
+}
+
+/*
+ * partitionInsertRecords
+ * ----------------------
+ * Did insertRecords on a partitioned table: every record was routed first
+ * (nothing was inserted if one had no partition), and then each partition got
+ * its records as one batch, in their order.
+ */
+static RC
+partitionInsertRecords(RM_TableData *rel, char *recData, int numRecords, RID *ids)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    RM_PartitionSet *ps = tblData->partSet;
+    size_t recordSize = tblData->recordSize;
+    if (numRecords <= 0)
+        return RC_OK;
+
+    int *target = (int *) malloc(numRecords * sizeof(int));
+    for (int i = 0; i < numRecords; i++)
+    {
+        target[i] = partitionOf(rel, recData + i * recordSize);
+        if (target[i] < 0)
+        {
+            free(target);
+            return RC_RM_NO_PARTITION;
+        }
+    }
+
+    char *batch = (char *) malloc(numRecords * recordSize);
+    RID *rids = (RID *) malloc(numRecords * sizeof(RID));
+    RC rc = RC_OK;
+    for (int pos = 0; pos < ps->numParts && rc == RC_OK; pos++)
+    {
+        int n = 0;
+        for (int i = 0; i < numRecords; i++)
+            if (target[i] == pos)
+                memcpy(batch + n++ * recordSize, recData + i * recordSize, recordSize);
+        if (n == 0)
+            continue;
+
+        rc = insertRecords(ps->tables[pos], batch, n, rids);
+        if (rc == RC_OK && ids != NULL)
+            for (int i = 0, j = 0; i < numRecords; i++)
+                if (target[i] == pos)
+                    ids[i] = toParentRid(ps, pos, rids[j++]);
+    }
+    free(rids);
+    free(batch);
+    free(target);
+    return rc;
+}
+
+/*
+ * partitionPlan
+ * -------------
+ * Put together the plan of a scan of some partitions: the estimates of the
+ * partitions' own plans added up, and the access path of the first one.
+ */
+static void
+partitionPlan(RM_PartitionSet *ps, int *parts, int numParts, Expr *cond, RM_ScanPlan *plan)
+{
+    RM_ScanPlan first;
+    memset(plan, 0, sizeof(RM_ScanPlan));
+    memset(&first, 0, sizeof(RM_ScanPlan));
+    first.path = RM_PATH_SEQ;
+    first.indexAttrs[0] = first.indexAttrs[1] = -1;
+
+    for (int i = 0; i < numParts; i++)
+    {
+        RM_ScanPlan one;
+        explainScan(ps->tables[parts[i]], cond, &one);
+        if (i == 0)
+            first = one;
+        plan->estRows += one.estRows;
+        plan->cost    += one.cost;
+        plan->seqCost += one.seqCost;
+    }
+    plan->path       = first.path;
+    plan->indexAttrs[0] = first.indexAttrs[0];
+    plan->indexAttrs[1] = first.indexAttrs[1];
+    snprintf(plan->text, sizeof(plan->text), "partitions %d of %d, %.200s",
+             numParts, ps->numParts, numParts > 0 ? first.text : "no scan");
+}
+
+/*
+ * initPartitionScan
+ * -----------------
+ * Set up a scan of a partitioned table: of the partition at 'only', or (if
+ * it was -1) of every partition the condition did not rule out. next scanned
+ * them one after the other.
+ */
+static RC
+initPartitionScan(RM_TableData *rel, RM_ScanHandle *scan, Expr *cond, int only,
+                  int numAttrs, int *attrs, RM_Snapshot *snapshot)
+{
+    RM_PartitionSet *ps = ((RM_TableMgmtData *) rel->mgmtData)->partSet;
+    RM_ScanMgmtData *sdata = (RM_ScanMgmtData *) calloc(1, sizeof(RM_ScanMgmtData));
+    sdata->cond = cond;
+    sdata->parts = (int *) malloc((ps->numParts > 0 ? ps->numParts : 1) * sizeof(int));
+
+    if (only >= 0)
+        sdata->parts[sdata->numParts++] = only;
+    else
+    {
+        bool keep[ps->numParts > 0 ? ps->numParts : 1];
+        rmPartPrune(ps, cond, keep);
+        for (int i = 0; i < ps->numParts; i++)
+            if (keep[i])
+                sdata->parts[sdata->numParts++] = i;
+    }
+
+    if (numAttrs > 0)
+    {
+        sdata->numProjAttrs = numAttrs;
+        sdata->projAttrs = (int *) malloc(numAttrs * sizeof(int));
+        memcpy(sdata->projAttrs, attrs, numAttrs * sizeof(int));
+    }
+    sdata->asOf = (snapshot != NULL);
+    sdata->snapshot = (snapshot != NULL) ? snapshot->readTs : 0;
+    partitionPlan(ps, sdata->parts, sdata->numParts, cond, &sdata->plan);
+
+    scan->rel = rel;
+    scan->mgmtData = sdata;
+    return RC_OK;
+}
+
+/*
+ * nextInPartitions
+ * ----------------
+ * Returned the next record (or view, for nextView) of a partition scan,
+ * starting the scan of the next partition whenever one ran out.
+ */
+static RC
+nextInPartitions(RM_ScanHandle *scan, Record *record, RM_RecordView *view)
+{
+    RM_PartitionSet *ps = ((RM_TableMgmtData *) scan->rel->mgmtData)->partSet;
+    RM_ScanMgmtData *sdata = (RM_ScanMgmtData *) scan->mgmtData;
+
+    while (sdata->partPos < sdata->numParts)
+    {
+        int pos = sdata->parts[sdata->partPos];
+        RC rc;
+        if (!sdata->partOpen)
+        {
+            RM_Snapshot snapshot;
+            snapshot.readTs = sdata->snapshot;
+            if (sdata->asOf)
+                rc = startScanAsOf(ps->tables[pos], &sdata->partScan, sdata->cond, &snapshot);
+            else
+                rc = startScanProjection(ps->tables[pos], &sdata->partScan, sdata->cond,
+                                         sdata->numProjAttrs, sdata->projAttrs);
+            if (rc != RC_OK) return rc;
+            sdata->partOpen = true;
+        }
+
+        rc = (view != NULL) ? nextView(&sdata->partScan, view) : next(&sdata->partScan, record);
+        if (rc == RC_OK && view != NULL)
+            view->id = toParentRid(ps, pos, view->id);
+        else if (rc == RC_OK)
+            record->id = toParentRid(ps, pos, record->id);
+        if (rc == RC_OK)
+            return RC_OK;
+        closeScan(&sdata->partScan);
+        sdata->partOpen = false;
+        sdata->partPos++;
+        if (rc != RC_RM_NO_MORE_TUPLES)
+            return rc;
+    }
+    return RC_RM_NO_MORE_TUPLES;
+}
+
+/*
+ * getNumPartitions
+ * ----------------
+ * Returned how many partitions the table had; a table that was not
+ * partitioned counted as one.
+ */
+int getNumPartitions(RM_TableData *rel)
+{
+    RM_PartitionSet *ps = ((RM_TableMgmtData *) rel->mgmtData)->partSet;
+    return (ps != NULL) ? ps->numParts : 1;
+}
+
+/*
+ * getScanPartitions
+ * -----------------
+ * Listed the partitions (0 .. getNumPartitions - 1) a scan with this condition
+ * had to read; 'parts' needed room for all of them. Each could then be read by
+ * its own thread with startPartitionScan.
+ */
+RC getScanPartitions(RM_TableData *rel, Expr *cond, int *parts, int *numParts)
+{
+    RM_PartitionSet *ps = ((RM_TableMgmtData *) rel->mgmtData)->partSet;
+    *numParts = 0;
+    if (ps == NULL)
+    {
+        parts[(*numParts)++] = 0;
+        return RC_OK;
+    }
+
+    bool keep[ps->numParts > 0 ? ps->numParts : 1];
+    rmPartPrune(ps, cond, keep);
+    for (int i = 0; i < ps->numParts; i++)
+        if (keep[i])
+            parts[(*numParts)++] = i;
+    return RC_OK;
+}
+
+/*
+ * startPartitionScan
+ * ------------------
+ * Started a scan of one partition. Scans of different partitions shared
+ * nothing but the partition list, so threads could run them at once.
+ */
+RC startPartitionScan(RM_TableData *rel, int part, RM_ScanHandle *scan, Expr *cond)
+{
+    RM_PartitionSet *ps = ((RM_TableMgmtData *) rel->mgmtData)->partSet;
+    if (ps == NULL)
+        return (part == 0) ? startScan(rel, scan, cond) : RC_RM_BAD_PARTITION;
+    if (part < 0 || part >= ps->numParts)
+        return RC_RM_BAD_PARTITION;
+    return initPartitionScan(rel, scan, cond, part, 0, NULL, NULL);
+}
+
+/*
+ * addPartition
+ * ------------
+ * Added a range partition for the keys from the highest upper bound so far
+ * up to 'upperBound', created like the last partition (layout, indexes, zone
+ * map, dictionaries, codec, in memory or not). Hash tables could not grow.
+ */
+RC addPartition(RM_TableData *rel, Value *upperBound)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    RM_PartitionSet *ps = tblData->partSet;
+    if (ps == NULL || ps->scheme != RM_PART_RANGE || upperBound == NULL
+        || (upperBound->dt != DT_INT && upperBound->dt != DT_FLOAT))
+        return RC_RM_BAD_PARTITION;
+
+    double high = rmPartKey(upperBound);
+    RM_Partition last;
+    memset(&last, 0, sizeof(RM_Partition));
+    if (ps->numParts > 0)
+    {
+        last = ps->parts[ps->numParts - 1];
+        if (!last.hasHigh || high <= last.high)
+            return RC_RM_BAD_PARTITION;
+    }
+
+    int numAttr = rel->schema->numAttr;
+    int zoneAttrs[numAttr], indexAttrs[numAttr], dictAttrs[numAttr];
+    RM_TableOptions options;
+    if (ps->numParts > 0)
+        likeOptions(ps->tables[ps->numParts - 1], &options, zoneAttrs, indexAttrs, dictAttrs);
+    else
+        initTableOptions(&options);
+
+    char file[256];
+    rmPartFileName(rel->name, ps->nextId, file, sizeof(file));
+    RC rc = createTableWithOptions(file, rel->schema, &options);
+    if (rc != RC_OK) return rc;
+
+    RM_Partition *p = rmPartAdd(ps);
+    p->hasLow  = last.hasHigh;
+    p->low     = last.high;
+    p->hasHigh = 1;
+    p->high    = high;
+    int pos = ps->numParts - 1;
+    rc = openPartition(rel, pos);
+    if (rc == RC_OK && tblData->log != NULL)
+        rc = attachTableLog(ps->tables[pos], tblData->log);
+    if (rc != RC_OK)
+    {
+        rmPartRemove(ps, pos);
+        return rc;
+    }
+    return savePartitionMap(rel);
+}
+
+/*
+ * dropPartition
+ * -------------
+ * Dropped a range partition with all its records: it was taken out of the
+ * saved partition list, and then its files were deleted, whatever the number
+ * of records. Keys in its range had no partition afterwards (unless it was
+ * the last one, whose range a later addPartition took again). Like
+ * vacuumTable it needed the table to itself, and was refused while a
+ * snapshot was open.
+ */
+RC dropPartition(RM_TableData *rel, int part)
+{
+    RM_PartitionSet *ps = ((RM_TableMgmtData *) rel->mgmtData)->partSet;
+    if (ps == NULL || ps->scheme != RM_PART_RANGE || part < 0 || part >= ps->numParts)
+        return RC_RM_BAD_PARTITION;
+    if (rmSnapshotsOpen() > 0)
+        return RC_RM_SNAPSHOT_OPEN;
+
+    RM_TableData *table = ps->tables[part];
+    rmPartRemove(ps, part);
+    RC rc = savePartitionMap(rel);
+    if (rc != RC_OK) return rc;
+    return closePartition(table, true);
+}
+
+/* --------------------------------------------------------------------------
+   Large objects
+   --------------------------------------------------------------------------
+   A large object lived in the page file of its table, on a directory page
+   (RM_PAGE_BLOB, whose number was the id a DT_BLOB attribute held) that listed
+   its data pages in order (see rm_page.h). It was read and written through a
+   handle a piece at a time, so neither side ever held the whole object in
+   memory, and any offset was reached through the directory. The object
+   belonged to the record that held its id: deleteRecord freed it, and so did
+   updateRecord once the attribute held another id. One handle at a time could
+   write an object; readers did not see a write until it returned.
+   -------------------------------------------------------------------------- */
+
+/*
+ * blobHead
+ * --------
+ * Checked that 'id' named the first page of a large object and read its length.
+ */
+static RC
+blobHead(RM_TableMgmtData *tblData, int id, long long *length)
+{
+    BM_PageHandle page;
+    if (id < 1 || id >= tblData->numPages)
+        return RC_RM_BAD_BLOB;
+    RC rc = latchPage(tblData, &page, id, false);
+    if (rc != RC_OK) return rc;
+
+    bool isBlob = (RM_PAGE_HDR(page.data)->pageType == RM_PAGE_BLOB);
+    if (isBlob)
+        memcpy(length, RM_BLOB_LENGTH(page.data), sizeof(long long));
+    unlatchPage(tblData, &page);
+    return isBlob ? RC_OK : RC_RM_BAD_BLOB;
+}
+
+/*
+ * newBlobPage
+ * -----------
+ * Allocated and formatted a page of a large object: an empty directory page,
+ * or a data page.
+ */
+static RC
+newBlobPage(RM_TableMgmtData *tblData, int pageType, int *pageNum)
+{
+    BM_PageHandle page;
+    RC rc = allocPage(tblData, pageNum);
+    if (rc != RC_OK) return rc;
+    rc = latchPage(tblData, &page, *pageNum, true);
+    if (rc != RC_OK) return rc;
+
+    rmInitPage(page.data, pageType);
+    RM_PAGE_HDR(page.data)->nextPage = -1;
+    RM_PAGE_HDR(page.data)->dataLen  = 0;
+    if (pageType != RM_PAGE_OVERFLOW)
+        memset(RM_BLOB_LENGTH(page.data), 0, sizeof(long long));
+    dirtyPage(tblData, &page);
+    return unlatchPage(tblData, &page);
+}
+
+/*
+ * blobDataPage
+ * ------------
+ * Found data page number k of an open large object through its directory,
+ * starting from the directory page used last unless k came before it. With
+ * 'extend' set, k could be one past the last data page, which was then
+ * allocated (and a directory page with it, if the last one was full). No page
+ * was latched while another one was allocated.
+ */
+static RC
+blobDataPage(RM_BlobHandle *blob, long long k, bool extend, int *pageNum)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) blob->rel->mgmtData;
+    RM_BlobMgmtData *bd = (RM_BlobMgmtData *) blob->mgmtData;
+    BM_PageHandle page;
+
+    if (k < bd->dirFirst)
+    {
+        bd->dirPage  = blob->id;
+        bd->dirFirst = 0;
+    }
+    for (;;)
+    {
+        RC rc = latchPage(tblData, &page, bd->dirPage, false);
+        if (rc != RC_OK) return rc;
+        RM_PageHeader *hdr = RM_PAGE_HDR(page.data);
+        int numEntries = hdr->dataLen, next = hdr->nextPage;
+
+        if (k < bd->dirFirst + RM_BLOB_DIR_ENTRIES)
+        {
+            int idx = (int) (k - bd->dirFirst);
+            if (idx < numEntries)
+                *pageNum = RM_BLOB_PAGES(page.data)[idx];
+            unlatchPage(tblData, &page);
+            if (idx < numEntries)
+                return RC_OK;
+            if (!extend || idx != numEntries)
+                return RC_RM_BAD_BLOB;
+
+            rc = newBlobPage(tblData, RM_PAGE_OVERFLOW, pageNum);
+            if (rc != RC_OK) return rc;
+            rc = latchPage(tblData, &page, bd->dirPage, true);
+            if (rc != RC_OK) return rc;
+            RM_BLOB_PAGES(page.data)[idx] = *pageNum;
+            RM_PAGE_HDR(page.data)->dataLen = idx + 1;
+            dirtyPage(tblData, &page);
+            return unlatchPage(tblData, &page);
+        }
+        unlatchPage(tblData, &page);
+
+        // The entry lay on a later directory page
+        if (next < 1)
+        {
+            if (!extend || numEntries < RM_BLOB_DIR_ENTRIES)
+                return RC_RM_BAD_BLOB;
+            rc = newBlobPage(tblData, RM_PAGE_BLOB_DIR, &next);
+            if (rc != RC_OK) return rc;
+            rc = latchPage(tblData, &page, bd->dirPage, true);
+            if (rc != RC_OK) return rc;
+            RM_PAGE_HDR(page.data)->nextPage = next;
+            dirtyPage(tblData, &page);
+            unlatchPage(tblData, &page);
+        }
+        bd->dirPage   = next;
+        bd->dirFirst += RM_BLOB_DIR_ENTRIES;
+    }
+}
+
+/*
+ * dropBlob
+ * --------
+ * Released every page of a large object: the data pages listed on each
+ * directory page (copied out first, so only one page was latched at a time),
+ * then the directory page itself.
+ */
+static RC
+dropBlob(RM_TableMgmtData *tblData, int id)
+{
+    BM_PageHandle page;
+    long long length;
+    int pages[RM_BLOB_DIR_ENTRIES];
+    RC rc = blobHead(tblData, id, &length);
+    if (rc != RC_OK) return rc;
+
+    for (int dir = id; dir > 0; )
+    {
+        rc = latchPage(tblData, &page, dir, false);
+        if (rc != RC_OK) return rc;
+        int numEntries = RM_PAGE_HDR(page.data)->dataLen;
+        int next = RM_PAGE_HDR(page.data)->nextPage;
+        memcpy(pages, RM_BLOB_PAGES(page.data), numEntries * sizeof(int));
+        unlatchPage(tblData, &page);
+
+        for (int i = 0; i < numEntries; i++)
+        {
+            rc = releasePage(tblData, pages[i]);
+            if (rc != RC_OK) return rc;
+        }
+        rc = releasePage(tblData, dir);
+        if (rc != RC_OK) return rc;
+        dir = next;
+    }
+    return RC_OK;
+}
+
+/*
+ * freeBlobs
+ * ---------
+ * Freed the large objects an old version of a record held and the new one
+ * (NULL after a delete) no longer did. Ids that named no large object were
+ * skipped.
+ */
+static RC
+freeBlobs(RM_TableData *rel, char *oldData, char *newData)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    Schema *sc = rel->schema;
+
+    for (int i = 0; i < sc->numAttr; i++)
+    {
+        if (sc->dataTypes[i] != DT_BLOB)
+            continue;
+        int oldId, newId = 0;
+        memcpy(&oldId, oldData + sc->attrOffsets[i], sizeof(int));
+        if (newData != NULL)
+            memcpy(&newId, newData + sc->attrOffsets[i], sizeof(int));
+        if (oldId == 0 || oldId == newId)
+            continue;
+        RC rc = dropBlob(tblData, oldId);
+        if (rc != RC_OK && rc != RC_RM_BAD_BLOB) return rc;
+    }
+    return RC_OK;
+}
+
+/*
+ * openBlobHandle
+ * --------------
+ * Set up a handle positioned at the start of a large object.
+ */
+static void
+openBlobHandle(RM_TableData *rel, int id, long long length, RM_BlobHandle *blob)
+{
+    RM_BlobMgmtData *bd = (RM_BlobMgmtData *) malloc(sizeof(RM_BlobMgmtData));
+    bd->length   = length;
+    bd->pos      = 0;
+    bd->dirPage  = id;
+    bd->dirFirst = 0;
+
+    blob->rel      = rel;
+    blob->id       = id;
+    blob->mgmtData = bd;
+}
+
+/*
+ * createBlob
+ * ----------
+ * Created an empty large object in a table and opened it for writing. Its id
+ * (blob->id) went into a DT_BLOB attribute with setAttr, before or after the
+ * object was written. Partitioned tables held no large objects.
+ */
+RC createBlob(RM_TableData *rel, RM_BlobHandle *blob)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    int id;
+    if (tblData->partSet != NULL)
+        return RC_RM_BAD_BLOB_ATTR;
+
+    RC rc = newBlobPage(tblData, RM_PAGE_BLOB, &id);
+    if (rc != RC_OK) return rc;
+    openBlobHandle(rel, id, 0, blob);
+    return RC_OK;
+}
+
+/*
+ * openBlob
+ * --------
+ * Opened the large object a DT_BLOB attribute held the id of, positioned at
+ * its start. Returned RC_RM_BAD_BLOB if the id named none.
+ */
+RC openBlob(RM_TableData *rel, int id, RM_BlobHandle *blob)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    long long length;
+    if (tblData->partSet != NULL)
+        return RC_RM_BAD_BLOB_ATTR;
+
+    RC rc = blobHead(tblData, id, &length);
+    if (rc != RC_OK) return rc;
+    openBlobHandle(rel, id, length, blob);
+    return RC_OK;
+}
+
+/*
+ * readBlob
+ * --------
+ * Copied up to 'len' bytes from the current position into buf, one data page
+ * at a time, and moved the position past them. *numRead was 0 at the end of
+ * the object.
+ */
+RC readBlob(RM_BlobHandle *blob, char *buf, int len, int *numRead)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) blob->rel->mgmtData;
+    RM_BlobMgmtData *bd = (RM_BlobMgmtData *) blob->mgmtData;
+    BM_PageHandle page;
+
+    *numRead = 0;
+    while (len > 0 && bd->pos < bd->length)
+    {
+        int off = (int) (bd->pos % RM_OVERFLOW_CAPACITY);
+        long long left = bd->length - bd->pos;
+        int chunk = RM_OVERFLOW_CAPACITY - off;
+        if (chunk > len) chunk = len;
+        if (chunk > left) chunk = (int) left;
+
+        int pageNum;
+        RC rc = blobDataPage(blob, bd->pos / RM_OVERFLOW_CAPACITY, false, &pageNum);
+        if (rc != RC_OK) return rc;
+        rc = latchPage(tblData, &page, pageNum, false);
+        if (rc != RC_OK) return rc;
+        memcpy(buf, RM_OVERFLOW_DATA(page.data) + off, chunk);
+        unlatchPage(tblData, &page);
+
+        buf       += chunk;
+        len       -= chunk;
+        bd->pos   += chunk;
+        *numRead  += chunk;
+    }
+    return RC_OK;
+}
+
+/*
+ * writeBlob
+ * ---------
+ * Wrote 'len' bytes at the current position, over what was there and then
+ * onto new data pages past the end, and moved the position past them. The
+ * new length was saved on the first directory page once the bytes were in.
+ */
+RC writeBlob(RM_BlobHandle *blob, char *buf, int len)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) blob->rel->mgmtData;
+    RM_BlobMgmtData *bd = (RM_BlobMgmtData *) blob->mgmtData;
+    BM_PageHandle page;
+
+    while (len > 0)
+    {
+        int off = (int) (bd->pos % RM_OVERFLOW_CAPACITY);
+        int chunk = RM_OVERFLOW_CAPACITY - off;
+        if (chunk > len) chunk = len;
+
+        int pageNum;
+        RC rc = blobDataPage(blob, bd->pos / RM_OVERFLOW_CAPACITY, true, &pageNum);
+        if (rc != RC_OK) return rc;
+        rc = latchPage(tblData, &page, pageNum, true);
+        if (rc != RC_OK) return rc;
+        memcpy(RM_OVERFLOW_DATA(page.data) + off, buf, chunk);
+        if (RM_PAGE_HDR(page.data)->dataLen < off + chunk)
+            RM_PAGE_HDR(page.data)->dataLen = off + chunk;
+        dirtyPage(tblData, &page);
+        unlatchPage(tblData, &page);
+
+        buf     += chunk;
+        len     -= chunk;
+        bd->pos += chunk;
+        if (bd->pos > bd->length)
+            bd->length = bd->pos;
+    }
+
+    RC rc = latchPage(tblData, &page, blob->id, true);
+    if (rc != RC_OK) return rc;
+    memcpy(RM_BLOB_LENGTH(page.data), &bd->length, sizeof(long long));
+    dirtyPage(tblData, &page);
+    return unlatchPage(tblData, &page);
+}
+
+/*
+ * seekBlob
+ * --------
+ * Moved the position of a handle anywhere from the start to the end of the
+ * object (RC_RM_BAD_BLOB otherwise).
+ */
+RC seekBlob(RM_BlobHandle *blob, long long offset)
+{
+    RM_BlobMgmtData *bd = (RM_BlobMgmtData *) blob->mgmtData;
+    if (offset < 0 || offset > bd->length)
+        return RC_RM_BAD_BLOB;
+    bd->pos = offset;
+    return RC_OK;
+}
+
+/*
+ * getBlobSize
+ * -----------
+ * Returned the length of an open large object, in bytes.
+ */
+long long getBlobSize(RM_BlobHandle *blob)
+{
+    return ((RM_BlobMgmtData *) blob->mgmtData)->length;
+}
+
+/*
+ * closeBlob
+ * ---------
+ * Released a handle. Everything written was already on the object's pages.
+ */
+RC closeBlob(RM_BlobHandle *blob)
+{
+    free(blob->mgmtData);
+    blob->mgmtData = NULL;
+    return RC_OK;
+}
+
+/*
+ * deleteBlob
+ * ----------
+ * Freed a large object that no record held (one that a record held went with
+ * the record). Its handles had to be closed.
+ */
+RC deleteBlob(RM_TableData *rel, int id)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    if (tblData->partSet != NULL)
+        return RC_RM_BAD_BLOB_ATTR;
+    return dropBlob(tblData, id);
+}
+
+/* --------------------------------------------------------------------------
+   Record Manager Interface
+   -------------------------------------------------------------------------- */
+
+/* 
+ * initRecordManager
+ * -----------------
+ * Performed global initialization if needed (here we just called initStorageManager).
+ */
+RC initRecordManager(void *mgmtData)
+{
+    initStorageManager();
+    rmVersionStart();
+    return RC_OK;
+}
+
+/*
+ * shutdownRecordManager
+ * ---------------------
+ * Stopped the thread that collected old record versions.
+ */
+RC shutdownRecordManager()
+{
+    rmVersionStop();
+    return RC_OK;
+}
+
+/*
+ * initTableOptions
+ * ----------------
+ * Filled in the default table options: row layout, no zone map, no indexes,
+ * no dictionary-encoded attributes, pages stored uncompressed in a page file.
+ */
+void initTableOptions(RM_TableOptions *options)
+{
+    options->layout       = RM_LAYOUT_ROW;
+    options->numZoneAttrs = 0;
+    options->zoneAttrs    = NULL;
+    options->numIndexes   = 0;
+    options->indexAttrs   = NULL;
+    options->numDictAttrs = 0;
+    options->dictAttrs    = NULL;
+    options->codec        = SM_CODEC_NONE;
+    options->partScheme   = RM_PART_NONE;
+    options->partAttr     = 0;
+    options->numParts     = 0;
+    options->partBounds   = NULL;
+    options->inMemory     = false;
+}
+
+/*
+ * createTable
+ * -----------
+ * Created a table with the default options (row layout).
+ */
+RC createTable(char *name, Schema *schema)
+{
+    return createTableWithOptions(name, schema, NULL);
+}
+
+/*
+ * createTableWithOptions
+ * ----------------------
+ * Created a page file for the table (and one per index), set up the mgmt data,
+ * wrote initial table metadata (including the options, NULL meaning the
+ * defaults), and then shut down the buffer manager. Freed the mgmt data after done.
+ * A partitioned table got a page file per partition as well (see
+ * createPartitionedTable). An in-memory table got an arena instead of its
+ * page file (its indexes still had theirs) and no buffer pool.
+ */
+RC createTableWithOptions(char *name, Schema *schema, RM_TableOptions *options)
+{
+    RM_TableOptions defaults;
+    if (options == NULL)
+    {
+        initTableOptions(&defaults);
+        options = &defaults;
+    }
+    if (options->partScheme != RM_PART_NONE)
+        return createPartitionedTable(name, schema, options);
+    RM_Layout layout = options->layout;
+
+    for (int i = 0; i < options->numZoneAttrs; i++)
+        if (options->zoneAttrs[i] < 0 || options->zoneAttrs[i] >= schema->numAttr)
+            return RC_RM_NO_SUCH_ATTR;
+    for (int i = 0; i < options->numIndexes; i++)
+        if (options->indexAttrs[i] < 0 || options->indexAttrs[i] >= schema->numAttr)
+            return RC_RM_NO_SUCH_ATTR;
+
+    // The id of a large object said nothing about its contents
+    for (int i = 0; i < options->numZoneAttrs; i++)
+        if (schema->dataTypes[options->zoneAttrs[i]] == DT_BLOB)
+            return RC_RM_BAD_BLOB_ATTR;
+    for (int i = 0; i < options->numIndexes; i++)
+        if (schema->dataTypes[options->indexAttrs[i]] == DT_BLOB)
+            return RC_RM_BAD_BLOB_ATTR;
+
+    // Dictionary codes only went into row records, and a value had to fit on a page
+    for (int i = 0; i < options->numDictAttrs; i++)
+    {
+        int a = options->dictAttrs[i];
+        if (a < 0 || a >= schema->numAttr)
+            return RC_RM_NO_SUCH_ATTR;
+        if (layout != RM_LAYOUT_ROW || schema->dataTypes[a] != DT_STRING
+            || schema->typeLength[a] > RM_OVERFLOW_CAPACITY - (int) sizeof(unsigned short))
+            return RC_RM_BAD_DICT_ATTR;
+        for (int j = 0; j < i; j++)
+            if (options->dictAttrs[j] == a)
+                return RC_RM_BAD_DICT_ATTR;
+    }
+
+    // A PAX page had to hold at least one fixed-width record
+    if (layout == RM_LAYOUT_PAX)
+    {
+        int colStart[schema->numAttr > 0 ? schema->numAttr : 1];
+        if (rmPaxLayout(schema, colStart) < 1)
+            return RC_RM_RECORD_TOO_LARGE;
+    }
+
+    RC rc = options->inMemory ? RC_OK : createPageFileWithCodec(name, options->codec);
+    if (rc != RC_OK) return rc;
+
+    for (int i = 0; i < options->numIndexes; i++)
+    {
+        rc = createIndexFile(name, schema, options->indexAttrs[i]);
+        if (rc != RC_OK) return rc;
+    }
+
+    // Allocated mgmt data for the table
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) malloc(sizeof(RM_TableMgmtData));
+    tblData->numTuples    = 0;
+    tblData->nextFreePage = -1;
+    tblData->freePageHead = -1;
+    tblData->numPages     = 1;
+    tblData->recordSize   = computeRecordSize(schema);
+    tblData->layout       = layout;
+    tblData->arena        = options->inMemory ? rmArenaCreate(name) : NULL;
+    tblData->zoneMapPage  = -1;
+    tblData->partSet      = NULL;
+    tblData->partMapPage  = -1;
+    rmZoneInit(&tblData->zoneMap, schema, options->numZoneAttrs, options->zoneAttrs);
+    tblData->numIndexes   = options->numIndexes;
+    tblData->indexAttrs   = options->indexAttrs;
+    tblData->log          = NULL;
+    tblData->numDicts     = 0;
+    tblData->dictOf       = (RM_Dictionary **) calloc(schema->numAttr, sizeof(RM_Dictionary *));
+    rmStatsInit(&tblData->stats, schema->numAttr);
+    initLatches(tblData);
+
+    // Initialized a buffer manager for this table
+    if (tblData->arena == NULL)
+    {
+        rc = initBufferPool(&tblData->bufferPool, name, RM_POOL_PAGES, RS_FIFO, NULL);
+        if (rc != RC_OK) return rc;
+    }
+
+    // Started the page chain of every dictionary
+    for (int i = 0; i < options->numDictAttrs; i++)
+    {
+        int a = options->dictAttrs[i];
+        RM_Dictionary *dict = (RM_Dictionary *) malloc(sizeof(RM_Dictionary));
+        rmDictInit(dict, a, schema->typeLength[a]);
+        tblData->dictOf[a] = dict;
+        tblData->numDicts++;
+        rc = newDictPage(tblData, &dict->firstPage);
+        if (rc != RC_OK) return rc;
+        dict->lastPage = dict->firstPage;
+    }
+
+    // Built a temporary RM_TableData struct so we could call writeTableInfo
+    RM_TableData tmp;
+    tmp.name   = name;
+    tmp.schema = schema;
+    tmp.mgmtData = tblData;
+
+    // Wrote out the table metadata to page 0
+    rc = writeTableInfo(&tmp);
+    if (rc != RC_OK) return rc;
+
+    // Shut down the buffer manager
+    if (tblData->arena != NULL)
+        rmArenaClose(tblData->arena);
+    else
+    {
+        rc = shutdownBufferPool(&tblData->bufferPool);
+        if (rc != RC_OK) return rc;
+    }
+
+    // Freed the mgmt data
+    rmZoneFree(&tblData->zoneMap);
+    rmStatsFree(&tblData->stats);
+    freeDictionaries(tblData, schema->numAttr);
+    destroyLatches(tblData);
+    free(tblData);
+    return RC_OK;
+}
+
+/*
+ * freeTableData
+ * -------------
+ * Released what readTableInfo (and the rest of openTable) had allocated for
+ * an open table, once its pool or arena was let go: the schema, the layout
+ * arrays, dictionaries, zone map, versions, statistics, partition list,
+ * latches and the mgmt data itself.
+ */
+static void
+freeTableData(RM_TableData *rel, RM_TableMgmtData *tblData)
+{
+    freeDictionaries(tblData, rel->schema->numAttr);
+    freeSchema(rel->schema);
+    rel->schema = NULL;
+
+    free(tblData->encOffset);
+    free(tblData->paxColStart);
+    free(tblData->indexAttrs);
+    rmZoneFree(&tblData->zoneMap);
+    rmVersionFree(&tblData->versions);
+    rmStatsFree(&tblData->stats);
+    if (tblData->partSet != NULL)
+    {
+        rmPartFree(tblData->partSet);
+        free(tblData->partSet);
+    }
+    destroyLatches(tblData);
+    free(tblData);
+    rel->mgmtData = NULL;
+}
+
+/*
+ * abandonOpen
+ * -----------
+ * Undid what a failed openTable had set up so far: the partitions and
+ * indexes it had opened and what readTableInfo had allocated (if it had got
+ * that far, i.e. rel->schema was set), then the buffer pool or arena, the
+ * latches and the mgmt data. Nothing was written back.
+ */
+static void
+abandonOpen(RM_TableData *rel, RM_TableMgmtData *tblData, bool poolReady)
+{
+    if (rel->schema != NULL)
+    {
+        closePartitions(tblData);
+        closeIndexes(tblData);
+    }
+    if (tblData->arena != NULL)
+        rmArenaClose(tblData->arena);
+    else if (poolReady)
+        shutdownBufferPool(&tblData->bufferPool);
+
+    if (rel->schema != NULL)
+        freeTableData(rel, tblData);
+    else
+    {
+        destroyLatches(tblData);
+        free(tblData);
+        rel->mgmtData = NULL;
+    }
+}
+
+/*
+ * openTable
+ * ---------
+ * Opened an existing table by creating new mgmt data, initing a buffer pool,
+ * and reading table info from page 0. Set rel->schema and rel->mgmtData.
+ * The tables of a partitioned table's partitions were opened with it. A name
+ * with an arena in this process was an in-memory table, opened without a
+ * buffer pool. A missing file was found before anything was allocated, and
+ * a step that failed later undid the ones before it (see abandonOpen).
+ */
+RC openTable(RM_TableData *rel, char *name)
+{
+    RM_Arena *arena = rmArenaOpen(name);
+    int numPages;
+    RC rc;
+
+    if (arena != NULL)
+        numPages = rmArenaNumPages(arena);
+    else
+    {
+        // Looked up the file size once; from here on we tracked it ourselves
+        SM_FileHandle fHandle;
+        rc = openPageFile(name, &fHandle);
+        if (rc != RC_OK) return rc;
+        numPages = fHandle.totalNumPages;
+        closePageFile(&fHandle);
+    }
+
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) malloc(sizeof(RM_TableMgmtData));
+    if (tblData == NULL)
+    {
+        if (arena != NULL)
+            rmArenaClose(arena);
+        return RC_MEMORY_ALLOCATION_ERROR;
+    }
+    tblData->log      = NULL;
+    tblData->arena    = arena;
+    tblData->numPages = numPages;
+    initLatches(tblData);
+
+    rel->name     = name;
+    rel->schema   = NULL;
+    rel->mgmtData = tblData;
+
+    if (arena == NULL)
+    {
+        rc = initBufferPool(&tblData->bufferPool, name, RM_POOL_PAGES, RS_FIFO, NULL);
+        if (rc != RC_OK)
+        {
+            abandonOpen(rel, tblData, false);
+            return rc;
+        }
+    }
+
+    rc = readTableInfo(rel);
+    if (rc == RC_OK)
+    {
+        rmVersionInit(&tblData->versions, tblData->recordSize);
+        rc = loadDictionaries(rel);
+    }
+    if (rc == RC_OK)
+        rc = openIndexes(rel);
+    if (rc == RC_OK)
+        rc = loadZoneMap(rel);
+    if (rc == RC_OK)
+        rc = openPartitions(rel);
+
+    if (rc != RC_OK)
+        abandonOpen(rel, tblData, true);
+    return rc;
+}
+
+/*
+ * closeTable
+ * ----------
+ * Closed the indexes, saved the zone map, wrote out metadata, shut down buffer
+ * pool, freed schema and mgmt data. Every other thread had to be done with the
+ * table first. The tables of the partitions were closed first.
+ */
+RC closeTable(RM_TableData *rel)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    RC rc = closePartitions(tblData);
+    if (rc != RC_OK) return rc;
+
+    rc = closeIndexes(tblData);
+    if (rc != RC_OK) return rc;
+
+    rc = saveZoneMap(tblData);
+    if (rc != RC_OK) return rc;
+
+    rc = writeTableInfo(rel);
+    if (rc != RC_OK) return rc;
+
+    if (tblData->arena != NULL)
+        rmArenaClose(tblData->arena);
+    else
+    {
+        rc = shutdownBufferPool(&tblData->bufferPool);
+        if (rc != RC_OK) return rc;
+    }
+
+    freeTableData(rel, tblData);
+    return RC_OK;
+}
+
+/*
+ * deleteTable
+ * -----------
+ * Destroyed the page file on disk for the table, and the files of its indexes
+ * (found by reading the table header first). The tables of a partitioned
+ * table's partitions were deleted too, and an in-memory table's arena freed.
+ */
+RC deleteTable(char *name)
+{
+    RM_TableData rel;
+    if (openTable(&rel, name) == RC_OK)
+    {
+        RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel.mgmtData;
+        RM_PartitionSet *ps = tblData->partSet;
+        for (int i = 0; ps != NULL && i < ps->numParts; i++)
+        {
+            RC rc = closePartition(ps->tables[i], true);
+            ps->tables[i] = NULL;
+            if (rc != RC_OK) return rc;
+        }
+
+        int numIndexes = tblData->numIndexes;
+        char files[numIndexes > 0 ? numIndexes : 1][256];
+        for (int i = 0; i < numIndexes; i++)
+            indexFileName(name, rel.schema, tblData->indexAttrs[i], files[i], sizeof(files[i]));
+
+        RC rc = closeTable(&rel);
+        if (rc != RC_OK) return rc;
+        for (int i = 0; i < numIndexes; i++)
+            deleteBtree(files[i]);
+    }
+    if (rmArenaDrop(name))
+        return RC_OK;
+    return destroyPageFile(name);
+}
+
+/*
+ * getNumTuples
+ * ------------
+ * Returned the number of tuples stored in the table (from mgmt data).
+ */
+int getNumTuples(RM_TableData *rel)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    if (tblData->partSet != NULL)
+    {
+        int total = 0;
+        for (int i = 0; i < tblData->partSet->numParts; i++)
+            total += getNumTuples(tblData->partSet->tables[i]);
+        return total;
+    }
+    return tblData->numTuples;
+}
+
+/*
+ * getTableIndex
+ * -------------
+ * Returned the open B+ tree the table kept on an attribute, or NULL if the
+ * attribute was not indexed. Its entries mapped attribute values to RIDs.
+ * The partitions of a partitioned table kept their indexes to themselves.
+ */
+BTreeHandle *getTableIndex(RM_TableData *rel, int attrNum)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    for (int i = 0; i < tblData->numIndexes; i++)
+        if (tblData->indexAttrs[i] == attrNum && tblData->indexes != NULL)
+            return tblData->indexes[i];
+    return NULL;
+}
+
+/*
+ * attachTableLog
+ * --------------
+ * Sent every later change of the table and its indexes to a write-ahead log
+ * (NULL stopped logging). Pages were no longer forced to disk; the log had to
+ * stay open until the table was closed. Every partition used the same log.
+ * In-memory tables were not logged, as nothing of them outlived the process.
+ */
+RC attachTableLog(RM_TableData *rel, WAL_Log *log)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    for (int i = 0; tblData->partSet != NULL && i < tblData->partSet->numParts; i++)
+    {
+        RC rc = attachTableLog(tblData->partSet->tables[i], log);
+        if (rc != RC_OK) return rc;
+    }
+    if (tblData->arena != NULL)
+        return RC_OK;
+
+    RC rc = setPoolLog(&tblData->bufferPool, log);
+    if (rc != RC_OK) return rc;
+
+    for (int i = 0; i < tblData->numIndexes; i++)
+    {
+        rc = setBtreeLog(tblData->indexes[i], log);
+        if (rc != RC_OK) return rc;
+    }
+    tblData->log = log;
+    return RC_OK;
+}
+
+/*
+ * commitTable
+ * -----------
+ * Made the changes to a table so far durable. The header page was rewritten,
+ * so its tuple count and free-space hints were logged too, and then a commit
+ * record was appended and synced (together with other committers, see
+ * commitLog). A table without a log flushed its buffer pool instead. The
+ * partitions of a partitioned table shared its log, so one commit record
+ * covered them all. In-memory tables had nothing to make durable.
+ */
+RC commitTable(RM_TableData *rel)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    RC rc;
+    for (int i = 0; tblData->partSet != NULL && i < tblData->partSet->numParts; i++)
+    {
+        RM_TableData *table = tblData->partSet->tables[i];
+        rc = writeTableInfo(table);
+        if (rc == RC_OK && tblData->log == NULL)
+            rc = flushTable((RM_TableMgmtData *) table->mgmtData);
+        if (rc != RC_OK) return rc;
+    }
+
+    rc = writeTableInfo(rel);
+    if (rc != RC_OK) return rc;
+
+    if (tblData->log == NULL)
+        return flushTable(tblData);
+    return commitLog(tblData->log, NULL);
+}
+
+/* --------------------------------------------------------------------------
+   Record-level operations
+   -------------------------------------------------------------------------- */
+
+/*
+ * insertRecord
+ * ------------
+ * Inserted a new record into the table. Encoded it into its variable-length
+ * stored form, put it on the current insert target page (or a new page if that
+ * was full), assigned record->id and incremented numTuples. PAX tables
+ * scattered the record into the minipages of a free slot instead. Finally
+ * the new record was added to every index. An empty version was saved for the
+ * new RID, so snapshots taken before the insert did not see the record (it
+ * was dropped again at once if no snapshot was open). Threads inserting at
+ * once each filled their own target page. Partitioned
+ * tables passed the record on to the partition of its key.
+ */
+RC insertRecord(RM_TableData *rel, Record *record)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    char stored[RM_MAX_STORED_RECORD];
+    int len;
+    RC rc;
+
+    if (tblData->partSet != NULL)
+        return partitionInsert(rel, record);
+
+    RM_Timestamp ts = rmWriteTimestamp();
+    if (tblData->layout == RM_LAYOUT_PAX)
+        rc = paxInsert(rel, record, &ts);
+    else
+    {
+        rc = encodeRecord(rel, record->data, RM_REC_NORMAL, NULL, stored, &len);
+        if (rc == RC_OK && (rc = placeRecord(tblData, stored, len, &record->id, &ts)) != RC_OK)
+            freeStoredToast(tblData, stored);
+    }
+
+    if (rc == RC_OK)
+    {
+        rmZoneAdd(&tblData->zoneMap, rel->schema, record->id.page, record->data);
+        tblData->numTuples++;
+        rc = maintainIndexes(rel, record->id, NULL, record->data);
+    }
+    if (rmWriteDone(ts) && rc == RC_OK)
+        rmVersionDrop(&tblData->versions, record->id, ts);
+    return rc;
+}
+
+/*
+ * fillPage
+ * --------
+ * Put records from..numRecords-1 on a latched page until one did not fit, and
+ * returned how many went there. Row tables took the stored forms ('stored',
+ * record i ending at ends[i]), PAX tables the records themselves.
+ */
+static int
+fillPage(RM_TableData *rel, BM_PageHandle *page, char *recData, char *stored, int *ends,
+         int from, int numRecords, RID *ids, RM_Timestamp *versionTs)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    int i;
+
+    for (i = from; i < numRecords; i++)
+    {
+        int slot;
+        if (tblData->layout == RM_LAYOUT_PAX)
+            slot = rmPaxInsert(page->data, rel->schema, tblData->paxColStart,
+                               recData + (size_t) i * tblData->recordSize);
+        else
+        {
+            int start = (i > 0) ? ends[i - 1] : 0;
+            slot = rmPageInsert(page->data, stored + start, ends[i] - start);
+        }
+        if (slot < 0)
+            break;
+        ids[i].page = page->pageNum;
+        ids[i].slot = slot;
+        if (versionTs != NULL)
+            rmVersionAdd(&tblData->versions, ids[i], *versionTs, NULL);
+    }
+    return i - from;
+}
+
+/*
+ * insertRecords
+ * -------------
+ * Inserted numRecords records, given back to back in recData (recordSize bytes
+ * each), in order, and set ids[i] to the RID of record i if ids was not NULL.
+ * Unlike one insertRecord per record, every page was latched once: the records
+ * were encoded (and their long strings toasted) first, then the insert target
+ * was filled, and then new pages one after the other. The indexes were changed
+ * under one hold of indexLatch. The records placed before an error stayed;
+ * the overflow chains of the others were freed.
+ */
+RC insertRecords(RM_TableData *rel, char *recData, int numRecords, RID *ids)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    if (tblData->partSet != NULL)
+        return partitionInsertRecords(rel, recData, numRecords, ids);
+
+    char *stored = NULL;
+    int *ends = NULL;
+    RID *rids = (ids != NULL) ? ids : (RID *) malloc((numRecords > 0 ? numRecords : 1) * sizeof(RID));
+    int done = 0, encoded = 0;
+    RC rc = RC_OK;
+
+    // Row tables: the stored forms, before any page was latched
+    if (tblData->layout == RM_LAYOUT_ROW && numRecords > 0)
+    {
+        char one[RM_MAX_STORED_RECORD];
+        int used = 0, cap = numRecords * (RM_MIN_STORED_RECORD + tblData->fixedSize);
+        stored = (char *) malloc(cap);
+        ends   = (int *) malloc(numRecords * sizeof(int));
+        for (int i = 0; i < numRecords && rc == RC_OK; i++)
+        {
+            int len;
+            rc = encodeRecord(rel, recData + (size_t) i * tblData->recordSize, RM_REC_NORMAL, NULL, one, &len);
+            if (rc != RC_OK)
+                break;
+            if (used + len > cap)
+            {
+                cap = 2 * cap + len;
+                stored = (char *) realloc(stored, cap);
+            }
+            memcpy(stored + used, one, len);
+            used += len;
+            ends[i] = used;
+            encoded++;
+        }
+    }
+
+    RM_Timestamp ts = rmWriteTimestamp();
+    int *target = insertTarget(tblData);
+    int pageType = (tblData->layout == RM_LAYOUT_PAX) ? RM_PAGE_PAX : RM_PAGE_HEAP;
+
+    pthread_mutex_lock(&tblData->spaceLatch);
+    int pageNum = *target;
+    pthread_mutex_unlock(&tblData->spaceLatch);
+
+    while (rc == RC_OK && done < numRecords)
+    {
+        BM_PageHandle page;
+        bool fresh = (pageNum <= 0);
+        if (fresh && (rc = allocPage(tblData, &pageNum)) != RC_OK)
+            break;
+        if ((rc = latchPage(tblData, &page, pageNum, true)) != RC_OK)
+            break;
+
+        if (fresh && pageType == RM_PAGE_PAX)
+            rmPaxInit(page.data, tblData->paxCapacity);
+        else if (fresh)
+            rmInitPage(page.data, RM_PAGE_HEAP);
+
+        int placed = 0;
+        if (RM_PAGE_HDR(page.data)->pageType == pageType)
+            placed = fillPage(rel, &page, recData, stored, ends, done, numRecords, rids, &ts);
+        if (placed > 0)
+            dirtyPage(tblData, &page);
+        unlatchPage(tblData, &page);
+        done += placed;
+
+        // The page was full (or not ours any more), so the next one was new
+        pthread_mutex_lock(&tblData->spaceLatch);
+        *target = (done < numRecords) ? -1 : pageNum;
+        pthread_mutex_unlock(&tblData->spaceLatch);
+        if (done < numRecords)
+        {
+            if (fresh && placed == 0)
+                rc = RC_RM_RECORD_TOO_LARGE;
+            pageNum = -1;
+        }
+    }
+    for (int i = done; i < encoded; i++)
+        freeStoredToast(tblData, stored + ((i > 0) ? ends[i - 1] : 0));
+
+    for (int i = 0; i < done; i++)
+        rmZoneAdd(&tblData->zoneMap, rel->schema, rids[i].page, recData + (size_t) i * tblData->recordSize);
+    tblData->numTuples += done;
+
+    if (tblData->numIndexes > 0 && done > 0)
+    {
+        pthread_mutex_lock(&tblData->indexLatch);
+        for (int i = 0; i < done; i++)
+        {
+            RC irc = changeIndexes(rel, rids[i], NULL, recData + (size_t) i * tblData->recordSize);
+            if (irc != RC_OK && rc == RC_OK)
+                rc = irc;
+        }
+        pthread_mutex_unlock(&tblData->indexLatch);
+    }
+    if (rmWriteDone(ts))
+        for (int i = 0; i < done; i++)
+            rmVersionDrop(&tblData->versions, rids[i], ts);
+
+    if (rids != ids)
+        free(rids);
+    free(stored);
+    free(ends);
+    return rc;
+}
+
+/*
+ * removeRecord
+ * ------------
+ * Freed a slot (and the slot of its moved body, if the record had been
+ * forwarded), released its overflow pages and decreased numTuples.
+ */
+static RC
+removeRecord(RM_TableData *rel, RID id)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    BM_PageHandle page;
+
+    if (tblData->layout == RM_LAYOUT_PAX)
+    {
+        RC rc = paxAccess(rel, id, NULL, 'd');
+        return (rc == RC_RM_NO_MORE_TUPLES) ? RC_OK : rc;
+    }
+
+    RC rc = latchPage(tblData, &page, id.page, false);
+    if (rc != RC_OK) return rc;
+
+    char *stored = rmPageRecord(page.data, id.slot, NULL);
+    int flag = (stored != NULL) ? stored[0] : -1;
+    RID target = (flag == RM_REC_FORWARD) ? readForward(stored) : id;
+    unlatchPage(tblData, &page);
+
+    // if the slot was free (or only held a moved body), there was nothing to delete
+    if (flag != RM_REC_NORMAL && flag != RM_REC_FORWARD)
+        return RC_OK;
+
+    if (flag == RM_REC_FORWARD)
+    {
+        rc = removeStored(tblData, target);
+        if (rc != RC_OK) return rc;
+    }
+    rc = removeStored(tblData, id);
+    if (rc != RC_OK) return rc;
+
+    tblData->numTuples--;
+    return RC_OK;
+}
+
+/*
+ * rewriteRecord
+ * -------------
+ * Overwrote an existing record. If the new version no longer fit on its page,
+ * it moved to another page and the original slot became a forward stub, so
+ * the RID of the record stayed the same. Until the home slot pointed at the
+ * new body, a failure left the old one in place and freed the new overflow
+ * chains.
+ */
+static RC
+rewriteRecord(RM_TableData *rel, Record *record)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    BM_PageHandle page;
+    RID home = record->id;
+    char stored[RM_MAX_STORED_RECORD];
+    char oldCopy[RM_MAX_STORED_RECORD];
+    int len, oldLen;
+    int toastPages[tblData->numStrings > 0 ? tblData->numStrings : 1];
+    int numToast;
+
+    if (tblData->layout == RM_LAYOUT_PAX)
+    {
+        RC rc = paxAccess(rel, home, record, 'u');
+        return (rc == RC_RM_NO_MORE_TUPLES) ? RC_READ_NON_EXISTING_PAGE : rc;
+    }
+
+    RC rc = latchPage(tblData, &page, home.page, false);
+    if (rc != RC_OK) return rc;
+
+    // if slot was free => cannot update
+    char *old = rmPageRecord(page.data, home.slot, &oldLen);
+    if (old == NULL || old[0] == RM_REC_MOVED)
+    {
+        unlatchPage(tblData, &page);
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    memcpy(oldCopy, old, oldLen);
+    unlatchPage(tblData, &page);
+
+    // The body currently lived either in the home slot or behind a forward
+    RID where = (oldCopy[0] == RM_REC_FORWARD) ? readForward(oldCopy) : home;
+    int flag  = (oldCopy[0] == RM_REC_FORWARD) ? RM_REC_MOVED : RM_REC_NORMAL;
+
+    if (oldCopy[0] == RM_REC_FORWARD)
+    {
+        rc = latchPage(tblData, &page, where.page, false);
+        if (rc != RC_OK) return rc;
+        old = rmPageRecord(page.data, where.slot, &oldLen);
+        memcpy(oldCopy, old, oldLen);
+        unlatchPage(tblData, &page);
+    }
+    numToast = collectToast(tblData, oldCopy, toastPages);
+
+    rc = encodeRecord(rel, record->data, flag, &home, stored, &len);
+    if (rc != RC_OK) return rc;
+
+    // First choice: rewrite the body where it was
+    rc = latchPage(tblData, &page, where.page, true);
+    if (rc != RC_OK)
+    {
+        freeStoredToast(tblData, stored);
+        return rc;
+    }
+    RC fit = rmPageReplace(page.data, where.slot, stored, len);
+    if (fit == RC_OK)
+    {
+        rmZoneAdd(&tblData->zoneMap, rel->schema, where.page, record->data);
+        dirtyPage(tblData, &page);
+    }
+    unlatchPage(tblData, &page);
+
+    // The home page's range covered its moved records too (for snapshot scans)
+    if (fit != RC_OK || where.page != home.page)
+        rmZoneAdd(&tblData->zoneMap, rel->schema, home.page, record->data);
+
+    if (fit != RC_OK)
+    {
+        // Moved the body to another page
+        RID target;
+        if (flag == RM_REC_NORMAL && len + (int) sizeof(RID) <= RM_MAX_STORED_RECORD)
+        {
+            // Turned the body into a moved one by making room for the home RID
+            memmove(stored + 1 + sizeof(RID), stored + 1, len - 1);
+            stored[0] = RM_REC_MOVED;
+            memcpy(stored + 1, &home, sizeof(RID));
+            len += sizeof(RID);
+        }
+        else if (flag == RM_REC_NORMAL)
+        {
+            // No room for the extra header: encoded again, dropping the first toast chains
+            rc = freeStoredToast(tblData, stored);
+            if (rc != RC_OK) return rc;
+            rc = encodeRecord(rel, record->data, RM_REC_MOVED, &home, stored, &len);
+            if (rc != RC_OK) return rc;
+        }
+        rc = placeRecord(tblData, stored, len, &target, NULL);
+        if (rc != RC_OK)
+        {
+            freeStoredToast(tblData, stored);
+            return rc;
+        }
+        rmZoneAdd(&tblData->zoneMap, rel->schema, target.page, record->data);
+
+        // Pointed the home slot at the new place (stubs always fit in place)
+        char stub[RM_MIN_STORED_RECORD];
+        stub[0] = RM_REC_FORWARD;
+        memcpy(stub + 1, &target, sizeof(RID));
+        rc = latchPage(tblData, &page, home.page, true);
+        if (rc != RC_OK)
+        {
+            // The new body came off again, so the record kept its old one
+            if (latchPage(tblData, &page, target.page, true) == RC_OK)
+            {
+                rmPageDelete(page.data, target.slot);
+                dirtyPage(tblData, &page);
+                unlatchPage(tblData, &page);
+                freeStoredToast(tblData, stored);
+            }
+            return rc;
+        }
+        rmPageReplace(page.data, home.slot, stub, RM_MIN_STORED_RECORD);
+        dirtyPage(tblData, &page);
+        unlatchPage(tblData, &page);
+
+        // A previously moved body was deleted from its old place
+        if (flag == RM_REC_MOVED)
+        {
+            rc = latchPage(tblData, &page, where.page, true);
+            if (rc != RC_OK) return rc;
+            rmPageDelete(page.data, where.slot);
+            clearZoneIfEmpty(tblData, page.data, where.page);
+            dirtyPage(tblData, &page);
+            unlatchPage(tblData, &page);
+        }
+    }
+
+    return freeToast(tblData, toastPages, numToast);
+}
+
+/*
+ * latchStored
+ * -----------
+ * Found the stored body of a record of a row table: in its home slot, or
+ * where the forward stub there pointed. Returned with the page of the body
+ * latched (shared) and *stored pointing at it on the page; a body that
+ * another thread moved in the meantime was looked up again from the home slot.
+ */
+static RC
+latchStored(RM_TableMgmtData *tblData, RID id, BM_PageHandle *page, char **stored, int *len)
+{
+    RID at = id;
+    for (;;)
+    {
+        RC rc = latchPage(tblData, page, at.page, false);
+        if (rc != RC_OK) return rc;
+
+        // check usage: the home slot held a record or a stub, a body named its home
+        char *found = rmPageRecord(page->data, at.slot, len);
+        bool home = (at.page == id.page && at.slot == id.slot);
+        if (home && found != NULL && found[0] == RM_REC_MOVED)
+            found = NULL;
+        if (!home && found != NULL)
+        {
+            RID back = readForward(found);
+            if (found[0] != RM_REC_MOVED || back.page != id.page || back.slot != id.slot)
+                found = NULL;
+        }
+
+        if (found != NULL && found[0] != RM_REC_FORWARD)
+        {
+            *stored = found;
+            return RC_OK;
+        }
+        RID next = (found != NULL) ? readForward(found) : id;
+        unlatchPage(tblData, page);
+
+        if (found == NULL && home)
+            return RC_RM_NO_MORE_TUPLES;
+        at = next;
+    }
+}
+
+/*
+ * fetchRecord
+ * -----------
+ * Did the work of getRecord with the record latch of the RID held. The stored
+ * record was copied out and decoded once its page was released.
+ */
+static RC
+fetchRecord(RM_TableData *rel, RID id, Record *record)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    BM_PageHandle page;
+    char copy[RM_MAX_STORED_RECORD];
+    char *stored;
+    int len;
+
+    if (tblData->layout == RM_LAYOUT_PAX)
+        return paxAccess(rel, id, record, 'r');
+
+    RC rc = latchStored(tblData, id, &page, &stored, &len);
+    if (rc != RC_OK) return rc;
+    memcpy(copy, stored, len);
+    unlatchPage(tblData, &page);
+
+    record->id.page = id.page;
+    record->id.slot = id.slot;
+    return decodeRecord(rel, copy, record->data, NULL);
+}
+
+/*
+ * deleteRecordAt
+ * --------------
+ * Did the work of deleteRecord for a write stamped 'ts', with the record
+ * latch of the RID held.
+ */
+static RC
+deleteRecordAt(RM_TableData *rel, RID id, RM_Timestamp ts)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    char oldData[tblData->recordSize];
+    Record old;
+    old.data = oldData;
+    if (fetchRecord(rel, id, &old) != RC_OK)
+        return removeRecord(rel, id);
+    rmVersionAdd(&tblData->versions, id, ts, oldData);
+
+    RC rc = removeRecord(rel, id);
+    if (rc == RC_OK && tblData->numBlobs > 0)
+        rc = freeBlobs(rel, oldData, NULL);
+    if (rc != RC_OK) return rc;
+    return maintainIndexes(rel, id, oldData, NULL);
+}
+
+/*
+ * deleteRecord
+ * ------------
+ * Deleted a record and, if the table had indexes, removed its entries from
+ * them (the old values were read back first), and freed its large objects.
+ * The deleted version was saved for snapshots (with the ids of its large
+ * objects, not their contents), and dropped again if none was open. Updates
+ * and deletes of the same RID by different threads took turns (see
+ * recordLatch), and were stamped in that order.
+ */
+RC deleteRecord(RM_TableData *rel, RID id)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    if (tblData->partSet != NULL)
+    {
+        RID local;
+        RM_TableData *table = partitionOfRid(tblData->partSet, id, &local);
+        return (table != NULL) ? deleteRecord(table, local) : RC_RM_NO_MORE_TUPLES;
+    }
+
+    pthread_mutex_t *latch = recordLatch(tblData, id);
+    pthread_mutex_lock(latch);
+    RM_Timestamp ts = rmWriteTimestamp();
+    RC rc = deleteRecordAt(rel, id, ts);
+    if (rmWriteDone(ts))
+        rmVersionDrop(&tblData->versions, id, ts);
+    pthread_mutex_unlock(latch);
+    return rc;
+}
+
+/*
+ * updateRecordAt
+ * --------------
+ * Did the work of updateRecord for a write stamped 'ts', with the record
+ * latch of the RID held.
+ */
+static RC
+updateRecordAt(RM_TableData *rel, Record *record, RM_Timestamp ts)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    char oldData[tblData->recordSize];
+    Record old;
+    old.data = oldData;
+    RC rc = fetchRecord(rel, record->id, &old);
+    if (rc != RC_OK)
+        return rewriteRecord(rel, record);
+    rmVersionAdd(&tblData->versions, record->id, ts, oldData);
+
+    rc = rewriteRecord(rel, record);
+    if (rc == RC_OK && tblData->numBlobs > 0)
+        rc = freeBlobs(rel, oldData, record->data);
+    if (rc != RC_OK) return rc;
+    return maintainIndexes(rel, record->id, oldData, record->data);
+}
+
+/*
+ * updateRecord
+ * ------------
+ * Overwrote an existing record (see rewriteRecord) and moved its index entries
+ * for every indexed attribute whose value changed, and freed the large objects
+ * the record no longer held. The version it replaced was saved for snapshots
+ * first (see deleteRecord). A record of a partitioned
+ * table could not change partitions (RC_RM_BAD_PARTITION): it had to be
+ * deleted and inserted again.
+ */
+RC updateRecord(RM_TableData *rel, Record *record)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    if (tblData->partSet != NULL)
+    {
+        RID id = record->id, local;
+        RM_TableData *table = partitionOfRid(tblData->partSet, id, &local);
+        if (table == NULL)
+            return RC_RM_NO_MORE_TUPLES;
+        int pos = partitionOf(rel, record->data);
+        if (pos < 0 || tblData->partSet->tables[pos] != table)
+            return RC_RM_BAD_PARTITION;
+        record->id = local;
+        RC rc = updateRecord(table, record);
+        record->id = id;
+        return rc;
+    }
+
+    pthread_mutex_t *latch = recordLatch(tblData, record->id);
+    pthread_mutex_lock(latch);
+    RM_Timestamp ts = rmWriteTimestamp();
+    RC rc = updateRecordAt(rel, record, ts);
+    if (rmWriteDone(ts))
+        rmVersionDrop(&tblData->versions, record->id, ts);
+    pthread_mutex_unlock(latch);
+    return rc;
+}
+
+/*
+ * getRecord
+ * ---------
+ * Decoded the stored record into record->data, following a forward stub if the
+ * record had moved; if the slot was free, returned RC_RM_NO_MORE_TUPLES.
+ * PAX tables gathered the record from the minipages of its slot. The record
+ * latch kept an update from freeing its toasted strings while they were read.
+ */
+RC getRecord(RM_TableData *rel, RID id, Record *record)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    if (tblData->partSet != NULL)
+    {
+        RID local;
+        RM_TableData *table = partitionOfRid(tblData->partSet, id, &local);
+        RC rc = (table != NULL) ? getRecord(table, local, record) : RC_RM_NO_MORE_TUPLES;
+        record->id = id;
+        return rc;
+    }
+
+    pthread_mutex_t *latch = recordLatch(tblData, id);
+    pthread_mutex_lock(latch);
+    RC rc = fetchRecord(rel, id, record);
+    pthread_mutex_unlock(latch);
+    return rc;
+}
+
+/* --------------------------------------------------------------------------
+   Snapshots
+   -------------------------------------------------------------------------- */
+
+/*
+ * beginSnapshot
+ * -------------
+ * Opened a snapshot of every table as of the last write. Reads through it took
+ * no locks and never waited for writers; writers kept the versions it saw
+ * until endSnapshot.
+ */
+RC beginSnapshot(RM_Snapshot *snapshot)
+{
+    snapshot->readTs = rmSnapshotBegin();
+    return RC_OK;
+}
+
+/*
+ * endSnapshot
+ * -----------
+ * Closed a snapshot. The versions only it had needed were dropped by the
+ * collector in the background.
+ */
+RC endSnapshot(RM_Snapshot *snapshot)
+{
+    rmSnapshotEnd(snapshot->readTs);
+    return RC_OK;
+}
+
+/*
+ * getRecordAsOf
+ * -------------
+ * Read a record as the snapshot saw it: an older version from the version
+ * store if the record had changed since, otherwise the one on the page.
+ * Returned RC_RM_NO_MORE_TUPLES if the record did not exist in the snapshot.
+ * A version the store already held was returned without touching the page.
+ * Otherwise the page was read and the store asked again: writers saved the
+ * old version before changing the page, so a change seen there was always
+ * found in the version store after.
+ */
+RC getRecordAsOf(RM_TableData *rel, RID id, Record *record, RM_Snapshot *snapshot)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    if (tblData->partSet != NULL)
+    {
+        RID local;
+        RM_TableData *table = partitionOfRid(tblData->partSet, id, &local);
+        RC rc = (table != NULL) ? getRecordAsOf(table, local, record, snapshot) : RC_RM_NO_MORE_TUPLES;
+        record->id = id;
+        return rc;
+    }
+
+    RC rc = RC_OK;
+    int found = rmVersionGet(&tblData->versions, id, snapshot->readTs, record->data);
+    if (found == RM_VERSION_CURRENT)
+    {
+        rc = getRecord(rel, id, record);
+        found = rmVersionGet(&tblData->versions, id, snapshot->readTs, record->data);
+    }
+
+    switch (found)
+    {
+        case RM_VERSION_OLD:
+            record->id = id;
+            return RC_OK;
+        case RM_VERSION_NONE:
+            return RC_RM_NO_MORE_TUPLES;
+        default:
+            return rc;
+    }
+}
+
+/*
+ * clearView
+ * ---------
+ * Set up a view of a record of 'rel' that pointed at nothing yet.
+ */
+static void
+clearView(RM_RecordView *view, RM_TableData *rel)
+{
+    view->rel     = rel;
+    view->stored  = NULL;
+    view->paxSlot = -1;
+    view->data    = NULL;
+    view->pinned  = false;
+}
+
+/*
+ * getRecordView
+ * -------------
+ * Like getRecord, but copied nothing: the view pointed at the record where it
+ * lay on its page, which stayed pinned and latched (shared) until
+ * releaseRecordView, so nobody changed it in the meantime. The attributes were
+ * read in place with getViewInt, getViewFloat and getViewString. A view was
+ * meant to be released soon, and the thread holding it could not change the
+ * table before it did. A record of a partitioned table was viewed in its
+ * partition (view->rel).
+ */
+RC getRecordView(RM_TableData *rel, RID id, RM_RecordView *view)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    if (tblData->partSet != NULL)
+    {
+        RID local;
+        RM_TableData *table = partitionOfRid(tblData->partSet, id, &local);
+        RC rc = (table != NULL) ? getRecordView(table, local, view) : RC_RM_NO_MORE_TUPLES;
+        view->id = id;
+        return rc;
+    }
+
+    clearView(view, rel);
+    view->id = id;
+    if (tblData->layout == RM_LAYOUT_PAX)
+    {
+        RC rc = latchPage(tblData, &view->page, id.page, false);
+        if (rc != RC_OK) return rc;
+        if (!paxSlotUsed(view->page.data, id.slot))
+        {
+            unlatchPage(tblData, &view->page);
+            return RC_RM_NO_MORE_TUPLES;
+        }
+        view->paxSlot = id.slot;
+    }
+    else
+    {
+        int len;
+        RC rc = latchStored(tblData, id, &view->page, &view->stored, &len);
+        if (rc != RC_OK) return rc;
+    }
+    view->pinned = true;
+    return RC_OK;
+}
+
+/*
+ * releaseRecordView
+ * -----------------
+ * Unpinned and unlatched the page of a view. Releasing a view that held no
+ * page (a snapshot scan's, or one released already) did nothing.
+ */
+RC releaseRecordView(RM_RecordView *view)
+{
+    if (!view->pinned)
+        return RC_OK;
+    view->pinned = false;
+    return unlatchPage((RM_TableMgmtData *) view->rel->mgmtData, &view->page);
+}
+
+/*
+ * getNumVersions
+ * --------------
+ * Returned how many old record versions the table kept for open snapshots.
+ */
+int getNumVersions(RM_TableData *rel)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    if (tblData->partSet != NULL)
+    {
+        int total = 0;
+        for (int i = 0; i < tblData->partSet->numParts; i++)
+            total += getNumVersions(tblData->partSet->tables[i]);
+        return total;
+    }
+    return rmVersionCount(&tblData->versions);
+}
+
+/* --------------------------------------------------------------------------
+   Vacuum
+   -------------------------------------------------------------------------- */
+
+/*
+ * rebuildFreeChain
+ * ----------------
+ * Chained every free, never formatted or emptied page below 'limit' in
+ * ascending order, so the pages nearest to the start of the file were handed
+ * out first. Pages at or past 'limit' were left out of the chain.
+ */
+static RC
+rebuildFreeChain(RM_TableMgmtData *tblData, int limit)
+{
+    BM_PageHandle page;
+
+    tblData->freePageHead = -1;
+    for (int p = limit - 1; p >= 1; p--)
+    {
+        RC rc = latchPage(tblData, &page, p, true);
+        if (rc != RC_OK) return rc;
+
+        RM_PageHeader *hdr = RM_PAGE_HDR(page.data);
+        bool emptyData = (hdr->pageType == RM_PAGE_HEAP || hdr->pageType == RM_PAGE_PAX)
+                         && hdr->slotsUsed == 0;
+        if (hdr->pageType == RM_PAGE_FREE || hdr->pageType == RM_PAGE_UNUSED || emptyData)
+        {
+            rmInitPage(page.data, RM_PAGE_FREE);
+            RM_PAGE_HDR(page.data)->nextPage = tblData->freePageHead;
+            tblData->freePageHead = p;
+            rmZoneClear(&tblData->zoneMap, p);
+            dirtyPage(tblData, &page);
+        }
+        unlatchPage(tblData, &page);
+    }
+    return RC_OK;
+}
+
+/*
+ * vacuumPlace
+ * -----------
+ * Put a record that was moved off page 'hi' on the first page from *lo on
+ * that took it: the stored form on heap pages, recData on PAX pages. Free
+ * pages were formatted on the way (they were reached in chain order), and
+ * pages that were too full were passed over for good. Left rid->page at -1
+ * once *lo reached 'hi'.
+ */
+static RC
+vacuumPlace(RM_TableData *rel, int *lo, int hi, char *stored, int len, char *recData, RID *rid)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    BM_PageHandle page;
+
+    rid->page = -1;
+    for (; *lo < hi; (*lo)++)
+    {
+        RC rc = latchPage(tblData, &page, *lo, true);
+        if (rc != RC_OK) return rc;
+
+        RM_PageHeader *hdr = RM_PAGE_HDR(page.data);
+        if (hdr->pageType == RM_PAGE_FREE && *lo == tblData->freePageHead)
+        {
+            tblData->freePageHead = hdr->nextPage;
+            if (tblData->layout == RM_LAYOUT_PAX)
+                rmPaxInit(page.data, tblData->paxCapacity);
+            else
+                rmInitPage(page.data, RM_PAGE_HEAP);
+            dirtyPage(tblData, &page);
+        }
+
+        int slot = -1;
+        if (hdr->pageType == RM_PAGE_PAX && tblData->layout == RM_LAYOUT_PAX)
+            slot = rmPaxInsert(page.data, rel->schema, tblData->paxColStart, recData);
+        else if (hdr->pageType == RM_PAGE_HEAP && tblData->layout != RM_LAYOUT_PAX)
+            slot = rmPageInsert(page.data, stored, len);
+
+        if (slot >= 0)
+        {
+            rid->page = *lo;
+            rid->slot = slot;
+            dirtyPage(tblData, &page);
+            unlatchPage(tblData, &page);
+            return RC_OK;
+        }
+        unlatchPage(tblData, &page);
+    }
+    return RC_OK;
+}
+
+/*
+ * vacuumDelete
+ * ------------
+ * Dropped the old copy of a moved record. Unlike removeStored, its overflow
+ * chains were kept, since the new copy still pointed at them.
+ */
+static RC
+vacuumDelete(RM_TableMgmtData *tblData, RID id)
+{
+    BM_PageHandle page;
+    RC rc = latchPage(tblData, &page, id.page, true);
+    if (rc != RC_OK) return rc;
+
+    if (tblData->layout == RM_LAYOUT_PAX)
+        rmPaxDelete(page.data, id.slot);
+    else
+        rmPageDelete(page.data, id.slot);
+    clearZoneIfEmpty(tblData, page.data, id.page);
+    dirtyPage(tblData, &page);
+    unlatchPage(tblData, &page);
+    return RC_OK;
+}
+
+/*
+ * vacuumMove
+ * ----------
+ * Moved whatever one slot of page 'hi' held to an earlier page:
+ *  - a normal record (or a PAX one) got a new RID, and its index entries moved;
+ *  - a forward stub brought its moved body home as a normal record at the new
+ *    place, which also got a new RID;
+ *  - a moved body kept its home RID; only the stub pointing at it changed.
+ */
+static RC
+vacuumMove(RM_TableData *rel, RID from, int *lo, int hi)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    char recData[tblData->recordSize];
+    char stored[RM_MAX_STORED_RECORD];
+    BM_PageHandle page;
+    RID to, body = from;
+    int len = 0;
+    int flag = RM_REC_NORMAL;
+
+    RC rc = latchPage(tblData, &page, from.page, true);
+    if (rc != RC_OK) return rc;
+
+    if (tblData->layout == RM_LAYOUT_PAX)
+    {
+        bool used = paxSlotUsed(page.data, from.slot);
+        for (int i = 0; used && i < rel->schema->numAttr; i++)
+            rmPaxRead(page.data, rel->schema, tblData->paxColStart, from.slot, i, recData);
+        unlatchPage(tblData, &page);
+        if (!used)
+            return RC_OK;
+    }
+    else
+    {
+        char *old = rmPageRecord(page.data, from.slot, &len);
+        if (old != NULL)
+        {
+            memcpy(stored, old, len);
+            flag = old[0];
+        }
+        unlatchPage(tblData, &page);
+        if (old == NULL)
+            return RC_OK;
+
+        if (flag == RM_REC_FORWARD)
+        {
+            // Fetched the body and dropped its home RID
+            body = readForward(stored);
+            rc = latchPage(tblData, &page, body.page, true);
+            if (rc != RC_OK) return rc;
+            old = rmPageRecord(page.data, body.slot, &len);
+            len -= (int) sizeof(RID);
+            stored[0] = RM_REC_NORMAL;
+            memcpy(stored + 1, old + 1 + sizeof(RID), len - 1);
+            unlatchPage(tblData, &page);
+            if (len < RM_MIN_STORED_RECORD)
+            {
+                memset(stored + len, 0, RM_MIN_STORED_RECORD - len);
+                len = RM_MIN_STORED_RECORD;
+            }
+        }
+        rc = decodeRecord(rel, stored, recData, NULL);
+        if (rc != RC_OK) return rc;
+    }
+
+    rc = vacuumPlace(rel, lo, hi, stored, len, recData, &to);
+    if (rc != RC_OK || to.page < 0) return rc;
+    rmZoneAdd(&tblData->zoneMap, rel->schema, to.page, recData);
+
+    if (flag == RM_REC_MOVED)
+    {
+        // Pointed the home slot at the new place
+        RID home;
+        char stub[RM_MIN_STORED_RECORD];
+        memcpy(&home, stored + 1, sizeof(RID));
+        stub[0] = RM_REC_FORWARD;
+        memcpy(stub + 1, &to, sizeof(RID));
+        rc = latchPage(tblData, &page, home.page, true);
+        if (rc != RC_OK) return rc;
+        rmPageReplace(page.data, home.slot, stub, RM_MIN_STORED_RECORD);
+        dirtyPage(tblData, &page);
+        unlatchPage(tblData, &page);
+        return vacuumDelete(tblData, from);
+    }
+
+    if (flag == RM_REC_FORWARD)
+    {
+        rc = vacuumDelete(tblData, body);
+        if (rc != RC_OK) return rc;
+    }
+    rc = vacuumDelete(tblData, from);
+    if (rc != RC_OK) return rc;
+
+    rc = maintainIndexes(rel, from, recData, NULL);
+    if (rc != RC_OK) return rc;
+    return maintainIndexes(rel, to, NULL, recData);
+}
+
+/*
+ * shrinkTableFile
+ * ---------------
+ * Cut the page file back to tblData->numPages pages. The buffer pool was
+ * flushed and started again, so no frame kept a page that no longer existed.
+ * An in-memory table gave the chunks past them back instead.
+ */
+static RC
+shrinkTableFile(RM_TableData *rel)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    SM_FileHandle fHandle;
+    if (tblData->arena != NULL)
+    {
+        rmArenaTruncate(tblData->arena, tblData->numPages);
+        return RC_OK;
+    }
+
+    RC rc = shutdownBufferPool(&tblData->bufferPool);
+    if (rc != RC_OK) return rc;
+
+    // A logged truncation kept recovery from bringing the cut pages back
+    if (tblData->log != NULL)
+    {
+        LSN lsn;
+        rc = logFileTruncate(tblData->log, rel->name, tblData->numPages, &lsn);
+        if (rc == RC_OK)
+            rc = flushLog(tblData->log, lsn);
+        if (rc != RC_OK) return rc;
+    }
+
+    rc = openPageFile(rel->name, &fHandle);
+    if (rc != RC_OK) return rc;
+    if (fHandle.totalNumPages > tblData->numPages)
+        rc = truncatePageFile(tblData->numPages, &fHandle);
+    closePageFile(&fHandle);
+    if (rc != RC_OK) return rc;
+
+    rc = initBufferPool(&tblData->bufferPool, rel->name, RM_POOL_PAGES, RS_FIFO, NULL);
+    if (rc != RC_OK) return rc;
+    return setPoolLog(&tblData->bufferPool, tblData->log);
+}
+
+/*
+ * vacuumTable
+ * -----------
+ * Compacted a table after many deletes. Records were moved from the last pages
+ * into free room on the earliest ones until the two met, updating the indexes
+ * for every record that got a new RID. The empty pages at the end were then
+ * cut off the file, the free chain was rebuilt in page order and the insert
+ * target was reset. Overflow chains of long strings, large objects and
+ * dictionary pages were not moved, so such a page near the end kept the file
+ * from shrinking past it.
+ * Open scans of the table had to be closed first, and since records got new
+ * RIDs, vacuum returned RC_RM_SNAPSHOT_OPEN while any snapshot was open.
+ * Unlike the other operations it needed the table to itself: no other thread
+ * could use the table while it ran. Partitioned tables vacuumed every partition.
+ */
+RC vacuumTable(RM_TableData *rel)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) rel->mgmtData;
+    BM_PageHandle page;
+    int lo = 1;
+
+    if (rmSnapshotsOpen() > 0)
+        return RC_RM_SNAPSHOT_OPEN;
+    for (int i = 0; tblData->partSet != NULL && i < tblData->partSet->numParts; i++)
+    {
+        RC rc = vacuumTable(tblData->partSet->tables[i]);
+        if (rc != RC_OK) return rc;
+    }
+
+    RC rc = rebuildFreeChain(tblData, tblData->numPages);
+    if (rc != RC_OK) return rc;
+
+    for (int hi = tblData->numPages - 1; hi > lo; hi--)
+    {
+        rc = latchPage(tblData, &page, hi, true);
+        if (rc != RC_OK) return rc;
+        int type     = RM_PAGE_HDR(page.data)->pageType;
+        int numSlots = RM_PAGE_HDR(page.data)->numSlots;
+        unlatchPage(tblData, &page);
+
+        if (type != RM_PAGE_HEAP && type != RM_PAGE_PAX)
+            continue;
+        for (int slot = 0; slot < numSlots && lo < hi; slot++)
+        {
+            RID from;
+            from.page = hi;
+            from.slot = slot;
+            rc = vacuumMove(rel, from, &lo, hi);
+            if (rc != RC_OK) return rc;
+        }
+    }
+
+    // Kept everything up to the last page still in use
+    int last = 0;
+    for (int p = tblData->numPages - 1; p >= 1 && last == 0; p--)
+    {
+        rc = latchPage(tblData, &page, p, true);
+        if (rc != RC_OK) return rc;
+        RM_PageHeader *hdr = RM_PAGE_HDR(page.data);
+        if (hdr->pageType == RM_PAGE_OVERFLOW || hdr->pageType == RM_PAGE_DICT
+            || hdr->pageType == RM_PAGE_BLOB || hdr->pageType == RM_PAGE_BLOB_DIR
+            || ((hdr->pageType == RM_PAGE_HEAP || hdr->pageType == RM_PAGE_PAX) && hdr->slotsUsed > 0))
+            last = p;
+        unlatchPage(tblData, &page);
+    }
+
+    rc = rebuildFreeChain(tblData, last + 1);
+    if (rc != RC_OK) return rc;
+    for (int p = last + 1; p < tblData->numPages; p++)
+        rmZoneClear(&tblData->zoneMap, p);
+    tblData->numPages = last + 1;
+    tblData->nextFreePage = (lo <= last) ? lo : -1;
+    for (int i = 0; i < RM_INSERT_TARGETS; i++)
+        tblData->insertTargets[i] = -1;
+
+    rc = shrinkTableFile(rel);
+    if (rc != RC_OK) return rc;
+    return writeTableInfo(rel);
+}
+
+/* --------------------------------------------------------------------------
+   Statistics
+   -------------------------------------------------------------------------- */
+
+/*
+ * homeRids
+ * --------
+ * Listed the RIDs of the records whose home slot was on a page (a moved
+ * record counted on its home page, not where its body was), growing *rids as
+ * needed. Returned how many were found.
+ */
+static int
+homeRids(RM_TableMgmtData *tblData, int pageNum, RID **rids, int *cap)
+{
+    BM_PageHandle page;
+    if (latchPage(tblData, &page, pageNum, false) != RC_OK)
+        return 0;
+
+    RM_PageHeader *hdr = RM_PAGE_HDR(page.data);
+    int numSlots = (hdr->pageType == RM_PAGE_HEAP || hdr->pageType == RM_PAGE_PAX) ? hdr->numSlots : 0;
+    int n = 0;
+    if (numSlots > *cap)
+    {
+        *cap  = numSlots;
+        *rids = (RID *) realloc(*rids, numSlots * sizeof(RID));
+    }
+    for (int slot = 0; slot < numSlots; slot++)
+    {
+        bool home;
+        if (hdr->pageType == RM_PAGE_PAX)
+            home = paxSlotUsed(page.data, slot);
+        else
+        {
+            char *stored = rmPageRecord(page.data, slot, NULL);
+            home = (stored != NULL && stored[0] != RM_REC_MOVED);
+        }
+        if (home)
+        {
+            (*rids)[n].page = pageNum;
+            (*rids)[n].slot = slot;
+            n++;
+        }
+    }
+    unlatchPage(tblData, &page);
+    return n;
+}
+
+/*
+ * gatherStats
+ * -----------
+ * Gathered the statistics of every attribute (see rm_stats.h) from the
+ * records of up to maxPages data pages, spread evenly over the file; smaller
+ * tables were read in full. The new statistics replaced the old ones at once,
+ * so writers and scans could go on while the table was read.
+ */
+static void
+gatherStats(RM_TableData *rel, int maxPages)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    Schema *sc = rel->schema;
+    int dataPages  = tblData->numPages - 1;
+    int numSampled = (dataPages < maxPages) ? dataPages : maxPages;
+    int numTuples  = tblData->numTuples;
+
+    RM_AttrStats *attrs = (RM_AttrStats *) calloc(sc->numAttr > 0 ? sc->numAttr : 1, sizeof(RM_AttrStats));
+    double *keys[sc->numAttr > 0 ? sc->numAttr : 1];
+    int numKeys = 0, keyCap = 0, ridCap = 0;
+    RID *rids = NULL;
+    char recData[tblData->recordSize];
+    Record rec;
+    rec.data = recData;
+
+    for (int i = 0; i < sc->numAttr; i++)
+        keys[i] = NULL;
+
+    for (int s = 0; s < numSampled; s++)
+    {
+        int pageNum = 1 + (int) ((long long) s * dataPages / numSampled);
+        int n = homeRids(tblData, pageNum, &rids, &ridCap);
+        if (numKeys + n > keyCap)
+        {
+            keyCap = 2 * (numKeys + n);
+            for (int i = 0; i < sc->numAttr; i++)
+                keys[i] = (double *) realloc(keys[i], keyCap * sizeof(double));
+        }
+
+        // Records deleted since the page was listed were skipped
+        for (int r = 0; r < n; r++)
+        {
+            if (getRecord(rel, rids[r], &rec) != RC_OK)
+                continue;
+            for (int i = 0; i < sc->numAttr; i++)
+            {
+                char *raw = recData + sc->attrOffsets[i];
+                keys[i][numKeys] = rmStatsKey(sc->dataTypes[i], raw, attrSize(sc, i));
+                rmStatsAddSketch(&attrs[i], sc->dataTypes[i], raw, attrSize(sc, i));
+            }
+            numKeys++;
+        }
+    }
+
+    // A table read in full had exactly the tuples that were seen
+    if (numSampled == dataPages || numTuples < numKeys)
+        numTuples = numKeys;
+    for (int i = 0; i < sc->numAttr; i++)
+    {
+        rmStatsBuild(&attrs[i], keys[i], numKeys, numTuples);
+        free(keys[i]);
+    }
+    free(rids);
+
+    pthread_mutex_lock(&tblData->stats.lock);
+    free(tblData->stats.attrs);
+    tblData->stats.attrs         = attrs;
+    tblData->stats.analyzed      = 1;
+    tblData->stats.numTuples     = numTuples;
+    tblData->stats.sampledPages  = numSampled;
+    tblData->stats.sampledTuples = numKeys;
+    pthread_mutex_unlock(&tblData->stats.lock);
+}
+
+/*
+ * analyzeTable
+ * ------------
+ * Gathered the table's statistics and saved them on page 0. A partitioned
+ * table analyzed every partition instead; the partitions kept their own
+ * statistics.
+ */
+RC analyzeTable(RM_TableData *rel)
+{
+    RM_PartitionSet *ps = ((RM_TableMgmtData *) rel->mgmtData)->partSet;
+    if (ps != NULL)
+    {
+        for (int i = 0; i < ps->numParts; i++)
+        {
+            RC rc = analyzeTable(ps->tables[i]);
+            if (rc != RC_OK) return rc;
+        }
+        return RC_OK;
+    }
+
+    gatherStats(rel, RM_STATS_SAMPLE_PAGES);
+    return writeTableInfo(rel);
+}
+
+/*
+ * getAttrStats
+ * ------------
+ * Copied the statistics of one attribute. Returned RC_RM_NO_STATS if the
+ * attribute had not been analyzed, and always for partitioned tables, whose
+ * partitions' statistics could not be merged.
+ */
+RC getAttrStats(RM_TableData *rel, int attrNum, RM_AttrStats *stats)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    if (attrNum < 0 || attrNum >= rel->schema->numAttr)
+        return RC_RM_NO_SUCH_ATTR;
+    if (tblData->partSet != NULL)
+        return RC_RM_NO_STATS;
+
+    pthread_mutex_lock(&tblData->stats.lock);
+    *stats = tblData->stats.attrs[attrNum];
+    pthread_mutex_unlock(&tblData->stats.lock);
+    return stats->analyzed ? RC_OK : RC_RM_NO_STATS;
+}
+
+/*
+ * estimateSelectivity
+ * -------------------
+ * Estimated the fraction of the table's tuples that satisfied a term
+ * "attribute <op> constant". A constant of another type than the attribute,
+ * or an attribute that was not analyzed, got the default guesses. For a
+ * partitioned table, the estimates of the partitions were weighted by their
+ * numbers of tuples.
+ */
+double estimateSelectivity(RM_TableData *rel, AttrPredicate *pred)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    RM_AttrStats none;
+    none.analyzed = 0;
+
+    if (tblData->partSet != NULL && getNumTuples(rel) > 0)
+    {
+        double matched = 0;
+        for (int i = 0; i < tblData->partSet->numParts; i++)
+        {
+            RM_TableData *table = tblData->partSet->tables[i];
+            matched += estimateSelectivity(table, pred) * getNumTuples(table);
+        }
+        return matched / getNumTuples(rel);
+    }
+
+    if (pred->attrNum < 0 || pred->attrNum >= rel->schema->numAttr
+        || pred->cons->dt != rel->schema->dataTypes[pred->attrNum])
+        return rmStatsSelectivity(&none, pred->op, 0);
+
+    pthread_mutex_lock(&tblData->stats.lock);
+    double sel = rmStatsSelectivity(&tblData->stats.attrs[pred->attrNum], pred->op,
+                                    rmStatsValueKey(pred->cons));
+    pthread_mutex_unlock(&tblData->stats.lock);
+    return sel;
+}
+
+/* --------------------------------------------------------------------------
+   Access paths
+   -------------------------------------------------------------------------- */
+
+/*
+ * statsFresh
+ * ----------
+ * Decided whether a table's statistics could still be planned with: it had
+ * been analyzed, and its tuple count had not drifted more than
+ * RM_PLAN_STALE_FRACTION (and RM_PLAN_STALE_MIN tuples) since.
+ */
+static bool
+statsFresh(RM_TableData *rel)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    pthread_mutex_lock(&tblData->stats.lock);
+    int analyzed = tblData->stats.analyzed;
+    int drift = tblData->numTuples - tblData->stats.numTuples;
+    int limit = (int) (RM_PLAN_STALE_FRACTION * tblData->stats.numTuples);
+    pthread_mutex_unlock(&tblData->stats.lock);
+
+    if (drift < 0)
+        drift = -drift;
+    return analyzed && (drift <= limit || drift <= RM_PLAN_STALE_MIN);
+}
+
+/*
+ * attrSelectivity
+ * ---------------
+ * Estimated the fraction of tuples that satisfied the terms on one attribute:
+ * its first equality term if it had one, otherwise its first lower and upper
+ * bound together. With 'range' set, also filled in that key range (index left
+ * to the caller). Returned 1 if no term applied.
+ */
+static double
+attrSelectivity(RM_TableData *rel, AttrPredicate *preds, int numPreds, int attr, RM_IndexRange *range)
+{
+    Schema *sc = rel->schema;
+    int eq = -1, low = -1, high = -1;
+
+    for (int p = 0; p < numPreds; p++)
+    {
+        if (preds[p].attrNum != attr || preds[p].cons->dt != sc->dataTypes[attr])
+            continue;
+        if (preds[p].op == COMP_EQ && eq < 0)
+            eq = p;
+        else if ((preds[p].op == COMP_GT || preds[p].op == COMP_GE) && low < 0)
+            low = p;
+        else if ((preds[p].op == COMP_LT || preds[p].op == COMP_LE) && high < 0)
+            high = p;
+    }
+    if (eq >= 0)
+        low = high = -1;
+
+    double sel = 1;
+    if (eq >= 0)
+        sel = estimateSelectivity(rel, &preds[eq]);
+    else if (low >= 0 && high >= 0)
+        sel = estimateSelectivity(rel, &preds[low]) + estimateSelectivity(rel, &preds[high]) - 1;
+    else if (low >= 0)
+        sel = estimateSelectivity(rel, &preds[low]);
+    else if (high >= 0)
+        sel = estimateSelectivity(rel, &preds[high]);
+    if (sel < 0)
+        sel = 0;
+
+    if (range != NULL)
+    {
+        range->low  = (eq >= 0) ? preds[eq].cons : (low >= 0) ? preds[low].cons : NULL;
+        range->high = (eq >= 0) ? preds[eq].cons : (high >= 0) ? preds[high].cons : NULL;
+        range->lowInc  = (eq >= 0 || (low >= 0 && preds[low].op == COMP_GE));
+        range->highInc = (eq >= 0 || (high >= 0 && preds[high].op == COMP_LE));
+        range->sel = sel;
+    }
+    return sel;
+}
+
+/*
+ * pagesFetched
+ * ------------
+ * Estimated how many of 'pages' pages held at least one of 'rows' tuples
+ * spread evenly over them (Cardenas' formula), i.e. the heap pages an index
+ * scan read with its RIDs in page order.
+ */
+static double
+pagesFetched(double pages, double rows)
+{
+    if (pages < 1)
+        return 0;
+    return pages * (1 - pow(1 - 1 / pages, rows));
+}
+
+/*
+ * rangeCost
+ * ---------
+ * Estimated the cost of reading a key range of an index and fetching its
+ * records: the share of the tree's nodes the range spanned, one node for the
+ * way down, then the heap pages holding its tuples.
+ */
+static double
+rangeCost(RM_TableMgmtData *tblData, RM_IndexRange *range, double numTuples, double dataPages)
+{
+    int numNodes = 1;
+    pthread_mutex_lock(&tblData->indexLatch);
+    getNumNodes(tblData->indexes[range->index], &numNodes);
+    pthread_mutex_unlock(&tblData->indexLatch);
+
+    double rows = range->sel * numTuples;
+    return 1 + range->sel * numNodes + pagesFetched(dataPages, rows) + RM_PLAN_TUPLE_COST * 2 * rows;
+}
+
+/*
+ * planScan
+ * --------
+ * Chose how a scan with the given simple terms reached its records, by
+ * estimated cost: every data page; the pages the zone map did not rule out
+ * (counted exactly from the map); the key range of one index; or the RIDs two
+ * indexes had in common. If the table's statistics were missing or stale,
+ * they were gathered from a sample of RM_PLAN_SAMPLE_PAGES pages first (kept
+ * in memory, and saved with the table on close); analyzeTable read a larger
+ * one. Snapshot scans never used indexes, which only held the
+ * newest values. Chosen ranges were left in 'ranges'.
+ */
+static void
+planScan(RM_TableData *rel, RM_ScanMgmtData *sdata, AttrPredicate *preds, int numPreds, RM_IndexRange *ranges)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    Schema *sc = rel->schema;
+    RM_ScanPlan *plan = &sdata->plan;
+    bool useIndexes = !sdata->asOf && tblData->numIndexes > 0;
+
+    if (numPreds > 0 && (useIndexes || sdata->numZonePreds > 0) && !statsFresh(rel))
+        gatherStats(rel, RM_PLAN_SAMPLE_PAGES);
+
+    double numTuples = tblData->numTuples;
+    double dataPages = (tblData->numPages > 1) ? tblData->numPages - 1 : 1;
+
+    // Rows: the terms of different attributes were taken to be independent
+    bool seen[sc->numAttr > 0 ? sc->numAttr : 1];
+    memset(seen, 0, sizeof(seen));
+    plan->estRows = numTuples;
+    for (int p = 0; p < numPreds; p++)
+    {
+        if (seen[preds[p].attrNum])
+            continue;
+        seen[preds[p].attrNum] = true;
+        plan->estRows *= attrSelectivity(rel, preds, numPreds, preds[p].attrNum, NULL);
+    }
+
+    plan->path          = RM_PATH_SEQ;
+    plan->indexAttrs[0] = plan->indexAttrs[1] = -1;
+    plan->seqCost       = dataPages + RM_PLAN_TUPLE_COST * numTuples;
+    plan->cost          = plan->seqCost;
+
+    if (sdata->numZonePreds > 0)
+    {
+        int pages = 0;
+        for (int pg = 1; pg < tblData->numPages; pg++)
+            if (rmZoneMayMatch(&tblData->zoneMap, sc, pg, sdata->zonePreds, sdata->numZonePreds))
+                pages++;
+        double cost = pages + RM_PLAN_TUPLE_COST * numTuples * pages / dataPages;
+        if (cost < plan->cost)
+        {
+            plan->path = RM_PATH_ZONE;
+            plan->cost = cost;
+        }
+    }
+
+    // The usable range of every index, then the cheapest one or pair
+    RM_IndexRange cand[tblData->numIndexes > 0 ? tblData->numIndexes : 1];
+    double candCost[tblData->numIndexes > 0 ? tblData->numIndexes : 1];
+    int numCand = 0;
+    for (int i = 0; useIndexes && i < tblData->numIndexes; i++)
+    {
+        int attr = tblData->indexAttrs[i];
+        RM_IndexRange *r = &cand[numCand];
+        attrSelectivity(rel, preds, numPreds, attr, r);
+        // A string longer than the attribute could not be turned into a key
+        if (r->low == NULL && r->high == NULL)
+            continue;
+        if (sc->dataTypes[attr] == DT_STRING
+            && ((r->low != NULL && (int) strlen(r->low->v.stringV) > sc->typeLength[attr])
+                || (r->high != NULL && (int) strlen(r->high->v.stringV) > sc->typeLength[attr])))
+            continue;
+        r->index = i;
+        candCost[numCand] = rangeCost(tblData, r, numTuples, dataPages);
+        if (candCost[numCand] < plan->cost)
+        {
+            plan->path = RM_PATH_INDEX;
+            plan->cost = candCost[numCand];
+            plan->indexAttrs[0] = attr;
+            plan->indexAttrs[1] = -1;
+            ranges[0] = *r;
+        }
+        numCand++;
+    }
+    for (int a = 0; a < numCand; a++)
+        for (int b = a + 1; b < numCand; b++)
+        {
+            int attrA = tblData->indexAttrs[cand[a].index], attrB = tblData->indexAttrs[cand[b].index];
+            if (attrA == attrB)
+                continue;
+            double rows = cand[a].sel * cand[b].sel * numTuples;
+            double cost = (candCost[a] - pagesFetched(dataPages, cand[a].sel * numTuples))
+                + (candCost[b] - pagesFetched(dataPages, cand[b].sel * numTuples))
+                + pagesFetched(dataPages, rows) + RM_PLAN_TUPLE_COST * rows;
+            if (cost < plan->cost)
+            {
+                plan->path = RM_PATH_INTERSECT;
+                plan->cost = cost;
+                plan->indexAttrs[0] = attrA;
+                plan->indexAttrs[1] = attrB;
+                ranges[0] = cand[a];
+                ranges[1] = cand[b];
+            }
+        }
+
+    switch (plan->path)
+    {
+        case RM_PATH_SEQ:
+            sprintf(plan->text, "SEQ SCAN rows=%.0f cost=%.2f", plan->estRows, plan->cost);
+            break;
+        case RM_PATH_ZONE:
+            sprintf(plan->text, "ZONE MAP SCAN rows=%.0f cost=%.2f (seq scan cost=%.2f)",
+                    plan->estRows, plan->cost, plan->seqCost);
+            break;
+        case RM_PATH_INDEX:
+            sprintf(plan->text, "INDEX SCAN on %.64s rows=%.0f cost=%.2f (seq scan cost=%.2f)",
+                    sc->attrNames[plan->indexAttrs[0]], plan->estRows, plan->cost, plan->seqCost);
+            break;
+        case RM_PATH_INTERSECT:
+            sprintf(plan->text, "INDEX INTERSECT on %.64s, %.64s rows=%.0f cost=%.2f (seq scan cost=%.2f)",
+                    sc->attrNames[plan->indexAttrs[0]], sc->attrNames[plan->indexAttrs[1]],
+                    plan->estRows, plan->cost, plan->seqCost);
+            break;
+    }
+}
+
+/*
+ * setupTerms
+ * ----------
+ * Picked the simple terms out of a scan condition, kept the ones the zone map
+ * and the PAX minipage loops could use, and chose the access path. An index
+ * path needed none of the page filters, which were dropped again.
+ */
+static void
+setupTerms(RM_TableData *rel, RM_ScanMgmtData *sdata, Expr *cond, RM_IndexRange *ranges)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    Schema *sc = rel->schema;
+    AttrPredicate found[RM_MAX_SCAN_PREDS];
+    int exact = 0, n = 0;
+
+    bool paxTerms  = (tblData->layout == RM_LAYOUT_PAX);
+    bool zoneTerms = (tblData->zoneMap.numAttrs > 0);
+    if (cond != NULL)
+        n = extractPredicates(cond, found, RM_MAX_SCAN_PREDS, &exact);
+    sdata->predsExact = (exact != 0);
+
+    for (int i = 0; i < n; i++)
+    {
+        DataType dt = sc->dataTypes[found[i].attrNum];
+        if (zoneTerms && found[i].cons->dt == dt)
+            sdata->zonePreds[sdata->numZonePreds++] = found[i];
+
+        // Kept the terms the minipage loops could evaluate, with matching types
+        bool usable = paxTerms && (found[i].cons->dt == dt)
+            && (dt == DT_INT || dt == DT_FLOAT || (dt == DT_STRING && found[i].op == COMP_EQ));
+        if (usable)
+            sdata->preds[sdata->numPreds++] = found[i];
+        else
+            sdata->predsExact = false;
+    }
+
+    planScan(rel, sdata, found, n, ranges);
+    if (sdata->plan.path == RM_PATH_INDEX || sdata->plan.path == RM_PATH_INTERSECT)
+    {
+        sdata->numZonePreds = 0;
+        sdata->numPreds     = 0;
+        sdata->predsExact   = false;
+    }
+}
+
+/*
+ * explainScan
+ * -----------
+ * Reported how startScan would reach the records for a condition and at what
+ * estimated cost, without reading any of them. For a partitioned table it
+ * added up the plans of the partitions the condition did not rule out.
+ */
+RC explainScan(RM_TableData *rel, Expr *cond, RM_ScanPlan *plan)
+{
+    RM_ScanMgmtData sdata;
+    RM_IndexRange ranges[2];
+    RM_PartitionSet *ps = ((RM_TableMgmtData *) rel->mgmtData)->partSet;
+    if (ps != NULL)
+    {
+        int parts[ps->numParts > 0 ? ps->numParts : 1], numParts;
+        getScanPartitions(rel, cond, parts, &numParts);
+        partitionPlan(ps, parts, numParts, cond, plan);
+        return RC_OK;
+    }
+
+    memset(&sdata, 0, sizeof(sdata));
+    setupTerms(rel, &sdata, cond, ranges);
+    *plan = sdata.plan;
+    return RC_OK;
+}
+
+/*
+ * getScanPlan
+ * -----------
+ * Reported how a started scan reached its records.
+ */
+RC getScanPlan(RM_ScanHandle *scan, RM_ScanPlan *plan)
+{
+    RM_ScanMgmtData *sdata = (RM_ScanMgmtData*) scan->mgmtData;
+    *plan = sdata->plan;
+    return RC_OK;
+}
+
+/* --------------------------------------------------------------------------
+   Scan operations
+   -------------------------------------------------------------------------- */
+
+/*
+ * startScan
+ * ---------
+ * Started a scan that filled in every attribute of the returned records.
+ */
+RC startScan(RM_TableData *rel, RM_ScanHandle *scan, Expr *cond)
+{
+    return startScanProjection(rel, scan, cond, 0, NULL);
+}
+
+/*
+ * initScan
+ * --------
+ * Allocated mgmt data for scanning: currentPage=1, currentSlot=0, stored the
+ * condition. If numAttrs > 0, next() only filled in the listed attributes
+ * (plus the ones the condition needed), so a PAX table only read those
+ * minipages and a row table skipped decoding (and toast reads) for the rest.
+ * The access path was chosen here (see planScan). An index scan only visited
+ * the RIDs its ranges returned; otherwise next() skipped pages whose zone map
+ * ruled the terms out and, on PAX tables, tested them a minipage at a time.
+ * Terms on dictionary-encoded attributes were tested on the codes of a heap
+ * page before any of its records was decoded. Partitioned tables scanned the
+ * partitions the condition left (see initPartitionScan).
+ */
+static RC
+initScan(RM_TableData *rel, RM_ScanHandle *scan, Expr *cond, int numAttrs, int *attrs, RM_Snapshot *snapshot)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    Schema *sc = rel->schema;
+    if (tblData->partSet != NULL)
+        return initPartitionScan(rel, scan, cond, -1, numAttrs, attrs, snapshot);
+
+    RM_ScanMgmtData *scanData = (RM_ScanMgmtData*) malloc(sizeof(RM_ScanMgmtData));
+    scanData->currentPage = 1; 
+    scanData->currentSlot = 0;
+    scanData->cond        = cond;
+    scanData->needAttr    = NULL;
+    scanData->numPreds    = 0;
+    scanData->predsExact  = false;
+    scanData->match       = NULL;
+    scanData->numZonePreds = 0;
+    scanData->numDictTerms = 0;
+    scanData->dictExact   = false;
+    scanData->dictMatch   = NULL;
+    scanData->dictSlots   = 0;
+    scanData->rids        = NULL;
+    scanData->numRids     = 0;
+    scanData->ridPos      = 0;
+    scanData->asOf        = (snapshot != NULL);
+    scanData->snapshot    = (snapshot != NULL) ? snapshot->readTs : 0;
+    scanData->batchIds    = NULL;
+    scanData->batch       = NULL;
+    scanData->batchLen    = 0;
+    scanData->batchCap    = 0;
+    scanData->batchPos    = 0;
+    scanData->hits        = NULL;
+    scanData->hitData     = NULL;
+    scanData->hitCap      = 0;
+    scanData->parts       = NULL;
+    scanData->numParts    = 0;
+    scanData->partPos     = 0;
+    scanData->partOpen    = false;
+    scanData->numProjAttrs = 0;
+    scanData->projAttrs   = NULL;
+    scanData->viewData    = NULL;
+
+    if (numAttrs > 0)
+    {
+        scanData->needAttr = (bool *) calloc(sc->numAttr, sizeof(bool));
+        for (int i = 0; i < numAttrs; i++)
+            scanData->needAttr[attrs[i]] = true;
+        markCondAttrs(cond, scanData->needAttr);
+    }
+
+    RM_IndexRange ranges[2];
+    setupTerms(rel, scanData, cond, ranges);
+    if (scanData->numPreds > 0)
+        scanData->match = (char *) malloc(tblData->paxCapacity);
+
+    // Index paths fetched the RIDs of their ranges up front
+    if (scanData->plan.path == RM_PATH_INDEX || scanData->plan.path == RM_PATH_INTERSECT)
+    {
+        scanData->numRids = collectRange(tblData, &ranges[0], &scanData->rids);
+        if (scanData->numRids >= 0 && scanData->plan.path == RM_PATH_INTERSECT)
+        {
+            RID *other;
+            int numOther = collectRange(tblData, &ranges[1], &other);
+            if (numOther >= 0)
+            {
+                scanData->numRids = intersectRids(scanData->rids, scanData->numRids, other, numOther);
+                free(other);
+            }
+        }
+        // A tree that could not be read left the scan to go through the pages
+        if (scanData->numRids < 0)
+        {
+            scanData->rids    = NULL;
+            scanData->numRids = 0;
+        }
+    }
+
+    // Scans through the heap pages tested dictionary terms on the codes
+    if (tblData->numDicts > 0 && cond != NULL && scanData->rids == NULL && !scanData->asOf)
+    {
+        scanData->dictExact = true;
+        pthread_mutex_lock(&tblData->dictLatch);
+        collectDictTerms(tblData, scanData, cond);
+        pthread_mutex_unlock(&tblData->dictLatch);
+        if (scanData->numDictTerms > 0)
+            scanData->dictMatch = (char *) malloc(PAGE_SIZE / sizeof(RM_Slot));
+    }
+
+    scan->rel      = rel;
+    scan->mgmtData = scanData;
+    return RC_OK;
+}
+
+/*
+ * startScanProjection
+ * -------------------
+ * Started a scan of the newest versions that filled in the listed attributes.
+ */
+RC startScanProjection(RM_TableData *rel, RM_ScanHandle *scan, Expr *cond, int numAttrs, int *attrs)
+{
+    return initScan(rel, scan, cond, numAttrs, attrs, NULL);
+}
+
+/*
+ * startScanAsOf
+ * -------------
+ * Started a scan that returned the records as a snapshot saw them. It went
+ * through all pages (indexes held the newest values only) and still skipped
+ * pages with the zone map.
+ */
+RC startScanAsOf(RM_TableData *rel, RM_ScanHandle *scan, Expr *cond, RM_Snapshot *snapshot)
+{
+    return initScan(rel, scan, cond, 0, NULL, snapshot);
+}
+
+/*
+ * scanMatches
+ * -----------
+ * Evaluated the scan condition (if any) on a record that was already filled in.
+ */
+static bool
+scanMatches(RM_ScanHandle *scan, Record *record)
+{
+    RM_ScanMgmtData *sdata = (RM_ScanMgmtData*) scan->mgmtData;
+    if (sdata->cond == NULL)
+        return true;
 
-    char *data = page.data;
-    int slotsUsed;
-    memcpy(&slotsUsed, data, sizeof(int));
+    Value *res;
+    evalExpr(record, scan->rel->schema, sdata->cond, &res);
+    bool pass = (res->v.boolV == TRUE);
+    freeVal(res);
+    return pass;
+}
 
-    int maxSlots = computeMaxSlots(recSize);
-    int freeSlot = -1;
+/*
+ * nextOnHeapPage
+ * --------------
+ * Looked for the next matching record on a slotted heap page, skipping free
+ * slots and forward stubs (a moved record was returned, under its home RID,
+ * when the scan reached the page it had moved to). A record with toasted
+ * strings was not decoded while the page was latched, since reading them
+ * pinned overflow pages: its RID was returned with *deferred set instead, and
+ * next() read it with getRecord once the page was released. Records that
+ * failed the dictionary terms were skipped without being decoded; the terms
+ * were evaluated for the whole page when the scan entered it (and again if
+ * slots had been added since). With 'copy' unset (nextView), a record the terms
+ * alone decided was not decoded at all.
+ */
+static bool
+nextOnHeapPage(RM_ScanHandle *scan, char *data, Record *record, bool copy, bool *deferred)
+{
+    RM_ScanMgmtData *sdata = (RM_ScanMgmtData*) scan->mgmtData;
 
-    // looked for a free slot
-    for (int i = 0; i < maxSlots; i++)
+    while (sdata->currentSlot < RM_PAGE_HDR(data)->numSlots)
     {
-        if (getSlotFlag(data, i) == 0)
+        int slot = sdata->currentSlot++;
+        if (sdata->numDictTerms > 0)
         {
-            freeSlot = i;
-            break;
+            if (slot == 0 || slot >= sdata->dictSlots)
+                dictFilter(sdata, data);
+            if (!sdata->dictMatch[slot])
+                continue;
         }
-    }
 
-    // if no slot was free, set nextFreePage = -1, unpin, reinsert
-    if (freeSlot < 0)
-    {
-        tblData->nextFreePage = -1;
-        markDirty(&tblData->bufferPool, &page);
-        unpinPage(&tblData->bufferPool, &page);
-        return insertRecord(rel, record);
-    }
-
-    // wrote record->data into the page
-    int offset = 4 + maxSlots + (freeSlot * recSize);
-    memcpy(data + offset, record->data, recSize);
-
-    // updated usage
-    setSlotFlag(data, freeSlot, 1);
-    slotsUsed++;
-    memcpy(data, &slotsUsed, sizeof(int));
+        char *stored = rmPageRecord(data, slot, NULL);
+        if (stored == NULL || stored[0] == RM_REC_FORWARD)
+            continue;
 
-    // assigned record->id
-    record->id.page = tblData->nextFreePage;
-    record->id.slot = freeSlot;
-
-    markDirty(&tblData->bufferPool, &page);
-    unpinPage(&tblData->bufferPool, &page);
-
-    tblData->numTuples++;
-
-    // If page was full, set nextFreePage = -1, else keep the same page
-    if (slotsUsed == maxSlots)
-        tblData->nextFreePage = -1;
-    else
-        tblData->nextFreePage = pageNum;
+        if (stored[0] == RM_REC_MOVED)
+            memcpy(&record->id, stored + 1, sizeof(RID));
+        else
+        {
+            record->id.page = sdata->currentPage;
+            record->id.slot = slot;
+        }
+        bool decided = (sdata->cond == NULL || (sdata->numDictTerms > 0 && sdata->dictExact));
+        if (decided && !copy)
+            return true;
+        if (hasToast(scan->rel, stored, sdata->needAttr))
+        {
+            *deferred = true;
+            return true;
+        }
 
-    return RC_OK;
+        // Decoded the record
+        decodeRecord(scan->rel, stored, record->data, sdata->needAttr);
+        if (decided || scanMatches(scan, record))
+            return true;
+    }
+    return false;
 }
 
 /*
- * deleteRecord
- * ------------
- * Freed a slot by marking usage=0, decreased the number of used slots,
- * and set nextFreePage if needed.
+ * nextOnPaxPage
+ * -------------
+ * Looked for the next matching record on a PAX page. The simple terms of the
+ * condition were tested over whole minipages when the scan entered the page;
+ * only slots that passed were gathered and, unless the terms were the whole
+ * condition, checked with evalExpr. 'copy' was handled as in nextOnHeapPage.
  */
-RC deleteRecord(RM_TableData *rel, RID id)
+static bool
+nextOnPaxPage(RM_ScanHandle *scan, char *data, Record *record, bool copy)
 {
-    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
-    BM_PageHandle page;
-    RC rc = pinPage(&tblData->bufferPool, &page, id.page);
-    if (rc != RC_OK) return rc;
+    RM_ScanMgmtData *sdata    = (RM_ScanMgmtData*) scan->mgmtData;
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) scan->rel->mgmtData;
+    Schema *sc = scan->rel->schema;
+    char *used = RM_PAX_USED(data);
 
-    char *data = page.data;
-    int slotsUsed;
-    memcpy(&slotsUsed, data, sizeof(int));
+    if (sdata->numPreds > 0 && sdata->currentSlot == 0)
+        paxFilter(scan->rel, sdata, data);
 
-    // if usage was 1 => used, set it to 0 => free
-    if (getSlotFlag(data, id.slot) == 1)
+    while (sdata->currentSlot < RM_PAGE_HDR(data)->numSlots)
     {
-        setSlotFlag(data, id.slot, 0);
-        slotsUsed--;
-        memcpy(data, &slotsUsed, sizeof(int));
-        tblData->numTuples--;
+        int slot = sdata->currentSlot++;
+        if (!used[slot] || (sdata->numPreds > 0 && !sdata->match[slot]))
+            continue;
 
-        // if the page used to be full, we updated nextFreePage to this one
-        int maxSlots = computeMaxSlots(tblData->recordSize);
-        if (slotsUsed == maxSlots - 1)
-        {
-            tblData->nextFreePage = id.page;
-        }
-    }
+        record->id.page = sdata->currentPage;
+        record->id.slot = slot;
+        bool decided = (sdata->cond == NULL || (sdata->numPreds > 0 && sdata->predsExact));
+        if (decided && !copy)
+            return true;
 
-    markDirty(&tblData->bufferPool, &page);
-    unpinPage(&tblData->bufferPool, &page);
-    return RC_OK;
+        for (int i = 0; i < sc->numAttr; i++)
+            if (sdata->needAttr == NULL || sdata->needAttr[i])
+                rmPaxRead(data, sc, tblData->paxColStart, slot, i, record->data);
+        if (decided || scanMatches(scan, record))
+            return true;
+    }
+    return false;
 }
 
 /*
- * updateRecord
- * ------------
- * Overwrote the record data in an existing slot, if that slot usage was 1.
+ * addToBatch
+ * ----------
+ * Appended a record to the batch of a snapshot scan.
  */
-RC updateRecord(RM_TableData *rel, Record *record)
+static void
+addToBatch(RM_ScanMgmtData *sdata, int recordSize, RID id, char *data)
 {
-    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
-    BM_PageHandle page;
-    int pageNum = record->id.page;
-    int slotNum = record->id.slot;
-
-    RC rc = pinPage(&tblData->bufferPool, &page, pageNum);
-    if (rc != RC_OK) return rc;
-
-    // if usage was 0 => cannot update
-    if (getSlotFlag(page.data, slotNum) == 0)
+    if (sdata->batchLen == sdata->batchCap)
     {
-        unpinPage(&tblData->bufferPool, &page);
-        return RC_READ_NON_EXISTING_PAGE;
+        sdata->batchCap = (sdata->batchCap > 0) ? 2 * sdata->batchCap : 64;
+        sdata->batchIds = (RID *) realloc(sdata->batchIds, sdata->batchCap * sizeof(RID));
+        sdata->batch    = (char *) realloc(sdata->batch, (size_t) sdata->batchCap * recordSize);
     }
-
-    int maxSlots = computeMaxSlots(tblData->recordSize);
-    int offset = 4 + maxSlots + slotNum * tblData->recordSize;
-    memcpy(page.data + offset, record->data, tblData->recordSize);
-
-    markDirty(&tblData->bufferPool, &page);
-    unpinPage(&tblData->bufferPool, &page);
-    return RC_OK;
+    sdata->batchIds[sdata->batchLen] = id;
+    memcpy(sdata->batch + (size_t) sdata->batchLen * recordSize, data, recordSize);
+    sdata->batchLen++;
 }
 
 /*
- * getRecord
- * ---------
- * Copied the record data out of the slot if usage was 1; if usage was 0, returned RC_RM_NO_MORE_TUPLES.
+ * loadSnapshotPage
+ * ----------------
+ * Collected what a snapshot scan returned for the records whose home RID was
+ * on one page into its batch. It was done all at once, so writes between
+ * calls to next() could neither hide a record from the scan nor return one
+ * twice. The page was read first, following forward stubs (moved bodies were
+ * left to their home page), and released; then the RIDs that had changed
+ * since the snapshot were looked up in the version store without any latch,
+ * and the version the snapshot saw replaced what the page held. Writers saved
+ * the old version before changing the page, so a change seen on the page was
+ * always found there after. The zone map could still rule the page out,
+ * because a moved record's values were also added to the range of its home
+ * page. Forwarded records and ones with toasted strings were read through
+ * getRecordAsOf once the page was released.
  */
-RC getRecord(RM_TableData *rel, RID id, Record *record)
+static RC
+loadSnapshotPage(RM_ScanHandle *scan, int pageNum)
 {
+    RM_TableData *rel         = scan->rel;
     RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    RM_ScanMgmtData *sdata    = (RM_ScanMgmtData*) scan->mgmtData;
+    Schema *sc = rel->schema;
+    int size = tblData->recordSize;
+    char recData[size];
+    Record rec;
+    rec.data = recData;
+    RC rc = RC_OK;
+
+    sdata->batchLen = 0;
+    sdata->batchPos = 0;
+
+    if (sdata->numZonePreds > 0
+        && !rmZoneMayMatch(&tblData->zoneMap, sc, pageNum, sdata->zonePreds, sdata->numZonePreds))
+        return RC_OK;
+
     BM_PageHandle page;
-    RC rc = pinPage(&tblData->bufferPool, &page, id.page);
+    rc = latchPage(tblData, &page, pageNum, false);
     if (rc != RC_OK) return rc;
 
-    // check usage
-    if (getSlotFlag(page.data, id.slot) == 0)
+    RM_PageHeader *hdr = RM_PAGE_HDR(page.data);
+    int numSlots = (hdr->pageType == RM_PAGE_HEAP || hdr->pageType == RM_PAGE_PAX) ? hdr->numSlots : 0;
+    int deferred[numSlots > 0 ? numSlots : 1];
+    int numDeferred = 0;
+
+    rec.id.page = pageNum;
+    for (int slot = 0; slot < numSlots; slot++)
     {
-        unpinPage(&tblData->bufferPool, &page);
-        return RC_RM_NO_MORE_TUPLES;
+        rec.id.slot = slot;
+        if (hdr->pageType == RM_PAGE_PAX)
+        {
+            if (!RM_PAX_USED(page.data)[slot])
+                continue;
+            for (int i = 0; i < sc->numAttr; i++)
+                rmPaxRead(page.data, sc, tblData->paxColStart, slot, i, recData);
+        }
+        else
+        {
+            char *stored = rmPageRecord(page.data, slot, NULL);
+            if (stored == NULL || stored[0] == RM_REC_MOVED)
+                continue;
+            if (stored[0] == RM_REC_FORWARD || hasToast(rel, stored, NULL))
+            {
+                deferred[numDeferred++] = slot;
+                continue;
+            }
+            decodeRecord(rel, stored, recData, NULL);
+        }
+        if (scanMatches(scan, &rec))
+            addToBatch(sdata, size, rec.id, recData);
     }
+    unlatchPage(tblData, &page);
 
-    int maxSlots = computeMaxSlots(tblData->recordSize);
-    int offset   = 4 + maxSlots + (id.slot * tblData->recordSize);
-    memcpy(record->data, page.data + offset, tblData->recordSize);
+    // The RIDs of this page that had changed since the snapshot
+    int numHits;
+    while ((numHits = rmVersionsOnPage(&tblData->versions, pageNum, sdata->snapshot,
+                                       sdata->hits, sdata->hitData, sdata->hitCap)) > sdata->hitCap)
+    {
+        sdata->hitCap  = numHits;
+        sdata->hits    = (RM_VersionHit *) realloc(sdata->hits, numHits * sizeof(RM_VersionHit));
+        sdata->hitData = (char *) realloc(sdata->hitData, (size_t) numHits * size);
+    }
 
-    record->id.page = id.page;
-    record->id.slot = id.slot;
+    int numChanged = (numSlots > 0) ? numSlots : 1;
+    for (int i = 0; i < numHits; i++)
+        if (sdata->hits[i].id.slot >= numChanged)
+            numChanged = sdata->hits[i].id.slot + 1;
+    bool changed[numChanged];
+    memset(changed, 0, sizeof(changed));
+    for (int i = 0; i < numHits; i++)
+        changed[sdata->hits[i].id.slot] = true;
+
+    // Drop what the page held of the changed ones
+    int kept = 0;
+    for (int i = 0; i < sdata->batchLen; i++)
+    {
+        if (changed[sdata->batchIds[i].slot])
+            continue;
+        if (kept != i)
+        {
+            sdata->batchIds[kept] = sdata->batchIds[i];
+            memcpy(sdata->batch + (size_t) kept * size, sdata->batch + (size_t) i * size, size);
+        }
+        kept++;
+    }
+    sdata->batchLen = kept;
+
+    // Read the deferred records once the home page was released
+    RM_Snapshot snap;
+    snap.readTs = sdata->snapshot;
+    for (int i = 0; i < numDeferred; i++)
+    {
+        if (changed[deferred[i]])
+            continue;
+        RID home;
+        home.page = pageNum;
+        home.slot = deferred[i];
+        rc = getRecordAsOf(rel, home, &rec, &snap);
+        if (rc == RC_RM_NO_MORE_TUPLES)
+            continue;
+        if (rc != RC_OK) return rc;
+        if (scanMatches(scan, &rec))
+            addToBatch(sdata, size, rec.id, recData);
+    }
 
-    unpinPage(&tblData->bufferPool, &page);
+    // The versions the snapshot saw of the changed ones
+    for (int i = 0; i < numHits; i++)
+    {
+        if (!sdata->hits[i].visible)
+            continue;
+        rec.id = sdata->hits[i].id;
+        memcpy(recData, sdata->hitData + (size_t) i * size, size);
+        if (scanMatches(scan, &rec))
+            addToBatch(sdata, size, rec.id, recData);
+    }
     return RC_OK;
 }
 
-/* --------------------------------------------------------------------------
-   Scan operations
-   -------------------------------------------------------------------------- */
-
 /*
- * startScan
- * ---------
- * Allocated mgmt data for scanning: currentPage=1, currentSlot=0, stored the condition.
+ * nextAsOf
+ * --------
+ * Returned the next record of a snapshot scan from its batch, collecting the
+ * following pages as the batch ran out. A view pointed into the batch instead.
  */
-RC startScan(RM_TableData *rel, RM_ScanHandle *scan, Expr *cond)
+static RC
+nextAsOf(RM_ScanHandle *scan, Record *record, RM_RecordView *view)
 {
-    RM_ScanMgmtData *scanData = (RM_ScanMgmtData*) malloc(sizeof(RM_ScanMgmtData));
-    scanData->currentPage = 1; 
-    scanData->currentSlot = 0;
-    scanData->cond        = cond;
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) scan->rel->mgmtData;
+    RM_ScanMgmtData *sdata    = (RM_ScanMgmtData*) scan->mgmtData;
 
-    scan->rel      = rel;
-    scan->mgmtData = scanData;
+    while (sdata->batchPos >= sdata->batchLen)
+    {
+        if (sdata->currentPage < 1 || sdata->currentPage >= tblData->numPages)
+            return RC_RM_NO_MORE_TUPLES;
+        RC rc = loadSnapshotPage(scan, sdata->currentPage++);
+        if (rc != RC_OK) return rc;
+    }
+
+    int pos = sdata->batchPos++;
+    char *data = sdata->batch + (size_t) pos * tblData->recordSize;
+    if (view != NULL)
+    {
+        view->id   = sdata->batchIds[pos];
+        view->data = data;
+        return RC_OK;
+    }
+    record->id = sdata->batchIds[pos];
+    memcpy(record->data, data, tblData->recordSize);
     return RC_OK;
 }
 
 /*
  * next
  * ----
- * Retrieved the next matching record by scanning pages from currentPage onward,
- * skipping free slots (usage=0), returning the first that satisfies the condition (if any).
+ * Retrieved the next matching record. Index scans fetched the next RID from
+ * their list; other scans went through the pages from currentPage onward, skipping pages that held no records (overflow, dictionary and free pages) or
+ * whose zone map ranges could not satisfy the condition, and returning the
+ * first record that satisfied the condition (if any).
  */
 RC next(RM_ScanHandle *scan, Record *record)
 {
@@ -573,87 +5760,190 @@ RC next(RM_ScanHandle *scan, Record *record)
     RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
     RM_ScanMgmtData *sdata    = (RM_ScanMgmtData*) scan->mgmtData;
 
-    int recSize = tblData->recordSize;
-    int maxSlots= computeMaxSlots(recSize);
+    if (sdata->parts != NULL)
+        return nextInPartitions(scan, record, NULL);
+    if (sdata->asOf)
+        return nextAsOf(scan, record, NULL);
 
-    while (true)
+    // Index scans fetched the collected RIDs, in page order
+    if (sdata->rids != NULL)
     {
-        if (sdata->currentPage < 1)
-            return RC_RM_NO_MORE_TUPLES;
+        while (sdata->ridPos < sdata->numRids)
+        {
+            RID id = sdata->rids[sdata->ridPos++];
+            if (getRecord(rel, id, record) == RC_OK && scanMatches(scan, record))
+                return RC_OK;
+        }
+        return RC_RM_NO_MORE_TUPLES;
+    }
+
+    while (sdata->currentPage >= 1 && sdata->currentPage < tblData->numPages)
+    {
+        // Skipped pages the zone map ruled out without reading them
+        if (sdata->currentSlot == 0 && sdata->numZonePreds > 0
+            && !rmZoneMayMatch(&tblData->zoneMap, rel->schema, sdata->currentPage,
+                               sdata->zonePreds, sdata->numZonePreds))
+        {
+            sdata->currentPage++;
+            continue;
+        }
 
         BM_PageHandle page;
-        // If pinPage fails => presumably no more pages exist
-        if (pinPage(&tblData->bufferPool, &page, sdata->currentPage) != RC_OK)
+        if (latchPage(tblData, &page, sdata->currentPage, false) != RC_OK)
             return RC_RM_NO_MORE_TUPLES;
 
-        char *data = page.data;
-        int slotsUsed;
-        memcpy(&slotsUsed, data, sizeof(int));
-
-        bool found = false;
-        while (sdata->currentSlot < maxSlots)
+        bool found = false, deferred = false;
+        switch (RM_PAGE_HDR(page.data)->pageType)
         {
-            if (getSlotFlag(data, sdata->currentSlot) == 1)
-            {
-                // Copied the record
-                int offset = 4 + maxSlots + (sdata->currentSlot * recSize);
-                memcpy(record->data, data + offset, recSize);
-                record->id.page = sdata->currentPage;
-                record->id.slot = sdata->currentSlot;
-
-                // If there was a condition, we evaluated it
-                if (sdata->cond != NULL)
-                {
-                    Value *res;
-                    evalExpr(record, rel->schema, sdata->cond, &res);
-                    bool pass = (res->v.boolV == TRUE);
-                    freeVal(res);
-                    if (pass)
-                    {
-                        found = true;
-                        sdata->currentSlot++;
-                        break;
-                    }
-                }
-                else
-                {
-                    // No condition => matched by default
-                    found = true;
-                    sdata->currentSlot++;
-                    break;
-                }
-            }
-            sdata->currentSlot++;
+            case RM_PAGE_HEAP:
+                found = nextOnHeapPage(scan, page.data, record, true, &deferred);
+                break;
+            case RM_PAGE_PAX:
+                found = nextOnPaxPage(scan, page.data, record, true);
+                break;
+            default:
+                break;
         }
 
-        unpinPage(&tblData->bufferPool, &page);
+        unlatchPage(tblData, &page);
 
+        if (deferred)
+        {
+            if (getRecord(rel, record->id, record) == RC_OK && scanMatches(scan, record))
+                return RC_OK;
+            continue;
+        }
         if (found)
             return RC_OK;
 
         // Moved on to the next page
         sdata->currentPage++;
         sdata->currentSlot=0;
+    }
+    return RC_RM_NO_MORE_TUPLES;
+}
 
-        // Checked if new page was beyond file size
-        SM_FileHandle fHandle;
-        if (openPageFile(rel->name, &fHandle) != RC_OK)
-            return RC_RM_NO_MORE_TUPLES;
-        bool beyond = (sdata->currentPage >= fHandle.totalNumPages);
-        closePageFile(&fHandle);
-        if (beyond)
+/*
+ * nextView
+ * --------
+ * Like next, but returned a view of the record (see getRecordView) instead of
+ * a copy. Records the condition was decided for without decoding them (no
+ * condition, or one the pushed-down terms settled) were never copied; the
+ * others were decoded into a scratch record only to be checked. Snapshot scans
+ * returned views into their batch, which held no page. Each view had to be
+ * released before the next call.
+ */
+RC nextView(RM_ScanHandle *scan, RM_RecordView *view)
+{
+    RM_TableData *rel         = scan->rel;
+    RM_TableMgmtData *tblData = (RM_TableMgmtData*) rel->mgmtData;
+    RM_ScanMgmtData *sdata    = (RM_ScanMgmtData*) scan->mgmtData;
+    Record scratch;
+
+    if (sdata->parts != NULL)
+        return nextInPartitions(scan, NULL, view);
+    clearView(view, rel);
+    if (sdata->asOf)
+        return nextAsOf(scan, NULL, view);
+
+    if (sdata->viewData == NULL)
+        sdata->viewData = (char *) malloc(tblData->recordSize);
+    scratch.data = sdata->viewData;
+
+    // Index scans checked the condition on a copy, then took the view
+    if (sdata->rids != NULL)
+    {
+        while (sdata->ridPos < sdata->numRids)
+        {
+            RID id = sdata->rids[sdata->ridPos++];
+            if (sdata->cond != NULL && (getRecord(rel, id, &scratch) != RC_OK || !scanMatches(scan, &scratch)))
+                continue;
+            if (getRecordView(rel, id, view) == RC_OK)
+                return RC_OK;
+        }
+        return RC_RM_NO_MORE_TUPLES;
+    }
+
+    while (sdata->currentPage >= 1 && sdata->currentPage < tblData->numPages)
+    {
+        if (sdata->currentSlot == 0 && sdata->numZonePreds > 0
+            && !rmZoneMayMatch(&tblData->zoneMap, rel->schema, sdata->currentPage,
+                               sdata->zonePreds, sdata->numZonePreds))
+        {
+            sdata->currentPage++;
+            continue;
+        }
+
+        if (latchPage(tblData, &view->page, sdata->currentPage, false) != RC_OK)
             return RC_RM_NO_MORE_TUPLES;
+
+        bool found = false, deferred = false;
+        char *data = view->page.data;
+        switch (RM_PAGE_HDR(data)->pageType)
+        {
+            case RM_PAGE_HEAP:
+                found = nextOnHeapPage(scan, data, &scratch, false, &deferred);
+                break;
+            case RM_PAGE_PAX:
+                found = nextOnPaxPage(scan, data, &scratch, false);
+                break;
+            default:
+                break;
+        }
+
+        // The view kept the page it found the record on
+        if (found && !deferred)
+        {
+            view->id = scratch.id;
+            if (RM_PAGE_HDR(data)->pageType == RM_PAGE_PAX)
+                view->paxSlot = sdata->currentSlot - 1;
+            else
+                view->stored = rmPageRecord(data, sdata->currentSlot - 1, NULL);
+            view->pinned = true;
+            return RC_OK;
+        }
+        unlatchPage(tblData, &view->page);
+
+        if (deferred)
+        {
+            RID id = scratch.id;
+            if (getRecord(rel, id, &scratch) == RC_OK && scanMatches(scan, &scratch)
+                && getRecordView(rel, id, view) == RC_OK)
+                return RC_OK;
+            continue;
+        }
+
+        sdata->currentPage++;
+        sdata->currentSlot = 0;
     }
+    return RC_RM_NO_MORE_TUPLES;
 }
 
 /*
  * closeScan
  * ---------
- * Freed the mgmt data for the scan.
+ * Freed the mgmt data for the scan, closing the scan of a partition still
+ * open.
  */
 RC closeScan(RM_ScanHandle *scan)
 {
-    free(scan->mgmtData);
+    RM_ScanMgmtData *sdata = (RM_ScanMgmtData*) scan->mgmtData;
+    if (sdata->partOpen)
+        closeScan(&sdata->partScan);
+    free(sdata->parts);
+    free(sdata->projAttrs);
+    free(sdata->needAttr);
+    free(sdata->match);
+    free(sdata->dictMatch);
+    for (int t = 0; t < sdata->numDictTerms; t++)
+        free(sdata->dictTerms[t].codes);
+    free(sdata->rids);
+    free(sdata->batchIds);
+    free(sdata->batch);
+    free(sdata->hits);
+    free(sdata->hitData);
+    free(sdata->viewData);
+    free(sdata);
     scan->mgmtData = NULL;
     return RC_OK;
 }
@@ -672,10 +5962,22 @@ int getRecordSize(Schema *schema)
     return computeRecordSize(schema);
 }
 
+/*
+ * getAttrSize
+ * -----------
+ * Returned how many bytes an attribute took up inside record->data, from the
+ * offsets createSchema had worked out.
+ */
+int getAttrSize(Schema *schema, int attrNum)
+{
+    return schema->attrOffsets[attrNum + 1] - schema->attrOffsets[attrNum];
+}
+
 /*
  * createSchema
  * ------------
  * Created a schema from the given arrays. Allocated and returned the pointer.
+ * Also filled the attribute offset table used by getAttr/setAttr.
  */
 Schema *createSchema(int numAttr, char **attrNames, DataType *dataTypes,
                      int *typeLength, int keySize, int *keys)
@@ -687,6 +5989,12 @@ Schema *createSchema(int numAttr, char **attrNames, DataType *dataTypes,
     sc->typeLength = typeLength;
     sc->keySize    = keySize;
     sc->keyAttrs   = keys;
+
+    // Summed the attribute sizes once, so record access never had to again
+    sc->attrOffsets = (int*) malloc((numAttr + 1) * sizeof(int));
+    sc->attrOffsets[0] = 0;
+    for (int i = 0; i < numAttr; i++)
+        sc->attrOffsets[i + 1] = sc->attrOffsets[i] + attrSize(sc, i);
     return sc;
 }
 
@@ -705,6 +6013,7 @@ RC freeSchema(Schema *schema)
     free(schema->dataTypes);
     free(schema->typeLength);
     free(schema->keyAttrs);
+    free(schema->attrOffsets);
     free(schema);
     return RC_OK;
 }
@@ -740,90 +6049,192 @@ RC freeRecord(Record *record)
 /*
  * getAttr
  * -------
- * Fetched a single attribute from record->data by computing the offset for that attribute.
+ * Fetched a single attribute from record->data at its precomputed offset.
  * Copied it into a newly allocated Value, based on the attribute's data type.
  */
 RC getAttr(Record *record, Schema *schema, int attrNum, Value **value)
 {
-    char *base = record->data;
-    int offset = 0;
-
-    // Calculated offset by skipping the sizes of earlier attributes
-    for (int i = 0; i < attrNum; i++)
-    {
-        switch (schema->dataTypes[i])
-        {
-            case DT_INT:    offset += sizeof(int);    break;
-            case DT_FLOAT:  offset += sizeof(float);  break;
-            case DT_BOOL:   offset += sizeof(bool);   break;
-            case DT_STRING: offset += schema->typeLength[i]; break;
-        }
-    }
-
     // Allocated the Value object
     *value = (Value*) malloc(sizeof(Value));
-    (*value)->dt = schema->dataTypes[attrNum];
 
-    // Copied from record->data + offset
-    switch ((*value)->dt)
+    // Strings got their own buffer, since freeVal released it later
+    if (schema->dataTypes[attrNum] == DT_STRING)
+        (*value)->v.stringV = (char*) malloc(schema->typeLength[attrNum] + 1);
+
+    return getAttrInto(record, schema, attrNum, *value);
+}
+
+/*
+ * getAttrInto
+ * -----------
+ * Same as getAttr, but filled a caller-owned Value and allocated nothing.
+ * For DT_STRING the caller had to point out->v.stringV at a buffer of at least
+ * typeLength + 1 bytes; the string was copied there and null terminated.
+ */
+RC getAttrInto(Record *record, Schema *schema, int attrNum, Value *out)
+{
+    char *src = record->data + schema->attrOffsets[attrNum];
+
+    out->dt = schema->dataTypes[attrNum];
+    switch (out->dt)
     {
         case DT_INT:
-        {
-            int val;
-            memcpy(&val, base + offset, sizeof(int));
-            (*value)->v.intV = val;
-        }
-        break;
+            memcpy(&out->v.intV, src, sizeof(int));
+            break;
         case DT_FLOAT:
-        {
-            float f;
-            memcpy(&f, base + offset, sizeof(float));
-            (*value)->v.floatV = f;
-        }
-        break;
+            memcpy(&out->v.floatV, src, sizeof(float));
+            break;
         case DT_BOOL:
         {
             bool b;
-            memcpy(&b, base + offset, sizeof(bool));
-            (*value)->v.boolV = b;
+            memcpy(&b, src, sizeof(bool));
+            out->v.boolV = b;
         }
         break;
         case DT_STRING:
         {
             int len = schema->typeLength[attrNum];
-            (*value)->v.stringV = (char*) malloc(len + 1);
-            memcpy((*value)->v.stringV, base + offset, len);
+            memcpy(out->v.stringV, src, len);
             // Null terminator
-            (*value)->v.stringV[len] = '\0';
+            out->v.stringV[len] = '\0';
         }
         break;
+        case DT_BLOB:
+            memcpy(&out->v.blobV, src, sizeof(int));
+            break;
     }
     return RC_OK;
 }
 
+/*
+ * getIntAttr / getFloatAttr
+ * -------------------------
+ * Typed accessors that read the attribute in place and returned it by value.
+ * The caller was responsible for asking for an attribute of the right type.
+ */
+int getIntAttr(Record *record, Schema *schema, int attrNum)
+{
+    int val;
+    memcpy(&val, record->data + schema->attrOffsets[attrNum], sizeof(int));
+    return val;
+}
+
+float getFloatAttr(Record *record, Schema *schema, int attrNum)
+{
+    float val;
+    memcpy(&val, record->data + schema->attrOffsets[attrNum], sizeof(float));
+    return val;
+}
+
+/*
+ * getStringAttr
+ * -------------
+ * Returned a view of a DT_STRING attribute: a pointer into record->data and,
+ * through *len, the number of characters before the zero padding. The view was
+ * NOT null terminated when the string filled the whole typeLength, and it was
+ * only valid as long as the record itself.
+ */
+const char *getStringAttr(Record *record, Schema *schema, int attrNum, int *len)
+{
+    const char *src = record->data + schema->attrOffsets[attrNum];
+    if (len != NULL)
+        *len = (int) strnlen(src, schema->typeLength[attrNum]);
+    return src;
+}
+
+/*
+ * viewValue
+ * ---------
+ * Found the bytes of a fixed-width attribute (or the code of a dictionary
+ * string) of a viewed record: in the batch of a snapshot scan, in the minipage
+ * of a PAX page, or in the fixed part of a stored record.
+ */
+static const char *
+viewValue(RM_RecordView *view, int attrNum)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) view->rel->mgmtData;
+    Schema *sc = view->rel->schema;
+
+    if (view->data != NULL)
+        return view->data + sc->attrOffsets[attrNum];
+    if (view->paxSlot >= 0)
+    {
+        int width = sc->attrOffsets[attrNum + 1] - sc->attrOffsets[attrNum];
+        return view->page.data + tblData->paxColStart[attrNum] + view->paxSlot * width;
+    }
+    return recordBody(view->stored) + tblData->encOffset[attrNum];
+}
+
+/*
+ * getViewInt / getViewFloat
+ * -------------------------
+ * Read an attribute of a viewed record in place, like getIntAttr and
+ * getFloatAttr (getViewInt also read the id of a DT_BLOB attribute).
+ */
+int getViewInt(RM_RecordView *view, int attrNum)
+{
+    int val;
+    memcpy(&val, viewValue(view, attrNum), sizeof(int));
+    return val;
+}
+
+float getViewFloat(RM_RecordView *view, int attrNum)
+{
+    float val;
+    memcpy(&val, viewValue(view, attrNum), sizeof(float));
+    return val;
+}
+
+/*
+ * getViewString
+ * -------------
+ * Returned a DT_STRING attribute of a viewed record where it lay, like
+ * getStringAttr: the bytes on the page (or the dictionary's copy of a coded
+ * value), not null terminated, with their length in *len. A toasted string
+ * was not on the page: NULL was returned, and getRecord read it.
+ */
+const char *getViewString(RM_RecordView *view, int attrNum, int *len)
+{
+    RM_TableMgmtData *tblData = (RM_TableMgmtData *) view->rel->mgmtData;
+    Schema *sc = view->rel->schema;
+    const char *src;
+    int n;
+
+    if (view->data != NULL || view->paxSlot >= 0)
+    {
+        src = viewValue(view, attrNum);
+        n = (int) strnlen(src, sc->typeLength[attrNum]);
+    }
+    else if (tblData->dictOf[attrNum] != NULL)
+    {
+        unsigned short code;
+        memcpy(&code, viewValue(view, attrNum), sizeof(code));
+        src = rmDictValue(tblData->dictOf[attrNum], code);
+        n = (int) strnlen(src, sc->typeLength[attrNum]);
+    }
+    else
+    {
+        bool toasted;
+        src = varEntry(tblData, recordBody(view->stored), tblData->encOffset[attrNum], &n, &toasted);
+        if (toasted)
+            src = NULL;
+    }
+    if (len != NULL)
+        *len = (src != NULL) ? n : 0;
+    return src;
+}
+
 /*
  * setAttr
  * -------
- * Computed the offset for the specified attribute, then wrote the new value's
- * bytes into record->data. For strings, we wrote up to 'len' characters and
- * padded with zero if needed.
+ * Wrote the new value's bytes into record->data at the attribute's precomputed
+ * offset. For strings, we wrote up to 'len' characters and padded with zero if
+ * needed.
  */
 RC setAttr(Record *record, Schema *schema, int attrNum, Value *value)
 {
     char *base = record->data;
-    int offset = 0;
-
-    // Found how many bytes to skip for earlier attributes
-    for (int i = 0; i < attrNum; i++)
-    {
-        switch (schema->dataTypes[i])
-        {
-            case DT_INT:    offset += sizeof(int);    break;
-            case DT_FLOAT:  offset += sizeof(float);  break;
-            case DT_BOOL:   offset += sizeof(bool);   break;
-            case DT_STRING: offset += schema->typeLength[i]; break;
-        }
-    }
+    int offset = schema->attrOffsets[attrNum];
 
     // Wrote the attribute
     switch (value->dt)
@@ -835,8 +6246,11 @@ RC setAttr(Record *record, Schema *schema, int attrNum, Value *value)
             memcpy(base + offset, &value->v.floatV, sizeof(float));
             break;
         case DT_BOOL:
-            memcpy(base + offset, &value->v.boolV, sizeof(bool));
-            break;
+        {
+            bool b = value->v.boolV;
+            memcpy(base + offset, &b, sizeof(bool));
+        }
+        break;
         case DT_STRING:
         {
             int len = schema->typeLength[attrNum];
@@ -844,6 +6258,9 @@ RC setAttr(Record *record, Schema *schema, int attrNum, Value *value)
             strncpy(base + offset, value->v.stringV, len);
         }
         break;
+        case DT_BLOB:
+            memcpy(base + offset, &value->v.blobV, sizeof(int));
+            break;
     }
     return RC_OK;
-}
\ No newline at end of file
+}
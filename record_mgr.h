@@ -2,8 +2,13 @@
 #define RECORD_MGR_H
 
 #include "dberror.h"
+#include "storage_mgr.h"
+#include "buffer_mgr.h"
 #include "expr.h"
 #include "tables.h"
+#include "btree_mgr.h"
+#include "rm_stats.h"
+#include "rm_partition.h"
 
 // Bookkeeping for scans
 typedef struct RM_ScanHandle
@@ -12,28 +17,146 @@ typedef struct RM_ScanHandle
 	void *mgmtData;
 } RM_ScanHandle;
 
+// how a table lays out records on its pages
+typedef enum RM_Layout {
+	RM_LAYOUT_ROW = 0,   // slotted pages of variable-length records (the default)
+	RM_LAYOUT_PAX = 1    // fixed-width records stored column by column within each page
+} RM_Layout;
+
+// table-level storage options for createTableWithOptions
+typedef struct RM_TableOptions
+{
+	RM_Layout layout;
+	int numZoneAttrs;    // attributes to keep per-page min/max ranges for (scans skip pages with them)
+	int *zoneAttrs;
+	int numIndexes;      // attributes to keep a B+ tree index on (used by scans with matching terms)
+	int *indexAttrs;
+	int numDictAttrs;    // DT_STRING attributes to store as dictionary codes (row layout only, see rm_dict.h)
+	int *dictAttrs;
+	SM_Codec codec;      // how the table's pages were stored (SM_CODEC_LZ: compressed, see sm_extent.h)
+	RM_PartScheme partScheme;  // store the table as numParts partitions by partAttr (see rm_partition.h)
+	int partAttr;
+	int numParts;
+	Value **partBounds;  // range partitions: the exclusive upper bound of each, ascending
+	bool inMemory;       // keep the pages in an arena of the process, with no page file (see rm_arena.h)
+} RM_TableOptions;
+
+// how a scan reached the records, chosen by cost when it started
+typedef enum RM_AccessPath {
+	RM_PATH_SEQ = 0,         // every data page
+	RM_PATH_ZONE = 1,        // the pages the zone map did not rule out
+	RM_PATH_INDEX = 2,       // one B+ tree key range, RIDs fetched in page order
+	RM_PATH_INTERSECT = 3    // the RIDs the key ranges of two B+ trees had in common
+} RM_AccessPath;
+
+// what explainScan and getScanPlan reported
+typedef struct RM_ScanPlan
+{
+	RM_AccessPath path;
+	int indexAttrs[2];   // attributes of the indexes used (-1 if none)
+	double estRows;      // tuples expected to satisfy the simple terms of the condition
+	double cost;         // estimated page reads (plus a little per tuple) of the chosen path
+	double seqCost;      // the same for reading every page
+	char text[256];      // one line describing the choice
+} RM_ScanPlan;
+
 // table and manager
 extern RC initRecordManager (void *mgmtData);
 extern RC shutdownRecordManager ();
+extern void initTableOptions (RM_TableOptions *options);
 extern RC createTable (char *name, Schema *schema);
+extern RC createTableWithOptions (char *name, Schema *schema, RM_TableOptions *options);
 extern RC openTable (RM_TableData *rel, char *name);
 extern RC closeTable (RM_TableData *rel);
 extern RC deleteTable (char *name);
 extern int getNumTuples (RM_TableData *rel);
+extern BTreeHandle *getTableIndex (RM_TableData *rel, int attrNum);
+extern RC vacuumTable (RM_TableData *rel);
+
+// partitions (see rm_partition.h); a partition was named by its position, 0 .. getNumPartitions - 1
+extern int getNumPartitions (RM_TableData *rel);
+extern RC getScanPartitions (RM_TableData *rel, Expr *cond, int *parts, int *numParts);
+extern RC startPartitionScan (RM_TableData *rel, int part, RM_ScanHandle *scan, Expr *cond);
+extern RC addPartition (RM_TableData *rel, Value *upperBound);
+extern RC dropPartition (RM_TableData *rel, int part);
+
+// statistics for cardinality estimates (see rm_stats.h)
+extern RC analyzeTable (RM_TableData *rel);
+extern RC getAttrStats (RM_TableData *rel, int attrNum, RM_AttrStats *stats);
+extern double estimateSelectivity (RM_TableData *rel, AttrPredicate *pred);
+
+// snapshot reads (see rm_version.h)
+typedef long long RM_Timestamp;
+
+typedef struct RM_Snapshot
+{
+	RM_Timestamp readTs;   // the snapshot saw every write stamped up to this
+} RM_Snapshot;
+
+extern RC beginSnapshot (RM_Snapshot *snapshot);
+extern RC endSnapshot (RM_Snapshot *snapshot);
+extern RC getRecordAsOf (RM_TableData *rel, RID id, Record *record, RM_Snapshot *snapshot);
+extern RC startScanAsOf (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond, RM_Snapshot *snapshot);
+extern int getNumVersions (RM_TableData *rel);
+
+// durability (see wal_mgr.h)
+extern RC attachTableLog (RM_TableData *rel, WAL_Log *log);
+extern RC commitTable (RM_TableData *rel);
 
 // handling records in a table
 extern RC insertRecord (RM_TableData *rel, Record *record);
+extern RC insertRecords (RM_TableData *rel, char *recData, int numRecords, RID *ids);
 extern RC deleteRecord (RM_TableData *rel, RID id);
 extern RC updateRecord (RM_TableData *rel, Record *record);
 extern RC getRecord (RM_TableData *rel, RID id, Record *record);
 
 // scans
 extern RC startScan (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond);
+extern RC startScanProjection (RM_TableData *rel, RM_ScanHandle *scan, Expr *cond, int numAttrs, int *attrs);
 extern RC next (RM_ScanHandle *scan, Record *record);
 extern RC closeScan (RM_ScanHandle *scan);
+extern RC explainScan (RM_TableData *rel, Expr *cond, RM_ScanPlan *plan);
+extern RC getScanPlan (RM_ScanHandle *scan, RM_ScanPlan *plan);
+
+// zero-copy reads: a record read where it lay, on its page kept pinned and latched until released
+typedef struct RM_RecordView
+{
+	RID id;
+	RM_TableData *rel;   // the table the record was in (its partition, for a partitioned table)
+	char *stored;        // row tables: the stored record on the page
+	int paxSlot;         // PAX tables: the record's slot on the page (-1 otherwise)
+	char *data;          // snapshot scans: the record in record->data layout, in the scan's batch
+	BM_PageHandle page;
+	bool pinned;         // page was held until releaseRecordView
+} RM_RecordView;
+
+extern RC getRecordView (RM_TableData *rel, RID id, RM_RecordView *view);
+extern RC nextView (RM_ScanHandle *scan, RM_RecordView *view);
+extern RC releaseRecordView (RM_RecordView *view);
+extern int getViewInt (RM_RecordView *view, int attrNum);
+extern float getViewFloat (RM_RecordView *view, int attrNum);
+extern const char *getViewString (RM_RecordView *view, int attrNum, int *len);
+
+// large objects (DT_BLOB attributes held their ids), read and written a piece at a time
+typedef struct RM_BlobHandle
+{
+	RM_TableData *rel;
+	int id;              // what a DT_BLOB attribute held to refer to the object
+	void *mgmtData;
+} RM_BlobHandle;
+
+extern RC createBlob (RM_TableData *rel, RM_BlobHandle *blob);
+extern RC openBlob (RM_TableData *rel, int id, RM_BlobHandle *blob);
+extern RC readBlob (RM_BlobHandle *blob, char *buf, int len, int *numRead);
+extern RC writeBlob (RM_BlobHandle *blob, char *buf, int len);
+extern RC seekBlob (RM_BlobHandle *blob, long long offset);
+extern long long getBlobSize (RM_BlobHandle *blob);
+extern RC closeBlob (RM_BlobHandle *blob);
+extern RC deleteBlob (RM_TableData *rel, int id);
 
 // dealing with schemas
 extern int getRecordSize (Schema *schema);
+extern int getAttrSize (Schema *schema, int attrNum);
 extern Schema *createSchema (int numAttr, char **attrNames, DataType *dataTypes, int *typeLength, int keySize, int *keys);
 extern RC freeSchema (Schema *schema);
 
@@ -43,4 +166,10 @@ extern RC freeRecord (Record *record);
 extern RC getAttr (Record *record, Schema *schema, int attrNum, Value **value);
 extern RC setAttr (Record *record, Schema *schema, int attrNum, Value *value);
 
+// allocation-free attribute access (strings are copied into out->v.stringV, which must hold typeLength + 1 bytes)
+extern RC getAttrInto (Record *record, Schema *schema, int attrNum, Value *out);
+extern int getIntAttr (Record *record, Schema *schema, int attrNum);
+extern float getFloatAttr (Record *record, Schema *schema, int attrNum);
+extern const char *getStringAttr (Record *record, Schema *schema, int attrNum, int *len);
+
 #endif // RECORD_MGR_H
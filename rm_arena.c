@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rm_arena.h"
+#include "dberror.h"
+
+/*
+ * rm_arena.c
+ * ---------------------------------------------------------------
+ * The arenas that held the pages of in-memory tables, and the list of them
+ * by table name. See rm_arena.h.
+ */
+
+/* The arenas of the process. */
+static RM_Arena *arenas = NULL;
+static pthread_mutex_t arenasLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * findArena
+ * ---------
+ * Returned the arena of a table, or NULL. arenasLock had to be held.
+ */
+static RM_Arena *findArena(char *name)
+{
+    for (RM_Arena *a = arenas; a != NULL; a = a->next)
+        if (strcmp(a->name, name) == 0)
+            return a;
+    return NULL;
+}
+
+/*
+ * freeChunks
+ * ----------
+ * Gave back the chunks from chunk 'from' on.
+ */
+static void freeChunks(RM_Arena *arena, int from)
+{
+    for (int c = from; c < RM_ARENA_MAX_CHUNKS; c++)
+    {
+        char *chunk = atomic_exchange(&arena->chunks[c], NULL);
+        free(chunk);
+    }
+}
+
+/*
+ * rmArenaCreate
+ * -------------
+ * Created an empty arena for a table and opened it. An arena the table
+ * already had was emptied instead, as createPageFile emptied a page file.
+ */
+RM_Arena *rmArenaCreate(char *name)
+{
+    pthread_mutex_lock(&arenasLock);
+    RM_Arena *arena = findArena(name);
+    if (arena != NULL)
+    {
+        freeChunks(arena, 0);
+        atomic_store(&arena->numPages, 0);
+    }
+    else
+    {
+        arena = (RM_Arena *) calloc(1, sizeof(RM_Arena));
+        arena->name = strdup(name);
+        pthread_mutex_init(&arena->lock, NULL);
+        arena->next = arenas;
+        arenas = arena;
+    }
+    arena->refCount++;
+    pthread_mutex_unlock(&arenasLock);
+    return arena;
+}
+
+/*
+ * rmArenaOpen
+ * -----------
+ * Opened the arena of a table, or returned NULL if the table had none (it was
+ * kept in a page file, or did not exist).
+ */
+RM_Arena *rmArenaOpen(char *name)
+{
+    pthread_mutex_lock(&arenasLock);
+    RM_Arena *arena = findArena(name);
+    if (arena != NULL)
+        arena->refCount++;
+    pthread_mutex_unlock(&arenasLock);
+    return arena;
+}
+
+/*
+ * rmArenaClose
+ * ------------
+ * Closed an arena. Its pages stayed until rmArenaDrop.
+ */
+void rmArenaClose(RM_Arena *arena)
+{
+    pthread_mutex_lock(&arenasLock);
+    arena->refCount--;
+    pthread_mutex_unlock(&arenasLock);
+}
+
+/*
+ * rmArenaDrop
+ * -----------
+ * Freed the arena of a table. Returned false if the table had none. The
+ * table had to be closed.
+ */
+bool rmArenaDrop(char *name)
+{
+    pthread_mutex_lock(&arenasLock);
+    RM_Arena **link = &arenas;
+    while (*link != NULL && strcmp((*link)->name, name) != 0)
+        link = &(*link)->next;
+    RM_Arena *arena = *link;
+    if (arena != NULL)
+        *link = arena->next;
+    pthread_mutex_unlock(&arenasLock);
+    if (arena == NULL)
+        return false;
+
+    freeChunks(arena, 0);
+    pthread_mutex_destroy(&arena->lock);
+    free(arena->name);
+    free(arena);
+    return true;
+}
+
+/*
+ * rmArenaPage
+ * -----------
+ * Returned where a page lay, allocating its chunk (zeroed) the first time.
+ * The lock was only taken to allocate.
+ */
+char *rmArenaPage(RM_Arena *arena, int pageNum)
+{
+    int c = pageNum / RM_ARENA_CHUNK;
+    if (pageNum < 0 || c >= RM_ARENA_MAX_CHUNKS)
+        return NULL;
+
+    char *chunk = atomic_load(&arena->chunks[c]);
+    if (chunk == NULL || pageNum >= atomic_load(&arena->numPages))
+    {
+        pthread_mutex_lock(&arena->lock);
+        chunk = atomic_load(&arena->chunks[c]);
+        if (chunk == NULL)
+        {
+            chunk = (char *) calloc(RM_ARENA_CHUNK, PAGE_SIZE);
+            atomic_store(&arena->chunks[c], chunk);
+        }
+        if (chunk != NULL && pageNum >= atomic_load(&arena->numPages))
+            atomic_store(&arena->numPages, pageNum + 1);
+        pthread_mutex_unlock(&arena->lock);
+        if (chunk == NULL)
+            return NULL;
+    }
+    return chunk + (size_t) (pageNum % RM_ARENA_CHUNK) * PAGE_SIZE;
+}
+
+/*
+ * rmArenaNumPages
+ * ---------------
+ * Returned one past the highest page used, like the size of a page file.
+ */
+int rmArenaNumPages(RM_Arena *arena)
+{
+    return atomic_load(&arena->numPages);
+}
+
+/*
+ * rmArenaTruncate
+ * ---------------
+ * Cut an arena back to numPages pages: the chunks past them were freed and
+ * the rest of the last chunk zeroed, so pages used again started out empty.
+ * Nobody could be using the pages that went.
+ */
+void rmArenaTruncate(RM_Arena *arena, int numPages)
+{
+    pthread_mutex_lock(&arena->lock);
+    if (numPages < atomic_load(&arena->numPages))
+    {
+        int keep = (numPages + RM_ARENA_CHUNK - 1) / RM_ARENA_CHUNK;
+        freeChunks(arena, keep);
+        char *last = (numPages % RM_ARENA_CHUNK != 0) ? atomic_load(&arena->chunks[keep - 1]) : NULL;
+        if (last != NULL)
+            memset(last + (size_t) (numPages % RM_ARENA_CHUNK) * PAGE_SIZE, 0,
+                   (size_t) (RM_ARENA_CHUNK - numPages % RM_ARENA_CHUNK) * PAGE_SIZE);
+        atomic_store(&arena->numPages, numPages);
+    }
+    pthread_mutex_unlock(&arena->lock);
+}
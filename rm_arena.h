@@ -0,0 +1,48 @@
+#ifndef RM_ARENA_H
+#define RM_ARENA_H
+
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "dberror.h"
+
+/*
+ * In-memory tables (RM_TableOptions.inMemory).
+ *
+ * An in-memory table kept its pages in an arena of the process instead of a
+ * page file. The arena handed out RM_ARENA_CHUNK pages at a time, zeroed, the
+ * first time one of them was used, and a chunk never moved afterwards: the
+ * record manager read and changed a page where it lay, with no buffer pool
+ * and no file I/O in between, and a RID (page, slot) pointed into the same
+ * memory for the life of the table. The pages had the same layout as the
+ * pages of a page file, page 0 included.
+ *
+ * Arenas were found by table name, so a table closed and opened again within
+ * the process still had its records; deleteTable freed the arena. Nothing was
+ * written to disk or logged, so nothing survived the process.
+ */
+
+#define RM_ARENA_CHUNK          256     /* pages per chunk (1 MB) */
+#define RM_ARENA_MAX_CHUNKS     4096    /* so at most 4 GB per table */
+
+typedef struct RM_Arena {
+    char *name;
+    _Atomic(char *) chunks[RM_ARENA_MAX_CHUNKS];   /* NULL until a page in it was used */
+    atomic_int numPages;    /* one past the highest page used */
+    int refCount;           /* open tables using the arena */
+    pthread_mutex_t lock;   /* allocating chunks */
+    struct RM_Arena *next;
+} RM_Arena;
+
+// the arenas of the process, by table name
+extern RM_Arena *rmArenaCreate (char *name);
+extern RM_Arena *rmArenaOpen (char *name);
+extern void rmArenaClose (RM_Arena *arena);
+extern bool rmArenaDrop (char *name);
+
+// pages (NULL past RM_ARENA_MAX_CHUNKS chunks)
+extern char *rmArenaPage (RM_Arena *arena, int pageNum);
+extern int rmArenaNumPages (RM_Arena *arena);
+extern void rmArenaTruncate (RM_Arena *arena, int numPages);
+
+#endif // RM_ARENA_H
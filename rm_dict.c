@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rm_dict.h"
+#include "dberror.h"
+
+/*
+ * rm_dict.c
+ * ---------------------------------------------------------------
+ * In-memory side of the string dictionaries of a table: codes to values
+ * through fixed blocks, values to codes through a hash table. The record
+ * manager loaded a dictionary from its pages when the table was opened and
+ * wrote every new value back right away. See rm_dict.h.
+ */
+
+/*
+ * hashValue
+ * ---------
+ * Hashed the first len bytes of a value (FNV-1a).
+ */
+static unsigned hashValue(const char *value, int len)
+{
+    unsigned h = 2166136261u;
+    for (int i = 0; i < len; i++)
+        h = (h ^ (unsigned char) value[i]) * 16777619u;
+    return h;
+}
+
+/*
+ * sameValue
+ * ---------
+ * Told whether a zero padded dictionary value was the string value[0..len).
+ */
+static int sameValue(RM_Dictionary *dict, char *stored, const char *value, int len)
+{
+    return memcmp(stored, value, len) == 0 && (len == dict->width || stored[len] == '\0');
+}
+
+/*
+ * bucketOf
+ * --------
+ * Returned the bucket holding a value's code, or the empty bucket where it
+ * belonged.
+ */
+static int bucketOf(RM_Dictionary *dict, const char *value, int len)
+{
+    int mask = dict->hashSize - 1;
+    int b = (int) (hashValue(value, len) & (unsigned) mask);
+
+    while (dict->hash[b] >= 0 && !sameValue(dict, rmDictValue(dict, dict->hash[b]), value, len))
+        b = (b + 1) & mask;
+    return b;
+}
+
+/*
+ * growHash
+ * --------
+ * Doubled the hash table and put every code back in.
+ */
+static void growHash(RM_Dictionary *dict)
+{
+    free(dict->hash);
+    dict->hashSize *= 2;
+    dict->hash = (int *) malloc(dict->hashSize * sizeof(int));
+    memset(dict->hash, 0xff, dict->hashSize * sizeof(int));
+
+    for (int code = 0; code < dict->numCodes; code++)
+    {
+        char *v = rmDictValue(dict, code);
+        dict->hash[bucketOf(dict, v, (int) strnlen(v, dict->width))] = code;
+    }
+}
+
+/*
+ * rmDictInit
+ * ----------
+ * Set up an empty dictionary for an attribute of the given typeLength.
+ */
+void rmDictInit(RM_Dictionary *dict, int attrNum, int width)
+{
+    dict->attrNum   = attrNum;
+    dict->width     = width;
+    dict->numCodes  = 0;
+    memset(dict->blocks, 0, sizeof(dict->blocks));
+    dict->hashSize  = 64;
+    dict->hash      = (int *) malloc(dict->hashSize * sizeof(int));
+    memset(dict->hash, 0xff, dict->hashSize * sizeof(int));
+    dict->firstPage = -1;
+    dict->lastPage  = -1;
+}
+
+/*
+ * rmDictFree
+ * ----------
+ * Released the memory of a dictionary.
+ */
+void rmDictFree(RM_Dictionary *dict)
+{
+    for (int b = 0; b < RM_DICT_MAX_CODES / RM_DICT_BLOCK; b++)
+        free(dict->blocks[b]);
+    free(dict->hash);
+    memset(dict->blocks, 0, sizeof(dict->blocks));
+    dict->hash     = NULL;
+    dict->numCodes = 0;
+}
+
+/*
+ * rmDictFind
+ * ----------
+ * Returned the code of the string value[0..len), or -1 if the dictionary did
+ * not hold it (a string longer than the attribute never matched).
+ */
+int rmDictFind(RM_Dictionary *dict, const char *value, int len)
+{
+    if (len > dict->width)
+        return -1;
+    return dict->hash[bucketOf(dict, value, len)];
+}
+
+/*
+ * rmDictAdd
+ * ---------
+ * Returned the code of the string value[0..len), giving it the next code if
+ * it was new. Returned -1 if it was new and every code was taken.
+ */
+int rmDictAdd(RM_Dictionary *dict, const char *value, int len)
+{
+    if (len > dict->width)
+        return -1;
+
+    int b = bucketOf(dict, value, len);
+    if (dict->hash[b] >= 0)
+        return dict->hash[b];
+    if (dict->numCodes == RM_DICT_MAX_CODES)
+        return -1;
+
+    // The value went in first, so whoever saw the code could read it
+    int code = dict->numCodes;
+    char **block = &dict->blocks[code / RM_DICT_BLOCK];
+    if (*block == NULL)
+        *block = (char *) calloc(RM_DICT_BLOCK, dict->width > 0 ? dict->width : 1);
+    memcpy(*block + (code % RM_DICT_BLOCK) * dict->width, value, len);
+    dict->numCodes++;
+
+    dict->hash[b] = code;
+    if (2 * dict->numCodes > dict->hashSize)
+        growHash(dict);
+    return code;
+}
+
+/*
+ * rmDictDropLast
+ * --------------
+ * Took back the newest code, whose value could not be written out. Nothing
+ * added earlier had probed past its bucket, so emptying the bucket was enough.
+ */
+void rmDictDropLast(RM_Dictionary *dict)
+{
+    if (dict->numCodes == 0)
+        return;
+
+    int code = dict->numCodes - 1;
+    char *v = rmDictValue(dict, code);
+    dict->hash[bucketOf(dict, v, (int) strnlen(v, dict->width))] = -1;
+    memset(v, 0, dict->width);
+    dict->numCodes--;
+}
+
+/*
+ * rmDictValue
+ * -----------
+ * Returned the value of a code, zero padded to the attribute's width.
+ */
+char *rmDictValue(RM_Dictionary *dict, int code)
+{
+    return dict->blocks[code / RM_DICT_BLOCK] + (code % RM_DICT_BLOCK) * dict->width;
+}
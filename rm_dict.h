@@ -0,0 +1,43 @@
+#ifndef RM_DICT_H
+#define RM_DICT_H
+
+#include "dberror.h"
+
+/*
+ * Dictionaries for DT_STRING attributes with few distinct values.
+ *
+ * A dictionary-encoded attribute was stored as an unsigned short code instead
+ * of its string; code c stood for the c-th distinct value the table had seen.
+ * Values were kept zero padded to the attribute's typeLength, in blocks of
+ * RM_DICT_BLOCK values that never moved once allocated, so the value of a code
+ * could be read without a lock by anyone who had seen the code in a record.
+ * Finding and adding codes went through a hash table and had to be serialized
+ * by the caller.
+ *
+ * The record manager kept each dictionary in a chain of RM_PAGE_DICT pages
+ * (see rm_page.h) and appended a value there as soon as it got its code.
+ */
+
+// a code took two bytes in a stored record
+#define RM_DICT_MAX_CODES 65536
+#define RM_DICT_BLOCK     256
+
+typedef struct RM_Dictionary {
+    int attrNum;        /* the encoded attribute */
+    int width;          /* its typeLength */
+    int numCodes;
+    char *blocks[RM_DICT_MAX_CODES / RM_DICT_BLOCK];
+    int *hash;          /* open addressing: a code per bucket, -1 if empty */
+    int hashSize;
+    int firstPage;      /* the chain of the dictionary's pages (kept by the record manager) */
+    int lastPage;
+} RM_Dictionary;
+
+extern void rmDictInit (RM_Dictionary *dict, int attrNum, int width);
+extern void rmDictFree (RM_Dictionary *dict);
+extern int rmDictFind (RM_Dictionary *dict, const char *value, int len);
+extern int rmDictAdd (RM_Dictionary *dict, const char *value, int len);
+extern void rmDictDropLast (RM_Dictionary *dict);
+extern char *rmDictValue (RM_Dictionary *dict, int code);
+
+#endif // RM_DICT_H
@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "rm_page.h"
+#include "dberror.h"
+
+/*
+ * rm_page.c
+ * ---------------------------------------------------------------
+ * Operations on a single slotted heap page or PAX page that was already
+ * pinned by the caller. None of these functions touched the buffer pool;
+ * the caller marked the page dirty afterwards. See rm_page.h for the page layout.
+ */
+
+/*
+ * rmInitPage
+ * ----------
+ * Formatted a page buffer as an empty page of the given type.
+ */
+void rmInitPage(char *data, int pageType)
+{
+    memset(data, 0, PAGE_SIZE);
+    RM_PageHeader *hdr = RM_PAGE_HDR(data);
+    hdr->pageType   = pageType;
+    hdr->nextPage   = -1;
+    hdr->numSlots   = 0;
+    hdr->slotsUsed  = 0;
+    hdr->freeOffset = PAGE_SIZE;
+    hdr->dataLen    = 0;
+}
+
+/*
+ * liveBytes
+ * ---------
+ * Summed the lengths of all records that were still referenced by a slot.
+ */
+static int liveBytes(char *data)
+{
+    RM_PageHeader *hdr = RM_PAGE_HDR(data);
+    RM_Slot *slots = RM_PAGE_SLOTS(data);
+    int total = 0;
+    for (int i = 0; i < hdr->numSlots; i++)
+        if (slots[i].offset != 0)
+            total += slots[i].length;
+    return total;
+}
+
+/*
+ * slotForInsert
+ * -------------
+ * Returned the first free slot directory entry, or numSlots if a new entry
+ * had to be appended.
+ */
+static int slotForInsert(char *data)
+{
+    RM_PageHeader *hdr = RM_PAGE_HDR(data);
+    RM_Slot *slots = RM_PAGE_SLOTS(data);
+    if (hdr->slotsUsed < hdr->numSlots)
+    {
+        for (int i = 0; i < hdr->numSlots; i++)
+            if (slots[i].offset == 0)
+                return i;
+    }
+    return hdr->numSlots;
+}
+
+/*
+ * rmPageFreeSpace
+ * ---------------
+ * Returned the length of the largest record that could still be inserted,
+ * counting the holes that compaction would reclaim and the slot entry the
+ * insert might need.
+ */
+int rmPageFreeSpace(char *data)
+{
+    RM_PageHeader *hdr = RM_PAGE_HDR(data);
+    int dirBytes = (int) sizeof(RM_PageHeader) + hdr->numSlots * (int) sizeof(RM_Slot);
+    if (slotForInsert(data) == hdr->numSlots)
+        dirBytes += sizeof(RM_Slot);
+
+    int space = PAGE_SIZE - dirBytes - liveBytes(data);
+    return (space > 0) ? space : 0;
+}
+
+/*
+ * rmPageCompact
+ * -------------
+ * Moved all live records to the end of the page so the free space became one
+ * contiguous block again. Slot numbers (and therefore RIDs) did not change.
+ * Trailing free slot entries were dropped from the directory.
+ */
+void rmPageCompact(char *data)
+{
+    RM_PageHeader *hdr = RM_PAGE_HDR(data);
+    RM_Slot *slots = RM_PAGE_SLOTS(data);
+    char tmp[PAGE_SIZE];
+    int end = PAGE_SIZE;
+
+    memcpy(tmp, data, PAGE_SIZE);
+    for (int i = 0; i < hdr->numSlots; i++)
+    {
+        if (slots[i].offset == 0)
+            continue;
+        end -= slots[i].length;
+        memcpy(data + end, tmp + slots[i].offset, slots[i].length);
+        slots[i].offset = (unsigned short) end;
+    }
+    hdr->freeOffset = end;
+
+    while (hdr->numSlots > 0 && slots[hdr->numSlots - 1].offset == 0)
+        hdr->numSlots--;
+}
+
+/*
+ * rmPageInsert
+ * ------------
+ * Stored 'len' bytes as a new record on the page, compacting it first if the
+ * contiguous free space was too fragmented. Returned the slot number, or -1 if
+ * the record did not fit.
+ */
+int rmPageInsert(char *data, char *rec, int len)
+{
+    RM_PageHeader *hdr = RM_PAGE_HDR(data);
+
+    if (rmPageFreeSpace(data) < len)
+        return -1;
+
+    int slot = slotForInsert(data);
+    int dirEnd = (int) sizeof(RM_PageHeader)
+               + ((slot == hdr->numSlots) ? hdr->numSlots + 1 : hdr->numSlots) * (int) sizeof(RM_Slot);
+    if (hdr->freeOffset - dirEnd < len)
+    {
+        rmPageCompact(data);
+        slot = slotForInsert(data);
+    }
+
+    RM_Slot *slots = RM_PAGE_SLOTS(data);
+    if (slot == hdr->numSlots)
+        hdr->numSlots++;
+
+    hdr->freeOffset -= len;
+    memcpy(data + hdr->freeOffset, rec, len);
+    slots[slot].offset = (unsigned short) hdr->freeOffset;
+    slots[slot].length = (unsigned short) len;
+    hdr->slotsUsed++;
+    return slot;
+}
+
+/*
+ * rmPageReplace
+ * -------------
+ * Overwrote the record in 'slot' with new bytes. A record that shrank stayed
+ * where it was; one that grew was rewritten into the free space (compacting if
+ * needed). Returned RC_RM_PAGE_FULL, leaving the page untouched, if the new
+ * version did not fit on this page.
+ */
+RC rmPageReplace(char *data, int slot, char *rec, int len)
+{
+    RM_PageHeader *hdr = RM_PAGE_HDR(data);
+    RM_Slot *slots = RM_PAGE_SLOTS(data);
+
+    if (len <= slots[slot].length)
+    {
+        memcpy(data + slots[slot].offset, rec, len);
+        slots[slot].length = (unsigned short) len;
+        return RC_OK;
+    }
+
+    // Space if the old version was gone (the slot entry itself stays)
+    int dirBytes = (int) sizeof(RM_PageHeader) + hdr->numSlots * (int) sizeof(RM_Slot);
+    if (PAGE_SIZE - dirBytes - liveBytes(data) + slots[slot].length < len)
+        return RC_RM_PAGE_FULL;
+
+    // Released the old version, keeping the directory entry for this slot
+    slots[slot].offset = 0;
+    if (hdr->freeOffset - dirBytes < len)
+    {
+        int savedSlots = hdr->numSlots;
+        rmPageCompact(data);
+        hdr->numSlots = savedSlots;
+    }
+
+    hdr->freeOffset -= len;
+    memcpy(data + hdr->freeOffset, rec, len);
+    slots[slot].offset = (unsigned short) hdr->freeOffset;
+    slots[slot].length = (unsigned short) len;
+    return RC_OK;
+}
+
+/*
+ * rmPageDelete
+ * ------------
+ * Freed a slot. If the record was the lowest one in the record area, its
+ * bytes went straight back to the contiguous free space.
+ */
+void rmPageDelete(char *data, int slot)
+{
+    RM_PageHeader *hdr = RM_PAGE_HDR(data);
+    RM_Slot *slots = RM_PAGE_SLOTS(data);
+
+    if (slot < 0 || slot >= hdr->numSlots || slots[slot].offset == 0)
+        return;
+
+    if (slots[slot].offset == hdr->freeOffset)
+        hdr->freeOffset += slots[slot].length;
+    slots[slot].offset = 0;
+    slots[slot].length = 0;
+    hdr->slotsUsed--;
+
+    while (hdr->numSlots > 0 && slots[hdr->numSlots - 1].offset == 0)
+        hdr->numSlots--;
+}
+
+/*
+ * rmPageRecord
+ * ------------
+ * Returned a pointer to the stored bytes of a slot and their length, or NULL
+ * if the slot was free or out of range.
+ */
+char *rmPageRecord(char *data, int slot, int *len)
+{
+    RM_PageHeader *hdr = RM_PAGE_HDR(data);
+    RM_Slot *slots = RM_PAGE_SLOTS(data);
+
+    if (hdr->pageType != RM_PAGE_HEAP || slot < 0 || slot >= hdr->numSlots || slots[slot].offset == 0)
+        return NULL;
+    if (len != NULL)
+        *len = slots[slot].length;
+    return data + slots[slot].offset;
+}
+
+/* --------------------------------------------------------------------------
+   PAX pages
+   -------------------------------------------------------------------------- */
+
+#define RM_ALIGN8(x)  (((x) + 7) & ~7)
+
+/*
+ * rmPaxLayout
+ * -----------
+ * Worked out how many records of this schema fit on a PAX page and where each
+ * attribute's minipage started (colStart needs numAttr entries). Returned 0 if
+ * not even one record fit.
+ */
+int rmPaxLayout(Schema *schema, int *colStart)
+{
+    int recSize  = schema->attrOffsets[schema->numAttr];
+    int overhead = (int) sizeof(RM_PageHeader) + 8 * (schema->numAttr + 1);
+    int capacity = (PAGE_SIZE - overhead) / (recSize + 1);
+
+    if (capacity < 1)
+        return 0;
+
+    int offset = RM_ALIGN8((int) sizeof(RM_PageHeader) + capacity);
+    for (int i = 0; i < schema->numAttr; i++)
+    {
+        colStart[i] = offset;
+        offset = RM_ALIGN8(offset + capacity * (schema->attrOffsets[i + 1] - schema->attrOffsets[i]));
+    }
+    return capacity;
+}
+
+/*
+ * rmPaxInit
+ * ---------
+ * Formatted an empty PAX page with room for 'capacity' records.
+ */
+void rmPaxInit(char *data, int capacity)
+{
+    rmInitPage(data, RM_PAGE_PAX);
+    RM_PAGE_HDR(data)->numSlots = capacity;
+}
+
+/*
+ * rmPaxWrite
+ * ----------
+ * Scattered the attributes of record->data into the minipages of one slot.
+ */
+void rmPaxWrite(char *data, Schema *schema, int *colStart, int slot, char *recData)
+{
+    for (int i = 0; i < schema->numAttr; i++)
+    {
+        int width = schema->attrOffsets[i + 1] - schema->attrOffsets[i];
+        memcpy(data + colStart[i] + slot * width, recData + schema->attrOffsets[i], width);
+    }
+}
+
+/*
+ * rmPaxRead
+ * ---------
+ * Gathered one attribute of a slot back into the fixed-width record layout.
+ */
+void rmPaxRead(char *data, Schema *schema, int *colStart, int slot, int attrNum, char *recData)
+{
+    int width = schema->attrOffsets[attrNum + 1] - schema->attrOffsets[attrNum];
+    memcpy(recData + schema->attrOffsets[attrNum], data + colStart[attrNum] + slot * width, width);
+}
+
+/*
+ * rmPaxInsert
+ * -----------
+ * Stored a record in the first unused slot. Returned the slot, or -1 if the
+ * page was full.
+ */
+int rmPaxInsert(char *data, Schema *schema, int *colStart, char *recData)
+{
+    RM_PageHeader *hdr = RM_PAGE_HDR(data);
+    char *used = RM_PAX_USED(data);
+
+    if (hdr->slotsUsed >= hdr->numSlots)
+        return -1;
+
+    char *freeSlot = memchr(used, 0, hdr->numSlots);
+    if (freeSlot == NULL)
+        return -1;
+
+    int slot = (int) (freeSlot - used);
+    rmPaxWrite(data, schema, colStart, slot, recData);
+    used[slot] = 1;
+    hdr->slotsUsed++;
+    return slot;
+}
+
+/*
+ * rmPaxDelete
+ * -----------
+ * Marked a slot of a PAX page as unused.
+ */
+void rmPaxDelete(char *data, int slot)
+{
+    char *used = RM_PAX_USED(data);
+    if (used[slot])
+    {
+        used[slot] = 0;
+        RM_PAGE_HDR(data)->slotsUsed--;
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef RM_PAGE_H
+#define RM_PAGE_H
+
+#include "dberror.h"
+#include "tables.h"
+
+/*
+ * Page formats used by the record manager for everything after page 0.
+ *
+ * Every page starts with an RM_PageHeader. Heap pages are slotted: the slot
+ * directory grows forward right after the header, the records are packed
+ * backwards from the end of the page, and freeOffset marks where the record
+ * area currently begins. A slot with offset 0 is free.
+ *
+ *   | header | slot 0 | slot 1 | ... -->      free      <-- ... | rec 1 | rec 0 |
+ *
+ * PAX pages (tables created with the RM_LAYOUT_PAX option) hold numSlots
+ * fixed-width records column by column: one "used" byte per slot, then one
+ * minipage per attribute, each starting on an 8-byte boundary. Value 's' of
+ * attribute 'i' lives at colStart[i] + s * width(i), see rmPaxLayout.
+ *
+ *   | header | used[numSlots] | attr 0 values | attr 1 values | ... |
+ *
+ * Overflow pages hold dataLen bytes of a value that did not fit into its
+ * record and link to the rest of the value through nextPage. Free pages are
+ * chained the same way, starting at the table's freePageHead. Dictionary
+ * pages (see rm_dict.h) are laid out like overflow pages: dataLen bytes of
+ * values, each an unsigned short length followed by its bytes, in code order
+ * along the chain.
+ *
+ * A large object (see createBlob) starts on an RM_PAGE_BLOB page holding its
+ * length and a directory: the page numbers of its data pages, in order, with
+ * dataLen entries. Once the directory is full, it goes on in RM_PAGE_BLOB_DIR
+ * pages chained through nextPage. The data pages are overflow pages, full
+ * except for the last one, and are not chained, so any offset of the object is
+ * found through the directory without reading the data before it.
+ */
+
+#define RM_PAGE_UNUSED    0   /* never formatted (a freshly appended block) */
+#define RM_PAGE_HEAP      1
+#define RM_PAGE_OVERFLOW  2
+#define RM_PAGE_FREE      3
+#define RM_PAGE_PAX       4
+#define RM_PAGE_DICT      5
+#define RM_PAGE_BLOB      6   /* first directory page of a large object */
+#define RM_PAGE_BLOB_DIR  7   /* further directory pages of a large object */
+
+typedef struct RM_PageHeader {
+    int pageType;     /* one of the RM_PAGE_* values above */
+    int nextPage;     /* next page of an overflow/free/dictionary/directory chain, -1 at the end */
+    int numSlots;     /* entries in the slot directory (heap pages) */
+    int slotsUsed;    /* live entries in the slot directory (heap pages) */
+    int freeOffset;   /* first byte of the record area (heap pages) */
+    int dataLen;      /* payload bytes on this page (overflow and dictionary pages),
+                         or directory entries (large object pages) */
+} RM_PageHeader;
+
+typedef struct RM_Slot {
+    unsigned short offset;   /* 0 => the slot is free */
+    unsigned short length;
+} RM_Slot;
+
+#define RM_PAGE_HDR(data)          ((RM_PageHeader *) (data))
+#define RM_PAGE_SLOTS(data)        ((RM_Slot *) ((data) + sizeof(RM_PageHeader)))
+#define RM_PAX_USED(data)          ((data) + sizeof(RM_PageHeader))
+#define RM_OVERFLOW_DATA(data)     ((data) + sizeof(RM_PageHeader))
+#define RM_OVERFLOW_CAPACITY       (PAGE_SIZE - (int) sizeof(RM_PageHeader))
+#define RM_BLOB_LENGTH(data)       ((long long *) ((data) + sizeof(RM_PageHeader)))
+#define RM_BLOB_PAGES(data)        ((int *) ((data) + sizeof(RM_PageHeader) + sizeof(long long)))
+#define RM_BLOB_DIR_ENTRIES        ((PAGE_SIZE - (int) sizeof(RM_PageHeader) - (int) sizeof(long long)) / (int) sizeof(int))
+
+/* The largest stored record that still fits on an otherwise empty heap page. */
+#define RM_MAX_STORED_RECORD       (PAGE_SIZE - (int) sizeof(RM_PageHeader) - (int) sizeof(RM_Slot))
+
+/*
+ * Stored records start with one flag byte:
+ *  - RM_REC_NORMAL : the record body follows.
+ *  - RM_REC_FORWARD: the record grew out of its page; a RID pointing at its
+ *                    new location follows. The RID of the record stays the same.
+ *  - RM_REC_MOVED  : the target of a forward. The home RID follows, then the body.
+ * Stored records are never shorter than a forward stub, so any record can be
+ * turned into one in place.
+ */
+#define RM_REC_NORMAL   0
+#define RM_REC_FORWARD  1
+#define RM_REC_MOVED    2
+
+#define RM_MIN_STORED_RECORD  (1 + (int) sizeof(RID))
+
+/* page-level helpers */
+extern void rmInitPage (char *data, int pageType);
+extern int rmPageFreeSpace (char *data);
+extern int rmPageInsert (char *data, char *rec, int len);
+extern RC rmPageReplace (char *data, int slot, char *rec, int len);
+extern void rmPageDelete (char *data, int slot);
+extern void rmPageCompact (char *data);
+extern char *rmPageRecord (char *data, int slot, int *len);
+
+/* PAX page helpers; colStart comes from rmPaxLayout */
+extern int rmPaxLayout (Schema *schema, int *colStart);
+extern void rmPaxInit (char *data, int capacity);
+extern int rmPaxInsert (char *data, Schema *schema, int *colStart, char *recData);
+extern void rmPaxWrite (char *data, Schema *schema, int *colStart, int slot, char *recData);
+extern void rmPaxRead (char *data, Schema *schema, int *colStart, int slot, int attrNum, char *recData);
+extern void rmPaxDelete (char *data, int slot);
+
+#endif // RM_PAGE_H
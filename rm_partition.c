@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rm_partition.h"
+#include "dberror.h"
+
+/*
+ * rm_partition.c
+ * ---------------------------------------------------------------
+ * The partition list of a partitioned table, and which partitions a key or a
+ * scan condition reached. The record manager opened the partitions and moved
+ * records between them and the caller; see rm_partition.h.
+ */
+
+/*
+ * rmPartInit
+ * ----------
+ * Set up an empty partition list.
+ */
+void rmPartInit(RM_PartitionSet *ps, RM_PartScheme scheme, int attr, DataType dt)
+{
+    ps->scheme   = scheme;
+    ps->attr     = attr;
+    ps->dt       = dt;
+    ps->numParts = 0;
+    ps->cap      = 0;
+    ps->parts    = NULL;
+    ps->tables   = NULL;
+    ps->nextId   = 0;
+}
+
+/*
+ * rmPartFree
+ * ----------
+ * Released the list (the tables had to be closed by then).
+ */
+void rmPartFree(RM_PartitionSet *ps)
+{
+    free(ps->parts);
+    free(ps->tables);
+    ps->parts    = NULL;
+    ps->tables   = NULL;
+    ps->numParts = 0;
+    ps->cap      = 0;
+}
+
+/*
+ * rmPartAdd
+ * ---------
+ * Appended a partition with the next id and no bounds, and returned it.
+ */
+RM_Partition *rmPartAdd(RM_PartitionSet *ps)
+{
+    if (ps->numParts == ps->cap)
+    {
+        ps->cap    = (ps->cap > 0) ? 2 * ps->cap : 8;
+        ps->parts  = (RM_Partition *) realloc(ps->parts, ps->cap * sizeof(RM_Partition));
+        ps->tables = (RM_TableData **) realloc(ps->tables, ps->cap * sizeof(RM_TableData *));
+    }
+    RM_Partition *p = &ps->parts[ps->numParts];
+    memset(p, 0, sizeof(RM_Partition));
+    p->id = ps->nextId++;
+    ps->tables[ps->numParts] = NULL;
+    ps->numParts++;
+    return p;
+}
+
+/*
+ * rmPartRemove
+ * ------------
+ * Took a partition out of the list, keeping the others in order.
+ */
+void rmPartRemove(RM_PartitionSet *ps, int pos)
+{
+    int after = ps->numParts - pos - 1;
+    memmove(&ps->parts[pos], &ps->parts[pos + 1], after * sizeof(RM_Partition));
+    memmove(&ps->tables[pos], &ps->tables[pos + 1], after * sizeof(RM_TableData *));
+    ps->numParts--;
+}
+
+/*
+ * rmPartFind
+ * ----------
+ * Returned the position of the partition with an id, or -1 if it was gone.
+ */
+int rmPartFind(RM_PartitionSet *ps, int id)
+{
+    for (int i = 0; i < ps->numParts; i++)
+        if (ps->parts[i].id == id)
+            return i;
+    return -1;
+}
+
+/*
+ * rmPartFileName
+ * --------------
+ * Built the page file name of a partition: "<table>.p<id>".
+ */
+void rmPartFileName(char *table, int id, char *buf, size_t size)
+{
+    snprintf(buf, size, "%s.p%d", table, id);
+}
+
+/*
+ * rmPartKey
+ * ---------
+ * Returned the range key of a DT_INT or DT_FLOAT value.
+ */
+double rmPartKey(Value *value)
+{
+    return (value->dt == DT_FLOAT) ? (double) value->v.floatV : (double) value->v.intV;
+}
+
+/*
+ * rmPartHash
+ * ----------
+ * Hashed the raw bytes of a key (FNV-1a); strings without their padding.
+ * A float -0.0 was hashed as 0.0, since the two compared equal.
+ */
+unsigned rmPartHash(DataType dt, const char *raw, int len)
+{
+    float f;
+    if (dt == DT_FLOAT && len == (int) sizeof(float))
+    {
+        memcpy(&f, raw, sizeof(float));
+        if (f == 0.0f)
+            f = 0.0f;
+        raw = (const char *) &f;
+    }
+
+    unsigned h = 2166136261u;
+    for (int i = 0; i < len; i++)
+        h = (h ^ (unsigned char) raw[i]) * 16777619u;
+    return h ^ (unsigned) dt;
+}
+
+/*
+ * rmPartRouteKey
+ * --------------
+ * Returned the position of the partition that held a key: by its hash for
+ * hash partitions, by its range key otherwise.
+ */
+int rmPartRouteKey(RM_PartitionSet *ps, double key, unsigned hash)
+{
+    if (ps->numParts == 0)
+        return -1;
+    if (ps->scheme == RM_PART_HASH)
+        return (int) (hash % (unsigned) ps->numParts);
+
+    for (int i = 0; i < ps->numParts; i++)
+    {
+        RM_Partition *p = &ps->parts[i];
+        if ((!p->hasLow || key >= p->low) && (!p->hasHigh || key < p->high))
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * rangeRuledOut
+ * -------------
+ * Told whether no key of a range partition could satisfy "attr op key".
+ */
+static bool rangeRuledOut(RM_Partition *p, CompOp op, double key)
+{
+    switch (op)
+    {
+        case COMP_EQ:
+            return (p->hasLow && key < p->low) || (p->hasHigh && key >= p->high);
+        case COMP_LT:
+            return p->hasLow && p->low >= key;
+        case COMP_LE:
+            return p->hasLow && p->low > key;
+        case COMP_GT:
+        case COMP_GE:
+            return p->hasHigh && p->high <= key;
+    }
+    return false;
+}
+
+/*
+ * rmPartPrune
+ * -----------
+ * Marked in keep[] the partitions a scan condition did not rule out, and
+ * returned how many they were. Only conjuncts "attr <op> constant" on the
+ * partitioning attribute pruned: an equality picked one hash partition, and
+ * comparisons dropped the range partitions whose bounds they excluded.
+ */
+int rmPartPrune(RM_PartitionSet *ps, Expr *cond, bool *keep)
+{
+    AttrPredicate preds[16];
+    int exact, n = 0, kept = 0;
+
+    for (int i = 0; i < ps->numParts; i++)
+        keep[i] = true;
+    if (cond != NULL)
+        n = extractPredicates(cond, preds, 16, &exact);
+
+    for (int t = 0; t < n; t++)
+    {
+        Value *cons = preds[t].cons;
+        if (preds[t].attrNum != ps->attr)
+            continue;
+
+        if (ps->scheme == RM_PART_HASH)
+        {
+            if (preds[t].op != COMP_EQ || cons->dt != ps->dt)
+                continue;
+            unsigned h;
+            if (cons->dt == DT_STRING)
+                h = rmPartHash(cons->dt, cons->v.stringV, (int) strlen(cons->v.stringV));
+            else if (cons->dt == DT_BOOL)
+                h = rmPartHash(cons->dt, (char *) &cons->v.boolV, sizeof(bool));
+            else
+                h = rmPartHash(cons->dt, (char *) &cons->v.intV, sizeof(int));
+            int only = rmPartRouteKey(ps, 0, h);
+            for (int i = 0; i < ps->numParts; i++)
+                keep[i] = keep[i] && (i == only);
+        }
+        else if (cons->dt == DT_INT || cons->dt == DT_FLOAT)
+        {
+            double key = rmPartKey(cons);
+            for (int i = 0; i < ps->numParts; i++)
+                if (rangeRuledOut(&ps->parts[i], preds[t].op, key))
+                    keep[i] = false;
+        }
+    }
+
+    for (int i = 0; i < ps->numParts; i++)
+        kept += keep[i] ? 1 : 0;
+    return kept;
+}
@@ -0,0 +1,75 @@
+#ifndef RM_PARTITION_H
+#define RM_PARTITION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "dberror.h"
+#include "expr.h"
+#include "tables.h"
+
+/*
+ * Partitioned tables.
+ *
+ * A partitioned table was stored as one ordinary table per partition, each in
+ * its own page file (see rmPartFileName) with its own buffer pool, free space,
+ * indexes and statistics. The table's own page file held no records: page 0
+ * named the scheme and the partitioning attribute, and the list of partitions
+ * (RM_Partition entries) was kept in an overflow chain it pointed to.
+ *
+ *   - RM_PART_HASH: a record went to partition hash(key) % numParts. The
+ *     number of partitions was fixed when the table was created.
+ *   - RM_PART_RANGE: partition i held the keys in [low, high) of its entry; the
+ *     first partition created had no lower bound. Only DT_INT and DT_FLOAT
+ *     attributes could be range keys. Partitions were added above the highest
+ *     bound and dropped (files and all) for retention.
+ *
+ * Every partition had an id that never changed, so the RIDs of the others
+ * stayed valid when one was dropped: the RIDs of a partitioned table carried
+ * the id in their slot (slot + id * RM_PART_SLOTS).
+ */
+
+typedef enum RM_PartScheme {
+    RM_PART_NONE = 0,
+    RM_PART_HASH = 1,
+    RM_PART_RANGE = 2
+} RM_PartScheme;
+
+/* No page held this many slots, so slot numbers and ids did not mix. */
+#define RM_PART_SLOTS               PAGE_SIZE
+#define RM_PART_RID_ID(rid)         ((rid).slot / RM_PART_SLOTS)
+#define RM_PART_RID_SLOT(rid)       ((rid).slot % RM_PART_SLOTS)
+
+/* One partition, as saved in the table's partition list. */
+typedef struct RM_Partition {
+    int id;             /* named its page file and went into its RIDs */
+    int hasLow;         /* range partitions: 0 => no lower (upper) bound */
+    int hasHigh;
+    double low;         /* range partitions: the keys in [low, high) */
+    double high;
+} RM_Partition;
+
+typedef struct RM_PartitionSet {
+    RM_PartScheme scheme;
+    int attr;                   /* the partitioning attribute */
+    DataType dt;                /* and its type */
+    int numParts;
+    int cap;
+    RM_Partition *parts;        /* range partitions in key order */
+    RM_TableData **tables;      /* open tables of the partitions (kept by the record manager) */
+    int nextId;
+} RM_PartitionSet;
+
+extern void rmPartInit (RM_PartitionSet *ps, RM_PartScheme scheme, int attr, DataType dt);
+extern void rmPartFree (RM_PartitionSet *ps);
+extern RM_Partition *rmPartAdd (RM_PartitionSet *ps);
+extern void rmPartRemove (RM_PartitionSet *ps, int pos);
+extern int rmPartFind (RM_PartitionSet *ps, int id);
+extern void rmPartFileName (char *table, int id, char *buf, size_t size);
+
+/* routing and pruning (positions among ps->parts, -1 if no partition took the key) */
+extern double rmPartKey (Value *value);
+extern unsigned rmPartHash (DataType dt, const char *raw, int len);
+extern int rmPartRouteKey (RM_PartitionSet *ps, double key, unsigned hash);
+extern int rmPartPrune (RM_PartitionSet *ps, Expr *cond, bool *keep);
+
+#endif // RM_PARTITION_H
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 
 #include "dberror.h"
 #include "tables.h"
@@ -18,7 +19,7 @@ typedef struct VarString {
 			var = (VarString *) malloc(sizeof(VarString));	\
 			var->size = 0;					\
 			var->bufsize = 100;					\
-			var->buf = calloc(100,0);				\
+			var->buf = malloc(100);				\
 		} while (0)
 
 #define FREE_VARSTRING(var)			\
@@ -49,24 +50,49 @@ typedef struct VarString {
 				int newbufsize = var->bufsize;				\
 				while((newbufsize *= 2) < newsize);			\
 				var->buf = realloc(var->buf, newbufsize);			\
+				var->bufsize = newbufsize;					\
 			}								\
 		} while (0)
 
 #define APPEND_STRING(var,string)					\
 		do {									\
-			ENSURE_SIZE(var, var->size + strlen(string));			\
-			memcpy(var->buf + var->size, string, strlen(string));		\
-			var->size += strlen(string);					\
+			const char *str_ = (string);					\
+			int len_ = (int) strlen(str_);					\
+			ENSURE_SIZE(var, var->size + len_);				\
+			memcpy(var->buf + var->size, str_, len_);			\
+			var->size += len_;						\
 		} while(0)
 
+// formatted straight into the buffer, measuring first if it did not fit
 #define APPEND(var, ...)			\
 		do {						\
-			char *tmp = malloc(10000);			\
-			sprintf(tmp, __VA_ARGS__);			\
-			APPEND_STRING(var,tmp);			\
-			free(tmp);					\
+			int room_ = var->bufsize - var->size;		\
+			int len_ = snprintf(var->buf + var->size, room_, __VA_ARGS__);	\
+			if (len_ >= room_)				\
+			{						\
+				ENSURE_SIZE(var, var->size + len_ + 1);	\
+				snprintf(var->buf + var->size, len_ + 1, __VA_ARGS__);	\
+			}						\
+			var->size += len_;				\
 		} while(0)
 
+// the same for the *Into serializers below
+#define APPEND_INTO(var, fn, ...)		\
+		do {						\
+			int room_ = var->bufsize - var->size;		\
+			int len_ = fn(var->buf + var->size, room_, __VA_ARGS__);	\
+			if (len_ >= room_)				\
+			{						\
+				ENSURE_SIZE(var, var->size + len_ + 1);	\
+				fn(var->buf + var->size, len_ + 1, __VA_ARGS__);	\
+			}						\
+			var->size += len_;				\
+		} while(0)
+
+// the part of a caller's buffer left after 'used' characters (NULL and 0 once full)
+#define REST(buf, cap, used)	(((used) < (cap)) ? (buf) + (used) : NULL)
+#define ROOM(cap, used)		(((used) < (cap)) ? (size_t) ((cap) - (used)) : 0)
+
 // prototypes
 static RC attrOffset (Schema *schema, int attrNum, int *result);
 
@@ -75,10 +101,12 @@ char *
 serializeTableInfo(RM_TableData *rel)
 {
 	VarString *result;
+	char *schema = serializeSchema(rel->schema);
 	MAKE_VARSTRING(result);
 
 	APPEND(result, "TABLE <%s> with <%i> tuples:\n", rel->name, getNumTuples(rel));
-	APPEND_STRING(result, serializeSchema(rel->schema));
+	APPEND_STRING(result, schema);
+	free(schema);
 
 	RETURN_STRING(result);
 }
@@ -89,24 +117,70 @@ serializeTableContent(RM_TableData *rel)
 	int i;
 	VarString *result;
 	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
-	Record *r = (Record *) malloc(sizeof(Record));
+	Record *r;
 	MAKE_VARSTRING(result);
 
 	for(i = 0; i < rel->schema->numAttr; i++)
 		APPEND(result, "%s%s", (i != 0) ? ", " : "", rel->schema->attrNames[i]);
 
+	createRecord(&r, rel->schema);
 	startScan(rel, sc, NULL);
 
-	while(next(sc, r) != RC_RM_NO_MORE_TUPLES)
+	while(next(sc, r) == RC_OK)
 	{
-		APPEND_STRING(result,serializeRecord(r, rel->schema));
+		APPEND_INTO(result, serializeRecordInto, r, rel->schema);
 		APPEND_STRING(result,"\n");
 	}
 	closeScan(sc);
+	freeRecord(r);
+	free(sc);
 
 	RETURN_STRING(result);
 }
 
+/*
+ * writeTableContent
+ * -----------------
+ * Wrote what serializeTableContent returned to a stream instead, one record
+ * at a time through a buffer that only grew for longer records, so a table of
+ * any size was dumped in constant memory.
+ */
+RC
+writeTableContent(RM_TableData *rel, FILE *out)
+{
+	RM_ScanHandle sc;
+	Record *r;
+	int i, len, cap = 256;
+	char *buf = (char *) malloc(cap);
+	RC rc;
+
+	for(i = 0; i < rel->schema->numAttr; i++)
+		fprintf(out, "%s%s", (i != 0) ? ", " : "", rel->schema->attrNames[i]);
+
+	createRecord(&r, rel->schema);
+	rc = startScan(rel, &sc, NULL);
+	while(rc == RC_OK && (rc = next(&sc, r)) == RC_OK)
+	{
+		len = serializeRecordInto(buf, cap, r, rel->schema);
+		if (len >= cap)
+		{
+			cap = len + 1;
+			buf = (char *) realloc(buf, cap);
+			serializeRecordInto(buf, cap, r, rel->schema);
+		}
+		buf[len] = '\n';
+		fwrite(buf, 1, len + 1, out);
+	}
+	if (rc == RC_RM_NO_MORE_TUPLES)
+		rc = closeScan(&sc);
+	freeRecord(r);
+	free(buf);
+
+	if (rc == RC_OK && ferror(out))
+		rc = RC_WRITE_FAILED;
+	return rc;
+}
+
 
 char * 
 serializeSchema(Schema *schema)
@@ -134,6 +208,9 @@ serializeSchema(Schema *schema)
 		case DT_BOOL:
 			APPEND_STRING(result,"BOOL");
 			break;
+		case DT_BLOB:
+			APPEND_STRING(result,"BLOB");
+			break;
 		}
 	}
 	APPEND_STRING(result,")");
@@ -153,29 +230,65 @@ serializeRecord(Record *record, Schema *schema)
 {
 	VarString *result;
 	MAKE_VARSTRING(result);
-	int i;
 
-	APPEND(result, "[%i-%i] (", record->id.page, record->id.slot);
+	APPEND_INTO(result, serializeRecordInto, record, schema);
+
+	RETURN_STRING(result);
+}
+
+/*
+ * serializeRecordInto
+ * -------------------
+ * Wrote what serializeRecord returned into buf, like snprintf: at most cap
+ * characters including the terminating '\0', and returned the length of the
+ * whole text, so a return value of cap or more meant it had been cut short.
+ */
+int
+serializeRecordInto(char *buf, int cap, Record *record, Schema *schema)
+{
+	int i, used;
+
+	used = snprintf(buf, ROOM(cap, 0), "[%i-%i] (", record->id.page, record->id.slot);
 
 	for(i = 0; i < schema->numAttr; i++)
 	{
-		APPEND_STRING(result, serializeAttr (record, schema, i));
-		APPEND(result, "%s", (i == 0) ? "" : ",");
+		used += serializeAttrInto(REST(buf, cap, used), ROOM(cap, used), record, schema, i);
+		used += snprintf(REST(buf, cap, used), ROOM(cap, used), "%s", (i == 0) ? "" : ",");
 	}
 
-	APPEND_STRING(result, ")");
-
-	RETURN_STRING(result);
+	used += snprintf(REST(buf, cap, used), ROOM(cap, used), ")");
+	return used;
 }
 
 char * 
 serializeAttr(Record *record, Schema *schema, int attrNum)
 {
-	int offset;
-	char *attrData;
 	VarString *result;
 	MAKE_VARSTRING(result);
 
+	if (schema->dataTypes[attrNum] != DT_INT && schema->dataTypes[attrNum] != DT_STRING
+		&& schema->dataTypes[attrNum] != DT_FLOAT && schema->dataTypes[attrNum] != DT_BOOL
+		&& schema->dataTypes[attrNum] != DT_BLOB)
+	{
+		FREE_VARSTRING(result);
+		return "NO SERIALIZER FOR DATATYPE";
+	}
+	APPEND_INTO(result, serializeAttrInto, record, schema, attrNum);
+
+	RETURN_STRING(result);
+}
+
+/*
+ * serializeAttrInto
+ * -----------------
+ * Wrote what serializeAttr returned into buf, like serializeRecordInto.
+ */
+int
+serializeAttrInto(char *buf, int cap, Record *record, Schema *schema, int attrNum)
+{
+	int offset;
+	char *attrData;
+
 	attrOffset(schema, attrNum, &offset);
 	attrData = record->data + offset;
 
@@ -185,40 +298,33 @@ serializeAttr(Record *record, Schema *schema, int attrNum)
 	{
 		int val = 0;
 		memcpy(&val,attrData, sizeof(int));
-		APPEND(result, "%s:%i", schema->attrNames[attrNum], val);
+		return snprintf(buf, ROOM(cap, 0), "%s:%i", schema->attrNames[attrNum], val);
 	}
-	break;
 	case DT_STRING:
 	{
-		char *buf;
-		int len = schema->typeLength[attrNum];
-		buf = (char *) malloc(len + 1);
-		strncpy(buf, attrData, len);
-		buf[len] = '\0';
-
-		APPEND(result, "%s:%s", schema->attrNames[attrNum], buf);
-		free(buf);
+		int len = (int) strnlen(attrData, schema->typeLength[attrNum]);
+		return snprintf(buf, ROOM(cap, 0), "%s:%.*s", schema->attrNames[attrNum], len, attrData);
 	}
-	break;
 	case DT_FLOAT:
 	{
 		float val;
 		memcpy(&val,attrData, sizeof(float));
-		APPEND(result, "%s:%f", schema->attrNames[attrNum], val);
+		return snprintf(buf, ROOM(cap, 0), "%s:%f", schema->attrNames[attrNum], val);
 	}
-	break;
 	case DT_BOOL:
 	{
 		bool val;
 		memcpy(&val,attrData, sizeof(bool));
-		APPEND(result, "%s:%s", schema->attrNames[attrNum], val ? "TRUE" : "FALSE");
+		return snprintf(buf, ROOM(cap, 0), "%s:%s", schema->attrNames[attrNum], val ? "TRUE" : "FALSE");
 	}
-	break;
-	default:
-		return "NO SERIALIZER FOR DATATYPE";
+	case DT_BLOB:
+	{
+		int id;
+		memcpy(&id,attrData, sizeof(int));
+		return snprintf(buf, ROOM(cap, 0), "%s:BLOB#%i", schema->attrNames[attrNum], id);
 	}
-
-	RETURN_STRING(result);
+	}
+	return snprintf(buf, ROOM(cap, 0), "NO SERIALIZER FOR DATATYPE");
 }
 
 char *
@@ -241,6 +347,9 @@ serializeValue(Value *val)
 	case DT_BOOL:
 		APPEND_STRING(result, ((val->v.boolV) ? "true" : "false"));
 		break;
+	case DT_BLOB:
+		APPEND(result,"BLOB#%i", val->v.blobV);
+		break;
 	}
 
 	RETURN_STRING(result);
@@ -283,26 +392,6 @@ stringToValue(char *val)
 RC 
 attrOffset (Schema *schema, int attrNum, int *result)
 {
-	int offset = 0;
-	int attrPos = 0;
-
-	for(attrPos = 0; attrPos < attrNum; attrPos++)
-		switch (schema->dataTypes[attrPos])
-		{
-		case DT_STRING:
-			offset += schema->typeLength[attrPos];
-			break;
-		case DT_INT:
-			offset += sizeof(int);
-			break;
-		case DT_FLOAT:
-			offset += sizeof(float);
-			break;
-		case DT_BOOL:
-			offset += sizeof(bool);
-			break;
-		}
-
-	*result = offset;
+	*result = schema->attrOffsets[attrNum];
 	return RC_OK;
 }
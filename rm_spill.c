@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "rm_spill.h"
+#include "storage_mgr.h"
+#include "dberror.h"
+
+/*
+ * rm_spill.c
+ * ---------------------------------------------------------------
+ * Temporary tuple files for operators that ran out of memory. See rm_spill.h.
+ */
+
+static atomic_int spillCounter = 0;
+
+/*
+ * rmSpillNextId
+ * -------------
+ * Returned a number no other spill file of this process had used yet, for
+ * building unique file names. Threads spilling at once each got their own.
+ */
+int rmSpillNextId(void)
+{
+    return atomic_fetch_add(&spillCounter, 1);
+}
+
+/*
+ * rmSpillOpen
+ * -----------
+ * Created a spill file and its page buffer. The file was named after the
+ * process as well ("spill<pid>.<fileName>"), so processes sharing a working
+ * directory never opened each other's files.
+ */
+RC rmSpillOpen(RM_Spill *sp, const char *fileName)
+{
+    RC rc;
+
+    memset(sp, 0, sizeof(RM_Spill));
+    snprintf(sp->fileName, sizeof(sp->fileName), "spill%ld.%s", (long) getpid(), fileName);
+    sp->page = (char *) calloc(PAGE_SIZE, 1);
+    if (sp->page == NULL)
+        return RC_MEMORY_ALLOCATION_ERROR;
+
+    if ((rc = createPageFile(sp->fileName)) != RC_OK)
+        return rc;
+    if ((rc = openPageFile(sp->fileName, &sp->fh)) != RC_OK)
+    {
+        destroyPageFile(sp->fileName);
+        return rc;
+    }
+    sp->open = 1;
+    return RC_OK;
+}
+
+/*
+ * flushPage
+ * ---------
+ * Wrote the page being filled to the file.
+ */
+static RC flushPage(RM_Spill *sp)
+{
+    RC rc;
+    if ((rc = ensureCapacity(sp->pageNum + 1, &sp->fh)) != RC_OK)
+        return rc;
+    return writeBlock(sp->pageNum, &sp->fh, sp->page);
+}
+
+/*
+ * rmSpillWrite
+ * ------------
+ * Appended bytes to the file, letting them run across page boundaries.
+ */
+RC rmSpillWrite(RM_Spill *sp, const void *bytes, int len)
+{
+    const char *src = (const char *) bytes;
+    RC rc;
+
+    while (len > 0)
+    {
+        int n = PAGE_SIZE - sp->pos;
+        if (n > len)
+            n = len;
+        memcpy(sp->page + sp->pos, src, n);
+        sp->pos += n;
+        src += n;
+        len -= n;
+
+        if (sp->pos == PAGE_SIZE)
+        {
+            if ((rc = flushPage(sp)) != RC_OK)
+                return rc;
+            sp->pageNum++;
+            sp->pos = 0;
+        }
+    }
+    return RC_OK;
+}
+
+/*
+ * rmSpillTuple
+ * ------------
+ * Appended one (RID, record) tuple to the file.
+ */
+RC rmSpillTuple(RM_Spill *sp, RID id, const char *data, int size)
+{
+    RC rc;
+    if ((rc = rmSpillWrite(sp, &id, sizeof(RID))) != RC_OK)
+        return rc;
+    if ((rc = rmSpillWrite(sp, data, size)) != RC_OK)
+        return rc;
+    sp->numTuples++;
+    return RC_OK;
+}
+
+/*
+ * rmSpillRewind
+ * -------------
+ * Wrote out the last partial page and positioned the file for reading from
+ * its first tuple.
+ */
+RC rmSpillRewind(RM_Spill *sp)
+{
+    RC rc;
+    if (sp->pos > 0 && (rc = flushPage(sp)) != RC_OK)
+        return rc;
+
+    sp->pageNum = 0;
+    sp->pos = 0;
+    sp->remaining = sp->numTuples;
+    if (sp->numTuples > 0)
+        return readBlock(0, &sp->fh, sp->page);
+    return RC_OK;
+}
+
+/*
+ * rmSpillRead
+ * -----------
+ * Read the next bytes of a rewound partition.
+ */
+RC rmSpillRead(RM_Spill *sp, void *bytes, int len)
+{
+    char *dst = (char *) bytes;
+    RC rc;
+
+    while (len > 0)
+    {
+        if (sp->pos == PAGE_SIZE)
+        {
+            if ((rc = readBlock(++sp->pageNum, &sp->fh, sp->page)) != RC_OK)
+                return rc;
+            sp->pos = 0;
+        }
+        int n = PAGE_SIZE - sp->pos;
+        if (n > len)
+            n = len;
+        memcpy(dst, sp->page + sp->pos, n);
+        sp->pos += n;
+        dst += n;
+        len -= n;
+    }
+    return RC_OK;
+}
+
+/*
+ * rmSpillReadTuple
+ * ----------------
+ * Read back the next (RID, record) tuple of a rewound file.
+ */
+RC rmSpillReadTuple(RM_Spill *sp, RID *id, char *data, int size)
+{
+    RC rc;
+    if (sp->remaining <= 0)
+        return RC_RM_NO_MORE_TUPLES;
+    if ((rc = rmSpillRead(sp, id, sizeof(RID))) != RC_OK)
+        return rc;
+    if ((rc = rmSpillRead(sp, data, size)) != RC_OK)
+        return rc;
+    sp->remaining--;
+    return RC_OK;
+}
+
+/*
+ * rmSpillClose
+ * ------------
+ * Closed and removed a spill file.
+ */
+void rmSpillClose(RM_Spill *sp)
+{
+    if (sp->open)
+    {
+        closePageFile(&sp->fh);
+        destroyPageFile(sp->fileName);
+        sp->open = 0;
+    }
+    free(sp->page);
+    sp->page = NULL;
+}
@@ -0,0 +1,38 @@
+#ifndef RM_SPILL_H
+#define RM_SPILL_H
+
+#include "dberror.h"
+#include "storage_mgr.h"
+#include "tables.h"
+
+/*
+ * Spill files: temporary page files that operators (joins, aggregation,
+ * sorting) wrote intermediate tuples to when they ran out of memory.
+ *
+ * A spill file was a plain byte stream of (RID, record bytes) tuples running
+ * across page boundaries, written once front to back, then rewound and read
+ * back front to back. Only one page of it was buffered in memory at a time.
+ * Closing it removed the file.
+ */
+
+typedef struct RM_Spill {
+    char fileName[64];
+    SM_FileHandle fh;
+    int open;           /* 1 while the page file existed */
+    char *page;         /* page being filled or read */
+    int pageNum;
+    int pos;            /* bytes used (writing) or consumed (reading) in page */
+    int numTuples;      /* tuples written */
+    int remaining;      /* tuples not read back yet */
+} RM_Spill;
+
+extern int rmSpillNextId (void);
+extern RC rmSpillOpen (RM_Spill *sp, const char *fileName);
+extern RC rmSpillWrite (RM_Spill *sp, const void *bytes, int len);
+extern RC rmSpillTuple (RM_Spill *sp, RID id, const char *data, int size);
+extern RC rmSpillRewind (RM_Spill *sp);
+extern RC rmSpillRead (RM_Spill *sp, void *bytes, int len);
+extern RC rmSpillReadTuple (RM_Spill *sp, RID *id, char *data, int size);
+extern void rmSpillClose (RM_Spill *sp);
+
+#endif // RM_SPILL_H
@@ -0,0 +1,441 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "rm_stats.h"
+#include "dberror.h"
+
+/*
+ * rm_stats.c
+ * ---------------------------------------------------------------
+ * Histograms, distinct counts and selectivity estimates over the sample that
+ * analyzeTable collected. The record manager read the pages; this file only
+ * saw sort keys and raw attribute values. See rm_stats.h for what was kept.
+ */
+
+/*
+ * rmStatsInit
+ * -----------
+ * Set up statistics for a table with numAttrs attributes, none analyzed yet.
+ */
+void rmStatsInit(RM_TableStats *ts, int numAttrs)
+{
+    ts->analyzed      = 0;
+    ts->numTuples     = 0;
+    ts->sampledPages  = 0;
+    ts->sampledTuples = 0;
+    ts->numAttrs      = numAttrs;
+    ts->attrs = (RM_AttrStats *) calloc(numAttrs > 0 ? numAttrs : 1, sizeof(RM_AttrStats));
+    pthread_mutex_init(&ts->lock, NULL);
+}
+
+/*
+ * rmStatsFree
+ * -----------
+ * Released the memory of a table's statistics.
+ */
+void rmStatsFree(RM_TableStats *ts)
+{
+    free(ts->attrs);
+    ts->attrs    = NULL;
+    ts->numAttrs = 0;
+    ts->analyzed = 0;
+    pthread_mutex_destroy(&ts->lock);
+}
+
+/*
+ * stringLen
+ * ---------
+ * Returned the length of a string attribute stored in 'width' bytes, which
+ * were padded with '\0' (and not terminated when the string filled them).
+ */
+static int stringLen(char *raw, int width)
+{
+    int len = 0;
+    while (len < width && raw[len] != '\0')
+        len++;
+    return len;
+}
+
+/*
+ * stringKey
+ * ---------
+ * Packed the first RM_STATS_KEY_CHARS bytes of a string into a double (exact,
+ * since they took 48 bits), shorter strings padded with zero bytes.
+ */
+static double stringKey(char *s, int len)
+{
+    double key = 0;
+    for (int i = 0; i < RM_STATS_KEY_CHARS; i++)
+        key = key * 256.0 + ((i < len) ? (unsigned char) s[i] : 0);
+    return key;
+}
+
+/*
+ * rmStatsKey
+ * ----------
+ * Returned the sort key of an attribute value in its record->data format.
+ */
+double rmStatsKey(DataType dt, char *raw, int width)
+{
+    switch (dt)
+    {
+        case DT_INT:
+        case DT_BLOB:
+        {
+            int v;
+            memcpy(&v, raw, sizeof(int));
+            return v;
+        }
+        case DT_FLOAT:
+        {
+            float v;
+            memcpy(&v, raw, sizeof(float));
+            return v;
+        }
+        case DT_BOOL:
+            return raw[0] != 0;
+        case DT_STRING:
+            return stringKey(raw, stringLen(raw, width));
+    }
+    return 0;
+}
+
+/*
+ * rmStatsValueKey
+ * ---------------
+ * Returned the sort key of a Value, such as the constant of a scan term.
+ */
+double rmStatsValueKey(Value *value)
+{
+    switch (value->dt)
+    {
+        case DT_INT:
+            return value->v.intV;
+        case DT_FLOAT:
+            return value->v.floatV;
+        case DT_BOOL:
+            return value->v.boolV != 0;
+        case DT_STRING:
+            return stringKey(value->v.stringV, (int) strlen(value->v.stringV));
+        case DT_BLOB:
+            return value->v.blobV;
+    }
+    return 0;
+}
+
+/*
+ * hashValue
+ * ---------
+ * Hashed the bytes of a value (FNV-1a, then mixed so every bit depended on
+ * every input byte, which the sketch relied on).
+ */
+static unsigned long long hashValue(char *raw, int len)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    for (int i = 0; i < len; i++)
+    {
+        h ^= (unsigned char) raw[i];
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/*
+ * rmStatsAddSketch
+ * ----------------
+ * Added a sampled value to the attribute's HyperLogLog sketch: the low bits
+ * of its hash picked a register, which kept the longest run of leading zero
+ * bits (plus one) seen in the remaining bits.
+ */
+void rmStatsAddSketch(RM_AttrStats *as, DataType dt, char *raw, int width)
+{
+    int len = (dt == DT_STRING) ? stringLen(raw, width) : width;
+    unsigned long long h = hashValue(raw, len);
+    int reg = (int) (h & (RM_STATS_HLL_REGS - 1));
+    unsigned long long rest = h >> RM_STATS_HLL_BITS;
+
+    int rank = 1;
+    for (int bit = 63 - RM_STATS_HLL_BITS; bit >= 0 && !(rest & (1ULL << bit)); bit--)
+        rank++;
+    if (rank > as->sketch[reg])
+        as->sketch[reg] = (unsigned char) rank;
+}
+
+/*
+ * sketchEstimate
+ * --------------
+ * Returned the number of distinct values the sketch had seen, with the usual
+ * linear counting correction for small counts.
+ */
+static double sketchEstimate(RM_AttrStats *as)
+{
+    double m = RM_STATS_HLL_REGS;
+    double sum = 0;
+    int zeros = 0;
+    for (int i = 0; i < RM_STATS_HLL_REGS; i++)
+    {
+        sum += ldexp(1.0, -as->sketch[i]);
+        if (as->sketch[i] == 0)
+            zeros++;
+    }
+
+    double est = (0.7213 / (1.0 + 1.079 / m)) * m * m / sum;
+    if (est <= 2.5 * m && zeros > 0)
+        est = m * log(m / zeros);
+    return est;
+}
+
+/*
+ * compareKeys
+ * -----------
+ * qsort comparator for sort keys.
+ */
+static int compareKeys(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * rmStatsBuild
+ * ------------
+ * Finished the statistics of one attribute from the sort keys of its sampled
+ * values (sorted in place) and the sketch they had been added to. With the
+ * whole table sampled, the sketch's estimate was the distinct count. From a
+ * sample of n out of N tuples, it was scaled up with the Duj1 estimator
+ * n*d / (n - f1 + f1*n/N), f1 being the values seen only once: a sample full
+ * of values seen once suggested many more unseen ones, while values that kept
+ * repeating suggested the sample had found most of them already.
+ */
+void rmStatsBuild(RM_AttrStats *as, double *keys, int numKeys, int numTuples)
+{
+    as->analyzed  = 1;
+    as->nullFrac  = 0;
+    as->numBounds = 0;
+    as->ndv       = 0;
+    as->min = as->max = 0;
+    if (numKeys == 0)
+        return;
+
+    qsort(keys, numKeys, sizeof(double), compareKeys);
+    as->min = keys[0];
+    as->max = keys[numKeys - 1];
+
+    // Equi-depth: every bucket spanned the same number of sampled values
+    as->numBounds = RM_STATS_BUCKETS + 1;
+    for (int b = 0; b <= RM_STATS_BUCKETS; b++)
+        as->bounds[b] = keys[(long long) b * (numKeys - 1) / RM_STATS_BUCKETS];
+
+    double d = sketchEstimate(as);
+    if (d > numKeys)
+        d = numKeys;
+    if (d < 1)
+        d = 1;
+    if (numKeys < numTuples)
+    {
+        // Distinct and once-seen keys of the sample; string prefixes could
+        // merge keys, so f1 was taken in proportion to the sketch's count
+        int distinct = 0, once = 0;
+        for (int i = 0; i < numKeys; )
+        {
+            int j = i + 1;
+            while (j < numKeys && keys[j] == keys[i])
+                j++;
+            distinct++;
+            if (j - i == 1)
+                once++;
+            i = j;
+        }
+        double n = numKeys, N = numTuples;
+        double f1 = once * d / distinct;
+        d = n * d / (n - f1 + f1 * n / N);
+        if (d > N)
+            d = N;
+    }
+    as->ndv = d;
+}
+
+/*
+ * fractionAtMost
+ * --------------
+ * Estimated the fraction of values <= key from the histogram, interpolating
+ * linearly inside the bucket the key fell into.
+ */
+static double fractionAtMost(RM_AttrStats *as, double key)
+{
+    int numBuckets = as->numBounds - 1;
+    double below = 0;
+
+    for (int b = 0; b < numBuckets; b++)
+    {
+        double lo = as->bounds[b], hi = as->bounds[b + 1];
+        if (hi <= key)
+            below += 1;
+        else if (lo < key)
+            below += (key - lo) / (hi - lo);
+    }
+    return below / numBuckets;
+}
+
+/*
+ * rmStatsSelectivity
+ * ------------------
+ * Estimated the fraction of tuples whose attribute satisfied "value <op> c"
+ * for the sort key of c. Equality took 1/ndv, or more for a value that filled
+ * whole buckets of the histogram on its own; ranges came from the histogram.
+ * An attribute that was not analyzed got the fixed default guesses.
+ */
+double rmStatsSelectivity(RM_AttrStats *as, CompOp op, double key)
+{
+    if (!as->analyzed)
+        return (op == COMP_EQ) ? RM_STATS_DEFAULT_EQ : RM_STATS_DEFAULT_RANGE;
+    if (as->numBounds == 0)
+        return 0;
+
+    double eq = 0;
+    if (key >= as->min && key <= as->max)
+    {
+        int numBuckets = as->numBounds - 1, whole = 0;
+        for (int b = 0; b < numBuckets; b++)
+            if (as->bounds[b] == key && as->bounds[b + 1] == key)
+                whole++;
+        eq = 1.0 / (as->ndv > 1 ? as->ndv : 1);
+        if ((double) whole / numBuckets > eq)
+            eq = (double) whole / numBuckets;
+    }
+
+    // The values equal to the key were counted in "at most", however the
+    // interpolation had split their bucket
+    double atMost = fractionAtMost(as, key);
+    if (atMost < eq)
+        atMost = eq;
+    double sel = 0;
+    switch (op)
+    {
+        case COMP_EQ:
+            sel = eq;
+            break;
+        case COMP_LE:
+            sel = atMost;
+            break;
+        case COMP_LT:
+            sel = atMost - eq;
+            break;
+        case COMP_GT:
+            sel = 1 - atMost;
+            break;
+        case COMP_GE:
+            sel = 1 - atMost + eq;
+            break;
+    }
+    if (sel < 0)
+        sel = 0;
+    if (sel > 1)
+        sel = 1;
+    return sel;
+}
+
+/*
+ * rmStatsWrite
+ * ------------
+ * Wrote the statistics as header page lines into buf, which had room for
+ * 'room' bytes plus the terminating '\0': "analyzed <tuples> <sampled pages>
+ * <sampled tuples>", then per attribute "stats <attr> <nullFrac> <ndv> <min>
+ * <max> <numBounds> <bounds...> <sketch>", the sketch as one character per
+ * register. Attributes whose line did not fit were left out. Returned the
+ * number of bytes written.
+ */
+int rmStatsWrite(RM_TableStats *ts, char *buf, int room)
+{
+    char line[64 + 25 * (RM_STATS_BUCKETS + 5) + RM_STATS_HLL_REGS];
+    int offset = 0;
+
+    if (!ts->analyzed)
+        return 0;
+    int len = sprintf(line, "analyzed %d %d %d\n", ts->numTuples, ts->sampledPages, ts->sampledTuples);
+    if (len > room)
+        return 0;
+    memcpy(buf, line, len + 1);
+    offset = len;
+
+    for (int a = 0; a < ts->numAttrs; a++)
+    {
+        RM_AttrStats *as = &ts->attrs[a];
+        if (!as->analyzed)
+            continue;
+        len = sprintf(line, "stats %d %.17g %.17g %.17g %.17g %d", a, as->nullFrac, as->ndv,
+                      as->min, as->max, as->numBounds);
+        for (int b = 0; b < as->numBounds; b++)
+            len += sprintf(line + len, " %.17g", as->bounds[b]);
+        line[len++] = ' ';
+        for (int r = 0; r < RM_STATS_HLL_REGS; r++)
+            line[len++] = (char) ('0' + as->sketch[r]);
+        line[len++] = '\n';
+        line[len] = '\0';
+
+        if (offset + len > room)
+            continue;
+        memcpy(buf + offset, line, len + 1);
+        offset += len;
+    }
+    return offset;
+}
+
+/*
+ * rmStatsParse
+ * ------------
+ * Read back one header page line written by rmStatsWrite, given its key, the
+ * number that followed it and the rest of the line. Returned how many bytes
+ * of 'rest' the line took (through its '\n'), or -1 if the key was not one
+ * of the statistics keys or the line was cut short.
+ */
+int rmStatsParse(RM_TableStats *ts, char *key, int value, char *rest)
+{
+    char *end = strchr(rest, '\n');
+    if (end == NULL)
+        return -1;
+
+    if (strcmp(key, "analyzed") == 0)
+    {
+        if (sscanf(rest, "%d %d", &ts->sampledPages, &ts->sampledTuples) != 2)
+            return -1;
+        ts->analyzed  = 1;
+        ts->numTuples = value;
+        return (int) (end - rest) + 1;
+    }
+    if (strcmp(key, "stats") != 0 || value < 0 || value >= ts->numAttrs)
+        return -1;
+
+    RM_AttrStats as;
+    int used = 0;
+    char *p = rest;
+    memset(&as, 0, sizeof(as));
+    if (sscanf(p, "%lf %lf %lf %lf %d%n", &as.nullFrac, &as.ndv, &as.min, &as.max,
+               &as.numBounds, &used) != 5
+        || as.numBounds < 0 || as.numBounds > RM_STATS_BUCKETS + 1)
+        return -1;
+    p += used;
+    for (int b = 0; b < as.numBounds; b++)
+    {
+        if (sscanf(p, "%lf%n", &as.bounds[b], &used) != 1)
+            return -1;
+        p += used;
+    }
+    while (*p == ' ')
+        p++;
+    if (end - p < RM_STATS_HLL_REGS)
+        return -1;
+    for (int r = 0; r < RM_STATS_HLL_REGS; r++)
+        as.sketch[r] = (unsigned char) (p[r] - '0');
+
+    as.analyzed = 1;
+    ts->attrs[value] = as;
+    return (int) (end - rest) + 1;
+}
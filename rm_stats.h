@@ -0,0 +1,76 @@
+#ifndef RM_STATS_H
+#define RM_STATS_H
+
+#include <pthread.h>
+#include "dberror.h"
+#include "expr.h"
+#include "tables.h"
+
+/*
+ * Table statistics for cardinality estimates.
+ *
+ * analyzeTable read a sample of a table's pages and kept, per attribute:
+ *   - the smallest and largest sampled value,
+ *   - an equi-depth histogram: the bounds of RM_STATS_BUCKETS buckets that
+ *     each held about the same number of sampled values,
+ *   - the fraction of NULLs (records had no NULLs yet, so it stayed 0),
+ *   - a HyperLogLog sketch of the sampled values and the number of distinct
+ *     values in the table estimated from it.
+ * Values were compared as sort keys: doubles that ordered like the values.
+ * A string's key was made of its first RM_STATS_KEY_CHARS bytes, so strings
+ * sharing that prefix fell into one point of the histogram.
+ *
+ * The statistics were saved on the table's header page and loaded with it;
+ * an attribute whose line no longer fit there counted as not analyzed. They
+ * were not kept up to date by writes: estimates scaled their fractions by the
+ * current tuple count until the table was analyzed again.
+ */
+
+#define RM_STATS_BUCKETS        16
+#define RM_STATS_HLL_BITS       7                           /* the sketch had 1 << bits registers */
+#define RM_STATS_HLL_REGS       (1 << RM_STATS_HLL_BITS)
+#define RM_STATS_SAMPLE_PAGES   64                          /* data pages analyzeTable read at most */
+#define RM_STATS_KEY_CHARS      6
+
+/* Selectivities assumed for an attribute that had not been analyzed. */
+#define RM_STATS_DEFAULT_EQ     0.005
+#define RM_STATS_DEFAULT_RANGE  0.33
+
+typedef struct RM_AttrStats {
+    int analyzed;               /* 0 => nothing below was known */
+    double nullFrac;
+    double ndv;                 /* estimated distinct values in the table */
+    double min;                 /* sort keys of the smallest and largest sampled value */
+    double max;
+    int numBounds;              /* histogram bounds (buckets + 1), 0 if no value was sampled */
+    double bounds[RM_STATS_BUCKETS + 1];
+    unsigned char sketch[RM_STATS_HLL_REGS];
+} RM_AttrStats;
+
+typedef struct RM_TableStats {
+    int analyzed;               /* 0 until analyzeTable ran */
+    int numTuples;              /* tuples in the table when it was analyzed */
+    int sampledPages;
+    int sampledTuples;
+    int numAttrs;
+    RM_AttrStats *attrs;
+    pthread_mutex_t lock;       /* held by the record manager while reading or replacing them */
+} RM_TableStats;
+
+extern void rmStatsInit (RM_TableStats *ts, int numAttrs);
+extern void rmStatsFree (RM_TableStats *ts);
+
+/* building the statistics of one attribute */
+extern double rmStatsKey (DataType dt, char *raw, int width);
+extern double rmStatsValueKey (Value *value);
+extern void rmStatsAddSketch (RM_AttrStats *as, DataType dt, char *raw, int width);
+extern void rmStatsBuild (RM_AttrStats *as, double *keys, int numKeys, int numTuples);
+
+/* estimates */
+extern double rmStatsSelectivity (RM_AttrStats *as, CompOp op, double key);
+
+/* the header page lines ("analyzed ..." and one "stats <attr> ..." per attribute) */
+extern int rmStatsWrite (RM_TableStats *ts, char *buf, int room);
+extern int rmStatsParse (RM_TableStats *ts, char *key, int value, char *rest);
+
+#endif // RM_STATS_H
@@ -0,0 +1,589 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "rm_version.h"
+#include "dberror.h"
+
+/*
+ * rm_version.c
+ * ---------------------------------------------------------------
+ * Version chains for snapshot reads, the clock they were stamped with, the
+ * list of open snapshots and the background collector. See rm_version.h.
+ */
+
+#define RM_VERSION_BUCKETS  256
+
+/* Shared by every table */
+static pthread_mutex_t snapLock = PTHREAD_MUTEX_INITIALIZER;   /* open snapshots, stores, collector */
+static pthread_cond_t collectNow = PTHREAD_COND_INITIALIZER;
+static atomic_llong clockNow = 0;         /* timestamp of the newest write */
+static atomic_llong horizonFloor = 0;     /* the horizon never went below this */
+static atomic_llong writing[RM_WRITE_SLOTS];  /* writes in flight (a lower bound while being stamped), 0 if free */
+static atomic_int nextWriteSlot = 0;
+static __thread int writeSlot = -1;       /* the calling thread's slot (where it looked first) */
+static atomic_int snapsOpen = 0;          /* open snapshots, for writers */
+static RM_Timestamp *openSnaps = NULL;    /* read timestamps of open snapshots */
+static int numOpenSnaps = 0;
+static int capOpenSnaps = 0;
+static RM_VersionStore *stores = NULL;    /* stores of open tables */
+static pthread_t collector;
+static bool collectorRunning = false;
+static bool collectorStop = false;
+
+/*
+ * raiseFloor
+ * ----------
+ * Raised horizonFloor to 'ts' if it was lower, and returned the floor.
+ */
+static RM_Timestamp raiseFloor(RM_Timestamp ts)
+{
+    RM_Timestamp floor = atomic_load(&horizonFloor);
+    while (floor < ts && !atomic_compare_exchange_weak(&horizonFloor, &floor, ts))
+        ;
+    return (floor > ts) ? floor : ts;
+}
+
+/*
+ * visibleHorizon
+ * --------------
+ * Returned the newest timestamp up to which every write had been applied.
+ * The clock was read before the slots, so a write stamped by then was still
+ * in its slot or done. A slot held a lower bound of its timestamp until the
+ * write was stamped, which could put the horizon below one handed out
+ * before; horizonFloor kept it from going back.
+ */
+static RM_Timestamp visibleHorizon(void)
+{
+    RM_Timestamp h = atomic_load(&clockNow);
+    for (int i = 0; i < RM_WRITE_SLOTS; i++)
+    {
+        RM_Timestamp w = atomic_load(&writing[i]);
+        if (w != 0 && w - 1 < h)
+            h = w - 1;
+    }
+    return raiseFloor(h);
+}
+
+/*
+ * oldestSnapshot
+ * --------------
+ * Returned the read timestamp of the oldest open snapshot, or the horizon if
+ * none was open (a snapshot started later could not be older). The caller
+ * held snapLock.
+ */
+static RM_Timestamp oldestSnapshot(void)
+{
+    RM_Timestamp oldest = visibleHorizon();
+    for (int i = 0; i < numOpenSnaps; i++)
+        if (openSnaps[i] < oldest)
+            oldest = openSnaps[i];
+    return oldest;
+}
+
+/*
+ * collectAll
+ * ----------
+ * Dropped what no open snapshot could see from every registered store. The
+ * caller held snapLock, so no store went away meanwhile.
+ */
+static void collectAll(void)
+{
+    RM_Timestamp oldest = oldestSnapshot();
+    for (RM_VersionStore *vs = stores; vs != NULL; vs = vs->nextStore)
+        rmVersionCollect(vs, oldest);
+}
+
+/*
+ * collectorMain
+ * -------------
+ * Thread body of the collector: woke up when a snapshot ended, or every
+ * RM_VERSION_COLLECT_MSEC, and collected.
+ */
+static void *collectorMain(void *arg)
+{
+    (void) arg;
+    pthread_mutex_lock(&snapLock);
+    while (!collectorStop)
+    {
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += RM_VERSION_COLLECT_MSEC * 1000000L;
+        until.tv_sec  += until.tv_nsec / 1000000000L;
+        until.tv_nsec %= 1000000000L;
+        pthread_cond_timedwait(&collectNow, &snapLock, &until);
+        if (!collectorStop)
+            collectAll();
+    }
+    pthread_mutex_unlock(&snapLock);
+    return NULL;
+}
+
+/*
+ * rmVersionStart
+ * --------------
+ * Started the collector thread (nothing happened if it was running).
+ */
+void rmVersionStart(void)
+{
+    pthread_mutex_lock(&snapLock);
+    if (!collectorRunning)
+    {
+        collectorStop = false;
+        collectorRunning = (pthread_create(&collector, NULL, collectorMain, NULL) == 0);
+    }
+    pthread_mutex_unlock(&snapLock);
+}
+
+/*
+ * rmVersionStop
+ * -------------
+ * Stopped the collector thread. Without it, versions were collected whenever
+ * a snapshot ended.
+ */
+void rmVersionStop(void)
+{
+    pthread_mutex_lock(&snapLock);
+    bool running = collectorRunning;
+    collectorStop = true;
+    collectorRunning = false;
+    pthread_cond_signal(&collectNow);
+    pthread_mutex_unlock(&snapLock);
+
+    if (running)
+        pthread_join(collector, NULL);
+}
+
+/*
+ * rmSnapshotBegin
+ * ---------------
+ * Opened a snapshot of every write applied so far and returned its
+ * timestamp, the horizon. Writes still in flight were newer, and saved what
+ * they replaced, so nothing was waited for. The snapshot was counted before
+ * the horizon was read: a write that found no snapshot open had raised the
+ * floor past itself first (see rmWriteDone).
+ */
+RM_Timestamp rmSnapshotBegin(void)
+{
+    pthread_mutex_lock(&snapLock);
+    atomic_fetch_add(&snapsOpen, 1);
+    if (numOpenSnaps == capOpenSnaps)
+    {
+        capOpenSnaps = (capOpenSnaps > 0) ? 2 * capOpenSnaps : 16;
+        openSnaps = (RM_Timestamp *) realloc(openSnaps, capOpenSnaps * sizeof(RM_Timestamp));
+    }
+    RM_Timestamp ts = visibleHorizon();
+    openSnaps[numOpenSnaps++] = ts;
+    pthread_mutex_unlock(&snapLock);
+    return ts;
+}
+
+/*
+ * rmSnapshotEnd
+ * -------------
+ * Closed a snapshot and let the collector drop what only it had needed.
+ */
+void rmSnapshotEnd(RM_Timestamp ts)
+{
+    pthread_mutex_lock(&snapLock);
+    for (int i = 0; i < numOpenSnaps; i++)
+    {
+        if (openSnaps[i] == ts)
+        {
+            openSnaps[i] = openSnaps[--numOpenSnaps];
+            atomic_fetch_sub(&snapsOpen, 1);
+            break;
+        }
+    }
+    if (collectorRunning)
+        pthread_cond_signal(&collectNow);
+    else
+        collectAll();
+    pthread_mutex_unlock(&snapLock);
+}
+
+/*
+ * rmSnapshotsOpen
+ * ---------------
+ * Returned how many snapshots were open.
+ */
+int rmSnapshotsOpen(void)
+{
+    return atomic_load(&snapsOpen);
+}
+
+/*
+ * rmWriteTimestamp
+ * ----------------
+ * Stamped a write with the next timestamp of the clock and registered it as
+ * in flight. A lower bound of the timestamp was put in a free slot before the
+ * clock moved, so the horizon never passed a write that was not applied yet.
+ * The write had to call rmWriteDone once it was applied, and a thread had one
+ * write in flight at a time. Only with RM_WRITE_SLOTS writes in flight did a
+ * write wait (for a slot).
+ */
+RM_Timestamp rmWriteTimestamp(void)
+{
+    if (writeSlot < 0)
+        writeSlot = atomic_fetch_add(&nextWriteSlot, 1) % RM_WRITE_SLOTS;
+
+    RM_Timestamp bound = atomic_load(&clockNow) + 1;
+    for (int slot = writeSlot;; slot = (slot + 1) % RM_WRITE_SLOTS)
+    {
+        RM_Timestamp free = 0;
+        if (atomic_compare_exchange_strong(&writing[slot], &free, bound))
+        {
+            writeSlot = slot;
+            break;
+        }
+        if ((slot + 1) % RM_WRITE_SLOTS == writeSlot)
+            sched_yield();
+    }
+
+    RM_Timestamp ts = atomic_fetch_add(&clockNow, 1) + 1;
+    atomic_store(&writing[writeSlot], ts);
+    return ts;
+}
+
+/*
+ * rmWriteDone
+ * -----------
+ * Ended a write started by rmWriteTimestamp. Returned true if no snapshot
+ * could need what the write had saved: none was open, and no older write was
+ * in flight, so every snapshot started from now on saw the write. The floor
+ * was raised past it before the snapshots were counted, so one starting
+ * meanwhile saw it too.
+ */
+bool rmWriteDone(RM_Timestamp ts)
+{
+    atomic_store(&writing[writeSlot], 0);
+    for (int i = 0; i < RM_WRITE_SLOTS; i++)
+    {
+        RM_Timestamp w = atomic_load(&writing[i]);
+        if (w != 0 && w <= ts)
+            return false;
+    }
+    raiseFloor(ts);
+    return atomic_load(&snapsOpen) == 0;
+}
+
+/*
+ * rmCurrentTimestamp
+ * ------------------
+ * Returned the timestamp of the newest write.
+ */
+RM_Timestamp rmCurrentTimestamp(void)
+{
+    return atomic_load(&clockNow);
+}
+
+/*
+ * rmVersionInit
+ * -------------
+ * Set up an empty version store and registered it with the collector.
+ */
+void rmVersionInit(RM_VersionStore *vs, int recordSize)
+{
+    for (int i = 0; i < RM_VERSION_LOCKS; i++)
+        pthread_mutex_init(&vs->locks[i], NULL);
+    vs->recordSize  = recordSize;
+    vs->numBuckets  = RM_VERSION_BUCKETS;
+    vs->buckets     = (RM_VersionChain **) calloc(RM_VERSION_BUCKETS, sizeof(RM_VersionChain *));
+    atomic_init(&vs->numChains, 0);
+    atomic_init(&vs->numVersions, 0);
+
+    pthread_mutex_lock(&snapLock);
+    vs->nextStore = stores;
+    stores = vs;
+    pthread_mutex_unlock(&snapLock);
+}
+
+/*
+ * bucketLock
+ * ----------
+ * Returned the lock of the bucket a RID's page hashed to.
+ */
+static pthread_mutex_t *bucketLock(RM_VersionStore *vs, int page)
+{
+    return &vs->locks[(page % vs->numBuckets) % RM_VERSION_LOCKS];
+}
+
+/*
+ * freeVersions
+ * ------------
+ * Released a list of versions and returned how many there were.
+ */
+static int freeVersions(RM_Version *v)
+{
+    int n = 0;
+    while (v != NULL)
+    {
+        RM_Version *older = v->older;
+        free(v->data);
+        free(v);
+        v = older;
+        n++;
+    }
+    return n;
+}
+
+/*
+ * rmVersionFree
+ * -------------
+ * Unregistered a version store and released all of its chains.
+ */
+void rmVersionFree(RM_VersionStore *vs)
+{
+    pthread_mutex_lock(&snapLock);
+    for (RM_VersionStore **p = &stores; *p != NULL; p = &(*p)->nextStore)
+    {
+        if (*p == vs)
+        {
+            *p = vs->nextStore;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&snapLock);
+
+    for (int b = 0; b < vs->numBuckets; b++)
+    {
+        RM_VersionChain *c = vs->buckets[b];
+        while (c != NULL)
+        {
+            RM_VersionChain *next = c->next;
+            freeVersions(c->versions);
+            free(c);
+            c = next;
+        }
+    }
+    free(vs->buckets);
+    for (int i = 0; i < RM_VERSION_LOCKS; i++)
+        pthread_mutex_destroy(&vs->locks[i]);
+}
+
+/*
+ * findChain
+ * ---------
+ * Found the chain of a RID, or NULL. The caller held the lock of its bucket.
+ */
+static RM_VersionChain *findChain(RM_VersionStore *vs, RID id)
+{
+    for (RM_VersionChain *c = vs->buckets[id.page % vs->numBuckets]; c != NULL; c = c->next)
+        if (c->id.page == id.page && c->id.slot == id.slot)
+            return c;
+    return NULL;
+}
+
+/*
+ * visibleVersion
+ * --------------
+ * Found the version of a chain a snapshot saw, or NULL if the page's version
+ * was the visible one. *none was set if nothing at all was visible.
+ */
+static RM_Version *visibleVersion(RM_VersionChain *c, RM_Timestamp snap, bool *none)
+{
+    *none = false;
+    if (c == NULL || c->headBegin <= snap)
+        return NULL;
+    for (RM_Version *v = c->versions; v != NULL; v = v->older)
+    {
+        if (v->begin <= snap && snap < v->end)
+        {
+            *none = (v->data == NULL);
+            return v;
+        }
+    }
+    *none = true;
+    return NULL;
+}
+
+/*
+ * rmVersionAdd
+ * ------------
+ * Saved the version a write at 'ts' replaced: oldData, or NULL if the slot had
+ * held no record.
+ */
+void rmVersionAdd(RM_VersionStore *vs, RID id, RM_Timestamp ts, char *oldData)
+{
+    RM_Version *v = (RM_Version *) malloc(sizeof(RM_Version));
+    v->end  = ts;
+    v->data = NULL;
+    if (oldData != NULL)
+    {
+        v->data = (char *) malloc(vs->recordSize);
+        memcpy(v->data, oldData, vs->recordSize);
+    }
+
+    pthread_mutex_t *lock = bucketLock(vs, id.page);
+    pthread_mutex_lock(lock);
+    RM_VersionChain *c = findChain(vs, id);
+    if (c == NULL)
+    {
+        // Whatever the slot held had been there since before any snapshot
+        c = (RM_VersionChain *) malloc(sizeof(RM_VersionChain));
+        c->id        = id;
+        c->headBegin = 0;
+        c->versions  = NULL;
+        c->next      = vs->buckets[id.page % vs->numBuckets];
+        vs->buckets[id.page % vs->numBuckets] = c;
+        atomic_fetch_add(&vs->numChains, 1);
+    }
+    v->begin     = c->headBegin;
+    v->older     = c->versions;
+    c->versions  = v;
+    c->headBegin = ts;
+    atomic_fetch_add(&vs->numVersions, 1);
+    pthread_mutex_unlock(lock);
+}
+
+/*
+ * rmVersionGet
+ * ------------
+ * Looked up what a snapshot saw of a RID. For RM_VERSION_OLD the version was
+ * copied to 'data'.
+ */
+int rmVersionGet(RM_VersionStore *vs, RID id, RM_Timestamp snap, char *data)
+{
+    bool none;
+    int result = RM_VERSION_CURRENT;
+
+    pthread_mutex_t *lock = bucketLock(vs, id.page);
+    pthread_mutex_lock(lock);
+    RM_Version *v = visibleVersion(findChain(vs, id), snap, &none);
+    if (none)
+        result = RM_VERSION_NONE;
+    else if (v != NULL)
+    {
+        memcpy(data, v->data, vs->recordSize);
+        result = RM_VERSION_OLD;
+    }
+    pthread_mutex_unlock(lock);
+    return result;
+}
+
+/*
+ * rmVersionsOnPage
+ * ----------------
+ * Listed the chains of RIDs on 'page' whose page version was newer than the
+ * snapshot, with the version the snapshot saw instead (copied to data, one
+ * recordSize entry per hit). At most 'max' were filled in; the number there
+ * were was returned, so the caller could grow its arrays and ask again.
+ */
+int rmVersionsOnPage(RM_VersionStore *vs, int page, RM_Timestamp snap, RM_VersionHit *hits, char *data, int max)
+{
+    int n = 0;
+
+    pthread_mutex_t *lock = bucketLock(vs, page);
+    pthread_mutex_lock(lock);
+    for (RM_VersionChain *c = vs->buckets[page % vs->numBuckets]; c != NULL; c = c->next)
+    {
+        if (c->id.page != page || c->headBegin <= snap)
+            continue;
+        if (n < max)
+        {
+            bool none;
+            RM_Version *v = visibleVersion(c, snap, &none);
+            hits[n].id      = c->id;
+            hits[n].visible = (v != NULL && !none);
+            if (hits[n].visible)
+                memcpy(data + (size_t) n * vs->recordSize, v->data, vs->recordSize);
+        }
+        n++;
+    }
+    pthread_mutex_unlock(lock);
+    return n;
+}
+
+/*
+ * collectBucket
+ * -------------
+ * Did the work of rmVersionCollect for one bucket, with its lock held.
+ */
+static void collectBucket(RM_VersionStore *vs, int b, RM_Timestamp oldest)
+{
+    RM_VersionChain **link = &vs->buckets[b];
+    while (*link != NULL)
+    {
+        RM_VersionChain *c = *link;
+        if (c->headBegin <= oldest)
+        {
+            atomic_fetch_sub(&vs->numVersions, freeVersions(c->versions));
+            atomic_fetch_sub(&vs->numChains, 1);
+            *link = c->next;
+            free(c);
+            continue;
+        }
+
+        // Versions only got older down the chain, so the rest went at once
+        for (RM_Version **v = &c->versions; *v != NULL; v = &(*v)->older)
+        {
+            if ((*v)->end <= oldest)
+            {
+                atomic_fetch_sub(&vs->numVersions, freeVersions(*v));
+                *v = NULL;
+                break;
+            }
+        }
+        link = &c->next;
+    }
+}
+
+/*
+ * rmVersionCollect
+ * ----------------
+ * Dropped every version that ended no later than 'oldest' (the oldest open
+ * snapshot), and every chain all open snapshots read from the page. One
+ * bucket was locked at a time.
+ */
+void rmVersionCollect(RM_VersionStore *vs, RM_Timestamp oldest)
+{
+    for (int b = 0; b < vs->numBuckets; b++)
+    {
+        pthread_mutex_t *lock = &vs->locks[b % RM_VERSION_LOCKS];
+        pthread_mutex_lock(lock);
+        collectBucket(vs, b, oldest);
+        pthread_mutex_unlock(lock);
+    }
+}
+
+/*
+ * rmVersionDrop
+ * -------------
+ * Dropped the chain of a RID written at 'ts' once rmWriteDone had found that
+ * no snapshot could need it, unless a newer write had saved a version since.
+ */
+void rmVersionDrop(RM_VersionStore *vs, RID id, RM_Timestamp ts)
+{
+    pthread_mutex_t *lock = bucketLock(vs, id.page);
+    pthread_mutex_lock(lock);
+    for (RM_VersionChain **link = &vs->buckets[id.page % vs->numBuckets]; *link != NULL; link = &(*link)->next)
+    {
+        RM_VersionChain *c = *link;
+        if (c->id.page == id.page && c->id.slot == id.slot)
+        {
+            if (c->headBegin <= ts)
+            {
+                atomic_fetch_sub(&vs->numVersions, freeVersions(c->versions));
+                atomic_fetch_sub(&vs->numChains, 1);
+                *link = c->next;
+                free(c);
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(lock);
+}
+
+/*
+ * rmVersionCount
+ * --------------
+ * Returned how many old versions the store held.
+ */
+int rmVersionCount(RM_VersionStore *vs)
+{
+    return atomic_load(&vs->numVersions);
+}
@@ -0,0 +1,104 @@
+#ifndef RM_VERSION_H
+#define RM_VERSION_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "dberror.h"
+#include "tables.h"
+#include "record_mgr.h"
+
+/*
+ * Row versions for snapshot reads (multi-version concurrency control).
+ *
+ * Every insert, update and delete took a timestamp from one clock shared by all
+ * tables, and a snapshot saw exactly the writes with timestamps up to its own.
+ * Pages only ever held the newest version of a record. A write first saved
+ * the version it replaced in the table's version store, which kept one chain
+ * per RID:
+ *   - headBegin: when the contents of the slot on the page (a record, or no
+ *                record after a delete) had begun,
+ *   - the older versions, newest first, each with the begin and end timestamps
+ *     between which it had been the current one. An insert saved an empty
+ *     version, so snapshots from before it did not see the record.
+ * A reader whose snapshot was older than headBegin used the chain's version
+ * instead of the page.
+ *
+ * Nobody waited for anybody. A write was stamped with an atomic increment of
+ * the clock and registered in a slot of in-flight writes until it was
+ * applied. A snapshot took the horizon: the newest timestamp up to which
+ * every write had been applied (one less than the oldest write in flight).
+ * Writes in flight were always newer than any snapshot that could start, so
+ * every write saved a version, and when it was done and found no snapshot
+ * open, it dropped the chains it had made itself.
+ *
+ * A version ended no later than the oldest open snapshot was visible to
+ * nobody, and a chain whose headBegin every open snapshot saw was not needed
+ * at all. A collector thread dropped both in the background.
+ */
+
+/* rmVersionGet results */
+#define RM_VERSION_CURRENT  0   /* the record on the page was the visible one */
+#define RM_VERSION_OLD      1   /* an older version was copied out */
+#define RM_VERSION_NONE     2   /* no version was visible */
+
+/* How often the collector looked for versions to drop without being woken. */
+#define RM_VERSION_COLLECT_MSEC  50
+
+/* Writes in flight at once before another had to wait for a slot. */
+#define RM_WRITE_SLOTS      64
+
+/* Lock stripes of a version store: bucket b used locks[b % RM_VERSION_LOCKS]. */
+#define RM_VERSION_LOCKS    16
+
+typedef struct RM_Version {
+    RM_Timestamp begin;
+    RM_Timestamp end;
+    char *data;                 /* record->data of the version, NULL if none existed */
+    struct RM_Version *older;
+} RM_Version;
+
+typedef struct RM_VersionChain {
+    RID id;
+    RM_Timestamp headBegin;
+    RM_Version *versions;       /* newest first */
+    struct RM_VersionChain *next;
+} RM_VersionChain;
+
+/* A diverged chain on one page, as seen by a snapshot (see rmVersionsOnPage). */
+typedef struct RM_VersionHit {
+    RID id;
+    int visible;                /* 1 if a version was visible (its data was copied) */
+} RM_VersionHit;
+
+typedef struct RM_VersionStore {
+    pthread_mutex_t locks[RM_VERSION_LOCKS];
+    int recordSize;
+    int numBuckets;             /* chains were hashed by the page of their RID */
+    RM_VersionChain **buckets;
+    atomic_int numChains;
+    atomic_int numVersions;
+    struct RM_VersionStore *nextStore;   /* registered with the collector */
+} RM_VersionStore;
+
+/* the clock, snapshots and the collector */
+extern void rmVersionStart (void);
+extern void rmVersionStop (void);
+extern RM_Timestamp rmSnapshotBegin (void);
+extern void rmSnapshotEnd (RM_Timestamp ts);
+extern int rmSnapshotsOpen (void);
+extern RM_Timestamp rmWriteTimestamp (void);
+extern bool rmWriteDone (RM_Timestamp ts);
+extern RM_Timestamp rmCurrentTimestamp (void);
+
+/* per-table version stores */
+extern void rmVersionInit (RM_VersionStore *vs, int recordSize);
+extern void rmVersionFree (RM_VersionStore *vs);
+extern void rmVersionAdd (RM_VersionStore *vs, RID id, RM_Timestamp ts, char *oldData);
+extern int rmVersionGet (RM_VersionStore *vs, RID id, RM_Timestamp snap, char *data);
+extern int rmVersionsOnPage (RM_VersionStore *vs, int page, RM_Timestamp snap, RM_VersionHit *hits, char *data, int max);
+extern void rmVersionCollect (RM_VersionStore *vs, RM_Timestamp oldest);
+extern void rmVersionDrop (RM_VersionStore *vs, RID id, RM_Timestamp ts);
+extern int rmVersionCount (RM_VersionStore *vs);
+
+#endif // RM_VERSION_H
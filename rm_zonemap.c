@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "rm_zonemap.h"
+#include "record_mgr.h"
+#include "dberror.h"
+
+/*
+ * rm_zonemap.c
+ * ---------------------------------------------------------------
+ * Per-page min/max summaries used by scans to skip pages. The record manager
+ * kept the map in memory while a table was open and stored it in an overflow
+ * chain when the table was closed. See rm_zonemap.h for the entry layout.
+ */
+
+/*
+ * rmZoneInit
+ * ----------
+ * Set up an empty zone map for the given attributes (none is fine: every call
+ * on such a map did nothing and every page "may match").
+ */
+void rmZoneInit(RM_ZoneMap *zm, Schema *schema, int numAttrs, int *attrs)
+{
+    zm->numAttrs   = numAttrs;
+    zm->attrs      = NULL;
+    zm->valOffset  = NULL;
+    zm->entrySize  = 1;
+    zm->numEntries = 0;
+    zm->entries    = NULL;
+    pthread_mutex_init(&zm->lock, NULL);
+
+    if (numAttrs <= 0)
+    {
+        zm->numAttrs = 0;
+        return;
+    }
+
+    zm->attrs     = (int *) malloc(numAttrs * sizeof(int));
+    zm->valOffset = (int *) malloc(numAttrs * sizeof(int));
+    for (int i = 0; i < numAttrs; i++)
+    {
+        zm->attrs[i]     = attrs[i];
+        zm->valOffset[i] = zm->entrySize;
+        zm->entrySize   += 2 * getAttrSize(schema, attrs[i]);
+    }
+}
+
+/*
+ * rmZoneFree
+ * ----------
+ * Released the memory of a zone map.
+ */
+void rmZoneFree(RM_ZoneMap *zm)
+{
+    free(zm->attrs);
+    free(zm->valOffset);
+    free(zm->entries);
+    zm->attrs     = NULL;
+    zm->valOffset = NULL;
+    zm->entries   = NULL;
+    zm->numAttrs  = 0;
+    zm->numEntries = 0;
+    pthread_mutex_destroy(&zm->lock);
+}
+
+/*
+ * reserve
+ * -------
+ * Grew the map so it covered at least numEntries pages. New entries were
+ * empty. The caller held the map's mutex.
+ */
+static void reserve(RM_ZoneMap *zm, int numEntries)
+{
+    if (numEntries <= zm->numEntries)
+        return;
+
+    // Grew geometrically, since tables mostly grew one page at a time
+    int newCount = (zm->numEntries > 0) ? zm->numEntries : 16;
+    while (newCount < numEntries)
+        newCount *= 2;
+
+    zm->entries = (char *) realloc(zm->entries, (size_t) newCount * zm->entrySize);
+    memset(zm->entries + (size_t) zm->numEntries * zm->entrySize, 0,
+           (size_t) (newCount - zm->numEntries) * zm->entrySize);
+    zm->numEntries = newCount;
+}
+
+/*
+ * rmZoneReserve
+ * -------------
+ * Grew the map so it covered at least numEntries pages. New entries were empty.
+ */
+void rmZoneReserve(RM_ZoneMap *zm, int numEntries)
+{
+    if (zm->numAttrs == 0)
+        return;
+    pthread_mutex_lock(&zm->lock);
+    reserve(zm, numEntries);
+    pthread_mutex_unlock(&zm->lock);
+}
+
+/*
+ * compareRaw
+ * ----------
+ * Compared two values of an attribute in their record->data byte format.
+ * Returned <0, 0 or >0 like strcmp.
+ */
+static int compareRaw(DataType dt, const char *a, const char *b, int width)
+{
+    switch (dt)
+    {
+        case DT_INT:
+        case DT_BLOB:   // large objects compared by id
+        {
+            int x, y;
+            memcpy(&x, a, sizeof(int));
+            memcpy(&y, b, sizeof(int));
+            return (x > y) - (x < y);
+        }
+        case DT_FLOAT:
+        {
+            float x, y;
+            memcpy(&x, a, sizeof(float));
+            memcpy(&y, b, sizeof(float));
+            return (x > y) - (x < y);
+        }
+        case DT_BOOL:
+            return (a[0] != 0) - (b[0] != 0);
+        case DT_STRING:
+            return strncmp(a, b, width);
+    }
+    return 0;
+}
+
+/*
+ * rmZoneAdd
+ * ---------
+ * Widened the range of a page so it included the zoned attributes of a record
+ * that was just stored there.
+ */
+void rmZoneAdd(RM_ZoneMap *zm, Schema *schema, int pageNum, char *recData)
+{
+    if (zm->numAttrs == 0)
+        return;
+    pthread_mutex_lock(&zm->lock);
+    reserve(zm, pageNum + 1);
+
+    char *entry = zm->entries + (size_t) pageNum * zm->entrySize;
+    bool first = (entry[0] == RM_ZONE_EMPTY);
+
+    for (int i = 0; i < zm->numAttrs; i++)
+    {
+        int attr  = zm->attrs[i];
+        int width = getAttrSize(schema, attr);
+        char *val = recData + schema->attrOffsets[attr];
+        char *min = entry + zm->valOffset[i];
+        char *max = min + width;
+
+        if (first || compareRaw(schema->dataTypes[attr], val, min, width) < 0)
+            memcpy(min, val, width);
+        if (first || compareRaw(schema->dataTypes[attr], val, max, width) > 0)
+            memcpy(max, val, width);
+    }
+    entry[0] = RM_ZONE_RANGE;
+    pthread_mutex_unlock(&zm->lock);
+}
+
+/*
+ * rmZoneClear
+ * -----------
+ * Marked a page as holding no records.
+ */
+void rmZoneClear(RM_ZoneMap *zm, int pageNum)
+{
+    if (zm->numAttrs == 0)
+        return;
+    pthread_mutex_lock(&zm->lock);
+    if (pageNum < zm->numEntries)
+        memset(zm->entries + (size_t) pageNum * zm->entrySize, 0, zm->entrySize);
+    pthread_mutex_unlock(&zm->lock);
+}
+
+/*
+ * rangeMayHold
+ * ------------
+ * Checked whether some value in [min, max] could satisfy "value <op> c".
+ */
+static bool rangeMayHold(DataType dt, CompOp op, const char *min, const char *max,
+                         const char *c, int width)
+{
+    switch (op)
+    {
+        case COMP_EQ: return compareRaw(dt, min, c, width) <= 0 && compareRaw(dt, max, c, width) >= 0;
+        case COMP_LT: return compareRaw(dt, min, c, width) <  0;
+        case COMP_LE: return compareRaw(dt, min, c, width) <= 0;
+        case COMP_GT: return compareRaw(dt, max, c, width) >  0;
+        case COMP_GE: return compareRaw(dt, max, c, width) >= 0;
+    }
+    return true;
+}
+
+/*
+ * mayMatch
+ * --------
+ * Decided whether a page could hold a record satisfying all of the given
+ * terms. Returned 0 only when that was certainly not the case: the page was
+ * empty, or the range of a zoned attribute ruled out one of the terms. Terms
+ * on other attributes, or with a constant of another type, were ignored.
+ * The caller held the map's mutex.
+ */
+static int mayMatch(RM_ZoneMap *zm, Schema *schema, int pageNum, AttrPredicate *preds, int numPreds)
+{
+    if (pageNum >= zm->numEntries)
+        return 0;
+
+    char *entry = zm->entries + (size_t) pageNum * zm->entrySize;
+    if (entry[0] == RM_ZONE_EMPTY)
+        return 0;
+
+    for (int p = 0; p < numPreds; p++)
+    {
+        int attr = preds[p].attrNum;
+        DataType dt = schema->dataTypes[attr];
+        if (preds[p].cons->dt != dt)
+            continue;
+
+        for (int i = 0; i < zm->numAttrs; i++)
+        {
+            if (zm->attrs[i] != attr)
+                continue;
+
+            // Brought the constant into the record byte format first
+            int width = getAttrSize(schema, attr);
+            char c[width + 1];
+            memset(c, 0, width + 1);
+            switch (dt)
+            {
+                case DT_INT:    memcpy(c, &preds[p].cons->v.intV, sizeof(int)); break;
+                case DT_FLOAT:  memcpy(c, &preds[p].cons->v.floatV, sizeof(float)); break;
+                case DT_BOOL:   c[0] = (preds[p].cons->v.boolV != 0); break;
+                case DT_STRING: strncpy(c, preds[p].cons->v.stringV, width + 1); break;
+                case DT_BLOB:   memcpy(c, &preds[p].cons->v.blobV, sizeof(int)); break;
+            }
+            // A string constant longer than the attribute could not be compared by prefix
+            if (dt == DT_STRING && c[width] != '\0')
+                break;
+
+            char *min = entry + zm->valOffset[i];
+            if (!rangeMayHold(dt, preds[p].op, min, min + width, c, width))
+                return 0;
+            break;
+        }
+    }
+    return 1;
+}
+
+/*
+ * rmZoneMayMatch
+ * --------------
+ * Decided whether a page could hold a record satisfying all of the given
+ * terms (see mayMatch); 1 if the table had no zone map.
+ */
+int rmZoneMayMatch(RM_ZoneMap *zm, Schema *schema, int pageNum, AttrPredicate *preds, int numPreds)
+{
+    if (zm->numAttrs == 0 || numPreds == 0)
+        return 1;
+
+    pthread_mutex_lock(&zm->lock);
+    int may = mayMatch(zm, schema, pageNum, preds, numPreds);
+    pthread_mutex_unlock(&zm->lock);
+    return may;
+}
@@ -0,0 +1,42 @@
+#ifndef RM_ZONEMAP_H
+#define RM_ZONEMAP_H
+
+#include <pthread.h>
+#include "dberror.h"
+#include "expr.h"
+#include "tables.h"
+
+/*
+ * Zone maps: a small min/max summary per page for a few chosen attributes.
+ *
+ * The map is one fixed-size entry per page number. An entry starts with a
+ * state byte (RM_ZONE_EMPTY until a record was added to the page), followed by
+ * the raw min and max value of every zoned attribute, in the same byte format
+ * as record->data. Inserts and updates only ever widened a range; a page went
+ * back to RM_ZONE_EMPTY when its last record was deleted. The ranges were
+ * therefore conservative: a page whose range could not satisfy a scan term
+ * certainly held no matching record. Every call took the map's mutex, so
+ * threads writing one table could widen ranges while scans read them.
+ */
+
+#define RM_ZONE_EMPTY   0
+#define RM_ZONE_RANGE   1
+
+typedef struct RM_ZoneMap {
+    int numAttrs;       /* zoned attributes; 0 => the table had no zone map */
+    int *attrs;         /* their attribute numbers */
+    int *valOffset;     /* where each attribute's min starts within an entry (max follows) */
+    int entrySize;
+    int numEntries;     /* pages covered so far; pages beyond were empty */
+    char *entries;
+    pthread_mutex_t lock;
+} RM_ZoneMap;
+
+extern void rmZoneInit (RM_ZoneMap *zm, Schema *schema, int numAttrs, int *attrs);
+extern void rmZoneFree (RM_ZoneMap *zm);
+extern void rmZoneReserve (RM_ZoneMap *zm, int numEntries);
+extern void rmZoneAdd (RM_ZoneMap *zm, Schema *schema, int pageNum, char *recData);
+extern void rmZoneClear (RM_ZoneMap *zm, int pageNum);
+extern int rmZoneMayMatch (RM_ZoneMap *zm, Schema *schema, int pageNum, AttrPredicate *preds, int numPreds);
+
+#endif // RM_ZONEMAP_H
@@ -0,0 +1,816 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "sm_extent.h"
+#include "dberror.h"
+
+/*
+ * sm_extent.c
+ * ---------------------------------------------------------------
+ * The codec and the extent map behind compressed page files. storage_mgr.c
+ * handed every block operation on such a file to the functions here. See
+ * sm_extent.h for the file layout.
+ */
+
+/* The file header, at the start of sector 0. */
+typedef struct SM_FileHeader {
+    char magic[8];
+    int codec;
+    int numPages;
+    int clean;        // 1 => the map saved at mapSector was valid
+    int mapSector;
+    int endSector;
+    unsigned nextSeq;
+} SM_FileHeader;
+
+/* The start of every region from sector 1 on. */
+typedef struct SM_ExtentHeader {
+    int pageNum;      // -1 => a free region
+    int sectors;      // length of the region, this header included
+    int length;       // bytes stored after the header
+    int raw;          // 1 => the page was stored uncompressed
+    unsigned seq;
+} SM_ExtentHeader;
+
+/* One entry of the saved map. */
+typedef struct SM_SavedExtent {
+    int sector;
+    int sectors;
+} SM_SavedExtent;
+
+#define SM_LZ_MIN_MATCH    3
+#define SM_LZ_MAX_MATCH    (127 + SM_LZ_MIN_MATCH)
+#define SM_LZ_MIN_REPEAT   2
+#define SM_LZ_MAX_REPEAT   (63 + SM_LZ_MIN_REPEAT)
+#define SM_LZ_MAX_LITERALS 64
+#define SM_LZ_HASH_BITS    12
+
+/* The most sectors one page could take. */
+#define SM_MAX_SECTORS ((int) ((sizeof(SM_ExtentHeader) + PAGE_SIZE + SM_SECTOR - 1) / SM_SECTOR))
+
+/* Compressed files open in this process, shared by their handles. */
+static SM_ExtentFile *openFiles = NULL;
+static pthread_mutex_t openFilesLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* --------------------------------------------------------------------------
+   Codec
+   -------------------------------------------------------------------------- */
+
+/*
+ * putLiterals
+ * -----------
+ * Wrote src[from..to) as literal tokens. Returned the new output length, or
+ * -1 if it did not fit.
+ */
+static int putLiterals(const unsigned char *src, int from, int to, char *dest, int out, int cap)
+{
+    while (from < to)
+    {
+        int n = (to - from > SM_LZ_MAX_LITERALS) ? SM_LZ_MAX_LITERALS : to - from;
+        if (out + 1 + n > cap)
+            return -1;
+        dest[out++] = (char) (n - 1);
+        memcpy(dest + out, src + from, n);
+        out  += n;
+        from += n;
+    }
+    return out;
+}
+
+/*
+ * matchLength
+ * -----------
+ * Returned how many bytes from pos repeated the bytes from cand on, up to max.
+ */
+static int matchLength(const unsigned char *in, int len, int cand, int pos, int max)
+{
+    int n = 0;
+    while (n < max && pos + n < len && in[cand + n] == in[pos + n])
+        n++;
+    return n;
+}
+
+/*
+ * smCodecCompress
+ * ---------------
+ * Compressed len bytes greedily. At every position the bytes at the last
+ * offset used were tried first (records of a page repeated at a fixed
+ * stride, and such a match took one byte); otherwise the position was looked
+ * up by its first three bytes in a table of the last position with the same
+ * hash.
+ */
+int smCodecCompress(const char *src, int len, char *dest, int cap)
+{
+    const unsigned char *in = (const unsigned char *) src;
+    int table[1 << SM_LZ_HASH_BITS];
+    int out = 0, pos = 0, litStart = 0, lastOffset = 0;
+
+    memset(table, 0xff, sizeof(table));
+    while (pos + SM_LZ_MIN_MATCH <= len)
+    {
+        unsigned key = ((unsigned) in[pos] << 16) | ((unsigned) in[pos + 1] << 8) | in[pos + 2];
+        unsigned h = (key * 2654435761u) >> (32 - SM_LZ_HASH_BITS);
+        int cand = table[h];
+        int repeatLen = 0, matchLen = 0;
+        table[h] = pos;
+
+        if (lastOffset > 0 && pos >= lastOffset)
+            repeatLen = matchLength(in, len, pos - lastOffset, pos, SM_LZ_MAX_REPEAT);
+        if (cand >= 0 && pos - cand <= 0xffff)
+            matchLen = matchLength(in, len, cand, pos, SM_LZ_MAX_MATCH);
+
+        // A repeat was two bytes shorter to write than a match
+        if (repeatLen >= SM_LZ_MIN_REPEAT && repeatLen + 2 >= matchLen)
+        {
+            out = putLiterals(in, litStart, pos, dest, out, cap);
+            if (out < 0 || out + 1 > cap)
+                return -1;
+            dest[out++] = (char) (0x40 | (repeatLen - SM_LZ_MIN_REPEAT));
+            pos += repeatLen;
+        }
+        else if (matchLen >= SM_LZ_MIN_MATCH)
+        {
+            out = putLiterals(in, litStart, pos, dest, out, cap);
+            if (out < 0 || out + 3 > cap)
+                return -1;
+            lastOffset = pos - cand;
+            dest[out++] = (char) (0x80 | (matchLen - SM_LZ_MIN_MATCH));
+            dest[out++] = (char) (lastOffset & 0xff);
+            dest[out++] = (char) (lastOffset >> 8);
+            pos += matchLen;
+        }
+        else
+        {
+            pos++;
+            continue;
+        }
+        litStart = pos;
+    }
+    return putLiterals(in, litStart, len, dest, out, cap);
+}
+
+/*
+ * smCodecDecompress
+ * -----------------
+ * Undid smCodecCompress. Returned -1 for input that smCodecCompress could not
+ * have written.
+ */
+int smCodecDecompress(const char *src, int len, char *dest, int cap)
+{
+    const unsigned char *in = (const unsigned char *) src;
+    int ip = 0, out = 0, lastOffset = 0;
+
+    while (ip < len)
+    {
+        int c = in[ip++];
+        if (c < 0x40)
+        {
+            int n = c + 1;
+            if (ip + n > len || out + n > cap)
+                return -1;
+            memcpy(dest + out, in + ip, n);
+            ip  += n;
+            out += n;
+            continue;
+        }
+
+        int n;
+        if (c < 0x80)
+            n = (c & 0x3f) + SM_LZ_MIN_REPEAT;
+        else
+        {
+            n = (c & 0x7f) + SM_LZ_MIN_MATCH;
+            if (ip + 2 > len)
+                return -1;
+            lastOffset = in[ip] | (in[ip + 1] << 8);
+            ip += 2;
+        }
+        if (lastOffset == 0 || lastOffset > out || out + n > cap)
+            return -1;
+        for (int k = 0; k < n; k++, out++)
+            dest[out] = dest[out - lastOffset];
+    }
+    return out;
+}
+
+/* --------------------------------------------------------------------------
+   Sectors and regions
+   -------------------------------------------------------------------------- */
+
+/*
+ * readAt
+ * ------
+ * Read len bytes starting at a sector.
+ */
+static RC readAt(SM_ExtentFile *ef, int sector, void *buf, size_t len)
+{
+    if (fseek(ef->fp, (long) sector * SM_SECTOR, SEEK_SET) != 0
+        || fread(buf, 1, len, ef->fp) != len)
+        return RC_READ_NON_EXISTING_PAGE;
+    return RC_OK;
+}
+
+/*
+ * writeAt
+ * -------
+ * Wrote len bytes starting at a sector.
+ */
+static RC writeAt(SM_ExtentFile *ef, int sector, const void *buf, size_t len)
+{
+    if (fseek(ef->fp, (long) sector * SM_SECTOR, SEEK_SET) != 0
+        || fwrite(buf, 1, len, ef->fp) != len)
+        return RC_WRITE_FAILED;
+    return RC_OK;
+}
+
+/*
+ * writeHeader
+ * -----------
+ * Wrote the file header from the open state.
+ */
+static RC writeHeader(SM_ExtentFile *ef, int mapSector)
+{
+    SM_FileHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SM_EXTENT_MAGIC, sizeof(hdr.magic));
+    hdr.codec     = (int) ef->codec;
+    hdr.numPages  = ef->numPages;
+    hdr.clean     = ef->clean ? 1 : 0;
+    hdr.mapSector = mapSector;
+    hdr.endSector = ef->endSector;
+    hdr.nextSeq   = ef->nextSeq;
+    return writeAt(ef, 0, &hdr, sizeof(hdr));
+}
+
+/*
+ * cutFile
+ * -------
+ * Cut the file back to endSector sectors.
+ */
+static RC cutFile(SM_ExtentFile *ef)
+{
+    fflush(ef->fp);
+    if (ftruncate(fileno(ef->fp), (off_t) ef->endSector * SM_SECTOR) != 0)
+        return RC_WRITE_FAILED;
+    return RC_OK;
+}
+
+/*
+ * beginChange
+ * -----------
+ * Made sure the header no longer claimed a clean file before anything
+ * changed, and dropped the saved map that followed the last region.
+ */
+static RC beginChange(SM_ExtentFile *ef)
+{
+    if (!ef->clean)
+        return RC_OK;
+    ef->clean = false;
+    RC rc = cutFile(ef);
+    if (rc != RC_OK) return rc;
+    return writeHeader(ef, 0);
+}
+
+/*
+ * reserveMap
+ * ----------
+ * Grew the map so it covered numPages pages; new pages had no extent.
+ */
+static void reserveMap(SM_ExtentFile *ef, int numPages)
+{
+    if (numPages <= ef->mapCap)
+        return;
+    int cap = (ef->mapCap > 0) ? ef->mapCap : 16;
+    while (cap < numPages)
+        cap *= 2;
+    ef->map = (SM_Extent *) realloc(ef->map, cap * sizeof(SM_Extent));
+    memset(ef->map + ef->mapCap, 0, (cap - ef->mapCap) * sizeof(SM_Extent));
+    ef->mapCap = cap;
+}
+
+/*
+ * addFree
+ * -------
+ * Remembered a free region, merging it with a free neighbour.
+ */
+static void addFree(SM_ExtentFile *ef, int sector, int sectors)
+{
+    for (int i = 0; i < ef->numFree; i++)
+    {
+        SM_Extent *r = &ef->freeRegions[i];
+        if (r->sector + r->sectors == sector)
+        {
+            r->sectors += sectors;
+            return;
+        }
+        if (sector + sectors == r->sector)
+        {
+            r->sector   = sector;
+            r->sectors += sectors;
+            return;
+        }
+    }
+    if (ef->numFree == ef->freeCap)
+    {
+        ef->freeCap = (ef->freeCap > 0) ? 2 * ef->freeCap : 16;
+        ef->freeRegions = (SM_Extent *) realloc(ef->freeRegions, ef->freeCap * sizeof(SM_Extent));
+    }
+    ef->freeRegions[ef->numFree].sector  = sector;
+    ef->freeRegions[ef->numFree].sectors = sectors;
+    ef->numFree++;
+}
+
+/*
+ * writeFreeHeader
+ * ---------------
+ * Marked a region as free on disk, so a walk of the regions stepped over it.
+ */
+static RC writeFreeHeader(SM_ExtentFile *ef, int sector, int sectors)
+{
+    SM_ExtentHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.pageNum = -1;
+    hdr.sectors = sectors;
+    return writeAt(ef, sector, &hdr, sizeof(hdr));
+}
+
+/*
+ * freeRegion
+ * ----------
+ * Gave a page's old extent back.
+ */
+static RC freeRegion(SM_ExtentFile *ef, int sector, int sectors)
+{
+    RC rc = writeFreeHeader(ef, sector, sectors);
+    if (rc != RC_OK) return rc;
+    addFree(ef, sector, sectors);
+    return RC_OK;
+}
+
+/*
+ * allocRegion
+ * -----------
+ * Found 'need' sectors: the first free region that was long enough (the rest
+ * of it stayed free), or the end of the file.
+ */
+static RC allocRegion(SM_ExtentFile *ef, int need, int *sector)
+{
+    for (int i = 0; i < ef->numFree; i++)
+    {
+        SM_Extent *r = &ef->freeRegions[i];
+        if (r->sectors < need)
+            continue;
+        *sector = r->sector;
+        if (r->sectors == need)
+        {
+            ef->freeRegions[i] = ef->freeRegions[--ef->numFree];
+            return RC_OK;
+        }
+        r->sector  += need;
+        r->sectors -= need;
+        return writeFreeHeader(ef, r->sector, r->sectors);
+    }
+    *sector = ef->endSector;
+    ef->endSector += need;
+    return RC_OK;
+}
+
+/*
+ * compareSectors
+ * --------------
+ * qsort comparator: extents by first sector.
+ */
+static int compareSectors(const void *a, const void *b)
+{
+    return ((const SM_Extent *) a)->sector - ((const SM_Extent *) b)->sector;
+}
+
+/*
+ * findFree
+ * --------
+ * Rebuilt the free list from the map: every gap between the extents in use
+ * was free.
+ */
+static void findFree(SM_ExtentFile *ef)
+{
+    SM_Extent *used = (SM_Extent *) malloc((ef->numPages > 0 ? ef->numPages : 1) * sizeof(SM_Extent));
+    int n = 0, at = 1;
+
+    for (int p = 0; p < ef->numPages; p++)
+        if (ef->map[p].sector > 0)
+            used[n++] = ef->map[p];
+    qsort(used, n, sizeof(SM_Extent), compareSectors);
+
+    ef->numFree = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (used[i].sector > at)
+            addFree(ef, at, used[i].sector - at);
+        at = used[i].sector + used[i].sectors;
+    }
+    if (ef->endSector > at)
+        addFree(ef, at, ef->endSector - at);
+    free(used);
+}
+
+/*
+ * walkRegions
+ * -----------
+ * Rebuilt the map of a file that was not closed cleanly from the region
+ * headers. The walk stopped at the first header that made no sense (a region
+ * being written when the process stopped), and the file was cut there.
+ */
+static RC walkRegions(SM_ExtentFile *ef)
+{
+    fseek(ef->fp, 0, SEEK_END);
+    int fileSectors = (int) (ftell(ef->fp) / SM_SECTOR);
+    int sector = 1;
+
+    while (sector < fileSectors)
+    {
+        SM_ExtentHeader hdr;
+        if (readAt(ef, sector, &hdr, sizeof(hdr)) != RC_OK)
+            break;
+        if (hdr.sectors < 1 || sector + hdr.sectors > fileSectors || hdr.pageNum < -1
+            || hdr.length < 0 || hdr.length > hdr.sectors * SM_SECTOR - (int) sizeof(hdr))
+            break;
+
+        // Pages cut off by a truncation that did not finish stayed free
+        if (hdr.pageNum >= 0 && hdr.pageNum < ef->numPages)
+        {
+            SM_Extent *e = &ef->map[hdr.pageNum];
+            if (e->sector == 0 || hdr.seq > e->seq)
+            {
+                e->sector  = sector;
+                e->sectors = hdr.sectors;
+                e->seq     = hdr.seq;
+            }
+            if (hdr.seq >= ef->nextSeq)
+                ef->nextSeq = hdr.seq + 1;
+        }
+        sector += hdr.sectors;
+    }
+
+    ef->endSector = sector;
+    return (sector < fileSectors) ? cutFile(ef) : RC_OK;
+}
+
+/* --------------------------------------------------------------------------
+   Compressed page files
+   -------------------------------------------------------------------------- */
+
+/*
+ * smExtentIsCompressed
+ * --------------------
+ * Told whether an open file started with the compressed file magic. The file
+ * position was left at the start.
+ */
+bool smExtentIsCompressed(FILE *fp)
+{
+    char magic[8];
+    bool found = (fread(magic, 1, sizeof(magic), fp) == sizeof(magic)
+                  && memcmp(magic, SM_EXTENT_MAGIC, sizeof(magic)) == 0);
+    rewind(fp);
+    return found;
+}
+
+/*
+ * smExtentCreate
+ * --------------
+ * Created a compressed file holding one page of zeros (like createPageFile),
+ * closed cleanly with an empty map.
+ */
+RC smExtentCreate(char *fileName, SM_Codec codec)
+{
+    SM_ExtentFile ef;
+    SM_SavedExtent none = { 0, 0 };
+    char sector[SM_SECTOR];
+
+    memset(&ef, 0, sizeof(ef));
+    ef.fp = fopen(fileName, "w");
+    if (ef.fp == NULL)
+        return RC_WRITE_FAILED;
+    ef.codec     = codec;
+    ef.numPages  = 1;
+    ef.clean     = true;
+    ef.endSector = 1;
+
+    memset(sector, 0, sizeof(sector));
+    RC rc = writeAt(&ef, 0, sector, sizeof(sector));
+    if (rc == RC_OK)
+        rc = writeHeader(&ef, 1);
+    if (rc == RC_OK)
+        rc = writeAt(&ef, 1, &none, sizeof(none));
+    fclose(ef.fp);
+    return rc;
+}
+
+/*
+ * smExtentOpen
+ * ------------
+ * Returned the open state of a compressed file, reading its header and map
+ * the first time (or rebuilding the map if the file was not closed cleanly).
+ */
+RC smExtentOpen(char *fileName, SM_ExtentFile **out)
+{
+    pthread_mutex_lock(&openFilesLock);
+    for (SM_ExtentFile *f = openFiles; f != NULL; f = f->next)
+        if (strcmp(f->fileName, fileName) == 0)
+        {
+            f->refCount++;
+            *out = f;
+            pthread_mutex_unlock(&openFilesLock);
+            return RC_OK;
+        }
+
+    SM_FileHeader hdr;
+    FILE *fp = fopen(fileName, "r+");
+    if (fp == NULL || fread(&hdr, 1, sizeof(hdr), fp) != sizeof(hdr)
+        || memcmp(hdr.magic, SM_EXTENT_MAGIC, sizeof(hdr.magic)) != 0)
+    {
+        if (fp != NULL)
+            fclose(fp);
+        pthread_mutex_unlock(&openFilesLock);
+        return RC_FILE_NOT_FOUND;
+    }
+
+    SM_ExtentFile *ef = (SM_ExtentFile *) calloc(1, sizeof(SM_ExtentFile));
+    ef->fileName  = strdup(fileName);
+    ef->fp        = fp;
+    ef->refCount  = 1;
+    ef->codec     = (SM_Codec) hdr.codec;
+    ef->numPages  = hdr.numPages;
+    ef->clean     = (hdr.clean != 0);
+    ef->nextSeq   = hdr.nextSeq;
+    pthread_mutex_init(&ef->lock, NULL);
+    reserveMap(ef, ef->numPages);
+
+    RC rc = RC_OK;
+    if (ef->clean)
+    {
+        SM_SavedExtent *saved = (SM_SavedExtent *) malloc((ef->numPages > 0 ? ef->numPages : 1) * sizeof(SM_SavedExtent));
+        rc = readAt(ef, hdr.mapSector, saved, ef->numPages * sizeof(SM_SavedExtent));
+        for (int p = 0; rc == RC_OK && p < ef->numPages; p++)
+        {
+            ef->map[p].sector  = saved[p].sector;
+            ef->map[p].sectors = saved[p].sectors;
+        }
+        ef->endSector = hdr.mapSector;
+        free(saved);
+    }
+    else
+        rc = walkRegions(ef);
+    if (rc == RC_OK)
+        findFree(ef);
+
+    if (rc != RC_OK)
+    {
+        fclose(fp);
+        free(ef->map);
+        free(ef->freeRegions);
+        free(ef->fileName);
+        pthread_mutex_destroy(&ef->lock);
+        free(ef);
+        pthread_mutex_unlock(&openFilesLock);
+        return rc;
+    }
+
+    ef->next  = openFiles;
+    openFiles = ef;
+    *out = ef;
+    pthread_mutex_unlock(&openFilesLock);
+    return RC_OK;
+}
+
+/*
+ * smExtentClose
+ * -------------
+ * Let go of the open state. The last handle saved the map after the last
+ * region and marked the file clean, if it had changed.
+ */
+RC smExtentClose(SM_ExtentFile *ef)
+{
+    RC rc = RC_OK;
+
+    pthread_mutex_lock(&openFilesLock);
+    if (--ef->refCount > 0)
+    {
+        pthread_mutex_unlock(&openFilesLock);
+        return RC_OK;
+    }
+    for (SM_ExtentFile **f = &openFiles; *f != NULL; f = &(*f)->next)
+        if (*f == ef)
+        {
+            *f = ef->next;
+            break;
+        }
+    pthread_mutex_unlock(&openFilesLock);
+
+    if (!ef->clean)
+    {
+        SM_SavedExtent *saved = (SM_SavedExtent *) malloc((ef->numPages > 0 ? ef->numPages : 1) * sizeof(SM_SavedExtent));
+        for (int p = 0; p < ef->numPages; p++)
+        {
+            saved[p].sector  = ef->map[p].sector;
+            saved[p].sectors = ef->map[p].sectors;
+        }
+        rc = writeAt(ef, ef->endSector, saved, ef->numPages * sizeof(SM_SavedExtent));
+        free(saved);
+
+        // The map went out before the header said it was there
+        fflush(ef->fp);
+        if (rc == RC_OK)
+        {
+            ef->clean = true;
+            rc = writeHeader(ef, ef->endSector);
+        }
+    }
+
+    fclose(ef->fp);
+    free(ef->map);
+    free(ef->freeRegions);
+    free(ef->fileName);
+    pthread_mutex_destroy(&ef->lock);
+    free(ef);
+    return rc;
+}
+
+/*
+ * smExtentRead
+ * ------------
+ * Read a page from its extent and decompressed it.
+ */
+RC smExtentRead(SM_ExtentFile *ef, int pageNum, char *page)
+{
+    char buf[SM_MAX_SECTORS * SM_SECTOR];
+    SM_ExtentHeader hdr;
+    RC rc = RC_OK;
+
+    pthread_mutex_lock(&ef->lock);
+    if (pageNum < 0 || pageNum >= ef->numPages)
+        rc = RC_READ_NON_EXISTING_PAGE;
+    else if (ef->map[pageNum].sector == 0)
+        memset(page, 0, PAGE_SIZE);
+    else
+    {
+        SM_Extent *e = &ef->map[pageNum];
+        int sectors = (e->sectors < SM_MAX_SECTORS) ? e->sectors : SM_MAX_SECTORS;
+        rc = readAt(ef, e->sector, buf, (size_t) sectors * SM_SECTOR);
+        if (rc == RC_OK)
+        {
+            memcpy(&hdr, buf, sizeof(hdr));
+            char *data = buf + sizeof(hdr);
+            if (hdr.pageNum != pageNum || hdr.length > sectors * SM_SECTOR - (int) sizeof(hdr))
+                rc = RC_READ_NON_EXISTING_PAGE;
+            else if (hdr.raw)
+                memcpy(page, data, PAGE_SIZE);
+            else if (smCodecDecompress(data, hdr.length, page, PAGE_SIZE) != PAGE_SIZE)
+                rc = RC_READ_NON_EXISTING_PAGE;
+        }
+    }
+    pthread_mutex_unlock(&ef->lock);
+    return rc;
+}
+
+/*
+ * smExtentWrite
+ * -------------
+ * Compressed a page and wrote it over its extent if it still fit there, or
+ * else to a new extent, freeing the old one afterwards (until then a crash
+ * left both, and the newer one won).
+ */
+RC smExtentWrite(SM_ExtentFile *ef, int pageNum, char *page)
+{
+    char buf[SM_MAX_SECTORS * SM_SECTOR];
+    SM_ExtentHeader hdr;
+
+    pthread_mutex_lock(&ef->lock);
+    if (pageNum < 0 || pageNum >= ef->numPages)
+    {
+        pthread_mutex_unlock(&ef->lock);
+        return RC_WRITE_FAILED;
+    }
+    RC rc = beginChange(ef);
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.pageNum = pageNum;
+    hdr.length  = smCodecCompress(page, PAGE_SIZE, buf + sizeof(hdr), PAGE_SIZE - 1);
+    if (hdr.length < 0)
+    {
+        hdr.raw    = 1;
+        hdr.length = PAGE_SIZE;
+        memcpy(buf + sizeof(hdr), page, PAGE_SIZE);
+    }
+    int need = (int) ((sizeof(hdr) + hdr.length + SM_SECTOR - 1) / SM_SECTOR);
+    hdr.seq  = ef->nextSeq++;
+
+    SM_Extent *e = &ef->map[pageNum];
+    SM_Extent old = *e;
+    if (rc == RC_OK && old.sector > 0 && old.sectors >= need)
+        hdr.sectors = old.sectors;
+    else if (rc == RC_OK)
+    {
+        hdr.sectors = need;
+        rc = allocRegion(ef, need, &e->sector);
+        e->sectors = need;
+    }
+    e->seq = hdr.seq;
+
+    // Whole sectors went out, so the file always ended on a sector
+    if (rc == RC_OK)
+    {
+        size_t used = sizeof(hdr) + hdr.length;
+        memcpy(buf, &hdr, sizeof(hdr));
+        memset(buf + used, 0, (size_t) hdr.sectors * SM_SECTOR - used);
+        rc = writeAt(ef, e->sector, buf, (size_t) hdr.sectors * SM_SECTOR);
+    }
+    if (rc == RC_OK && old.sector > 0 && old.sector != e->sector)
+        rc = freeRegion(ef, old.sector, old.sectors);
+    pthread_mutex_unlock(&ef->lock);
+    return rc;
+}
+
+/*
+ * smExtentGrow
+ * ------------
+ * Added pages of zeros until the file held numPages pages. They took no space
+ * until they were written.
+ */
+RC smExtentGrow(SM_ExtentFile *ef, int numPages)
+{
+    RC rc = RC_OK;
+    pthread_mutex_lock(&ef->lock);
+    if (numPages > ef->numPages)
+    {
+        rc = beginChange(ef);
+        reserveMap(ef, numPages);
+        ef->numPages = numPages;
+        if (rc == RC_OK)
+            rc = writeHeader(ef, 0);
+    }
+    pthread_mutex_unlock(&ef->lock);
+    return rc;
+}
+
+/*
+ * smExtentTruncate
+ * ----------------
+ * Dropped every page from numPages on. Their extents became free, and the
+ * file was cut back after the last extent still in use.
+ */
+RC smExtentTruncate(SM_ExtentFile *ef, int numPages)
+{
+    pthread_mutex_lock(&ef->lock);
+    if (numPages < 1 || numPages > ef->numPages)
+    {
+        pthread_mutex_unlock(&ef->lock);
+        return RC_WRITE_FAILED;
+    }
+    RC rc = beginChange(ef);
+
+    // The header went first, so a walk after a crash ignored the dropped pages
+    int oldPages = ef->numPages;
+    ef->numPages = numPages;
+    if (rc == RC_OK)
+        rc = writeHeader(ef, 0);
+    for (int p = numPages; rc == RC_OK && p < oldPages; p++)
+        if (ef->map[p].sector > 0)
+            rc = freeRegion(ef, ef->map[p].sector, ef->map[p].sectors);
+    memset(ef->map + numPages, 0, (oldPages - numPages) * sizeof(SM_Extent));
+
+    if (rc == RC_OK)
+    {
+        int end = 1;
+        for (int p = 0; p < numPages; p++)
+            if (ef->map[p].sector + ef->map[p].sectors > end)
+                end = ef->map[p].sector + ef->map[p].sectors;
+        if (end < ef->endSector)
+        {
+            ef->endSector = end;
+            findFree(ef);
+            rc = cutFile(ef);
+            if (rc == RC_OK)
+                rc = writeHeader(ef, 0);
+        }
+    }
+    pthread_mutex_unlock(&ef->lock);
+    return rc;
+}
+
+/*
+ * smExtentSync
+ * ------------
+ * Made the pages written so far durable.
+ */
+RC smExtentSync(SM_ExtentFile *ef)
+{
+    RC rc = RC_OK;
+    pthread_mutex_lock(&ef->lock);
+    if (fflush(ef->fp) != 0 || fdatasync(fileno(ef->fp)) != 0)
+        rc = RC_WRITE_FAILED;
+    pthread_mutex_unlock(&ef->lock);
+    return rc;
+}
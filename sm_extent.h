@@ -0,0 +1,85 @@
+#ifndef SM_EXTENT_H
+#define SM_EXTENT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "dberror.h"
+#include "storage_mgr.h"
+
+/*
+ * Compressed page files (see createPageFileWithCodec).
+ *
+ * A compressed page file still held numbered PAGE_SIZE pages as far as its
+ * users could tell, but each page was stored compressed, in a run of
+ * SM_SECTOR-byte sectors (an extent) that was only as long as it needed to be:
+ *   - sector 0: the file header (magic, codec, number of pages, whether the
+ *     file was closed cleanly, where the saved extent map started),
+ *   - from sector 1 on: regions that tiled the file, each starting with an
+ *     SM_ExtentHeader. A region held one page (its number, stored length, and
+ *     a sequence number that grew with every write) or was free.
+ * A page that was never written had no extent and read back as zeros. A page
+ * that no longer fit its extent moved to a free region (first fit) or to the
+ * end of the file, and its old extent became free.
+ *
+ * The extent map (page number => extent) lived in memory while the file was
+ * open. A clean close saved it after the last region and marked the header
+ * clean; the first change after opening dropped the saved map again. A file
+ * that was not closed cleanly had its map rebuilt by walking the regions,
+ * where the newest sequence number of a page won. Handles on the same file
+ * within the process shared one open state, so the map was read once and
+ * every handle saw the same pages.
+ *
+ * Codec SM_CODEC_LZ: a sequence of tokens; a byte c < 64 was followed by c + 1
+ * literal bytes, a byte c >= 128 by a 2-byte offset and copied (c & 127) + 3
+ * bytes from that far back in the output (overlapping, so runs of one byte
+ * took a single token), and a byte 64 <= c < 128 copied (c & 63) + 2 bytes
+ * from the offset of the last such copy (the stride between the records of a
+ * page). Pages that did not get smaller were stored as is.
+ */
+
+#define SM_SECTOR 128
+#define SM_EXTENT_MAGIC "SMZPAGE1"
+
+// where a page was stored
+typedef struct SM_Extent {
+	int sector;        // first sector, 0 => never written (all zeros)
+	int sectors;
+	unsigned seq;
+} SM_Extent;
+
+// the open state of a compressed page file, shared by its handles
+typedef struct SM_ExtentFile {
+	char *fileName;
+	FILE *fp;
+	int refCount;
+	SM_Codec codec;
+	int numPages;
+	SM_Extent *map;
+	int mapCap;
+	SM_Extent *freeRegions;  // seq unused
+	int numFree;
+	int freeCap;
+	int endSector;     // first sector past the last region
+	unsigned nextSeq;
+	bool clean;        // the header said the saved map was valid
+	pthread_mutex_t lock;
+	struct SM_ExtentFile *next;
+} SM_ExtentFile;
+
+// the codec (return the output length, or -1 if it did not fit in cap bytes)
+extern int smCodecCompress (const char *src, int len, char *dest, int cap);
+extern int smCodecDecompress (const char *src, int len, char *dest, int cap);
+
+// compressed page files
+extern bool smExtentIsCompressed (FILE *fp);
+extern RC smExtentCreate (char *fileName, SM_Codec codec);
+extern RC smExtentOpen (char *fileName, SM_ExtentFile **ef);
+extern RC smExtentClose (SM_ExtentFile *ef);
+extern RC smExtentRead (SM_ExtentFile *ef, int pageNum, char *page);
+extern RC smExtentWrite (SM_ExtentFile *ef, int pageNum, char *page);
+extern RC smExtentGrow (SM_ExtentFile *ef, int numPages);
+extern RC smExtentTruncate (SM_ExtentFile *ef, int numPages);
+extern RC smExtentSync (SM_ExtentFile *ef);
+
+#endif // SM_EXTENT_H
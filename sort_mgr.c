@@ -0,0 +1,642 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "sort_mgr.h"
+#include "record_mgr.h"
+#include "rm_spill.h"
+#include "dberror.h"
+#include "tables.h"
+
+/*
+ * sort_mgr.c
+ * ---------------------------------------------------------------
+ * External merge sort.
+ *
+ * Run generation copied (RID, record) tuples into arena blocks and kept one
+ * small entry per tuple: an 8-byte prefix of the first sort key, encoded so
+ * that unsigned comparison gave the sort order, and a pointer to the tuple.
+ * Sorting the entries mostly compared prefixes; the full keys were only read
+ * when two prefixes were equal. A run was written to a spill file in sorted
+ * order when the tuples and entries reached the memory budget.
+ *
+ * The runs were merged with a loser tree: the internal nodes remembered the
+ * run that lost the match played there, so replacing the winner only
+ * replayed the matches on its path to the root, one comparison per level.
+ */
+
+/* Bytes in one arena block. */
+#define SORT_ARENA_BLOCK (64 * 1024)
+
+/* One tuple of the run being generated. */
+typedef struct SortEntry {
+    unsigned long long prefix;
+    int seq;            // input position, to keep equal keys in order
+    char *tuple;        // RID followed by record->data
+} SortEntry;
+
+typedef struct SortBlock {
+    struct SortBlock *next;
+    size_t used;
+    size_t size;
+    char mem[];
+} SortBlock;
+
+/* A run being read back, with its current tuple. */
+typedef struct SortRun {
+    RM_Spill file;
+    char *tuple;
+    bool done;
+} SortRun;
+
+/* This structure stored the state of a sort in progress. */
+typedef struct SortData {
+    Schema *schema;
+    int recSize;
+    int tupleSize;      // sizeof(RID) + recSize
+    int numKeys;
+    RM_SortKey *keys;
+    size_t budget;
+
+    // Run generation (and the result, when it all fit)
+    SortBlock *blocks;
+    size_t memUsed;     // tuple and entry bytes in the current run
+    SortEntry *entries;
+    int numEntries, capEntries;
+    int seq;
+    int emitPos;
+
+    // Runs on disk and the loser tree merging them
+    SortRun *runs;
+    int numRuns, capRuns;
+    int *tree;          // tree[0] the winning run, tree[1..numRuns-1] losers
+} SortData;
+
+/* --------------------------------------------------------------------------
+   Keys
+   -------------------------------------------------------------------------- */
+
+/*
+ * compareRaw
+ * ----------
+ * Compared two values of an attribute in their record->data byte format.
+ * Returned <0, 0 or >0 like strcmp.
+ */
+static int compareRaw(DataType dt, const char *a, const char *b, int width)
+{
+    switch (dt)
+    {
+        case DT_INT:
+        case DT_BLOB:   // large objects compared by id
+        {
+            int x, y;
+            memcpy(&x, a, sizeof(int));
+            memcpy(&y, b, sizeof(int));
+            return (x > y) - (x < y);
+        }
+        case DT_FLOAT:
+        {
+            float x, y;
+            memcpy(&x, a, sizeof(float));
+            memcpy(&y, b, sizeof(float));
+            return (x > y) - (x < y);
+        }
+        case DT_BOOL:
+            return (a[0] != 0) - (b[0] != 0);
+        case DT_STRING:
+            return strncmp(a, b, width);
+    }
+    return 0;
+}
+
+/*
+ * compareTuples
+ * -------------
+ * Compared two tuples by all sort keys.
+ */
+static int compareTuples(SortData *sd, const char *a, const char *b)
+{
+    Schema *sc = sd->schema;
+    for (int i = 0; i < sd->numKeys; i++)
+    {
+        int attr = sd->keys[i].attrNum;
+        int off = (int) sizeof(RID) + sc->attrOffsets[attr];
+        int c = compareRaw(sc->dataTypes[attr], a + off, b + off,
+                           sc->attrOffsets[attr + 1] - sc->attrOffsets[attr]);
+        if (c != 0)
+            return sd->keys[i].descending ? -c : c;
+    }
+    return 0;
+}
+
+/*
+ * keyPrefix
+ * ---------
+ * Encoded the start of the first sort key as an unsigned number with the
+ * same order: ints and floats with their sign bit flipped (and negative
+ * floats inverted), strings as their first 8 bytes, most significant first.
+ */
+static unsigned long long keyPrefix(SortData *sd, const char *data)
+{
+    Schema *sc = sd->schema;
+    int attr = sd->keys[0].attrNum;
+    const char *val = data + sc->attrOffsets[attr];
+    unsigned long long p = 0;
+
+    switch (sc->dataTypes[attr])
+    {
+        case DT_INT:
+        case DT_BLOB:
+        {
+            unsigned int u;
+            memcpy(&u, val, sizeof(int));
+            p = (unsigned long long) (u ^ 0x80000000u) << 32;
+            break;
+        }
+        case DT_FLOAT:
+        {
+            unsigned int u;
+            memcpy(&u, val, sizeof(float));
+            u = (u & 0x80000000u) ? ~u : (u ^ 0x80000000u);
+            p = (unsigned long long) u << 32;
+            break;
+        }
+        case DT_BOOL:
+            p = (val[0] != 0);
+            break;
+        case DT_STRING:
+        {
+            int len = (int) strnlen(val, sc->attrOffsets[attr + 1] - sc->attrOffsets[attr]);
+            for (int i = 0; i < 8; i++)
+                p = (p << 8) | (i < len ? (unsigned char) val[i] : 0);
+            break;
+        }
+    }
+    return sd->keys[0].descending ? ~p : p;
+}
+
+/*
+ * compareEntries
+ * --------------
+ * Order of the entries of a run: prefix, then the full keys, then input
+ * position.
+ */
+static int compareEntries(SortData *sd, const SortEntry *a, const SortEntry *b)
+{
+    if (a->prefix != b->prefix)
+        return (a->prefix > b->prefix) ? 1 : -1;
+    int c = compareTuples(sd, a->tuple, b->tuple);
+    if (c != 0)
+        return c;
+    return (a->seq > b->seq) - (a->seq < b->seq);
+}
+
+/* --------------------------------------------------------------------------
+   Run generation
+   -------------------------------------------------------------------------- */
+
+/*
+ * addTuple
+ * --------
+ * Copied one input record into the arena and added its entry.
+ */
+static RC addTuple(SortData *sd, Record *record)
+{
+    if (sd->numEntries == sd->capEntries)
+    {
+        int cap = (sd->capEntries > 0) ? 2 * sd->capEntries : 1024;
+        SortEntry *e = (SortEntry *) realloc(sd->entries, cap * sizeof(SortEntry));
+        if (e == NULL)
+            return RC_MEMORY_ALLOCATION_ERROR;
+        sd->entries = e;
+        sd->capEntries = cap;
+    }
+
+    SortBlock *blk = sd->blocks;
+    if (blk == NULL || blk->size - blk->used < (size_t) sd->tupleSize)
+    {
+        size_t size = (sd->tupleSize > SORT_ARENA_BLOCK) ? (size_t) sd->tupleSize : SORT_ARENA_BLOCK;
+        blk = (SortBlock *) malloc(sizeof(SortBlock) + size);
+        if (blk == NULL)
+            return RC_MEMORY_ALLOCATION_ERROR;
+        blk->next = sd->blocks;
+        blk->used = 0;
+        blk->size = size;
+        sd->blocks = blk;
+    }
+
+    char *tuple = blk->mem + blk->used;
+    blk->used += sd->tupleSize;
+    memcpy(tuple, &record->id, sizeof(RID));
+    memcpy(tuple + sizeof(RID), record->data, sd->recSize);
+
+    SortEntry *e = &sd->entries[sd->numEntries++];
+    e->prefix = keyPrefix(sd, record->data);
+    e->seq    = sd->seq++;
+    e->tuple  = tuple;
+    sd->memUsed += sd->tupleSize + sizeof(SortEntry);
+    return RC_OK;
+}
+
+/*
+ * sortEntries
+ * -----------
+ * Sorted the entries of the run being generated, by a bottom-up merge sort
+ * (qsort passed its comparison no context, and concurrent sorts could not
+ * share one). Fell back to insertion sort if no scratch array was to be had.
+ */
+static void sortEntries(SortData *sd)
+{
+    int n = sd->numEntries;
+    SortEntry *from = sd->entries;
+    SortEntry *to = (n > 1) ? (SortEntry *) malloc(n * sizeof(SortEntry)) : NULL;
+
+    if (to == NULL)
+    {
+        for (int i = 1; i < n; i++)
+        {
+            SortEntry e = from[i];
+            int j = i;
+            for (; j > 0 && compareEntries(sd, &from[j - 1], &e) > 0; j--)
+                from[j] = from[j - 1];
+            from[j] = e;
+        }
+        return;
+    }
+
+    for (int width = 1; width < n; width *= 2)
+    {
+        for (int lo = 0; lo < n; lo += 2 * width)
+        {
+            int mid = (lo + width < n) ? lo + width : n;
+            int hi = (lo + 2 * width < n) ? lo + 2 * width : n;
+            int i = lo, j = mid, k = lo;
+            while (i < mid && j < hi)
+                to[k++] = (compareEntries(sd, &from[j], &from[i]) < 0) ? from[j++] : from[i++];
+            while (i < mid)
+                to[k++] = from[i++];
+            while (j < hi)
+                to[k++] = from[j++];
+        }
+        SortEntry *t = from;
+        from = to;
+        to = t;
+    }
+
+    if (from != sd->entries)
+    {
+        memcpy(sd->entries, from, n * sizeof(SortEntry));
+        to = from;
+    }
+    free(to);
+}
+
+/*
+ * freeArena
+ * ---------
+ * Dropped the tuples of the run being generated. The entry array was kept.
+ */
+static void freeArena(SortData *sd)
+{
+    while (sd->blocks != NULL)
+    {
+        SortBlock *next = sd->blocks->next;
+        free(sd->blocks);
+        sd->blocks = next;
+    }
+    sd->numEntries = 0;
+    sd->memUsed = 0;
+}
+
+/*
+ * newRun
+ * ------
+ * Appended an empty run with its own spill file.
+ */
+static RC newRun(SortData *sd, SortRun **run)
+{
+    char fileName[64];
+
+    if (sd->numRuns == sd->capRuns)
+    {
+        int cap = (sd->capRuns > 0) ? 2 * sd->capRuns : 16;
+        SortRun *r = (SortRun *) realloc(sd->runs, cap * sizeof(SortRun));
+        if (r == NULL)
+            return RC_MEMORY_ALLOCATION_ERROR;
+        sd->runs = r;
+        sd->capRuns = cap;
+    }
+
+    *run = &sd->runs[sd->numRuns++];
+    memset(*run, 0, sizeof(SortRun));
+    (*run)->tuple = (char *) malloc(sd->tupleSize);
+    snprintf(fileName, sizeof(fileName), "sort%d.tmp", rmSpillNextId());
+    return rmSpillOpen(&(*run)->file, fileName);
+}
+
+/*
+ * writeRun
+ * --------
+ * Sorted the tuples in memory and wrote them out as a new run.
+ */
+static RC writeRun(SortData *sd)
+{
+    SortRun *run;
+    RC rc;
+
+    sortEntries(sd);
+    if ((rc = newRun(sd, &run)) != RC_OK)
+        return rc;
+    for (int i = 0; i < sd->numEntries; i++)
+    {
+        RID id;
+        memcpy(&id, sd->entries[i].tuple, sizeof(RID));
+        if ((rc = rmSpillTuple(&run->file, id, sd->entries[i].tuple + sizeof(RID), sd->recSize)) != RC_OK)
+            return rc;
+    }
+    freeArena(sd);
+    return RC_OK;
+}
+
+/* --------------------------------------------------------------------------
+   Merging
+   -------------------------------------------------------------------------- */
+
+/*
+ * advanceRun
+ * ----------
+ * Read the next tuple of a run, or marked it done.
+ */
+static RC advanceRun(SortData *sd, SortRun *run)
+{
+    RID id;
+    if (run->file.remaining == 0)
+    {
+        run->done = true;
+        return RC_OK;
+    }
+    RC rc = rmSpillReadTuple(&run->file, &id, run->tuple + sizeof(RID), sd->recSize);
+    memcpy(run->tuple, &id, sizeof(RID));
+    return rc;
+}
+
+/*
+ * runBeats
+ * --------
+ * Decided whether run a's current tuple came before run b's. Index k stood
+ * for a sentinel that beat everything (used while building the tree), a
+ * finished run lost against everything, and equal keys went to the earlier
+ * run so the merge stayed stable.
+ */
+static bool runBeats(SortData *sd, SortRun *runs, int k, int a, int b)
+{
+    if (a == k) return true;
+    if (b == k) return false;
+    if (runs[a].done) return false;
+    if (runs[b].done) return true;
+    int c = compareTuples(sd, runs[a].tuple, runs[b].tuple);
+    return (c != 0) ? (c < 0) : (a < b);
+}
+
+/*
+ * replay
+ * ------
+ * Replayed the matches from leaf s up to the root after run s got a new
+ * tuple. The loser of each match stayed in the node; the winner moved up.
+ */
+static void replay(SortData *sd, SortRun *runs, int k, int *tree, int s)
+{
+    for (int t = (s + k) / 2; t > 0; t /= 2)
+    {
+        if (runBeats(sd, runs, k, tree[t], s))
+        {
+            int tmp = tree[t];
+            tree[t] = s;
+            s = tmp;
+        }
+    }
+    tree[0] = s;
+}
+
+/*
+ * buildTree
+ * ---------
+ * Read the first tuple of each of k runs and played the initial matches.
+ */
+static RC buildTree(SortData *sd, SortRun *runs, int k, int *tree)
+{
+    RC rc;
+
+    for (int i = 0; i < k; i++)
+    {
+        tree[i] = k;
+        if ((rc = rmSpillRewind(&runs[i].file)) != RC_OK)
+            return rc;
+        if ((rc = advanceRun(sd, &runs[i])) != RC_OK)
+            return rc;
+    }
+    for (int i = k - 1; i >= 0; i--)
+        replay(sd, runs, k, tree, i);
+    return RC_OK;
+}
+
+/*
+ * closeRun
+ * --------
+ * Removed a run's file and buffer.
+ */
+static void closeRun(SortRun *run)
+{
+    rmSpillClose(&run->file);
+    free(run->tuple);
+    run->tuple = NULL;
+}
+
+/*
+ * mergePass
+ * ---------
+ * Merged groups of RM_SORT_MAX_FANIN consecutive runs into one run each,
+ * keeping the runs in input order.
+ */
+static RC mergePass(SortData *sd)
+{
+    SortRun *old = sd->runs;
+    int numOld = sd->numRuns;
+    int tree[RM_SORT_MAX_FANIN];
+    RC rc = RC_OK;
+
+    sd->runs = NULL;
+    sd->numRuns = sd->capRuns = 0;
+
+    for (int first = 0; first < numOld && rc == RC_OK; first += RM_SORT_MAX_FANIN)
+    {
+        int k = numOld - first;
+        SortRun *out;
+        if (k > RM_SORT_MAX_FANIN)
+            k = RM_SORT_MAX_FANIN;
+
+        if ((rc = newRun(sd, &out)) != RC_OK)
+            break;
+        if ((rc = buildTree(sd, old + first, k, tree)) != RC_OK)
+            break;
+        while (!old[first + tree[0]].done)
+        {
+            SortRun *w = &old[first + tree[0]];
+            RID id;
+            memcpy(&id, w->tuple, sizeof(RID));
+            if ((rc = rmSpillTuple(&out->file, id, w->tuple + sizeof(RID), sd->recSize)) != RC_OK)
+                break;
+            if ((rc = advanceRun(sd, w)) != RC_OK)
+                break;
+            replay(sd, old + first, k, tree, tree[0]);
+        }
+    }
+
+    for (int i = 0; i < numOld; i++)
+        closeRun(&old[i]);
+    free(old);
+    return rc;
+}
+
+/* --------------------------------------------------------------------------
+   Sort interface
+   -------------------------------------------------------------------------- */
+
+/*
+ * freeSortData
+ * ------------
+ * Released everything a sort held, removing its run files.
+ */
+static void freeSortData(SortData *sd)
+{
+    freeArena(sd);
+    for (int i = 0; i < sd->numRuns; i++)
+        closeRun(&sd->runs[i]);
+    free(sd->runs);
+    free(sd->tree);
+    free(sd->entries);
+    free(sd->keys);
+    free(sd);
+}
+
+/*
+ * startSort
+ * ---------
+ * Read an open scan to its end and sorted it by the given keys (the first
+ * key most significant). memoryBudget bounded the bytes one run took in
+ * memory (0 meant RM_SORT_DEFAULT_MEMORY).
+ */
+RC startSort(RM_ScanHandle *scan, int numKeys, RM_SortKey *keys, int memoryBudget, RM_SortHandle *sort)
+{
+    Schema *sc = scan->rel->schema;
+    Record *rec;
+    RC rc;
+
+    if (numKeys <= 0)
+        return RC_RM_NO_SUCH_ATTR;
+    for (int i = 0; i < numKeys; i++)
+    {
+        if (keys[i].attrNum < 0 || keys[i].attrNum >= sc->numAttr)
+            return RC_RM_NO_SUCH_ATTR;
+        if (sc->dataTypes[keys[i].attrNum] == DT_BLOB)
+            return RC_RM_BAD_BLOB_ATTR;
+    }
+
+    SortData *sd = (SortData *) calloc(1, sizeof(SortData));
+    if (sd == NULL)
+        return RC_MEMORY_ALLOCATION_ERROR;
+    sd->schema    = sc;
+    sd->recSize   = getRecordSize(sc);
+    sd->tupleSize = (int) sizeof(RID) + sd->recSize;
+    sd->numKeys   = numKeys;
+    sd->keys      = (RM_SortKey *) malloc(numKeys * sizeof(RM_SortKey));
+    memcpy(sd->keys, keys, numKeys * sizeof(RM_SortKey));
+    sd->budget    = (memoryBudget > 0) ? (size_t) memoryBudget : RM_SORT_DEFAULT_MEMORY;
+
+    createRecord(&rec, sc);
+    while ((rc = next(scan, rec)) == RC_OK)
+    {
+        if ((rc = addTuple(sd, rec)) != RC_OK)
+            break;
+        if (sd->memUsed >= sd->budget && (rc = writeRun(sd)) != RC_OK)
+            break;
+    }
+    freeRecord(rec);
+    if (rc == RC_RM_NO_MORE_TUPLES)
+        rc = RC_OK;
+
+    if (rc == RC_OK)
+    {
+        if (sd->numRuns == 0)
+            sortEntries(sd);        // all of it fit: returned from memory
+        else
+        {
+            if (sd->numEntries > 0)
+                rc = writeRun(sd);
+            while (rc == RC_OK && sd->numRuns > RM_SORT_MAX_FANIN)
+                rc = mergePass(sd);
+            if (rc == RC_OK)
+            {
+                sd->tree = (int *) malloc(sd->numRuns * sizeof(int));
+                rc = buildTree(sd, sd->runs, sd->numRuns, sd->tree);
+            }
+        }
+    }
+    if (rc != RC_OK)
+    {
+        freeSortData(sd);
+        return rc;
+    }
+
+    sort->rel = scan->rel;
+    sort->mgmtData = sd;
+    return RC_OK;
+}
+
+/*
+ * nextSorted
+ * ----------
+ * Returned the next record in sort order, with its RID in the table, or
+ * RC_RM_NO_MORE_TUPLES.
+ */
+RC nextSorted(RM_SortHandle *sort, Record *record)
+{
+    SortData *sd = (SortData *) sort->mgmtData;
+    const char *tuple;
+
+    if (sd->numRuns == 0)
+    {
+        if (sd->emitPos >= sd->numEntries)
+            return RC_RM_NO_MORE_TUPLES;
+        tuple = sd->entries[sd->emitPos++].tuple;
+        memcpy(&record->id, tuple, sizeof(RID));
+        memcpy(record->data, tuple + sizeof(RID), sd->recSize);
+        return RC_OK;
+    }
+
+    int w = sd->tree[0];
+    SortRun *run = &sd->runs[w];
+    if (run->done)
+        return RC_RM_NO_MORE_TUPLES;
+    memcpy(&record->id, run->tuple, sizeof(RID));
+    memcpy(record->data, run->tuple + sizeof(RID), sd->recSize);
+
+    RC rc = advanceRun(sd, run);
+    if (rc != RC_OK)
+        return rc;
+    replay(sd, sd->runs, sd->numRuns, sd->tree, w);
+    return RC_OK;
+}
+
+/*
+ * closeSort
+ * ---------
+ * Freed the sort and removed its run files. The scan stayed open.
+ */
+RC closeSort(RM_SortHandle *sort)
+{
+    if (sort->mgmtData != NULL)
+        freeSortData((SortData *) sort->mgmtData);
+    sort->mgmtData = NULL;
+    return RC_OK;
+}
@@ -0,0 +1,42 @@
+#ifndef SORT_MGR_H
+#define SORT_MGR_H
+
+#include "dberror.h"
+#include "record_mgr.h"
+
+/*
+ * External merge sort of a record manager scan.
+ *
+ * startSort read a scan the caller had already started to its end (use a scan
+ * without condition to sort a whole table). Records were collected until the
+ * memory budget was used up, sorted, and written out as a sorted run to a
+ * temporary page file. nextSorted then merged the runs. When everything fit
+ * into one run, it was returned straight from memory. Records with equal keys
+ * kept their input order. A DT_BLOB attribute could not be a sort key
+ * (RC_RM_BAD_BLOB_ATTR).
+ */
+
+typedef struct RM_SortKey
+{
+	int attrNum;
+	int descending;     // 0 sorted ascending, anything else descending
+} RM_SortKey;
+
+// Bookkeeping for sorts
+typedef struct RM_SortHandle
+{
+	RM_TableData *rel;  // table the sorted records came from
+	void *mgmtData;
+} RM_SortHandle;
+
+// memory for one run when the caller passed 0
+#define RM_SORT_DEFAULT_MEMORY (1 << 20)
+
+// most runs merged at once; more runs were merged in several passes
+#define RM_SORT_MAX_FANIN 64
+
+extern RC startSort (RM_ScanHandle *scan, int numKeys, RM_SortKey *keys, int memoryBudget, RM_SortHandle *sort);
+extern RC nextSorted (RM_SortHandle *sort, Record *record);
+extern RC closeSort (RM_SortHandle *sort);
+
+#endif // SORT_MGR_H
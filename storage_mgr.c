@@ -3,7 +3,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "dberror.h"
+#include "sm_extent.h"
+
+// What mgmtInfo pointed to: the file, or the shared state of a compressed one
+typedef struct SM_MgmtInfo {
+  FILE *filePointer;
+  SM_ExtentFile *extent;
+} SM_MgmtInfo;
 
 /* Handling Page Files */
 
@@ -37,12 +45,38 @@ RC createPageFile(char *fileName)
       return RC_WRITE_FAILED;
     }
     
-    printf("File created successfully.\n");
     fclose(filePointer);
     free(initialPage);
     return RC_OK;
 }
 
+// Created new page file whose pages were stored with the given codec
+RC createPageFileWithCodec(char *fileName, SM_Codec codec)
+{
+    if (codec == SM_CODEC_NONE)
+      return createPageFile(fileName);
+
+    RC rc = smExtentCreate(fileName, codec);
+    if (rc != RC_OK)
+    {
+      printf("Failed to create file.\n");
+      return rc;
+    }
+    return RC_OK;
+}
+
+// Reported the codec a page file was created with
+RC getPageFileCodec(char *fileName, SM_Codec *codec)
+{
+    FILE *filePointer = fopen(fileName, "r");
+    if (!filePointer)
+      return RC_FILE_NOT_FOUND;
+
+    *codec = smExtentIsCompressed(filePointer) ? SM_CODEC_LZ : SM_CODEC_NONE;
+    fclose(filePointer);
+    return RC_OK;
+}
+
 // Opened existing page file and initialized file handle
 RC openPageFile(char *fileName, SM_FileHandle *fileHandle)
 {
@@ -53,17 +87,38 @@ RC openPageFile(char *fileName, SM_FileHandle *fileHandle)
       return RC_FILE_NOT_FOUND;
     }
 
-    // Determined file size
-    fseek(filePointer, 0, SEEK_END);
-    fileHandle->totalNumPages = ftell(filePointer) / PAGE_SIZE;
-    rewind(filePointer);
+    SM_MgmtInfo *mgmt = (SM_MgmtInfo *)calloc(1, sizeof(SM_MgmtInfo));
+
+    // Compressed files were handed to the extent map
+    if (smExtentIsCompressed(filePointer))
+    {
+      fclose(filePointer);
+      RC rc = smExtentOpen(fileName, &mgmt->extent);
+      if (rc != RC_OK)
+      {
+        free(mgmt);
+        return rc;
+      }
+      fileHandle->totalNumPages = mgmt->extent->numPages;
+    }
+    else
+    {
+      // Pages were read and written whole, so stdio buffering only hid
+      // writes from other handles on the file
+      setvbuf(filePointer, NULL, _IONBF, 0);
+
+      // Determined file size
+      fseek(filePointer, 0, SEEK_END);
+      fileHandle->totalNumPages = ftell(filePointer) / PAGE_SIZE;
+      rewind(filePointer);
+      mgmt->filePointer = filePointer;
+    }
 
     // Initialized file handle properties
     fileHandle->fileName = fileName;
     fileHandle->curPagePos = 0;
-    fileHandle->mgmtInfo = filePointer;
+    fileHandle->mgmtInfo = mgmt;
 
-    printf("Opened file: %s\n", fileName);
     return RC_OK;
 }
 
@@ -74,7 +129,7 @@ RC closePageFile(SM_FileHandle *fileHandle)
   if (fileHandle == NULL || fileHandle->mgmtInfo == NULL) 
     return RC_FILE_HANDLE_NOT_INIT;
 
-  FILE *filePointer = (FILE *)fileHandle->mgmtInfo;
+  SM_MgmtInfo *mgmt = (SM_MgmtInfo *)fileHandle->mgmtInfo;
   
   // Reset handle properties
   fileHandle->fileName = NULL;
@@ -82,8 +137,26 @@ RC closePageFile(SM_FileHandle *fileHandle)
   fileHandle->totalNumPages = 0;
   fileHandle->mgmtInfo = NULL;
 
-  fclose(filePointer);
-  printf("Closed file successfully.\n");
+  RC rc = RC_OK;
+  if (mgmt->extent != NULL)
+    rc = smExtentClose(mgmt->extent);
+  else
+    fclose(mgmt->filePointer);
+  free(mgmt);
+  return rc;
+}
+
+// Forced the pages written through a handle to disk
+RC syncPageFile(SM_FileHandle *fileHandle)
+{
+  if (fileHandle == NULL || fileHandle->mgmtInfo == NULL)
+    return RC_FILE_HANDLE_NOT_INIT;
+
+  SM_MgmtInfo *mgmt = (SM_MgmtInfo *)fileHandle->mgmtInfo;
+  if (mgmt->extent != NULL)
+    return smExtentSync(mgmt->extent);
+  if (fflush(mgmt->filePointer) != 0 || fdatasync(fileno(mgmt->filePointer)) != 0)
+    return RC_WRITE_FAILED;
   return RC_OK;
 }
 
@@ -104,8 +177,6 @@ RC destroyPageFile(char *fileName)
     printf("Failed to delete file.\n");
     return RC_FILE_NOT_FOUND;
   }
-  
-  printf("Destroyed file: %s\n", fileName);
   return RC_OK;
 }
 
@@ -118,12 +189,20 @@ RC readBlock(int pageNum, SM_FileHandle *fileHandle, SM_PageHandle memPage)
   if (pageNum < 0 || pageNum >= fileHandle->totalNumPages)
     return RC_READ_NON_EXISTING_PAGE;
 
-  FILE *filePointer = (FILE *)fileHandle->mgmtInfo;
-  long offset = pageNum * PAGE_SIZE;
+  SM_MgmtInfo *mgmt = (SM_MgmtInfo *)fileHandle->mgmtInfo;
+  if (mgmt->extent != NULL)
+  {
+    RC rc = smExtentRead(mgmt->extent, pageNum, memPage);
+    if (rc == RC_OK)
+      fileHandle->curPagePos = pageNum;
+    return rc;
+  }
 
-  // Positioned file pointer and read data
-  if (fseek(filePointer, offset, SEEK_SET) != 0 ||
-      fread(memPage, sizeof(char), PAGE_SIZE, filePointer) != PAGE_SIZE)
+  off_t offset = (off_t) pageNum * PAGE_SIZE;
+
+  // Read at the offset without moving the file position, so reads and
+  // writes of other pages through the handle could run at the same time
+  if (pread(fileno(mgmt->filePointer), memPage, PAGE_SIZE, offset) != PAGE_SIZE)
   {
     return RC_READ_NON_EXISTING_PAGE;
   }
@@ -181,12 +260,19 @@ RC writeBlock(int pageNum, SM_FileHandle *fileHandle, SM_PageHandle memPage)
   if (pageNum < 0 || pageNum >= fileHandle->totalNumPages)
     return RC_WRITE_FAILED;
 
-  FILE *filePointer = (FILE *)fileHandle->mgmtInfo;
-  long offset = pageNum * PAGE_SIZE;
+  SM_MgmtInfo *mgmt = (SM_MgmtInfo *)fileHandle->mgmtInfo;
+  if (mgmt->extent != NULL)
+  {
+    RC rc = smExtentWrite(mgmt->extent, pageNum, memPage);
+    if (rc == RC_OK)
+      fileHandle->curPagePos = pageNum;
+    return rc;
+  }
+
+  off_t offset = (off_t) pageNum * PAGE_SIZE;
 
-  // Executed write operation
-  if (fseek(filePointer, offset, SEEK_SET) != 0 ||
-      fwrite(memPage, sizeof(char), PAGE_SIZE, filePointer) != PAGE_SIZE)
+  // Executed write operation (positioned, like readBlock)
+  if (pwrite(fileno(mgmt->filePointer), memPage, PAGE_SIZE, offset) != PAGE_SIZE)
   {
     return RC_WRITE_FAILED;
   }
@@ -204,12 +290,17 @@ RC writeCurrentBlock(SM_FileHandle *fileHandle, SM_PageHandle memPage)
 // Added new empty block to end of file
 RC appendEmptyBlock(SM_FileHandle *fileHandle)
 {
+  // Compressed files grew without writing anything
+  SM_MgmtInfo *mgmt = (SM_MgmtInfo *)fileHandle->mgmtInfo;
+  if (mgmt->extent != NULL)
+    return ensureCapacity(fileHandle->totalNumPages + 1, fileHandle);
+
   // Created zero-initialized page
   SM_PageHandle emptyPage = (char *)calloc(PAGE_SIZE, sizeof(char));
   if (!emptyPage) return RC_WRITE_FAILED;
 
   // Appended to file
-  FILE *filePointer = (FILE *)fileHandle->mgmtInfo;
+  FILE *filePointer = mgmt->filePointer;
   fseek(filePointer, 0, SEEK_END);
   
   if (fwrite(emptyPage, sizeof(char), PAGE_SIZE, filePointer) != PAGE_SIZE)
@@ -228,6 +319,22 @@ RC appendEmptyBlock(SM_FileHandle *fileHandle)
 // Guaranteed minimum file capacity
 RC ensureCapacity(int numberOfPages, SM_FileHandle *fileHandle)
 {
+  // Compressed files shared their page count between handles
+  SM_MgmtInfo *mgmt = (SM_MgmtInfo *)fileHandle->mgmtInfo;
+  if (mgmt->extent != NULL)
+  {
+    int oldNumPages = fileHandle->totalNumPages;
+    RC rc = smExtentGrow(mgmt->extent, numberOfPages);
+    fileHandle->totalNumPages = mgmt->extent->numPages;
+    if (fileHandle->totalNumPages > oldNumPages)
+      fileHandle->curPagePos = fileHandle->totalNumPages - 1;
+    return rc;
+  }
+
+  // Picked up pages another handle had added
+  fseek(mgmt->filePointer, 0, SEEK_END);
+  fileHandle->totalNumPages = ftell(mgmt->filePointer) / PAGE_SIZE;
+
   // Calculated needed pages
   int pagesNeeded = numberOfPages - fileHandle->totalNumPages;
   if (pagesNeeded <= 0) return RC_OK;
@@ -239,4 +346,34 @@ RC ensureCapacity(int numberOfPages, SM_FileHandle *fileHandle)
     if (status != RC_OK) return status;
   }
   return RC_OK;
-}
\ No newline at end of file
+}
+
+// Cut the file back to its first numberOfPages pages
+RC truncatePageFile(int numberOfPages, SM_FileHandle *fileHandle)
+{
+  if (fileHandle == NULL || fileHandle->mgmtInfo == NULL)
+    return RC_FILE_HANDLE_NOT_INIT;
+  if (numberOfPages < 1 || numberOfPages > fileHandle->totalNumPages)
+    return RC_WRITE_FAILED;
+
+  SM_MgmtInfo *mgmt = (SM_MgmtInfo *)fileHandle->mgmtInfo;
+  if (mgmt->extent != NULL)
+  {
+    RC rc = smExtentTruncate(mgmt->extent, numberOfPages);
+    if (rc != RC_OK)
+      return rc;
+  }
+  else
+  {
+    FILE *filePointer = mgmt->filePointer;
+    fflush(filePointer);
+    if (ftruncate(fileno(filePointer), (off_t) numberOfPages * PAGE_SIZE) != 0)
+      return RC_WRITE_FAILED;
+  }
+
+  // Updated file metadata
+  fileHandle->totalNumPages = numberOfPages;
+  if (fileHandle->curPagePos >= numberOfPages)
+    fileHandle->curPagePos = numberOfPages - 1;
+  return RC_OK;
+}
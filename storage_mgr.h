@@ -15,6 +15,12 @@ typedef struct SM_FileHandle {
 
 typedef char* SM_PageHandle;
 
+/* how the pages of a file were stored (see sm_extent.h) */
+typedef enum SM_Codec {
+	SM_CODEC_NONE = 0,   // PAGE_SIZE bytes per page at pageNum * PAGE_SIZE
+	SM_CODEC_LZ = 1      // each page LZ-compressed into a variable-size extent
+} SM_Codec;
+
 /************************************************************
  *                    interface                             *
  ************************************************************/
@@ -24,6 +30,9 @@ extern RC createPageFile (char *fileName);
 extern RC openPageFile (char *fileName, SM_FileHandle *fHandle);
 extern RC closePageFile (SM_FileHandle *fHandle);
 extern RC destroyPageFile (char *fileName);
+extern RC createPageFileWithCodec (char *fileName, SM_Codec codec);
+extern RC getPageFileCodec (char *fileName, SM_Codec *codec);
+extern RC syncPageFile (SM_FileHandle *fHandle);
 
 /* reading blocks from disc */
 extern RC readBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage);
@@ -39,5 +48,6 @@ extern RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage
 extern RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC appendEmptyBlock (SM_FileHandle *fHandle);
 extern RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle);
+extern RC truncatePageFile (int numberOfPages, SM_FileHandle *fHandle);
 
 #endif
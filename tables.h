@@ -1,14 +1,17 @@
 #ifndef TABLES_H
 #define TABLES_H
 
+#include <stdio.h>
 #include "dt.h"
+#include "dberror.h"
 
 // Data Types, Records, and Schemas
 typedef enum DataType {
 	DT_INT = 0,
 	DT_STRING = 1,
 	DT_FLOAT = 2,
-	DT_BOOL = 3
+	DT_BOOL = 3,
+	DT_BLOB = 4     // a large object stored out of line; the record held its id (see createBlob)
 } DataType;
 
 typedef struct Value {
@@ -18,6 +21,7 @@ typedef struct Value {
 		char *stringV;
 		float floatV;
 		bool boolV;
+		int blobV;      // DT_BLOB: the id of the large object, 0 for none
 	} v;
 } Value;
 
@@ -41,6 +45,7 @@ typedef struct Schema
 	int *typeLength;
 	int *keyAttrs;
 	int keySize;
+	int *attrOffsets; // byte offset of each attribute in a record, [numAttr] is the record size
 } Schema;
 
 // TableData: Management Structure for a Record Manager to handle one relation
@@ -88,4 +93,9 @@ extern char *serializeRecord(Record *record, Schema *schema);
 extern char *serializeAttr(Record *record, Schema *schema, int attrNum);
 extern char *serializeValue(Value *val);
 
+// streaming variants: snprintf-like into a caller's buffer, or straight to a stream
+extern int serializeRecordInto(char *buf, int cap, Record *record, Schema *schema);
+extern int serializeAttrInto(char *buf, int cap, Record *record, Schema *schema, int attrNum);
+extern RC writeTableContent(RM_TableData *rel, FILE *out);
+
 #endif
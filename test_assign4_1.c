@@ -15,6 +15,7 @@
 static void testInsertAndFind (void);
 static void testDelete (void);
 static void testIndexScan (void);
+static void testDuplicatesAndRangeScan (void);
 
 // helper methods
 static Value **createValues (char **stringVals, int size);
@@ -33,6 +34,7 @@ main (void)
   testInsertAndFind();
   testDelete();
   testIndexScan();
+  testDuplicatesAndRangeScan();
 
   return 0;
 }
@@ -266,6 +268,77 @@ testIndexScan (void)
   TEST_DONE();
 }
 
+// ************************************************************ 
+void
+testDuplicatesAndRangeScan (void)
+{
+  BTreeHandle *tree = NULL;
+  BT_ScanHandle *sc = NULL;
+  Value *key, *low, *high;
+  RID rid, prev;
+  int i, rc, testint;
+
+  testName = "duplicate keys, entry deletes and range scans";
+
+  TEST_CHECK(initIndexManager(NULL));
+  TEST_CHECK(createBtreeWithOptions("testidx", DT_INT, 0, 3, TRUE));
+  TEST_CHECK(openBtree(&tree, "testidx"));
+
+  // key i % 10 for RID (i, i), inserted in descending order
+  for(i = 99; i >= 0; i--)
+    {
+      RID r = { i, i };
+      key = stringToValue("i0");
+      key->v.intV = i % 10;
+      TEST_CHECK(insertKey(tree, key, r));
+      ASSERT_EQUALS_INT(RC_IM_KEY_ALREADY_EXISTS, insertKey(tree, key, r), "same key and RID twice");
+      free(key);
+    }
+  TEST_CHECK(getNumEntries(tree, &testint));
+  ASSERT_EQUALS_INT(100, testint, "number of entries in btree");
+
+  // remove the entries of key 4 one by one, and one entry of key 5
+  key = stringToValue("i4");
+  for(i = 4; i < 100; i += 10)
+    {
+      RID r = { i, i };
+      TEST_CHECK(deleteEntry(tree, key, r));
+    }
+  ASSERT_EQUALS_INT(RC_IM_KEY_NOT_FOUND, findKey(tree, key, &rid), "all entries of key 4 were deleted");
+  free(key);
+  key = stringToValue("i5");
+  rid.page = rid.slot = 55;
+  TEST_CHECK(deleteEntry(tree, key, rid));
+  TEST_CHECK(findKey(tree, key, &rid));
+  ASSERT_EQUALS_INT(5, rid.page, "first remaining entry of key 5");
+  free(key);
+
+  // 3 <= key < 6 => keys 3 and 5, each in RID order
+  low = stringToValue("i3");
+  high = stringToValue("i6");
+  TEST_CHECK(openTreeRangeScan(tree, low, TRUE, high, FALSE, &sc));
+  i = 0;
+  prev.page = -1;
+  while((rc = nextEntry(sc, &rid)) == RC_OK)
+    {
+      ASSERT_TRUE(rid.page % 10 == 3 || rid.page % 10 == 5, "key within the range");
+      ASSERT_TRUE(rid.page % 10 > prev.page % 10 || (rid.page % 10 == prev.page % 10 && rid.page > prev.page), "entries in (key, RID) order");
+      prev = rid;
+      i++;
+    }
+  ASSERT_EQUALS_INT(RC_IM_NO_MORE_ENTRIES, rc, "no error returned by scan");
+  ASSERT_EQUALS_INT(19, i, "entries of keys 3 and 5");
+  TEST_CHECK(closeTreeScan(sc));
+  free(low);
+  free(high);
+
+  TEST_CHECK(closeBtree(tree));
+  TEST_CHECK(deleteBtree("testidx"));
+  TEST_CHECK(shutdownIndexManager());
+
+  TEST_DONE();
+}
+
 // ************************************************************ 
 int *
 createPermutation (int size)
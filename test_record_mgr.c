@@ -0,0 +1,3195 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "dberror.h"
+#include "expr.h"
+#include "export_mgr.h"
+#include "join_mgr.h"
+#include "load_mgr.h"
+#include "aggr_mgr.h"
+#include "buffer_mgr.h"
+#include "sort_mgr.h"
+#include "record_mgr.h"
+#include "storage_mgr.h"
+#include "tables.h"
+#include "test_helper.h"
+#include "wal_mgr.h"
+
+// test methods
+static void testAttrAccessors (void);
+static void testVariableLengthRecords (void);
+static void testPaxLayout (void);
+static void testZoneMaps (void);
+static void testSecondaryIndexes (void);
+static void testJoins (void);
+static void testAggregation (void);
+static void testExternalSort (void);
+static void testVacuum (void);
+static void testWriteAheadLog (void);
+static void testCheckpointRecovery (void);
+static void testSnapshots (void);
+static void testConcurrentWrites (void);
+static void testStatistics (void);
+static void testAccessPaths (void);
+static void testBulkLoad (void);
+static void testSerializers (void);
+static void testColumnarExport (void);
+static void testDictionaryEncoding (void);
+static void testPageCompression (void);
+static void testPartitionedTables (void);
+static void testInMemoryTables (void);
+static void testLargeObjects (void);
+static void testRecordViews (void);
+
+// helper methods
+static Schema *testSchema (void);
+static Schema *varcharSchema (int length);
+static void fillString (Record *r, Schema *schema, int attrNum, char c, int len);
+static Record *testRecord (Schema *schema, int a, char *b, float c);
+static int countMatches (RM_TableData *table, Expr *cond);
+static int sumSnapshot (RM_TableData *table, RM_Snapshot *snap, Expr *cond, int *count, int *bad);
+static int filePages (char *name);
+static void copyFile (char *from, char *to);
+static void *commitMany (void *log);
+static void *writeMany (void *thread);
+static void *sortMany (void *byC);
+static double selectivity (RM_TableData *table, int attr, CompOp op, Value *cons);
+static int countPlanned (RM_TableData *table, Expr *cond, RM_ScanPlan *plan);
+static Record *textRecord (Schema *schema, int id, char *text);
+static long fileBytes (char *name);
+static void *scanPartition (void *part);
+static int countJoin (RM_TableData *orders, RM_TableData *customers, Expr *custCond, int attr, char method, int budget);
+static Schema *blobSchema (void);
+static char testBlobByte (long long pos, int seed);
+static int writeTestBlob (RM_TableData *table, int len, int seed);
+static bool checkTestBlob (RM_TableData *table, int id, int len, int seed);
+
+char *testName;
+
+// table shared by the writeMany and sortMany threads
+static RM_TableData *sharedTable;
+
+// main method
+int
+main (void)
+{
+	testName = "";
+
+	testAttrAccessors();
+	testVariableLengthRecords();
+	testPaxLayout();
+	testZoneMaps();
+	testSecondaryIndexes();
+	testJoins();
+	testAggregation();
+	testExternalSort();
+	testVacuum();
+	testWriteAheadLog();
+	testCheckpointRecovery();
+	testSnapshots();
+	testConcurrentWrites();
+	testStatistics();
+	testAccessPaths();
+	testBulkLoad();
+	testSerializers();
+	testColumnarExport();
+	testDictionaryEncoding();
+	testPageCompression();
+	testPartitionedTables();
+	testInMemoryTables();
+	testLargeObjects();
+	testRecordViews();
+
+	return 0;
+}
+
+// ************************************************************
+void
+testAttrAccessors (void)
+{
+	Schema *schema;
+	Record *r;
+	Value *val;
+	Value into;
+	char strBuf[5];
+	const char *view;
+	int len;
+	testName = "test attribute offsets and allocation-free accessors";
+
+	schema = testSchema();
+	ASSERT_EQUALS_INT(0, schema->attrOffsets[0], "offset of a");
+	ASSERT_EQUALS_INT((int) sizeof(int), schema->attrOffsets[1], "offset of b");
+	ASSERT_EQUALS_INT((int) sizeof(int) + 4, schema->attrOffsets[2], "offset of c");
+	ASSERT_EQUALS_INT(getRecordSize(schema), schema->attrOffsets[3], "last offset is the record size");
+
+	r = testRecord(schema, 42, "abcd", 1.5);
+	ASSERT_EQUALS_INT(42, getIntAttr(r, schema, 0), "typed int accessor");
+	ASSERT_TRUE(getFloatAttr(r, schema, 2) == 1.5, "typed float accessor");
+
+	view = getStringAttr(r, schema, 1, &len);
+	ASSERT_EQUALS_INT(4, len, "string view covers the full typeLength");
+	ASSERT_TRUE(strncmp(view, "abcd", len) == 0, "string view points at the value");
+
+	into.v.stringV = strBuf;
+	TEST_CHECK(getAttrInto(r, schema, 1, &into));
+	ASSERT_EQUALS_STRING("abcd", into.v.stringV, "getAttrInto copies into the caller buffer");
+
+	MAKE_STRING_VALUE(val, "x");
+	TEST_CHECK(setAttr(r, schema, 1, val));
+	freeVal(val);
+	view = getStringAttr(r, schema, 1, &len);
+	ASSERT_EQUALS_INT(1, len, "shorter string stops at the padding");
+	ASSERT_EQUALS_INT(42, getIntAttr(r, schema, 0), "neighbour attribute untouched");
+
+	TEST_CHECK(getAttr(r, schema, 2, &val));
+	ASSERT_TRUE(val->v.floatV == 1.5, "getAttr still returns a fresh value");
+	freeVal(val);
+
+	freeRecord(r);
+	freeSchema(schema);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testVariableLengthRecords (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	Schema *schema;
+	Record *r, *check;
+	SM_FileHandle fh;
+	RID rids[200];
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	int i, rc, len, seen;
+	testName = "test variable-length records, overflow chains and moved records";
+
+	schema = varcharSchema(6000);
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable("test_table_var", schema));
+	TEST_CHECK(openTable(table, "test_table_var"));
+	TEST_CHECK(createRecord(&r, schema));
+	TEST_CHECK(createRecord(&check, schema));
+
+	// short values only take the space they need
+	for(i = 0; i < 200; i++)
+	{
+		memset(r->data, 0, getRecordSize(schema));
+		memcpy(r->data, &i, sizeof(int));
+		fillString(r, schema, 1, 'a' + i % 26, 10);
+		TEST_CHECK(insertRecord(table, r));
+		rids[i] = r->id;
+	}
+	TEST_CHECK(openPageFile("test_table_var", &fh));
+	ASSERT_TRUE(fh.totalNumPages <= 3, "200 short VARCHAR(6000) records fit on two pages");
+	TEST_CHECK(closePageFile(&fh));
+
+	// growing a value past the page moves it to an overflow chain, the RID stays
+	for(i = 0; i < 200; i += 20)
+	{
+		memset(r->data, 0, getRecordSize(schema));
+		memcpy(r->data, &i, sizeof(int));
+		fillString(r, schema, 1, 'z', 5000 + i);
+		r->id = rids[i];
+		TEST_CHECK(updateRecord(table, r));
+	}
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(openTable(table, "test_table_var"));
+	schema = table->schema;
+
+	for(i = 0; i < 200; i++)
+	{
+		TEST_CHECK(getRecord(table, rids[i], check));
+		getStringAttr(check, schema, 1, &len);
+		ASSERT_EQUALS_INT(getIntAttr(check, schema, 0), i, "id survives");
+		ASSERT_EQUALS_INT((i % 20 == 0) ? 5000 + i : 10, len, "string length survives");
+	}
+
+	// shrink half of the long values again and delete the others
+	for(i = 0; i < 200; i += 20)
+	{
+		if (i % 40 == 0)
+		{
+			TEST_CHECK(deleteRecord(table, rids[i]));
+		}
+		else
+		{
+			memset(r->data, 0, getRecordSize(schema));
+			memcpy(r->data, &i, sizeof(int));
+			fillString(r, schema, 1, 'y', 3);
+			r->id = rids[i];
+			TEST_CHECK(updateRecord(table, r));
+		}
+	}
+	ASSERT_EQUALS_INT(195, getNumTuples(table), "five records deleted");
+
+	// every live record is seen exactly once, under its original RID
+	seen = 0;
+	TEST_CHECK(startScan(table, sc, NULL));
+	while((rc = next(sc, check)) == RC_OK)
+	{
+		i = getIntAttr(check, schema, 0);
+		ASSERT_TRUE(rids[i].page == check->id.page && rids[i].slot == check->id.slot, "scan returns the home RID");
+		seen++;
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+	ASSERT_EQUALS_INT(195, seen, "scan saw every live record once");
+	TEST_CHECK(closeScan(sc));
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_var"));
+	TEST_CHECK(shutdownRecordManager());
+	freeRecord(r);
+	freeRecord(check);
+	free(table);
+	free(sc);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testPaxLayout (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableOptions options;
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	Schema *schema;
+	Record *r;
+	RID rids[500];
+	Expr *sel, *isEven, *isSmall, *notSmall, *left, *right;
+	int i, rc, seen, projected[] = { 0 };
+	testName = "test PAX layout with minipage predicates and projection";
+
+	schema = testSchema();
+	initTableOptions(&options);
+	options.layout = RM_LAYOUT_PAX;
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTableWithOptions("test_table_pax", schema, &options));
+	TEST_CHECK(openTable(table, "test_table_pax"));
+	freeSchema(schema);
+	schema = table->schema;
+
+	for(i = 0; i < 500; i++)
+	{
+		r = testRecord(schema, i, (i % 2) ? "odd" : "even", i * 0.5);
+		TEST_CHECK(insertRecord(table, r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+	for(i = 0; i < 500; i += 10)
+		TEST_CHECK(deleteRecord(table, rids[i]));
+	r = testRecord(schema, 7, "even", 0);
+	r->id = rids[7];
+	TEST_CHECK(updateRecord(table, r));
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(openTable(table, "test_table_pax"));
+	schema = table->schema;
+
+	TEST_CHECK(getRecord(table, rids[7], r));
+	ASSERT_EQUALS_INT(7, getIntAttr(r, schema, 0), "gathered int attribute");
+	ASSERT_TRUE(strncmp(getStringAttr(r, schema, 1, NULL), "even", 4) == 0, "gathered updated string");
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, getRecord(table, rids[10], r), "deleted slot is empty");
+
+	// b = "even" AND NOT (a < 100), evaluated a minipage at a time
+	MAKE_ATTRREF(left, 1);
+	MAKE_CONS(right, stringToValue("seven"));
+	MAKE_BINOP_EXPR(isEven, left, right, OP_COMP_EQUAL);
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i100"));
+	MAKE_BINOP_EXPR(isSmall, left, right, OP_COMP_SMALLER);
+	MAKE_UNOP_EXPR(notSmall, isSmall, OP_BOOL_NOT);
+	MAKE_BINOP_EXPR(sel, isEven, notSmall, OP_BOOL_AND);
+
+	seen = 0;
+	memset(r->data, 0, getRecordSize(schema));
+	TEST_CHECK(startScanProjection(table, sc, sel, 1, projected));
+	while((rc = next(sc, r)) == RC_OK)
+	{
+		i = getIntAttr(r, schema, 0);
+		ASSERT_TRUE(i >= 100 && i % 2 == 0 && i % 10 != 0, "only matching records are returned");
+		ASSERT_TRUE(getFloatAttr(r, schema, 2) == 0, "unprojected attribute is not read");
+		seen++;
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+	ASSERT_EQUALS_INT(160, seen, "even ids from 100 to 498, minus multiples of 10");
+	TEST_CHECK(closeScan(sc));
+
+	freeExpr(sel);
+	freeRecord(r);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_pax"));
+	TEST_CHECK(shutdownRecordManager());
+	free(table);
+	free(sc);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testZoneMaps (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableOptions options;
+	Schema *schema;
+	Record *r;
+	RID rids[2000];
+	Expr *late, *small, *left, *right;
+	int i, pass, zoned[] = { 0, 2 }, missing[] = { 3 };
+	testName = "test zone maps stay conservative across updates, deletes and reopen";
+
+	schema = testSchema();
+	initTableOptions(&options);
+	options.numZoneAttrs = 1;
+	options.zoneAttrs = missing;
+	TEST_CHECK(initRecordManager(NULL));
+	ASSERT_EQUALS_INT(RC_RM_NO_SUCH_ATTR, createTableWithOptions("test_table_zone", schema, &options), "zoned attribute must exist");
+	options.numZoneAttrs = 2;
+	options.zoneAttrs = zoned;
+	TEST_CHECK(createTableWithOptions("test_table_zone", schema, &options));
+	TEST_CHECK(openTable(table, "test_table_zone"));
+	freeSchema(schema);
+	schema = table->schema;
+
+	// appended in "time order", so every page covers a narrow range of a
+	for(i = 0; i < 2000; i++)
+	{
+		r = testRecord(schema, i, "x", i * 0.5);
+		TEST_CHECK(insertRecord(table, r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+
+	// an old record moved far out of its page's range, and the newest pages emptied
+	r = testRecord(schema, 5000, "x", 2.5);
+	r->id = rids[5];
+	TEST_CHECK(updateRecord(table, r));
+	freeRecord(r);
+	for(i = 1500; i < 2000; i++)
+		TEST_CHECK(deleteRecord(table, rids[i]));
+
+	// a > 1400
+	MAKE_CONS(left, stringToValue("i1400"));
+	MAKE_ATTRREF(right, 0);
+	MAKE_BINOP_EXPR(late, left, right, OP_COMP_SMALLER);
+	// c < 10.0
+	MAKE_ATTRREF(left, 2);
+	MAKE_CONS(right, stringToValue("f10.0"));
+	MAKE_BINOP_EXPR(small, left, right, OP_COMP_SMALLER);
+
+	for(pass = 0; pass < 2; pass++)
+	{
+		ASSERT_EQUALS_INT(100, countMatches(table, late), "records 1401..1499 plus the widened page");
+		ASSERT_EQUALS_INT(20, countMatches(table, small), "records 0..19");
+		ASSERT_EQUALS_INT(1500, countMatches(table, NULL), "scan without a condition");
+
+		// the map was saved on close and loaded on open
+		TEST_CHECK(closeTable(table));
+		TEST_CHECK(openTable(table, "test_table_zone"));
+	}
+
+	freeExpr(late);
+	freeExpr(small);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_zone"));
+	TEST_CHECK(shutdownRecordManager());
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testSecondaryIndexes (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableOptions options;
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	Schema *schema;
+	Record *r;
+	RID rids[300], last;
+	Expr *byName, *range, *below, *lower, *upper, *left, *right;
+	int i, rc, seen, indexed[] = { 0, 1 };
+	testName = "test secondary indexes are maintained and used by scans";
+
+	schema = testSchema();
+	initTableOptions(&options);
+	options.numIndexes = 2;
+	options.indexAttrs = indexed;
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTableWithOptions("test_table_idx", schema, &options));
+	TEST_CHECK(openTable(table, "test_table_idx"));
+	freeSchema(schema);
+	schema = table->schema;
+
+	// a = i % 100 (three records per key), b = "k<i % 7>"
+	for(i = 0; i < 300; i++)
+	{
+		char name[5];
+		sprintf(name, "k%d", i % 7);
+		r = testRecord(schema, i % 100, name, i);
+		TEST_CHECK(insertRecord(table, r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+	for(i = 0; i < 300; i += 3)
+		TEST_CHECK(deleteRecord(table, rids[i]));
+	r = testRecord(schema, 42, "k9", 0);
+	r->id = rids[1];
+	TEST_CHECK(updateRecord(table, r));
+	freeRecord(r);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(openTable(table, "test_table_idx"));
+	schema = table->schema;
+
+	// b = "k9" only finds the updated record
+	MAKE_ATTRREF(left, 1);
+	MAKE_CONS(right, stringToValue("sk9"));
+	MAKE_BINOP_EXPR(byName, left, right, OP_COMP_EQUAL);
+	TEST_CHECK(createRecord(&r, schema));
+	TEST_CHECK(startScan(table, sc, byName));
+	TEST_CHECK(next(sc, r));
+	ASSERT_TRUE(r->id.page == rids[1].page && r->id.slot == rids[1].slot, "index returned the updated record");
+	ASSERT_EQUALS_INT(42, getIntAttr(r, schema, 0), "with its new value");
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, next(sc, r), "old and deleted names are gone from the index");
+	TEST_CHECK(closeScan(sc));
+
+	// 40 <= a AND a < 45, returned in RID order
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i40"));
+	MAKE_BINOP_EXPR(below, left, right, OP_COMP_SMALLER);
+	MAKE_UNOP_EXPR(lower, below, OP_BOOL_NOT);
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i45"));
+	MAKE_BINOP_EXPR(upper, left, right, OP_COMP_SMALLER);
+	MAKE_BINOP_EXPR(range, lower, upper, OP_BOOL_AND);
+
+	seen = 0;
+	last.page = last.slot = -1;
+	TEST_CHECK(startScan(table, sc, range));
+	while((rc = next(sc, r)) == RC_OK)
+	{
+		i = getIntAttr(r, schema, 0);
+		ASSERT_TRUE(i >= 40 && i < 45, "record is in the range");
+		ASSERT_TRUE(r->id.page > last.page || (r->id.page == last.page && r->id.slot > last.slot), "heap fetched in RID order");
+		last = r->id;
+		seen++;
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+	// two of the three records per key survived, plus the one updated to 42
+	ASSERT_EQUALS_INT(11, seen, "records in [40, 45)");
+	TEST_CHECK(closeScan(sc));
+
+	freeExpr(byName);
+	freeExpr(range);
+	freeRecord(r);
+	TEST_CHECK(closeTable(table));
+
+	// an open that failed half way (a missing index) undid what it had set up
+	rename("test_table_idx.b.idx", "test_table_idx.b.moved");
+	ASSERT_TRUE(openTable(table, "test_table_idx") != RC_OK, "no open without the index");
+	rename("test_table_idx.b.moved", "test_table_idx.b.idx");
+	TEST_CHECK(openTable(table, "test_table_idx"));
+	TEST_CHECK(closeTable(table));
+	ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, openTable(table, "test_table_none"), "no such table");
+	ASSERT_TRUE(deleteTable("test_table_none") != RC_OK, "no such table to delete");
+	TEST_CHECK(deleteTable("test_table_idx"));
+	TEST_CHECK(shutdownRecordManager());
+	free(table);
+	free(sc);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testJoins (void)
+{
+	RM_TableData *orders = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableData *customers = (RM_TableData *) malloc(sizeof(RM_TableData));
+	Schema *schema;
+	Record *r;
+	Expr *cond, *left, *right;
+	RM_TableOptions options;
+	char name[5];
+	int i, indexed[] = { 0, 1 };
+	testName = "test hash, index nested-loop and merge joins";
+
+	schema = testSchema();
+	initTableOptions(&options);
+	options.numIndexes = 2;
+	options.indexAttrs = indexed;
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTableWithOptions("test_orders", schema, &options));
+	TEST_CHECK(createTableWithOptions("test_customers", schema, &options));
+	TEST_CHECK(openTable(orders, "test_orders"));
+	TEST_CHECK(openTable(customers, "test_customers"));
+
+	// orders: a = i % 50, b = "o<i % 3>", c >= 1000
+	for(i = 0; i < 400; i++)
+	{
+		sprintf(name, "o%d", i % 3);
+		r = testRecord(schema, i % 50, name, 1000 + i);
+		TEST_CHECK(insertRecord(orders, r));
+		freeRecord(r);
+	}
+	// customers: a = i, b = "o<i % 5>", c < 1000
+	for(i = 0; i < 60; i++)
+	{
+		sprintf(name, "o%d", i % 5);
+		r = testRecord(schema, i, name, i);
+		TEST_CHECK(insertRecord(customers, r));
+		freeRecord(r);
+	}
+
+	// customers with a < 40
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i40"));
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_SMALLER);
+
+	// each of the 40 customers matches 8 orders on a
+	ASSERT_EQUALS_INT(320, countJoin(orders, customers, cond, 0, 'h', 0), "hash join on a in memory");
+	ASSERT_EQUALS_INT(320, countJoin(orders, customers, cond, 0, 'h', 1024), "hash join on a with spilled partitions");
+	ASSERT_EQUALS_INT(320, countJoin(orders, customers, cond, 0, 'i', 0), "index join on a");
+	ASSERT_EQUALS_INT(320, countJoin(orders, customers, cond, 0, 'm', 0), "merge join on a");
+	// 24 of them have b in "o0".."o2", 8 for each name, and each name has ~400/3 orders
+	ASSERT_EQUALS_INT(3200, countJoin(orders, customers, cond, 1, 'h', 0), "hash join on b in memory");
+	ASSERT_EQUALS_INT(3200, countJoin(orders, customers, cond, 1, 'h', 1024), "hash join on b with spilled partitions");
+	ASSERT_EQUALS_INT(3200, countJoin(orders, customers, cond, 1, 'i', 0), "index join on b");
+	ASSERT_EQUALS_INT(3200, countJoin(orders, customers, cond, 1, 'm', 0), "merge join on b");
+
+	freeExpr(cond);
+	TEST_CHECK(closeTable(orders));
+	TEST_CHECK(closeTable(customers));
+	TEST_CHECK(deleteTable("test_orders"));
+	TEST_CHECK(deleteTable("test_customers"));
+	TEST_CHECK(shutdownRecordManager());
+	freeSchema(schema);
+	free(orders);
+	free(customers);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testAggregation (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RM_AggrHandle aggr;
+	RM_AggrSpec byName[] = { { RM_AGGR_COUNT, -1 }, { RM_AGGR_SUM, 0 }, { RM_AGGR_MIN, 2 },
+			{ RM_AGGR_MAX, 2 }, { RM_AGGR_AVG, 2 } };
+	RM_AggrSpec total[] = { { RM_AGGR_COUNT, -1 }, { RM_AGGR_SUM, 2 }, { RM_AGGR_MAX, 1 } };
+	Schema *schema;
+	Record *r;
+	char name[5];
+	int i, rc, budget, groups, rows, bad, sumA[5], nameAttr[] = { 1 }, bothAttrs[] = { 0, 1 };
+	float sumC;
+	testName = "test hash aggregation with and without spilled groups";
+
+	schema = testSchema();
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable("test_table_aggr", schema));
+	TEST_CHECK(openTable(table, "test_table_aggr"));
+
+	// a = i % 37, b = "g<i % 5>", c = i
+	memset(sumA, 0, sizeof(sumA));
+	for(i = 0; i < 1000; i++)
+	{
+		sprintf(name, "g%d", i % 5);
+		r = testRecord(schema, i % 37, name, i);
+		TEST_CHECK(insertRecord(table, r));
+		freeRecord(r);
+		sumA[i % 5] += i % 37;
+	}
+
+	// GROUP BY b: COUNT(*), SUM(a), MIN(c), MAX(c), AVG(c)
+	TEST_CHECK(startScan(table, sc, NULL));
+	TEST_CHECK(startAggregation(sc, 1, nameAttr, 5, byName, 0, &aggr));
+	ASSERT_EQUALS_INT(6, aggr.schema->numAttr, "b plus five aggregates");
+	ASSERT_EQUALS_STRING("avg_c", aggr.schema->attrNames[5], "aggregate attribute name");
+	TEST_CHECK(createRecord(&r, aggr.schema));
+	groups = bad = 0;
+	while((rc = nextGroup(&aggr, r)) == RC_OK)
+	{
+		int len, g;
+		const char *b = getStringAttr(r, aggr.schema, 0, &len);
+		g = b[1] - '0';
+		if (len != 2 || getIntAttr(r, aggr.schema, 1) != 200 || getIntAttr(r, aggr.schema, 2) != sumA[g]
+				|| getFloatAttr(r, aggr.schema, 3) != g || getFloatAttr(r, aggr.schema, 4) != 995 + g
+				|| getFloatAttr(r, aggr.schema, 5) != 497.5f + g)
+			bad++;
+		groups++;
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "all groups returned");
+	ASSERT_EQUALS_INT(5, groups, "one group per name");
+	ASSERT_EQUALS_INT(0, bad, "every group has the right aggregates");
+	freeRecord(r);
+	TEST_CHECK(closeAggregation(&aggr));
+	TEST_CHECK(closeScan(sc));
+
+	// GROUP BY a, b: 185 groups, in memory and with most of them spilled
+	for(budget = 0; budget <= 1024; budget += 1024)
+	{
+		RM_AggrSpec sums[] = { { RM_AGGR_COUNT, -1 }, { RM_AGGR_SUM, 2 } };
+		TEST_CHECK(startScan(table, sc, NULL));
+		TEST_CHECK(startAggregation(sc, 2, bothAttrs, 2, sums, budget, &aggr));
+		TEST_CHECK(createRecord(&r, aggr.schema));
+		groups = rows = 0;
+		sumC = 0;
+		while((rc = nextGroup(&aggr, r)) == RC_OK)
+		{
+			groups++;
+			rows += getIntAttr(r, aggr.schema, 2);
+			sumC += getFloatAttr(r, aggr.schema, 3);
+		}
+		ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "all groups returned");
+		ASSERT_EQUALS_INT(185, groups, "one group per (a, b) pair");
+		ASSERT_EQUALS_INT(1000, rows, "group counts add up to the input");
+		ASSERT_EQUALS_INT(499500, (int) sumC, "group sums add up to the input");
+		freeRecord(r);
+		TEST_CHECK(closeAggregation(&aggr));
+		TEST_CHECK(closeScan(sc));
+	}
+
+	// No group attributes: one group, also for an empty input
+	TEST_CHECK(startScan(table, sc, NULL));
+	TEST_CHECK(startAggregation(sc, 0, NULL, 3, total, 0, &aggr));
+	TEST_CHECK(createRecord(&r, aggr.schema));
+	TEST_CHECK(nextGroup(&aggr, r));
+	ASSERT_EQUALS_INT(1000, getIntAttr(r, aggr.schema, 0), "COUNT(*)");
+	ASSERT_EQUALS_INT(499500, (int) getFloatAttr(r, aggr.schema, 1), "SUM(c)");
+	ASSERT_EQUALS_STRING("g4", getStringAttr(r, aggr.schema, 2, &i), "MAX(b)");
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, nextGroup(&aggr, r), "a single group");
+	freeRecord(r);
+	TEST_CHECK(closeAggregation(&aggr));
+	TEST_CHECK(closeScan(sc));
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_aggr"));
+	TEST_CHECK(shutdownRecordManager());
+	freeSchema(schema);
+	free(table);
+	free(sc);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testExternalSort (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RM_SortHandle sort;
+	RM_SortKey byAC[] = { { 0, 0 }, { 2, 1 } };
+	RM_SortKey byB[] = { { 1, 1 } };
+	int budgets[] = { 0, 2000, 400 };
+	pthread_t threads[2];
+	void *failed;
+	Schema *schema;
+	Record *r;
+	char name[5], last[5];
+	int i, k, rc, rows, bad, lastA, len;
+	float lastC;
+	testName = "test external merge sort in memory, with one merge and with merge passes";
+
+	schema = testSchema();
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTable("test_table_sort", schema));
+	TEST_CHECK(openTable(table, "test_table_sort"));
+
+	// a = i * 7919 % 1000 (every value twice), b = "s<a % 26 as a letter>", c = i
+	for(i = 0; i < 2000; i++)
+	{
+		sprintf(name, "s%c", 'a' + (i * 7919 % 1000) % 26);
+		r = testRecord(schema, i * 7919 % 1000, name, i);
+		TEST_CHECK(insertRecord(table, r));
+		freeRecord(r);
+	}
+	TEST_CHECK(createRecord(&r, schema));
+
+	// ORDER BY a, c DESC
+	for(k = 0; k < 3; k++)
+	{
+		TEST_CHECK(startScan(table, sc, NULL));
+		TEST_CHECK(startSort(sc, 2, byAC, budgets[k], &sort));
+		rows = bad = 0;
+		lastA = -1;
+		lastC = 0;
+		while((rc = nextSorted(&sort, r)) == RC_OK)
+		{
+			int a = getIntAttr(r, schema, 0);
+			float c = getFloatAttr(r, schema, 2);
+			if (a < lastA || (a == lastA && c >= lastC))
+				bad++;
+			lastA = a;
+			lastC = c;
+			rows++;
+		}
+		ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "sort ended normally");
+		ASSERT_EQUALS_INT(2000, rows, "every record returned once");
+		ASSERT_EQUALS_INT(0, bad, "records ordered by a, then c descending");
+		TEST_CHECK(closeSort(&sort));
+		TEST_CHECK(closeScan(sc));
+	}
+
+	// ORDER BY b DESC keeps equal names in table order
+	TEST_CHECK(startScan(table, sc, NULL));
+	TEST_CHECK(startSort(sc, 1, byB, 400, &sort));
+	rows = bad = 0;
+	strcpy(last, "sz~");
+	lastC = -1;
+	while((rc = nextSorted(&sort, r)) == RC_OK)
+	{
+		const char *b = getStringAttr(r, schema, 1, &len);
+		float c = getFloatAttr(r, schema, 2);
+		int cmp = strncmp(b, last, len + 1);
+		if (cmp > 0 || (cmp == 0 && c <= lastC))
+			bad++;
+		memcpy(last, b, len);
+		last[len] = '\0';
+		lastC = c;
+		rows++;
+	}
+	ASSERT_EQUALS_INT(2000, rows, "every record returned once");
+	ASSERT_EQUALS_INT(0, bad, "records ordered by b descending and stable");
+	TEST_CHECK(closeSort(&sort));
+	TEST_CHECK(closeScan(sc));
+
+	// two sorts by different keys at once, both spilling runs, kept apart
+	sharedTable = table;
+	for(k = 0; k < 2; k++)
+		pthread_create(&threads[k], NULL, sortMany, (void *) (long) k);
+	for(k = 0; k < 2; k++)
+	{
+		pthread_join(threads[k], &failed);
+		ASSERT_EQUALS_INT(0, (int) (long) failed, "concurrent sort ordered by its own keys");
+	}
+
+	freeRecord(r);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_sort"));
+	TEST_CHECK(shutdownRecordManager());
+	freeSchema(schema);
+	free(table);
+	free(sc);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testVacuum (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableOptions options;
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	Schema *schema;
+	Record *r;
+	RID rids[2000];
+	Expr *byKey, *left, *right;
+	const char *b;
+	int i, rc, len, layout, before, sum, bad, indexed[] = { 0 };
+	testName = "test vacuum moves tail records forward and shrinks the file";
+
+	TEST_CHECK(initRecordManager(NULL));
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i1230"));
+	MAKE_BINOP_EXPR(byKey, left, right, OP_COMP_EQUAL);
+
+	for(layout = RM_LAYOUT_ROW; layout <= RM_LAYOUT_PAX; layout++)
+	{
+		schema = testSchema();
+		initTableOptions(&options);
+		options.layout = layout;
+		options.numIndexes = 1;
+		options.indexAttrs = indexed;
+		TEST_CHECK(createTableWithOptions("test_table_vac", schema, &options));
+		TEST_CHECK(openTable(table, "test_table_vac"));
+		freeSchema(schema);
+		schema = table->schema;
+
+		for(i = 0; i < 2000; i++)
+		{
+			r = testRecord(schema, i, "", i);
+			TEST_CHECK(insertRecord(table, r));
+			rids[i] = r->id;
+			freeRecord(r);
+		}
+		// some early records grew out of their full pages (row tables forwarded
+		// them to the end of the file), then only every tenth record survived
+		for(i = 0; i < 300; i += 10)
+		{
+			r = testRecord(schema, i, "abcd", i);
+			r->id = rids[i];
+			TEST_CHECK(updateRecord(table, r));
+			freeRecord(r);
+		}
+		for(i = 0; i < 2000; i++)
+			if (i % 10 != 0)
+				TEST_CHECK(deleteRecord(table, rids[i]));
+		TEST_CHECK(closeTable(table));
+		before = filePages("test_table_vac");
+
+		TEST_CHECK(openTable(table, "test_table_vac"));
+		schema = table->schema;
+		TEST_CHECK(vacuumTable(table));
+		TEST_CHECK(closeTable(table));
+		ASSERT_TRUE(before > 5, "deletes left the file as long as before");
+		ASSERT_EQUALS_INT(2, filePages("test_table_vac"), "file shrank to the header and one data page");
+
+		TEST_CHECK(openTable(table, "test_table_vac"));
+		schema = table->schema;
+		ASSERT_EQUALS_INT(200, getNumTuples(table), "no record was lost");
+
+		// every survivor came back once, with its values
+		sum = bad = 0;
+		TEST_CHECK(createRecord(&r, schema));
+		TEST_CHECK(startScan(table, sc, NULL));
+		while((rc = next(sc, r)) == RC_OK)
+		{
+			i = getIntAttr(r, schema, 0);
+			b = getStringAttr(r, schema, 1, &len);
+			sum += i;
+			if (i % 10 != 0 || getFloatAttr(r, schema, 2) != (float) i
+				|| len != ((i < 300) ? 4 : 0) || (len == 4 && memcmp(b, "abcd", 4) != 0))
+				bad++;
+		}
+		ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+		TEST_CHECK(closeScan(sc));
+		ASSERT_EQUALS_INT(199000, sum, "records 0, 10, ..., 1990");
+		ASSERT_EQUALS_INT(0, bad, "values survived the move");
+
+		// the index followed the moved record
+		TEST_CHECK(startScan(table, sc, byKey));
+		TEST_CHECK(next(sc, r));
+		ASSERT_EQUALS_INT(1230, getIntAttr(r, schema, 0), "index found the moved record");
+		ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, next(sc, r), "and only once");
+		TEST_CHECK(closeScan(sc));
+		freeRecord(r);
+
+		// the table kept working after the file shrank
+		r = testRecord(schema, 5000, "new", 0);
+		TEST_CHECK(insertRecord(table, r));
+		freeRecord(r);
+		ASSERT_EQUALS_INT(201, countMatches(table, NULL), "insert after vacuum");
+
+		TEST_CHECK(closeTable(table));
+		TEST_CHECK(deleteTable("test_table_vac"));
+	}
+
+	freeExpr(byKey);
+	TEST_CHECK(shutdownRecordManager());
+	free(table);
+	free(sc);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testWriteAheadLog (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableOptions options;
+	WAL_Log log;
+	Schema *schema;
+	Record *r;
+	Expr *byKey, *left, *right;
+	WAL_RecoveryStats stats;
+	pthread_t threads[4];
+	char *files[] = { "test_table_wal", "test_table_wal.a.idx", "test_wal.log" };
+	char crash[64], header[PAGE_SIZE];
+	void *failed;
+	FILE *f;
+	int i, numTuples, bad, indexed[] = { 0 };
+	testName = "test write-ahead log recovery and group commit";
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createLog("test_wal.log"));
+	TEST_CHECK(openLog(&log, "test_wal.log"));
+	schema = testSchema();
+	initTableOptions(&options);
+	options.numIndexes = 1;
+	options.indexAttrs = indexed;
+	TEST_CHECK(createTableWithOptions("test_table_wal", schema, &options));
+	TEST_CHECK(openTable(table, "test_table_wal"));
+	freeSchema(schema);
+	schema = table->schema;
+	TEST_CHECK(attachTableLog(table, &log));
+
+	for(i = 0; i < 300; i++)
+	{
+		r = testRecord(schema, i, "w", i);
+		TEST_CHECK(insertRecord(table, r));
+		freeRecord(r);
+	}
+	TEST_CHECK(commitTable(table));
+
+	// crashed right after the commit: kept the files as they were on disk then
+	for(i = 0; i < 3; i++)
+	{
+		sprintf(crash, "%s.crash", files[i]);
+		copyFile(files[i], crash);
+	}
+	f = fopen("test_table_wal", "rb");
+	ASSERT_TRUE(f != NULL && fread(header, 1, PAGE_SIZE, f) == PAGE_SIZE, "read the header page");
+	fclose(f);
+	sscanf(header, "%d", &numTuples);
+	ASSERT_EQUALS_INT(0, numTuples, "the header page was logged, not forced");
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(closeLog(&log));
+	for(i = 0; i < 3; i++)
+	{
+		sprintf(crash, "%s.crash", files[i]);
+		copyFile(crash, files[i]);
+		remove(crash);
+	}
+
+	// recovery brought back the table, its header and its index
+	TEST_CHECK(recoverLog("test_wal.log", 0, &stats));
+	ASSERT_TRUE(stats.numRedone > 0, "page records were redone");
+	TEST_CHECK(openTable(table, "test_table_wal"));
+	ASSERT_EQUALS_INT(300, getNumTuples(table), "committed tuple count");
+	ASSERT_EQUALS_INT(300, countMatches(table, NULL), "committed records");
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i123"));
+	MAKE_BINOP_EXPR(byKey, left, right, OP_COMP_EQUAL);
+	ASSERT_EQUALS_INT(1, countMatches(table, byKey), "index scan after recovery");
+	freeExpr(byKey);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_wal"));
+	TEST_CHECK(destroyLog("test_wal.log"));
+
+	// four threads committing 25 times each shared their syncs
+	TEST_CHECK(createLog("test_wal_group.log"));
+	TEST_CHECK(openLog(&log, "test_wal_group.log"));
+	log.groupCommitUsec = 1000;
+	for(i = 0; i < 4; i++)
+		pthread_create(&threads[i], NULL, commitMany, &log);
+	bad = 0;
+	for(i = 0; i < 4; i++)
+	{
+		pthread_join(threads[i], &failed);
+		bad += (int) (long) failed;
+	}
+	ASSERT_EQUALS_INT(0, bad, "every commit succeeded");
+	ASSERT_TRUE(getNumLogSyncs(&log) < 100, "fewer syncs than commits");
+	ASSERT_TRUE(getFlushedLSN(&log) > 0, "commit records were durable");
+	TEST_CHECK(closeLog(&log));
+	TEST_CHECK(destroyLog("test_wal_group.log"));
+
+	TEST_CHECK(shutdownRecordManager());
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testCheckpointRecovery (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableOptions options;
+	WAL_Log log;
+	WAL_RecoveryStats stats;
+	Schema *schema;
+	Record *r;
+	Expr *byKey, *left, *right;
+	char *files[] = { "test_table_ckpt", "test_table_ckpt.a.idx", "test_ckpt.log", "test_ckpt.log.master" };
+	char crash[64];
+	LSN first;
+	int i, indexed[] = { 0 };
+	testName = "test fuzzy checkpoints and parallel redo";
+
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createLog("test_ckpt.log"));
+	TEST_CHECK(openLog(&log, "test_ckpt.log"));
+	ASSERT_TRUE(getLastCheckpointLSN(&log) == WAL_NO_LSN, "a new log had no checkpoint");
+	schema = testSchema();
+	initTableOptions(&options);
+	options.numIndexes = 1;
+	options.indexAttrs = indexed;
+	TEST_CHECK(createTableWithOptions("test_table_ckpt", schema, &options));
+	TEST_CHECK(openTable(table, "test_table_ckpt"));
+	freeSchema(schema);
+	schema = table->schema;
+	TEST_CHECK(attachTableLog(table, &log));
+
+	for(i = 0; i < 300; i++)
+	{
+		r = testRecord(schema, i, "c", i);
+		TEST_CHECK(insertRecord(table, r));
+		freeRecord(r);
+	}
+	TEST_CHECK(commitTable(table));
+	TEST_CHECK(checkpointLog(&log));
+	first = getLastCheckpointLSN(&log);
+	ASSERT_TRUE(first > 0, "explicit checkpoint");
+
+	// later checkpoints were taken automatically while records were inserted
+	log.checkpointInterval = 16 * PAGE_SIZE;
+	for(i = 300; i < 400; i++)
+	{
+		r = testRecord(schema, i, "c", i);
+		TEST_CHECK(insertRecord(table, r));
+		freeRecord(r);
+	}
+	TEST_CHECK(commitTable(table));
+	ASSERT_TRUE(getLastCheckpointLSN(&log) > first, "automatic checkpoint");
+
+	// crashed right after the commit
+	for(i = 0; i < 4; i++)
+	{
+		sprintf(crash, "%s.crash", files[i]);
+		copyFile(files[i], crash);
+	}
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(closeLog(&log));
+	for(i = 0; i < 4; i++)
+	{
+		sprintf(crash, "%s.crash", files[i]);
+		copyFile(crash, files[i]);
+		remove(crash);
+	}
+
+	// redo started at the checkpoint's oldest dirty page, not the start of the log
+	TEST_CHECK(recoverLog("test_ckpt.log", 4, &stats));
+	ASSERT_TRUE(stats.checkpointLSN > first, "recovery used the newest checkpoint");
+	ASSERT_TRUE(stats.redoStart > 0 && stats.redoStart <= stats.checkpointLSN, "redo started before the checkpoint");
+	ASSERT_TRUE(stats.numRedone > 0, "page records were redone");
+	TEST_CHECK(openTable(table, "test_table_ckpt"));
+	ASSERT_EQUALS_INT(400, getNumTuples(table), "committed tuple count");
+	ASSERT_EQUALS_INT(400, countMatches(table, NULL), "committed records");
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i345"));
+	MAKE_BINOP_EXPR(byKey, left, right, OP_COMP_EQUAL);
+	ASSERT_EQUALS_INT(1, countMatches(table, byKey), "index scan after recovery");
+	freeExpr(byKey);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_ckpt"));
+	TEST_CHECK(destroyLog("test_ckpt.log"));
+
+	TEST_CHECK(shutdownRecordManager());
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testSnapshots (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableOptions options;
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RM_Snapshot snap;
+	Schema *schema;
+	Record *r, *w;
+	RID rids[2000], added;
+	Expr *high, *left, *right;
+	int i, rc, len, layout, sum, count, bad, waited, zoned[] = { 0 }, indexed[] = { 0 };
+	testName = "test snapshot reads while records are written";
+
+	TEST_CHECK(initRecordManager(NULL));
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i1990"));
+	MAKE_BINOP_EXPR(high, right, left, OP_COMP_SMALLER);
+
+	for(layout = RM_LAYOUT_ROW; layout <= RM_LAYOUT_PAX; layout++)
+	{
+		schema = testSchema();
+		initTableOptions(&options);
+		options.layout = layout;
+		options.numZoneAttrs = 1;
+		options.zoneAttrs = zoned;
+		options.numIndexes = 1;
+		options.indexAttrs = indexed;
+		TEST_CHECK(createTableWithOptions("test_table_mvcc", schema, &options));
+		TEST_CHECK(openTable(table, "test_table_mvcc"));
+		freeSchema(schema);
+		schema = table->schema;
+
+		for(i = 0; i < 2000; i++)
+		{
+			r = testRecord(schema, i, "", i);
+			TEST_CHECK(insertRecord(table, r));
+			rids[i] = r->id;
+			freeRecord(r);
+		}
+		// the last records grew into the room deletes left on early pages (row
+		// tables forwarded them there)
+		for(i = 300; i < 400; i++)
+			TEST_CHECK(deleteRecord(table, rids[i]));
+		for(i = 1900; i < 2000; i++)
+		{
+			r = testRecord(schema, i, "abcd", i);
+			r->id = rids[i];
+			TEST_CHECK(updateRecord(table, r));
+			freeRecord(r);
+		}
+		ASSERT_EQUALS_INT(0, getNumVersions(table), "no versions without snapshots");
+		TEST_CHECK(beginSnapshot(&snap));
+
+		// then records were updated and deleted and more were inserted
+		for(i = 0; i < 300; i++)
+		{
+			r = testRecord(schema, i, "abcd", i + 5000);
+			r->id = rids[i];
+			TEST_CHECK(updateRecord(table, r));
+			freeRecord(r);
+		}
+		for(i = 400; i < 500; i++)
+			TEST_CHECK(deleteRecord(table, rids[i]));
+		for(i = 0; i < 150; i++)
+		{
+			r = testRecord(schema, 2000 + i, "new", 0);
+			TEST_CHECK(insertRecord(table, r));
+			added = r->id;
+			freeRecord(r);
+		}
+		ASSERT_EQUALS_INT(1950, countMatches(table, NULL), "scans without a snapshot saw the writes");
+		ASSERT_TRUE(getNumVersions(table) > 0, "writes kept versions for the snapshot");
+		ASSERT_EQUALS_INT(RC_RM_SNAPSHOT_OPEN, vacuumTable(table), "no vacuum under a snapshot");
+
+		// the snapshot saw the table as it was
+		ASSERT_EQUALS_INT(1964050, sumSnapshot(table, &snap, NULL, &count, &bad), "snapshot sum");
+		ASSERT_EQUALS_INT(1900, count, "snapshot count");
+		ASSERT_EQUALS_INT(0, bad, "snapshot values");
+		sumSnapshot(table, &snap, high, &count, &bad);
+		ASSERT_EQUALS_INT(9, count, "snapshot scan with a condition");
+
+		TEST_CHECK(createRecord(&r, schema));
+		TEST_CHECK(getRecordAsOf(table, rids[7], r, &snap));
+		ASSERT_TRUE(getFloatAttr(r, schema, 2) == 7.0f, "old version of an updated record");
+		TEST_CHECK(getRecordAsOf(table, rids[450], r, &snap));
+		ASSERT_EQUALS_INT(450, getIntAttr(r, schema, 0), "deleted record was still there");
+		ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, getRecordAsOf(table, added, r, &snap), "new record was not");
+
+		// writes in the middle of a snapshot scan changed nothing it returned
+		sum = count = bad = 0;
+		TEST_CHECK(startScanAsOf(table, sc, NULL, &snap));
+		while((rc = next(sc, r)) == RC_OK)
+		{
+			i = getIntAttr(r, schema, 0);
+			getStringAttr(r, schema, 1, &len);
+			sum += i;
+			count++;
+			if (len != ((i >= 1900) ? 4 : 0) || getFloatAttr(r, schema, 2) != (float) i)
+				bad++;
+			if (i >= 500 && i % 3 == 0)
+			{
+				w = testRecord(schema, i, "wxyz", -1);
+				w->id = r->id;
+				TEST_CHECK(updateRecord(table, w));
+				freeRecord(w);
+			}
+			else if (i >= 500 && i % 3 == 1)
+				TEST_CHECK(deleteRecord(table, r->id));
+			// records whose bodies had moved changed before the scan reached them
+			if (i == 1000)
+				for(i = 1900; i < 2000; i++)
+				{
+					w = testRecord(schema, i, "wx", -1);
+					w->id = rids[i];
+					TEST_CHECK(updateRecord(table, w));
+					freeRecord(w);
+				}
+		}
+		ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+		TEST_CHECK(closeScan(sc));
+		ASSERT_EQUALS_INT(1900, count, "every record once");
+		ASSERT_EQUALS_INT(1964050, sum, "snapshot sum during writes");
+		ASSERT_EQUALS_INT(0, bad, "snapshot values during writes");
+		freeRecord(r);
+
+		// once the snapshot ended, the collector dropped every version
+		TEST_CHECK(endSnapshot(&snap));
+		for(waited = 0; waited < 200 && getNumVersions(table) > 0; waited++)
+			usleep(10000);
+		ASSERT_EQUALS_INT(0, getNumVersions(table), "old versions were collected");
+		ASSERT_EQUALS_INT(1450, countMatches(table, NULL), "newest versions");
+		TEST_CHECK(vacuumTable(table));
+
+		TEST_CHECK(closeTable(table));
+		TEST_CHECK(deleteTable("test_table_mvcc"));
+	}
+
+	freeExpr(high);
+	TEST_CHECK(shutdownRecordManager());
+	free(sc);
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testConcurrentWrites (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableOptions options;
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	pthread_t threads[4];
+	Schema *schema;
+	Record *r;
+	Expr *low, *left, *right;
+	void *failed;
+	int t, i, rc, len, layout, count, bad, zoned[] = { 0 }, indexed[] = { 0 };
+	testName = "test threads writing to one table";
+
+	TEST_CHECK(initRecordManager(NULL));
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i1000"));
+	MAKE_BINOP_EXPR(low, left, right, OP_COMP_SMALLER);
+
+	for(layout = RM_LAYOUT_ROW; layout <= RM_LAYOUT_PAX; layout++)
+	{
+		schema = testSchema();
+		initTableOptions(&options);
+		options.layout = layout;
+		options.numZoneAttrs = 1;
+		options.zoneAttrs = zoned;
+		options.numIndexes = 1;
+		options.indexAttrs = indexed;
+		TEST_CHECK(createTableWithOptions("test_table_threads", schema, &options));
+		TEST_CHECK(openTable(table, "test_table_threads"));
+		freeSchema(schema);
+		schema = table->schema;
+
+		// each thread inserted, updated and deleted records of its own
+		sharedTable = table;
+		for(t = 0; t < 4; t++)
+		{
+			rc = pthread_create(&threads[t], NULL, writeMany, (void *) (long) t);
+			ASSERT_EQUALS_INT(0, rc, "started a writer");
+		}
+		for(t = 0; t < 4; t++)
+		{
+			pthread_join(threads[t], &failed);
+			ASSERT_EQUALS_INT(0, (int) (long) failed, "every write of a thread succeeded");
+		}
+
+		ASSERT_EQUALS_INT(1600, getNumTuples(table), "tuple count after concurrent writes");
+		ASSERT_EQUALS_INT(1600, countMatches(table, NULL), "every record was found");
+		ASSERT_EQUALS_INT(400, countMatches(table, low), "records of the first thread");
+
+		count = bad = 0;
+		TEST_CHECK(createRecord(&r, schema));
+		TEST_CHECK(startScan(table, sc, NULL));
+		while((rc = next(sc, r)) == RC_OK)
+		{
+			i = getIntAttr(r, schema, 0) % 1000;
+			getStringAttr(r, schema, 1, &len);
+			count++;
+			if (i % 5 == 0 || len != ((i % 2 == 0) ? 4 : 0)
+				|| getFloatAttr(r, schema, 2) != ((i % 2 == 0) ? -1.0f : (float) i))
+				bad++;
+		}
+		ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+		TEST_CHECK(closeScan(sc));
+		ASSERT_EQUALS_INT(1600, count, "scanned every record once");
+		ASSERT_EQUALS_INT(0, bad, "every record held its last write");
+		freeRecord(r);
+
+		TEST_CHECK(closeTable(table));
+		TEST_CHECK(deleteTable("test_table_threads"));
+	}
+
+	freeExpr(low);
+	TEST_CHECK(shutdownRecordManager());
+	free(sc);
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testStatistics (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RM_AggrHandle aggr;
+	RM_AggrSpec count[] = { { RM_AGGR_COUNT, -1 } };
+	RM_AttrStats st;
+	Schema *schema;
+	Record *r;
+	Value v;
+	char name[8];
+	double sel, ndvA;
+	int i, rc, groups, byName[] = { 1 };
+	testName = "test table statistics and estimates";
+
+	TEST_CHECK(initRecordManager(NULL));
+	schema = testSchema();
+	TEST_CHECK(createTable("test_table_stats", schema));
+	TEST_CHECK(openTable(table, "test_table_stats"));
+	freeSchema(schema);
+	schema = table->schema;
+
+	// a = i (unique), b = "s<i % 50>", c = i % 7; more pages than analyzeTable reads
+	for(i = 0; i < 30000; i++)
+	{
+		sprintf(name, "s%03d", i % 50);
+		r = testRecord(schema, i, name, i % 7);
+		TEST_CHECK(insertRecord(table, r));
+		freeRecord(r);
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_STATS, getAttrStats(table, 0, &st), "no statistics before analyzeTable");
+	v.dt = DT_INT;
+	v.v.intV = 100;
+	ASSERT_TRUE(selectivity(table, 0, COMP_LT, &v) == RM_STATS_DEFAULT_RANGE, "default guess without statistics");
+
+	TEST_CHECK(analyzeTable(table));
+	TEST_CHECK(getAttrStats(table, 0, &st));
+	ASSERT_TRUE(st.min >= 0 && st.max < 30000 && st.max > 29000, "range of a");
+	ASSERT_TRUE(st.ndv > 21000 && st.ndv <= 30000, "distinct values of a, scaled up from the sample");
+	ndvA = st.ndv;
+	TEST_CHECK(getAttrStats(table, 1, &st));
+	ASSERT_TRUE(st.ndv > 40 && st.ndv < 60, "distinct values of b");
+	ASSERT_TRUE(st.nullFrac == 0, "no NULLs");
+	TEST_CHECK(getAttrStats(table, 2, &st));
+	ASSERT_TRUE(st.ndv > 6 && st.ndv < 8, "distinct values of c");
+	ASSERT_EQUALS_INT(RC_RM_NO_SUCH_ATTR, getAttrStats(table, 3, &st), "no such attribute");
+
+	// estimates from the histograms and distinct counts
+	v.v.intV = 6000;
+	sel = selectivity(table, 0, COMP_LT, &v);
+	ASSERT_TRUE(sel > 0.15 && sel < 0.25, "a < 6000 is about a fifth");
+	sel = selectivity(table, 0, COMP_GE, &v);
+	ASSERT_TRUE(sel > 0.75 && sel < 0.85, "a >= 6000 is the rest");
+	sel = selectivity(table, 0, COMP_EQ, &v);
+	ASSERT_TRUE(sel > 0 && sel < 0.001, "a = 6000 is one tuple");
+	v.v.intV = 50000;
+	ASSERT_TRUE(selectivity(table, 0, COMP_EQ, &v) == 0, "a = 50000 is out of range");
+	ASSERT_TRUE(selectivity(table, 0, COMP_GT, &v) == 0, "a > 50000 is out of range");
+	v.dt = DT_FLOAT;
+	v.v.floatV = 3;
+	sel = selectivity(table, 2, COMP_EQ, &v);
+	ASSERT_TRUE(sel > 0.12 && sel < 0.17, "c = 3 is a seventh");
+	v.dt = DT_STRING;
+	v.v.stringV = "s010";
+	sel = selectivity(table, 1, COMP_EQ, &v);
+	ASSERT_TRUE(sel > 0.015 && sel < 0.025, "b = 's010' is a fiftieth");
+
+	// the statistics were saved with the table
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(openTable(table, "test_table_stats"));
+	schema = table->schema;
+	TEST_CHECK(getAttrStats(table, 0, &st));
+	ASSERT_TRUE(st.ndv == ndvA, "statistics after reopening");
+
+	// aggregation sized its hash table from them and still found every group
+	TEST_CHECK(startScan(table, sc, NULL));
+	TEST_CHECK(startAggregation(sc, 1, byName, 1, count, 0, &aggr));
+	TEST_CHECK(createRecord(&r, aggr.schema));
+	groups = 0;
+	while((rc = nextGroup(&aggr, r)) == RC_OK)
+		groups++;
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "all groups returned");
+	ASSERT_EQUALS_INT(50, groups, "one group per name");
+	freeRecord(r);
+	TEST_CHECK(closeAggregation(&aggr));
+	TEST_CHECK(closeScan(sc));
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_stats"));
+	TEST_CHECK(shutdownRecordManager());
+	free(sc);
+	free(table);
+
+	TEST_DONE();
+}
+
+void
+testAccessPaths (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableOptions options;
+	RM_ScanPlan plan, explained;
+	RM_Snapshot snap;
+	RM_AttrStats st;
+	Schema *schema;
+	Record *r;
+	Expr *point, *prefix, *below, *all, *both, *byName, *fewC, *left, *right;
+	char name[8];
+	int i, c, count, bad, nPoint = 0, nBoth = 0, zoned[] = { 0 }, indexed[] = { 1, 2 };
+	testName = "test scans choose their access path by estimated cost";
+
+	schema = testSchema();
+	initTableOptions(&options);
+	options.numZoneAttrs = 1;
+	options.zoneAttrs = zoned;
+	options.numIndexes = 2;
+	options.indexAttrs = indexed;
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTableWithOptions("test_table_path", schema, &options));
+	TEST_CHECK(openTable(table, "test_table_path"));
+	freeSchema(schema);
+	schema = table->schema;
+
+	// a = i (in insertion order), b = "s<i % 50>", c scattered over 0..999
+	for(i = 0; i < 20000; i++)
+	{
+		c = (i * 7919) % 1000;
+		sprintf(name, "s%03d", i % 50);
+		r = testRecord(schema, i, name, c);
+		TEST_CHECK(insertRecord(table, r));
+		freeRecord(r);
+		nPoint += (c == 500);
+		nBoth += (c < 30 && i % 50 == 10);
+	}
+
+	// c = 500: a few records anywhere in the table
+	MAKE_ATTRREF(left, 2);
+	MAKE_CONS(right, stringToValue("f500"));
+	MAKE_BINOP_EXPR(point, left, right, OP_COMP_EQUAL);
+
+	// without statistics the planner sampled a few pages itself
+	ASSERT_EQUALS_INT(RC_RM_NO_STATS, getAttrStats(table, 2, &st), "not analyzed yet");
+	TEST_CHECK(explainScan(table, point, &explained));
+	TEST_CHECK(getAttrStats(table, 2, &st));
+	ASSERT_TRUE(explained.estRows > 5 && explained.estRows < 80, "estimate from the planner's sample");
+
+	ASSERT_EQUALS_INT(nPoint, countPlanned(table, point, &plan), "records with c = 500");
+	ASSERT_EQUALS_INT(RM_PATH_INDEX, plan.path, "c = 500 used the index");
+	ASSERT_EQUALS_INT(2, plan.indexAttrs[0], "the index on c");
+	ASSERT_TRUE(plan.cost < plan.seqCost, "cheaper than reading every page");
+	TEST_CHECK(getAttrStats(table, 2, &st));
+	TEST_CHECK(explainScan(table, point, &explained));
+	ASSERT_TRUE(explained.path == plan.path && explained.cost == plan.cost, "explainScan agreed with the scan");
+	ASSERT_TRUE(strncmp(explained.text, "INDEX SCAN on c", 15) == 0, "plan text names the index");
+
+	// a < 1000: the first pages, which only the zone map knew
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i1000"));
+	MAKE_BINOP_EXPR(prefix, left, right, OP_COMP_SMALLER);
+	ASSERT_EQUALS_INT(1000, countPlanned(table, prefix, &plan), "records with a < 1000");
+	ASSERT_EQUALS_INT(RM_PATH_ZONE, plan.path, "a < 1000 skipped pages with the zone map");
+
+	// c >= 0: everything
+	MAKE_ATTRREF(left, 2);
+	MAKE_CONS(right, stringToValue("f0"));
+	MAKE_BINOP_EXPR(below, left, right, OP_COMP_SMALLER);
+	MAKE_UNOP_EXPR(all, below, OP_BOOL_NOT);
+	ASSERT_EQUALS_INT(20000, countPlanned(table, all, &plan), "records with c >= 0");
+	ASSERT_EQUALS_INT(RM_PATH_SEQ, plan.path, "c >= 0 read every page");
+	ASSERT_TRUE(plan.estRows > 18000, "estimated to match nearly every record");
+
+	// b = 's010' AND c < 30: each index alone matched too many scattered records
+	MAKE_ATTRREF(left, 1);
+	MAKE_CONS(right, stringToValue("ss010"));
+	MAKE_BINOP_EXPR(byName, left, right, OP_COMP_EQUAL);
+	MAKE_ATTRREF(left, 2);
+	MAKE_CONS(right, stringToValue("f30"));
+	MAKE_BINOP_EXPR(fewC, left, right, OP_COMP_SMALLER);
+	MAKE_BINOP_EXPR(both, byName, fewC, OP_BOOL_AND);
+	ASSERT_EQUALS_INT(nBoth, countPlanned(table, both, &plan), "records with b = 's010' and c < 30");
+	ASSERT_EQUALS_INT(RM_PATH_INTERSECT, plan.path, "intersected the RIDs of both indexes");
+	ASSERT_TRUE(plan.estRows > 0 && plan.estRows < 100, "estimated from both terms");
+
+	// snapshots read the pages, whatever the indexes offered
+	TEST_CHECK(beginSnapshot(&snap));
+	sumSnapshot(table, &snap, point, &count, &bad);
+	ASSERT_EQUALS_INT(nPoint, count, "snapshot scan found the same records");
+	TEST_CHECK(endSnapshot(&snap));
+
+	freeExpr(point);
+	freeExpr(prefix);
+	freeExpr(all);
+	freeExpr(both);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_path"));
+	TEST_CHECK(shutdownRecordManager());
+	free(table);
+
+	TEST_DONE();
+}
+
+void
+testBulkLoad (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableOptions options;
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	Schema *schema;
+	Record *r;
+	Expr *byA, *left, *right;
+	FILE *f;
+	const char *b;
+	char name[8];
+	unsigned short len;
+	float c;
+	int i, rc, count, ordered, prev, sum, indexed[] = { 0 };
+	testName = "test bulk loading from CSV and binary files";
+
+	// a = i, b = "k<i % 50>", c = i + 0.5; two rows with quoting, one empty line
+	f = fopen("test_load.csv", "w");
+	for(i = 0; i < 20000; i++)
+	{
+		if (i == 100)
+			fprintf(f, "100,\"x,\"\"y\",100.5\r\n");
+		else if (i == 200)
+			fprintf(f, "200,\"a\nb\",200.5\n\n");
+		else
+			fprintf(f, "%d,k%02d,%d.5\n", i, i % 50, i);
+	}
+	fclose(f);
+
+	schema = testSchema();
+	initTableOptions(&options);
+	options.numZoneAttrs = 1;
+	options.zoneAttrs = indexed;
+	options.numIndexes = 1;
+	options.indexAttrs = indexed;
+	TEST_CHECK(initRecordManager(NULL));
+	TEST_CHECK(createTableWithOptions("test_table_load", schema, &options));
+	TEST_CHECK(openTable(table, "test_table_load"));
+	freeSchema(schema);
+	schema = table->schema;
+
+	rc = loadTableFromFile(table, "no_such_file.csv", RM_LOAD_CSV);
+	ASSERT_EQUALS_INT(RC_FILE_NOT_FOUND, rc, "missing file");
+	TEST_CHECK(loadTableFromFile(table, "test_load.csv", RM_LOAD_CSV));
+	ASSERT_EQUALS_INT(20000, getNumTuples(table), "every row loaded");
+
+	// the rows went in in file order, with their values intact
+	TEST_CHECK(createRecord(&r, schema));
+	TEST_CHECK(startScan(table, sc, NULL));
+	count = sum = 0;
+	ordered = 1;
+	prev = -1;
+	while((rc = next(sc, r)) == RC_OK)
+	{
+		i = getIntAttr(r, schema, 0);
+		if (i <= prev || getFloatAttr(r, schema, 2) != i + 0.5f)
+			ordered = 0;
+		prev = i;
+		sum += i;
+		count++;
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+	ASSERT_EQUALS_INT(20000, count, "rows scanned");
+	ASSERT_EQUALS_INT(199990000, sum, "sum of a");
+	ASSERT_TRUE(ordered, "rows in file order, c parsed");
+	TEST_CHECK(closeScan(sc));
+
+	// the index was filled too, and quoted fields were unquoted
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i100"));
+	MAKE_BINOP_EXPR(byA, left, right, OP_COMP_EQUAL);
+	TEST_CHECK(startScan(table, sc, byA));
+	TEST_CHECK(next(sc, r));
+	b = getStringAttr(r, schema, 1, &i);
+	ASSERT_TRUE(i == 4 && memcmp(b, "x,\"y", 4) == 0, "quoted comma and quote");
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, next(sc, r), "a = 100 once");
+	TEST_CHECK(closeScan(sc));
+	freeExpr(byA);
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i200"));
+	MAKE_BINOP_EXPR(byA, left, right, OP_COMP_EQUAL);
+	TEST_CHECK(startScan(table, sc, byA));
+	TEST_CHECK(next(sc, r));
+	b = getStringAttr(r, schema, 1, &i);
+	ASSERT_TRUE(i == 3 && memcmp(b, "a\nb", 3) == 0, "quoted line break");
+	TEST_CHECK(closeScan(sc));
+	freeExpr(byA);
+
+	// a bad row stopped the load after the rows before it
+	f = fopen("test_load.csv", "w");
+	fprintf(f, "1,ab,1.0\n2,cd,2.0\n3,cd,3.0x\n4,ef,4.0\n");
+	fclose(f);
+	rc = loadTableFromFile(table, "test_load.csv", RM_LOAD_CSV);
+	ASSERT_EQUALS_INT(RC_RM_BAD_ROW, rc, "malformed float");
+	ASSERT_EQUALS_INT(20002, getNumTuples(table), "rows before the bad one loaded");
+	f = fopen("test_load.csv", "w");
+	fprintf(f, "5,ab,1.0\n6,cd\n");
+	fclose(f);
+	rc = loadTableFromFile(table, "test_load.csv", RM_LOAD_CSV);
+	ASSERT_EQUALS_INT(RC_RM_BAD_ROW, rc, "missing field");
+	ASSERT_EQUALS_INT(20003, getNumTuples(table), "one more row loaded");
+	freeRecord(r);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_load"));
+
+	// binary rows into a PAX table
+	f = fopen("test_load.bin", "wb");
+	for(i = 0; i < 5000; i++)
+	{
+		sprintf(name, "b%d", i % 7);
+		len = (unsigned short) strlen(name);
+		c = i;
+		fwrite(&i, sizeof(int), 1, f);
+		fwrite(&len, sizeof(len), 1, f);
+		fwrite(name, 1, len, f);
+		fwrite(&c, sizeof(float), 1, f);
+	}
+	fclose(f);
+	schema = testSchema();
+	initTableOptions(&options);
+	options.layout = RM_LAYOUT_PAX;
+	TEST_CHECK(createTableWithOptions("test_table_load", schema, &options));
+	TEST_CHECK(openTable(table, "test_table_load"));
+	freeSchema(schema);
+	schema = table->schema;
+	TEST_CHECK(loadTableFromFile(table, "test_load.bin", RM_LOAD_BINARY));
+	ASSERT_EQUALS_INT(5000, getNumTuples(table), "every binary row loaded");
+	TEST_CHECK(createRecord(&r, schema));
+	TEST_CHECK(startScan(table, sc, NULL));
+	count = 0;
+	while((rc = next(sc, r)) == RC_OK)
+	{
+		i = getIntAttr(r, schema, 0);
+		sprintf(name, "b%d", i % 7);
+		b = getStringAttr(r, schema, 1, &prev);
+		if (getFloatAttr(r, schema, 2) == (float) i && prev == (int) strlen(name) && memcmp(b, name, prev) == 0)
+			count++;
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+	ASSERT_EQUALS_INT(5000, count, "binary rows read back");
+	TEST_CHECK(closeScan(sc));
+	freeRecord(r);
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_load"));
+	TEST_CHECK(shutdownRecordManager());
+	remove("test_load.csv");
+	remove("test_load.bin");
+	free(table);
+	free(sc);
+
+	TEST_DONE();
+}
+
+void
+testSerializers (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	Schema *schema;
+	Record *r;
+	FILE *f;
+	char buf[64], *text, *streamed;
+	int i, len;
+	long size;
+	testName = "test streaming serializers";
+
+	TEST_CHECK(initRecordManager(NULL));
+	schema = testSchema();
+	TEST_CHECK(createTable("test_table_ser", schema));
+	TEST_CHECK(openTable(table, "test_table_ser"));
+	freeSchema(schema);
+	schema = table->schema;
+
+	for(i = 0; i < 2000; i++)
+	{
+		sprintf(buf, "v%d", i % 100);
+		r = testRecord(schema, i, buf, i + 0.5);
+		TEST_CHECK(insertRecord(table, r));
+		freeRecord(r);
+	}
+
+	// serializeRecordInto matched serializeRecord, and told how much was cut
+	r = testRecord(schema, 7, "ab", 1.5);
+	r->id.page = 1;
+	r->id.slot = 0;
+	text = serializeRecord(r, schema);
+	ASSERT_EQUALS_STRING("[1-0] (a:7b:ab,c:1.500000,)", text, "record text as before");
+	len = serializeRecordInto(buf, sizeof(buf), r, schema);
+	ASSERT_EQUALS_INT((int) strlen(text), len, "length of the record text");
+	ASSERT_EQUALS_STRING(text, buf, "same text in the caller's buffer");
+	len = serializeRecordInto(buf, 8, r, schema);
+	ASSERT_EQUALS_INT((int) strlen(text), len, "full length when cut short");
+	ASSERT_EQUALS_STRING("[1-0] (", buf, "cut at the buffer size");
+	len = serializeAttrInto(buf, sizeof(buf), r, schema, 1);
+	ASSERT_TRUE(len == 4 && strcmp(buf, "b:ab") == 0, "one attribute");
+	free(text);
+	freeRecord(r);
+
+	// writeTableContent wrote what serializeTableContent returned
+	text = serializeTableContent(table);
+	f = tmpfile();
+	TEST_CHECK(writeTableContent(table, f));
+	size = ftell(f);
+	ASSERT_EQUALS_INT((int) strlen(text), (int) size, "length of the table dump");
+	streamed = (char *) malloc(size + 1);
+	rewind(f);
+	ASSERT_TRUE(fread(streamed, 1, size, f) == (size_t) size, "read the dump back");
+	streamed[size] = '\0';
+	fclose(f);
+	ASSERT_TRUE(strcmp(text, streamed) == 0, "same table dump");
+	free(text);
+	free(streamed);
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_ser"));
+	TEST_CHECK(shutdownRecordManager());
+	free(table);
+
+	TEST_DONE();
+}
+
+void
+testColumnarExport (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RM_ColumnFile cf;
+	RM_ColumnScan cs;
+	Schema *schema;
+	Record *r;
+	Expr *cond, *left, *right;
+	FILE *f;
+	char name[8], *text;
+	const char *b;
+	int i, rc, count, sum, bad, len, onlyB[] = { 1 };
+	long size;
+	testName = "test columnar export and its reader";
+
+	TEST_CHECK(initRecordManager(NULL));
+	schema = testSchema();
+	TEST_CHECK(createTable("test_table_exp", schema));
+	TEST_CHECK(openTable(table, "test_table_exp"));
+	freeSchema(schema);
+	schema = table->schema;
+
+	// a = i, b = "s<i % 5>" (a dictionary), c = i / 1000 (long runs)
+	for(i = 0; i < 10000; i++)
+	{
+		sprintf(name, "s%d", i % 5);
+		r = testRecord(schema, i, name, i / 1000);
+		TEST_CHECK(insertRecord(table, r));
+		freeRecord(r);
+	}
+
+	TEST_CHECK(exportTable(table, "test_export.col"));
+	f = fopen("test_export.col", "rb");
+	fseek(f, 0, SEEK_END);
+	size = ftell(f);
+	fclose(f);
+	text = serializeTableContent(table);
+	ASSERT_TRUE(size * 5 < (long) strlen(text), "a fifth of the text dump or less");
+	free(text);
+
+	// the file described itself
+	TEST_CHECK(openColumnFile(&cf, "test_export.col"));
+	ASSERT_EQUALS_INT(10000, cf.numRows, "rows in the file");
+	ASSERT_EQUALS_INT(3, cf.numRowGroups, "row groups");
+	ASSERT_EQUALS_INT(3, cf.schema->numAttr, "attributes");
+	ASSERT_TRUE(cf.schema->dataTypes[1] == DT_STRING && cf.schema->typeLength[1] == 4, "type of b");
+	ASSERT_EQUALS_STRING("b", cf.schema->attrNames[1], "name of b");
+
+	// every record came back in order
+	TEST_CHECK(createRecord(&r, cf.schema));
+	TEST_CHECK(startColumnScan(&cf, 0, NULL, NULL, &cs));
+	count = sum = bad = 0;
+	while((rc = nextColumnRecord(&cs, r)) == RC_OK)
+	{
+		i = getIntAttr(r, cf.schema, 0);
+		sprintf(name, "s%d", i % 5);
+		b = getStringAttr(r, cf.schema, 1, &len);
+		if (i != count || len != 2 || memcmp(b, name, 2) != 0 || getFloatAttr(r, cf.schema, 2) != i / 1000)
+			bad++;
+		sum += i;
+		count++;
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+	ASSERT_EQUALS_INT(10000, count, "records read back");
+	ASSERT_EQUALS_INT(0, bad, "with their values");
+	ASSERT_EQUALS_INT(49995000, sum, "sum of a");
+	TEST_CHECK(closeColumnScan(&cs));
+
+	// a < 1000, returning only b: the other row groups were skipped
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i1000"));
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_SMALLER);
+	TEST_CHECK(startColumnScan(&cf, 1, onlyB, cond, &cs));
+	count = bad = 0;
+	while((rc = nextColumnRecord(&cs, r)) == RC_OK)
+	{
+		getStringAttr(r, cf.schema, 1, &len);
+		if (len != 2 || getFloatAttr(r, cf.schema, 2) != 0)
+			bad++;
+		count++;
+	}
+	ASSERT_EQUALS_INT(1000, count, "records with a < 1000");
+	ASSERT_EQUALS_INT(0, bad, "b filled in, c left out");
+	ASSERT_EQUALS_INT(1, cs.rowGroupsRead, "one row group read");
+	TEST_CHECK(closeColumnScan(&cs));
+	freeRecord(r);
+	TEST_CHECK(closeColumnFile(&cf));
+
+	// the output of a scan with a condition
+	MAKE_UNOP_EXPR(left, cond, OP_BOOL_NOT);
+	TEST_CHECK(startScan(table, sc, left));
+	TEST_CHECK(exportScan(sc, "test_export.col"));
+	TEST_CHECK(closeScan(sc));
+	TEST_CHECK(openColumnFile(&cf, "test_export.col"));
+	ASSERT_EQUALS_INT(9000, cf.numRows, "records with a >= 1000");
+	TEST_CHECK(closeColumnFile(&cf));
+	freeExpr(left);
+
+	// anything else was refused
+	f = fopen("test_export.col", "wb");
+	fprintf(f, "a, b, c\n");
+	fclose(f);
+	rc = openColumnFile(&cf, "test_export.col");
+	ASSERT_EQUALS_INT(RC_RM_BAD_EXPORT_FILE, rc, "not an export file");
+
+	remove("test_export.col");
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_exp"));
+	TEST_CHECK(shutdownRecordManager());
+	free(table);
+	free(sc);
+
+	TEST_DONE();
+}
+
+void
+testDictionaryEncoding (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableData *plain = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RM_TableOptions options;
+	Schema *schema;
+	Record *r;
+	Expr *cond, *left, *right, *other, *both;
+	char text[48];
+	const char *view;
+	int i, rc, len, count, updated, textAttr[] = { 1 }, idAttr[] = { 0 };
+	testName = "test dictionary-encoded string attributes";
+
+	TEST_CHECK(initRecordManager(NULL));
+	schema = varcharSchema(40);
+
+	// only strings of row tables could be encoded
+	initTableOptions(&options);
+	options.numDictAttrs = 1;
+	options.dictAttrs = idAttr;
+	rc = createTableWithOptions("test_table_dict", schema, &options);
+	ASSERT_EQUALS_INT(RC_RM_BAD_DICT_ATTR, rc, "int attribute refused");
+	options.dictAttrs = textAttr;
+	options.layout = RM_LAYOUT_PAX;
+	rc = createTableWithOptions("test_table_dict", schema, &options);
+	ASSERT_EQUALS_INT(RC_RM_BAD_DICT_ATTR, rc, "PAX table refused");
+	options.layout = RM_LAYOUT_ROW;
+
+	// the same 6000 records, with four distinct texts, with and without a dictionary
+	TEST_CHECK(createTableWithOptions("test_table_dict", schema, &options));
+	TEST_CHECK(createTable("test_table_plain", schema));
+	freeSchema(schema);
+	TEST_CHECK(openTable(table, "test_table_dict"));
+	TEST_CHECK(openTable(plain, "test_table_plain"));
+	schema = table->schema;
+	for(i = 0; i < 6000; i++)
+	{
+		sprintf(text, "category number %d of the catalogue", i % 4);
+		r = textRecord(schema, i, text);
+		TEST_CHECK(insertRecord(table, r));
+		TEST_CHECK(insertRecord(plain, r));
+		freeRecord(r);
+	}
+	TEST_CHECK(closeTable(plain));
+	ASSERT_TRUE(filePages("test_table_dict") * 3 < filePages("test_table_plain"), "a third of the pages or less");
+	TEST_CHECK(deleteTable("test_table_plain"));
+
+	// records read back with their strings
+	TEST_CHECK(createRecord(&r, schema));
+	r->id.page = 2;
+	r->id.slot = 5;
+	TEST_CHECK(getRecord(table, r->id, r));
+	sprintf(text, "category number %d of the catalogue", getIntAttr(r, schema, 0) % 4);
+	view = getStringAttr(r, schema, 1, &len);
+	ASSERT_TRUE(len == (int) strlen(text) && memcmp(view, text, len) == 0, "text decoded");
+
+	// equality, IN (an OR of equalities), and a value the dictionary did not hold
+	MAKE_ATTRREF(left, 1);
+	MAKE_CONS(right, stringToValue("scategory number 2 of the catalogue"));
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_EQUAL);
+	ASSERT_EQUALS_INT(1500, countMatches(table, cond), "text = one value");
+	MAKE_ATTRREF(left, 1);
+	MAKE_CONS(right, stringToValue("scategory number 3 of the catalogue"));
+	MAKE_BINOP_EXPR(other, left, right, OP_COMP_EQUAL);
+	MAKE_BINOP_EXPR(both, cond, other, OP_BOOL_OR);
+	ASSERT_EQUALS_INT(3000, countMatches(table, both), "text in two values");
+	MAKE_ATTRREF(left, 1);
+	MAKE_CONS(right, stringToValue("scategory number 9 of the catalogue"));
+	MAKE_BINOP_EXPR(other, left, right, OP_COMP_EQUAL);
+	ASSERT_EQUALS_INT(0, countMatches(table, other), "value not in the dictionary");
+	freeExpr(other);
+
+	// combined with a term the codes could not decide
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i1000"));
+	MAKE_BINOP_EXPR(other, left, right, OP_COMP_SMALLER);
+	MAKE_BINOP_EXPR(cond, both, other, OP_BOOL_AND);
+	ASSERT_EQUALS_INT(500, countMatches(table, cond), "text in two values and id < 1000");
+	freeExpr(cond);
+
+	// an update to a new value got a new code
+	TEST_CHECK(getRecord(table, r->id, r));
+	updated = getIntAttr(r, schema, 0);
+	freeRecord(r);
+	r = textRecord(schema, 123456, "a brand new category");
+	r->id.page = 2;
+	r->id.slot = 5;
+	TEST_CHECK(updateRecord(table, r));
+	freeRecord(r);
+
+	// the dictionary came back with the table
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(openTable(table, "test_table_dict"));
+	schema = table->schema;
+	r = textRecord(schema, 6000, "category number 1 of the catalogue");
+	TEST_CHECK(insertRecord(table, r));
+	freeRecord(r);
+	MAKE_ATTRREF(left, 1);
+	MAKE_CONS(right, stringToValue("sa brand new category"));
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_EQUAL);
+	ASSERT_EQUALS_INT(1, countMatches(table, cond), "updated value after reopening");
+	freeExpr(cond);
+	MAKE_ATTRREF(left, 1);
+	MAKE_CONS(right, stringToValue("scategory number 1 of the catalogue"));
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_EQUAL);
+	count = (updated % 4 == 1) ? 1500 : 1501;
+	ASSERT_EQUALS_INT(count, countMatches(table, cond), "old and new records share the code");
+
+	// vacuum after deleting the even ids (6000 among them) kept the dictionary pages
+	TEST_CHECK(createRecord(&r, schema));
+	TEST_CHECK(startScan(table, sc, NULL));
+	while((rc = next(sc, r)) == RC_OK)
+		if (getIntAttr(r, schema, 0) % 2 == 0)
+			TEST_CHECK(deleteRecord(table, r->id));
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+	TEST_CHECK(closeScan(sc));
+	freeRecord(r);
+	TEST_CHECK(vacuumTable(table));
+	ASSERT_EQUALS_INT(count - 1, countMatches(table, cond), "odd ids left after vacuum");
+	freeExpr(cond);
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_dict"));
+	TEST_CHECK(shutdownRecordManager());
+	free(table);
+	free(plain);
+	free(sc);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testPageCompression (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableData *plain = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RM_TableOptions options;
+	SM_FileHandle fh;
+	SM_Codec codec;
+	Schema *schema;
+	Record *r;
+	char text[48], page[PAGE_SIZE], back[PAGE_SIZE];
+	const char *view;
+	long compressedBytes, plainBytes;
+	int i, rc, len;
+	testName = "test compressed page files";
+
+	TEST_CHECK(initRecordManager(NULL));
+	schema = varcharSchema(40);
+
+	// the same 6000 records in a compressed and a plain table
+	initTableOptions(&options);
+	options.codec = SM_CODEC_LZ;
+	TEST_CHECK(createTableWithOptions("test_table_lz", schema, &options));
+	TEST_CHECK(createTable("test_table_plain", schema));
+	freeSchema(schema);
+	TEST_CHECK(getPageFileCodec("test_table_lz", &codec));
+	ASSERT_EQUALS_INT(SM_CODEC_LZ, codec, "codec of the compressed file");
+	TEST_CHECK(getPageFileCodec("test_table_plain", &codec));
+	ASSERT_EQUALS_INT(SM_CODEC_NONE, codec, "codec of the plain file");
+
+	TEST_CHECK(openTable(table, "test_table_lz"));
+	TEST_CHECK(openTable(plain, "test_table_plain"));
+	schema = table->schema;
+	for(i = 0; i < 6000; i++)
+	{
+		sprintf(text, "customer %d of region %d", i, i % 7);
+		r = textRecord(schema, i, text);
+		TEST_CHECK(insertRecord(table, r));
+		TEST_CHECK(insertRecord(plain, r));
+		freeRecord(r);
+	}
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(closeTable(plain));
+	ASSERT_EQUALS_INT(filePages("test_table_plain"), filePages("test_table_lz"), "same number of pages");
+	compressedBytes = fileBytes("test_table_lz");
+	plainBytes = fileBytes("test_table_plain");
+	ASSERT_TRUE(compressedBytes * 5 < plainBytes * 2, "under 40% of the bytes");
+	TEST_CHECK(deleteTable("test_table_plain"));
+
+	// records read back after reopening
+	TEST_CHECK(openTable(table, "test_table_lz"));
+	schema = table->schema;
+	ASSERT_EQUALS_INT(6000, countMatches(table, NULL), "every record");
+	TEST_CHECK(createRecord(&r, schema));
+	r->id.page = 3;
+	r->id.slot = 7;
+	TEST_CHECK(getRecord(table, r->id, r));
+	i = getIntAttr(r, schema, 0);
+	sprintf(text, "customer %d of region %d", i, i % 7);
+	view = getStringAttr(r, schema, 1, &len);
+	ASSERT_TRUE(len == (int) strlen(text) && memcmp(view, text, len) == 0, "text read back");
+
+	// vacuum after deleting most records gave the space back
+	TEST_CHECK(startScan(table, sc, NULL));
+	while((rc = next(sc, r)) == RC_OK)
+		if (getIntAttr(r, schema, 0) >= 1000)
+			TEST_CHECK(deleteRecord(table, r->id));
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+	TEST_CHECK(closeScan(sc));
+	freeRecord(r);
+	TEST_CHECK(vacuumTable(table));
+	ASSERT_EQUALS_INT(1000, countMatches(table, NULL), "records left after vacuum");
+	TEST_CHECK(closeTable(table));
+	ASSERT_TRUE(fileBytes("test_table_lz") < compressedBytes, "vacuum shrank the file");
+	TEST_CHECK(openTable(table, "test_table_lz"));
+	ASSERT_EQUALS_INT(1000, countMatches(table, NULL), "records left after reopening");
+	TEST_CHECK(closeTable(table));
+
+	// a page that grew moved, and a file that was not closed was walked
+	for(i = 0; i < PAGE_SIZE; i++)
+		page[i] = (char) (rand() % 256);
+	TEST_CHECK(openPageFile("test_table_lz", &fh));
+	TEST_CHECK(ensureCapacity(fh.totalNumPages + 2, &fh));
+	TEST_CHECK(writeBlock(fh.totalNumPages - 1, &fh, page));
+	TEST_CHECK(writeBlock(1, &fh, page));
+	TEST_CHECK(syncPageFile(&fh));
+	copyFile("test_table_lz", "test_table_lz.crash");
+	TEST_CHECK(closePageFile(&fh));
+	copyFile("test_table_lz.crash", "test_table_lz");
+	remove("test_table_lz.crash");
+	TEST_CHECK(openPageFile("test_table_lz", &fh));
+	TEST_CHECK(readBlock(1, &fh, back));
+	ASSERT_TRUE(memcmp(page, back, PAGE_SIZE) == 0, "moved page after the walk");
+	TEST_CHECK(readBlock(fh.totalNumPages - 1, &fh, back));
+	ASSERT_TRUE(memcmp(page, back, PAGE_SIZE) == 0, "new page after the walk");
+	TEST_CHECK(readBlock(fh.totalNumPages - 2, &fh, back));
+	ASSERT_TRUE(back[0] == 0 && memcmp(back, back + 1, PAGE_SIZE - 1) == 0, "unwritten page read as zeros");
+	TEST_CHECK(closePageFile(&fh));
+
+	TEST_CHECK(deleteTable("test_table_lz"));
+	TEST_CHECK(shutdownRecordManager());
+	free(table);
+	free(plain);
+	free(sc);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testPartitionedTables (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableOptions options;
+	RM_ScanPlan plan;
+	Schema *schema;
+	Record *r;
+	Expr *cond, *left, *right;
+	Value *bounds[3], *bound;
+	RID rids[3000], kept, dropped;
+	pthread_t threads[3];
+	void *counted;
+	char *recData, key[8];
+	int parts[4], numParts, i, rc, total;
+	testName = "test hash and range partitioned tables";
+
+	TEST_CHECK(initRecordManager(NULL));
+	schema = testSchema();
+
+	// hash partitions on the string attribute
+	initTableOptions(&options);
+	options.partScheme = RM_PART_HASH;
+	options.partAttr = 1;
+	options.numParts = 4;
+	TEST_CHECK(createTableWithOptions("test_table_hash", schema, &options));
+	TEST_CHECK(openTable(table, "test_table_hash"));
+	ASSERT_EQUALS_INT(4, getNumPartitions(table), "hash partitions");
+	ASSERT_TRUE(access("test_table_hash.p3", F_OK) == 0, "page file of a partition");
+	for(i = 0; i < 400; i++)
+	{
+		sprintf(key, "k%02d", i % 20);
+		r = testRecord(table->schema, i, key, i);
+		TEST_CHECK(insertRecord(table, r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+	ASSERT_EQUALS_INT(400, getNumTuples(table), "tuples in all partitions");
+	for(i = 0, total = 0; i < 20; i++)
+		total += (RM_PART_RID_ID(rids[i]) != RM_PART_RID_ID(rids[0]));
+	ASSERT_TRUE(total > 0, "keys spread over the partitions");
+
+	MAKE_ATTRREF(left, 1);
+	MAKE_CONS(right, stringToValue("sk07"));
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_EQUAL);
+	ASSERT_EQUALS_INT(20, countMatches(table, cond), "records of one key");
+	TEST_CHECK(explainScan(table, cond, &plan));
+	ASSERT_TRUE(strncmp(plan.text, "partitions 1 of 4", 17) == 0, "equality read one partition");
+	freeExpr(cond);
+
+	// RIDs led back to their partition; a record could not change partitions
+	TEST_CHECK(createRecord(&r, table->schema));
+	TEST_CHECK(getRecord(table, rids[123], r));
+	ASSERT_EQUALS_INT(123, getIntAttr(r, table->schema, 0), "record read by RID");
+	ASSERT_TRUE(r->id.page == rids[123].page && r->id.slot == rids[123].slot, "RID kept");
+	freeRecord(r);
+	r = testRecord(table->schema, -123, "k03", 0);
+	r->id = rids[123];
+	TEST_CHECK(updateRecord(table, r));
+	freeRecord(r);
+	for(i = 0, rc = RC_OK; i < 20 && rc == RC_OK; i++)
+	{
+		sprintf(key, "k%02d", i);
+		r = testRecord(table->schema, 123, key, 0);
+		r->id = rids[123];
+		rc = updateRecord(table, r);
+		freeRecord(r);
+	}
+	ASSERT_EQUALS_INT(RC_RM_BAD_PARTITION, rc, "update to a key of another partition");
+	TEST_CHECK(deleteRecord(table, rids[0]));
+	ASSERT_EQUALS_INT(399, getNumTuples(table), "tuples after a delete");
+	ASSERT_EQUALS_INT(RC_RM_BAD_PARTITION, addPartition(table, NULL), "hash partitions were fixed");
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_hash"));
+	ASSERT_TRUE(access("test_table_hash.p3", F_OK) != 0, "partitions deleted with the table");
+
+	// range partitions on the int attribute: [.., 1000), [1000, 2000), [2000, 3000)
+	options.partScheme = RM_PART_RANGE;
+	options.partAttr = 1;
+	options.numParts = 3;
+	for(i = 0; i < 3; i++)
+		MAKE_VALUE(bounds[i], DT_INT, (i + 1) * 1000);
+	options.partBounds = bounds;
+	ASSERT_EQUALS_INT(RC_RM_BAD_PARTITION, createTableWithOptions("test_table_range", schema, &options),
+			"range keys were numbers");
+	options.partAttr = 0;
+	TEST_CHECK(createTableWithOptions("test_table_range", schema, &options));
+	for(i = 0; i < 3; i++)
+		freeVal(bounds[i]);
+	TEST_CHECK(openTable(table, "test_table_range"));
+
+	recData = (char *) malloc(3000 * getRecordSize(table->schema));
+	for(i = 0; i < 3000; i++)
+	{
+		r = testRecord(table->schema, i, "ab", i);
+		memcpy(recData + i * getRecordSize(table->schema), r->data, getRecordSize(table->schema));
+		freeRecord(r);
+	}
+	TEST_CHECK(insertRecords(table, recData, 3000, rids));
+	free(recData);
+	kept = rids[2500];
+	dropped = rids[500];
+	r = testRecord(table->schema, 3500, "ab", 0);
+	ASSERT_EQUALS_INT(RC_RM_NO_PARTITION, insertRecord(table, r), "key above every partition");
+
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i1500"));
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_SMALLER);
+	ASSERT_EQUALS_INT(1500, countMatches(table, cond), "records below 1500");
+	TEST_CHECK(explainScan(table, cond, &plan));
+	ASSERT_TRUE(strncmp(plan.text, "partitions 2 of 3", 17) == 0, "range condition pruned");
+	TEST_CHECK(getScanPartitions(table, cond, parts, &numParts));
+	ASSERT_EQUALS_INT(2, numParts, "partitions to scan");
+	freeExpr(cond);
+
+	// a thread per partition
+	sharedTable = table;
+	TEST_CHECK(getScanPartitions(table, NULL, parts, &numParts));
+	ASSERT_EQUALS_INT(3, numParts, "partitions of a full scan");
+	for(i = 0; i < numParts; i++)
+		pthread_create(&threads[i], NULL, scanPartition, (void *) (long) parts[i]);
+	for(i = 0, total = 0; i < numParts; i++)
+	{
+		pthread_join(threads[i], &counted);
+		total += (int) (long) counted;
+	}
+	ASSERT_EQUALS_INT(3000, total, "records of the parallel scans");
+
+	// retention: a partition added on top and the oldest one dropped
+	MAKE_VALUE(bound, DT_INT, 3000);
+	ASSERT_EQUALS_INT(RC_RM_BAD_PARTITION, addPartition(table, bound), "bound not above the last");
+	freeVal(bound);
+	MAKE_VALUE(bound, DT_INT, 4000);
+	TEST_CHECK(addPartition(table, bound));
+	freeVal(bound);
+	TEST_CHECK(insertRecord(table, r));
+	freeRecord(r);
+	TEST_CHECK(dropPartition(table, 0));
+	ASSERT_EQUALS_INT(3, getNumPartitions(table), "partitions after add and drop");
+	ASSERT_EQUALS_INT(2001, getNumTuples(table), "tuples after the drop");
+	ASSERT_TRUE(access("test_table_range.p0", F_OK) != 0, "dropped partition's file deleted");
+	r = testRecord(table->schema, 10, "ab", 0);
+	ASSERT_EQUALS_INT(RC_RM_NO_PARTITION, insertRecord(table, r), "key of the dropped range");
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, getRecord(table, dropped, r), "RID in the dropped partition");
+	TEST_CHECK(getRecord(table, kept, r));
+	ASSERT_EQUALS_INT(2500, getIntAttr(r, table->schema, 0), "RID of another partition still valid");
+	TEST_CHECK(closeTable(table));
+
+	// the partition list after reopening
+	TEST_CHECK(openTable(table, "test_table_range"));
+	ASSERT_EQUALS_INT(3, getNumPartitions(table), "partitions after reopening");
+	ASSERT_EQUALS_INT(2001, countMatches(table, NULL), "records after reopening");
+	TEST_CHECK(getRecord(table, kept, r));
+	ASSERT_EQUALS_INT(2500, getIntAttr(r, table->schema, 0), "RID after reopening");
+	freeRecord(r);
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_range"));
+	ASSERT_TRUE(access("test_table_range.p3", F_OK) != 0, "added partition deleted with the table");
+
+	TEST_CHECK(shutdownRecordManager());
+	freeSchema(schema);
+	free(table);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testInMemoryTables (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RM_TableOptions options;
+	RM_Snapshot snap;
+	RM_ScanPlan plan;
+	Schema *schema;
+	Record *r;
+	Expr *cond, *left, *right;
+	RID rids[5000];
+	char key[8];
+	int indexAttrs[] = { 0 };
+	int dictAttrs[] = { 1 };
+	int i, rc;
+	testName = "test in-memory tables";
+
+	TEST_CHECK(initRecordManager(NULL));
+	schema = testSchema();
+
+	// no page file for the table, only for its index
+	initTableOptions(&options);
+	options.inMemory = true;
+	options.numIndexes = 1;
+	options.indexAttrs = indexAttrs;
+	options.numDictAttrs = 1;
+	options.dictAttrs = dictAttrs;
+	TEST_CHECK(createTableWithOptions("test_table_mem", schema, &options));
+	freeSchema(schema);
+	ASSERT_TRUE(access("test_table_mem", F_OK) != 0, "no page file");
+	TEST_CHECK(openTable(table, "test_table_mem"));
+	schema = table->schema;
+	ASSERT_TRUE(getTableIndex(table, 0) != NULL, "index opened");
+
+	for(i = 0; i < 5000; i++)
+	{
+		sprintf(key, "k%02d", i % 10);
+		r = testRecord(schema, i, key, i);
+		TEST_CHECK(insertRecord(table, r));
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+	ASSERT_EQUALS_INT(5000, getNumTuples(table), "tuples inserted");
+	ASSERT_TRUE(rids[4999].page > 1, "records on several pages");
+
+	MAKE_ATTRREF(left, 1);
+	MAKE_CONS(right, stringToValue("sk03"));
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_EQUAL);
+	ASSERT_EQUALS_INT(500, countMatches(table, cond), "dictionary term");
+	freeExpr(cond);
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i42"));
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_EQUAL);
+	TEST_CHECK(explainScan(table, cond, &plan));
+	ASSERT_EQUALS_INT(RM_PATH_INDEX, plan.path, "index scan");
+	ASSERT_EQUALS_INT(1, countMatches(table, cond), "record found by the index");
+	freeExpr(cond);
+
+	// updates, deletes and snapshot reads by RID
+	TEST_CHECK(beginSnapshot(&snap));
+	r = testRecord(schema, 7, "new", -7);
+	r->id = rids[7];
+	TEST_CHECK(updateRecord(table, r));
+	TEST_CHECK(getRecord(table, rids[7], r));
+	ASSERT_TRUE(getFloatAttr(r, schema, 2) == -7, "record updated");
+	TEST_CHECK(getRecordAsOf(table, rids[7], r, &snap));
+	ASSERT_TRUE(getFloatAttr(r, schema, 2) == 7, "snapshot saw the old version");
+	TEST_CHECK(endSnapshot(&snap));
+	for(i = 1000; i < 5000; i++)
+		TEST_CHECK(deleteRecord(table, rids[i]));
+	rc = getRecord(table, rids[1000], r);
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "deleted record gone");
+	freeRecord(r);
+
+	// logging and commits had nothing to do
+	TEST_CHECK(commitTable(table));
+	TEST_CHECK(closeTable(table));
+
+	// the arena outlived the handle, and vacuum gave chunks back
+	TEST_CHECK(openTable(table, "test_table_mem"));
+	schema = table->schema;
+	ASSERT_EQUALS_INT(1000, countMatches(table, NULL), "records after reopening");
+	TEST_CHECK(vacuumTable(table));
+	ASSERT_EQUALS_INT(1000, countMatches(table, NULL), "records after vacuum");
+	TEST_CHECK(createRecord(&r, schema));
+	TEST_CHECK(startScan(table, sc, NULL));
+	while((rc = next(sc, r)) == RC_OK)
+		ASSERT_TRUE(r->id.page <= rids[999].page, "records moved to the front");
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+	TEST_CHECK(closeScan(sc));
+	freeRecord(r);
+	TEST_CHECK(closeTable(table));
+
+	TEST_CHECK(deleteTable("test_table_mem"));
+	ASSERT_TRUE(openTable(table, "test_table_mem") != RC_OK, "arena freed by deleteTable");
+
+	TEST_CHECK(shutdownRecordManager());
+	free(table);
+	free(sc);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testLargeObjects (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableOptions options;
+	RM_BlobHandle blob;
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RM_SortHandle sort;
+	RM_AggrHandle aggr;
+	RM_SortKey byBlob[] = { { 1, 0 } };
+	Schema *schema;
+	Record *r;
+	Value *value;
+	char buf[10000];
+	int indexAttrs[] = { 1 };
+	int big = 5 * 1024 * 1024 + 123;
+	int id, id2, n, pages, rc;
+	long long total;
+	bool same;
+	testName = "test large objects";
+
+	TEST_CHECK(initRecordManager(NULL));
+	schema = blobSchema();
+
+	// large objects said nothing about their contents, so they were not indexed
+	initTableOptions(&options);
+	options.numIndexes = 1;
+	options.indexAttrs = indexAttrs;
+	rc = createTableWithOptions("test_table_blob", schema, &options);
+	ASSERT_EQUALS_INT(RC_RM_BAD_BLOB_ATTR, rc, "no index on a large object");
+
+	TEST_CHECK(createTable("test_table_blob", schema));
+	TEST_CHECK(openTable(table, "test_table_blob"));
+
+	// a payload much larger than a page, streamed in: its directory went on
+	// to a second page
+	id = writeTestBlob(table, big, 1);
+	TEST_CHECK(createRecord(&r, schema));
+	MAKE_VALUE(value, DT_INT, 1);
+	TEST_CHECK(setAttr(r, schema, 0, value));
+	value->dt = DT_BLOB;
+	value->v.blobV = id;
+	TEST_CHECK(setAttr(r, schema, 1, value));
+	freeVal(value);
+	TEST_CHECK(insertRecord(table, r));
+
+	// read back a piece at a time through the id the record held
+	TEST_CHECK(getRecord(table, r->id, r));
+	TEST_CHECK(getAttr(r, schema, 1, &value));
+	ASSERT_EQUALS_INT(DT_BLOB, value->dt, "blob attribute");
+	ASSERT_EQUALS_INT(id, value->v.blobV, "blob id kept");
+	freeVal(value);
+	ASSERT_TRUE(checkTestBlob(table, id, big, 1), "blob read back");
+
+	// seeks went straight to their data page, and reads stopped at the end
+	TEST_CHECK(openBlob(table, id, &blob));
+	TEST_CHECK(seekBlob(&blob, big - 100));
+	TEST_CHECK(readBlob(&blob, buf, sizeof(buf), &n));
+	ASSERT_EQUALS_INT(100, n, "read up to the end");
+	same = true;
+	for(int i = 0; i < n; i++)
+		same = same && buf[i] == testBlobByte(big - 100 + i, 1);
+	ASSERT_TRUE(same, "bytes after the seek");
+	TEST_CHECK(readBlob(&blob, buf, sizeof(buf), &n));
+	ASSERT_EQUALS_INT(0, n, "nothing past the end");
+	rc = seekBlob(&blob, big + 1);
+	ASSERT_EQUALS_INT(RC_RM_BAD_BLOB, rc, "no seek past the end");
+
+	// overwriting in place kept the length
+	TEST_CHECK(seekBlob(&blob, 5000));
+	TEST_CHECK(writeBlob(&blob, "patched", 7));
+	ASSERT_TRUE(getBlobSize(&blob) == big, "length unchanged");
+	TEST_CHECK(closeBlob(&blob));
+	TEST_CHECK(openBlob(table, id, &blob));
+	TEST_CHECK(seekBlob(&blob, 4998));
+	TEST_CHECK(readBlob(&blob, buf, 11, &n));
+	ASSERT_TRUE(n == 11 && buf[0] == testBlobByte(4998, 1) && memcmp(buf + 2, "patched", 7) == 0
+			&& buf[9] == testBlobByte(5007, 1), "overwrite in place");
+	TEST_CHECK(closeBlob(&blob));
+
+	// ids that named no large object
+	rc = openBlob(table, 0, &blob);
+	ASSERT_EQUALS_INT(RC_RM_BAD_BLOB, rc, "no blob 0");
+	rc = openBlob(table, r->id.page, &blob);
+	ASSERT_EQUALS_INT(RC_RM_BAD_BLOB, rc, "a heap page is no blob");
+
+	// nor were they sort keys, groups or loaded from files
+	TEST_CHECK(startScan(table, sc, NULL));
+	rc = startSort(sc, 1, byBlob, 0, &sort);
+	ASSERT_EQUALS_INT(RC_RM_BAD_BLOB_ATTR, rc, "no sort by a large object");
+	rc = startAggregation(sc, 1, indexAttrs, 0, NULL, 0, &aggr);
+	ASSERT_EQUALS_INT(RC_RM_BAD_BLOB_ATTR, rc, "no group by a large object");
+	TEST_CHECK(closeScan(sc));
+	rc = loadTableFromFile(table, "test_blob_rows.csv", RM_LOAD_CSV);
+	ASSERT_EQUALS_INT(RC_RM_BAD_BLOB_ATTR, rc, "no load into a large object");
+
+	// the object was on disk with the table
+	TEST_CHECK(closeTable(table));
+	pages = filePages("test_table_blob");
+	ASSERT_TRUE(pages > big / PAGE_SIZE, "blob pages in the file");
+	TEST_CHECK(openTable(table, "test_table_blob"));
+	TEST_CHECK(openBlob(table, id, &blob));
+	total = getBlobSize(&blob);
+	TEST_CHECK(closeBlob(&blob));
+	ASSERT_TRUE(total == big, "length saved");
+
+	// replacing the object freed the old one, whose pages the next one reused
+	id2 = writeTestBlob(table, 3 * PAGE_SIZE, 2);
+	value = (Value *) malloc(sizeof(Value));
+	value->dt = DT_BLOB;
+	value->v.blobV = id2;
+	TEST_CHECK(setAttr(r, schema, 1, value));
+	free(value);
+	TEST_CHECK(updateRecord(table, r));
+	rc = openBlob(table, id, &blob);
+	ASSERT_EQUALS_INT(RC_RM_BAD_BLOB, rc, "old blob freed by the update");
+	ASSERT_TRUE(checkTestBlob(table, id2, 3 * PAGE_SIZE, 2), "new blob read back");
+	id = writeTestBlob(table, big, 3);
+	TEST_CHECK(closeTable(table));
+	ASSERT_EQUALS_INT(pages + 5, filePages("test_table_blob"), "only the replacement took new pages");
+
+	// deleting the record freed its object; one no record held was deleted by id
+	TEST_CHECK(openTable(table, "test_table_blob"));
+	TEST_CHECK(deleteRecord(table, r->id));
+	rc = openBlob(table, id2, &blob);
+	ASSERT_EQUALS_INT(RC_RM_BAD_BLOB, rc, "blob freed by the delete");
+	ASSERT_TRUE(checkTestBlob(table, id, big, 3), "unheld blob kept");
+	TEST_CHECK(deleteBlob(table, id));
+	rc = openBlob(table, id, &blob);
+	ASSERT_EQUALS_INT(RC_RM_BAD_BLOB, rc, "blob deleted");
+	TEST_CHECK(vacuumTable(table));
+	TEST_CHECK(closeTable(table));
+	ASSERT_TRUE(filePages("test_table_blob") < 10, "file shrank after vacuum");
+
+	freeRecord(r);
+	TEST_CHECK(deleteTable("test_table_blob"));
+	freeSchema(schema);
+	TEST_CHECK(shutdownRecordManager());
+	free(table);
+	free(sc);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+void
+testRecordViews (void)
+{
+	RM_TableData *table = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_TableData *pax = (RM_TableData *) malloc(sizeof(RM_TableData));
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RM_TableOptions options;
+	RM_RecordView view, views[4];
+	RM_Snapshot snap;
+	Schema *schema;
+	Record *r;
+	Expr *cond, *left, *right;
+	RID rids[1000];
+	const char *s;
+	char key[8];
+	int dictAttrs[] = { 1 };
+	int indexAttrs[] = { 0 };
+	int i, n, len, rc;
+	long sum;
+	bool same;
+	testName = "test zero-copy record views";
+
+	TEST_CHECK(initRecordManager(NULL));
+	schema = testSchema();
+
+	initTableOptions(&options);
+	options.numDictAttrs = 1;
+	options.dictAttrs = dictAttrs;
+	options.numIndexes = 1;
+	options.indexAttrs = indexAttrs;
+	TEST_CHECK(createTableWithOptions("test_table_view", schema, &options));
+	initTableOptions(&options);
+	options.layout = RM_LAYOUT_PAX;
+	TEST_CHECK(createTableWithOptions("test_table_viewpax", schema, &options));
+	TEST_CHECK(openTable(table, "test_table_view"));
+	TEST_CHECK(openTable(pax, "test_table_viewpax"));
+	for(i = 0; i < 1000; i++)
+	{
+		sprintf(key, "k%02d", i % 10);
+		r = testRecord(schema, i, key, i * 1.5);
+		TEST_CHECK(insertRecord(table, r));
+		rids[i] = r->id;
+		TEST_CHECK(insertRecord(pax, r));
+		freeRecord(r);
+	}
+
+	// point lookups read the attributes where they lay
+	TEST_CHECK(getRecordView(table, rids[7], &view));
+	ASSERT_TRUE(view.pinned && view.stored != NULL, "view of the page");
+	ASSERT_EQUALS_INT(7, getViewInt(&view, 0), "int in place");
+	ASSERT_TRUE(getViewFloat(&view, 2) == 10.5, "float in place");
+	s = getViewString(&view, 1, &len);
+	ASSERT_TRUE(len == 3 && memcmp(s, "k07", 3) == 0, "coded string from the dictionary");
+	TEST_CHECK(releaseRecordView(&view));
+	TEST_CHECK(deleteRecord(table, rids[8]));
+	rc = getRecordView(table, rids[8], &view);
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "no view of a deleted record");
+
+	// a caller could hold views of several pages at once
+	n = 0;
+	for(i = 0; i < 1000 && n < 4; i++)
+		if(n == 0 || rids[i].page != views[n - 1].id.page)
+			TEST_CHECK(getRecordView(table, rids[i], &views[n++]));
+	ASSERT_EQUALS_INT(4, n, "views of four pages held");
+	for(i = 0; i < n; i++)
+		TEST_CHECK(releaseRecordView(&views[i]));
+
+	// scans without a condition, and with one decided by dictionary codes,
+	// never decoded a record
+	sum = 0;
+	n = 0;
+	TEST_CHECK(startScan(table, sc, NULL));
+	while((rc = nextView(sc, &view)) == RC_OK)
+	{
+		sum += getViewInt(&view, 0);
+		n++;
+		TEST_CHECK(releaseRecordView(&view));
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+	TEST_CHECK(closeScan(sc));
+	ASSERT_EQUALS_INT(999, n, "viewed every record");
+	ASSERT_TRUE(sum == 999 * 1000 / 2 - 8, "viewed values");
+
+	MAKE_ATTRREF(left, 1);
+	MAKE_CONS(right, stringToValue("sk03"));
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_EQUAL);
+	n = 0;
+	same = true;
+	TEST_CHECK(startScan(table, sc, cond));
+	while(nextView(sc, &view) == RC_OK)
+	{
+		s = getViewString(&view, 1, &len);
+		same = same && len == 3 && memcmp(s, "k03", 3) == 0 && getViewInt(&view, 0) % 10 == 3;
+		n++;
+		TEST_CHECK(releaseRecordView(&view));
+	}
+	TEST_CHECK(closeScan(sc));
+	freeExpr(cond);
+	ASSERT_EQUALS_INT(100, n, "dictionary term");
+	ASSERT_TRUE(same, "matching records viewed");
+
+	// index scans viewed the records the index led to
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i42"));
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_EQUAL);
+	n = 0;
+	TEST_CHECK(startScan(table, sc, cond));
+	while(nextView(sc, &view) == RC_OK)
+	{
+		n++;
+		ASSERT_TRUE(view.id.page == rids[42].page && view.id.slot == rids[42].slot, "index led to the record");
+		ASSERT_TRUE(getViewFloat(&view, 2) == 63, "indexed record viewed");
+		TEST_CHECK(releaseRecordView(&view));
+	}
+	TEST_CHECK(closeScan(sc));
+	freeExpr(cond);
+	ASSERT_EQUALS_INT(1, n, "index term");
+
+	// PAX pages: minipages read in place, and terms decided without copies
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i500"));
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_SMALLER);
+	n = 0;
+	same = true;
+	TEST_CHECK(startScan(pax, sc, cond));
+	while(nextView(sc, &view) == RC_OK)
+	{
+		i = getViewInt(&view, 0);
+		s = getViewString(&view, 1, &len);
+		same = same && view.paxSlot >= 0 && i < 500 && getViewFloat(&view, 2) == i * 1.5f
+			&& len == 3 && s[2] == '0' + i % 10;
+		n++;
+		TEST_CHECK(releaseRecordView(&view));
+	}
+	TEST_CHECK(closeScan(sc));
+	freeExpr(cond);
+	ASSERT_EQUALS_INT(500, n, "PAX terms");
+	ASSERT_TRUE(same, "PAX records viewed");
+
+	// snapshot scans viewed the versions in their batch, holding no page
+	TEST_CHECK(beginSnapshot(&snap));
+	r = testRecord(schema, -1, "new", 0);
+	r->id = rids[0];
+	TEST_CHECK(updateRecord(table, r));
+	freeRecord(r);
+	n = 0;
+	same = true;
+	TEST_CHECK(startScanAsOf(table, sc, NULL, &snap));
+	while(nextView(sc, &view) == RC_OK)
+	{
+		same = same && !view.pinned && view.data != NULL && getViewInt(&view, 0) >= 0;
+		n++;
+		TEST_CHECK(releaseRecordView(&view));
+	}
+	TEST_CHECK(closeScan(sc));
+	TEST_CHECK(endSnapshot(&snap));
+	ASSERT_EQUALS_INT(999, n, "snapshot views");
+	ASSERT_TRUE(same, "old version viewed");
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(closeTable(pax));
+	TEST_CHECK(deleteTable("test_table_view"));
+	TEST_CHECK(deleteTable("test_table_viewpax"));
+	freeSchema(schema);
+
+	// toasted strings were not on the page
+	schema = varcharSchema(3000);
+	TEST_CHECK(createTable("test_table_view", schema));
+	TEST_CHECK(openTable(table, "test_table_view"));
+	r = textRecord(schema, 1, "abc");
+	TEST_CHECK(insertRecord(table, r));
+	rids[0] = r->id;
+	freeRecord(r);
+	r = textRecord(schema, 2, "def");
+	TEST_CHECK(insertRecord(table, r));
+	freeRecord(r);
+	r = textRecord(schema, 1, "");
+	fillString(r, schema, 1, 'y', 2500);
+	r->id = rids[0];
+	TEST_CHECK(updateRecord(table, r));
+	freeRecord(r);
+	TEST_CHECK(getRecordView(table, rids[0], &view));
+	ASSERT_EQUALS_INT(1, getViewInt(&view, 0), "record with a toasted string viewed");
+	ASSERT_TRUE(getViewString(&view, 1, &len) == NULL, "toasted string not in place");
+	TEST_CHECK(releaseRecordView(&view));
+
+	MAKE_ATTRREF(left, 0);
+	MAKE_CONS(right, stringToValue("i2"));
+	MAKE_BINOP_EXPR(cond, left, right, OP_COMP_SMALLER);
+	n = 0;
+	TEST_CHECK(startScan(table, sc, cond));
+	while(nextView(sc, &view) == RC_OK)
+	{
+		n += getViewInt(&view, 0);
+		TEST_CHECK(releaseRecordView(&view));
+	}
+	TEST_CHECK(closeScan(sc));
+	freeExpr(cond);
+	ASSERT_EQUALS_INT(1, n, "toasted record checked on a copy");
+
+	TEST_CHECK(closeTable(table));
+	TEST_CHECK(deleteTable("test_table_view"));
+	freeSchema(schema);
+	TEST_CHECK(shutdownRecordManager());
+	free(table);
+	free(pax);
+	free(sc);
+
+	TEST_DONE();
+}
+
+// ************************************************************
+Schema *
+testSchema (void)
+{
+	Schema *result;
+	char *names[] = { "a", "b", "c" };
+	DataType dt[] = { DT_INT, DT_STRING, DT_FLOAT };
+	int sizes[] = { 0, 4, 0 };
+	int keys[] = {0};
+	int i;
+	char **cpNames = (char **) malloc(sizeof(char*) * 3);
+	DataType *cpDt = (DataType *) malloc(sizeof(DataType) * 3);
+	int *cpSizes = (int *) malloc(sizeof(int) * 3);
+	int *cpKeys = (int *) malloc(sizeof(int));
+
+	for(i = 0; i < 3; i++)
+	{
+		cpNames[i] = (char *) malloc(2);
+		strcpy(cpNames[i], names[i]);
+	}
+	memcpy(cpDt, dt, sizeof(DataType) * 3);
+	memcpy(cpSizes, sizes, sizeof(int) * 3);
+	memcpy(cpKeys, keys, sizeof(int));
+
+	result = createSchema(3, cpNames, cpDt, cpSizes, 1, cpKeys);
+
+	return result;
+}
+
+// ************************************************************
+Record *
+testRecord (Schema *schema, int a, char *b, float c)
+{
+	Record *result;
+	Value *value;
+
+	TEST_CHECK(createRecord(&result, schema));
+
+	MAKE_VALUE(value, DT_INT, a);
+	TEST_CHECK(setAttr(result, schema, 0, value));
+	freeVal(value);
+
+	MAKE_STRING_VALUE(value, b);
+	TEST_CHECK(setAttr(result, schema, 1, value));
+	freeVal(value);
+
+	MAKE_VALUE(value, DT_FLOAT, c);
+	TEST_CHECK(setAttr(result, schema, 2, value));
+	freeVal(value);
+
+	return result;
+}
+
+// ************************************************************
+Schema *
+varcharSchema (int length)
+{
+	char **names = (char **) malloc(sizeof(char*) * 2);
+	DataType *dt = (DataType *) malloc(sizeof(DataType) * 2);
+	int *sizes = (int *) malloc(sizeof(int) * 2);
+	int *keys = (int *) malloc(sizeof(int));
+
+	names[0] = strdup("id");
+	names[1] = strdup("text");
+	dt[0] = DT_INT;
+	dt[1] = DT_STRING;
+	sizes[0] = 0;
+	sizes[1] = length;
+	keys[0] = 0;
+
+	return createSchema(2, names, dt, sizes, 1, keys);
+}
+
+// ************************************************************
+void
+fillString (Record *r, Schema *schema, int attrNum, char c, int len)
+{
+	memset(r->data + schema->attrOffsets[attrNum], 0, schema->typeLength[attrNum]);
+	memset(r->data + schema->attrOffsets[attrNum], c, len);
+}
+
+// ************************************************************
+int
+countMatches (RM_TableData *table, Expr *cond)
+{
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	Record *r;
+	int rc, count = 0;
+
+	TEST_CHECK(createRecord(&r, table->schema));
+	TEST_CHECK(startScan(table, sc, cond));
+	while((rc = next(sc, r)) == RC_OK)
+		count++;
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+	TEST_CHECK(closeScan(sc));
+	freeRecord(r);
+	free(sc);
+
+	return count;
+}
+
+// ************************************************************
+int
+countJoin (RM_TableData *orders, RM_TableData *customers, Expr *custCond, int attr, char method, int budget)
+{
+	RM_ScanHandle *os = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RM_ScanHandle *cs = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	RM_JoinHandle join;
+	Record *o, *c;
+	Value ov, cv;
+	char obuf[5], cbuf[5];
+	int rc, count = 0, bad = 0;
+
+	TEST_CHECK(createRecord(&o, orders->schema));
+	TEST_CHECK(createRecord(&c, customers->schema));
+	TEST_CHECK(startScan(orders, os, NULL));
+	TEST_CHECK(startScan(customers, cs, custCond));
+	if (method == 'h')
+	{
+		TEST_CHECK(startHashJoin(os, attr, cs, attr, budget, &join));
+	}
+	else if (method == 'i')
+	{
+		TEST_CHECK(startIndexJoin(os, attr, customers, attr, custCond, &join));
+	}
+	else
+	{
+		TEST_CHECK(startMergeJoin(orders, attr, NULL, customers, attr, custCond, &join));
+	}
+
+	ov.v.stringV = obuf;
+	cv.v.stringV = cbuf;
+	while((rc = nextJoin(&join, o, c)) == RC_OK)
+	{
+		TEST_CHECK(getAttrInto(o, orders->schema, attr, &ov));
+		TEST_CHECK(getAttrInto(c, customers->schema, attr, &cv));
+		if (attr == 0 ? ov.v.intV != cv.v.intV : strcmp(ov.v.stringV, cv.v.stringV) != 0)
+			bad++;
+		// the left record is an order, the right one a selected customer
+		if (getFloatAttr(o, orders->schema, 2) < 1000 || getFloatAttr(c, customers->schema, 2) >= 40)
+			bad++;
+		count++;
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "join ended normally");
+	ASSERT_EQUALS_INT(0, bad, "every pair matched on the join attribute and came from the right side");
+
+	TEST_CHECK(closeJoin(&join));
+	TEST_CHECK(closeScan(os));
+	TEST_CHECK(closeScan(cs));
+	freeRecord(o);
+	freeRecord(c);
+	free(os);
+	free(cs);
+	return count;
+}
+
+// ************************************************************
+int
+filePages (char *name)
+{
+	SM_FileHandle fh;
+	int pages;
+
+	TEST_CHECK(openPageFile(name, &fh));
+	pages = fh.totalNumPages;
+	TEST_CHECK(closePageFile(&fh));
+
+	return pages;
+}
+
+// ************************************************************
+void
+copyFile (char *from, char *to)
+{
+	FILE *in = fopen(from, "rb");
+	FILE *out = fopen(to, "wb");
+	char buf[PAGE_SIZE];
+	size_t n;
+
+	ASSERT_TRUE(in != NULL && out != NULL, "opened the files to copy");
+	while((n = fread(buf, 1, sizeof(buf), in)) > 0)
+		fwrite(buf, 1, n, out);
+	fclose(in);
+	fclose(out);
+}
+
+// ************************************************************
+void *
+commitMany (void *log)
+{
+	long failed = 0;
+	int i;
+
+	for(i = 0; i < 25; i++)
+		if (commitLog((WAL_Log *) log, NULL) != RC_OK)
+			failed++;
+
+	return (void *) failed;
+}
+
+// ************************************************************
+int
+sumSnapshot (RM_TableData *table, RM_Snapshot *snap, Expr *cond, int *count, int *bad)
+{
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	Record *r;
+	int rc, i, len, sum = 0;
+
+	*count = *bad = 0;
+	TEST_CHECK(createRecord(&r, table->schema));
+	TEST_CHECK(startScanAsOf(table, sc, cond, snap));
+	while((rc = next(sc, r)) == RC_OK)
+	{
+		i = getIntAttr(r, table->schema, 0);
+		getStringAttr(r, table->schema, 1, &len);
+		sum += i;
+		(*count)++;
+		if (len != ((i >= 1900) ? 4 : 0) || getFloatAttr(r, table->schema, 2) != (float) i)
+			(*bad)++;
+	}
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+	TEST_CHECK(closeScan(sc));
+	freeRecord(r);
+	free(sc);
+
+	return sum;
+}
+
+// ************************************************************
+void *
+writeMany (void *thread)
+{
+	Schema *schema = sharedTable->schema;
+	int base = 1000 * (int) (long) thread;
+	RID rids[500];
+	Record *r;
+	long failed = 0;
+	int i;
+
+	for(i = 0; i < 500; i++)
+	{
+		r = testRecord(schema, base + i, "", i);
+		if (insertRecord(sharedTable, r) != RC_OK)
+			failed++;
+		rids[i] = r->id;
+		freeRecord(r);
+	}
+	// the updates grew the records, so row tables moved some of them
+	for(i = 0; i < 500; i += 2)
+	{
+		r = testRecord(schema, base + i, "abcd", -1);
+		r->id = rids[i];
+		if (updateRecord(sharedTable, r) != RC_OK)
+			failed++;
+		freeRecord(r);
+	}
+	for(i = 0; i < 500; i += 5)
+		if (deleteRecord(sharedTable, rids[i]) != RC_OK)
+			failed++;
+
+	// every record read back as the thread had left it
+	createRecord(&r, schema);
+	for(i = 1; i < 500; i++)
+		if (i % 5 != 0 && (getRecord(sharedTable, rids[i], r) != RC_OK
+			|| getIntAttr(r, schema, 0) != base + i))
+			failed++;
+	freeRecord(r);
+
+	return (void *) failed;
+}
+
+// ************************************************************
+void *
+sortMany (void *byC)
+{
+	RM_ScanHandle sc;
+	RM_SortHandle sort;
+	RM_SortKey byA[] = { { 0, 0 } };
+	RM_SortKey byCDesc[] = { { 2, 1 } };
+	Schema *schema = sharedTable->schema;
+	Record *r;
+	long failed = 0;
+	int rows = 0, lastA = -1;
+	float lastC = 1e9;
+
+	createRecord(&r, schema);
+	if (startScan(sharedTable, &sc, NULL) != RC_OK
+		|| startSort(&sc, 1, byC ? byCDesc : byA, 400, &sort) != RC_OK)
+		return (void *) 1L;
+	while(nextSorted(&sort, r) == RC_OK)
+	{
+		int a = getIntAttr(r, schema, 0);
+		float c = getFloatAttr(r, schema, 2);
+		if (byC ? c > lastC : a < lastA)
+			failed++;
+		lastA = a;
+		lastC = c;
+		rows++;
+	}
+	failed += (rows != 2000);
+	closeSort(&sort);
+	closeScan(&sc);
+	freeRecord(r);
+
+	return (void *) failed;
+}
+
+// ************************************************************
+double
+selectivity (RM_TableData *table, int attr, CompOp op, Value *cons)
+{
+	AttrPredicate pred;
+
+	pred.attrNum = attr;
+	pred.op = op;
+	pred.cons = cons;
+	return estimateSelectivity(table, &pred);
+}
+
+// ************************************************************
+int
+countPlanned (RM_TableData *table, Expr *cond, RM_ScanPlan *plan)
+{
+	RM_ScanHandle *sc = (RM_ScanHandle *) malloc(sizeof(RM_ScanHandle));
+	Record *r;
+	int rc, count = 0;
+
+	TEST_CHECK(createRecord(&r, table->schema));
+	TEST_CHECK(startScan(table, sc, cond));
+	TEST_CHECK(getScanPlan(sc, plan));
+	while((rc = next(sc, r)) == RC_OK)
+		count++;
+	ASSERT_EQUALS_INT(RC_RM_NO_MORE_TUPLES, rc, "scan ended normally");
+	TEST_CHECK(closeScan(sc));
+	freeRecord(r);
+	free(sc);
+
+	return count;
+}
+
+// ************************************************************
+Record *
+textRecord (Schema *schema, int id, char *text)
+{
+	Record *result;
+	Value *value;
+
+	TEST_CHECK(createRecord(&result, schema));
+
+	MAKE_VALUE(value, DT_INT, id);
+	TEST_CHECK(setAttr(result, schema, 0, value));
+	freeVal(value);
+
+	MAKE_STRING_VALUE(value, text);
+	TEST_CHECK(setAttr(result, schema, 1, value));
+	freeVal(value);
+
+	return result;
+}
+
+// ************************************************************
+long
+fileBytes (char *name)
+{
+	FILE *f = fopen(name, "rb");
+	long bytes;
+
+	ASSERT_TRUE(f != NULL, "opened the file to measure");
+	fseek(f, 0, SEEK_END);
+	bytes = ftell(f);
+	fclose(f);
+
+	return bytes;
+}
+
+// ************************************************************
+void *
+scanPartition (void *part)
+{
+	RM_ScanHandle sc;
+	Record *r;
+	long count = 0;
+
+	if (createRecord(&r, sharedTable->schema) != RC_OK)
+		return (void *) -1L;
+	if (startPartitionScan(sharedTable, (int) (long) part, &sc, NULL) == RC_OK)
+	{
+		while(next(&sc, r) == RC_OK)
+			count++;
+		closeScan(&sc);
+	}
+	freeRecord(r);
+
+	return (void *) count;
+}
+
+// ************************************************************
+Schema *
+blobSchema (void)
+{
+	char **names = (char **) malloc(sizeof(char*) * 2);
+	DataType *dt = (DataType *) malloc(sizeof(DataType) * 2);
+	int *sizes = (int *) malloc(sizeof(int) * 2);
+	int *keys = (int *) malloc(sizeof(int));
+
+	names[0] = strdup("id");
+	names[1] = strdup("doc");
+	dt[0] = DT_INT;
+	dt[1] = DT_BLOB;
+	sizes[0] = 0;
+	sizes[1] = 0;
+	keys[0] = 0;
+
+	return createSchema(2, names, dt, sizes, 1, keys);
+}
+
+// ************************************************************
+char
+testBlobByte (long long pos, int seed)
+{
+	return (char) ((pos * 31 + pos / 4099 + seed) & 0xff);
+}
+
+// ************************************************************
+int
+writeTestBlob (RM_TableData *table, int len, int seed)
+{
+	RM_BlobHandle blob;
+	char buf[65536];
+	int pos = 0, id;
+
+	TEST_CHECK(createBlob(table, &blob));
+	while(pos < len)
+	{
+		int n = (len - pos < (int) sizeof(buf)) ? len - pos : (int) sizeof(buf);
+		for(int i = 0; i < n; i++)
+			buf[i] = testBlobByte(pos + i, seed);
+		TEST_CHECK(writeBlob(&blob, buf, n));
+		pos += n;
+	}
+	id = blob.id;
+	TEST_CHECK(closeBlob(&blob));
+
+	return id;
+}
+
+// ************************************************************
+bool
+checkTestBlob (RM_TableData *table, int id, int len, int seed)
+{
+	RM_BlobHandle blob;
+	char buf[9999];
+	long long pos = 0;
+	bool same;
+	int n;
+
+	TEST_CHECK(openBlob(table, id, &blob));
+	same = (getBlobSize(&blob) == len);
+	do
+	{
+		TEST_CHECK(readBlob(&blob, buf, sizeof(buf), &n));
+		for(int i = 0; i < n; i++)
+			same = same && buf[i] == testBlobByte(pos + i, seed);
+		pos += n;
+	} while(n > 0);
+	TEST_CHECK(closeBlob(&blob));
+
+	return same && pos == len;
+}
@@ -0,0 +1,959 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include "wal_mgr.h"
+#include "storage_mgr.h"
+#include "dberror.h"
+
+/*
+ * wal_mgr.c
+ * ---------------------------------------------------------------
+ * Write-ahead log with group commit, fuzzy checkpoints and parallel redo.
+ * See wal_mgr.h.
+ */
+
+#define WAL_REC_PAGE      1   /* image of one page after a change */
+#define WAL_REC_COMMIT    2   /* commit point, no payload */
+#define WAL_REC_TRUNCATE  3   /* a page file was cut back to pageNum pages */
+#define WAL_REC_CHECKPOINT 4  /* dirty page table, see logCheckpoint */
+
+#define WAL_MAX_NAME      255
+#define WAL_MAX_PAYLOAD   (1 << 26)
+
+/* Page records queued per redo worker */
+#define WAL_REDO_QUEUE    64
+
+/* Every record started with this header, followed by the name and the data. */
+typedef struct WAL_RecordHeader {
+    LSN lsn;
+    int type;                 /* one of the WAL_REC_* values above */
+    int pageNum;
+    int nameLen;              /* bytes of the page file name after the header */
+    int dataLen;              /* bytes of page data after the name */
+    unsigned int checksum;    /* over the header (with checksum 0), name and data */
+    int unused;
+} WAL_RecordHeader;
+
+/* Records appended but not written to the file yet. */
+typedef struct WAL_Buffer {
+    char *data;
+    int len;
+    int cap;
+} WAL_Buffer;
+
+typedef struct WAL_MgmtData {
+    FILE *file;
+    pthread_mutex_t lock;
+    pthread_cond_t flushed;   /* signalled whenever a sync finished */
+    WAL_Buffer cur;           /* where new records went */
+    WAL_Buffer spare;         /* handed to the next sync */
+    LSN bufStart;             /* LSN of cur.data[0] */
+    LSN flushedLSN;           /* every record before this was durable */
+    bool flushing;            /* a leader was writing and syncing */
+    int numSyncs;
+    LSN lastCheckpoint;       /* newest durable checkpoint, WAL_NO_LSN if none */
+} WAL_MgmtData;
+
+/* Contents of "<log>.master": where the newest checkpoint record started. */
+typedef struct WAL_Master {
+    LSN checkpoint;
+    unsigned int checksum;
+    int unused;
+} WAL_Master;
+
+/*
+ * checksumBytes
+ * -------------
+ * Continued an FNV-1a hash over len more bytes.
+ */
+static unsigned int checksumBytes(unsigned int h, const char *bytes, int len)
+{
+    for (int i = 0; i < len; i++)
+    {
+        h ^= (unsigned char) bytes[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/*
+ * recordChecksum
+ * --------------
+ * Computed the checksum of a record whose header had checksum set to 0.
+ */
+static unsigned int recordChecksum(WAL_RecordHeader *hdr, const char *name, const char *data)
+{
+    unsigned int h = checksumBytes(2166136261u, (const char *) hdr, sizeof(WAL_RecordHeader));
+    h = checksumBytes(h, name, hdr->nameLen);
+    return checksumBytes(h, data, hdr->dataLen);
+}
+
+/*
+ * masterName
+ * ----------
+ * Built the name of the master file that belonged to a log.
+ */
+static void masterName(const char *fileName, char *buf, size_t size)
+{
+    snprintf(buf, size, "%s.master", fileName);
+}
+
+/*
+ * readMaster
+ * ----------
+ * Read the LSN of the newest checkpoint from the master file. Returned false
+ * if there was none or it had been torn.
+ */
+static bool readMaster(const char *fileName, LSN *checkpoint)
+{
+    char name[WAL_MAX_NAME + 16];
+    WAL_Master master;
+
+    masterName(fileName, name, sizeof(name));
+    FILE *file = fopen(name, "rb");
+    if (file == NULL)
+        return false;
+    bool ok = fread(&master, sizeof(master), 1, file) == 1
+              && master.checksum == checksumBytes(2166136261u, (const char *) &master.checkpoint, sizeof(LSN));
+    fclose(file);
+
+    if (ok)
+        *checkpoint = master.checkpoint;
+    return ok;
+}
+
+/*
+ * writeMaster
+ * -----------
+ * Durably pointed the master file at a new checkpoint.
+ */
+static RC writeMaster(const char *fileName, LSN checkpoint)
+{
+    char name[WAL_MAX_NAME + 16];
+    WAL_Master master;
+
+    memset(&master, 0, sizeof(master));
+    master.checkpoint = checkpoint;
+    master.checksum = checksumBytes(2166136261u, (const char *) &master.checkpoint, sizeof(LSN));
+
+    masterName(fileName, name, sizeof(name));
+    FILE *file = fopen(name, "wb");
+    if (file == NULL)
+        return RC_WRITE_FAILED;
+    RC rc = RC_OK;
+    if (fwrite(&master, sizeof(master), 1, file) != 1 || fflush(file) != 0
+        || fdatasync(fileno(file)) != 0)
+        rc = RC_WRITE_FAILED;
+    fclose(file);
+    return rc;
+}
+
+/*
+ * appendRecord
+ * ------------
+ * Added one record to the in-memory buffer and returned its LSN. The caller
+ * held the lock.
+ */
+static RC appendRecord(WAL_MgmtData *m, int type, const char *name, int pageNum,
+                       const char *data, int dataLen, LSN *lsn)
+{
+    WAL_RecordHeader hdr;
+    int nameLen = (name != NULL) ? (int) strlen(name) : 0;
+    if (nameLen > WAL_MAX_NAME)
+        return RC_INVALID_FILENAME;
+
+    int len = (int) sizeof(hdr) + nameLen + dataLen;
+    if (m->cur.len + len > m->cur.cap)
+    {
+        int cap = (m->cur.cap > 0) ? m->cur.cap : 4 * PAGE_SIZE;
+        while (cap < m->cur.len + len)
+            cap *= 2;
+        char *grown = (char *) realloc(m->cur.data, cap);
+        if (grown == NULL)
+            return RC_MEMORY_ALLOCATION_ERROR;
+        m->cur.data = grown;
+        m->cur.cap  = cap;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.lsn     = m->bufStart + m->cur.len;
+    hdr.type    = type;
+    hdr.pageNum = pageNum;
+    hdr.nameLen = nameLen;
+    hdr.dataLen = dataLen;
+    hdr.checksum = recordChecksum(&hdr, name, data);
+
+    char *out = m->cur.data + m->cur.len;
+    memcpy(out, &hdr, sizeof(hdr));
+    if (nameLen > 0)
+        memcpy(out + sizeof(hdr), name, nameLen);
+    if (dataLen > 0)
+        memcpy(out + sizeof(hdr) + nameLen, data, dataLen);
+    m->cur.len += len;
+
+    if (lsn != NULL)
+        *lsn = hdr.lsn;
+    return RC_OK;
+}
+
+/*
+ * syncTo
+ * ------
+ * Returned once the record at 'lsn' was durable. The first caller to find no
+ * sync running became the leader: it (optionally) waited for more records,
+ * took the whole buffer, wrote it and called fdatasync once for everyone in
+ * it. The others waited for the leader and took over if their record had
+ * missed its batch.
+ */
+static RC syncTo(WAL_Log *log, LSN lsn, int waitUsec)
+{
+    WAL_MgmtData *m = (WAL_MgmtData *) log->mgmtData;
+    RC rc = RC_OK;
+
+    pthread_mutex_lock(&m->lock);
+    while (rc == RC_OK && m->flushedLSN <= lsn)
+    {
+        if (m->flushing)
+        {
+            pthread_cond_wait(&m->flushed, &m->lock);
+            continue;
+        }
+        if (m->cur.len == 0)
+            break;
+
+        m->flushing = true;
+        if (waitUsec > 0)
+        {
+            pthread_mutex_unlock(&m->lock);
+            usleep(waitUsec);
+            pthread_mutex_lock(&m->lock);
+        }
+
+        // Swapped buffers so new records could be appended during the sync
+        WAL_Buffer batch = m->cur;
+        LSN end = m->bufStart + batch.len;
+        m->cur = m->spare;
+        m->cur.len = 0;
+        m->bufStart = end;
+        pthread_mutex_unlock(&m->lock);
+
+        if (fwrite(batch.data, 1, batch.len, m->file) != (size_t) batch.len
+            || fflush(m->file) != 0 || fdatasync(fileno(m->file)) != 0)
+            rc = RC_WRITE_FAILED;
+
+        pthread_mutex_lock(&m->lock);
+        m->spare = batch;
+        if (rc == RC_OK)
+            m->flushedLSN = end;
+        m->flushing = false;
+        m->numSyncs++;
+        pthread_cond_broadcast(&m->flushed);
+    }
+    pthread_mutex_unlock(&m->lock);
+    return rc;
+}
+
+/*
+ * createLog
+ * ---------
+ * Created an empty log file.
+ */
+RC createLog(char *fileName)
+{
+    char name[WAL_MAX_NAME + 16];
+    FILE *file = fopen(fileName, "wb");
+    if (file == NULL)
+        return RC_WRITE_FAILED;
+    fclose(file);
+
+    // A master file left by an earlier log of that name pointed nowhere now
+    masterName(fileName, name, sizeof(name));
+    remove(name);
+    return RC_OK;
+}
+
+/*
+ * openLog
+ * -------
+ * Opened a log for appending; new records followed the existing ones.
+ */
+RC openLog(WAL_Log *log, char *fileName)
+{
+    FILE *file = fopen(fileName, "r+b");
+    if (file == NULL)
+        return RC_FILE_NOT_FOUND;
+    fseek(file, 0, SEEK_END);
+
+    WAL_MgmtData *m = (WAL_MgmtData *) calloc(1, sizeof(WAL_MgmtData));
+    if (m == NULL)
+    {
+        fclose(file);
+        return RC_MEMORY_ALLOCATION_ERROR;
+    }
+    m->file = file;
+    m->bufStart = m->flushedLSN = ftell(file);
+    if (!readMaster(fileName, &m->lastCheckpoint))
+        m->lastCheckpoint = WAL_NO_LSN;
+    pthread_mutex_init(&m->lock, NULL);
+    pthread_cond_init(&m->flushed, NULL);
+
+    log->fileName = fileName;
+    log->groupCommitUsec = 0;
+    log->checkpointInterval = 0;
+    log->mgmtData = m;
+    return RC_OK;
+}
+
+/*
+ * closeLog
+ * --------
+ * Made every appended record durable and closed the log.
+ */
+RC closeLog(WAL_Log *log)
+{
+    WAL_MgmtData *m = (WAL_MgmtData *) log->mgmtData;
+    if (m == NULL)
+        return RC_FILE_HANDLE_NOT_INIT;
+
+    RC rc = syncTo(log, m->bufStart + m->cur.len, 0);
+    fclose(m->file);
+    pthread_mutex_destroy(&m->lock);
+    pthread_cond_destroy(&m->flushed);
+    free(m->cur.data);
+    free(m->spare.data);
+    free(m);
+    log->mgmtData = NULL;
+    return rc;
+}
+
+/*
+ * destroyLog
+ * ----------
+ * Removed a log file.
+ */
+RC destroyLog(char *fileName)
+{
+    char name[WAL_MAX_NAME + 16];
+    masterName(fileName, name, sizeof(name));
+    remove(name);
+    return (remove(fileName) == 0) ? RC_OK : RC_FILE_NOT_FOUND;
+}
+
+/*
+ * logPageImage
+ * ------------
+ * Appended the image of one page after a change. The record was not durable
+ * until flushLog or commitLog had covered its LSN.
+ */
+RC logPageImage(WAL_Log *log, char *pageFile, int pageNum, char *data, LSN *lsn)
+{
+    WAL_MgmtData *m = (WAL_MgmtData *) log->mgmtData;
+    pthread_mutex_lock(&m->lock);
+    RC rc = appendRecord(m, WAL_REC_PAGE, pageFile, pageNum, data, PAGE_SIZE, lsn);
+    pthread_mutex_unlock(&m->lock);
+    return rc;
+}
+
+/*
+ * logFileTruncate
+ * ---------------
+ * Appended a record saying that a page file had been cut back to numPages
+ * pages, so recovery did not bring back pages that no longer existed.
+ */
+RC logFileTruncate(WAL_Log *log, char *pageFile, int numPages, LSN *lsn)
+{
+    WAL_MgmtData *m = (WAL_MgmtData *) log->mgmtData;
+    pthread_mutex_lock(&m->lock);
+    RC rc = appendRecord(m, WAL_REC_TRUNCATE, pageFile, numPages, NULL, 0, lsn);
+    pthread_mutex_unlock(&m->lock);
+    return rc;
+}
+
+/*
+ * flushLog
+ * --------
+ * Made every record up to and including the one at 'lsn' durable. Used by the
+ * buffer manager before it wrote a page back, so it never waited for a group.
+ */
+RC flushLog(WAL_Log *log, LSN lsn)
+{
+    if (lsn == WAL_NO_LSN)
+        return RC_OK;
+    return syncTo(log, lsn, 0);
+}
+
+/*
+ * commitLog
+ * ---------
+ * Appended a commit record and returned once it was durable, sharing the sync
+ * with every other committer of the same batch.
+ */
+RC commitLog(WAL_Log *log, LSN *lsn)
+{
+    WAL_MgmtData *m = (WAL_MgmtData *) log->mgmtData;
+    LSN commit;
+
+    pthread_mutex_lock(&m->lock);
+    RC rc = appendRecord(m, WAL_REC_COMMIT, NULL, -1, NULL, 0, &commit);
+    pthread_mutex_unlock(&m->lock);
+    if (rc != RC_OK)
+        return rc;
+
+    if (lsn != NULL)
+        *lsn = commit;
+    return syncTo(log, commit, log->groupCommitUsec);
+}
+
+/*
+ * logCheckpoint
+ * -------------
+ * Wrote a fuzzy checkpoint: the dirty page table the caller had collected,
+ * with no page written and no writer held up. Once the record was durable,
+ * the master file was pointed at it. The caller had made every page that was
+ * clean when the table was collected durable in its file first.
+ */
+RC logCheckpoint(WAL_Log *log, WAL_DirtyPage *dirty, int numDirty, LSN *lsn)
+{
+    WAL_MgmtData *m = (WAL_MgmtData *) log->mgmtData;
+    int len = (int) sizeof(int);
+    LSN checkpoint;
+
+    // Payload: numDirty, then (recLSN, pageNum, nameLen, name) per page
+    for (int i = 0; i < numDirty; i++)
+        len += (int) (sizeof(LSN) + 2 * sizeof(int) + strlen(dirty[i].pageFile));
+    if (len > WAL_MAX_PAYLOAD)
+        return RC_WRITE_FAILED;
+    char *payload = (char *) malloc(len);
+    if (payload == NULL)
+        return RC_MEMORY_ALLOCATION_ERROR;
+
+    char *out = payload;
+    memcpy(out, &numDirty, sizeof(int));
+    out += sizeof(int);
+    for (int i = 0; i < numDirty; i++)
+    {
+        int nameLen = (int) strlen(dirty[i].pageFile);
+        memcpy(out, &dirty[i].recLSN, sizeof(LSN));
+        memcpy(out + sizeof(LSN), &dirty[i].pageNum, sizeof(int));
+        memcpy(out + sizeof(LSN) + sizeof(int), &nameLen, sizeof(int));
+        memcpy(out + sizeof(LSN) + 2 * sizeof(int), dirty[i].pageFile, nameLen);
+        out += sizeof(LSN) + 2 * sizeof(int) + nameLen;
+    }
+
+    pthread_mutex_lock(&m->lock);
+    RC rc = appendRecord(m, WAL_REC_CHECKPOINT, NULL, -1, payload, len, &checkpoint);
+    pthread_mutex_unlock(&m->lock);
+    free(payload);
+
+    if (rc == RC_OK)
+        rc = syncTo(log, checkpoint, 0);
+    if (rc == RC_OK)
+        rc = writeMaster(log->fileName, checkpoint);
+    if (rc != RC_OK)
+        return rc;
+
+    pthread_mutex_lock(&m->lock);
+    m->lastCheckpoint = checkpoint;
+    pthread_mutex_unlock(&m->lock);
+    if (lsn != NULL)
+        *lsn = checkpoint;
+    return RC_OK;
+}
+
+/* --------------------------------------------------------------------------
+   Recovery
+   -------------------------------------------------------------------------- */
+
+/* The dirty page table of the checkpoint recovery started from. */
+typedef struct RedoDirtyEntry {
+    const char *name;         /* points into the checkpoint payload */
+    int nameLen;
+    int pageNum;
+    LSN recLSN;
+} RedoDirtyEntry;
+
+typedef struct RedoDirtyTable {
+    RedoDirtyEntry *entries;  /* open addressing, name == NULL => unused */
+    int size;                 /* a power of two */
+} RedoDirtyTable;
+
+/* One page file a redo worker kept open. */
+typedef struct RedoFile {
+    char name[WAL_MAX_NAME + 1];
+    int fd;                   /* -1 while none was open */
+    bool compressed;          /* a compressed file, open through fh instead */
+    SM_FileHandle fh;
+} RedoFile;
+
+typedef struct RedoItem {
+    char name[WAL_MAX_NAME + 1];
+    int pageNum;
+    char data[PAGE_SIZE];
+} RedoItem;
+
+/* A redo thread and the ring of page records queued for it. */
+typedef struct RedoWorker {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;   /* signalled when records were queued or applied */
+    RedoItem *items;
+    int head;                 /* next record to apply */
+    int count;                /* queued records, including the one being applied */
+    bool done;                /* no more records would come */
+    RedoFile file;
+    RC rc;
+} RedoWorker;
+
+/*
+ * pageHash
+ * --------
+ * Hashed a page of a page file; used for the dirty page table and to give
+ * every page to one redo worker.
+ */
+static unsigned int pageHash(const char *name, int nameLen, int pageNum)
+{
+    return checksumBytes(2166136261u, name, nameLen) ^ ((unsigned int) pageNum * 2654435761u);
+}
+
+/*
+ * findDirty
+ * ---------
+ * Found the dirty page table slot of a page, or the free slot it would go in.
+ */
+static RedoDirtyEntry *findDirty(RedoDirtyTable *dpt, const char *name, int nameLen, int pageNum)
+{
+    unsigned int i = pageHash(name, nameLen, pageNum) & (dpt->size - 1);
+    while (dpt->entries[i].name != NULL)
+    {
+        RedoDirtyEntry *e = &dpt->entries[i];
+        if (e->pageNum == pageNum && e->nameLen == nameLen && memcmp(e->name, name, nameLen) == 0)
+            return e;
+        i = (i + 1) & (dpt->size - 1);
+    }
+    return &dpt->entries[i];
+}
+
+/*
+ * loadDirtyTable
+ * --------------
+ * Built the dirty page table from a checkpoint payload and returned where
+ * redo had to start: the oldest recLSN, or the checkpoint itself if no page
+ * had been dirty.
+ */
+static LSN loadDirtyTable(RedoDirtyTable *dpt, const char *payload, int len, LSN checkpoint)
+{
+    LSN start = checkpoint;
+    int numDirty = 0;
+
+    if (len >= (int) sizeof(int))
+        memcpy(&numDirty, payload, sizeof(int));
+    dpt->size = 16;
+    while (dpt->size < 2 * numDirty)
+        dpt->size *= 2;
+    dpt->entries = (RedoDirtyEntry *) calloc(dpt->size, sizeof(RedoDirtyEntry));
+
+    const char *in = payload + sizeof(int);
+    const char *end = payload + len;
+    for (int i = 0; i < numDirty && in + sizeof(LSN) + 2 * sizeof(int) <= end; i++)
+    {
+        RedoDirtyEntry e;
+        memcpy(&e.recLSN, in, sizeof(LSN));
+        memcpy(&e.pageNum, in + sizeof(LSN), sizeof(int));
+        memcpy(&e.nameLen, in + sizeof(LSN) + sizeof(int), sizeof(int));
+        e.name = in + sizeof(LSN) + 2 * sizeof(int);
+        if (e.nameLen < 0 || e.name + e.nameLen > end)
+            break;
+        in = e.name + e.nameLen;
+
+        *findDirty(dpt, e.name, e.nameLen, e.pageNum) = e;
+        if (e.recLSN < start)
+            start = e.recLSN;
+    }
+    return start;
+}
+
+/*
+ * readRecord
+ * ----------
+ * Read the record at the current position of the log, which had to start at
+ * 'expected'. The payload went to *data, grown as needed. Returned false at
+ * the end of the log or at a torn or corrupt record.
+ */
+static bool readRecord(FILE *file, LSN expected, WAL_RecordHeader *hdr, char *name, char **data, int *cap)
+{
+    if (fread(hdr, sizeof(WAL_RecordHeader), 1, file) != 1)
+        return false;
+    if (hdr->lsn != expected || hdr->nameLen < 0 || hdr->nameLen > WAL_MAX_NAME
+        || hdr->dataLen < 0 || hdr->dataLen > WAL_MAX_PAYLOAD)
+        return false;
+    if (hdr->dataLen > *cap)
+    {
+        char *grown = (char *) realloc(*data, hdr->dataLen);
+        if (grown == NULL)
+            return false;
+        *data = grown;
+        *cap = hdr->dataLen;
+    }
+    if (fread(name, 1, hdr->nameLen, file) != (size_t) hdr->nameLen
+        || fread(*data, 1, hdr->dataLen, file) != (size_t) hdr->dataLen)
+        return false;
+    name[hdr->nameLen] = '\0';
+
+    unsigned int expectedSum = hdr->checksum;
+    hdr->checksum = 0;
+    bool ok = recordChecksum(hdr, name, *data) == expectedSum;
+    hdr->checksum = expectedSum;
+    return ok;
+}
+
+/*
+ * closeRedoFile
+ * -------------
+ * Made the pages redone into a file durable and closed it.
+ */
+static RC closeRedoFile(RedoFile *f)
+{
+    RC rc = RC_OK;
+    if (f->compressed)
+    {
+        rc = syncPageFile(&f->fh);
+        RC closed = closePageFile(&f->fh);
+        if (rc == RC_OK)
+            rc = closed;
+        f->compressed = false;
+    }
+    if (f->fd >= 0)
+    {
+        if (fdatasync(f->fd) != 0)
+            rc = RC_WRITE_FAILED;
+        close(f->fd);
+        f->fd = -1;
+    }
+    return rc;
+}
+
+/*
+ * redoPage
+ * --------
+ * Wrote one page image to its file (writing past the end grew the file).
+ * Pages of files that had been deleted since were dropped. Compressed files
+ * went through the storage manager, which shared one open state between the
+ * workers writing to the same file.
+ */
+static RC redoPage(RedoFile *f, const char *name, int pageNum, const char *data)
+{
+    if ((f->fd < 0 && !f->compressed) || strcmp(f->name, name) != 0)
+    {
+        RC rc = closeRedoFile(f);
+        if (rc != RC_OK) return rc;
+
+        SM_Codec codec;
+        if (getPageFileCodec((char *) name, &codec) != RC_OK)
+            return RC_OK;
+        strcpy(f->name, name);
+        if (codec != SM_CODEC_NONE)
+        {
+            rc = openPageFile(f->name, &f->fh);
+            if (rc != RC_OK) return rc;
+            f->compressed = true;
+        }
+        else
+        {
+            f->fd = open(name, O_WRONLY);
+            if (f->fd < 0)
+                return (errno == ENOENT) ? RC_OK : RC_WRITE_FAILED;
+        }
+    }
+    if (f->compressed)
+    {
+        RC rc = ensureCapacity(pageNum + 1, &f->fh);
+        return (rc == RC_OK) ? writeBlock(pageNum, &f->fh, (char *) data) : rc;
+    }
+    if (pwrite(f->fd, data, PAGE_SIZE, (off_t) pageNum * PAGE_SIZE) != PAGE_SIZE)
+        return RC_WRITE_FAILED;
+    return RC_OK;
+}
+
+/*
+ * redoTruncate
+ * ------------
+ * Cut a page file back to numPages pages if it was longer.
+ */
+static RC redoTruncate(const char *name, int numPages)
+{
+    SM_Codec codec;
+    if (getPageFileCodec((char *) name, &codec) != RC_OK)
+        return RC_OK;
+    if (codec != SM_CODEC_NONE)
+    {
+        SM_FileHandle fh;
+        RC rc = openPageFile((char *) name, &fh);
+        if (rc != RC_OK) return rc;
+        if (fh.totalNumPages > numPages)
+            rc = truncatePageFile(numPages, &fh);
+        if (rc == RC_OK)
+            rc = syncPageFile(&fh);
+        RC closed = closePageFile(&fh);
+        return (rc == RC_OK) ? closed : rc;
+    }
+
+    int fd = open(name, O_WRONLY);
+    if (fd < 0)
+        return (errno == ENOENT) ? RC_OK : RC_WRITE_FAILED;
+
+    RC rc = RC_OK;
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size > (off_t) numPages * PAGE_SIZE
+        && (ftruncate(fd, (off_t) numPages * PAGE_SIZE) != 0 || fdatasync(fd) != 0))
+        rc = RC_WRITE_FAILED;
+    close(fd);
+    return rc;
+}
+
+/*
+ * redoWorker
+ * ----------
+ * Thread body: applied the records queued for this worker in order until
+ * recovery said no more would come.
+ */
+static void *redoWorker(void *arg)
+{
+    RedoWorker *w = (RedoWorker *) arg;
+
+    pthread_mutex_lock(&w->lock);
+    for (;;)
+    {
+        while (w->count == 0 && !w->done)
+            pthread_cond_wait(&w->changed, &w->lock);
+        if (w->count == 0)
+            break;
+
+        // The slot stayed counted, so the reader did not reuse it meanwhile
+        RedoItem *item = &w->items[w->head];
+        pthread_mutex_unlock(&w->lock);
+        RC rc = redoPage(&w->file, item->name, item->pageNum, item->data);
+        pthread_mutex_lock(&w->lock);
+
+        if (rc != RC_OK && w->rc == RC_OK)
+            w->rc = rc;
+        w->head = (w->head + 1) % WAL_REDO_QUEUE;
+        w->count--;
+        pthread_cond_broadcast(&w->changed);
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    RC rc = closeRedoFile(&w->file);
+    if (rc != RC_OK && w->rc == RC_OK)
+        w->rc = rc;
+    return NULL;
+}
+
+/*
+ * queueRedo
+ * ---------
+ * Handed a page record to a worker, waiting while its queue was full.
+ */
+static void queueRedo(RedoWorker *w, const char *name, int pageNum, const char *data)
+{
+    pthread_mutex_lock(&w->lock);
+    while (w->count == WAL_REDO_QUEUE)
+        pthread_cond_wait(&w->changed, &w->lock);
+    RedoItem *item = &w->items[(w->head + w->count) % WAL_REDO_QUEUE];
+    pthread_mutex_unlock(&w->lock);
+
+    // Only the reader wrote past the queued records, so it filled the slot unlocked
+    strcpy(item->name, name);
+    item->pageNum = pageNum;
+    memcpy(item->data, data, PAGE_SIZE);
+
+    pthread_mutex_lock(&w->lock);
+    w->count++;
+    pthread_cond_signal(&w->changed);
+    pthread_mutex_unlock(&w->lock);
+}
+
+/*
+ * drainRedo
+ * ---------
+ * Waited until every worker had applied everything queued for it.
+ */
+static void drainRedo(RedoWorker *workers, int numWorkers)
+{
+    for (int i = 0; i < numWorkers; i++)
+    {
+        pthread_mutex_lock(&workers[i].lock);
+        while (workers[i].count > 0)
+            pthread_cond_wait(&workers[i].changed, &workers[i].lock);
+        pthread_mutex_unlock(&workers[i].lock);
+    }
+}
+
+/*
+ * recoverLog
+ * ----------
+ * Brought the page files up to date after a crash. Redo started at the oldest
+ * recLSN of the last checkpoint (the whole log without one). A page record
+ * older than the checkpoint was only applied if its page had been dirty then
+ * and the record was not older than the page's recLSN. Page records went to
+ * numWorkers threads by page, so different pages were redone in parallel, and
+ * a truncate record waited for all of them. Page images made redo idempotent,
+ * so a crash during recovery was handled by running it again. A torn or
+ * corrupt record ended the log and was cut off, so later appends followed the
+ * last good record.
+ */
+RC recoverLog(char *fileName, int numWorkers, WAL_RecoveryStats *stats)
+{
+    FILE *file = fopen(fileName, "r+b");
+    if (file == NULL)
+        return RC_FILE_NOT_FOUND;
+    if (numWorkers <= 0)
+        numWorkers = WAL_DEFAULT_REDO_WORKERS;
+
+    WAL_RecoveryStats st;
+    WAL_RecordHeader hdr;
+    RedoDirtyTable dpt;
+    char name[WAL_MAX_NAME + 1];
+    char *data = NULL, *checkpoint = NULL;
+    int cap = 0;
+    LSN pos;
+    RC rc = RC_OK;
+
+    memset(&st, 0, sizeof(st));
+    memset(&dpt, 0, sizeof(dpt));
+    st.checkpointLSN = WAL_NO_LSN;
+
+    // Started from the checkpoint the master file named, if it was intact
+    if (readMaster(fileName, &pos) && fseek(file, pos, SEEK_SET) == 0
+        && readRecord(file, pos, &hdr, name, &data, &cap) && hdr.type == WAL_REC_CHECKPOINT)
+    {
+        st.checkpointLSN = pos;
+        checkpoint = data;
+        data = NULL;
+        cap = 0;
+        st.redoStart = loadDirtyTable(&dpt, checkpoint, hdr.dataLen, pos);
+    }
+
+    RedoWorker *workers = (RedoWorker *) calloc(numWorkers, sizeof(RedoWorker));
+    for (int i = 0; i < numWorkers; i++)
+    {
+        workers[i].items = (RedoItem *) malloc(WAL_REDO_QUEUE * sizeof(RedoItem));
+        workers[i].file.fd = -1;
+        workers[i].file.compressed = false;
+        pthread_mutex_init(&workers[i].lock, NULL);
+        pthread_cond_init(&workers[i].changed, NULL);
+        pthread_create(&workers[i].thread, NULL, redoWorker, &workers[i]);
+    }
+
+    pos = st.redoStart;
+    fseek(file, pos, SEEK_SET);
+    while (rc == RC_OK && readRecord(file, pos, &hdr, name, &data, &cap))
+    {
+        pos += (LSN) sizeof(hdr) + hdr.nameLen + hdr.dataLen;
+        st.numRecords++;
+        bool afterCheckpoint = (st.checkpointLSN == WAL_NO_LSN || hdr.lsn > st.checkpointLSN);
+
+        if (hdr.type == WAL_REC_PAGE)
+        {
+            if (!afterCheckpoint)
+            {
+                RedoDirtyEntry *e = findDirty(&dpt, name, hdr.nameLen, hdr.pageNum);
+                if (e->name == NULL || hdr.lsn < e->recLSN)
+                {
+                    st.numSkipped++;
+                    continue;
+                }
+            }
+            unsigned int w = pageHash(name, hdr.nameLen, hdr.pageNum) % numWorkers;
+            queueRedo(&workers[w], name, hdr.pageNum, data);
+            st.numRedone++;
+        }
+        else if (hdr.type == WAL_REC_TRUNCATE && afterCheckpoint)
+        {
+            drainRedo(workers, numWorkers);
+            rc = redoTruncate(name, hdr.pageNum);
+            st.numRedone++;
+        }
+    }
+
+    for (int i = 0; i < numWorkers; i++)
+    {
+        pthread_mutex_lock(&workers[i].lock);
+        workers[i].done = true;
+        pthread_cond_signal(&workers[i].changed);
+        pthread_mutex_unlock(&workers[i].lock);
+    }
+    for (int i = 0; i < numWorkers; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        if (rc == RC_OK)
+            rc = workers[i].rc;
+        pthread_mutex_destroy(&workers[i].lock);
+        pthread_cond_destroy(&workers[i].changed);
+        free(workers[i].items);
+    }
+    free(workers);
+    free(dpt.entries);
+    free(checkpoint);
+    free(data);
+
+    // Cut off whatever followed the last good record
+    if (rc == RC_OK)
+    {
+        fflush(file);
+        fseek(file, 0, SEEK_END);
+        if (ftell(file) > pos && ftruncate(fileno(file), (off_t) pos) != 0)
+            rc = RC_WRITE_FAILED;
+    }
+    fclose(file);
+
+    if (stats != NULL)
+        *stats = st;
+    return rc;
+}
+
+/*
+ * getFlushedLSN
+ * -------------
+ * Returned the LSN up to which (exclusive) the log was durable.
+ */
+LSN getFlushedLSN(WAL_Log *log)
+{
+    WAL_MgmtData *m = (WAL_MgmtData *) log->mgmtData;
+    pthread_mutex_lock(&m->lock);
+    LSN lsn = m->flushedLSN;
+    pthread_mutex_unlock(&m->lock);
+    return lsn;
+}
+
+/*
+ * getLastCheckpointLSN
+ * --------------------
+ * Returned the LSN of the newest durable checkpoint (WAL_NO_LSN if none).
+ */
+LSN getLastCheckpointLSN(WAL_Log *log)
+{
+    WAL_MgmtData *m = (WAL_MgmtData *) log->mgmtData;
+    pthread_mutex_lock(&m->lock);
+    LSN lsn = m->lastCheckpoint;
+    pthread_mutex_unlock(&m->lock);
+    return lsn;
+}
+
+/*
+ * getNumLogSyncs
+ * --------------
+ * Returned how many times the log had been synced to disk.
+ */
+int getNumLogSyncs(WAL_Log *log)
+{
+    WAL_MgmtData *m = (WAL_MgmtData *) log->mgmtData;
+    pthread_mutex_lock(&m->lock);
+    int syncs = m->numSyncs;
+    pthread_mutex_unlock(&m->lock);
+    return syncs;
+}
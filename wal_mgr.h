@@ -0,0 +1,90 @@
+#ifndef WAL_MGR_H
+#define WAL_MGR_H
+
+#include "dberror.h"
+
+/*
+ * Write-ahead log of page changes.
+ *
+ * The log was an append-only file of redo records, and the LSN of a record was
+ * its byte offset in that file. A page record held the image of one page of
+ * one page file after a change. A buffer pool with a log attached (see
+ * setPoolLog) appended one whenever a page marked dirty was unpinned, and
+ * before it wrote a dirty page back to its file it forced the log up to that
+ * page's LSN, so no page reached its file before the log record describing it.
+ *
+ * commitLog appended a commit record and returned once it was durable. Records
+ * were collected in memory and written by whichever committer found no sync
+ * running; everyone who had appended by then shared its fdatasync, and the
+ * leader waited groupCommitUsec first to let more committers join the batch.
+ *
+ * Checkpoints were fuzzy: logCheckpoint recorded the dirty page table (every
+ * dirty page with the LSN of the first record that dirtied it, its recLSN)
+ * without writing any page or holding up writers, and the LSN of the newest
+ * checkpoint was kept in a small master file next to the log ("<log>.master").
+ * The buffer manager collected the table (see checkpointLog in buffer_mgr.h).
+ *
+ * After a crash, recoverLog started redo at the oldest recLSN of the last
+ * checkpoint instead of the start of the log, and skipped page records that
+ * the checkpoint showed were already on disk. Page records were handed to
+ * numWorkers threads by page, so each page saw its records in log order while
+ * different pages were redone in parallel. A torn record at the end of the log
+ * was cut off. Recovery ran before any table was opened.
+ */
+
+typedef long long LSN;
+
+#define WAL_NO_LSN ((LSN) -1)
+
+// redo threads used by recoverLog when the caller passed 0
+#define WAL_DEFAULT_REDO_WORKERS 4
+
+// One entry of the dirty page table of a checkpoint
+typedef struct WAL_DirtyPage
+{
+	char *pageFile;
+	int pageNum;
+	LSN recLSN;            // first record that dirtied the page since it was last written
+} WAL_DirtyPage;
+
+// What recoverLog did
+typedef struct WAL_RecoveryStats
+{
+	LSN checkpointLSN;     // checkpoint recovery started from (WAL_NO_LSN if none)
+	LSN redoStart;         // first log record read
+	int numRecords;        // records read from redoStart on
+	int numRedone;         // page and truncate records applied
+	int numSkipped;        // page records the checkpoint showed were on disk
+} WAL_RecoveryStats;
+
+// Bookkeeping for an open log
+typedef struct WAL_Log
+{
+	char *fileName;
+	int groupCommitUsec;   // how long a commit leader waited for others to join its sync
+	LSN checkpointInterval;   // log bytes between automatic checkpoints (0 => only explicit ones)
+	void *mgmtData;
+} WAL_Log;
+
+// creating, opening and closing logs
+extern RC createLog (char *fileName);
+extern RC openLog (WAL_Log *log, char *fileName);
+extern RC closeLog (WAL_Log *log);
+extern RC destroyLog (char *fileName);
+
+// appending records and making them durable
+extern RC logPageImage (WAL_Log *log, char *pageFile, int pageNum, char *data, LSN *lsn);
+extern RC logFileTruncate (WAL_Log *log, char *pageFile, int numPages, LSN *lsn);
+extern RC flushLog (WAL_Log *log, LSN lsn);
+extern RC commitLog (WAL_Log *log, LSN *lsn);
+extern RC logCheckpoint (WAL_Log *log, WAL_DirtyPage *dirty, int numDirty, LSN *lsn);
+
+// restart
+extern RC recoverLog (char *fileName, int numWorkers, WAL_RecoveryStats *stats);
+
+// statistics
+extern LSN getFlushedLSN (WAL_Log *log);
+extern LSN getLastCheckpointLSN (WAL_Log *log);
+extern int getNumLogSyncs (WAL_Log *log);
+
+#endif // WAL_MGR_H